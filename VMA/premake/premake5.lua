@@ -30,7 +30,7 @@ filename ("VulkanSample_" .. _SUFFIX)
 targetdir "../bin"
 objdir "../build/Desktop_%{_SUFFIX}/%{cfg.platform}/%{cfg.buildcfg}"
 floatingpoint "Fast"
-files { "../src/*.h", "../src/*.cpp" }
+files { "../src/*.h", "../src/*.cpp", "../src/VmaReplay/BinaryRecording.h", "../src/VmaReplay/BinaryRecording.cpp" }
 flags { "NoPCH", "FatalWarnings" }
 characterset "Unicode"
 
@@ -61,7 +61,6 @@ buildoptions { "/MD" }
 
 
 project "VmaReplay"
-removeplatforms { "Linux-x64" }
 kind "ConsoleApp"
 language "C++"
 location "../build"
@@ -69,7 +68,7 @@ filename ("VmaReplay_" .. _SUFFIX)
 targetdir "../bin"
 objdir "../build/Desktop_%{_SUFFIX}/%{cfg.platform}/%{cfg.buildcfg}"
 floatingpoint "Fast"
-files { "../src/VmaReplay/*.h", "../src/VmaReplay/*.cpp" }
+files { "../src/VmaReplay/*.h", "../src/VmaReplay/*.cpp", "../src/NullDevice.h", "../src/NullDevice.cpp" }
 flags { "NoPCH", "FatalWarnings" }
 characterset "Default"
 
@@ -86,11 +85,13 @@ targetsuffix ("_Release_" .. _SUFFIX)
 
 filter { "platforms:x64" }
 defines { "WIN32", "_CONSOLE", "PROFILE", "_WINDOWS", "_WIN32_WINNT=0x0601" }
-links { "vulkan-1" }
+includedirs { "../../zlib/include" }
+libdirs { "../../zlib/lib64-vc" .. string.sub(_ACTION, 3) }
+links { "vulkan-1", "zlibstatic" }
 
 filter { "platforms:Linux-x64" }
 buildoptions { "-std=c++0x" }
-links { "vulkan" }
+links { "vulkan", "z" }
 
 filter { "configurations:Debug", "platforms:x64" }
 buildoptions { "/MDd" }
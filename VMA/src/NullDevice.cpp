@@ -0,0 +1,543 @@
+//
+// Copyright (c) 2017-2019 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "VmaUsage.h"
+#include "NullDevice.h"
+
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+static const VkDeviceSize NULL_DEVICE_BUFFER_ALIGNMENT = 256;
+static const VkDeviceSize NULL_DEVICE_LINEAR_IMAGE_ALIGNMENT = 256;
+static const VkDeviceSize NULL_DEVICE_OPTIMAL_IMAGE_ALIGNMENT = 4096;
+// Size of a texel assumed for every format.
+static const VkDeviceSize NULL_DEVICE_TEXEL_SIZE = 4;
+
+struct NullDeviceMemory
+{
+    uint32_t memoryTypeIndex;
+    VkDeviceSize size;
+    // Null until the memory is mapped or copied to for the first time.
+    // Atomic because different threads may map the same memory or copy to it at the same time.
+    std::atomic<char*> pData;
+};
+
+struct NullDeviceResource
+{
+    VkDeviceSize size;
+    VkDeviceSize alignment;
+    NullDeviceMemory* pMemory;
+    VkDeviceSize memoryOffset;
+};
+
+template<typename HandleT>
+static HandleT ToHandle(void* ptr)
+{
+    return (HandleT)(uintptr_t)ptr;
+}
+
+template<typename HandleT>
+static NullDeviceMemory* ToMemory(HandleT handle)
+{
+    return (NullDeviceMemory*)(uintptr_t)handle;
+}
+
+template<typename HandleT>
+static NullDeviceResource* ToResource(HandleT handle)
+{
+    return (NullDeviceResource*)(uintptr_t)handle;
+}
+
+static VkDeviceSize AlignUp(VkDeviceSize val, VkDeviceSize align)
+{
+    return (val + align - 1) / align * align;
+}
+
+// Returns data of the memory, allocating it on first use, or null if it couldn't be allocated.
+static char* EnsureMemoryData(NullDeviceMemory* pMemory)
+{
+    char* pData = pMemory->pData.load();
+    if(pData == nullptr && pMemory->size <= SIZE_MAX)
+    {
+        char* const pNewData = (char*)calloc(1, (size_t)pMemory->size);
+        if(pNewData == nullptr)
+        {
+            return nullptr;
+        }
+        // Another thread may have allocated the data in the meantime. Then use its data instead.
+        if(pMemory->pData.compare_exchange_strong(pData, pNewData))
+        {
+            pData = pNewData;
+        }
+        else
+        {
+            free(pNewData);
+        }
+    }
+    return pData;
+}
+
+static VkDeviceSize CalcImageSize(const VkImageCreateInfo& createInfo)
+{
+    VkDeviceSize size = 0;
+    uint32_t width = createInfo.extent.width;
+    uint32_t height = createInfo.extent.height;
+    uint32_t depth = createInfo.extent.depth;
+    for(uint32_t mipLevel = 0; mipLevel < createInfo.mipLevels; ++mipLevel)
+    {
+        size += (VkDeviceSize)width * height * depth;
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+        depth = depth > 1 ? depth / 2 : 1;
+    }
+    const VkDeviceSize sampleCount = createInfo.samples != 0 ? (VkDeviceSize)createInfo.samples : 1;
+    return size * createInfo.arrayLayers * sampleCount * NULL_DEVICE_TEXEL_SIZE;
+}
+
+void GetDefaultNullDeviceDesc(NullDeviceDesc& outDesc)
+{
+    memset(&outDesc, 0, sizeof(outDesc));
+
+    VkPhysicalDeviceProperties& props = outDesc.properties;
+    props.apiVersion = VK_MAKE_VERSION(1, 0, 0);
+    props.deviceType = VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU;
+    strcpy(props.deviceName, "Null Device");
+    props.limits.maxMemoryAllocationCount = 4096;
+    props.limits.bufferImageGranularity = 1024;
+    props.limits.nonCoherentAtomSize = 64;
+
+    VkPhysicalDeviceMemoryProperties& memProps = outDesc.memoryProperties;
+    memProps.memoryHeapCount = 2;
+    memProps.memoryHeaps[0].size = 8ull * 1024 * 1024 * 1024;
+    memProps.memoryHeaps[0].flags = VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+    memProps.memoryHeaps[1].size = 16ull * 1024 * 1024 * 1024;
+    memProps.memoryTypeCount = 3;
+    memProps.memoryTypes[0].heapIndex = 0;
+    memProps.memoryTypes[0].propertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    memProps.memoryTypes[1].heapIndex = 1;
+    memProps.memoryTypes[1].propertyFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    memProps.memoryTypes[2].heapIndex = 1;
+    memProps.memoryTypes[2].propertyFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT |
+        VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+
+    outDesc.dedicatedAllocationExtension = true;
+    outDesc.bindMemory2Extension = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// class NullDevice
+
+NullDevice::NullDevice(const NullDeviceDesc& desc) :
+    m_Desc(desc),
+    m_AllocationCount(0)
+{
+    assert(desc.memoryProperties.memoryHeapCount <= VK_MAX_MEMORY_HEAPS);
+    assert(desc.memoryProperties.memoryTypeCount <= VK_MAX_MEMORY_TYPES);
+    for(uint32_t i = 0; i < VK_MAX_MEMORY_HEAPS; ++i)
+    {
+        m_HeapUsage[i] = 0;
+    }
+
+    memset(&m_VulkanFunctions, 0, sizeof(m_VulkanFunctions));
+    m_VulkanFunctions.vkGetPhysicalDeviceProperties = GetPhysicalDeviceProperties;
+    m_VulkanFunctions.vkGetPhysicalDeviceMemoryProperties = GetPhysicalDeviceMemoryProperties;
+    m_VulkanFunctions.vkAllocateMemory = AllocateMemory;
+    m_VulkanFunctions.vkFreeMemory = FreeMemory;
+    m_VulkanFunctions.vkMapMemory = MapMemory;
+    m_VulkanFunctions.vkUnmapMemory = UnmapMemory;
+    m_VulkanFunctions.vkFlushMappedMemoryRanges = FlushMappedMemoryRanges;
+    m_VulkanFunctions.vkInvalidateMappedMemoryRanges = InvalidateMappedMemoryRanges;
+    m_VulkanFunctions.vkBindBufferMemory = BindBufferMemory;
+    m_VulkanFunctions.vkBindImageMemory = BindImageMemory;
+    m_VulkanFunctions.vkGetBufferMemoryRequirements = GetBufferMemoryRequirements;
+    m_VulkanFunctions.vkGetImageMemoryRequirements = GetImageMemoryRequirements;
+    m_VulkanFunctions.vkCreateBuffer = CreateBuffer;
+    m_VulkanFunctions.vkDestroyBuffer = DestroyBuffer;
+    m_VulkanFunctions.vkCreateImage = CreateImage;
+    m_VulkanFunctions.vkDestroyImage = DestroyImage;
+    m_VulkanFunctions.vkCmdCopyBuffer = CmdCopyBuffer;
+#if VMA_DEDICATED_ALLOCATION
+    if(desc.dedicatedAllocationExtension)
+    {
+        m_VulkanFunctions.vkGetBufferMemoryRequirements2KHR = GetBufferMemoryRequirements2KHR;
+        m_VulkanFunctions.vkGetImageMemoryRequirements2KHR = GetImageMemoryRequirements2KHR;
+    }
+#endif
+#if VMA_BIND_MEMORY2
+    if(desc.bindMemory2Extension)
+    {
+        m_VulkanFunctions.vkBindBufferMemory2KHR = BindBufferMemory2KHR;
+        m_VulkanFunctions.vkBindImageMemory2KHR = BindImageMemory2KHR;
+    }
+#endif
+}
+
+NullDevice::~NullDevice()
+{
+    assert(m_AllocationCount == 0 && "Unfreed VkDeviceMemory found.");
+}
+
+VkPhysicalDevice NullDevice::GetPhysicalDevice() const
+{
+    return reinterpret_cast<VkPhysicalDevice>(const_cast<NullDevice*>(this));
+}
+
+VkDevice NullDevice::GetDevice() const
+{
+    return reinterpret_cast<VkDevice>(const_cast<NullDevice*>(this));
+}
+
+VkCommandBuffer NullDevice::GetCommandBuffer() const
+{
+    return reinterpret_cast<VkCommandBuffer>(const_cast<NullDevice*>(this));
+}
+
+VkDeviceSize NullDevice::GetHeapUsage(uint32_t heapIndex) const
+{
+    assert(heapIndex < m_Desc.memoryProperties.memoryHeapCount);
+    return m_HeapUsage[heapIndex].load();
+}
+
+NullDevice* NullDevice::FromHandle(VkPhysicalDevice physicalDevice)
+{
+    return reinterpret_cast<NullDevice*>(physicalDevice);
+}
+
+NullDevice* NullDevice::FromHandle(VkDevice device)
+{
+    return reinterpret_cast<NullDevice*>(device);
+}
+
+NullDevice* NullDevice::FromHandle(VkCommandBuffer commandBuffer)
+{
+    return reinterpret_cast<NullDevice*>(commandBuffer);
+}
+
+uint32_t NullDevice::GetAllMemoryTypeBits() const
+{
+    const uint32_t memTypeCount = m_Desc.memoryProperties.memoryTypeCount;
+    return memTypeCount < 32 ? (1u << memTypeCount) - 1 : UINT32_MAX;
+}
+
+void NullDevice::Wait(uint64_t nanoseconds) const
+{
+    if(nanoseconds == 0)
+    {
+        return;
+    }
+    const auto endTime = std::chrono::steady_clock::now() + std::chrono::nanoseconds(nanoseconds);
+    while(std::chrono::steady_clock::now() < endTime)
+    {
+    }
+}
+
+void VKAPI_CALL NullDevice::GetPhysicalDeviceProperties(VkPhysicalDevice physicalDevice, VkPhysicalDeviceProperties* pProperties)
+{
+    *pProperties = FromHandle(physicalDevice)->m_Desc.properties;
+}
+
+void VKAPI_CALL NullDevice::GetPhysicalDeviceMemoryProperties(VkPhysicalDevice physicalDevice, VkPhysicalDeviceMemoryProperties* pMemoryProperties)
+{
+    *pMemoryProperties = FromHandle(physicalDevice)->m_Desc.memoryProperties;
+}
+
+VkResult VKAPI_CALL NullDevice::AllocateMemory(VkDevice device, const VkMemoryAllocateInfo* pAllocateInfo, const VkAllocationCallbacks* pAllocator, VkDeviceMemory* pMemory)
+{
+    NullDevice* const self = FromHandle(device);
+    self->Wait(self->m_Desc.allocateMemoryLatency);
+
+    const VkPhysicalDeviceMemoryProperties& memProps = self->m_Desc.memoryProperties;
+    assert(pAllocateInfo->memoryTypeIndex < memProps.memoryTypeCount);
+    const uint32_t heapIndex = memProps.memoryTypes[pAllocateInfo->memoryTypeIndex].heapIndex;
+    const VkDeviceSize heapSize = memProps.memoryHeaps[heapIndex].size;
+
+    if(++self->m_AllocationCount > self->m_Desc.properties.limits.maxMemoryAllocationCount)
+    {
+        --self->m_AllocationCount;
+        return VK_ERROR_TOO_MANY_OBJECTS;
+    }
+
+    std::atomic<VkDeviceSize>& heapUsage = self->m_HeapUsage[heapIndex];
+    VkDeviceSize prevUsage = heapUsage.load();
+    do
+    {
+        if(pAllocateInfo->allocationSize > heapSize - prevUsage)
+        {
+            --self->m_AllocationCount;
+            return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+        }
+    } while(!heapUsage.compare_exchange_weak(prevUsage, prevUsage + pAllocateInfo->allocationSize));
+
+    NullDeviceMemory* const pMem = new NullDeviceMemory();
+    pMem->memoryTypeIndex = pAllocateInfo->memoryTypeIndex;
+    pMem->size = pAllocateInfo->allocationSize;
+    pMem->pData = nullptr;
+    *pMemory = ToHandle<VkDeviceMemory>(pMem);
+    return VK_SUCCESS;
+}
+
+void VKAPI_CALL NullDevice::FreeMemory(VkDevice device, VkDeviceMemory memory, const VkAllocationCallbacks* pAllocator)
+{
+    NullDevice* const self = FromHandle(device);
+    self->Wait(self->m_Desc.freeMemoryLatency);
+    if(memory == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    NullDeviceMemory* const pMem = ToMemory(memory);
+    const uint32_t heapIndex = self->m_Desc.memoryProperties.memoryTypes[pMem->memoryTypeIndex].heapIndex;
+    self->m_HeapUsage[heapIndex] -= pMem->size;
+    --self->m_AllocationCount;
+    free(pMem->pData.load());
+    delete pMem;
+}
+
+VkResult VKAPI_CALL NullDevice::MapMemory(VkDevice device, VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize size, VkMemoryMapFlags flags, void** ppData)
+{
+    NullDevice* const self = FromHandle(device);
+    self->Wait(self->m_Desc.otherCallLatency);
+
+    NullDeviceMemory* const pMem = ToMemory(memory);
+    const VkMemoryPropertyFlags memFlags = self->m_Desc.memoryProperties.memoryTypes[pMem->memoryTypeIndex].propertyFlags;
+    if((memFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) == 0)
+    {
+        assert(0 && "Mapping memory that is not HOST_VISIBLE.");
+        return VK_ERROR_MEMORY_MAP_FAILED;
+    }
+    assert(offset < pMem->size);
+    char* const pData = EnsureMemoryData(pMem);
+    if(pData == nullptr)
+    {
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+    *ppData = pData + offset;
+    return VK_SUCCESS;
+}
+
+void VKAPI_CALL NullDevice::UnmapMemory(VkDevice device, VkDeviceMemory memory)
+{
+    NullDevice* const self = FromHandle(device);
+    self->Wait(self->m_Desc.otherCallLatency);
+}
+
+VkResult VKAPI_CALL NullDevice::FlushMappedMemoryRanges(VkDevice device, uint32_t memoryRangeCount, const VkMappedMemoryRange* pMemoryRanges)
+{
+    NullDevice* const self = FromHandle(device);
+    self->Wait(self->m_Desc.otherCallLatency);
+    return VK_SUCCESS;
+}
+
+VkResult VKAPI_CALL NullDevice::InvalidateMappedMemoryRanges(VkDevice device, uint32_t memoryRangeCount, const VkMappedMemoryRange* pMemoryRanges)
+{
+    NullDevice* const self = FromHandle(device);
+    self->Wait(self->m_Desc.otherCallLatency);
+    return VK_SUCCESS;
+}
+
+VkResult VKAPI_CALL NullDevice::BindBufferMemory(VkDevice device, VkBuffer buffer, VkDeviceMemory memory, VkDeviceSize memoryOffset)
+{
+    NullDevice* const self = FromHandle(device);
+    self->Wait(self->m_Desc.otherCallLatency);
+
+    NullDeviceResource* const pBuf = ToResource(buffer);
+    NullDeviceMemory* const pMem = ToMemory(memory);
+    assert(memoryOffset % pBuf->alignment == 0 && memoryOffset + pBuf->size <= pMem->size);
+    pBuf->pMemory = pMem;
+    pBuf->memoryOffset = memoryOffset;
+    return VK_SUCCESS;
+}
+
+VkResult VKAPI_CALL NullDevice::BindImageMemory(VkDevice device, VkImage image, VkDeviceMemory memory, VkDeviceSize memoryOffset)
+{
+    NullDevice* const self = FromHandle(device);
+    self->Wait(self->m_Desc.otherCallLatency);
+
+    NullDeviceResource* const pImg = ToResource(image);
+    NullDeviceMemory* const pMem = ToMemory(memory);
+    assert(memoryOffset % pImg->alignment == 0 && memoryOffset + pImg->size <= pMem->size);
+    pImg->pMemory = pMem;
+    pImg->memoryOffset = memoryOffset;
+    return VK_SUCCESS;
+}
+
+void VKAPI_CALL NullDevice::GetBufferMemoryRequirements(VkDevice device, VkBuffer buffer, VkMemoryRequirements* pMemoryRequirements)
+{
+    NullDevice* const self = FromHandle(device);
+    self->Wait(self->m_Desc.otherCallLatency);
+
+    const NullDeviceResource* const pBuf = ToResource(buffer);
+    pMemoryRequirements->size = AlignUp(pBuf->size, pBuf->alignment);
+    pMemoryRequirements->alignment = pBuf->alignment;
+    pMemoryRequirements->memoryTypeBits = self->GetAllMemoryTypeBits();
+}
+
+void VKAPI_CALL NullDevice::GetImageMemoryRequirements(VkDevice device, VkImage image, VkMemoryRequirements* pMemoryRequirements)
+{
+    NullDevice* const self = FromHandle(device);
+    self->Wait(self->m_Desc.otherCallLatency);
+
+    const NullDeviceResource* const pImg = ToResource(image);
+    pMemoryRequirements->size = AlignUp(pImg->size, pImg->alignment);
+    pMemoryRequirements->alignment = pImg->alignment;
+    pMemoryRequirements->memoryTypeBits = self->GetAllMemoryTypeBits();
+}
+
+VkResult VKAPI_CALL NullDevice::CreateBuffer(VkDevice device, const VkBufferCreateInfo* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkBuffer* pBuffer)
+{
+    NullDevice* const self = FromHandle(device);
+    self->Wait(self->m_Desc.otherCallLatency);
+
+    NullDeviceResource* const pBuf = new(std::nothrow) NullDeviceResource();
+    if(pBuf == nullptr)
+    {
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+    pBuf->size = pCreateInfo->size;
+    pBuf->alignment = NULL_DEVICE_BUFFER_ALIGNMENT;
+    pBuf->pMemory = nullptr;
+    pBuf->memoryOffset = 0;
+    *pBuffer = ToHandle<VkBuffer>(pBuf);
+    return VK_SUCCESS;
+}
+
+void VKAPI_CALL NullDevice::DestroyBuffer(VkDevice device, VkBuffer buffer, const VkAllocationCallbacks* pAllocator)
+{
+    NullDevice* const self = FromHandle(device);
+    self->Wait(self->m_Desc.otherCallLatency);
+    delete ToResource(buffer);
+}
+
+VkResult VKAPI_CALL NullDevice::CreateImage(VkDevice device, const VkImageCreateInfo* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkImage* pImage)
+{
+    NullDevice* const self = FromHandle(device);
+    self->Wait(self->m_Desc.otherCallLatency);
+
+    NullDeviceResource* const pImg = new(std::nothrow) NullDeviceResource();
+    if(pImg == nullptr)
+    {
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+    pImg->size = CalcImageSize(*pCreateInfo);
+    pImg->alignment = pCreateInfo->tiling == VK_IMAGE_TILING_OPTIMAL ?
+        NULL_DEVICE_OPTIMAL_IMAGE_ALIGNMENT : NULL_DEVICE_LINEAR_IMAGE_ALIGNMENT;
+    pImg->pMemory = nullptr;
+    pImg->memoryOffset = 0;
+    *pImage = ToHandle<VkImage>(pImg);
+    return VK_SUCCESS;
+}
+
+void VKAPI_CALL NullDevice::DestroyImage(VkDevice device, VkImage image, const VkAllocationCallbacks* pAllocator)
+{
+    NullDevice* const self = FromHandle(device);
+    self->Wait(self->m_Desc.otherCallLatency);
+    delete ToResource(image);
+}
+
+void VKAPI_CALL NullDevice::CmdCopyBuffer(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkBuffer dstBuffer, uint32_t regionCount, const VkBufferCopy* pRegions)
+{
+    NullDevice* const self = FromHandle(commandBuffer);
+    self->Wait(self->m_Desc.otherCallLatency);
+
+    const NullDeviceResource* const pSrc = ToResource(srcBuffer);
+    const NullDeviceResource* const pDst = ToResource(dstBuffer);
+    assert(pSrc->pMemory != nullptr && pDst->pMemory != nullptr);
+    // Memory that was never written by the host holds no data worth copying.
+    const char* const pSrcData = pSrc->pMemory->pData.load();
+    if(pSrcData == nullptr)
+    {
+        return;
+    }
+    char* const pDstData = EnsureMemoryData(pDst->pMemory);
+    if(pDstData == nullptr)
+    {
+        return;
+    }
+    for(uint32_t i = 0; i < regionCount; ++i)
+    {
+        const VkBufferCopy& region = pRegions[i];
+        assert(region.srcOffset + region.size <= pSrc->size && region.dstOffset + region.size <= pDst->size);
+        memmove(
+            pDstData + pDst->memoryOffset + region.dstOffset,
+            pSrcData + pSrc->memoryOffset + region.srcOffset,
+            (size_t)region.size);
+    }
+}
+
+#if VMA_DEDICATED_ALLOCATION
+
+void VKAPI_CALL NullDevice::GetBufferMemoryRequirements2KHR(VkDevice device, const VkBufferMemoryRequirementsInfo2KHR* pInfo, VkMemoryRequirements2KHR* pMemoryRequirements)
+{
+    GetBufferMemoryRequirements(device, pInfo->buffer, &pMemoryRequirements->memoryRequirements);
+    VkMemoryDedicatedRequirementsKHR* pDedicatedReq = (VkMemoryDedicatedRequirementsKHR*)pMemoryRequirements->pNext;
+    for(; pDedicatedReq != nullptr; pDedicatedReq = (VkMemoryDedicatedRequirementsKHR*)pDedicatedReq->pNext)
+    {
+        if(pDedicatedReq->sType == VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS_KHR)
+        {
+            pDedicatedReq->requiresDedicatedAllocation = VK_FALSE;
+            pDedicatedReq->prefersDedicatedAllocation = VK_FALSE;
+        }
+    }
+}
+
+void VKAPI_CALL NullDevice::GetImageMemoryRequirements2KHR(VkDevice device, const VkImageMemoryRequirementsInfo2KHR* pInfo, VkMemoryRequirements2KHR* pMemoryRequirements)
+{
+    GetImageMemoryRequirements(device, pInfo->image, &pMemoryRequirements->memoryRequirements);
+    VkMemoryDedicatedRequirementsKHR* pDedicatedReq = (VkMemoryDedicatedRequirementsKHR*)pMemoryRequirements->pNext;
+    for(; pDedicatedReq != nullptr; pDedicatedReq = (VkMemoryDedicatedRequirementsKHR*)pDedicatedReq->pNext)
+    {
+        if(pDedicatedReq->sType == VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS_KHR)
+        {
+            pDedicatedReq->requiresDedicatedAllocation = VK_FALSE;
+            pDedicatedReq->prefersDedicatedAllocation = VK_FALSE;
+        }
+    }
+}
+
+#endif // #if VMA_DEDICATED_ALLOCATION
+
+#if VMA_BIND_MEMORY2
+
+VkResult VKAPI_CALL NullDevice::BindBufferMemory2KHR(VkDevice device, uint32_t bindInfoCount, const VkBindBufferMemoryInfoKHR* pBindInfos)
+{
+    for(uint32_t i = 0; i < bindInfoCount; ++i)
+    {
+        BindBufferMemory(device, pBindInfos[i].buffer, pBindInfos[i].memory, pBindInfos[i].memoryOffset);
+    }
+    return VK_SUCCESS;
+}
+
+VkResult VKAPI_CALL NullDevice::BindImageMemory2KHR(VkDevice device, uint32_t bindInfoCount, const VkBindImageMemoryInfoKHR* pBindInfos)
+{
+    for(uint32_t i = 0; i < bindInfoCount; ++i)
+    {
+        BindImageMemory(device, pBindInfos[i].image, pBindInfos[i].memory, pBindInfos[i].memoryOffset);
+    }
+    return VK_SUCCESS;
+}
+
+#endif // #if VMA_BIND_MEMORY2
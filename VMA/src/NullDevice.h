@@ -0,0 +1,130 @@
+//
+// Copyright (c) 2017-2019 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#ifndef NULL_DEVICE_H_
+#define NULL_DEVICE_H_
+
+/*
+Fake Vulkan device that implements all the functions needed by VMA on top of
+host memory, so the library can be exercised without a GPU or driver.
+
+Memory heaps and types are fully configurable through NullDeviceDesc.
+Allocations are accounted per heap and fail with VK_ERROR_OUT_OF_DEVICE_MEMORY
+when heap size is exceeded, or with VK_ERROR_TOO_MANY_OBJECTS when
+maxMemoryAllocationCount is reached. Host memory backing a VkDeviceMemory is
+allocated only when it is mapped for the first time or is the destination of
+vkCmdCopyBuffer, so heaps of many gigabytes can be simulated cheaply.
+Command buffers are executed immediately by vkCmdCopyBuffer.
+
+Optional latencies can be injected into the functions to simulate cost of
+a real driver. They are busy-waited, not slept, to keep them accurate.
+
+Include this header after vk_mem_alloc.h. Pass the result of
+NullDevice::GetVulkanFunctions() as VmaAllocatorCreateInfo::pVulkanFunctions,
+together with NullDevice::GetPhysicalDevice() and NullDevice::GetDevice().
+*/
+
+#include <atomic>
+#include <cstdint>
+
+struct NullDeviceDesc
+{
+    VkPhysicalDeviceProperties properties;
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    // Whether vkGetBufferMemoryRequirements2KHR, vkGetImageMemoryRequirements2KHR are provided.
+    bool dedicatedAllocationExtension;
+    // Whether vkBindBufferMemory2KHR, vkBindImageMemory2KHR are provided.
+    bool bindMemory2Extension;
+    // Time to spend in vkAllocateMemory, in nanoseconds.
+    uint64_t allocateMemoryLatency;
+    // Time to spend in vkFreeMemory, in nanoseconds.
+    uint64_t freeMemoryLatency;
+    // Time to spend in all other functions, in nanoseconds.
+    uint64_t otherCallLatency;
+};
+
+// Fills the structure with description of a typical discrete GPU, with no latencies.
+void GetDefaultNullDeviceDesc(NullDeviceDesc& outDesc);
+
+class NullDevice
+{
+public:
+    explicit NullDevice(const NullDeviceDesc& desc);
+    ~NullDevice();
+
+    const NullDeviceDesc& GetDesc() const { return m_Desc; }
+    VkPhysicalDevice GetPhysicalDevice() const;
+    VkDevice GetDevice() const;
+    // Command buffer that can be passed to vmaDefragmentationBegin.
+    // It doesn't need to be begun, ended or submitted.
+    VkCommandBuffer GetCommandBuffer() const;
+    const VmaVulkanFunctions& GetVulkanFunctions() const { return m_VulkanFunctions; }
+
+    // Returns number of bytes currently allocated from given heap.
+    VkDeviceSize GetHeapUsage(uint32_t heapIndex) const;
+    // Returns number of VkDeviceMemory objects currently allocated.
+    uint32_t GetAllocationCount() const { return m_AllocationCount.load(); }
+
+private:
+    NullDeviceDesc m_Desc;
+    VmaVulkanFunctions m_VulkanFunctions;
+    std::atomic<VkDeviceSize> m_HeapUsage[VK_MAX_MEMORY_HEAPS];
+    std::atomic<uint32_t> m_AllocationCount;
+
+    NullDevice(const NullDevice&) = delete;
+    NullDevice& operator=(const NullDevice&) = delete;
+
+    static NullDevice* FromHandle(VkPhysicalDevice physicalDevice);
+    static NullDevice* FromHandle(VkDevice device);
+    static NullDevice* FromHandle(VkCommandBuffer commandBuffer);
+    uint32_t GetAllMemoryTypeBits() const;
+    void Wait(uint64_t nanoseconds) const;
+
+    static void VKAPI_CALL GetPhysicalDeviceProperties(VkPhysicalDevice physicalDevice, VkPhysicalDeviceProperties* pProperties);
+    static void VKAPI_CALL GetPhysicalDeviceMemoryProperties(VkPhysicalDevice physicalDevice, VkPhysicalDeviceMemoryProperties* pMemoryProperties);
+    static VkResult VKAPI_CALL AllocateMemory(VkDevice device, const VkMemoryAllocateInfo* pAllocateInfo, const VkAllocationCallbacks* pAllocator, VkDeviceMemory* pMemory);
+    static void VKAPI_CALL FreeMemory(VkDevice device, VkDeviceMemory memory, const VkAllocationCallbacks* pAllocator);
+    static VkResult VKAPI_CALL MapMemory(VkDevice device, VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize size, VkMemoryMapFlags flags, void** ppData);
+    static void VKAPI_CALL UnmapMemory(VkDevice device, VkDeviceMemory memory);
+    static VkResult VKAPI_CALL FlushMappedMemoryRanges(VkDevice device, uint32_t memoryRangeCount, const VkMappedMemoryRange* pMemoryRanges);
+    static VkResult VKAPI_CALL InvalidateMappedMemoryRanges(VkDevice device, uint32_t memoryRangeCount, const VkMappedMemoryRange* pMemoryRanges);
+    static VkResult VKAPI_CALL BindBufferMemory(VkDevice device, VkBuffer buffer, VkDeviceMemory memory, VkDeviceSize memoryOffset);
+    static VkResult VKAPI_CALL BindImageMemory(VkDevice device, VkImage image, VkDeviceMemory memory, VkDeviceSize memoryOffset);
+    static void VKAPI_CALL GetBufferMemoryRequirements(VkDevice device, VkBuffer buffer, VkMemoryRequirements* pMemoryRequirements);
+    static void VKAPI_CALL GetImageMemoryRequirements(VkDevice device, VkImage image, VkMemoryRequirements* pMemoryRequirements);
+    static VkResult VKAPI_CALL CreateBuffer(VkDevice device, const VkBufferCreateInfo* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkBuffer* pBuffer);
+    static void VKAPI_CALL DestroyBuffer(VkDevice device, VkBuffer buffer, const VkAllocationCallbacks* pAllocator);
+    static VkResult VKAPI_CALL CreateImage(VkDevice device, const VkImageCreateInfo* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkImage* pImage);
+    static void VKAPI_CALL DestroyImage(VkDevice device, VkImage image, const VkAllocationCallbacks* pAllocator);
+    static void VKAPI_CALL CmdCopyBuffer(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkBuffer dstBuffer, uint32_t regionCount, const VkBufferCopy* pRegions);
+#if VMA_DEDICATED_ALLOCATION
+    static void VKAPI_CALL GetBufferMemoryRequirements2KHR(VkDevice device, const VkBufferMemoryRequirementsInfo2KHR* pInfo, VkMemoryRequirements2KHR* pMemoryRequirements);
+    static void VKAPI_CALL GetImageMemoryRequirements2KHR(VkDevice device, const VkImageMemoryRequirementsInfo2KHR* pInfo, VkMemoryRequirements2KHR* pMemoryRequirements);
+#endif
+#if VMA_BIND_MEMORY2
+    static VkResult VKAPI_CALL BindBufferMemory2KHR(VkDevice device, uint32_t bindInfoCount, const VkBindBufferMemoryInfoKHR* pBindInfos);
+    static VkResult VKAPI_CALL BindImageMemory2KHR(VkDevice device, uint32_t bindInfoCount, const VkBindImageMemoryInfoKHR* pBindInfos);
+#endif
+};
+
+#endif
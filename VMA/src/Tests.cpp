@@ -23,10 +23,13 @@
 #include "Tests.h"
 #include "VmaUsage.h"
 #include "Common.h"
+#include "NullDevice.h"
+#include "VmaReplay/BinaryRecording.h"
 #include <atomic>
 #include <thread>
 #include <mutex>
 #include <functional>
+#include <unordered_map>
 
 #ifdef _WIN32
 
@@ -291,6 +294,55 @@ public:
     }
 };
 
+// Not null while BenchmarkNullDevice is running. Then g_hDevice is the null device.
+static const NullDevice* g_pNullDevice = nullptr;
+
+// Queries memory requirements using temporary buffer that is never bound to any memory.
+static void GetDummyBufferMemoryRequirements(const VkBufferCreateInfo& bufCreateInfo, VkMemoryRequirements& outMemReq)
+{
+    PFN_vkCreateBuffer pfnCreateBuffer = vkCreateBuffer;
+    PFN_vkGetBufferMemoryRequirements pfnGetBufferMemoryRequirements = vkGetBufferMemoryRequirements;
+    PFN_vkDestroyBuffer pfnDestroyBuffer = vkDestroyBuffer;
+    if(g_pNullDevice)
+    {
+        const VmaVulkanFunctions& funcs = g_pNullDevice->GetVulkanFunctions();
+        pfnCreateBuffer = funcs.vkCreateBuffer;
+        pfnGetBufferMemoryRequirements = funcs.vkGetBufferMemoryRequirements;
+        pfnDestroyBuffer = funcs.vkDestroyBuffer;
+    }
+
+    VkBuffer dummyBuffer = VK_NULL_HANDLE;
+    VkResult res = pfnCreateBuffer(g_hDevice, &bufCreateInfo, g_Allocs, &dummyBuffer);
+    TEST(res == VK_SUCCESS && dummyBuffer);
+
+    pfnGetBufferMemoryRequirements(g_hDevice, dummyBuffer, &outMemReq);
+
+    pfnDestroyBuffer(g_hDevice, dummyBuffer, g_Allocs);
+}
+
+// Queries memory requirements using temporary image that is never bound to any memory.
+static void GetDummyImageMemoryRequirements(const VkImageCreateInfo& imageCreateInfo, VkMemoryRequirements& outMemReq)
+{
+    PFN_vkCreateImage pfnCreateImage = vkCreateImage;
+    PFN_vkGetImageMemoryRequirements pfnGetImageMemoryRequirements = vkGetImageMemoryRequirements;
+    PFN_vkDestroyImage pfnDestroyImage = vkDestroyImage;
+    if(g_pNullDevice)
+    {
+        const VmaVulkanFunctions& funcs = g_pNullDevice->GetVulkanFunctions();
+        pfnCreateImage = funcs.vkCreateImage;
+        pfnGetImageMemoryRequirements = funcs.vkGetImageMemoryRequirements;
+        pfnDestroyImage = funcs.vkDestroyImage;
+    }
+
+    VkImage dummyImage = VK_NULL_HANDLE;
+    VkResult res = pfnCreateImage(g_hDevice, &imageCreateInfo, g_Allocs, &dummyImage);
+    TEST(res == VK_SUCCESS && dummyImage);
+
+    pfnGetImageMemoryRequirements(g_hDevice, dummyImage, &outMemReq);
+
+    pfnDestroyImage(g_hDevice, dummyImage, g_Allocs);
+}
+
 static void CurrentTimeToStr(std::string& out)
 {
     time_t rawTime; time(&rawTime);
@@ -1519,6 +1571,417 @@ void TestDefragmentationWholePool()
     TEST(defragStats[0].deviceMemoryBlocksFreed == defragStats[1].deviceMemoryBlocksFreed);
 }
 
+static void TestDefragmentationEstimate()
+{
+    wprintf(L"Test defragmentation estimate\n");
+
+    const VkDeviceSize BUF_SIZE = 0x10000;
+    const VkDeviceSize BLOCK_SIZE = BUF_SIZE * 8;
+
+    VkBufferCreateInfo bufCreateInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+    bufCreateInfo.size = BUF_SIZE;
+    bufCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+    VmaAllocationCreateInfo exampleAllocCreateInfo = {};
+    exampleAllocCreateInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+
+    uint32_t memTypeIndex = UINT32_MAX;
+    vmaFindMemoryTypeIndexForBufferInfo(g_hAllocator, &bufCreateInfo, &exampleAllocCreateInfo, &memTypeIndex);
+
+    VmaPoolCreateInfo poolCreateInfo = {};
+    poolCreateInfo.blockSize = BLOCK_SIZE;
+    poolCreateInfo.memoryTypeIndex = memTypeIndex;
+
+    VmaPool pool;
+    ERR_GUARD_VULKAN( vmaCreatePool(g_hAllocator, &poolCreateInfo, &pool) );
+
+    std::vector<AllocInfo> allocations;
+
+    // Fill 3 blocks. Remove odd buffers.
+    for(size_t i = 0; i < BLOCK_SIZE / BUF_SIZE * 3; ++i)
+    {
+        AllocInfo allocInfo;
+        CreateBuffer(pool, bufCreateInfo, false, allocInfo);
+        allocations.push_back(allocInfo);
+    }
+    for(size_t i = 1; i < allocations.size(); ++i)
+    {
+        DestroyAllocation(allocations[i]);
+        allocations.erase(allocations.begin() + i);
+    }
+
+    std::vector<VmaAllocationInfo> allocInfosBefore(allocations.size());
+    for(size_t i = 0; i < allocations.size(); ++i)
+    {
+        vmaGetAllocationInfo(g_hAllocator, allocations[i].m_Allocation, &allocInfosBefore[i]);
+    }
+
+    VmaDefragmentationInfo2 defragInfo = {};
+    defragInfo.poolCount = 1;
+    defragInfo.pPools = &pool;
+    defragInfo.maxCpuAllocationsToMove = UINT32_MAX;
+    defragInfo.maxCpuBytesToMove = VK_WHOLE_SIZE;
+
+    VmaDefragmentationEstimate estimate = {};
+    ERR_GUARD_VULKAN( vmaEstimateDefragmentation(g_hAllocator, &defragInfo, &estimate) );
+    TEST(estimate.allocationsMoved > 0 && estimate.bytesMoved > 0);
+    TEST(estimate.fragmentationAfter < estimate.fragmentationBefore);
+
+    // Estimation must not touch any allocation.
+    for(size_t i = 0; i < allocations.size(); ++i)
+    {
+        VmaAllocationInfo allocInfo;
+        vmaGetAllocationInfo(g_hAllocator, allocations[i].m_Allocation, &allocInfo);
+        TEST(allocInfo.deviceMemory == allocInfosBefore[i].deviceMemory);
+        TEST(allocInfo.offset == allocInfosBefore[i].offset);
+    }
+
+    VmaDefragmentationStats defragStats = {};
+    VmaDefragmentationContext defragCtx = VK_NULL_HANDLE;
+    VkResult res = vmaDefragmentationBegin(g_hAllocator, &defragInfo, &defragStats, &defragCtx);
+    TEST(res >= VK_SUCCESS);
+    vmaDefragmentationEnd(g_hAllocator, defragCtx);
+
+    // Estimate must predict the actual result exactly.
+    TEST(estimate.bytesMoved == defragStats.bytesMoved);
+    TEST(estimate.allocationsMoved == defragStats.allocationsMoved);
+    TEST(estimate.bytesFreed == defragStats.bytesFreed);
+    TEST(estimate.deviceMemoryBlocksFreed == defragStats.deviceMemoryBlocksFreed);
+
+    ValidateAllocationsData(allocations.data(), allocations.size());
+
+    DestroyAllAllocations(allocations);
+
+    vmaDestroyPool(g_hAllocator, pool);
+}
+
+// Counts regions passed to vkCmdCopyBuffer by TestDefragmentationCoalescing.
+static PFN_vkCmdCopyBuffer g_pfnOrigCmdCopyBuffer = nullptr;
+static uint32_t g_CmdCopyBufferRegionCount = 0;
+
+static void VKAPI_CALL CountingCmdCopyBuffer(
+    VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkBuffer dstBuffer, uint32_t regionCount, const VkBufferCopy* pRegions)
+{
+    g_CmdCopyBufferRegionCount += regionCount;
+    g_pfnOrigCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, regionCount, pRegions);
+}
+
+/*
+Moves of neighbouring allocations shifted by the same distance must be merged
+into one copy. Uses null device, so copy regions issued on the GPU path can be
+counted and data can be checked directly in host memory.
+*/
+static void TestDefragmentationCoalescing()
+{
+    wprintf(L"Test defragmentation coalescing\n");
+
+    const VkDeviceSize ALLOC_SIZE = 0x10000;
+    const size_t ALLOCS_PER_BLOCK = 16;
+
+    for(uint32_t gpu = 0; gpu < 2; ++gpu)
+    {
+        NullDeviceDesc nullDeviceDesc;
+        GetDefaultNullDeviceDesc(nullDeviceDesc);
+        NullDevice nullDevice(nullDeviceDesc);
+
+        VmaVulkanFunctions vulkanFunctions = nullDevice.GetVulkanFunctions();
+        g_pfnOrigCmdCopyBuffer = vulkanFunctions.vkCmdCopyBuffer;
+        vulkanFunctions.vkCmdCopyBuffer = CountingCmdCopyBuffer;
+        g_CmdCopyBufferRegionCount = 0;
+
+        VmaAllocatorCreateInfo allocatorInfo = {};
+        allocatorInfo.physicalDevice = nullDevice.GetPhysicalDevice();
+        allocatorInfo.device = nullDevice.GetDevice();
+        allocatorInfo.pVulkanFunctions = &vulkanFunctions;
+
+        VmaAllocator allocator = VK_NULL_HANDLE;
+        ERR_GUARD_VULKAN( vmaCreateAllocator(&allocatorInfo, &allocator) );
+
+        VmaAllocationCreateInfo allocCreateInfo = {};
+        allocCreateInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+
+        VmaPoolCreateInfo poolCreateInfo = {};
+        poolCreateInfo.blockSize = ALLOC_SIZE * ALLOCS_PER_BLOCK;
+        ERR_GUARD_VULKAN( vmaFindMemoryTypeIndex(allocator, UINT32_MAX, &allocCreateInfo, &poolCreateInfo.memoryTypeIndex) );
+
+        VmaPool pool = VK_NULL_HANDLE;
+        ERR_GUARD_VULKAN( vmaCreatePool(allocator, &poolCreateInfo, &pool) );
+        allocCreateInfo.pool = pool;
+
+        VkMemoryRequirements memReq = {};
+        memReq.size = ALLOC_SIZE;
+        memReq.alignment = 16;
+        memReq.memoryTypeBits = UINT32_MAX;
+
+        // Fill 2 blocks, each allocation with a different value.
+        std::vector<VmaAllocation> allocations(ALLOCS_PER_BLOCK * 2);
+        for(size_t i = 0; i < allocations.size(); ++i)
+        {
+            ERR_GUARD_VULKAN( vmaAllocateMemory(allocator, &memReq, &allocCreateInfo, &allocations[i], nullptr) );
+            void* pData = nullptr;
+            ERR_GUARD_VULKAN( vmaMapMemory(allocator, allocations[i], &pData) );
+            memset(pData, (int)i, (size_t)ALLOC_SIZE);
+            vmaUnmapMemory(allocator, allocations[i]);
+        }
+
+        // Free first half of each block, leaving one free range in front of the allocations that stay.
+        std::vector<uint8_t> values;
+        for(size_t i = 0; i < allocations.size(); ++i)
+        {
+            if(i % ALLOCS_PER_BLOCK < ALLOCS_PER_BLOCK / 2)
+            {
+                vmaFreeMemory(allocator, allocations[i]);
+            }
+            else
+            {
+                allocations[values.size()] = allocations[i];
+                values.push_back((uint8_t)i);
+            }
+        }
+        allocations.resize(values.size());
+
+        VmaDefragmentationInfo2 defragInfo = {};
+        defragInfo.poolCount = 1;
+        defragInfo.pPools = &pool;
+        if(gpu)
+        {
+            defragInfo.maxGpuAllocationsToMove = UINT32_MAX;
+            defragInfo.maxGpuBytesToMove = VK_WHOLE_SIZE;
+            defragInfo.commandBuffer = nullDevice.GetCommandBuffer();
+        }
+        else
+        {
+            defragInfo.maxCpuAllocationsToMove = UINT32_MAX;
+            defragInfo.maxCpuBytesToMove = VK_WHOLE_SIZE;
+        }
+
+        VmaDefragmentationStats defragStats = {};
+        VmaDefragmentationContext defragCtx = VK_NULL_HANDLE;
+        VkResult res = vmaDefragmentationBegin(allocator, &defragInfo, &defragStats, &defragCtx);
+        TEST(res >= VK_SUCCESS);
+        vmaDefragmentationEnd(allocator, defragCtx);
+
+        // All allocations fit in one block.
+        // Second half of the last block moves to the free first half of the first block.
+        TEST(defragStats.deviceMemoryBlocksFreed == 1);
+        TEST(defragStats.allocationsMoved == ALLOCS_PER_BLOCK / 2);
+        if(gpu)
+        {
+            // All of them are contiguous, so they are copied as one region.
+            TEST(g_CmdCopyBufferRegionCount == 1);
+        }
+
+        // Data follows the allocations and they don't overlap.
+        std::vector<VmaAllocationInfo> allocInfos(allocations.size());
+        for(size_t i = 0; i < allocations.size(); ++i)
+        {
+            vmaGetAllocationInfo(allocator, allocations[i], &allocInfos[i]);
+            TEST(allocInfos[i].deviceMemory == allocInfos[0].deviceMemory);
+            for(size_t j = 0; j < i; ++j)
+            {
+                TEST(allocInfos[i].offset + allocInfos[i].size <= allocInfos[j].offset ||
+                    allocInfos[j].offset + allocInfos[j].size <= allocInfos[i].offset);
+            }
+
+            void* pData = nullptr;
+            ERR_GUARD_VULKAN( vmaMapMemory(allocator, allocations[i], &pData) );
+            const uint8_t* const pBytes = (const uint8_t*)pData;
+            for(VkDeviceSize j = 0; j < ALLOC_SIZE; ++j)
+            {
+                TEST(pBytes[j] == values[i]);
+            }
+            vmaUnmapMemory(allocator, allocations[i]);
+        }
+
+        for(size_t i = 0; i < allocations.size(); ++i)
+        {
+            vmaFreeMemory(allocator, allocations[i]);
+        }
+        vmaDestroyPool(allocator, pool);
+        vmaDestroyAllocator(allocator);
+    }
+}
+
+static void TestDefragmentationLinearAndBuddy()
+{
+    wprintf(L"Test defragmentation of linear and buddy pools\n");
+
+    const VkDeviceSize BUF_SIZE = 0x10000;
+    const VkDeviceSize BLOCK_SIZE = BUF_SIZE * 8;
+
+    VkBufferCreateInfo bufCreateInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+    bufCreateInfo.size = BUF_SIZE;
+    bufCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+    VmaAllocationCreateInfo exampleAllocCreateInfo = {};
+    exampleAllocCreateInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+
+    uint32_t memTypeIndex = UINT32_MAX;
+    vmaFindMemoryTypeIndexForBufferInfo(g_hAllocator, &bufCreateInfo, &exampleAllocCreateInfo, &memTypeIndex);
+
+    const VmaPoolCreateFlags algorithms[] = {
+        VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT,
+        VMA_POOL_CREATE_BUDDY_ALGORITHM_BIT,
+    };
+    for(size_t algorithmIndex = 0; algorithmIndex < _countof(algorithms); ++algorithmIndex)
+    {
+        VmaPoolCreateInfo poolCreateInfo = {};
+        poolCreateInfo.blockSize = BLOCK_SIZE;
+        poolCreateInfo.memoryTypeIndex = memTypeIndex;
+        poolCreateInfo.flags = algorithms[algorithmIndex];
+
+        VmaPool pool;
+        ERR_GUARD_VULKAN( vmaCreatePool(g_hAllocator, &poolCreateInfo, &pool) );
+
+        std::vector<AllocInfo> allocations;
+
+        // Fill 3 blocks. Remove odd buffers.
+        for(size_t i = 0; i < BLOCK_SIZE / BUF_SIZE * 3; ++i)
+        {
+            AllocInfo allocInfo;
+            CreateBuffer(pool, bufCreateInfo, false, allocInfo);
+            allocations.push_back(allocInfo);
+        }
+        for(size_t i = 1; i < allocations.size(); ++i)
+        {
+            DestroyAllocation(allocations[i]);
+            allocations.erase(allocations.begin() + i);
+        }
+
+        VmaDefragmentationInfo2 defragInfo = {};
+        defragInfo.poolCount = 1;
+        defragInfo.pPools = &pool;
+        defragInfo.maxCpuAllocationsToMove = UINT32_MAX;
+        defragInfo.maxCpuBytesToMove = VK_WHOLE_SIZE;
+
+        VmaDefragmentationEstimate estimate = {};
+        ERR_GUARD_VULKAN( vmaEstimateDefragmentation(g_hAllocator, &defragInfo, &estimate) );
+
+        VmaDefragmentationStats defragStats = {};
+        VmaDefragmentationContext defragCtx = VK_NULL_HANDLE;
+        VkResult res = vmaDefragmentationBegin(g_hAllocator, &defragInfo, &defragStats, &defragCtx);
+        TEST(res >= VK_SUCCESS);
+        vmaDefragmentationEnd(g_hAllocator, defragCtx);
+
+        // 12 remaining buffers fit in 2 blocks.
+        TEST(defragStats.allocationsMoved > 0 && defragStats.bytesMoved > 0);
+        TEST(defragStats.deviceMemoryBlocksFreed == 1);
+        TEST(estimate.bytesMoved == defragStats.bytesMoved);
+        TEST(estimate.allocationsMoved == defragStats.allocationsMoved);
+        TEST(estimate.deviceMemoryBlocksFreed == defragStats.deviceMemoryBlocksFreed);
+
+        VmaPoolStats poolStats = {};
+        vmaGetPoolStats(g_hAllocator, pool, &poolStats);
+        TEST(poolStats.blockCount == 2);
+
+        ValidateAllocationsData(allocations.data(), allocations.size());
+
+        DestroyAllAllocations(allocations);
+
+        vmaDestroyPool(g_hAllocator, pool);
+    }
+}
+
+static void VKAPI_PTR AutoDefragmentationAllocationsMoved(
+    VmaAllocator allocator,
+    VmaPool pool,
+    uint32_t allocationCount,
+    const VmaAllocation* pAllocations,
+    void* pUserData)
+{
+    std::vector<AllocInfo>& allocations = *(std::vector<AllocInfo>*)pUserData;
+    for(uint32_t i = 0; i < allocationCount; ++i)
+    {
+        auto it = std::find_if(allocations.begin(), allocations.end(), [&](const AllocInfo& allocInfo) {
+            return allocInfo.m_Allocation == pAllocations[i];
+        });
+        TEST(it != allocations.end());
+        RecreateAllocationResource(*it);
+    }
+}
+
+static void TestAutoDefragmentation()
+{
+    wprintf(L"Test automatic defragmentation\n");
+
+    const VkDeviceSize BUF_SIZE = 0x10000;
+    const VkDeviceSize BLOCK_SIZE = BUF_SIZE * 8;
+
+    VkBufferCreateInfo bufCreateInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+    bufCreateInfo.size = BUF_SIZE;
+    bufCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+    VmaAllocationCreateInfo exampleAllocCreateInfo = {};
+    exampleAllocCreateInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+
+    uint32_t memTypeIndex = UINT32_MAX;
+    vmaFindMemoryTypeIndexForBufferInfo(g_hAllocator, &bufCreateInfo, &exampleAllocCreateInfo, &memTypeIndex);
+
+    VmaPoolCreateInfo poolCreateInfo = {};
+    poolCreateInfo.blockSize = BLOCK_SIZE;
+    poolCreateInfo.memoryTypeIndex = memTypeIndex;
+
+    VmaPool pool;
+    ERR_GUARD_VULKAN( vmaCreatePool(g_hAllocator, &poolCreateInfo, &pool) );
+
+    VmaFragmentationScore score = {};
+    vmaGetPoolFragmentationScore(g_hAllocator, pool, &score);
+    TEST(score.fragmentation == 0.f && score.unusedBytes == 0 && score.blockCount == 0);
+
+    std::vector<AllocInfo> allocations;
+
+    // Fill 3 blocks. Remove odd buffers.
+    for(size_t i = 0; i < BLOCK_SIZE / BUF_SIZE * 3; ++i)
+    {
+        AllocInfo allocInfo;
+        CreateBuffer(pool, bufCreateInfo, false, allocInfo);
+        allocations.push_back(allocInfo);
+    }
+    vmaGetPoolFragmentationScore(g_hAllocator, pool, &score);
+    TEST(score.fragmentation == 0.f && score.unusedBytes == 0 && score.blockCount == 3);
+
+    for(size_t i = 1; i < allocations.size(); ++i)
+    {
+        DestroyAllocation(allocations[i]);
+        allocations.erase(allocations.begin() + i);
+    }
+
+    // Each block is half-full, with free space scattered in ranges of single buffers.
+    vmaGetPoolFragmentationScore(g_hAllocator, pool, &score);
+    TEST(score.unusedBytes == BUF_SIZE * 12 && score.unusedRangeSizeMax == BUF_SIZE);
+    TEST(score.fragmentation > 0.9f);
+    TEST(score.blockUtilizationSpread < 0.01f);
+
+    VmaAutoDefragmentationPolicy policy = {};
+    policy.fragmentationThreshold = 0.5f;
+    policy.frameCount = 2;
+    policy.maxBytesToMove = VK_WHOLE_SIZE;
+    policy.maxAllocationsToMove = UINT32_MAX;
+    policy.pfnAllocationsMoved = AutoDefragmentationAllocationsMoved;
+    policy.pUserData = &allocations;
+    vmaSetPoolAutoDefragmentationPolicy(g_hAllocator, pool, &policy);
+
+    // Nothing happens until the score stays too high for 2 frames.
+    uint32_t frameIndex = 1;
+    vmaSetCurrentFrameIndex(g_hAllocator, frameIndex++);
+    vmaGetPoolFragmentationScore(g_hAllocator, pool, &score);
+    TEST(score.blockCount == 3);
+
+    vmaSetCurrentFrameIndex(g_hAllocator, frameIndex++);
+    vmaGetPoolFragmentationScore(g_hAllocator, pool, &score);
+    // 12 remaining buffers fit in 2 blocks.
+    TEST(score.blockCount == 2);
+    TEST(score.fragmentation == 0.f);
+
+    ValidateAllocationsData(allocations.data(), allocations.size());
+
+    vmaSetPoolAutoDefragmentationPolicy(g_hAllocator, pool, nullptr);
+
+    DestroyAllAllocations(allocations);
+
+    vmaDestroyPool(g_hAllocator, pool);
+}
+
 void TestDefragmentationFull()
 {
     std::vector<AllocInfo> allocations;
@@ -1929,22 +2392,942 @@ static void TestMemoryRequirements()
 
 }
 
-static void TestBasics()
+static void VKAPI_PTR AppendStatsToString(void* pUserData, const char* pData, size_t size)
 {
-    VkResult res;
+    std::string* const str = (std::string*)pUserData;
+    str->append(pData, size);
+}
 
-    TestMemoryRequirements();
+static void TestStatsSink()
+{
+    wprintf(L"Test stats sink\n");
 
-    // Lost allocation
-    {
-        VmaAllocation alloc = VK_NULL_HANDLE;
-        vmaCreateLostAllocation(g_hAllocator, &alloc);
-        TEST(alloc != VK_NULL_HANDLE);
+    // Some allocations to make the detailed map non-trivial.
+    VkBufferCreateInfo bufCreateInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+    bufCreateInfo.size = 0x10000;
+    bufCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
 
-        VmaAllocationInfo allocInfo;
-        vmaGetAllocationInfo(g_hAllocator, alloc, &allocInfo);
-        TEST(allocInfo.deviceMemory == VK_NULL_HANDLE);
-        TEST(allocInfo.size == 0);
+    VmaAllocationCreateInfo allocCreateInfo = {};
+    allocCreateInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+    allocCreateInfo.flags = VMA_ALLOCATION_CREATE_USER_DATA_COPY_STRING_BIT;
+    allocCreateInfo.pUserData = (void*)"Name with \"quotes\" and \\ backslash";
+
+    std::vector<BufferInfo> bufInfo(16);
+    for(size_t i = 0; i < bufInfo.size(); ++i)
+    {
+        VkResult res = vmaCreateBuffer(g_hAllocator, &bufCreateInfo, &allocCreateInfo,
+            &bufInfo[i].Buffer, &bufInfo[i].Allocation, nullptr);
+        TEST(res == VK_SUCCESS);
+    }
+
+    char* statsStr = nullptr;
+    vmaBuildStatsString(g_hAllocator, &statsStr, VK_TRUE);
+
+    const size_t chunkSizes[] = { 1, 7, 0 };
+    for(size_t i = 0; i < _countof(chunkSizes); ++i)
+    {
+        std::string streamedStr;
+        VmaStatsSink sink = {};
+        sink.pfnWrite = AppendStatsToString;
+        sink.pUserData = &streamedStr;
+        sink.chunkSize = chunkSizes[i];
+        VkResult res = vmaWriteStatsToSink(g_hAllocator, &sink, VK_TRUE);
+        TEST(res == VK_SUCCESS);
+        TEST(streamedStr == statsStr);
+    }
+
+    vmaFreeStatsString(g_hAllocator, statsStr);
+
+    // Binary format. Check its structure, as described in "docs/Binary stats file format.md".
+    {
+        std::string binaryStr;
+        VmaStatsSink sink = {};
+        sink.pfnWrite = AppendStatsToString;
+        sink.pUserData = &binaryStr;
+        VkResult res = vmaWriteBinaryStats(g_hAllocator, &sink);
+        TEST(res == VK_SUCCESS);
+
+        const char* const data = binaryStr.data();
+        TEST(binaryStr.size() >= 32 + 16);
+        TEST(memcmp(data, "VMASTATS", 8) == 0);
+        uint32_t header[6];
+        memcpy(header, data + 8, sizeof(header));
+        const uint32_t headerSize = header[1], recordSize = header[2];
+        const uint32_t heapCount = header[3], typeCount = header[4];
+        TEST(header[0] == 1 && headerSize == 32 && recordSize == 40);
+
+        uint64_t trailer[2];
+        memcpy(trailer, data + binaryStr.size() - sizeof(trailer), sizeof(trailer));
+        const size_t recordsOffset = headerSize + heapCount * 16 + typeCount * 8 + (1 + heapCount + typeCount) * 80;
+        TEST(recordsOffset + trailer[0] * recordSize + trailer[1] + sizeof(trailer) == binaryStr.size());
+
+        // Each buffer has its name in the string table.
+        size_t nameCount = 0;
+        for(size_t i = 0; i < trailer[1]; ++i)
+        {
+            if(data[recordsOffset + trailer[0] * recordSize + i] == '\0')
+            {
+                ++nameCount;
+            }
+        }
+        TEST(nameCount >= bufInfo.size());
+
+        // tools/VmaDumpVis/TestVmaBinaryStatsToJson.py checks that these convert to the same JSON.
+        SaveFile(L"StatsSink.bin", binaryStr.data(), binaryStr.size());
+        SaveAllocatorStatsToFile(L"StatsSink.json");
+    }
+
+    for(size_t i = bufInfo.size(); i--; )
+    {
+        vmaDestroyBuffer(g_hAllocator, bufInfo[i].Buffer, bufInfo[i].Allocation);
+    }
+}
+
+#if VMA_COUNTERS_ENABLED
+static void TestCounters()
+{
+    wprintf(L"Test counters\n");
+
+    VmaCounters countersBegin = {};
+    vmaGetCounters(g_hAllocator, &countersBegin);
+
+    VkBufferCreateInfo bufCreateInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+    bufCreateInfo.size = 0x1000;
+    bufCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+    VmaAllocationCreateInfo allocCreateInfo = {};
+    allocCreateInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+
+    std::vector<BufferInfo> bufInfo(8);
+    VkDeviceSize totalSize = 0;
+    for(size_t i = 0; i < bufInfo.size(); ++i)
+    {
+        if(i == bufInfo.size() - 1)
+        {
+            allocCreateInfo.flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+        }
+        VmaAllocationInfo allocInfo;
+        VkResult res = vmaCreateBuffer(g_hAllocator, &bufCreateInfo, &allocCreateInfo,
+            &bufInfo[i].Buffer, &bufInfo[i].Allocation, &allocInfo);
+        TEST(res == VK_SUCCESS);
+        totalSize += allocInfo.size;
+    }
+
+    void* pData = nullptr;
+    VkResult res = vmaMapMemory(g_hAllocator, bufInfo[0].Allocation, &pData);
+    TEST(res == VK_SUCCESS);
+    vmaFlushAllocation(g_hAllocator, bufInfo[0].Allocation, 0, VK_WHOLE_SIZE);
+    vmaUnmapMemory(g_hAllocator, bufInfo[0].Allocation);
+
+    // Allocation that must fail.
+    VmaAllocationCreateInfo failingCreateInfo = {};
+    failingCreateInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+    failingCreateInfo.flags = VMA_ALLOCATION_CREATE_NEVER_ALLOCATE_BIT;
+    VkMemoryRequirements memReq = { VK_WHOLE_SIZE / 2, 1, UINT32_MAX };
+    VmaAllocation failedAlloc = VK_NULL_HANDLE;
+    res = vmaAllocateMemory(g_hAllocator, &memReq, &failingCreateInfo, &failedAlloc, nullptr);
+    TEST(res < 0 && failedAlloc == VK_NULL_HANDLE);
+
+    for(size_t i = bufInfo.size(); i--; )
+    {
+        vmaDestroyBuffer(g_hAllocator, bufInfo[i].Buffer, bufInfo[i].Allocation);
+    }
+
+    VmaCounters countersEnd = {};
+    vmaGetCounters(g_hAllocator, &countersEnd);
+
+    TEST(countersEnd.allocationCount - countersBegin.allocationCount == bufInfo.size() + 1);
+    TEST(countersEnd.allocationFailureCount - countersBegin.allocationFailureCount == 1);
+    TEST(countersEnd.allocationBytes - countersBegin.allocationBytes == totalSize);
+    TEST(countersEnd.freeCount - countersBegin.freeCount == bufInfo.size());
+    TEST(countersEnd.freeBytes - countersBegin.freeBytes == totalSize);
+    TEST(countersEnd.dedicatedAllocationCount - countersBegin.dedicatedAllocationCount == 1);
+    TEST(countersEnd.mapCount - countersBegin.mapCount == 1);
+    TEST(countersEnd.unmapCount - countersBegin.unmapCount == 1);
+    TEST(countersEnd.flushCount - countersBegin.flushCount == 1);
+
+    // More threads than counter shards, so that some of them share one, and shards are reused after threads exit.
+    const uint32_t threadCount = 40;
+    const uint32_t allocationsPerThread = 100;
+    for(uint32_t round = 0; round < 2; ++round)
+    {
+        countersBegin = countersEnd;
+
+        allocCreateInfo.flags = 0;
+        std::vector<std::thread> threads;
+        for(uint32_t threadIndex = 0; threadIndex < threadCount; ++threadIndex)
+        {
+            threads.push_back(std::thread([&]() {
+                for(uint32_t i = 0; i < allocationsPerThread; ++i)
+                {
+                    VkBuffer buf = VK_NULL_HANDLE;
+                    VmaAllocation alloc = VK_NULL_HANDLE;
+                    VkResult threadRes = vmaCreateBuffer(g_hAllocator, &bufCreateInfo, &allocCreateInfo, &buf, &alloc, nullptr);
+                    TEST(threadRes == VK_SUCCESS);
+                    vmaDestroyBuffer(g_hAllocator, buf, alloc);
+                }
+            }));
+        }
+        for(size_t i = 0; i < threads.size(); ++i)
+        {
+            threads[i].join();
+        }
+
+        vmaGetCounters(g_hAllocator, &countersEnd);
+        TEST(countersEnd.allocationCount - countersBegin.allocationCount == threadCount * allocationsPerThread);
+        TEST(countersEnd.freeCount - countersBegin.freeCount == threadCount * allocationsPerThread);
+        TEST(countersEnd.freeBytes - countersBegin.freeBytes == countersEnd.allocationBytes - countersBegin.allocationBytes);
+    }
+}
+#endif // #if VMA_COUNTERS_ENABLED
+
+static void TestAllocationHistograms()
+{
+    wprintf(L"Test allocation histograms\n");
+
+    VkBufferCreateInfo sampleBufCreateInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+    sampleBufCreateInfo.size = 0x1000; // Whatever.
+    sampleBufCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+    VmaAllocationCreateInfo sampleAllocCreateInfo = {};
+    sampleAllocCreateInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+
+    VmaPoolCreateInfo poolCreateInfo = {};
+    VkResult res = vmaFindMemoryTypeIndexForBufferInfo(g_hAllocator, &sampleBufCreateInfo, &sampleAllocCreateInfo, &poolCreateInfo.memoryTypeIndex);
+    TEST(res == VK_SUCCESS);
+    poolCreateInfo.blockSize = 0x100000;
+
+    VmaPool pool = VK_NULL_HANDLE;
+    res = vmaCreatePool(g_hAllocator, &poolCreateInfo, &pool);
+    TEST(res == VK_SUCCESS);
+
+    VmaAllocationHistograms histograms;
+    vmaGetPoolAllocationHistograms(g_hAllocator, pool, &histograms);
+    for(uint32_t i = 0; i < VMA_SIZE_HISTOGRAM_BUCKET_COUNT; ++i)
+    {
+        TEST(histograms.allocationSize[i] == 0);
+    }
+    for(uint32_t i = 0; i < VMA_LIFETIME_HISTOGRAM_BUCKET_COUNT; ++i)
+    {
+        TEST(histograms.allocationLifetime[i] == 0);
+    }
+
+    VmaAllocationCreateInfo allocCreateInfo = {};
+    allocCreateInfo.pool = pool;
+
+    // 3 allocations of 4 KB and 2 allocations of 64 KB.
+    const VkDeviceSize sizes[] = { 0x1000, 0x1000, 0x1000, 0x10000, 0x10000 };
+    const size_t allocCount = sizeof(sizes) / sizeof(sizes[0]);
+    VmaAllocation allocs[allocCount] = {};
+    vmaSetCurrentFrameIndex(g_hAllocator, ++g_FrameIndex);
+    for(size_t i = 0; i < allocCount; ++i)
+    {
+        VkMemoryRequirements memReq = { sizes[i], 0x100, UINT32_MAX };
+        res = vmaAllocateMemory(g_hAllocator, &memReq, &allocCreateInfo, &allocs[i], nullptr);
+        TEST(res == VK_SUCCESS);
+    }
+
+    // 2 freed in the same frame, 3 freed 3 frames later.
+    vmaFreeMemory(g_hAllocator, allocs[0]);
+    vmaFreeMemory(g_hAllocator, allocs[3]);
+    g_FrameIndex += 3;
+    vmaSetCurrentFrameIndex(g_hAllocator, g_FrameIndex);
+    vmaFreeMemory(g_hAllocator, allocs[1]);
+    vmaFreeMemory(g_hAllocator, allocs[2]);
+    vmaFreeMemory(g_hAllocator, allocs[4]);
+
+    vmaGetPoolAllocationHistograms(g_hAllocator, pool, &histograms);
+    for(uint32_t i = 0; i < VMA_SIZE_HISTOGRAM_BUCKET_COUNT; ++i)
+    {
+        const uint64_t expected = i == 12 ? 3 : (i == 16 ? 2 : 0);
+        TEST(histograms.allocationSize[i] == expected);
+    }
+    for(uint32_t i = 0; i < VMA_LIFETIME_HISTOGRAM_BUCKET_COUNT; ++i)
+    {
+        // Lifetime of 3 frames falls into bucket [2, 4).
+        const uint64_t expected = i == 0 ? 2 : (i == 2 ? 3 : 0);
+        TEST(histograms.allocationLifetime[i] == expected);
+    }
+
+    vmaDestroyPool(g_hAllocator, pool);
+}
+
+// Simple task system for vmaCalculateStatsParallel(), running tasks on a few threads.
+static void VKAPI_PTR RunTasksOnThreads(void* pUserData, PFN_vmaTaskFunction pfnTask, void* pTaskData, uint32_t taskCount)
+{
+    std::atomic<uint32_t>* const pRunCount = (std::atomic<uint32_t>*)pUserData;
+    ++*pRunCount;
+
+    std::atomic<uint32_t> nextTaskIndex = 0;
+    auto threadProc = [&]()
+    {
+        for(uint32_t taskIndex = nextTaskIndex++; taskIndex < taskCount; taskIndex = nextTaskIndex++)
+        {
+            pfnTask(pTaskData, taskIndex);
+        }
+    };
+    std::vector<std::thread> threads;
+    for(uint32_t i = 0; i < 3; ++i)
+    {
+        threads.emplace_back(threadProc);
+    }
+    threadProc();
+    for(size_t i = 0; i < threads.size(); ++i)
+    {
+        threads[i].join();
+    }
+}
+
+static void TestCalculateStatsParallel()
+{
+    wprintf(L"Test calculate stats parallel\n");
+
+    RandomNumberGenerator rand{2137};
+
+    VkBufferCreateInfo sampleBufCreateInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+    sampleBufCreateInfo.size = 0x1000; // Whatever.
+    sampleBufCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+    VmaAllocationCreateInfo sampleAllocCreateInfo = {};
+    sampleAllocCreateInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+
+    VmaPoolCreateInfo poolCreateInfo = {};
+    VkResult res = vmaFindMemoryTypeIndexForBufferInfo(g_hAllocator, &sampleBufCreateInfo, &sampleAllocCreateInfo, &poolCreateInfo.memoryTypeIndex);
+    TEST(res == VK_SUCCESS);
+    poolCreateInfo.blockSize = 0x10000;
+
+    // Many small pools, which is the case vmaCalculateStatsParallel() is made for.
+    std::vector<VmaPool> pools(64);
+    std::vector<VmaAllocation> allocs;
+    for(size_t poolIndex = 0; poolIndex < pools.size(); ++poolIndex)
+    {
+        poolCreateInfo.flags = poolIndex % 2 ? VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT : 0;
+        res = vmaCreatePool(g_hAllocator, &poolCreateInfo, &pools[poolIndex]);
+        TEST(res == VK_SUCCESS);
+
+        VmaAllocationCreateInfo allocCreateInfo = {};
+        allocCreateInfo.pool = pools[poolIndex];
+        for(uint32_t i = 0; i < 16; ++i)
+        {
+            VkMemoryRequirements memReq = { 0x100 * (1 + rand.Generate() % 16), 0x100, UINT32_MAX };
+            VmaAllocation alloc = VK_NULL_HANDLE;
+            res = vmaAllocateMemory(g_hAllocator, &memReq, &allocCreateInfo, &alloc, nullptr);
+            TEST(res == VK_SUCCESS);
+            allocs.push_back(alloc);
+        }
+    }
+
+    VmaStats stats = {};
+    vmaCalculateStats(g_hAllocator, &stats);
+
+    // Using threads of the library.
+    VmaStats parallelStats = {};
+    vmaCalculateStatsParallel(g_hAllocator, nullptr, &parallelStats);
+    TEST(memcmp(&stats, &parallelStats, sizeof(stats)) == 0);
+
+    // Using custom task system.
+    std::atomic<uint32_t> runCount = 0;
+    VmaTaskSystem taskSystem = {};
+    taskSystem.pfnRunTasks = RunTasksOnThreads;
+    taskSystem.pUserData = &runCount;
+    memset(&parallelStats, 0, sizeof(parallelStats));
+    vmaCalculateStatsParallel(g_hAllocator, &taskSystem, &parallelStats);
+    TEST(runCount == 1);
+    TEST(memcmp(&stats, &parallelStats, sizeof(stats)) == 0);
+
+    for(size_t i = allocs.size(); i--; )
+    {
+        vmaFreeMemory(g_hAllocator, allocs[i]);
+    }
+    for(size_t i = pools.size(); i--; )
+    {
+        vmaDestroyPool(g_hAllocator, pools[i]);
+    }
+}
+
+static void TestStatsSnapshots()
+{
+    wprintf(L"Test stats snapshots\n");
+
+    VkBufferCreateInfo bufCreateInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+    bufCreateInfo.size = 0x1000;
+    bufCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+    VmaAllocationCreateInfo allocCreateInfo = {};
+    allocCreateInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+
+    VmaPoolCreateInfo poolCreateInfo = {};
+    VkResult res = vmaFindMemoryTypeIndexForBufferInfo(g_hAllocator, &bufCreateInfo, &allocCreateInfo, &poolCreateInfo.memoryTypeIndex);
+    TEST(res == VK_SUCCESS);
+    poolCreateInfo.blockSize = 0x10000;
+
+    VmaStatsSnapshot snapshotBegin = VK_NULL_HANDLE;
+    res = vmaCreateStatsSnapshot(g_hAllocator, VMA_STATS_SNAPSHOT_CREATE_ALLOCATIONS_BIT, &snapshotBegin);
+    TEST(res == VK_SUCCESS);
+
+    VmaPool pool = VK_NULL_HANDLE;
+    res = vmaCreatePool(g_hAllocator, &poolCreateInfo, &pool);
+    TEST(res == VK_SUCCESS);
+
+    // 16 allocations in the custom pool, one dedicated.
+    std::vector<BufferInfo> bufInfo(17);
+    VkDeviceSize dedicatedSize = 0;
+    for(size_t i = 0; i < bufInfo.size(); ++i)
+    {
+        VmaAllocationCreateInfo bufAllocCreateInfo = allocCreateInfo;
+        if(i < bufInfo.size() - 1)
+        {
+            bufAllocCreateInfo.pool = pool;
+        }
+        else
+        {
+            bufAllocCreateInfo.flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+        }
+        VmaAllocationInfo allocInfo;
+        res = vmaCreateBuffer(g_hAllocator, &bufCreateInfo, &bufAllocCreateInfo,
+            &bufInfo[i].Buffer, &bufInfo[i].Allocation, &allocInfo);
+        TEST(res == VK_SUCCESS);
+        if(bufAllocCreateInfo.pool == VK_NULL_HANDLE)
+        {
+            dedicatedSize = allocInfo.size;
+        }
+    }
+
+    VmaStatsSnapshot snapshotMiddle = VK_NULL_HANDLE;
+    res = vmaCreateStatsSnapshot(g_hAllocator, VMA_STATS_SNAPSHOT_CREATE_ALLOCATIONS_BIT, &snapshotMiddle);
+    TEST(res == VK_SUCCESS);
+
+    VmaStatsSnapshotDiff diff = {};
+    res = vmaCompareStatsSnapshots(g_hAllocator, snapshotBegin, snapshotMiddle, &diff);
+    TEST(res == VK_SUCCESS);
+    TEST(diff.total.allocationCount == (int64_t)bufInfo.size());
+    TEST(diff.memoryType[poolCreateInfo.memoryTypeIndex].allocationCount == (int64_t)bufInfo.size());
+    TEST(diff.removedAllocationCount == 0);
+    TEST(diff.destroyedBlockCount == 0);
+    TEST(diff.createdBlockCount >= 1);
+    TEST(diff.changedBlockCount == 0);
+    TEST(diff.addedAllocationCount == bufInfo.size());
+    for(size_t i = 0; i < bufInfo.size(); ++i)
+    {
+        bool found = false;
+        for(size_t j = 0; !found && j < diff.addedAllocationCount; ++j)
+        {
+            found = diff.pAddedAllocations[j].allocation == bufInfo[i].Allocation;
+        }
+        TEST(found);
+    }
+    // Only the new custom pool has changed.
+    TEST(diff.poolCount == 1);
+    TEST(diff.pPools[0].isCustomPool && diff.pPools[0].memoryTypeIndex == poolCreateInfo.memoryTypeIndex);
+    TEST(diff.pPools[0].delta.allocationCount == (int64_t)bufInfo.size() - 1);
+    TEST(diff.pPools[0].delta.blockCount == (int64_t)diff.createdBlockCount);
+    TEST(diff.total.usedBytes - diff.pPools[0].delta.usedBytes == (int64_t)dedicatedSize);
+    const uint32_t poolId = diff.pPools[0].poolId;
+    for(uint32_t i = 0; i < diff.createdBlockCount; ++i)
+    {
+        TEST(diff.pCreatedBlocks[i].isCustomPool && diff.pCreatedBlocks[i].poolId == poolId);
+    }
+    vmaFreeStatsSnapshotDiff(g_hAllocator, &diff);
+    TEST(diff.pPools == nullptr && diff.pAddedAllocations == nullptr);
+
+    // Free every other allocation from the pool. Its blocks stay, but their contents change.
+    VmaStatsSnapshot snapshotFreed = VK_NULL_HANDLE;
+    {
+        size_t freedCount = 0;
+        for(size_t i = 0; i < bufInfo.size() - 1; i += 2)
+        {
+            vmaDestroyBuffer(g_hAllocator, bufInfo[i].Buffer, bufInfo[i].Allocation);
+            bufInfo[i] = BufferInfo();
+            ++freedCount;
+        }
+
+        res = vmaCreateStatsSnapshot(g_hAllocator, VMA_STATS_SNAPSHOT_CREATE_ALLOCATIONS_BIT, &snapshotFreed);
+        TEST(res == VK_SUCCESS);
+        res = vmaCompareStatsSnapshots(g_hAllocator, snapshotMiddle, snapshotFreed, &diff);
+        TEST(res == VK_SUCCESS);
+        TEST(diff.createdBlockCount == 0 && diff.destroyedBlockCount == 0);
+        TEST(diff.changedBlockCount >= 1);
+        for(uint32_t i = 0; i < diff.changedBlockCount; ++i)
+        {
+            TEST(diff.pChangedBlocks[i].isCustomPool && diff.pChangedBlocks[i].poolId == poolId);
+        }
+        TEST(diff.removedAllocationCount == freedCount && diff.addedAllocationCount == 0);
+        vmaFreeStatsSnapshotDiff(g_hAllocator, &diff);
+        TEST(diff.pChangedBlocks == nullptr);
+
+        // Comparing snapshot with itself reports no changes.
+        res = vmaCompareStatsSnapshots(g_hAllocator, snapshotFreed, snapshotFreed, &diff);
+        TEST(res == VK_SUCCESS);
+        TEST(diff.changedBlockCount == 0 && diff.addedAllocationCount == 0 && diff.removedAllocationCount == 0);
+        vmaFreeStatsSnapshotDiff(g_hAllocator, &diff);
+    }
+
+    for(size_t i = bufInfo.size(); i--; )
+    {
+        vmaDestroyBuffer(g_hAllocator, bufInfo[i].Buffer, bufInfo[i].Allocation);
+    }
+    vmaDestroyPool(g_hAllocator, pool);
+
+    // Snapshot without allocations.
+    VmaStatsSnapshot snapshotEnd = VK_NULL_HANDLE;
+    res = vmaCreateStatsSnapshot(g_hAllocator, 0, &snapshotEnd);
+    TEST(res == VK_SUCCESS);
+
+    res = vmaCompareStatsSnapshots(g_hAllocator, snapshotMiddle, snapshotEnd, &diff);
+    TEST(res == VK_SUCCESS);
+    TEST(diff.total.allocationCount == -(int64_t)bufInfo.size());
+    TEST(diff.poolCount == 1 && diff.pPools[0].poolId == poolId);
+    TEST(diff.pPools[0].delta.blockCount < 0);
+    TEST(diff.addedAllocationCount == 0 && diff.removedAllocationCount == 0);
+    vmaFreeStatsSnapshotDiff(g_hAllocator, &diff);
+
+    res = vmaCompareStatsSnapshots(g_hAllocator, snapshotBegin, snapshotEnd, &diff);
+    TEST(res == VK_SUCCESS);
+    TEST(diff.total.allocationCount == 0 && diff.total.blockCount == 0);
+    TEST(diff.poolCount == 0 && diff.createdBlockCount == 0 && diff.destroyedBlockCount == 0);
+    vmaFreeStatsSnapshotDiff(g_hAllocator, &diff);
+
+    vmaDestroyStatsSnapshot(g_hAllocator, snapshotEnd);
+    vmaDestroyStatsSnapshot(g_hAllocator, snapshotFreed);
+    vmaDestroyStatsSnapshot(g_hAllocator, snapshotMiddle);
+    vmaDestroyStatsSnapshot(g_hAllocator, snapshotBegin);
+}
+
+#if VMA_RECORDING_ENABLED
+struct RecordingReplayResult
+{
+    uint32_t callCount;
+    // Allocations with VmaAllocation object that were not freed by the recording.
+    size_t liveAllocationCount;
+    // Number of replayed calls per recorded thread ID.
+    std::unordered_map<std::string, uint32_t> threadCallCounts;
+};
+
+// Columns of a call as in CSV format: thread ID, time, frame index, function name and parameters.
+typedef std::vector<std::string> RecordedCall;
+
+/*
+Replays calls that create pools and make and free allocations from a recording
+decoded like VmaReplay does, on a new allocator. Checks that they give the same
+results as originally. Other calls are ignored.
+*/
+static void ReplayRecordedAllocations(const std::vector<RecordedCall>& calls, RecordingReplayResult& outResult)
+{
+    outResult.callCount = 0;
+    outResult.liveAllocationCount = 0;
+    outResult.threadCallCounts.clear();
+
+    VmaAllocatorCreateInfo allocatorCreateInfo = {};
+    allocatorCreateInfo.physicalDevice = g_hPhysicalDevice;
+    allocatorCreateInfo.device = g_hDevice;
+    allocatorCreateInfo.pAllocationCallbacks = g_Allocs;
+
+    VmaAllocator hAllocator = VK_NULL_HANDLE;
+    VkResult res = vmaCreateAllocator(&allocatorCreateInfo, &hAllocator);
+    TEST(res == VK_SUCCESS);
+
+    // Objects are matched by handles from the recording.
+    std::unordered_map<std::string, VmaPool> pools;
+    std::unordered_map<std::string, VmaAllocation> allocs;
+    for(size_t callIndex = 0; callIndex < calls.size(); ++callIndex)
+    {
+        const RecordedCall& columns = calls[callIndex];
+        if(columns.size() < 5)
+        {
+            continue;
+        }
+        const std::string& function = columns[3];
+        vmaSetCurrentFrameIndex(hAllocator, (uint32_t)strtoul(columns[2].c_str(), nullptr, 10));
+
+        if(function == "vmaCreatePool" && columns.size() >= 11)
+        {
+            VmaPoolCreateInfo poolCreateInfo = {};
+            poolCreateInfo.memoryTypeIndex = (uint32_t)strtoul(columns[4].c_str(), nullptr, 10);
+            poolCreateInfo.flags = (VmaPoolCreateFlags)strtoul(columns[5].c_str(), nullptr, 10);
+            poolCreateInfo.blockSize = strtoull(columns[6].c_str(), nullptr, 10);
+            poolCreateInfo.minBlockCount = (size_t)strtoull(columns[7].c_str(), nullptr, 10);
+            poolCreateInfo.maxBlockCount = (size_t)strtoull(columns[8].c_str(), nullptr, 10);
+            poolCreateInfo.frameInUseCount = (uint32_t)strtoul(columns[9].c_str(), nullptr, 10);
+            VmaPool pool = VK_NULL_HANDLE;
+            TEST(vmaCreatePool(hAllocator, &poolCreateInfo, &pool) == VK_SUCCESS);
+            TEST(pools.emplace(columns[10], pool).second);
+        }
+        else if(function == "vmaDestroyPool")
+        {
+            auto it = pools.find(columns[4]);
+            TEST(it != pools.end());
+            vmaDestroyPool(hAllocator, it->second);
+            pools.erase(it);
+        }
+        else if((function == "vmaAllocateMemory" || function == "vmaAllocateMemoryWithoutHandle") && columns.size() >= 14)
+        {
+            VkMemoryRequirements memReq = {};
+            memReq.size = strtoull(columns[4].c_str(), nullptr, 10);
+            memReq.alignment = strtoull(columns[5].c_str(), nullptr, 10);
+            memReq.memoryTypeBits = (uint32_t)strtoul(columns[6].c_str(), nullptr, 10);
+            VmaAllocationCreateInfo allocCreateInfo = {};
+            allocCreateInfo.flags = (VmaAllocationCreateFlags)strtoul(columns[7].c_str(), nullptr, 10) &
+                ~(VmaAllocationCreateFlags)VMA_ALLOCATION_CREATE_USER_DATA_COPY_STRING_BIT;
+            allocCreateInfo.usage = (VmaMemoryUsage)strtoul(columns[8].c_str(), nullptr, 10);
+            allocCreateInfo.requiredFlags = (VkMemoryPropertyFlags)strtoul(columns[9].c_str(), nullptr, 10);
+            allocCreateInfo.preferredFlags = (VkMemoryPropertyFlags)strtoul(columns[10].c_str(), nullptr, 10);
+            allocCreateInfo.memoryTypeBits = (uint32_t)strtoul(columns[11].c_str(), nullptr, 10);
+            if(strtoull(columns[12].c_str(), nullptr, 16) != 0)
+            {
+                auto it = pools.find(columns[12]);
+                TEST(it != pools.end());
+                allocCreateInfo.pool = it->second;
+            }
+
+            if(function == "vmaAllocateMemory")
+            {
+                VmaAllocation alloc = VK_NULL_HANDLE;
+                TEST(vmaAllocateMemory(hAllocator, &memReq, &allocCreateInfo, &alloc, nullptr) == VK_SUCCESS);
+                TEST(allocs.emplace(columns[13], alloc).second);
+            }
+            else
+            {
+                VmaAllocationInfo allocInfo = {};
+                res = vmaAllocateMemoryWithoutHandle(hAllocator, &memReq, &allocCreateInfo, &allocInfo);
+                TEST((res == VK_SUCCESS) == (columns[13] == "1"));
+            }
+        }
+        else if(function == "vmaFreeMemory")
+        {
+            auto it = allocs.find(columns[4]);
+            TEST(it != allocs.end());
+            vmaFreeMemory(hAllocator, it->second);
+            allocs.erase(it);
+        }
+        else if(function == "vmaFreePoolAllocations" && columns.size() >= 7)
+        {
+            auto poolIt = pools.find(columns[4]);
+            TEST(poolIt != pools.end());
+            size_t freedCount = 0;
+            TEST(vmaFreePoolAllocations(hAllocator, poolIt->second,
+                (uint32_t)strtoul(columns[5].c_str(), nullptr, 10), &freedCount) == VK_SUCCESS);
+            TEST(freedCount == (size_t)strtoull(columns[6].c_str(), nullptr, 10));
+            // Allocation objects listed in the recording are destroyed by the call.
+            if(columns.size() >= 8)
+            {
+                for(size_t beg = 0; beg < columns[7].length(); )
+                {
+                    size_t end = columns[7].find(' ', beg);
+                    if(end == std::string::npos)
+                    {
+                        end = columns[7].length();
+                    }
+                    TEST(allocs.erase(columns[7].substr(beg, end - beg)) == 1);
+                    beg = end + 1;
+                }
+            }
+        }
+        else
+        {
+            continue;
+        }
+        ++outResult.threadCallCounts[columns[0]];
+        ++outResult.callCount;
+    }
+
+    outResult.liveAllocationCount = allocs.size();
+    for(auto it = allocs.begin(); it != allocs.end(); ++it)
+    {
+        vmaFreeMemory(hAllocator, it->second);
+    }
+    for(auto it = pools.begin(); it != pools.end(); ++it)
+    {
+        // Frees allocations without handle in pools with linear algorithm.
+        vmaFreePoolAllocations(hAllocator, it->second, UINT32_MAX, nullptr);
+        vmaDestroyPool(hAllocator, it->second);
+    }
+    vmaDestroyAllocator(hAllocator);
+}
+
+// Keeps calls decoded from a recording in binary format as columns of CSV format.
+class RecordedCallCollector : public BinaryRecordingSink
+{
+public:
+    bool configurationSet = false;
+    std::vector<RecordedCall> calls;
+
+    virtual void SetConfiguration(const char* beg, const char* end)
+    {
+        configurationSet = std::string(beg, end).find("Config,End") != std::string::npos;
+    }
+    virtual bool AddCall(const BinaryRecordingCall& call)
+    {
+        RecordedCall columns;
+        columns.push_back(std::to_string(call.threadId));
+        columns.push_back(std::to_string(call.time));
+        columns.push_back(std::to_string(call.frameIndex));
+        columns.push_back(call.functionName);
+        const uint64_t* value = call.values;
+        char buf[32];
+        for(const char* type = call.paramTypes; *type != '\0'; ++type)
+        {
+            switch(*type)
+            {
+            case 'u':
+                columns.push_back(std::to_string(*value++));
+                break;
+            case 'L':
+            case 'Q':
+                {
+                    std::string list;
+                    for(uint64_t count = *value++; count > 0; --count)
+                    {
+                        snprintf(buf, sizeof(buf), "%016llX", (unsigned long long)*value++);
+                        list += list.empty() ? buf : std::string(" ") + buf;
+                    }
+                    columns.push_back(list);
+                }
+                break;
+            case 'D':
+                columns.push_back(std::string(call.userData, call.userData + call.userDataLength));
+                break;
+            default:
+                snprintf(buf, sizeof(buf), "%016llX", (unsigned long long)*value++);
+                columns.push_back(buf);
+            }
+        }
+        m_Calls.push_back(columns);
+        return true;
+    }
+    virtual void SetCallOrder(const std::vector<uint32_t>& order)
+    {
+        calls.clear();
+        for(size_t i = 0; i < order.size(); ++i)
+        {
+            calls.push_back(m_Calls[order[i]]);
+        }
+        m_Calls.clear();
+    }
+
+private:
+    // In the order of the file.
+    std::vector<RecordedCall> m_Calls;
+};
+
+// Decodes recording file in binary format, like VmaReplay does.
+static void LoadBinaryRecording(const char* filePath, std::vector<RecordedCall>& outCalls)
+{
+    std::vector<char> recording;
+    ReadFile(recording, filePath);
+    TEST(IsBinaryRecording(recording.data(), recording.size()));
+    RecordedCallCollector collector;
+    TEST(DecodeBinaryRecording(recording.data(), recording.size(), collector));
+    TEST(collector.configurationSet);
+    outCalls.swap(collector.calls);
+}
+
+// Records calls in binary format from many short-lived threads and replays them.
+static void TestRecordingThreadChurn()
+{
+    wprintf(L"Test recording with thread churn\n");
+
+    const char* const FILE_PATH = "RecordingThreadChurn.bin";
+    const uint32_t ROUND_COUNT = 10;
+    const uint32_t THREAD_COUNT = 4;
+    const uint32_t ALLOC_COUNT = 32;
+
+    VmaRecordSettings recordSettings = {};
+    recordSettings.flags = VMA_RECORD_BINARY_FORMAT_BIT;
+    recordSettings.pFilePath = FILE_PATH;
+
+    VmaAllocatorCreateInfo allocatorCreateInfo = {};
+    allocatorCreateInfo.physicalDevice = g_hPhysicalDevice;
+    allocatorCreateInfo.device = g_hDevice;
+    allocatorCreateInfo.pAllocationCallbacks = g_Allocs;
+    allocatorCreateInfo.pRecordSettings = &recordSettings;
+
+    VmaAllocator hAllocator = VK_NULL_HANDLE;
+    VkResult res = vmaCreateAllocator(&allocatorCreateInfo, &hAllocator);
+    TEST(res == VK_SUCCESS);
+
+    VkMemoryRequirements memReq = {};
+    memReq.size = 0x1000;
+    memReq.alignment = 0x100;
+    memReq.memoryTypeBits = UINT32_MAX;
+
+    VmaAllocationCreateInfo allocCreateInfo = {};
+    allocCreateInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+
+    VmaRecordingStats recordingStatsBegin = {};
+    res = vmaGetRecordingStats(hAllocator, &recordingStatsBegin);
+    TEST(res == VK_SUCCESS);
+
+    // Every thread exits before the next round, so its buffer must be written
+    // and released, and a new thread may get the ID of the old one.
+    auto threadProc = [&]()
+    {
+        std::vector<VmaAllocation> allocs(ALLOC_COUNT);
+        for(uint32_t i = 0; i < ALLOC_COUNT; ++i)
+        {
+            TEST(vmaAllocateMemory(hAllocator, &memReq, &allocCreateInfo, &allocs[i], nullptr) == VK_SUCCESS);
+        }
+        for(uint32_t i = 0; i < ALLOC_COUNT; ++i)
+        {
+            vmaFreeMemory(hAllocator, allocs[i]);
+        }
+    };
+    for(uint32_t round = 0; round < ROUND_COUNT; ++round)
+    {
+        std::vector<std::thread> threads;
+        for(uint32_t i = 0; i < THREAD_COUNT; ++i)
+        {
+            threads.emplace_back(threadProc);
+        }
+        for(size_t i = 0; i < threads.size(); ++i)
+        {
+            threads[i].join();
+        }
+    }
+
+    const uint32_t expectedCallCount = ROUND_COUNT * THREAD_COUNT * ALLOC_COUNT * 2;
+    VmaRecordingStats recordingStatsEnd = {};
+    res = vmaGetRecordingStats(hAllocator, &recordingStatsEnd);
+    TEST(res == VK_SUCCESS);
+    TEST(recordingStatsEnd.recordedCallCount - recordingStatsBegin.recordedCallCount == expectedCallCount);
+
+    vmaDestroyAllocator(hAllocator);
+
+    std::vector<RecordedCall> calls;
+    LoadBinaryRecording(FILE_PATH, calls);
+    RecordingReplayResult replayResult;
+    ReplayRecordedAllocations(calls, replayResult);
+
+    TEST(replayResult.callCount == expectedCallCount);
+    TEST(replayResult.liveAllocationCount == 0);
+    // A reused thread ID may own calls of several threads, but never a part of them.
+    for(auto it = replayResult.threadCallCounts.begin(); it != replayResult.threadCallCounts.end(); ++it)
+    {
+        TEST(it->second % (ALLOC_COUNT * 2) == 0);
+    }
+
+    remove(FILE_PATH);
+}
+
+/*
+Makes allocations with and without VmaAllocation object in a pool with linear algorithm
+used as ring buffer, freed per frame, while the flight recorder overwrites the oldest
+calls. Dump must describe allocations made before its first call, so that it replays
+with the same results.
+*/
+static void TestFlightRecorderDump()
+{
+    wprintf(L"Test flight recorder dump\n");
+
+    const char* const FILE_PATH = "FlightRecorderDump.bin";
+    const uint32_t FRAME_COUNT = 100;
+    const uint32_t FRAME_ALLOC_COUNT = 3;
+    const uint32_t FRAMES_IN_FLIGHT = 2;
+
+    VmaRecordSettings recordSettings = {};
+    recordSettings.flags = VMA_RECORD_FLIGHT_RECORDER_BIT;
+    recordSettings.pFilePath = FILE_PATH;
+    recordSettings.flightRecorderBufferSize = 4096;
+
+    VmaAllocatorCreateInfo allocatorCreateInfo = {};
+    allocatorCreateInfo.physicalDevice = g_hPhysicalDevice;
+    allocatorCreateInfo.device = g_hDevice;
+    allocatorCreateInfo.pAllocationCallbacks = g_Allocs;
+    allocatorCreateInfo.pRecordSettings = &recordSettings;
+
+    VmaAllocator hAllocator = VK_NULL_HANDLE;
+    VkResult res = vmaCreateAllocator(&allocatorCreateInfo, &hAllocator);
+    TEST(res == VK_SUCCESS);
+
+    VmaAllocationCreateInfo allocCreateInfo = {};
+    allocCreateInfo.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+
+    VmaPoolCreateInfo poolCreateInfo = {};
+    res = vmaFindMemoryTypeIndex(hAllocator, UINT32_MAX, &allocCreateInfo, &poolCreateInfo.memoryTypeIndex);
+    TEST(res == VK_SUCCESS);
+    poolCreateInfo.flags = VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT;
+    poolCreateInfo.blockSize = 0x10000;
+    poolCreateInfo.maxBlockCount = 1;
+
+    VmaPool pool = VK_NULL_HANDLE;
+    res = vmaCreatePool(hAllocator, &poolCreateInfo, &pool);
+    TEST(res == VK_SUCCESS);
+    VmaAllocationCreateInfo poolAllocCreateInfo = {};
+    poolAllocCreateInfo.pool = pool;
+
+    VkMemoryRequirements memReq = {};
+    memReq.size = 1000;
+    memReq.alignment = 0x100;
+    memReq.memoryTypeBits = UINT32_MAX;
+
+    // Pool is used as ring buffer: allocations of a frame are freed FRAMES_IN_FLIGHT frames later.
+    std::vector<VmaAllocation> longLivedAllocs;
+    for(uint32_t frameIndex = 0; frameIndex < FRAME_COUNT; ++frameIndex)
+    {
+        vmaSetCurrentFrameIndex(hAllocator, frameIndex);
+        for(uint32_t i = 0; i < FRAME_ALLOC_COUNT; ++i)
+        {
+            VmaAllocation alloc = VK_NULL_HANDLE;
+            res = vmaAllocateMemory(hAllocator, &memReq, &poolAllocCreateInfo, &alloc, nullptr);
+            TEST(res == VK_SUCCESS);
+            VmaAllocationInfo allocInfo = {};
+            res = vmaAllocateMemoryWithoutHandle(hAllocator, &memReq, &poolAllocCreateInfo, &allocInfo);
+            TEST(res == VK_SUCCESS);
+        }
+        if(frameIndex % 10 == 0)
+        {
+            VmaAllocation alloc = VK_NULL_HANDLE;
+            res = vmaAllocateMemory(hAllocator, &memReq, &allocCreateInfo, &alloc, nullptr);
+            TEST(res == VK_SUCCESS);
+            longLivedAllocs.push_back(alloc);
+        }
+        if(frameIndex >= FRAMES_IN_FLIGHT)
+        {
+            size_t freedCount = 0;
+            res = vmaFreePoolAllocations(hAllocator, pool, frameIndex - FRAMES_IN_FLIGHT, &freedCount);
+            TEST(res == VK_SUCCESS && freedCount == FRAME_ALLOC_COUNT * 2);
+        }
+    }
+
+    VmaRecordingStats recordingStats = {};
+    res = vmaGetRecordingStats(hAllocator, &recordingStats);
+    TEST(res == VK_SUCCESS);
+    res = vmaDumpRecording(hAllocator, nullptr);
+    TEST(res == VK_SUCCESS);
+
+    std::vector<RecordedCall> calls;
+    LoadBinaryRecording(FILE_PATH, calls);
+    // Calls overwritten in the ring buffer are replaced by descriptions of objects.
+    TEST(calls.size() < recordingStats.recordedCallCount);
+    RecordingReplayResult replayResult;
+    ReplayRecordedAllocations(calls, replayResult);
+    TEST(replayResult.liveAllocationCount == longLivedAllocs.size() + FRAMES_IN_FLIGHT * FRAME_ALLOC_COUNT);
+
+    for(size_t i = 0; i < longLivedAllocs.size(); ++i)
+    {
+        vmaFreeMemory(hAllocator, longLivedAllocs[i]);
+    }
+    vmaDestroyPool(hAllocator, pool);
+    vmaDestroyAllocator(hAllocator);
+    remove(FILE_PATH);
+}
+#endif // #if VMA_RECORDING_ENABLED
+
+static void TestBasics()
+{
+    VkResult res;
+
+    TestMemoryRequirements();
+
+    // Lost allocation
+    {
+        VmaAllocation alloc = VK_NULL_HANDLE;
+        vmaCreateLostAllocation(g_hAllocator, &alloc);
+        TEST(alloc != VK_NULL_HANDLE);
+
+        VmaAllocationInfo allocInfo;
+        vmaGetAllocationInfo(g_hAllocator, alloc, &allocInfo);
+        TEST(allocInfo.deviceMemory == VK_NULL_HANDLE);
+        TEST(allocInfo.size == 0);
 
         vmaFreeMemory(g_hAllocator, alloc);
     }
@@ -1977,6 +3360,19 @@ static void TestBasics()
     TestUserData();
 
     TestInvalidAllocations();
+
+    TestStatsSink();
+
+#if VMA_COUNTERS_ENABLED
+    TestCounters();
+#endif
+    TestAllocationHistograms();
+    TestCalculateStatsParallel();
+    TestStatsSnapshots();
+#if VMA_RECORDING_ENABLED
+    TestRecordingThreadChurn();
+    TestFlightRecorderDump();
+#endif
 }
 
 void TestHeapSizeLimit()
@@ -2644,73 +4040,222 @@ static void TestLinearAllocatorMultiBlock()
             bufInfo.erase(bufInfo.begin() + indexToDestroy);
         }
 
-        // Make sure that pool has now at most one block.
-        vmaGetPoolStats(g_hAllocator, pool, &poolStats);
-        TEST(poolStats.blockCount <= 1);
-    }
+        // Make sure that pool has now at most one block.
+        vmaGetPoolStats(g_hAllocator, pool, &poolStats);
+        TEST(poolStats.blockCount <= 1);
+    }
+
+    // Test stack.
+    {
+        // Allocate buffers until we move to a second block.
+        VkDeviceMemory lastMem = VK_NULL_HANDLE;
+        for(uint32_t i = 0; ; ++i)
+        {
+            BufferInfo newBufInfo;
+            res = vmaCreateBuffer(g_hAllocator, &bufCreateInfo, &allocCreateInfo,
+                &newBufInfo.Buffer, &newBufInfo.Allocation, &allocInfo);
+            TEST(res == VK_SUCCESS);
+            bufInfo.push_back(newBufInfo);
+            if(lastMem && allocInfo.deviceMemory != lastMem)
+            {
+                break;
+            }
+            lastMem = allocInfo.deviceMemory;
+        }
+
+        TEST(bufInfo.size() > 2);
+
+        // Add few more buffers.
+        for(uint32_t i = 0; i < 5; ++i)
+        {
+            BufferInfo newBufInfo;
+            res = vmaCreateBuffer(g_hAllocator, &bufCreateInfo, &allocCreateInfo,
+                &newBufInfo.Buffer, &newBufInfo.Allocation, &allocInfo);
+            TEST(res == VK_SUCCESS);
+            bufInfo.push_back(newBufInfo);
+        }
+
+        // Make sure that pool has now two blocks.
+        VmaPoolStats poolStats = {};
+        vmaGetPoolStats(g_hAllocator, pool, &poolStats);
+        TEST(poolStats.blockCount == 2);
+        
+        // Delete half of buffers, LIFO.
+        for(size_t i = 0, countToDelete = bufInfo.size() / 2; i < countToDelete; ++i)
+        {
+            const BufferInfo& currBufInfo = bufInfo.back();
+            vmaDestroyBuffer(g_hAllocator, currBufInfo.Buffer, currBufInfo.Allocation);
+            bufInfo.pop_back();
+        }
+
+        // Add one more buffer.
+        BufferInfo newBufInfo;
+        res = vmaCreateBuffer(g_hAllocator, &bufCreateInfo, &allocCreateInfo,
+            &newBufInfo.Buffer, &newBufInfo.Allocation, &allocInfo);
+        TEST(res == VK_SUCCESS);
+        bufInfo.push_back(newBufInfo);
+
+        // Make sure that pool has now one block.
+        vmaGetPoolStats(g_hAllocator, pool, &poolStats);
+        TEST(poolStats.blockCount == 1);
+
+        // Delete all the remaining buffers, LIFO.
+        while(!bufInfo.empty())
+        {
+            const BufferInfo& currBufInfo = bufInfo.back();
+            vmaDestroyBuffer(g_hAllocator, currBufInfo.Buffer, currBufInfo.Allocation);
+            bufInfo.pop_back();
+        }
+    }
+
+    vmaDestroyPool(g_hAllocator, pool);
+
+    // Test ring buffer spanning multiple blocks.
+    {
+        poolCreateInfo.blockSize = bufCreateInfo.size * 8;
+        poolCreateInfo.maxBlockCount = 2;
+        res = vmaCreatePool(g_hAllocator, &poolCreateInfo, &pool);
+        TEST(res == VK_SUCCESS);
+        allocCreateInfo.pool = pool;
+
+        // Allocate buffers until we move to a second block.
+        size_t buffersPerBlock = 0;
+        VkDeviceMemory firstMem = VK_NULL_HANDLE;
+        for(;;)
+        {
+            BufferInfo newBufInfo;
+            res = vmaCreateBuffer(g_hAllocator, &bufCreateInfo, &allocCreateInfo,
+                &newBufInfo.Buffer, &newBufInfo.Allocation, &allocInfo);
+            TEST(res == VK_SUCCESS);
+            bufInfo.push_back(newBufInfo);
+            if(firstMem == VK_NULL_HANDLE)
+            {
+                firstMem = allocInfo.deviceMemory;
+            }
+            else if(allocInfo.deviceMemory != firstMem)
+            {
+                break;
+            }
+            ++buffersPerBlock;
+        }
+        TEST(buffersPerBlock > 1);
+
+        // Keep as many buffers as fit in one block, FIFO. Blocks must be reused, one after another.
+        for(size_t i = 0; i < buffersPerBlock * 5; ++i)
+        {
+            vmaDestroyBuffer(g_hAllocator, bufInfo.front().Buffer, bufInfo.front().Allocation);
+            bufInfo.erase(bufInfo.begin());
+
+            BufferInfo newBufInfo;
+            res = vmaCreateBuffer(g_hAllocator, &bufCreateInfo, &allocCreateInfo,
+                &newBufInfo.Buffer, &newBufInfo.Allocation, &allocInfo);
+            TEST(res == VK_SUCCESS);
+            bufInfo.push_back(newBufInfo);
+        }
+
+        VmaPoolStats poolStats = {};
+        vmaGetPoolStats(g_hAllocator, pool, &poolStats);
+        TEST(poolStats.blockCount == 2);
+
+        for(size_t i = 0; i < bufInfo.size(); ++i)
+        {
+            vmaDestroyBuffer(g_hAllocator, bufInfo[i].Buffer, bufInfo[i].Allocation);
+        }
+        bufInfo.clear();
+
+        vmaDestroyPool(g_hAllocator, pool);
+    }
+}
+
+static void TestLinearAllocatorFreePerFrame()
+{
+    wprintf(L"Test linear allocator free per frame\n");
+
+    RandomNumberGenerator rand{5641};
+
+    VkBufferCreateInfo sampleBufCreateInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+    sampleBufCreateInfo.size = 1024;
+    sampleBufCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+    VmaAllocationCreateInfo sampleAllocCreateInfo = {};
+    sampleAllocCreateInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+
+    VmaPoolCreateInfo poolCreateInfo = {};
+    poolCreateInfo.flags = VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT;
+    poolCreateInfo.blockSize = 64 * 1024;
+    poolCreateInfo.maxBlockCount = 8;
+    VkResult res = vmaFindMemoryTypeIndexForBufferInfo(g_hAllocator, &sampleBufCreateInfo, &sampleAllocCreateInfo, &poolCreateInfo.memoryTypeIndex);
+    TEST(res == VK_SUCCESS);
+
+    VmaPool pool = nullptr;
+    res = vmaCreatePool(g_hAllocator, &poolCreateInfo, &pool);
+    TEST(res == VK_SUCCESS);
+
+    VmaAllocationCreateInfo allocCreateInfo = {};
+    allocCreateInfo.pool = pool;
+    allocCreateInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+    VkMemoryRequirements memReq = {};
+    memReq.alignment = 16;
+    memReq.memoryTypeBits = 1u << poolCreateInfo.memoryTypeIndex;
+
+    const uint32_t framesInFlight = 3;
+    std::vector<size_t> allocCountPerFrame;
 
-    // Test stack.
+    // Allocations without handle, plus some normal ones, freed per frame like a ring buffer.
+    const uint32_t firstFrameIndex = ++g_FrameIndex;
+    for(uint32_t frame = 0; frame < 100; ++frame)
     {
-        // Allocate buffers until we move to a second block.
-        VkDeviceMemory lastMem = VK_NULL_HANDLE;
-        for(uint32_t i = 0; ; ++i)
+        const uint32_t frameIndex = firstFrameIndex + frame;
+        vmaSetCurrentFrameIndex(g_hAllocator, frameIndex);
+
+        const size_t allocCount = rand.Generate() % 32 + 1;
+        for(size_t i = 0; i < allocCount; ++i)
         {
-            BufferInfo newBufInfo;
-            res = vmaCreateBuffer(g_hAllocator, &bufCreateInfo, &allocCreateInfo,
-                &newBufInfo.Buffer, &newBufInfo.Allocation, &allocInfo);
-            TEST(res == VK_SUCCESS);
-            bufInfo.push_back(newBufInfo);
-            if(lastMem && allocInfo.deviceMemory != lastMem)
+            memReq.size = rand.Generate() % 1024 + 16;
+            VmaAllocationInfo allocInfo = {};
+            if(i % 4 == 0)
             {
-                break;
+                VmaAllocation alloc = VK_NULL_HANDLE;
+                res = vmaAllocateMemory(g_hAllocator, &memReq, &allocCreateInfo, &alloc, &allocInfo);
+            }
+            else
+            {
+                res = vmaAllocateMemoryWithoutHandle(g_hAllocator, &memReq, &allocCreateInfo, &allocInfo);
             }
-            lastMem = allocInfo.deviceMemory;
-        }
-
-        TEST(bufInfo.size() > 2);
-
-        // Add few more buffers.
-        for(uint32_t i = 0; i < 5; ++i)
-        {
-            BufferInfo newBufInfo;
-            res = vmaCreateBuffer(g_hAllocator, &bufCreateInfo, &allocCreateInfo,
-                &newBufInfo.Buffer, &newBufInfo.Allocation, &allocInfo);
             TEST(res == VK_SUCCESS);
-            bufInfo.push_back(newBufInfo);
+            TEST(allocInfo.size >= memReq.size && allocInfo.offset % memReq.alignment == 0);
+            TEST(allocInfo.pMappedData != nullptr);
+            memset(allocInfo.pMappedData, (int)frame, (size_t)memReq.size);
         }
+        allocCountPerFrame.push_back(allocCount);
 
-        // Make sure that pool has now two blocks.
-        VmaPoolStats poolStats = {};
-        vmaGetPoolStats(g_hAllocator, pool, &poolStats);
-        TEST(poolStats.blockCount == 2);
-        
-        // Delete half of buffers, LIFO.
-        for(size_t i = 0, countToDelete = bufInfo.size() / 2; i < countToDelete; ++i)
+        if(frame >= framesInFlight)
         {
-            const BufferInfo& currBufInfo = bufInfo.back();
-            vmaDestroyBuffer(g_hAllocator, currBufInfo.Buffer, currBufInfo.Allocation);
-            bufInfo.pop_back();
+            size_t freedCount = 0;
+            res = vmaFreePoolAllocations(g_hAllocator, pool, frameIndex - framesInFlight, &freedCount);
+            TEST(res == VK_SUCCESS);
+            TEST(freedCount == allocCountPerFrame[frame - framesInFlight]);
         }
+    }
+    g_FrameIndex = firstFrameIndex + 100;
 
-        // Add one more buffer.
-        BufferInfo newBufInfo;
-        res = vmaCreateBuffer(g_hAllocator, &bufCreateInfo, &allocCreateInfo,
-            &newBufInfo.Buffer, &newBufInfo.Allocation, &allocInfo);
-        TEST(res == VK_SUCCESS);
-        bufInfo.push_back(newBufInfo);
-
-        // Make sure that pool has now one block.
-        vmaGetPoolStats(g_hAllocator, pool, &poolStats);
-        TEST(poolStats.blockCount == 1);
-
-        // Delete all the remaining buffers, LIFO.
-        while(!bufInfo.empty())
-        {
-            const BufferInfo& currBufInfo = bufInfo.back();
-            vmaDestroyBuffer(g_hAllocator, currBufInfo.Buffer, currBufInfo.Allocation);
-            bufInfo.pop_back();
-        }
+    VmaPoolStats poolStats = {};
+    vmaGetPoolStats(g_hAllocator, pool, &poolStats);
+    size_t expectedAllocCount = 0;
+    for(size_t i = allocCountPerFrame.size() - framesInFlight; i < allocCountPerFrame.size(); ++i)
+    {
+        expectedAllocCount += allocCountPerFrame[i];
     }
+    TEST(poolStats.allocationCount == expectedAllocCount);
+
+    // Free everything at once.
+    size_t freedCount = 0;
+    res = vmaFreePoolAllocations(g_hAllocator, pool, UINT32_MAX, &freedCount);
+    TEST(res == VK_SUCCESS);
+    TEST(freedCount == expectedAllocCount);
+    vmaGetPoolStats(g_hAllocator, pool, &poolStats);
+    TEST(poolStats.allocationCount == 0 && poolStats.blockCount <= 1);
 
     vmaDestroyPool(g_hAllocator, pool);
 }
@@ -2861,15 +4406,8 @@ static void BenchmarkAlgorithmsCase(FILE* file,
     res = vmaCreatePool(g_hAllocator, &poolCreateInfo, &pool);
     TEST(res == VK_SUCCESS);
 
-    // Buffer created just to get memory requirements. Never bound to any memory.
-    VkBuffer dummyBuffer = VK_NULL_HANDLE;
-    res = vkCreateBuffer(g_hDevice, &sampleBufCreateInfo, g_Allocs, &dummyBuffer);
-    TEST(res == VK_SUCCESS && dummyBuffer);
-
     VkMemoryRequirements memReq = {};
-    vkGetBufferMemoryRequirements(g_hDevice, dummyBuffer, &memReq);
-
-    vkDestroyBuffer(g_hDevice, dummyBuffer, g_Allocs);
+    GetDummyBufferMemoryRequirements(sampleBufCreateInfo, memReq);
 
     VmaAllocationCreateInfo allocCreateInfo = {};
     allocCreateInfo.pool = pool;
@@ -3059,6 +4597,190 @@ static void BenchmarkAlgorithms(FILE* file)
     }
 }
 
+static void BenchmarkDefragmentationCase(FILE* file,
+    VmaDefragmentationFlags flags,
+    bool allAllocationsMovable)
+{
+    RandomNumberGenerator rand{7349};
+
+    const VkDeviceSize bufSizeMin = 64;
+    const VkDeviceSize bufSizeMax = 4096;
+    const size_t allocCount = ConfigType >= CONFIG_TYPE::CONFIG_TYPE_LARGE ? 40000 : 10000;
+
+    VkBufferCreateInfo sampleBufCreateInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+    sampleBufCreateInfo.size = bufSizeMax;
+    sampleBufCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+    VmaAllocationCreateInfo sampleAllocCreateInfo = {};
+    sampleAllocCreateInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+
+    VmaPoolCreateInfo poolCreateInfo = {};
+    VkResult res = vmaFindMemoryTypeIndexForBufferInfo(g_hAllocator, &sampleBufCreateInfo, &sampleAllocCreateInfo, &poolCreateInfo.memoryTypeIndex);
+    TEST(res == VK_SUCCESS);
+
+    poolCreateInfo.blockSize = 4ull * 1024 * 1024;
+
+    VmaPool pool = nullptr;
+    res = vmaCreatePool(g_hAllocator, &poolCreateInfo, &pool);
+    TEST(res == VK_SUCCESS);
+
+    VkMemoryRequirements memReq = {};
+    GetDummyBufferMemoryRequirements(sampleBufCreateInfo, memReq);
+
+    VmaAllocationCreateInfo allocCreateInfo = {};
+    allocCreateInfo.pool = pool;
+
+    // Make many small allocations, then delete half of them, choose randomly, leaving many small holes.
+    std::vector<VmaAllocation> allocations(allocCount);
+    for(size_t i = 0; i < allocCount; ++i)
+    {
+        memReq.size = bufSizeMin + rand.Generate() % (bufSizeMax - bufSizeMin);
+        res = vmaAllocateMemory(g_hAllocator, &memReq, &allocCreateInfo, &allocations[i], nullptr);
+        TEST(res == VK_SUCCESS);
+    }
+    for(size_t i = 0; i < allocCount / 2; ++i)
+    {
+        const size_t index = (size_t)rand.Generate() % allocations.size();
+        vmaFreeMemory(g_hAllocator, allocations[index]);
+        allocations.erase(allocations.begin() + index);
+    }
+
+    // Fill each allocation with a value derived from its index, to validate data after defragmentation.
+    for(size_t i = 0; i < allocations.size(); ++i)
+    {
+        VmaAllocationInfo allocInfo;
+        vmaGetAllocationInfo(g_hAllocator, allocations[i], &allocInfo);
+        void* pData = nullptr;
+        res = vmaMapMemory(g_hAllocator, allocations[i], &pData);
+        TEST(res == VK_SUCCESS);
+        memset(pData, (int)(i % 251), (size_t)allocInfo.size);
+        vmaUnmapMemory(g_hAllocator, allocations[i]);
+    }
+
+    VmaPoolStats poolStatsBefore = {};
+    vmaGetPoolStats(g_hAllocator, pool, &poolStatsBefore);
+
+    // When not all allocations are movable, default algorithm is the generic one, otherwise the fast one.
+    std::vector<VmaAllocation> allocationsToDefrag;
+    if(!allAllocationsMovable)
+    {
+        allocationsToDefrag = allocations;
+        std::shuffle(allocationsToDefrag.begin(), allocationsToDefrag.end(), MyUniformRandomNumberGenerator(rand));
+        allocationsToDefrag.resize(allocationsToDefrag.size() * 9 / 10);
+    }
+
+    VmaDefragmentationInfo2 defragInfo = {};
+    defragInfo.flags = flags;
+    if(allAllocationsMovable)
+    {
+        defragInfo.poolCount = 1;
+        defragInfo.pPools = &pool;
+    }
+    else
+    {
+        defragInfo.allocationCount = (uint32_t)allocationsToDefrag.size();
+        defragInfo.pAllocations = allocationsToDefrag.data();
+    }
+    defragInfo.maxCpuAllocationsToMove = UINT32_MAX;
+    defragInfo.maxCpuBytesToMove = VK_WHOLE_SIZE;
+
+    // BENCHMARK
+    VmaDefragmentationStats defragStats = {};
+    VmaDefragmentationContext defragCtx = VK_NULL_HANDLE;
+    time_point timeBeg = std::chrono::high_resolution_clock::now();
+    res = vmaDefragmentationBegin(g_hAllocator, &defragInfo, &defragStats, &defragCtx);
+    TEST(res >= VK_SUCCESS);
+    vmaDefragmentationEnd(g_hAllocator, defragCtx);
+    const float totalSeconds = ToFloatSeconds(std::chrono::high_resolution_clock::now() - timeBeg);
+
+    VmaPoolStats poolStatsAfter = {};
+    vmaGetPoolStats(g_hAllocator, pool, &poolStatsAfter);
+
+    // Validate the result: data preserved, no overlapping allocations, no more memory or free space than before.
+    std::vector<VmaAllocationInfo> allocInfos(allocations.size());
+    for(size_t i = 0; i < allocations.size(); ++i)
+    {
+        vmaGetAllocationInfo(g_hAllocator, allocations[i], &allocInfos[i]);
+        void* pData = nullptr;
+        res = vmaMapMemory(g_hAllocator, allocations[i], &pData);
+        TEST(res == VK_SUCCESS);
+        const uint8_t* const pBytes = (const uint8_t*)pData;
+        for(VkDeviceSize j = 0; j < allocInfos[i].size; ++j)
+        {
+            TEST(pBytes[j] == (uint8_t)(i % 251));
+        }
+        vmaUnmapMemory(g_hAllocator, allocations[i]);
+    }
+    std::sort(allocInfos.begin(), allocInfos.end(), [](const VmaAllocationInfo& lhs, const VmaAllocationInfo& rhs) {
+        if(lhs.deviceMemory != rhs.deviceMemory)
+            return lhs.deviceMemory < rhs.deviceMemory;
+        return lhs.offset < rhs.offset;
+    });
+    for(size_t i = 1; i < allocInfos.size(); ++i)
+    {
+        TEST(allocInfos[i].deviceMemory != allocInfos[i - 1].deviceMemory ||
+            allocInfos[i - 1].offset + allocInfos[i - 1].size <= allocInfos[i].offset);
+    }
+    TEST(poolStatsAfter.size <= poolStatsBefore.size);
+    TEST(poolStatsAfter.unusedSize <= poolStatsBefore.unusedSize);
+    TEST(poolStatsBefore.blockCount - poolStatsAfter.blockCount == defragStats.deviceMemoryBlocksFreed);
+
+    for(size_t i = allocations.size(); i--; )
+    {
+        vmaFreeMemory(g_hAllocator, allocations[i]);
+    }
+
+    vmaDestroyPool(g_hAllocator, pool);
+
+    const char* const algorithmName = (flags & VMA_DEFRAGMENTATION_BEST_FIT_ALGORITHM_BIT) != 0 ? "Best-fit" : "Default";
+
+    printf("    Algorithm=%s Movable=%s: %g s, moved %u allocations %llu B, freed %u blocks, unused ranges %zu -> %zu\n",
+        algorithmName,
+        allAllocationsMovable ? "All" : "Some",
+        totalSeconds,
+        defragStats.allocationsMoved,
+        defragStats.bytesMoved,
+        defragStats.deviceMemoryBlocksFreed,
+        poolStatsBefore.unusedRangeCount,
+        poolStatsAfter.unusedRangeCount);
+
+    if(file)
+    {
+        std::string currTime;
+        CurrentTimeToStr(currTime);
+
+        fprintf(file, "%s,%s,%s,%u,%g,%u,%llu,%u,%zu,%zu\n",
+            CODE_DESCRIPTION, currTime.c_str(),
+            algorithmName,
+            allAllocationsMovable ? 1 : 0,
+            totalSeconds,
+            defragStats.allocationsMoved,
+            defragStats.bytesMoved,
+            defragStats.deviceMemoryBlocksFreed,
+            poolStatsBefore.unusedRangeCount,
+            poolStatsAfter.unusedRangeCount);
+    }
+}
+
+static void BenchmarkDefragmentation(FILE* file)
+{
+    wprintf(L"Benchmark defragmentation\n");
+
+    if(file)
+    {
+        fprintf(file,
+            "Code,Time,"
+            "Algorithm,All movable,"
+            "Time (s),Allocations moved,Bytes moved,Blocks freed,Unused ranges before,Unused ranges after\n");
+    }
+
+    for(uint32_t movableIndex = 0; movableIndex < 2; ++movableIndex)
+    {
+        BenchmarkDefragmentationCase(file, 0, movableIndex == 0);
+        BenchmarkDefragmentationCase(file, VMA_DEFRAGMENTATION_BEST_FIT_ALGORITHM_BIT, movableIndex == 0);
+    }
+}
+
 static void TestPool_SameSize()
 {
     const VkDeviceSize BUF_SIZE = 1024 * 1024;
@@ -3469,28 +5191,16 @@ static void TestPool_Benchmark(
 
     uint32_t bufferMemoryTypeBits = UINT32_MAX;
     {
-        VkBuffer dummyBuffer;
-        VkResult res = vkCreateBuffer(g_hDevice, &bufferInfo, g_Allocs, &dummyBuffer);
-        TEST(res == VK_SUCCESS);
-
         VkMemoryRequirements memReq;
-        vkGetBufferMemoryRequirements(g_hDevice, dummyBuffer, &memReq);
+        GetDummyBufferMemoryRequirements(bufferInfo, memReq);
         bufferMemoryTypeBits = memReq.memoryTypeBits;
-
-        vkDestroyBuffer(g_hDevice, dummyBuffer, g_Allocs);
     }
 
     uint32_t imageMemoryTypeBits = UINT32_MAX;
     {
-        VkImage dummyImage;
-        VkResult res = vkCreateImage(g_hDevice, &imageInfo, g_Allocs, &dummyImage);
-        TEST(res == VK_SUCCESS);
-
         VkMemoryRequirements memReq;
-        vkGetImageMemoryRequirements(g_hDevice, dummyImage, &memReq);
+        GetDummyImageMemoryRequirements(imageInfo, memReq);
         imageMemoryTypeBits = memReq.memoryTypeBits;
-
-        vkDestroyImage(g_hDevice, dummyImage, g_Allocs);
     }
 
     uint32_t memoryTypeBits = 0;
@@ -4939,6 +6649,70 @@ static void BasicTestBuddyAllocator()
     }
 
     vmaDestroyPool(g_hAllocator, pool);
+
+    // Block of size not being power of two: 1 MB + 512 KB + 1023 B.
+    // By default, only the largest power of two is used: 1 MB.
+    poolCreateInfo.blockSize = 1024 * 1024 + 1024 * 512 + 1023;
+    poolCreateInfo.maxBlockCount = 1;
+    res = vmaCreatePool(g_hAllocator, &poolCreateInfo, &pool);
+    TEST(res == VK_SUCCESS);
+    allocCreateInfo.pool = pool;
+
+    bufCreateInfo.size = 1024 * 1024;
+    res = vmaCreateBuffer(g_hAllocator, &bufCreateInfo, &allocCreateInfo,
+        &newBufInfo.Buffer, &newBufInfo.Allocation, &allocInfo);
+    TEST(res == VK_SUCCESS);
+    bufInfo.push_back(newBufInfo);
+
+    bufCreateInfo.size = 1024 * 512;
+    res = vmaCreateBuffer(g_hAllocator, &bufCreateInfo, &allocCreateInfo,
+        &newBufInfo.Buffer, &newBufInfo.Allocation, &allocInfo);
+    TEST(res == VK_ERROR_OUT_OF_DEVICE_MEMORY);
+
+    vmaGetPoolStats(g_hAllocator, pool, &stats);
+    TEST(stats.blockCount == 1);
+    TEST(stats.unusedSize == poolCreateInfo.blockSize - 1024 * 1024);
+
+    for(size_t i = 0; i < bufInfo.size(); ++i)
+    {
+        vmaDestroyBuffer(g_hAllocator, bufInfo[i].Buffer, bufInfo[i].Allocation);
+    }
+    bufInfo.clear();
+
+    vmaDestroyPool(g_hAllocator, pool);
+
+    // With VMA_POOL_CREATE_BUDDY_MULTIPLE_ROOTS_BIT, whole block is used.
+    poolCreateInfo.flags = VMA_POOL_CREATE_BUDDY_ALGORITHM_BIT | VMA_POOL_CREATE_BUDDY_MULTIPLE_ROOTS_BIT;
+    res = vmaCreatePool(g_hAllocator, &poolCreateInfo, &pool);
+    TEST(res == VK_SUCCESS);
+    allocCreateInfo.pool = pool;
+
+    const VkDeviceSize tailSizes[] = { 1024 * 1024, 1024 * 512, 512, 256 };
+    for(size_t i = 0; i < _countof(tailSizes); ++i)
+    {
+        bufCreateInfo.size = tailSizes[i];
+        res = vmaCreateBuffer(g_hAllocator, &bufCreateInfo, &allocCreateInfo,
+            &newBufInfo.Buffer, &newBufInfo.Allocation, &allocInfo);
+        TEST(res == VK_SUCCESS);
+        bufInfo.push_back(newBufInfo);
+    }
+
+    vmaGetPoolStats(g_hAllocator, pool, &stats);
+    TEST(stats.blockCount == 1);
+    TEST(stats.unusedSize == poolCreateInfo.blockSize - (1024 * 1024 + 1024 * 512 + 512 + 256));
+
+    for(size_t i = 0; i < bufInfo.size(); ++i)
+    {
+        vmaDestroyBuffer(g_hAllocator, bufInfo[i].Buffer, bufInfo[i].Allocation);
+    }
+    bufInfo.clear();
+
+    vmaDestroyPool(g_hAllocator, pool);
+
+    // The flag is valid only together with buddy algorithm.
+    poolCreateInfo.flags = VMA_POOL_CREATE_BUDDY_MULTIPLE_ROOTS_BIT;
+    res = vmaCreatePool(g_hAllocator, &poolCreateInfo, &pool);
+    TEST(res == VK_ERROR_INITIALIZATION_FAILED);
 }
 
 static void BasicTestAllocatePages()
@@ -5103,6 +6877,7 @@ void Test()
     TestLinearAllocator();
     ManuallyTestLinearAllocator();
     TestLinearAllocatorMultiBlock();
+    TestLinearAllocatorFreePerFrame();
 
     BasicTestBuddyAllocator();
     BasicTestAllocatePages();
@@ -5115,9 +6890,21 @@ void Test()
         fclose(file);
     }
 
+    {
+        FILE* file;
+        fopen_s(&file, "Defragmentation.csv", "w");
+        assert(file != NULL);
+        BenchmarkDefragmentation(file);
+        fclose(file);
+    }
+
     TestDefragmentationSimple();
     TestDefragmentationFull();
     TestDefragmentationWholePool();
+    TestDefragmentationEstimate();
+    TestDefragmentationCoalescing();
+    TestDefragmentationLinearAndBuddy();
+    TestAutoDefragmentation();
     TestDefragmentationGpu();
 
     // # Detailed tests
@@ -5138,4 +6925,79 @@ void Test()
     wprintf(L"Done.\n");
 }
 
+void BenchmarkNullDevice()
+{
+    wprintf(L"BENCHMARKING ON NULL DEVICE:\n");
+
+    NullDeviceDesc nullDeviceDesc;
+    GetDefaultNullDeviceDesc(nullDeviceDesc);
+    NullDevice nullDevice(nullDeviceDesc);
+
+    VmaAllocatorCreateInfo allocatorInfo = {};
+    allocatorInfo.physicalDevice = nullDevice.GetPhysicalDevice();
+    allocatorInfo.device = nullDevice.GetDevice();
+    allocatorInfo.pVulkanFunctions = &nullDevice.GetVulkanFunctions();
+    allocatorInfo.pAllocationCallbacks = g_Allocs;
+    allocatorInfo.flags = VMA_ALLOCATOR_CREATE_KHR_DEDICATED_ALLOCATION_BIT;
+
+    VmaAllocator nullDeviceAllocator = VK_NULL_HANDLE;
+    VkResult res = vmaCreateAllocator(&allocatorInfo, &nullDeviceAllocator);
+    TEST(res == VK_SUCCESS);
+
+    // Benchmarks use global handles, so redirect them to the null device for the time being.
+    const VkPhysicalDevice origPhysicalDevice = g_hPhysicalDevice;
+    const VkDevice origDevice = g_hDevice;
+    const VmaAllocator origAllocator = g_hAllocator;
+    g_hPhysicalDevice = nullDevice.GetPhysicalDevice();
+    g_hDevice = nullDevice.GetDevice();
+    g_hAllocator = nullDeviceAllocator;
+    g_pNullDevice = &nullDevice;
+
+    {
+        FILE* file;
+        fopen_s(&file, "NullDevice_Algorithms.csv", "w");
+        TEST(file != NULL);
+        BenchmarkAlgorithms(file);
+        fclose(file);
+    }
+
+    {
+        FILE* file;
+        fopen_s(&file, "NullDevice_Defragmentation.csv", "w");
+        TEST(file != NULL);
+        BenchmarkDefragmentation(file);
+        fclose(file);
+    }
+
+    {
+        FILE* file;
+        fopen_s(&file, "NullDevice_Results.csv", "w");
+        TEST(file != NULL);
+
+        WriteMainTestResultHeader(file);
+        PerformMainTests(file);
+
+        WritePoolTestResultHeader(file);
+        PerformPoolTests(file);
+
+        fclose(file);
+    }
+
+    g_pNullDevice = nullptr;
+    g_hAllocator = origAllocator;
+    g_hDevice = origDevice;
+    g_hPhysicalDevice = origPhysicalDevice;
+
+    vmaDestroyAllocator(nullDeviceAllocator);
+
+    // Everything allocated by the benchmarks must have been returned to the null device.
+    TEST(nullDevice.GetAllocationCount() == 0);
+    for(uint32_t heapIndex = 0; heapIndex < nullDeviceDesc.memoryProperties.memoryHeapCount; ++heapIndex)
+    {
+        TEST(nullDevice.GetHeapUsage(heapIndex) == 0);
+    }
+
+    wprintf(L"Done.\n");
+}
+
 #endif // #ifdef _WIN32
@@ -26,6 +26,8 @@
 #ifdef _WIN32
 
 void Test();
+// Runs benchmarks on built-in null device, without using the GPU.
+void BenchmarkNullDevice();
 
 #endif // #ifdef _WIN32
 
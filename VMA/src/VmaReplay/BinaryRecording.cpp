@@ -0,0 +1,732 @@
+//
+// Copyright (c) 2017-2019 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "BinaryRecording.h"
+#include <algorithm>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+static const char BINARY_RECORDING_MAGIC[8] = { 'V', 'M', 'A', 'R', 'E', 'C', 'B', 'N' };
+static const uint32_t BINARY_RECORDING_VERSION = 1;
+static const size_t BINARY_RECORDING_HEADER_SIZE = 24;
+
+enum BLOCK_TYPE
+{
+    BLOCK_TYPE_THREAD = 1,
+    BLOCK_TYPE_CALLS = 2,
+    BLOCK_TYPE_END = 3,
+    BLOCK_TYPE_STATE = 4,
+};
+
+// Every call is encoded as if it was the first call of its thread. Set in dumps of the flight recorder.
+static const uint32_t HEADER_FLAG_INDEPENDENT_CALLS = 0x1;
+
+/*
+Function name and types of parameters for every operation code, starting from 1.
+Types are described in BinaryRecordingCall::paramTypes. Pools and allocations are
+encoded as differences from the previous pool or allocation of the same thread.
+
+Created is type of parameter that is the handle created by the call, or 0.
+'H' means the call creates an allocation without handle.
+*/
+struct OpDesc
+{
+    const char* functionName;
+    const char* params;
+    char created;
+};
+static const OpDesc OP_DESCS[] = {
+    { "vmaCreateAllocator", "", 0 },
+    { "vmaDestroyAllocator", "", 0 },
+    { "vmaCreatePool", "uuuuuuP", 'P' },
+    { "vmaDestroyPool", "P", 0 },
+    { "vmaAllocateMemory", "uuuuuuuuPAD", 'A' },
+    { "vmaAllocateMemoryPages", "uuuuuuuuPLD", 'L' },
+    { "vmaAllocateMemoryForBuffer", "uuuuuuuuuuPAD", 'A' },
+    { "vmaAllocateMemoryForImage", "uuuuuuuuuuPAD", 'A' },
+    { "vmaFreeMemory", "A", 0 },
+    { "vmaFreeMemoryPages", "L", 0 },
+    { "vmaSetAllocationUserData", "AD", 0 },
+    { "vmaCreateLostAllocation", "A", 'A' },
+    { "vmaMapMemory", "A", 0 },
+    { "vmaUnmapMemory", "A", 0 },
+    { "vmaFlushAllocation", "Auu", 0 },
+    { "vmaInvalidateAllocation", "Auu", 0 },
+    { "vmaCreateBuffer", "uuuuuuuuuPAD", 'A' },
+    { "vmaCreateImage", "uuuuuuuuuuuuuuuuuuPAD", 'A' },
+    { "vmaDestroyBuffer", "A", 0 },
+    { "vmaDestroyImage", "A", 0 },
+    { "vmaTouchAllocation", "A", 0 },
+    { "vmaGetAllocationInfo", "A", 0 },
+    { "vmaMakePoolAllocationsLost", "P", 0 },
+    { "vmaDefragmentationBegin", "uLQuuuuXX", 0 },
+    { "vmaDefragmentationEnd", "X", 0 },
+    { "vmaFreePoolAllocations", "PuuL", 0 },
+    { "vmaAllocateMemoryWithoutHandle", "uuuuuuuuPu", 'H' },
+};
+static const size_t OP_COUNT = sizeof(OP_DESCS) / sizeof(OP_DESCS[0]);
+
+// State of decoding of calls made by single thread. Values are delta-encoded
+// relative to previous call of the same thread.
+struct ThreadState
+{
+    bool announced = false;
+    uint32_t threadId = 0;
+    uint64_t prevCallIndex = 0;
+    int64_t prevTime = 0;
+    uint32_t prevFrameIndex = 0;
+    uint64_t prevAllocation = 0;
+    uint64_t prevPool = 0;
+};
+
+struct CallEntry
+{
+    uint64_t callIndex;
+    // Number of the call passed to BinaryRecordingSink::AddCall.
+    uint32_t callNumber;
+};
+
+// Call describing an object of the state of a flight recorder dump.
+struct DescriptionEntry
+{
+    uint64_t createdHandle; // First handle created by the call, or 0.
+    char created; // OpDesc::created of the call.
+    // For allocation without handle: its pool and frame.
+    uint64_t pool;
+    uint32_t frameIndex;
+};
+
+// Pool and frame index of allocations without handle.
+typedef std::pair<uint64_t, uint32_t> HandlelessKey;
+
+// The earliest call that refers to a handle.
+struct HandleUse
+{
+    uint64_t callIndex;
+    bool created;
+};
+
+class CallDecoder
+{
+public:
+    /*
+    Calls are numbered by pCallCount, which can be shared by several decoders passing calls to the same sink.
+    With describesState, these are calls describing objects of the state, and information
+    needed to choose from them in AppendCallOrder is kept for every call.
+    */
+    CallDecoder(BinaryRecordingSink& sink, uint32_t* pCallCount, double counterFrequency,
+        bool independentCalls, bool describesState) :
+        m_Sink(sink),
+        m_CallCount(*pCallCount),
+        m_CounterFrequency(counterFrequency),
+        m_IndependentCalls(independentCalls),
+        m_DescribesState(describesState)
+    {
+    }
+
+    std::vector<ThreadState>& GetThreads() { return m_Threads; }
+    // Decodes contents of a block of calls of given thread and passes them to the sink.
+    // Returns false if it's invalid or the sink stopped decoding, which is reported in outStopped.
+    bool DecodeCalls(uint32_t threadIndex, const uint8_t* beg, const uint8_t* end, bool& outStopped);
+    /*
+    Appends numbers of decoded calls in their global order.
+    If pWindow is not null, these are calls describing objects of the state. Then only the first
+    description of every handle is taken, pools before allocations, skipping handles that
+    pWindow creates before any other use. Allocations without handle can't be told apart,
+    so in every pool and frame the last ones are skipped, as many as pWindow makes.
+    */
+    void AppendCallOrder(std::vector<uint32_t>& outOrder, const CallDecoder* pWindow);
+    // Returns true if the first decoded call that refers to the handle creates it.
+    bool IsCreatedBeforeUse(uint64_t handle) const
+    {
+        const auto it = m_HandleUses.find(handle);
+        return it != m_HandleUses.end() && it->second.created;
+    }
+    // Returns number of successful calls that allocate without handle in the pool and frame.
+    size_t GetHandlelessAllocationCount(const HandlelessKey& key) const
+    {
+        const auto it = m_HandlelessCounts.find(key);
+        return it != m_HandlelessCounts.end() ? it->second : 0;
+    }
+
+private:
+    BinaryRecordingSink& m_Sink;
+    uint32_t& m_CallCount;
+    const double m_CounterFrequency;
+    // Header of the file has HEADER_FLAG_INDEPENDENT_CALLS.
+    const bool m_IndependentCalls;
+    const bool m_DescribesState;
+    std::vector<ThreadState> m_Threads;
+    std::vector<CallEntry> m_Calls;
+    // Filled only with m_DescribesState, parallel to m_Calls.
+    std::vector<DescriptionEntry> m_Descriptions;
+    // Filled only with m_IndependentCalls.
+    std::unordered_map<uint64_t, HandleUse> m_HandleUses;
+    std::map<HandlelessKey, size_t> m_HandlelessCounts;
+    // Parameters of the call being decoded.
+    std::vector<uint64_t> m_Values;
+    char m_UserDataPtr[17];
+
+    // Called for every handle that is a parameter of the call.
+    void AddHandle(uint64_t callIndex, DescriptionEntry& desc, uint64_t handle, bool created)
+    {
+        if(created && desc.createdHandle == 0)
+        {
+            desc.createdHandle = handle;
+        }
+        if(m_IndependentCalls && handle != 0)
+        {
+            const HandleUse use = { callIndex, created };
+            const auto result = m_HandleUses.emplace(handle, use);
+            if(!result.second && callIndex < result.first->second.callIndex)
+            {
+                result.first->second = use;
+            }
+        }
+    }
+};
+
+static bool ReadVarUint(const uint8_t*& p, const uint8_t* end, uint64_t& out)
+{
+    out = 0;
+    for(uint32_t shift = 0; shift < 64; shift += 7)
+    {
+        if(p == end)
+        {
+            return false;
+        }
+        const uint8_t byte = *p++;
+        out |= (uint64_t)(byte & 0x7F) << shift;
+        if((byte & 0x80) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool ReadVarInt(const uint8_t*& p, const uint8_t* end, int64_t& out)
+{
+    uint64_t zigzag;
+    if(!ReadVarUint(p, end, zigzag))
+    {
+        return false;
+    }
+    out = (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+    return true;
+}
+
+bool CallDecoder::DecodeCalls(uint32_t threadIndex, const uint8_t* p, const uint8_t* end, bool& outStopped)
+{
+    ThreadState& thread = m_Threads[threadIndex];
+    while(p < end)
+    {
+        const uint8_t op = *p++;
+        if(op == 0 || op > OP_COUNT)
+        {
+            printf("ERROR: Unknown operation code %u.\n", (uint32_t)op);
+            return false;
+        }
+        const OpDesc& opDesc = OP_DESCS[op - 1];
+
+        if(m_IndependentCalls)
+        {
+            thread.prevCallIndex = 0;
+            thread.prevTime = 0;
+            thread.prevFrameIndex = 0;
+            thread.prevAllocation = 0;
+            thread.prevPool = 0;
+        }
+
+        uint64_t callIndexDelta;
+        int64_t timeDelta, frameIndexDelta;
+        if(!ReadVarUint(p, end, callIndexDelta) ||
+            !ReadVarInt(p, end, timeDelta) ||
+            !ReadVarInt(p, end, frameIndexDelta))
+        {
+            return false;
+        }
+        thread.prevCallIndex += callIndexDelta;
+        thread.prevTime += timeDelta;
+        thread.prevFrameIndex = (uint32_t)((int64_t)thread.prevFrameIndex + frameIndexDelta);
+
+        BinaryRecordingCall call = {};
+        call.threadId = thread.threadId;
+        call.time = (double)thread.prevTime / m_CounterFrequency;
+        call.frameIndex = thread.prevFrameIndex;
+        call.functionName = opDesc.functionName;
+        call.paramTypes = opDesc.params;
+        call.userData = "";
+
+        DescriptionEntry desc = { 0, opDesc.created, 0, thread.prevFrameIndex };
+        // Value of the last parameter of type 'u', which tells whether allocation succeeded.
+        uint64_t lastUint = 0;
+        m_Values.clear();
+        for(const char* param = opDesc.params; *param != '\0'; ++param)
+        {
+            uint64_t value;
+            int64_t delta;
+            switch(*param)
+            {
+            case 'u':
+            case 'X':
+                if(!ReadVarUint(p, end, value))
+                {
+                    return false;
+                }
+                m_Values.push_back(value);
+                if(*param == 'u')
+                {
+                    lastUint = value;
+                }
+                break;
+            case 'A':
+            case 'P':
+                {
+                    uint64_t& prev = *param == 'A' ? thread.prevAllocation : thread.prevPool;
+                    if(!ReadVarInt(p, end, delta))
+                    {
+                        return false;
+                    }
+                    prev += (uint64_t)delta;
+                    m_Values.push_back(prev);
+                    AddHandle(thread.prevCallIndex, desc, prev, *param == opDesc.created);
+                    if(*param == 'P' && opDesc.created == 'H')
+                    {
+                        desc.pool = prev;
+                    }
+                }
+                break;
+            case 'L':
+            case 'Q':
+                {
+                    uint64_t& prev = *param == 'L' ? thread.prevAllocation : thread.prevPool;
+                    uint64_t count;
+                    if(!ReadVarUint(p, end, count) || count > (uint64_t)(end - p))
+                    {
+                        return false;
+                    }
+                    m_Values.push_back(count);
+                    for(uint64_t i = 0; i < count; ++i)
+                    {
+                        if(!ReadVarInt(p, end, delta))
+                        {
+                            return false;
+                        }
+                        prev += (uint64_t)delta;
+                        m_Values.push_back(prev);
+                        AddHandle(thread.prevCallIndex, desc, prev, *param == opDesc.created);
+                    }
+                }
+                break;
+            case 'D':
+                if(!ReadVarUint(p, end, value))
+                {
+                    return false;
+                }
+                if(value == 1)
+                {
+                    if(!ReadVarUint(p, end, value))
+                    {
+                        return false;
+                    }
+                    snprintf(m_UserDataPtr, sizeof(m_UserDataPtr), "%016llX", (unsigned long long)value);
+                    call.userData = m_UserDataPtr;
+                    call.userDataLength = strlen(m_UserDataPtr);
+                }
+                else if(value == 2)
+                {
+                    uint64_t strLen;
+                    if(!ReadVarUint(p, end, strLen) || strLen > (uint64_t)(end - p))
+                    {
+                        return false;
+                    }
+                    call.userData = (const char*)p;
+                    call.userDataLength = (size_t)strLen;
+                    p += strLen;
+                }
+                else if(value != 0)
+                {
+                    return false;
+                }
+                break;
+            default:
+                return false;
+            }
+        }
+        call.values = m_Values.data();
+
+        if(m_CallCount == UINT32_MAX || !m_Sink.AddCall(call))
+        {
+            outStopped = true;
+            return false;
+        }
+        const CallEntry entry = { thread.prevCallIndex, m_CallCount++ };
+        m_Calls.push_back(entry);
+        if(m_DescribesState)
+        {
+            m_Descriptions.push_back(desc);
+        }
+        if(m_IndependentCalls && opDesc.created == 'H' && lastUint != 0)
+        {
+            ++m_HandlelessCounts[HandlelessKey(desc.pool, desc.frameIndex)];
+        }
+    }
+    return true;
+}
+
+void CallDecoder::AppendCallOrder(std::vector<uint32_t>& outOrder, const CallDecoder* pWindow)
+{
+    // Calls of every thread are already sorted by their sequence numbers, so this is mostly merging.
+    std::vector<uint32_t> sorted(m_Calls.size());
+    for(uint32_t i = 0; i < (uint32_t)sorted.size(); ++i)
+    {
+        sorted[i] = i;
+    }
+    std::stable_sort(sorted.begin(), sorted.end(),
+        [this](uint32_t lhs, uint32_t rhs) { return m_Calls[lhs].callIndex < m_Calls[rhs].callIndex; });
+
+    if(pWindow == nullptr)
+    {
+        outOrder.reserve(outOrder.size() + sorted.size());
+        for(size_t i = 0; i < sorted.size(); ++i)
+        {
+            outOrder.push_back(m_Calls[sorted[i]].callNumber);
+        }
+        return;
+    }
+
+    assert(m_DescribesState);
+    std::unordered_set<uint64_t> describedHandles;
+    // Descriptions of allocations without handle left to take in every pool and frame.
+    std::map<HandlelessKey, size_t> handlelessToTake;
+    for(const DescriptionEntry& desc : m_Descriptions)
+    {
+        if(desc.created == 'H')
+        {
+            ++handlelessToTake[HandlelessKey(desc.pool, desc.frameIndex)];
+        }
+    }
+    for(auto& it : handlelessToTake)
+    {
+        it.second -= std::min(it.second, pWindow->GetHandlelessAllocationCount(it.first));
+    }
+    // Descriptions of pools are taken in the first pass, as allocations refer to them.
+    for(int pass = 0; pass < 2; ++pass)
+    {
+        for(size_t i = 0; i < sorted.size(); ++i)
+        {
+            const DescriptionEntry& desc = m_Descriptions[sorted[i]];
+            if((desc.created == 'P') != (pass == 0) ||
+                (desc.created != 'H' &&
+                    (desc.createdHandle == 0 ||
+                    pWindow->IsCreatedBeforeUse(desc.createdHandle) ||
+                    !describedHandles.insert(desc.createdHandle).second)))
+            {
+                continue;
+            }
+            if(desc.created == 'H')
+            {
+                size_t& toTake = handlelessToTake[HandlelessKey(desc.pool, desc.frameIndex)];
+                if(toTake == 0)
+                {
+                    continue;
+                }
+                --toTake;
+            }
+            outOrder.push_back(m_Calls[sorted[i]].callNumber);
+        }
+    }
+}
+
+bool IsBinaryRecording(const char* data, size_t numBytes)
+{
+    return numBytes >= sizeof(BINARY_RECORDING_MAGIC) &&
+        memcmp(data, BINARY_RECORDING_MAGIC, sizeof(BINARY_RECORDING_MAGIC)) == 0;
+}
+
+BinaryRecordingDecoder::BinaryRecordingDecoder(BinaryRecordingSink& sink) :
+    m_Sink(sink)
+{
+}
+
+BinaryRecordingDecoder::~BinaryRecordingDecoder()
+{
+}
+
+bool BinaryRecordingDecoder::Decode(const char* data, size_t numBytes)
+{
+    assert(m_Stage != STAGE_FINISHED);
+    if(m_Stage == STAGE_ENDED || m_Stage == STAGE_CORRUPTED)
+    {
+        // Following data is ignored.
+        return true;
+    }
+
+    // Data is decoded in place, unless there is a pending part to be completed.
+    size_t consumed = 0;
+    if(m_Pending.empty())
+    {
+        if(!DecodeData(data, data + numBytes, consumed))
+        {
+            return false;
+        }
+        m_Pending.assign(data + consumed, data + numBytes);
+    }
+    else
+    {
+        m_Pending.insert(m_Pending.end(), data, data + numBytes);
+        if(!DecodeData(m_Pending.data(), m_Pending.data() + m_Pending.size(), consumed))
+        {
+            return false;
+        }
+        m_Pending.erase(m_Pending.begin(), m_Pending.begin() + consumed);
+    }
+    m_Offset += consumed;
+    if(m_Stage == STAGE_ENDED || m_Stage == STAGE_CORRUPTED)
+    {
+        std::vector<char>().swap(m_Pending);
+    }
+    return true;
+}
+
+bool BinaryRecordingDecoder::DecodeData(const char* beg, const char* end, size_t& outConsumed)
+{
+    const char* p = beg;
+    outConsumed = 0;
+    if(m_Stage == STAGE_HEADER)
+    {
+        if(end - p < (ptrdiff_t)BINARY_RECORDING_HEADER_SIZE)
+        {
+            return true;
+        }
+        uint32_t version = 0;
+        uint32_t flags = 0;
+        uint64_t counterFrequency = 0;
+        memcpy(&version, p + 8, sizeof(version));
+        memcpy(&flags, p + 12, sizeof(flags));
+        memcpy(&counterFrequency, p + 16, sizeof(counterFrequency));
+        if(!IsBinaryRecording(p, BINARY_RECORDING_HEADER_SIZE) ||
+            version != BINARY_RECORDING_VERSION || counterFrequency == 0)
+        {
+            printf("ERROR: Incorrect binary file header.\n");
+            return false;
+        }
+
+        const bool independentCalls = (flags & HEADER_FLAG_INDEPENDENT_CALLS) != 0;
+        m_Decoder.reset(new CallDecoder(m_Sink, &m_CallCount, (double)counterFrequency, independentCalls, false));
+        m_StateDecoder.reset(new CallDecoder(m_Sink, &m_CallCount, (double)counterFrequency, independentCalls, true));
+        m_StateDecoder->GetThreads().resize(1);
+        m_StateDecoder->GetThreads()[0].announced = true;
+        p += BINARY_RECORDING_HEADER_SIZE;
+        outConsumed = p - beg;
+        m_Stage = STAGE_CONFIG;
+    }
+
+    if(m_Stage == STAGE_CONFIG)
+    {
+        // Configuration is stored as text, the same as in CSV format.
+        static const char CONFIG_END[] = "Config,End\n";
+        static const size_t CONFIG_END_LEN = sizeof(CONFIG_END) - 1;
+        const char* const searchBeg = p + std::min<size_t>(m_ConfigSearchedSize, end - p);
+        const char* configEnd = std::search(searchBeg, end, CONFIG_END, CONFIG_END + CONFIG_END_LEN);
+        if(configEnd == end)
+        {
+            // End of configuration may be split between parts.
+            m_ConfigSearchedSize = std::max<size_t>(end - p, CONFIG_END_LEN - 1) - (CONFIG_END_LEN - 1);
+            return true;
+        }
+        configEnd += CONFIG_END_LEN;
+        m_Sink.SetConfiguration(p, configEnd);
+        p = configEnd;
+        outConsumed = p - beg;
+        m_Stage = STAGE_BLOCKS;
+    }
+
+    if(m_Stage == STAGE_BLOCKS)
+    {
+        size_t blocksConsumed = 0;
+        const bool ok = DecodeBlocks(p, end, m_Offset + outConsumed, blocksConsumed);
+        outConsumed += blocksConsumed;
+        return ok;
+    }
+    return true;
+}
+
+bool BinaryRecordingDecoder::DecodeBlocks(const char* beg, const char* end, size_t begOffset, size_t& outConsumed)
+{
+    std::vector<ThreadState>& threads = m_Decoder->GetThreads();
+    const uint8_t* const blocksBeg = (const uint8_t*)beg;
+    const uint8_t* const blocksEnd = (const uint8_t*)end;
+    const uint8_t* blockBeg = blocksBeg;
+    const uint8_t* p = blocksBeg;
+    // Block that isn't complete waits for the next part, unless it's corrupted.
+    bool incomplete = false;
+    bool corrupted = false;
+    bool stopped = false;
+    while(p < blocksEnd)
+    {
+        blockBeg = p;
+        const uint8_t blockType = *p++;
+        uint64_t threadIndex = 0;
+        if(blockType == BLOCK_TYPE_END)
+        {
+            m_Stage = STAGE_ENDED;
+            break;
+        }
+        if(blockType == BLOCK_TYPE_STATE)
+        {
+            uint64_t size;
+            if(!ReadVarUint(p, blocksEnd, size))
+            {
+                // Number longer than 64 bits is corrupted, otherwise it's incomplete.
+                corrupted = p < blocksEnd;
+                incomplete = !corrupted;
+                break;
+            }
+            if(size > (uint64_t)(blocksEnd - p))
+            {
+                incomplete = true;
+                break;
+            }
+            if(!m_StateDecoder->DecodeCalls(0, p, p + size, stopped))
+            {
+                if(!stopped)
+                {
+                    printf("ERROR: Invalid block of state at offset %zu.\n", begOffset + (size_t)(p - blocksBeg));
+                }
+                return false;
+            }
+            p += size;
+            continue;
+        }
+        if(blockType != BLOCK_TYPE_THREAD && blockType != BLOCK_TYPE_CALLS)
+        {
+            corrupted = true;
+            break;
+        }
+        if(!ReadVarUint(p, blocksEnd, threadIndex))
+        {
+            corrupted = p < blocksEnd;
+            incomplete = !corrupted;
+            break;
+        }
+        if(threadIndex > UINT32_MAX)
+        {
+            corrupted = true;
+            break;
+        }
+        if(threadIndex >= threads.size())
+        {
+            threads.resize((size_t)threadIndex + 1);
+        }
+        ThreadState& thread = threads[(size_t)threadIndex];
+
+        uint64_t value;
+        if(!ReadVarUint(p, blocksEnd, value))
+        {
+            corrupted = p < blocksEnd;
+            incomplete = !corrupted;
+            break;
+        }
+        if(blockType == BLOCK_TYPE_THREAD)
+        {
+            thread.announced = true;
+            thread.threadId = (uint32_t)value;
+        }
+        else
+        {
+            if(!thread.announced)
+            {
+                printf("ERROR: Calls of unknown thread %llu.\n", (unsigned long long)threadIndex);
+                return false;
+            }
+            if(value > (uint64_t)(blocksEnd - p))
+            {
+                incomplete = true;
+                break;
+            }
+            if(!m_Decoder->DecodeCalls((uint32_t)threadIndex, p, p + value, stopped))
+            {
+                if(!stopped)
+                {
+                    printf("ERROR: Invalid block of calls at offset %zu.\n", begOffset + (size_t)(p - blocksBeg));
+                }
+                return false;
+            }
+            p += value;
+        }
+    }
+
+    // If the file ends here, it's truncated at the place where decoding stopped.
+    m_StopOffset = begOffset + (size_t)(p - blocksBeg);
+    if(corrupted)
+    {
+        m_Stage = STAGE_CORRUPTED;
+    }
+    outConsumed = (size_t)((incomplete ? blockBeg : p) - blocksBeg);
+    return true;
+}
+
+bool BinaryRecordingDecoder::Finish()
+{
+    assert(m_Stage != STAGE_FINISHED);
+    if(m_Stage == STAGE_HEADER)
+    {
+        printf("ERROR: Incorrect binary file header.\n");
+        return false;
+    }
+    if(m_Stage == STAGE_CONFIG)
+    {
+        printf("ERROR: Configuration not found.\n");
+        return false;
+    }
+    if(m_Stage != STAGE_ENDED)
+    {
+        printf("WARNING: Binary file is truncated or corrupted at offset %zu. Following calls are ignored.\n",
+            m_StopOffset);
+    }
+    m_Stage = STAGE_FINISHED;
+    std::vector<char>().swap(m_Pending);
+
+    // Objects created by recorded calls before any other use don't need to be created in advance.
+    std::vector<uint32_t> order;
+    m_StateDecoder->AppendCallOrder(order, m_Decoder.get());
+    m_Decoder->AppendCallOrder(order, nullptr);
+    // Decoded calls are no longer needed while the sink puts them in order.
+    m_StateDecoder.reset();
+    m_Decoder.reset();
+    m_Sink.SetCallOrder(order);
+    return true;
+}
+
+bool DecodeBinaryRecording(const char* data, size_t numBytes, BinaryRecordingSink& sink)
+{
+    BinaryRecordingDecoder decoder(sink);
+    return decoder.Decode(data, numBytes) && decoder.Finish();
+}
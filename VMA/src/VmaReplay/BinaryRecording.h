@@ -0,0 +1,134 @@
+//
+// Copyright (c) 2017-2019 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+/*
+Support for recording files written by VMA with VMA_RECORD_BINARY_FORMAT_BIT.
+Calls are decoded straight into the form used by the application, with parameters
+in the same order and meaning as columns of CSV format version 1.7, without
+converting the file to text.
+*/
+
+// Returns true if data starts with the signature of a recording file in binary format.
+bool IsBinaryRecording(const char* data, size_t numBytes);
+
+// Call decoded from a recording file in binary format.
+struct BinaryRecordingCall
+{
+    uint32_t threadId;
+    // In seconds.
+    double time;
+    uint32_t frameIndex;
+    const char* functionName;
+    /*
+    Types of parameters, in the same order as in CSV format:
+
+    u - unsigned number
+    P - VmaPool
+    A - VmaAllocation
+    X - other pointer
+    L - list of VmaAllocation
+    Q - list of VmaPool
+    D - pUserData, always last
+    */
+    const char* paramTypes;
+    // Values of parameters other than D, in their order. Lists are number of elements followed by the elements.
+    const uint64_t* values;
+    // Parameter D as text, the same as in CSV format: empty if null, pointer as hexadecimal number, or the string.
+    const char* userData;
+    size_t userDataLength;
+};
+
+// Receives contents of a recording file in binary format from BinaryRecordingDecoder.
+class BinaryRecordingSink
+{
+public:
+    virtual ~BinaryRecordingSink() { }
+    // Receives lines of configuration in CSV format, from "Config,Begin" to "Config,End".
+    virtual void SetConfiguration(const char* beg, const char* end) = 0;
+    // Receives every call in the order in which calls appear in the file. Returns false to stop decoding.
+    virtual bool AddCall(const BinaryRecordingCall& call) = 0;
+    /*
+    Receives the order in which calls were made, as numbers of calls passed to AddCall,
+    starting from 0. Calls of different threads are merged by their sequence numbers.
+    Calls that are not in the order are to be dropped.
+    */
+    virtual void SetCallOrder(const std::vector<uint32_t>& order) = 0;
+};
+
+class CallDecoder;
+
+/*
+Decodes recording file in binary format, given in consecutive parts, e.g. as it
+is decompressed. Parts can be split anywhere. Blocks of calls are passed to the
+sink as soon as they are complete, so only a block split between parts is copied.
+File truncated at the end, e.g. because the application crashed, is accepted
+with a warning.
+Dump of a flight recorder starts with calls that create pools and allocations
+which existed before its first call, all with thread ID 0 and time 0.
+*/
+class BinaryRecordingDecoder
+{
+public:
+    explicit BinaryRecordingDecoder(BinaryRecordingSink& sink);
+    ~BinaryRecordingDecoder();
+
+    // Decodes next part of the file.
+    // Returns false and prints error message if the file is invalid or the sink stopped decoding.
+    bool Decode(const char* data, size_t numBytes);
+    // Must be called after the last part. Passes order of calls to the sink.
+    // Returns false and prints error message if the file is invalid.
+    bool Finish();
+
+private:
+    enum STAGE { STAGE_HEADER, STAGE_CONFIG, STAGE_BLOCKS, STAGE_ENDED, STAGE_CORRUPTED, STAGE_FINISHED };
+
+    BinaryRecordingSink& m_Sink;
+    STAGE m_Stage = STAGE_HEADER;
+    // Header, configuration, or block that is not complete yet.
+    std::vector<char> m_Pending;
+    // Offset in the file of the beginning of m_Pending.
+    size_t m_Offset = 0;
+    // Number of bytes of m_Pending already searched for end of configuration.
+    size_t m_ConfigSearchedSize = 0;
+    // Offset in the file where decoding of blocks stopped, for the warning.
+    size_t m_StopOffset = 0;
+    uint32_t m_CallCount = 0;
+    std::unique_ptr<CallDecoder> m_Decoder;
+    // Objects that existed before the first call of a dump of the flight recorder, described as calls of thread 0.
+    std::unique_ptr<CallDecoder> m_StateDecoder;
+
+    // Decodes as much of the data as possible and returns in outConsumed the number of bytes
+    // that don't need to be kept for the next part.
+    bool DecodeData(const char* beg, const char* end, size_t& outConsumed);
+    bool DecodeBlocks(const char* beg, const char* end, size_t begOffset, size_t& outConsumed);
+};
+
+// Decodes recording file in binary format that is entirely in memory. See BinaryRecordingDecoder.
+bool DecodeBinaryRecording(const char* data, size_t numBytes, BinaryRecordingSink& sink);
@@ -51,6 +51,11 @@ bool StrRangeToPtrList(const StrRange& s, std::vector<uint64_t>& out)
 
 bool LineSplit::GetNextLine(StrRange& out)
 {
+    if(m_Source != nullptr)
+    {
+        Refill();
+    }
+
     if(m_NextLineBeg < m_NumBytes)
     {
         out.beg = m_Data + m_NextLineBeg;
@@ -58,6 +63,15 @@ bool LineSplit::GetNextLine(StrRange& out)
         while(currLineEnd < m_NumBytes && m_Data[currLineEnd] != '\n')
             ++currLineEnd;
         out.end = m_Data + currLineEnd;
+        // Parsing of a number stops at the first character that is not part of it, so an unterminated
+        // last line of data in memory is copied with '\n' appended not to read past the end of data.
+        if(currLineEnd == m_NumBytes && m_Source == nullptr)
+        {
+            m_Buffer.assign(out.beg, out.end);
+            m_Buffer.push_back('\n');
+            out.beg = m_Buffer.data();
+            out.end = out.beg + (m_Buffer.size() - 1);
+        }
         // Ignore trailing '\r' to support Windows end of line.
         if(out.end > out.beg && *(out.end - 1) == '\r')
         {
@@ -65,12 +79,41 @@ bool LineSplit::GetNextLine(StrRange& out)
         }
         m_NextLineBeg = currLineEnd + 1; // Past '\n'
         ++m_NextLineIndex;
+        if(m_LineCopy != nullptr)
+        {
+            m_LineCopy->append(out.beg, out.end);
+            m_LineCopy->push_back('\n');
+        }
         return true;
     }
     else
         return false;
 }
 
+void LineSplit::Refill()
+{
+    while(!m_SourceEnded &&
+        memchr(m_Data + m_NextLineBeg, '\n', m_NumBytes - m_NextLineBeg) == nullptr)
+    {
+        // Move beginning of the line to the beginning of the buffer and append more data after it.
+        const size_t remainingBytes = m_NumBytes - m_NextLineBeg;
+        memmove(m_Buffer.data(), m_Buffer.data() + m_NextLineBeg, remainingBytes);
+        // Last byte is reserved for null terminator, which stops parsing of numbers at the end of data.
+        if(remainingBytes + 1 == m_Buffer.size())
+        {
+            m_Buffer.resize(m_Buffer.size() * 2);
+        }
+        const size_t maxBytes = m_Buffer.size() - 1 - remainingBytes;
+        const size_t bytesRead = m_Source->Read(m_Buffer.data() + remainingBytes, maxBytes);
+        m_SourceEnded = bytesRead < maxBytes;
+
+        m_Data = m_Buffer.data();
+        m_NumBytes = remainingBytes + bytesRead;
+        m_NextLineBeg = 0;
+        m_Buffer[m_NumBytes] = '\0';
+    }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // CsvSplit class
 
@@ -675,25 +718,25 @@ void SecondsToFriendlyStr(float seconds, std::string& out)
     // #.### ns
     if(seconds < 1e-6)
     {
-        sprintf_s(s, "%.3f ns", seconds * 1e9);
+        snprintf(s, sizeof(s), "%.3f ns", seconds * 1e9);
         out += s;
     }
     // #.### us
     else if(seconds < 1e-3)
     {
-        sprintf_s(s, "%.3f us", seconds * 1e6);
+        snprintf(s, sizeof(s), "%.3f us", seconds * 1e6);
         out += s;
     }
     // #.### ms
     else if(seconds < 1.f)
     {
-        sprintf_s(s, "%.3f ms", seconds * 1e3);
+        snprintf(s, sizeof(s), "%.3f ms", seconds * 1e3);
         out += s;
     }
     // #.### s
     else if(seconds < 60.f)
     {
-        sprintf_s(s, "%.3f s", seconds);
+        snprintf(s, sizeof(s), "%.3f s", seconds);
         out += s;
     }
     else
@@ -704,7 +747,7 @@ void SecondsToFriendlyStr(float seconds, std::string& out)
 	    {
 		    uint64_t minutes = seconds_u / 60;
 		    seconds_u -= minutes * 60;
-            sprintf_s(s, "%llu:%02llu min", minutes, seconds_u);
+            snprintf(s, sizeof(s), "%llu:%02llu min", (unsigned long long)minutes, (unsigned long long)seconds_u);
             out += s;
 	    }
 	    // "#:##:## h"
@@ -714,7 +757,7 @@ void SecondsToFriendlyStr(float seconds, std::string& out)
             seconds_u -= minutes * 60;
 		    uint64_t hours = minutes / 60;
 		    minutes -= hours * 60;
-            sprintf_s(s, "%llu:%02llu:%02llu h", hours, minutes, seconds_u);
+            snprintf(s, sizeof(s), "%llu:%02llu:%02llu h", (unsigned long long)hours, (unsigned long long)minutes, (unsigned long long)seconds_u);
             out += s;
 	    }
     }
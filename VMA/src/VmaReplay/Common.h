@@ -41,6 +41,12 @@
 #include <cstdlib>
 #include <cstdio>
 #include <cstdarg>
+#include <cstring>
+#include <cerrno>
+
+#ifndef _countof
+    #define _countof(array) (sizeof(array) / sizeof((array)[0]))
+#endif
 
 typedef std::chrono::high_resolution_clock::time_point time_point;
 typedef std::chrono::high_resolution_clock::duration duration;
@@ -90,23 +96,71 @@ inline bool StrRangeEq(const StrRange& lhs, const char* rhsSz)
         memcmp(lhs.beg, rhsSz, rhsLen) == 0;
 }
 
+/*
+Integer parsers below are called for several columns of every line of the
+recording, so they are written by hand instead of using strtoul/strtoull, which
+need to check locale, whitespace, sign and errno. They accept digits only and
+fail on overflow. Empty string gives 0, same as before.
+*/
+template<typename T>
+inline bool StrRangeToUintImpl(const StrRange& s, T& out)
+{
+    static const T maxDiv10 = std::numeric_limits<T>::max() / 10;
+    static const T maxMod10 = std::numeric_limits<T>::max() % 10;
+    T val = 0;
+    for(const char* p = s.beg; p != s.end; ++p)
+    {
+        const T digit = (T)(unsigned char)(*p - '0');
+        if(digit > 9 || val > maxDiv10 || (val == maxDiv10 && digit > maxMod10))
+        {
+            return false;
+        }
+        val = val * 10 + digit;
+    }
+    out = val;
+    return true;
+}
 inline bool StrRangeToUint(const StrRange& s, uint32_t& out)
 {
-    char* end = (char*)s.end;
-    out = (uint32_t)strtoul(s.beg, &end, 10);
-    return end == s.end;
+    return StrRangeToUintImpl(s, out);
 }
 inline bool StrRangeToUint(const StrRange& s, uint64_t& out)
 {
-    char* end = (char*)s.end;
-    out = (uint64_t)strtoull(s.beg, &end, 10);
-    return end == s.end;
+    return StrRangeToUintImpl(s, out);
 }
+// Parses hexadecimal number, optionally prefixed with "0x", as written by "%p".
 inline bool StrRangeToPtr(const StrRange& s, uint64_t& out)
 {
-    char* end = (char*)s.end;
-    out = (uint64_t)strtoull(s.beg, &end, 16);
-    return end == s.end;
+    const char* p = s.beg;
+    if(s.length() >= 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X'))
+    {
+        p += 2;
+        if(p == s.end)
+        {
+            return false;
+        }
+    }
+    uint64_t val = 0;
+    for(; p != s.end; ++p)
+    {
+        uint64_t digit = (uint64_t)(unsigned char)(*p - '0');
+        if(digit > 9)
+        {
+            // Maps both 'a'..'f' and 'A'..'F' to 10..15.
+            digit = (uint64_t)(unsigned char)((*p | 0x20) - 'a') + 10;
+            if(digit > 15)
+            {
+                return false;
+            }
+        }
+        if(val >> 60)
+        {
+            return false;
+        }
+        val = (val << 4) | digit;
+    }
+    out = val;
+    return true;
 }
 inline bool StrRangeToFloat(const StrRange& s, float& out)
 {
@@ -140,6 +194,19 @@ inline bool StrRangeToBool(const StrRange& s, bool& out)
 }
 bool StrRangeToPtrList(const StrRange& s, std::vector<uint64_t>& out);
 
+// Source of data that is produced incrementally, e.g. decompressed while reading a file.
+class LineSource
+{
+public:
+    virtual ~LineSource() { }
+    // Returns number of bytes written to dst, less than maxBytes only at the end of data.
+    virtual size_t Read(char* dst, size_t maxBytes) = 0;
+    // Starts reading from the beginning of data. Returns false if it's not possible.
+    virtual bool Rewind() { return false; }
+    // Returns true if the data couldn't be read. Error message was already printed.
+    virtual bool HasFailed() const { return false; }
+};
+
 class LineSplit
 {
 public:
@@ -150,15 +217,41 @@ public:
         m_NextLineIndex(0)
     {
     }
+    // Reads data from the source on demand. Lines returned are valid only until the next call to GetNextLine.
+    // Optional prefix is data already read from the source, which precedes the rest of it.
+    explicit LineSplit(LineSource& source, const char* prefix = nullptr, size_t prefixSize = 0) :
+        m_Data(nullptr),
+        m_NumBytes(prefixSize),
+        m_NextLineBeg(0),
+        m_NextLineIndex(0),
+        m_Source(&source),
+        m_Buffer(std::max<size_t>(1024 * 1024, prefixSize + 1))
+    {
+        if(prefixSize > 0)
+        {
+            memcpy(m_Buffer.data(), prefix, prefixSize);
+        }
+        m_Data = m_Buffer.data();
+    }
 
     bool GetNextLine(StrRange& out);
     size_t GetNextLineIndex() const { return m_NextLineIndex; }
+    // While set, lines returned by GetNextLine are also appended to this string, each followed by '\n'.
+    void SetLineCopy(std::string* dst) { m_LineCopy = dst; }
 
 private:
-    const char* const m_Data;
-    const size_t m_NumBytes;
+    const char* m_Data;
+    size_t m_NumBytes;
     size_t m_NextLineBeg;
     size_t m_NextLineIndex;
+
+    LineSource* m_Source = nullptr;
+    bool m_SourceEnded = false;
+    std::vector<char> m_Buffer;
+    std::string* m_LineCopy = nullptr;
+
+    // Makes sure the next line is entirely in the buffer, unless the source has ended.
+    void Refill();
 };
 
 class CsvSplit
@@ -0,0 +1,1142 @@
+//
+// Copyright (c) 2017-2019 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "CompiledRecording.h"
+#include "BinaryRecording.h"
+#include "FileInput.h"
+#include <unordered_map>
+
+const uint32_t CompiledRecording::NULL_INDEX;
+
+// Columns before function parameters: thread ID, time, frame index, function name.
+static const size_t FIRST_PARAM_INDEX = 4;
+
+static const char* const COMPILED_PARAM_TYPES[] = {
+    "uuUUUuP", // vmaCreatePool
+    "P", // vmaDestroyPool
+    "AD", // vmaSetAllocationUserData
+    "uUuuuuuuuPAD", // vmaCreateBuffer
+    "A", // vmaDestroyBuffer
+    "uuuuuuuuuuuuuuuuuuPAD", // vmaCreateImage
+    "A", // vmaDestroyImage
+    "A", // vmaFreeMemory
+    "L", // vmaFreeMemoryPages
+    "A", // vmaCreateLostAllocation
+    "UUuuuuuuPAD", // vmaAllocateMemory
+    "UUuuuuuuPLD", // vmaAllocateMemoryPages
+    "UUuubbuuuuPAD", // vmaAllocateMemoryForBuffer
+    "UUuubbuuuuPAD", // vmaAllocateMemoryForImage
+    "A", // vmaMapMemory
+    "A", // vmaUnmapMemory
+    "AUU", // vmaFlushAllocation
+    "AUU", // vmaInvalidateAllocation
+    "A", // vmaTouchAllocation
+    "A", // vmaGetAllocationInfo
+    "P", // vmaMakePoolAllocationsLost
+    "AU", // vmaResizeAllocation
+    "uLQUuUuXC", // vmaDefragmentationBegin
+    "C", // vmaDefragmentationEnd
+    "", // vmaCreateAllocator
+    "", // vmaDestroyAllocator
+    "PuUL", // vmaFreePoolAllocations
+    "UUuuuuuuPb", // vmaAllocateMemoryWithoutHandle
+};
+static_assert(
+    _countof(COMPILED_PARAM_TYPES) == (size_t)VMA_FUNCTION::Count,
+    "COMPILED_PARAM_TYPES array doesn't match VMA_FUNCTION enum.");
+
+const char* GetCompiledParamTypes(VMA_FUNCTION func)
+{
+    assert(func < VMA_FUNCTION::Count);
+    return COMPILED_PARAM_TYPES[(size_t)func];
+}
+
+void CompiledRecording::Clear()
+{
+    prologue.clear();
+    lineCount = 0;
+    lines.clear();
+    params.clear();
+    strings.clear();
+    threadIds.clear();
+    pools.clear();
+    allocations.clear();
+    defragmentationContexts.clear();
+}
+
+size_t CompiledRecording::GetMemorySize() const
+{
+    return prologue.size() +
+        lines.size() * sizeof(CompiledLine) +
+        params.size() * sizeof(uint32_t) +
+        strings.size() +
+        threadIds.size() * sizeof(uint32_t) +
+        (pools.size() + allocations.size() + defragmentationContexts.size()) * sizeof(uint64_t);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// class RecordingCompiler
+
+class RecordingCompiler
+{
+public:
+    explicit RecordingCompiler(CompiledRecording& recording) : m_Recording(recording) { }
+
+    // Returns false if the recording became too large.
+    bool CompileLine(size_t lineNumber, const StrRange& line);
+    // Line number is assigned later, by ReorderLines.
+    bool CompileCall(const BinaryRecordingCall& call);
+    /*
+    Puts lines in the given order, as their indices, dropping the others, and numbers
+    them starting from firstLineNumber. Thread indices are assigned again in the order
+    of the first line of every thread, as if lines were compiled in this order.
+    Must be the last call, as other lines can't be compiled after it.
+    */
+    void ReorderLines(const std::vector<uint32_t>& order, size_t firstLineNumber);
+
+private:
+    // Maps original value to its index.
+    typedef std::unordered_map<uint64_t, uint32_t> IndexMap;
+
+    CompiledRecording& m_Recording;
+    CsvSplit m_CsvSplit;
+    IndexMap m_ThreadIndices;
+    IndexMap m_PoolIndices;
+    IndexMap m_AllocationIndices;
+    IndexMap m_DefragmentationContextIndices;
+    std::vector<uint64_t> m_PtrList;
+    bool m_TooLarge = false;
+
+    uint32_t GetThreadIndex(uint32_t threadId);
+    uint32_t GetIndex(IndexMap& indices, uint64_t value);
+    uint32_t GetPtrIndex(IndexMap& indices, std::vector<uint64_t>& ptrs, uint64_t ptr);
+    void PushUint64(uint64_t value);
+    // Returns false if parameters are invalid.
+    bool CompileParams(const char* types);
+    bool CompileCallParams(const char* types, const BinaryRecordingCall& call);
+    // Returns false if the recording became too large.
+    bool IsSizeValid() const;
+};
+
+bool RecordingCompiler::CompileLine(size_t lineNumber, const StrRange& line)
+{
+    CompiledLine compiledLine = {};
+    compiledLine.lineNumber = lineNumber;
+    compiledLine.paramOffset = (uint32_t)m_Recording.params.size();
+    compiledLine.threadIndex = CompiledRecording::NULL_INDEX;
+
+    m_CsvSplit.Set(line);
+    if(m_CsvSplit.GetCount() >= FIRST_PARAM_INDEX)
+    {
+        uint32_t threadId;
+        if(StrRangeToUint(m_CsvSplit.GetRange(0), threadId))
+        {
+            compiledLine.threadIndex = GetThreadIndex(threadId);
+        }
+
+        if(StrRangeToFloat(m_CsvSplit.GetRange(1), compiledLine.time))
+        {
+            compiledLine.flags |= COMPILED_LINE_FLAG_TIME_VALID;
+        }
+        if(StrRangeToUint(m_CsvSplit.GetRange(2), compiledLine.frameIndex))
+        {
+            compiledLine.flags |= COMPILED_LINE_FLAG_FRAME_INDEX_VALID;
+        }
+
+        const StrRange functionName = m_CsvSplit.GetRange(3);
+        const VMA_FUNCTION func = FindVmaFunction(functionName.beg, functionName.length());
+        compiledLine.function = (uint8_t)func;
+        if(func == VMA_FUNCTION::Count)
+        {
+            compiledLine.error = (uint8_t)COMPILED_LINE_ERROR::UNKNOWN_FUNCTION;
+        }
+        else
+        {
+            const char* const types = GetCompiledParamTypes(func);
+            const size_t paramCount = strlen(types);
+            // Last parameter pUserData is optional. So is the last list of allocations, when it's empty.
+            const bool lastUnbound = paramCount > 0 &&
+                (types[paramCount - 1] == 'D' || types[paramCount - 1] == 'L');
+            const bool paramCountValid = lastUnbound ?
+                m_CsvSplit.GetCount() >= FIRST_PARAM_INDEX + paramCount - 1 :
+                m_CsvSplit.GetCount() == FIRST_PARAM_INDEX + paramCount;
+            if(!paramCountValid)
+            {
+                compiledLine.error = (uint8_t)COMPILED_LINE_ERROR::INCORRECT_PARAMETER_COUNT;
+            }
+            else if(!CompileParams(types))
+            {
+                compiledLine.error = (uint8_t)COMPILED_LINE_ERROR::INVALID_PARAMETERS;
+            }
+        }
+    }
+    else
+    {
+        compiledLine.error = (uint8_t)COMPILED_LINE_ERROR::TOO_FEW_COLUMNS;
+    }
+
+    m_Recording.lines.push_back(compiledLine);
+    return IsSizeValid();
+}
+
+bool RecordingCompiler::CompileCall(const BinaryRecordingCall& call)
+{
+    CompiledLine compiledLine = {};
+    compiledLine.paramOffset = (uint32_t)m_Recording.params.size();
+    compiledLine.threadIndex = GetThreadIndex(call.threadId);
+    compiledLine.frameIndex = call.frameIndex;
+    compiledLine.time = (float)call.time;
+    compiledLine.flags = COMPILED_LINE_FLAG_FRAME_INDEX_VALID | COMPILED_LINE_FLAG_TIME_VALID;
+
+    const VMA_FUNCTION func = FindVmaFunction(call.functionName, strlen(call.functionName));
+    compiledLine.function = (uint8_t)func;
+    if(func == VMA_FUNCTION::Count)
+    {
+        compiledLine.error = (uint8_t)COMPILED_LINE_ERROR::UNKNOWN_FUNCTION;
+    }
+    else
+    {
+        const char* const types = GetCompiledParamTypes(func);
+        if(strlen(types) != strlen(call.paramTypes))
+        {
+            compiledLine.error = (uint8_t)COMPILED_LINE_ERROR::INCORRECT_PARAMETER_COUNT;
+        }
+        else if(!CompileCallParams(types, call))
+        {
+            compiledLine.error = (uint8_t)COMPILED_LINE_ERROR::INVALID_PARAMETERS;
+        }
+    }
+
+    m_Recording.lines.push_back(compiledLine);
+    return IsSizeValid();
+}
+
+void RecordingCompiler::ReorderLines(const std::vector<uint32_t>& order, size_t firstLineNumber)
+{
+    std::vector<CompiledLine>& lines = m_Recording.lines;
+    std::vector<uint32_t>& params = m_Recording.params;
+
+    bool ordered = order.size() == lines.size();
+    for(size_t i = 0; ordered && i < order.size(); ++i)
+    {
+        ordered = order[i] == i;
+    }
+    // Parameters are copied too, as they must follow the order of lines, and strings of dropped lines are removed.
+    if(!ordered)
+    {
+        std::vector<char>& strings = m_Recording.strings;
+        std::vector<CompiledLine> newLines;
+        std::vector<uint32_t> newParams;
+        std::vector<char> newStrings;
+        newLines.reserve(order.size());
+        newParams.reserve(params.size());
+        newStrings.reserve(strings.size());
+        for(size_t i = 0; i < order.size(); ++i)
+        {
+            const uint32_t lineIndex = order[i];
+            const CompiledLine& line = lines[lineIndex];
+            const size_t paramBeg = line.paramOffset;
+            const size_t paramEnd = lineIndex + 1 < lines.size() ? lines[lineIndex + 1].paramOffset : params.size();
+            newLines.push_back(line);
+            newLines.back().paramOffset = (uint32_t)newParams.size();
+            newParams.insert(newParams.end(), params.begin() + paramBeg, params.begin() + paramEnd);
+
+            // User data is always the last parameter.
+            if(paramEnd > paramBeg && line.function < (uint8_t)VMA_FUNCTION::Count)
+            {
+                const char* const types = GetCompiledParamTypes((VMA_FUNCTION)line.function);
+                const size_t typeCount = strlen(types);
+                uint32_t& stringOffset = newParams.back();
+                if(typeCount > 0 && types[typeCount - 1] == 'D' && stringOffset != CompiledRecording::NULL_INDEX)
+                {
+                    const char* const str = strings.data() + stringOffset;
+                    stringOffset = (uint32_t)newStrings.size();
+                    newStrings.insert(newStrings.end(), str, str + strlen(str) + 1);
+                }
+            }
+        }
+        lines.swap(newLines);
+        params.swap(newParams);
+        strings.swap(newStrings);
+    }
+
+    std::vector<uint32_t> newThreadIndices(m_Recording.threadIds.size(), CompiledRecording::NULL_INDEX);
+    std::vector<uint32_t> newThreadIds;
+    for(size_t i = 0; i < lines.size(); ++i)
+    {
+        CompiledLine& line = lines[i];
+        line.lineNumber = firstLineNumber + i;
+        if(line.threadIndex != CompiledRecording::NULL_INDEX)
+        {
+            uint32_t& newThreadIndex = newThreadIndices[line.threadIndex];
+            if(newThreadIndex == CompiledRecording::NULL_INDEX)
+            {
+                newThreadIndex = (uint32_t)newThreadIds.size();
+                newThreadIds.push_back(m_Recording.threadIds[line.threadIndex]);
+            }
+            line.threadIndex = newThreadIndex;
+        }
+    }
+    m_Recording.threadIds.swap(newThreadIds);
+}
+
+bool RecordingCompiler::IsSizeValid() const
+{
+    // Offsets and indices must fit in 32 bits and not be equal to NULL_INDEX.
+    const size_t maxCount = CompiledRecording::NULL_INDEX;
+    return !m_TooLarge &&
+        m_Recording.params.size() < maxCount &&
+        m_Recording.strings.size() < maxCount;
+}
+
+uint32_t RecordingCompiler::GetThreadIndex(uint32_t threadId)
+{
+    const size_t threadCount = m_ThreadIndices.size();
+    const uint32_t threadIndex = GetIndex(m_ThreadIndices, threadId);
+    if(m_ThreadIndices.size() > threadCount)
+    {
+        m_Recording.threadIds.push_back(threadId);
+    }
+    return threadIndex;
+}
+
+uint32_t RecordingCompiler::GetIndex(IndexMap& indices, uint64_t value)
+{
+    const auto it = indices.find(value);
+    if(it != indices.end())
+    {
+        return it->second;
+    }
+    const uint32_t index = (uint32_t)indices.size();
+    if(index == CompiledRecording::NULL_INDEX)
+    {
+        m_TooLarge = true;
+    }
+    indices.insert(std::make_pair(value, index));
+    return index;
+}
+
+uint32_t RecordingCompiler::GetPtrIndex(IndexMap& indices, std::vector<uint64_t>& ptrs, uint64_t ptr)
+{
+    if(ptr == 0)
+    {
+        return CompiledRecording::NULL_INDEX;
+    }
+    const uint32_t index = GetIndex(indices, ptr);
+    if(index == ptrs.size())
+    {
+        ptrs.push_back(ptr);
+    }
+    return index;
+}
+
+void RecordingCompiler::PushUint64(uint64_t value)
+{
+    m_Recording.params.push_back((uint32_t)value);
+    m_Recording.params.push_back((uint32_t)(value >> 32));
+}
+
+bool RecordingCompiler::CompileParams(const char* types)
+{
+    std::vector<uint32_t>& params = m_Recording.params;
+    const size_t paramsBegSize = params.size();
+
+    bool ok = true;
+    for(size_t i = 0; ok && types[i] != '\0'; ++i)
+    {
+        const size_t columnIndex = FIRST_PARAM_INDEX + i;
+        if(types[i] == 'D')
+        {
+            if(columnIndex < m_CsvSplit.GetCount())
+            {
+                // String user data can contain commas, so it's the rest of the line.
+                const char* const beg = m_CsvSplit.GetRange(columnIndex).beg;
+                const char* const end = m_CsvSplit.GetLine().end;
+                params.push_back((uint32_t)m_Recording.strings.size());
+                m_Recording.strings.insert(m_Recording.strings.end(), beg, end);
+                m_Recording.strings.push_back('\0');
+            }
+            else
+            {
+                params.push_back(CompiledRecording::NULL_INDEX);
+            }
+            continue;
+        }
+
+        const StrRange column = columnIndex < m_CsvSplit.GetCount() ?
+            m_CsvSplit.GetRange(columnIndex) :
+            StrRange { m_CsvSplit.GetLine().end, m_CsvSplit.GetLine().end };
+        switch(types[i])
+        {
+        case 'u':
+        {
+            uint32_t value = 0;
+            ok = StrRangeToUint(column, value);
+            params.push_back(value);
+            break;
+        }
+        case 'U':
+        {
+            uint64_t value = 0;
+            ok = StrRangeToUint(column, value);
+            PushUint64(value);
+            break;
+        }
+        case 'b':
+        {
+            bool value = false;
+            ok = StrRangeToBool(column, value);
+            params.push_back(value ? 1 : 0);
+            break;
+        }
+        case 'X':
+        {
+            uint64_t value = 0;
+            ok = StrRangeToPtr(column, value);
+            PushUint64(value);
+            break;
+        }
+        case 'P':
+        case 'A':
+        case 'C':
+        {
+            uint64_t ptr = 0;
+            ok = StrRangeToPtr(column, ptr);
+            if(ok)
+            {
+                if(types[i] == 'P')
+                    params.push_back(GetPtrIndex(m_PoolIndices, m_Recording.pools, ptr));
+                else if(types[i] == 'A')
+                    params.push_back(GetPtrIndex(m_AllocationIndices, m_Recording.allocations, ptr));
+                else
+                    params.push_back(GetPtrIndex(m_DefragmentationContextIndices, m_Recording.defragmentationContexts, ptr));
+            }
+            break;
+        }
+        case 'L':
+        case 'Q':
+            ok = StrRangeToPtrList(column, m_PtrList);
+            if(ok)
+            {
+                params.push_back((uint32_t)m_PtrList.size());
+                for(size_t j = 0; j < m_PtrList.size(); ++j)
+                {
+                    if(types[i] == 'L')
+                        params.push_back(GetPtrIndex(m_AllocationIndices, m_Recording.allocations, m_PtrList[j]));
+                    else
+                        params.push_back(GetPtrIndex(m_PoolIndices, m_Recording.pools, m_PtrList[j]));
+                }
+            }
+            break;
+        default:
+            assert(0);
+            ok = false;
+        }
+    }
+
+    if(!ok)
+    {
+        // User data is always last, so it wasn't added.
+        params.resize(paramsBegSize);
+    }
+    return ok;
+}
+
+bool RecordingCompiler::CompileCallParams(const char* types, const BinaryRecordingCall& call)
+{
+    std::vector<uint32_t>& params = m_Recording.params;
+    const size_t paramsBegSize = params.size();
+    const uint64_t* value = call.values;
+
+    bool ok = true;
+    for(size_t i = 0; ok && types[i] != '\0'; ++i)
+    {
+        // Types of the binary format tell only the kind of value, so they are checked against the compiled ones.
+        const char binaryType = call.paramTypes[i];
+        switch(types[i])
+        {
+        case 'u':
+            ok = binaryType == 'u' && *value <= UINT32_MAX;
+            params.push_back((uint32_t)*value++);
+            break;
+        case 'U':
+            ok = binaryType == 'u';
+            PushUint64(*value++);
+            break;
+        case 'b':
+            ok = binaryType == 'u' && *value <= 1;
+            params.push_back((uint32_t)*value++);
+            break;
+        case 'X':
+            ok = binaryType == 'X';
+            PushUint64(*value++);
+            break;
+        case 'P':
+        case 'A':
+        case 'C':
+            ok = binaryType == (types[i] == 'C' ? 'X' : types[i]);
+            if(types[i] == 'P')
+                params.push_back(GetPtrIndex(m_PoolIndices, m_Recording.pools, *value++));
+            else if(types[i] == 'A')
+                params.push_back(GetPtrIndex(m_AllocationIndices, m_Recording.allocations, *value++));
+            else
+                params.push_back(GetPtrIndex(m_DefragmentationContextIndices, m_Recording.defragmentationContexts, *value++));
+            break;
+        case 'L':
+        case 'Q':
+            ok = binaryType == types[i];
+            if(ok)
+            {
+                const uint64_t count = *value++;
+                params.push_back((uint32_t)count);
+                for(uint64_t j = 0; j < count; ++j)
+                {
+                    if(types[i] == 'L')
+                        params.push_back(GetPtrIndex(m_AllocationIndices, m_Recording.allocations, *value++));
+                    else
+                        params.push_back(GetPtrIndex(m_PoolIndices, m_Recording.pools, *value++));
+                }
+            }
+            break;
+        case 'D':
+            // Empty user data is the same as missing last column of CSV format.
+            ok = binaryType == 'D';
+            if(call.userDataLength > 0)
+            {
+                params.push_back((uint32_t)m_Recording.strings.size());
+                m_Recording.strings.insert(m_Recording.strings.end(), call.userData, call.userData + call.userDataLength);
+                m_Recording.strings.push_back('\0');
+            }
+            else
+            {
+                params.push_back(CompiledRecording::NULL_INDEX);
+            }
+            break;
+        default:
+            assert(0);
+            ok = false;
+        }
+    }
+
+    if(!ok)
+    {
+        params.resize(paramsBegSize);
+    }
+    return ok;
+}
+
+bool CompileRecording(LineSplit& lineSplit, CompiledRecording& outRecording)
+{
+    assert(outRecording.lines.empty());
+
+    RecordingCompiler compiler(outRecording);
+    StrRange line;
+    while(lineSplit.GetNextLine(line))
+    {
+        if(!compiler.CompileLine(lineSplit.GetNextLineIndex(), line))
+        {
+            printf("ERROR: Recording is too large to be compiled.\n");
+            return false;
+        }
+    }
+    outRecording.lineCount = lineSplit.GetNextLineIndex();
+    return true;
+}
+
+// Compiles calls received from DecodeBinaryRecording.
+class BinaryRecordingCompiler : public BinaryRecordingSink
+{
+public:
+    explicit BinaryRecordingCompiler(CompiledRecording& recording) :
+        m_Recording(recording),
+        m_Compiler(recording)
+    {
+    }
+
+    virtual void SetConfiguration(const char* beg, const char* end)
+    {
+        static const char CSV_HEADER[] = "Vulkan Memory Allocator,Calls recording\n1,7\n";
+        m_Recording.prologue.assign(CSV_HEADER);
+        m_Recording.prologue.append(beg, end);
+    }
+    virtual bool AddCall(const BinaryRecordingCall& call)
+    {
+        if(!m_Compiler.CompileCall(call))
+        {
+            printf("ERROR: Recording is too large to be compiled.\n");
+            return false;
+        }
+        return true;
+    }
+    virtual void SetCallOrder(const std::vector<uint32_t>& order)
+    {
+        // Calls follow the prologue, as lines of the equivalent file in CSV format.
+        const size_t prologueLineCount = (size_t)std::count(m_Recording.prologue.begin(), m_Recording.prologue.end(), '\n');
+        m_Compiler.ReorderLines(order, prologueLineCount + 1);
+        m_Recording.lineCount = prologueLineCount + order.size();
+    }
+
+private:
+    CompiledRecording& m_Recording;
+    RecordingCompiler m_Compiler;
+};
+
+bool CompileBinaryRecording(const char* data, size_t numBytes, CompiledRecording& outRecording)
+{
+    assert(outRecording.lines.empty());
+
+    BinaryRecordingCompiler compiler(outRecording);
+    return DecodeBinaryRecording(data, numBytes, compiler);
+}
+
+bool CompileBinaryRecording(LineSource& source, const char* prefix, size_t prefixSize, CompiledRecording& outRecording)
+{
+    assert(outRecording.lines.empty());
+
+    BinaryRecordingCompiler compiler(outRecording);
+    BinaryRecordingDecoder decoder(compiler);
+    if(!decoder.Decode(prefix, prefixSize))
+    {
+        return false;
+    }
+    std::vector<char> buffer(1024 * 1024);
+    for(;;)
+    {
+        const size_t bytesRead = source.Read(buffer.data(), buffer.size());
+        if(source.HasFailed() || !decoder.Decode(buffer.data(), bytesRead))
+        {
+            return false;
+        }
+        if(bytesRead < buffer.size())
+        {
+            break;
+        }
+    }
+    return decoder.Finish();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Saving and loading
+
+static const char COMPILED_RECORDING_MAGIC[8] = { 'V', 'M', 'A', 'R', 'E', 'C', 'C', 'P' };
+static const uint32_t COMPILED_RECORDING_VERSION = 1;
+
+struct CompiledRecordingHeader
+{
+    char magic[8];
+    uint32_t version;
+    // Detects files written by a build with different layout of CompiledLine.
+    uint32_t compiledLineSize;
+    uint64_t sourceSize;
+    uint64_t sourceModificationTime;
+    uint64_t lineCount;
+    uint64_t prologueSize;
+    uint64_t compiledLineCount;
+    uint64_t paramCount;
+    uint64_t stringsSize;
+    uint64_t threadCount;
+    uint64_t poolCount;
+    uint64_t allocationCount;
+    uint64_t defragmentationContextCount;
+};
+
+template<typename T>
+static bool WriteArray(FILE* file, const T* data, size_t count)
+{
+    return count == 0 || fwrite(data, sizeof(T), count, file) == count;
+}
+
+template<typename T>
+static bool ReadArray(FILE* file, T* data, size_t count)
+{
+    return count == 0 || fread(data, sizeof(T), count, file) == count;
+}
+
+bool SaveCompiledRecording(const char* filePath, uint64_t sourceSize, uint64_t sourceModificationTime,
+    const CompiledRecording& recording)
+{
+    CompiledRecordingHeader header = {};
+    memcpy(header.magic, COMPILED_RECORDING_MAGIC, sizeof(header.magic));
+    header.version = COMPILED_RECORDING_VERSION;
+    header.compiledLineSize = (uint32_t)sizeof(CompiledLine);
+    header.sourceSize = sourceSize;
+    header.sourceModificationTime = sourceModificationTime;
+    header.lineCount = recording.lineCount;
+    header.prologueSize = recording.prologue.size();
+    header.compiledLineCount = recording.lines.size();
+    header.paramCount = recording.params.size();
+    header.stringsSize = recording.strings.size();
+    header.threadCount = recording.threadIds.size();
+    header.poolCount = recording.pools.size();
+    header.allocationCount = recording.allocations.size();
+    header.defragmentationContextCount = recording.defragmentationContexts.size();
+
+    FILE* file = fopen(filePath, "wb");
+    if(file == nullptr)
+    {
+        return false;
+    }
+    bool success =
+        WriteArray(file, &header, 1) &&
+        WriteArray(file, recording.prologue.data(), recording.prologue.size()) &&
+        WriteArray(file, recording.lines.data(), recording.lines.size()) &&
+        WriteArray(file, recording.params.data(), recording.params.size()) &&
+        WriteArray(file, recording.strings.data(), recording.strings.size()) &&
+        WriteArray(file, recording.threadIds.data(), recording.threadIds.size()) &&
+        WriteArray(file, recording.pools.data(), recording.pools.size()) &&
+        WriteArray(file, recording.allocations.data(), recording.allocations.size()) &&
+        WriteArray(file, recording.defragmentationContexts.data(), recording.defragmentationContexts.size());
+    success = fclose(file) == 0 && success;
+    if(!success)
+    {
+        // Don't leave incomplete file that would fail to load every time.
+        remove(filePath);
+    }
+    return success;
+}
+
+static bool IsIndexValid(uint32_t index, size_t count)
+{
+    return index == CompiledRecording::NULL_INDEX || index < count;
+}
+
+// Checks that parameters of the line can be read without going out of bounds.
+static bool ValidateCompiledParams(const CompiledRecording& recording, VMA_FUNCTION func,
+    size_t paramBeg, size_t paramEnd)
+{
+    const uint32_t* const params = recording.params.data();
+    size_t p = paramBeg;
+    for(const char* type = GetCompiledParamTypes(func); *type != '\0'; ++type)
+    {
+        switch(*type)
+        {
+        case 'u':
+        case 'b':
+            p += 1;
+            break;
+        case 'U':
+        case 'X':
+            p += 2;
+            break;
+        case 'P':
+        case 'A':
+        case 'C':
+        case 'D':
+        {
+            if(p >= paramEnd)
+            {
+                return false;
+            }
+            const size_t count =
+                *type == 'P' ? recording.pools.size() :
+                *type == 'A' ? recording.allocations.size() :
+                *type == 'C' ? recording.defragmentationContexts.size() :
+                recording.strings.size();
+            if(!IsIndexValid(params[p], count))
+            {
+                return false;
+            }
+            ++p;
+            break;
+        }
+        case 'L':
+        case 'Q':
+        {
+            if(p >= paramEnd || params[p] > paramEnd - p - 1)
+            {
+                return false;
+            }
+            const size_t count = *type == 'L' ? recording.allocations.size() : recording.pools.size();
+            const size_t listEnd = p + 1 + params[p];
+            for(++p; p < listEnd; ++p)
+            {
+                if(!IsIndexValid(params[p], count))
+                {
+                    return false;
+                }
+            }
+            break;
+        }
+        default:
+            assert(0);
+            return false;
+        }
+        if(p > paramEnd)
+        {
+            return false;
+        }
+    }
+    return p == paramEnd;
+}
+
+static bool ValidateCompiledRecording(const CompiledRecording& recording)
+{
+    // Strings are referred by offset and read until null terminator.
+    if(!recording.strings.empty() && recording.strings.back() != '\0')
+    {
+        return false;
+    }
+
+    const size_t lineCount = recording.lines.size();
+    for(size_t i = 0; i < lineCount; ++i)
+    {
+        const CompiledLine& line = recording.lines[i];
+        const size_t paramEnd = i + 1 < lineCount ? recording.lines[i + 1].paramOffset : recording.params.size();
+        if(line.paramOffset > paramEnd ||
+            line.error > (uint8_t)COMPILED_LINE_ERROR::INVALID_PARAMETERS ||
+            !IsIndexValid(line.threadIndex, recording.threadIds.size()))
+        {
+            return false;
+        }
+        if(line.error == (uint8_t)COMPILED_LINE_ERROR::NONE)
+        {
+            if(line.function >= (uint8_t)VMA_FUNCTION::Count ||
+                !ValidateCompiledParams(recording, (VMA_FUNCTION)line.function, line.paramOffset, paramEnd))
+            {
+                return false;
+            }
+        }
+        else if(line.paramOffset != paramEnd ||
+            (line.error != (uint8_t)COMPILED_LINE_ERROR::TOO_FEW_COLUMNS &&
+            line.error != (uint8_t)COMPILED_LINE_ERROR::UNKNOWN_FUNCTION &&
+            line.function >= (uint8_t)VMA_FUNCTION::Count))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool LoadCompiledRecording(const char* filePath, uint64_t sourceSize, uint64_t sourceModificationTime,
+    CompiledRecording& outRecording)
+{
+    outRecording.Clear();
+
+    uint64_t fileSize, fileModificationTime;
+    if(!GetRegularFileInfo(filePath, fileSize, fileModificationTime))
+    {
+        return false;
+    }
+    FILE* file = fopen(filePath, "rb");
+    if(file == nullptr)
+    {
+        return false;
+    }
+
+    CompiledRecordingHeader header = {};
+    bool success = ReadArray(file, &header, 1) &&
+        memcmp(header.magic, COMPILED_RECORDING_MAGIC, sizeof(header.magic)) == 0 &&
+        header.version == COMPILED_RECORDING_VERSION &&
+        header.compiledLineSize == sizeof(CompiledLine) &&
+        header.sourceSize == sourceSize &&
+        header.sourceModificationTime == sourceModificationTime;
+
+    // Check sizes before allocating memory for them. Each is less than the whole file.
+    if(success)
+    {
+        const uint64_t sizes[] = {
+            header.prologueSize,
+            header.compiledLineCount * sizeof(CompiledLine),
+            header.paramCount * sizeof(uint32_t),
+            header.stringsSize,
+            header.threadCount * sizeof(uint32_t),
+            header.poolCount * sizeof(uint64_t),
+            header.allocationCount * sizeof(uint64_t),
+            header.defragmentationContextCount * sizeof(uint64_t),
+        };
+        const uint64_t counts[] = {
+            header.prologueSize,
+            header.compiledLineCount,
+            header.paramCount,
+            header.stringsSize,
+            header.threadCount,
+            header.poolCount,
+            header.allocationCount,
+            header.defragmentationContextCount,
+        };
+        uint64_t expectedFileSize = sizeof(header);
+        for(size_t i = 0; success && i < _countof(sizes); ++i)
+        {
+            success = counts[i] <= fileSize && sizes[i] <= fileSize - expectedFileSize;
+            expectedFileSize += sizes[i];
+        }
+        success = success && expectedFileSize == fileSize;
+    }
+
+    if(success)
+    {
+        outRecording.lineCount = (size_t)header.lineCount;
+        outRecording.prologue.resize((size_t)header.prologueSize);
+        outRecording.lines.resize((size_t)header.compiledLineCount);
+        outRecording.params.resize((size_t)header.paramCount);
+        outRecording.strings.resize((size_t)header.stringsSize);
+        outRecording.threadIds.resize((size_t)header.threadCount);
+        outRecording.pools.resize((size_t)header.poolCount);
+        outRecording.allocations.resize((size_t)header.allocationCount);
+        outRecording.defragmentationContexts.resize((size_t)header.defragmentationContextCount);
+        success =
+            ReadArray(file, &outRecording.prologue[0], outRecording.prologue.size()) &&
+            ReadArray(file, outRecording.lines.data(), outRecording.lines.size()) &&
+            ReadArray(file, outRecording.params.data(), outRecording.params.size()) &&
+            ReadArray(file, outRecording.strings.data(), outRecording.strings.size()) &&
+            ReadArray(file, outRecording.threadIds.data(), outRecording.threadIds.size()) &&
+            ReadArray(file, outRecording.pools.data(), outRecording.pools.size()) &&
+            ReadArray(file, outRecording.allocations.data(), outRecording.allocations.size()) &&
+            ReadArray(file, outRecording.defragmentationContexts.data(), outRecording.defragmentationContexts.size()) &&
+            ValidateCompiledRecording(outRecording);
+    }
+
+    fclose(file);
+    if(!success)
+    {
+        outRecording.Clear();
+    }
+    return success;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Dependencies
+
+class DependencyFinder
+{
+public:
+    DependencyFinder(const CompiledRecording& recording, CompiledDependencies& outDependencies) :
+        m_Recording(recording),
+        m_Dependencies(outDependencies),
+        m_Pools(recording.pools.size()),
+        m_LastAllocationUse(recording.allocations.size(), CompiledRecording::NULL_INDEX),
+        m_AllocationPools(recording.allocations.size(), CompiledRecording::NULL_INDEX),
+        m_LastDefragmentationContextUse(recording.defragmentationContexts.size(), CompiledRecording::NULL_INDEX)
+    {
+    }
+
+    void AddLine(uint32_t lineIndex);
+
+private:
+    struct PoolUse
+    {
+        uint32_t lastWriteLineIndex = CompiledRecording::NULL_INDEX;
+        // Lines that read the pool since last write, at most one per thread - the last one.
+        std::vector<uint32_t> readLineIndices;
+    };
+
+    const CompiledRecording& m_Recording;
+    CompiledDependencies& m_Dependencies;
+    std::vector<PoolUse> m_Pools;
+    std::vector<uint32_t> m_LastAllocationUse;
+    // Pool that every allocation was made from, or NULL_INDEX.
+    std::vector<uint32_t> m_AllocationPools;
+    std::vector<uint32_t> m_LastDefragmentationContextUse;
+    // Dependencies of the current line.
+    std::vector<uint32_t> m_CurrLineDependencies;
+
+    // Adds dependency of the current line on given line, if it's on a different thread.
+    void AddDependency(uint32_t lineIndex, uint32_t dependencyLineIndex);
+    void Write(uint32_t lineIndex, uint32_t& inoutLastUseLineIndex);
+    void UseAllocation(uint32_t lineIndex, uint32_t allocIndex, bool create, uint32_t poolIndex);
+    void ReadPool(uint32_t lineIndex, uint32_t poolIndex);
+    void WritePool(uint32_t lineIndex, uint32_t poolIndex);
+};
+
+void DependencyFinder::AddLine(uint32_t lineIndex)
+{
+    const CompiledLine& line = m_Recording.lines[lineIndex];
+    m_CurrLineDependencies.clear();
+
+    if((COMPILED_LINE_ERROR)line.error == COMPILED_LINE_ERROR::NONE)
+    {
+        const VMA_FUNCTION func = (VMA_FUNCTION)line.function;
+        // Pool is created or destroyed only by these, other functions only use it.
+        // vmaFreePoolAllocations frees allocations made from the pool by any thread, so it must be ordered with them.
+        const bool poolWritten =
+            func == VMA_FUNCTION::CreatePool ||
+            func == VMA_FUNCTION::DestroyPool ||
+            func == VMA_FUNCTION::FreePoolAllocations;
+
+        // Functions that take a pool without writing it create allocations, which always follow it in parameters.
+        bool lineCreatesAllocations = false;
+        uint32_t linePoolIndex = CompiledRecording::NULL_INDEX;
+
+        CompiledParamReader params(m_Recording, line);
+        for(const char* type = GetCompiledParamTypes(func); *type != '\0'; ++type)
+        {
+            switch(*type)
+            {
+            case 'u':
+            case 'b':
+                params.GetUint32();
+                break;
+            case 'U':
+            case 'X':
+                params.GetUint64();
+                break;
+            case 'D':
+                params.GetUserData();
+                break;
+            case 'P':
+            {
+                const uint32_t poolIndex = params.GetIndex();
+                if(!poolWritten)
+                {
+                    lineCreatesAllocations = true;
+                    linePoolIndex = poolIndex;
+                }
+                if(poolIndex != CompiledRecording::NULL_INDEX)
+                {
+                    if(poolWritten)
+                        WritePool(lineIndex, poolIndex);
+                    else
+                        ReadPool(lineIndex, poolIndex);
+                }
+                break;
+            }
+            case 'A':
+            {
+                const uint32_t allocIndex = params.GetIndex();
+                if(allocIndex != CompiledRecording::NULL_INDEX)
+                {
+                    UseAllocation(lineIndex, allocIndex, lineCreatesAllocations, linePoolIndex);
+                }
+                break;
+            }
+            case 'C':
+            {
+                const uint32_t defragCtxIndex = params.GetIndex();
+                if(defragCtxIndex != CompiledRecording::NULL_INDEX)
+                {
+                    Write(lineIndex, m_LastDefragmentationContextUse[defragCtxIndex]);
+                }
+                break;
+            }
+            case 'L':
+            case 'Q':
+            {
+                const uint32_t* indices = nullptr;
+                const uint32_t count = params.GetIndexList(indices);
+                for(uint32_t i = 0; i < count; ++i)
+                {
+                    if(indices[i] == CompiledRecording::NULL_INDEX)
+                        continue;
+                    if(*type == 'L')
+                        UseAllocation(lineIndex, indices[i], lineCreatesAllocations, linePoolIndex);
+                    else
+                        ReadPool(lineIndex, indices[i]);
+                }
+                break;
+            }
+            default:
+                assert(0);
+            }
+        }
+    }
+
+    std::sort(m_CurrLineDependencies.begin(), m_CurrLineDependencies.end());
+    m_CurrLineDependencies.erase(
+        std::unique(m_CurrLineDependencies.begin(), m_CurrLineDependencies.end()),
+        m_CurrLineDependencies.end());
+    m_Dependencies.lineIndices.insert(m_Dependencies.lineIndices.end(),
+        m_CurrLineDependencies.begin(), m_CurrLineDependencies.end());
+    m_Dependencies.offsets[lineIndex + 1] = (uint32_t)m_Dependencies.lineIndices.size();
+}
+
+void DependencyFinder::AddDependency(uint32_t lineIndex, uint32_t dependencyLineIndex)
+{
+    if(dependencyLineIndex != CompiledRecording::NULL_INDEX &&
+        m_Recording.lines[dependencyLineIndex].threadIndex != m_Recording.lines[lineIndex].threadIndex)
+    {
+        m_CurrLineDependencies.push_back(dependencyLineIndex);
+    }
+}
+
+void DependencyFinder::Write(uint32_t lineIndex, uint32_t& inoutLastUseLineIndex)
+{
+    AddDependency(lineIndex, inoutLastUseLineIndex);
+    inoutLastUseLineIndex = lineIndex;
+}
+
+void DependencyFinder::UseAllocation(uint32_t lineIndex, uint32_t allocIndex, bool create, uint32_t poolIndex)
+{
+    Write(lineIndex, m_LastAllocationUse[allocIndex]);
+    if(create)
+    {
+        // Handle of a freed allocation may be reused for a new one, from a different pool or none.
+        m_AllocationPools[allocIndex] = poolIndex;
+    }
+    else if(m_AllocationPools[allocIndex] != CompiledRecording::NULL_INDEX)
+    {
+        // Any other use of the allocation, including freeing it, uses its pool too,
+        // so destruction of the pool waits for it, even on a different thread.
+        ReadPool(lineIndex, m_AllocationPools[allocIndex]);
+    }
+}
+
+void DependencyFinder::ReadPool(uint32_t lineIndex, uint32_t poolIndex)
+{
+    PoolUse& pool = m_Pools[poolIndex];
+    AddDependency(lineIndex, pool.lastWriteLineIndex);
+
+    const uint32_t threadIndex = m_Recording.lines[lineIndex].threadIndex;
+    for(uint32_t& readLineIndex : pool.readLineIndices)
+    {
+        if(m_Recording.lines[readLineIndex].threadIndex == threadIndex)
+        {
+            readLineIndex = lineIndex;
+            return;
+        }
+    }
+    pool.readLineIndices.push_back(lineIndex);
+}
+
+void DependencyFinder::WritePool(uint32_t lineIndex, uint32_t poolIndex)
+{
+    PoolUse& pool = m_Pools[poolIndex];
+    for(uint32_t readLineIndex : pool.readLineIndices)
+    {
+        AddDependency(lineIndex, readLineIndex);
+    }
+    pool.readLineIndices.clear();
+    Write(lineIndex, pool.lastWriteLineIndex);
+}
+
+void FindCompiledDependencies(const CompiledRecording& recording, const RangeSequence<size_t>& lineRanges,
+    CompiledDependencies& outDependencies)
+{
+    const size_t lineCount = recording.lines.size();
+    outDependencies.offsets.assign(lineCount + 1, 0);
+    outDependencies.lineIndices.clear();
+
+    DependencyFinder finder(recording, outDependencies);
+    const bool useLineRanges = !lineRanges.IsEmpty();
+    for(uint32_t lineIndex = 0; lineIndex < (uint32_t)lineCount; ++lineIndex)
+    {
+        if(useLineRanges && !lineRanges.Includes((size_t)recording.lines[lineIndex].lineNumber))
+        {
+            // Line is not played, so nothing can wait for it.
+            outDependencies.offsets[lineIndex + 1] = (uint32_t)outDependencies.lineIndices.size();
+        }
+        else
+        {
+            finder.AddLine(lineIndex);
+        }
+    }
+}
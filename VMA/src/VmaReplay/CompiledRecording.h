@@ -0,0 +1,205 @@
+//
+// Copyright (c) 2017-2019 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "Common.h"
+#include "Constants.h"
+
+/*
+Recording file parsed into compact form, so it can be played many times without
+parsing its text again. Every line of the file becomes one CompiledLine, including
+invalid ones, which are played as the same warnings that the original lines would
+issue. Original pointers to pools, allocations and defragmentation contexts are
+replaced by dense indices, separate for every kind of object. Index is assigned
+to every distinct pointer value when it's first seen, so player can keep
+objects in arrays instead of maps keyed by pointer.
+
+Whole recording is compiled before it's played, even when it's played only once,
+because multithreaded playback needs dependencies between all the calls in advance.
+It takes memory proportional to the number of calls: sizeof(CompiledLine) = 32 B
+per line plus 4 B per parameter, typically 50-80 B per call, plus user data strings.
+*/
+
+enum class COMPILED_LINE_ERROR : uint8_t
+{
+    NONE,
+    TOO_FEW_COLUMNS,
+    UNKNOWN_FUNCTION,
+    INCORRECT_PARAMETER_COUNT,
+    INVALID_PARAMETERS,
+};
+
+static const uint8_t COMPILED_LINE_FLAG_FRAME_INDEX_VALID = 0x1;
+static const uint8_t COMPILED_LINE_FLAG_TIME_VALID = 0x2;
+
+struct CompiledLine
+{
+    uint64_t lineNumber;
+    // Index of the first parameter in CompiledRecording::params.
+    uint32_t paramOffset;
+    // Index into CompiledRecording::threadIds, or CompiledRecording::NULL_INDEX if thread ID was invalid.
+    uint32_t threadIndex;
+    uint32_t frameIndex;
+    float time;
+    uint8_t function; // VMA_FUNCTION
+    uint8_t error; // COMPILED_LINE_ERROR
+    uint8_t flags; // COMPILED_LINE_FLAG_*
+    uint8_t reserved;
+};
+
+struct CompiledRecording
+{
+    // Index of null pointer or missing string.
+    static const uint32_t NULL_INDEX = UINT32_MAX;
+
+    // Lines at the beginning of the file, up to the end of configuration, as text.
+    std::string prologue;
+    // Number of all lines of the file, including the prologue.
+    size_t lineCount = 0;
+    std::vector<CompiledLine> lines;
+    // Parameters of all lines, encoded as described in GetCompiledParamTypes.
+    std::vector<uint32_t> params;
+    // Null-terminated strings referred from params.
+    std::vector<char> strings;
+    // Original values by their indices.
+    std::vector<uint32_t> threadIds;
+    std::vector<uint64_t> pools;
+    std::vector<uint64_t> allocations;
+    std::vector<uint64_t> defragmentationContexts;
+
+    void Clear();
+    // Returns number of bytes occupied by the compiled data.
+    size_t GetMemorySize() const;
+};
+
+/*
+Returns types of parameters of given function, in the order in which they appear
+in the recording file:
+
+u - uint32_t, encoded as 1 element of CompiledRecording::params
+U - uint64_t, encoded as 2 elements, lower bits first
+b - bool, encoded as uint32_t 0 or 1
+X - other pointer, encoded as uint64_t
+P - VmaPool, encoded as index into CompiledRecording::pools
+A - VmaAllocation, encoded as index into CompiledRecording::allocations
+C - VmaDefragmentationContext, encoded as index into CompiledRecording::defragmentationContexts
+L - list of VmaAllocation, encoded as count followed by indices
+Q - list of VmaPool, encoded as count followed by indices
+D - pUserData, encoded as offset in CompiledRecording::strings of the rest of the line,
+    starting from this column, or NULL_INDEX if the column is missing. Always last.
+*/
+const char* GetCompiledParamTypes(VMA_FUNCTION func);
+
+/*
+Parses lines of the file that follow the prologue and appends them to outRecording.
+Lines are never rejected, but too large file gives false and error message.
+*/
+bool CompileRecording(LineSplit& lineSplit, CompiledRecording& outRecording);
+
+/*
+Decodes recording file in binary format straight into empty outRecording, with
+prologue equivalent to CSV format version 1.7. Calls of all threads are merged in
+the order in which they were made and numbered as lines that follow the prologue.
+Returns false and prints error message if the file is invalid or too large.
+*/
+bool CompileBinaryRecording(const char* data, size_t numBytes, CompiledRecording& outRecording);
+/*
+The same for data read from the source part by part, e.g. as it is decompressed,
+so the whole file is never kept in memory. Optional prefix is data already read
+from the source, which precedes the rest of it.
+*/
+bool CompileBinaryRecording(LineSource& source, const char* prefix, size_t prefixSize, CompiledRecording& outRecording);
+
+/*
+Compiled recording can be saved to a file, to be loaded instead of the original
+one when it's played again. Size and modification time of the original file are
+stored and must match when it's loaded. Loading returns false if the file doesn't
+exist, doesn't match, or was written by a different version of the program.
+*/
+bool SaveCompiledRecording(const char* filePath, uint64_t sourceSize, uint64_t sourceModificationTime,
+    const CompiledRecording& recording);
+bool LoadCompiledRecording(const char* filePath, uint64_t sourceSize, uint64_t sourceModificationTime,
+    CompiledRecording& outRecording);
+
+/*
+Order of calls that multithreaded playback must preserve. A call depends on
+previous calls from other threads that use the same object, e.g. freeing of an
+allocation depends on the call that created it. Pool passed to a function that
+allocates from it is only read, so such calls don't depend on each other, only
+on creation of the pool, and destruction of the pool depends on all of them, as
+well as vmaFreePoolAllocations. Every later use of an allocation made from a pool,
+e.g. freeing it on another thread, also reads the pool.
+*/
+struct CompiledDependencies
+{
+    // Dependencies of line i are lineIndices[offsets[i]] ... lineIndices[offsets[i + 1] - 1].
+    std::vector<uint32_t> offsets;
+    // Indices into CompiledRecording::lines.
+    std::vector<uint32_t> lineIndices;
+};
+
+// Only lines included in lineRanges are considered, or all if it's empty.
+void FindCompiledDependencies(const CompiledRecording& recording, const RangeSequence<size_t>& lineRanges,
+    CompiledDependencies& outDependencies);
+
+// Reads parameters of a compiled line in the order of their types.
+class CompiledParamReader
+{
+public:
+    CompiledParamReader(const CompiledRecording& recording, const CompiledLine& line) :
+        m_Recording(recording),
+        m_Params(recording.params.data() + line.paramOffset)
+    {
+    }
+
+    uint32_t GetUint32() { return *m_Params++; }
+    uint64_t GetUint64()
+    {
+        const uint64_t lo = m_Params[0];
+        const uint64_t hi = m_Params[1];
+        m_Params += 2;
+        return (hi << 32) | lo;
+    }
+    bool GetBool() { return GetUint32() != 0; }
+    // For P, A, C.
+    uint32_t GetIndex() { return GetUint32(); }
+    // For L, Q. Returns number of indices.
+    uint32_t GetIndexList(const uint32_t*& outIndices)
+    {
+        const uint32_t count = GetUint32();
+        outIndices = m_Params;
+        m_Params += count;
+        return count;
+    }
+    // For D. Returns null if the column is missing.
+    const char* GetUserData()
+    {
+        const uint32_t offset = GetUint32();
+        return offset != CompiledRecording::NULL_INDEX ? m_Recording.strings.data() + offset : nullptr;
+    }
+
+private:
+    const CompiledRecording& m_Recording;
+    const uint32_t* m_Params;
+};
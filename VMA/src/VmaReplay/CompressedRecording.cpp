@@ -0,0 +1,106 @@
+//
+// Copyright (c) 2017-2019 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "CompressedRecording.h"
+
+bool IsGzipFile(const char* data, size_t numBytes)
+{
+    return numBytes >= 2 && (uint8_t)data[0] == 0x1F && (uint8_t)data[1] == 0x8B;
+}
+
+GzipFileSource::GzipFileSource(LineSource& input) :
+    m_Source(input),
+    m_Input(256 * 1024)
+{
+    memset(&m_Stream, 0, sizeof(m_Stream));
+}
+
+GzipFileSource::~GzipFileSource()
+{
+    if(m_StreamInitialized)
+    {
+        inflateEnd(&m_Stream);
+    }
+}
+
+bool GzipFileSource::Rewind()
+{
+    if(!m_Source.Rewind())
+    {
+        printf("ERROR: Couldn't read compressed data again, input is not a regular file.\n");
+        m_Failed = true;
+        return false;
+    }
+    m_Stream.next_in = nullptr;
+    m_Stream.avail_in = 0;
+    m_StreamEnded = false;
+    m_Failed = false;
+
+    // Window bits above 15 accept only gzip format.
+    const int res = m_StreamInitialized ?
+        inflateReset(&m_Stream) :
+        inflateInit2(&m_Stream, 15 + 16);
+    if(res != Z_OK)
+    {
+        printf("ERROR: Couldn't initialize decompression (%i).\n", res);
+        m_Failed = true;
+        return false;
+    }
+    m_StreamInitialized = true;
+    return true;
+}
+
+size_t GzipFileSource::Read(char* dst, size_t maxBytes)
+{
+    assert(m_StreamInitialized);
+    m_Stream.next_out = (Bytef*)dst;
+    m_Stream.avail_out = (uInt)std::min<size_t>(maxBytes, UINT32_MAX);
+    while(m_Stream.avail_out > 0 && !m_StreamEnded && !m_Failed)
+    {
+        if(m_Stream.avail_in == 0)
+        {
+            const size_t bytesRead = m_Source.Read(m_Input.data(), m_Input.size());
+            if(bytesRead == 0)
+            {
+                // Recording was not finished, e.g. because the application crashed.
+                printf("WARNING: Compressed file is truncated.\n");
+                m_StreamEnded = true;
+                break;
+            }
+            m_Stream.next_in = (Bytef*)m_Input.data();
+            m_Stream.avail_in = (uInt)bytesRead;
+        }
+
+        const int res = inflate(&m_Stream, Z_NO_FLUSH);
+        if(res == Z_STREAM_END)
+        {
+            m_StreamEnded = true;
+        }
+        else if(res != Z_OK)
+        {
+            printf("ERROR: Corrupted compressed data (%i).\n", res);
+            m_Failed = true;
+        }
+    }
+    return (size_t)((char*)m_Stream.next_out - dst);
+}
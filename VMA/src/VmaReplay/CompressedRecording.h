@@ -0,0 +1,58 @@
+//
+// Copyright (c) 2017-2019 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "Common.h"
+#include <zlib.h>
+
+/*
+Support for recording files written by VMA with VMA_RECORD_COMPRESS_BIT,
+which are compressed in gzip format. They are decompressed while being parsed,
+so the whole decompressed file never needs to fit in memory.
+*/
+
+// Returns true if data starts with the signature of gzip format.
+bool IsGzipFile(const char* data, size_t numBytes);
+
+// Decompresses data read from another source.
+class GzipFileSource : public LineSource
+{
+public:
+    explicit GzipFileSource(LineSource& input);
+    ~GzipFileSource();
+
+    // Starts decompression from the beginning of the input. Must be called before first Read.
+    virtual bool Rewind();
+    virtual size_t Read(char* dst, size_t maxBytes);
+    // Returns true if the data was found corrupted.
+    virtual bool HasFailed() const { return m_Failed; }
+
+private:
+    LineSource& m_Source;
+    z_stream m_Stream;
+    std::vector<char> m_Input;
+    bool m_StreamInitialized = false;
+    bool m_StreamEnded = false;
+    bool m_Failed = false;
+};
@@ -54,20 +54,107 @@ const char* VMA_FUNCTION_NAMES[] = {
     "vmaResizeAllocation",
     "vmaDefragmentationBegin",
     "vmaDefragmentationEnd",
+    "vmaCreateAllocator",
+    "vmaDestroyAllocator",
+    "vmaFreePoolAllocations",
+    "vmaAllocateMemoryWithoutHandle",
 };
 static_assert(
     _countof(VMA_FUNCTION_NAMES) == (size_t)VMA_FUNCTION::Count,
     "VMA_FUNCTION_NAMES array doesn't match VMA_FUNCTION enum.");
 
+VMA_FUNCTION FindVmaFunction(const char* name, size_t nameLen)
+{
+    /*
+    Called for every line of the recording, so instead of comparing with all the
+    names one by one, single candidate is chosen by name length and the first
+    characters after "vma" prefix, which are unique for all the names. Then it is
+    confirmed with full comparison. Keep this in sync with VMA_FUNCTION_NAMES.
+    */
+    if(nameLen < 5)
+    {
+        return VMA_FUNCTION::Count;
+    }
+    const char c3 = name[3];
+    const char c4 = name[4];
+    VMA_FUNCTION candidate = VMA_FUNCTION::Count;
+    switch(nameLen)
+    {
+    case 12:
+        candidate = VMA_FUNCTION::MapMemory;
+        break;
+    case 13:
+        candidate = c3 == 'C' ? VMA_FUNCTION::CreatePool : VMA_FUNCTION::FreeMemory;
+        break;
+    case 14:
+        candidate = c3 == 'D' ? VMA_FUNCTION::DestroyPool :
+            c3 == 'C' ? VMA_FUNCTION::CreateImage : VMA_FUNCTION::UnmapMemory;
+        break;
+    case 15:
+        candidate = c3 == 'C' ? VMA_FUNCTION::CreateBuffer : VMA_FUNCTION::DestroyImage;
+        break;
+    case 16:
+        candidate = VMA_FUNCTION::DestroyBuffer;
+        break;
+    case 17:
+        candidate = VMA_FUNCTION::AllocateMemory;
+        break;
+    case 18:
+        candidate = c3 == 'T' ? VMA_FUNCTION::TouchAllocation :
+            c3 == 'C' ? VMA_FUNCTION::CreateAllocator :
+            c4 == 'r' ? VMA_FUNCTION::FreeMemoryPages : VMA_FUNCTION::FlushAllocation;
+        break;
+    case 19:
+        candidate = c3 == 'R' ? VMA_FUNCTION::ResizeAllocation : VMA_FUNCTION::DestroyAllocator;
+        break;
+    case 20:
+        candidate = VMA_FUNCTION::GetAllocationInfo;
+        break;
+    case 21:
+        candidate = VMA_FUNCTION::DefragmentationEnd;
+        break;
+    case 22:
+        candidate = c3 == 'A' ? VMA_FUNCTION::AllocateMemoryPages : VMA_FUNCTION::FreePoolAllocations;
+        break;
+    case 23:
+        candidate = c3 == 'C' ? VMA_FUNCTION::CreateLostAllocation :
+            c3 == 'I' ? VMA_FUNCTION::InvalidateAllocation : VMA_FUNCTION::DefragmentationBegin;
+        break;
+    case 24:
+        candidate = VMA_FUNCTION::SetAllocationUserData;
+        break;
+    case 25:
+        candidate = VMA_FUNCTION::AllocateMemoryForImage;
+        break;
+    case 26:
+        candidate = c3 == 'A' ? VMA_FUNCTION::AllocateMemoryForBuffer : VMA_FUNCTION::MakePoolAllocationsLost;
+        break;
+    case 30:
+        candidate = VMA_FUNCTION::AllocateMemoryWithoutHandle;
+        break;
+    default:
+        return VMA_FUNCTION::Count;
+    }
+
+    const char* const candidateName = VMA_FUNCTION_NAMES[(size_t)candidate];
+    if(strncmp(name, candidateName, nameLen) == 0 && candidateName[nameLen] == '\0')
+    {
+        return candidate;
+    }
+    return VMA_FUNCTION::Count;
+}
+
 const char* VMA_POOL_CREATE_FLAG_NAMES[] = {
     "VMA_POOL_CREATE_IGNORE_BUFFER_IMAGE_GRANULARITY_BIT",
     "VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT",
     "VMA_POOL_CREATE_BUDDY_ALGORITHM_BIT",
+    "VMA_POOL_CREATE_BUDDY_MULTIPLE_ROOTS_BIT",
 };
 const uint32_t VMA_POOL_CREATE_FLAG_VALUES[] = {
     VMA_POOL_CREATE_IGNORE_BUFFER_IMAGE_GRANULARITY_BIT,
     VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT,
     VMA_POOL_CREATE_BUDDY_ALGORITHM_BIT,
+    VMA_POOL_CREATE_BUDDY_MULTIPLE_ROOTS_BIT,
 };
 const size_t VMA_POOL_CREATE_FLAG_COUNT = _countof(VMA_POOL_CREATE_FLAG_NAMES);
 static_assert(
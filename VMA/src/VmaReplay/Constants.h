@@ -42,6 +42,10 @@ enum CMD_LINE_OPT
     CMD_LINE_OPT_DEFRAGMENT_AFTER_LINE,
     CMD_LINE_OPT_DEFRAGMENTATION_FLAGS,
     CMD_LINE_OPT_DUMP_DETAILED_STATS_AFTER_LINE,
+    CMD_LINE_OPT_NULL_DEVICE,
+    CMD_LINE_OPT_NULL_DEVICE_LATENCY,
+    CMD_LINE_OPT_COMPILED_CACHE,
+    CMD_LINE_OPT_MULTITHREADED,
 };
 
 enum class VERBOSITY
@@ -87,10 +91,18 @@ enum class VMA_FUNCTION
     ResizeAllocation,
     DefragmentationBegin,
     DefragmentationEnd,
+    CreateAllocator,
+    DestroyAllocator,
+    FreePoolAllocations,
+    AllocateMemoryWithoutHandle,
     Count
 };
 extern const char* VMA_FUNCTION_NAMES[];
 
+// Returns function with given name, as it appears in recording file,
+// e.g. "vmaCreateBuffer", or VMA_FUNCTION::Count if the name is unknown.
+VMA_FUNCTION FindVmaFunction(const char* name, size_t nameLen);
+
 extern const char* VMA_POOL_CREATE_FLAG_NAMES[];
 extern const uint32_t VMA_POOL_CREATE_FLAG_VALUES[];
 extern const size_t VMA_POOL_CREATE_FLAG_COUNT;
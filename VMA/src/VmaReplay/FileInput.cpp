@@ -0,0 +1,230 @@
+//
+// Copyright (c) 2017-2019 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "FileInput.h"
+
+#ifndef _WIN32
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// MappedFile class
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const char* filePath)
+{
+    Close();
+
+    HANDLE file = CreateFileA(filePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if(file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize = {};
+    bool success = GetFileType(file) == FILE_TYPE_DISK &&
+        GetFileSizeEx(file, &fileSize) != FALSE &&
+        (uint64_t)fileSize.QuadPart <= SIZE_MAX;
+    // Mapping of an empty file is not allowed.
+    if(success && fileSize.QuadPart > 0)
+    {
+        m_Mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if(m_Mapping != NULL)
+        {
+            m_Data = (const char*)MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0);
+        }
+        if(m_Data != nullptr)
+        {
+            m_Size = (size_t)fileSize.QuadPart;
+        }
+        else
+        {
+            Close();
+            success = false;
+        }
+    }
+
+    // Mapping keeps the file open.
+    CloseHandle(file);
+    return success;
+}
+
+void MappedFile::Close()
+{
+    if(m_Data != nullptr)
+    {
+        UnmapViewOfFile(m_Data);
+        m_Data = nullptr;
+    }
+    if(m_Mapping != NULL)
+    {
+        CloseHandle(m_Mapping);
+        m_Mapping = NULL;
+    }
+    m_Size = 0;
+}
+
+bool GetRegularFileInfo(const char* filePath, uint64_t& outSize, uint64_t& outModificationTime)
+{
+    WIN32_FILE_ATTRIBUTE_DATA data = {};
+    if(GetFileAttributesExA(filePath, GetFileExInfoStandard, &data) == FALSE ||
+        (data.dwFileAttributes & (FILE_ATTRIBUTE_DIRECTORY | FILE_ATTRIBUTE_DEVICE)) != 0)
+    {
+        return false;
+    }
+    outSize = ((uint64_t)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+    outModificationTime = ((uint64_t)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+    return true;
+}
+
+#else // #ifdef _WIN32
+
+bool MappedFile::Open(const char* filePath)
+{
+    Close();
+
+    const int fd = open(filePath, O_RDONLY);
+    if(fd < 0)
+    {
+        return false;
+    }
+
+    struct stat fileStat = {};
+    bool success = fstat(fd, &fileStat) == 0 &&
+        S_ISREG(fileStat.st_mode) &&
+        (uint64_t)fileStat.st_size <= SIZE_MAX;
+    // Mapping of an empty file is not allowed.
+    if(success && fileStat.st_size > 0)
+    {
+        const size_t size = (size_t)fileStat.st_size;
+        void* const data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(data != MAP_FAILED)
+        {
+            // The file is parsed from the beginning to the end, so more can be read ahead.
+            madvise(data, size, MADV_SEQUENTIAL);
+            m_Data = (const char*)data;
+            m_Size = size;
+        }
+        else
+        {
+            success = false;
+        }
+    }
+
+    // Mapping stays valid after the file is closed.
+    close(fd);
+    return success;
+}
+
+void MappedFile::Close()
+{
+    if(m_Data != nullptr)
+    {
+        munmap((void*)m_Data, m_Size);
+        m_Data = nullptr;
+    }
+    m_Size = 0;
+}
+
+bool GetRegularFileInfo(const char* filePath, uint64_t& outSize, uint64_t& outModificationTime)
+{
+    struct stat fileStat = {};
+    if(stat(filePath, &fileStat) != 0 || !S_ISREG(fileStat.st_mode))
+    {
+        return false;
+    }
+    outSize = (uint64_t)fileStat.st_size;
+    // In nanoseconds, as seconds are too coarse to notice a file rewritten right after it was compiled.
+#ifdef __APPLE__
+    const struct timespec& mtime = fileStat.st_mtimespec;
+#else
+    const struct timespec& mtime = fileStat.st_mtim;
+#endif
+    outModificationTime = (uint64_t)mtime.tv_sec * 1000000000ull + (uint64_t)mtime.tv_nsec;
+    return true;
+}
+
+#endif // #ifdef _WIN32
+
+////////////////////////////////////////////////////////////////////////////////
+// MemorySource class
+
+size_t MemorySource::Read(char* dst, size_t maxBytes)
+{
+    const size_t bytesRead = std::min(maxBytes, m_NumBytes - m_Offset);
+    memcpy(dst, m_Data + m_Offset, bytesRead);
+    m_Offset += bytesRead;
+    return bytesRead;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// StreamFileSource class
+
+size_t StreamFileSource::Peek(char* dst, size_t maxBytes)
+{
+    assert(m_HeadOffset == 0 && !m_ReadPastHead);
+    if(m_Head.size() < maxBytes)
+    {
+        const size_t oldSize = m_Head.size();
+        m_Head.resize(maxBytes);
+        m_Head.resize(oldSize + fread(m_Head.data() + oldSize, 1, maxBytes - oldSize, m_File));
+    }
+    const size_t bytesPeeked = std::min(maxBytes, m_Head.size());
+    memcpy(dst, m_Head.data(), bytesPeeked);
+    return bytesPeeked;
+}
+
+size_t StreamFileSource::Read(char* dst, size_t maxBytes)
+{
+    const size_t bytesFromHead = std::min(maxBytes, m_Head.size() - m_HeadOffset);
+    memcpy(dst, m_Head.data() + m_HeadOffset, bytesFromHead);
+    m_HeadOffset += bytesFromHead;
+    if(bytesFromHead == maxBytes)
+    {
+        return bytesFromHead;
+    }
+
+    m_ReadPastHead = true;
+    return bytesFromHead + fread(dst + bytesFromHead, 1, maxBytes - bytesFromHead, m_File);
+}
+
+bool StreamFileSource::Rewind()
+{
+    if(m_ReadPastHead)
+    {
+        // Fails for pipes.
+        if(fseek(m_File, 0, SEEK_SET) != 0)
+        {
+            return false;
+        }
+        m_Head.clear();
+        m_ReadPastHead = false;
+    }
+    m_HeadOffset = 0;
+    return true;
+}
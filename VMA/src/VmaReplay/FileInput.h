@@ -0,0 +1,98 @@
+//
+// Copyright (c) 2017-2019 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "Common.h"
+
+/*
+Reading of the recording file. Regular files are mapped into memory, so they can
+be parsed in place, without copying them into a separate buffer. Other files,
+like pipes, are read sequentially in chunks.
+*/
+
+// Read-only view of the whole contents of a regular file.
+class MappedFile
+{
+public:
+    MappedFile() { }
+    ~MappedFile() { Close(); }
+
+    // Returns false if the file can't be mapped, e.g. because it doesn't exist or isn't a regular file.
+    bool Open(const char* filePath);
+    void Close();
+
+    // Null if the file is empty.
+    const char* GetData() const { return m_Data; }
+    size_t GetSize() const { return m_Size; }
+
+private:
+    const char* m_Data = nullptr;
+    size_t m_Size = 0;
+#ifdef _WIN32
+    HANDLE m_Mapping = NULL;
+#endif
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+};
+
+// Returns size and time of the last modification of a regular file, which together identify its contents.
+// Time is in the finest units the platform provides: 100 ns on Windows, 1 ns elsewhere.
+// Returns false if the file doesn't exist or it is not a regular file.
+bool GetRegularFileInfo(const char* filePath, uint64_t& outSize, uint64_t& outModificationTime);
+
+// Data already present in memory, e.g. mapped file.
+class MemorySource : public LineSource
+{
+public:
+    MemorySource(const char* data, size_t numBytes) : m_Data(data), m_NumBytes(numBytes) { }
+
+    virtual size_t Read(char* dst, size_t maxBytes);
+    virtual bool Rewind() { m_Offset = 0; return true; }
+
+private:
+    const char* const m_Data;
+    const size_t m_NumBytes;
+    size_t m_Offset = 0;
+};
+
+// File read sequentially in chunks, which works also for files that can't be mapped or seeked.
+class StreamFileSource : public LineSource
+{
+public:
+    explicit StreamFileSource(FILE* file) : m_File(file) { }
+
+    // Returns first bytes of the file without consuming them.
+    size_t Peek(char* dst, size_t maxBytes);
+    virtual size_t Read(char* dst, size_t maxBytes);
+    // Succeeds when seeking in the file is supported or nothing was read past the peeked bytes.
+    virtual bool Rewind();
+
+private:
+    FILE* const m_File;
+    // Bytes returned by Peek, to be returned again by Read.
+    std::vector<char> m_Head;
+    size_t m_HeadOffset = 0;
+    bool m_ReadPastHead = false;
+};
@@ -0,0 +1,79 @@
+#
+# Copyright (c) 2018-2019 Advanced Micro Devices, Inc. All rights reserved.
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+#
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+
+
+PROGRAM_VERSION = 'VmaReplay Multithreaded Playback Test 1.0.0'
+
+POOL = 0xA000
+ALLOCATION_COUNT = 2000
+ITERATION_COUNT = 10
+
+
+def WritePoolFreedOnOtherThreadRecording(file):
+    # Thread 1000 creates a pool and allocates from it, thread 1001 frees the allocations,
+    # then thread 1000 destroys the pool. Destruction must wait for all the frees.
+    lines = [
+        'Vulkan Memory Allocator,Calls recording',
+        '1,7',
+        'Config,Begin',
+        'Config,End',
+        '1000,0.000,0,vmaCreateAllocator',
+        '1000,0.001,0,vmaCreatePool,1,0,1048576,0,0,0,%016X' % POOL]
+    for i in range(ALLOCATION_COUNT):
+        lines.append('1000,0.002,0,vmaAllocateMemory,1024,256,2,0,0,0,0,0,%016X,%016X,' % (POOL, 0x100000 + i * 16))
+    for i in range(ALLOCATION_COUNT):
+        lines.append('1001,0.003,0,vmaFreeMemory,%016X' % (0x100000 + i * 16))
+    lines.append('1000,0.004,0,vmaDestroyPool,%016X' % POOL)
+    lines.append('1000,0.005,0,vmaDestroyAllocator')
+    file.write('\n'.join(lines) + '\n')
+
+
+if __name__ == '__main__':
+    argParser = argparse.ArgumentParser(description='Checks that VmaReplay with --Multithreaded 1 keeps the order of calls that use the same objects on different threads. '
+        'Recordings are played on the null device, so no GPU is needed. Failures show best in Debug build of VmaReplay, where VMA asserts are enabled.')
+    argParser.add_argument('VmaReplay', help='Path to VmaReplay executable')
+    argParser.add_argument('-v', '--version', action='version', version=PROGRAM_VERSION)
+    args = argParser.parse_args()
+
+    # Relative path, because VmaReplay takes arguments starting with '/' as options.
+    fd, recordingPath = tempfile.mkstemp(suffix='.csv', dir='.')
+    recordingPath = os.path.basename(recordingPath)
+    try:
+        with os.fdopen(fd, 'w') as recordingFile:
+            WritePoolFreedOnOtherThreadRecording(recordingFile)
+        result = subprocess.run([args.VmaReplay, '--NullDevice', '1', '--Multithreaded', '1', '-i', str(ITERATION_COUNT), '-v', '0', recordingPath],
+            stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True)
+    finally:
+        os.remove(recordingPath)
+
+    if result.returncode != 0:
+        sys.exit('FAILED: Pool freed on other thread: VmaReplay returned %d.\n%s' % (result.returncode, result.stdout))
+    for line in result.stdout.splitlines():
+        if line.startswith('Line '):
+            sys.exit('FAILED: Pool freed on other thread: %s' % line)
+    print('PASSED')
@@ -23,9 +23,17 @@
 #include "VmaUsage.h"
 #include "Common.h"
 #include "Constants.h"
+#include "BinaryRecording.h"
+#include "CompressedRecording.h"
+#include "CompiledRecording.h"
+#include "FileInput.h"
+#include "../NullDevice.h"
 #include <unordered_map>
 #include <map>
 #include <algorithm>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
 
 static VERBOSITY g_Verbosity = VERBOSITY::DEFAULT;
 
@@ -670,6 +678,18 @@ static bool g_UserDataEnabled = true;
 static bool g_MemStatsEnabled = false;
 VULKAN_EXTENSION_REQUEST g_VK_KHR_dedicated_allocation_request = VULKAN_EXTENSION_REQUEST::DEFAULT;
 VULKAN_EXTENSION_REQUEST g_VK_LAYER_LUNARG_standard_validation = VULKAN_EXTENSION_REQUEST::DEFAULT;
+static bool g_NullDeviceEnabled = false;
+// Latencies injected into null device functions, in nanoseconds.
+static uint64_t g_NullDeviceAllocateMemoryLatency = 0;
+static uint64_t g_NullDeviceFreeMemoryLatency = 0;
+static uint64_t g_NullDeviceOtherCallLatency = 0;
+// Compiled recording is saved to and loaded from a file next to the source file.
+static bool g_CompiledCacheEnabled = false;
+// Calls of every recorded thread are played on a separate thread.
+static bool g_MultithreadedEnabled = false;
+// Time the current thread spent waiting for Statistics mutex since it started.
+// It's not part of VMA calls, so it's excluded from their latency.
+static thread_local uint64_t g_StatsLockWaitNanoseconds = 0;
 
 struct StatsAfterLineEntry
 {
@@ -688,7 +708,7 @@ static size_t g_DefragmentAfterLineNextIndex = 0;
 static bool ValidateFileVersion()
 {
     if(GetVersionMajor(g_FileVersion) == 1 &&
-        GetVersionMinor(g_FileVersion) <= 6)
+        GetVersionMinor(g_FileVersion) <= 7)
     {
         return true;
     }
@@ -743,8 +763,8 @@ public:
     void RegisterCreateBuffer(const VkBufferCreateInfo& info);
     void RegisterCreatePool(const VmaPoolCreateInfo& info);
     void RegisterCreateAllocation(const VmaAllocationCreateInfo& info, size_t allocCount = 1);
-    void RegisterCreateLostAllocation() { ++m_CreateLostAllocationCount; }
-    void RegisterAllocateMemoryPages(size_t allocCount) { m_VmaAllocateMemoryPages.PostValue(allocCount); }
+    void RegisterCreateLostAllocation() { auto lock = Lock(); ++m_CreateLostAllocationCount; }
+    void RegisterAllocateMemoryPages(size_t allocCount) { auto lock = Lock(); m_VmaAllocateMemoryPages.PostValue(allocCount); }
     void RegisterDefragmentation(const VmaDefragmentationInfo2& info);
 
     void RegisterDeviceMemoryAllocation(uint32_t memoryType, VkDeviceSize size);
@@ -795,6 +815,26 @@ private:
     DetailedStats::VmaAllocateMemoryPagesStats m_VmaAllocateMemoryPages;
     DetailedStats::VmaDefragmentationInfo2Stats m_VmaDefragmentationInfo2;
 
+    // Calls are registered from many threads during multithreaded playback.
+    std::mutex m_Mutex;
+
+    std::unique_lock<std::mutex> Lock()
+    {
+        if(!g_MultithreadedEnabled)
+        {
+            return std::unique_lock<std::mutex>();
+        }
+        std::unique_lock<std::mutex> lock(m_Mutex, std::try_to_lock);
+        if(!lock.owns_lock())
+        {
+            const time_point waitBeg = std::chrono::high_resolution_clock::now();
+            lock.lock();
+            g_StatsLockWaitNanoseconds += (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::high_resolution_clock::now() - waitBeg).count();
+        }
+        return lock;
+    }
+
     void UpdateMemStatInfo(MemStatInfo& inoutPeakInfo, const VmaStatInfo& currInfo);
     static void PrintMemStatInfo(const MemStatInfo& info);
 };
@@ -886,8 +926,8 @@ uint32_t Statistics::ImageUsageToClass(uint32_t usage)
 
 Statistics::Statistics()
 {
-    ZeroMemory(&m_DeviceMemStats, sizeof(m_DeviceMemStats));
-    ZeroMemory(&m_PeakMemStats, sizeof(m_PeakMemStats));
+    memset(&m_DeviceMemStats, 0, sizeof(m_DeviceMemStats));
+    memset(&m_PeakMemStats, 0, sizeof(m_PeakMemStats));
 
     assert(g_Statistics == nullptr);
     g_Statistics = this;
@@ -957,11 +997,14 @@ void Statistics::PrintDetailedStats() const
 
 void Statistics::RegisterFunctionCall(VMA_FUNCTION func)
 {
+    auto lock = Lock();
     ++m_FunctionCallCount[(size_t)func];
 }
 
 void Statistics::RegisterCreateImage(const VkImageCreateInfo& info)
 {
+    auto lock = Lock();
+
     if(info.tiling == VK_IMAGE_TILING_LINEAR)
         ++m_LinearImageCreationCount;
     else
@@ -975,6 +1018,8 @@ void Statistics::RegisterCreateImage(const VkImageCreateInfo& info)
 
 void Statistics::RegisterCreateBuffer(const VkBufferCreateInfo& info)
 {
+    auto lock = Lock();
+
     const uint32_t bufClass = BufferUsageToClass(info.usage);
     ++m_BufferCreationCount[bufClass];
 
@@ -983,21 +1028,26 @@ void Statistics::RegisterCreateBuffer(const VkBufferCreateInfo& info)
 
 void Statistics::RegisterCreatePool(const VmaPoolCreateInfo& info)
 {
+    auto lock = Lock();
     m_VmaPoolCreateInfo.PostValue(info);
 }
 
 void Statistics::RegisterCreateAllocation(const VmaAllocationCreateInfo& info, size_t allocCount)
 {
+    auto lock = Lock();
     m_VmaAllocationCreateInfo.PostValue(info, allocCount);
 }
 
 void Statistics::RegisterDefragmentation(const VmaDefragmentationInfo2& info)
 {
+    auto lock = Lock();
     m_VmaDefragmentationInfo2.PostValue(info);
 }
 
 void Statistics::UpdateMemStats(const VmaStats& currStats)
 {
+    auto lock = Lock();
+
     UpdateMemStatInfo(m_PeakMemStats.total, currStats.total);
     
     for(uint32_t i = 0; i < m_MemHeapCount; ++i)
@@ -1013,6 +1063,8 @@ void Statistics::UpdateMemStats(const VmaStats& currStats)
 
 void Statistics::RegisterDeviceMemoryAllocation(uint32_t memoryType, VkDeviceSize size)
 {
+    auto lock = Lock();
+
     ++m_DeviceMemStats.total.allocationCount;
     m_DeviceMemStats.total.allocationTotalSize += size;
 
@@ -1065,6 +1117,10 @@ public:
         const VkPhysicalDeviceMemoryProperties& currMemProps,
         bool currDedicatedAllocationExtensionEnabled);
 
+    // Returns description of a null device resembling the original one.
+    // Parameters that were not recorded are left at their defaults.
+    void GetNullDeviceDesc(NullDeviceDesc& outDesc) const;
+
 private:
     enum class OPTION
     {
@@ -1111,21 +1167,23 @@ private:
         OPTION option, const char* currValue);
     void CompareMemProps(
         const VkPhysicalDeviceMemoryProperties& currMemProps);
+    // If option is set and has valid value, returns it and true.
+    bool GetOptionValue(OPTION option, uint32_t& outValue) const;
+    bool GetOptionValue(OPTION option, uint64_t& outValue) const;
+    bool GetOptionValue(OPTION option, bool& outValue) const;
+    bool IsMemPropsValid() const;
 };
 
 ConfigurationParser::ConfigurationParser() :
     m_OptionSet((size_t)OPTION::Count),
     m_OptionValue((size_t)OPTION::Count)
 {
-    ZeroMemory(&m_MemProps, sizeof(m_MemProps));
+    memset(&m_MemProps, 0, sizeof(m_MemProps));
 }
 
 bool ConfigurationParser::Parse(LineSplit& lineSplit)
 {
-    for(auto& it : m_OptionSet)
-    {
-        it = false;
-    }
+    std::fill(m_OptionSet.begin(), m_OptionSet.end(), false);
     for(auto& it : m_OptionValue)
     {
         it.clear();
@@ -1324,6 +1382,96 @@ void ConfigurationParser::Compare(
     CompareMemProps(currMemProps);
 }
 
+void ConfigurationParser::GetNullDeviceDesc(NullDeviceDesc& outDesc) const
+{
+    GetDefaultNullDeviceDesc(outDesc);
+
+    VkPhysicalDeviceProperties& props = outDesc.properties;
+    GetOptionValue(OPTION::PhysicalDevice_apiVersion, props.apiVersion);
+    GetOptionValue(OPTION::PhysicalDevice_driverVersion, props.driverVersion);
+    GetOptionValue(OPTION::PhysicalDevice_vendorID, props.vendorID);
+    GetOptionValue(OPTION::PhysicalDevice_deviceID, props.deviceID);
+    uint32_t deviceType;
+    if(GetOptionValue(OPTION::PhysicalDevice_deviceType, deviceType))
+    {
+        props.deviceType = (VkPhysicalDeviceType)deviceType;
+    }
+    if(m_OptionSet[(size_t)OPTION::PhysicalDevice_deviceName])
+    {
+        const std::string& deviceName = m_OptionValue[(size_t)OPTION::PhysicalDevice_deviceName];
+        const size_t deviceNameLen = std::min(deviceName.length(), (size_t)VK_MAX_PHYSICAL_DEVICE_NAME_SIZE - 1);
+        memcpy(props.deviceName, deviceName.c_str(), deviceNameLen);
+        props.deviceName[deviceNameLen] = '\0';
+    }
+
+    GetOptionValue(OPTION::PhysicalDeviceLimits_maxMemoryAllocationCount, props.limits.maxMemoryAllocationCount);
+    GetOptionValue(OPTION::PhysicalDeviceLimits_bufferImageGranularity, props.limits.bufferImageGranularity);
+    GetOptionValue(OPTION::PhysicalDeviceLimits_nonCoherentAtomSize, props.limits.nonCoherentAtomSize);
+    GetOptionValue(OPTION::Extension_VK_KHR_dedicated_allocation, outDesc.dedicatedAllocationExtension);
+
+    if(IsMemPropsValid())
+    {
+        outDesc.memoryProperties = m_MemProps;
+    }
+    else if(m_MemProps.memoryHeapCount > 0 || m_MemProps.memoryTypeCount > 0)
+    {
+        printf("WARNING: Recorded memory heaps and types are invalid. Using defaults for null device.\n");
+    }
+}
+
+bool ConfigurationParser::GetOptionValue(OPTION option, uint32_t& outValue) const
+{
+    uint32_t value;
+    if(m_OptionSet[(size_t)option] &&
+        StrRangeToUint(StrRange(m_OptionValue[(size_t)option]), value))
+    {
+        outValue = value;
+        return true;
+    }
+    return false;
+}
+
+bool ConfigurationParser::GetOptionValue(OPTION option, uint64_t& outValue) const
+{
+    uint64_t value;
+    if(m_OptionSet[(size_t)option] &&
+        StrRangeToUint(StrRange(m_OptionValue[(size_t)option]), value))
+    {
+        outValue = value;
+        return true;
+    }
+    return false;
+}
+
+bool ConfigurationParser::GetOptionValue(OPTION option, bool& outValue) const
+{
+    bool value;
+    if(m_OptionSet[(size_t)option] &&
+        StrRangeToBool(StrRange(m_OptionValue[(size_t)option]), value))
+    {
+        outValue = value;
+        return true;
+    }
+    return false;
+}
+
+bool ConfigurationParser::IsMemPropsValid() const
+{
+    if(m_MemProps.memoryHeapCount == 0 || m_MemProps.memoryHeapCount > VK_MAX_MEMORY_HEAPS ||
+        m_MemProps.memoryTypeCount == 0 || m_MemProps.memoryTypeCount > VK_MAX_MEMORY_TYPES)
+    {
+        return false;
+    }
+    for(uint32_t i = 0; i < m_MemProps.memoryTypeCount; ++i)
+    {
+        if(m_MemProps.memoryTypes[i].heapIndex >= m_MemProps.memoryHeapCount)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
 void ConfigurationParser::SetOption(
     size_t lineNumber,
     OPTION option,
@@ -1529,13 +1677,11 @@ static bool IsLayerSupported(const VkLayerProperties* pProps, size_t propCount,
         }) != propsEnd;
 }
 
-static const size_t FIRST_PARAM_INDEX = 4;
-
 static void InitVulkanFeatures(
     VkPhysicalDeviceFeatures& outFeatures,
     const VkPhysicalDeviceFeatures& supportedFeatures)
 {
-    ZeroMemory(&outFeatures, sizeof(outFeatures));
+    memset(&outFeatures, 0, sizeof(outFeatures));
 
     // Enable something what may interact with memory/buffer/image support.
 
@@ -1549,15 +1695,101 @@ static void InitVulkanFeatures(
     outFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// class ObjectTable
+
+/*
+Objects created during playback, indexed by dense indices that CompiledRecording
+assigned to their original pointers. Behaves like a map keyed by the original
+pointer: an entry exists from creation of the object until its destruction.
+*/
+template<typename T>
+class ObjectTable
+{
+public:
+    explicit ObjectTable(size_t size) : m_Entries(size) { }
+
+    size_t GetCount() const { return m_Count; }
+
+    // Returns null if there is no object with this index, e.g. for CompiledRecording::NULL_INDEX.
+    T* Find(uint32_t index)
+    {
+        if(index < m_Entries.size() && m_Entries[index].exists)
+        {
+            return &m_Entries[index].object;
+        }
+        return nullptr;
+    }
+
+    // If object with this index already exists, replaces it and returns false.
+    bool Insert(uint32_t index, const T& object)
+    {
+        assert(index < m_Entries.size());
+        Entry& entry = m_Entries[index];
+        entry.object = object;
+        if(entry.exists)
+        {
+            return false;
+        }
+        entry.exists = true;
+        ++m_Count;
+        return true;
+    }
+
+    void Remove(uint32_t index)
+    {
+        assert(Find(index) != nullptr);
+        m_Entries[index].exists = false;
+        --m_Count;
+    }
+
+    void Clear()
+    {
+        for(auto& entry : m_Entries)
+        {
+            entry.exists = false;
+        }
+        m_Count = 0;
+    }
+
+    // Calls func(T&) for every existing object.
+    template<typename Func>
+    void ForEach(Func func)
+    {
+        for(auto& entry : m_Entries)
+        {
+            if(entry.exists)
+            {
+                func(entry.object);
+            }
+        }
+    }
+
+private:
+    struct Entry
+    {
+        T object = T();
+        bool exists = false;
+    };
+    std::vector<Entry> m_Entries;
+    // Entries are created and destroyed from many threads during multithreaded playback.
+    std::atomic<size_t> m_Count = { 0 };
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// class Player
+
 class Player
 {
 public:
-    Player();
-    int Init();
+    explicit Player(const CompiledRecording& recording);
+    int Init(const ConfigurationParser& configParser);
     ~Player();
 
     void ApplyConfig(ConfigurationParser& configParser);
-    void ExecuteLine(size_t lineNumber, const StrRange& line);
+    void ExecuteLine(const CompiledLine& line);
+    uint32_t GetCurrentFrameIndex() const { return m_VmaFrameIndex; }
+    void SetCurrentFrameIndex(uint32_t frameIndex);
     void DumpStats(const char* fileNameFormat, size_t lineNumber, bool detailed);
     void Defragment();
 
@@ -1566,8 +1798,9 @@ public:
 private:
     static const size_t MAX_WARNINGS_TO_SHOW = 64;
 
-    size_t m_WarningCount = 0;
-    bool m_AllocateForBufferImageWarningIssued = false;
+    const CompiledRecording& m_Recording;
+    std::atomic<size_t> m_WarningCount = { 0 };
+    std::atomic<bool> m_AllocateForBufferImageWarningIssued = { false };
 
     VkInstance m_VulkanInstance = VK_NULL_HANDLE;
     VkPhysicalDevice m_PhysicalDevice = VK_NULL_HANDLE;
@@ -1579,14 +1812,18 @@ private:
     VmaAllocator m_Allocator = VK_NULL_HANDLE;
     VkCommandPool m_CommandPool = VK_NULL_HANDLE;
     VkCommandBuffer m_CommandBuffer = VK_NULL_HANDLE;
+    // Not null when replaying on null device instead of real Vulkan.
+    std::unique_ptr<NullDevice> m_NullDevice;
+    PFN_vkDestroyBuffer m_pvkDestroyBuffer = nullptr;
+    PFN_vkDestroyImage m_pvkDestroyImage = nullptr;
     bool m_DedicatedAllocationEnabled = false;
     const VkPhysicalDeviceProperties* m_DevProps = nullptr;
     const VkPhysicalDeviceMemoryProperties* m_MemProps = nullptr;
 
-    PFN_vkCreateDebugReportCallbackEXT m_pvkCreateDebugReportCallbackEXT;
-    PFN_vkDebugReportMessageEXT m_pvkDebugReportMessageEXT;
-    PFN_vkDestroyDebugReportCallbackEXT m_pvkDestroyDebugReportCallbackEXT;
-    VkDebugReportCallbackEXT m_hCallback;
+    PFN_vkCreateDebugReportCallbackEXT m_pvkCreateDebugReportCallbackEXT = nullptr;
+    PFN_vkDebugReportMessageEXT m_pvkDebugReportMessageEXT = nullptr;
+    PFN_vkDestroyDebugReportCallbackEXT m_pvkDestroyDebugReportCallbackEXT = nullptr;
+    VkDebugReportCallbackEXT m_hCallback = VK_NULL_HANDLE;
 
     uint32_t m_VmaFrameIndex = 0;
 
@@ -1602,83 +1839,96 @@ private:
         VkBuffer buffer = VK_NULL_HANDLE;
         VkImage image = VK_NULL_HANDLE;
     };
-    std::unordered_map<uint64_t, Pool> m_Pools;
-    std::unordered_map<uint64_t, Allocation> m_Allocations;
-    std::unordered_map<uint64_t, VmaDefragmentationContext> m_DefragmentationContexts;
+    ObjectTable<Pool> m_Pools;
+    ObjectTable<Allocation> m_Allocations;
+    ObjectTable<VmaDefragmentationContext> m_DefragmentationContexts;
 
     struct Thread
     {
-        uint32_t callCount;
+        uint32_t callCount = 0;
     };
-    std::unordered_map<uint32_t, Thread> m_Threads;
+    // Indexed like CompiledRecording::threadIds.
+    std::vector<Thread> m_Threads;
 
-    // Copy of column [1] from previously parsed line.
-    std::string m_LastLineTimeStr;
     Statistics m_Stats;
 
-    std::vector<char> m_UserDataTmpStr;
-
     void Destroy(const Allocation& alloc);
 
-    // Finds VmaPool bu original pointer.
-    // If origPool = null, returns true and outPool = null.
+    // Original pointer of the object with given index, for messages printed with "%llX". 0 for CompiledRecording::NULL_INDEX.
+    static unsigned long long GetOrigPtr(const std::vector<uint64_t>& origPtrs, uint32_t index)
+    {
+        return index < origPtrs.size() ? (unsigned long long)origPtrs[index] : 0;
+    }
+
+    // Finds VmaPool by index of its original pointer.
+    // If poolIndex = CompiledRecording::NULL_INDEX, returns true and outPool = null.
     // If failed, prints warning, returns false and outPool = null.
-    bool FindPool(size_t lineNumber, uint64_t origPool, VmaPool& outPool);
-    // If allocation with that origPtr already exists, prints warning and replaces it.
-    void AddAllocation(size_t lineNumber, uint64_t origPtr, VkResult res, const char* functionName, Allocation&& allocDesc);
+    bool FindPool(size_t lineNumber, uint32_t poolIndex, VmaPool& outPool);
+    // If allocation with that index already exists, prints warning and replaces it.
+    void AddAllocation(size_t lineNumber, uint32_t allocIndex, VkResult res, const char* functionName, Allocation&& allocDesc);
 
     // Increments warning counter. Returns true if warning message should be printed.
     bool IssueWarning();
 
     int InitVulkan();
+    int InitNullDevice(const ConfigurationParser& configParser);
+    int CreateAllocator(const VmaVulkanFunctions* pVulkanFunctions);
     void FinalizeVulkan();
     void RegisterDebugCallbacks();
 
-    // If parmeter count doesn't match, issues warning and returns false.
-    bool ValidateFunctionParameterCount(size_t lineNumber, const CsvSplit& csvSplit, size_t expectedParamCount, bool lastUnbound);
+    // On null device commands are executed immediately, so these do nothing.
+    VkResult BeginCommandBuffer();
+    void EndCommandBuffer();
+    void SubmitCommandBufferAndWait();
 
-    // If failed, prints warning, returns false, and sets allocCreateInfo.pUserData to null.
-    bool PrepareUserData(size_t lineNumber, uint32_t allocCreateFlags, const StrRange& userDataColumn, const StrRange& wholeLine, void*& outUserData);
+    // userData is the rest of the line starting from pUserData column.
+    // If failed, prints warning, returns false, and sets outUserData to null.
+    bool PrepareUserData(size_t lineNumber, uint32_t allocCreateFlags, const char* userData, void*& outUserData);
 
     void UpdateMemStats();
 
-    void ExecuteCreatePool(size_t lineNumber, const CsvSplit& csvSplit);
-    void ExecuteDestroyPool(size_t lineNumber, const CsvSplit& csvSplit);
-    void ExecuteSetAllocationUserData(size_t lineNumber, const CsvSplit& csvSplit);
-    void ExecuteCreateBuffer(size_t lineNumber, const CsvSplit& csvSplit);
-    void ExecuteDestroyBuffer(size_t lineNumber, const CsvSplit& csvSplit) { m_Stats.RegisterFunctionCall(VMA_FUNCTION::DestroyBuffer); DestroyAllocation(lineNumber, csvSplit, "vmaDestroyBuffer"); }
-    void ExecuteCreateImage(size_t lineNumber, const CsvSplit& csvSplit);
-    void ExecuteDestroyImage(size_t lineNumber, const CsvSplit& csvSplit) { m_Stats.RegisterFunctionCall(VMA_FUNCTION::DestroyImage); DestroyAllocation(lineNumber, csvSplit, "vmaDestroyImage"); }
-    void ExecuteFreeMemory(size_t lineNumber, const CsvSplit& csvSplit) { m_Stats.RegisterFunctionCall(VMA_FUNCTION::FreeMemory); DestroyAllocation(lineNumber, csvSplit, "vmaFreeMemory"); }
-    void ExecuteFreeMemoryPages(size_t lineNumber, const CsvSplit& csvSplit);
-    void ExecuteCreateLostAllocation(size_t lineNumber, const CsvSplit& csvSplit);
-    void ExecuteAllocateMemory(size_t lineNumber, const CsvSplit& csvSplit);
-    void ExecuteAllocateMemoryPages(size_t lineNumber, const CsvSplit& csvSplit);
-    void ExecuteAllocateMemoryForBufferOrImage(size_t lineNumber, const CsvSplit& csvSplit, OBJECT_TYPE objType);
-    void ExecuteMapMemory(size_t lineNumber, const CsvSplit& csvSplit);
-    void ExecuteUnmapMemory(size_t lineNumber, const CsvSplit& csvSplit);
-    void ExecuteFlushAllocation(size_t lineNumber, const CsvSplit& csvSplit);
-    void ExecuteInvalidateAllocation(size_t lineNumber, const CsvSplit& csvSplit);
-    void ExecuteTouchAllocation(size_t lineNumber, const CsvSplit& csvSplit);
-    void ExecuteGetAllocationInfo(size_t lineNumber, const CsvSplit& csvSplit);
-    void ExecuteMakePoolAllocationsLost(size_t lineNumber, const CsvSplit& csvSplit);
-    void ExecuteResizeAllocation(size_t lineNumber, const CsvSplit& csvSplit);
-    void ExecuteDefragmentationBegin(size_t lineNumber, const CsvSplit& csvSplit);
-    void ExecuteDefragmentationEnd(size_t lineNumber, const CsvSplit& csvSplit);
-
-    void DestroyAllocation(size_t lineNumber, const CsvSplit& csvSplit, const char* functionName);
+    // Parameters are read in the order of GetCompiledParamTypes.
+    void ExecuteCreatePool(size_t lineNumber, CompiledParamReader& params);
+    void ExecuteDestroyPool(size_t lineNumber, CompiledParamReader& params);
+    void ExecuteSetAllocationUserData(size_t lineNumber, CompiledParamReader& params);
+    void ExecuteCreateBuffer(size_t lineNumber, CompiledParamReader& params);
+    void ExecuteCreateImage(size_t lineNumber, CompiledParamReader& params);
+    // vmaDestroyBuffer, vmaDestroyImage, vmaFreeMemory.
+    void ExecuteDestroyAllocation(size_t lineNumber, CompiledParamReader& params);
+    void ExecuteFreeMemoryPages(size_t lineNumber, CompiledParamReader& params);
+    void ExecuteCreateLostAllocation(size_t lineNumber, CompiledParamReader& params);
+    void ExecuteAllocateMemory(size_t lineNumber, CompiledParamReader& params);
+    void ExecuteAllocateMemoryPages(size_t lineNumber, CompiledParamReader& params);
+    void ExecuteAllocateMemoryForBufferOrImage(size_t lineNumber, CompiledParamReader& params);
+    void ExecuteMapMemory(size_t lineNumber, CompiledParamReader& params);
+    void ExecuteUnmapMemory(size_t lineNumber, CompiledParamReader& params);
+    void ExecuteFlushAllocation(size_t lineNumber, CompiledParamReader& params);
+    void ExecuteInvalidateAllocation(size_t lineNumber, CompiledParamReader& params);
+    void ExecuteTouchAllocation(size_t lineNumber, CompiledParamReader& params);
+    void ExecuteGetAllocationInfo(size_t lineNumber, CompiledParamReader& params);
+    void ExecuteMakePoolAllocationsLost(size_t lineNumber, CompiledParamReader& params);
+    void ExecuteResizeAllocation(size_t lineNumber, CompiledParamReader& params);
+    void ExecuteDefragmentationBegin(size_t lineNumber, CompiledParamReader& params);
+    void ExecuteDefragmentationEnd(size_t lineNumber, CompiledParamReader& params);
+    void ExecuteFreePoolAllocations(size_t lineNumber, CompiledParamReader& params);
+    void ExecuteAllocateMemoryWithoutHandle(size_t lineNumber, CompiledParamReader& params);
 
     void PrintStats(const VmaStats& stats, const char* suffix);
     void PrintStatInfo(const VmaStatInfo& info);
 };
 
-Player::Player()
+Player::Player(const CompiledRecording& recording) :
+    m_Recording(recording),
+    m_Pools(recording.pools.size()),
+    m_Allocations(recording.allocations.size()),
+    m_DefragmentationContexts(recording.defragmentationContexts.size()),
+    m_Threads(recording.threadIds.size())
 {
 }
 
-int Player::Init()
+int Player::Init(const ConfigurationParser& configParser)
 {
-    int result = InitVulkan();
+    int result = g_NullDeviceEnabled ? InitNullDevice(configParser) : InitVulkan();
     
     if(result == 0)
     {
@@ -1693,8 +1943,9 @@ Player::~Player()
 {
     FinalizeVulkan();
 
-    if(g_Verbosity < VERBOSITY::MAXIMUM && m_WarningCount > MAX_WARNINGS_TO_SHOW)
-        printf("WARNING: %zu more warnings not shown.\n", m_WarningCount - MAX_WARNINGS_TO_SHOW);
+    const size_t warningCount = m_WarningCount.load();
+    if(g_Verbosity < VERBOSITY::MAXIMUM && warningCount > MAX_WARNINGS_TO_SHOW)
+        printf("WARNING: %zu more warnings not shown.\n", warningCount - MAX_WARNINGS_TO_SHOW);
 }
 
 void Player::ApplyConfig(ConfigurationParser& configParser)
@@ -1702,137 +1953,176 @@ void Player::ApplyConfig(ConfigurationParser& configParser)
     configParser.Compare(*m_DevProps, *m_MemProps, m_DedicatedAllocationEnabled);
 }
 
-void Player::ExecuteLine(size_t lineNumber, const StrRange& line)
+void Player::ExecuteLine(const CompiledLine& line)
 {
-    CsvSplit csvSplit;
-    csvSplit.Set(line);
+    const size_t lineNumber = (size_t)line.lineNumber;
+    const COMPILED_LINE_ERROR error = (COMPILED_LINE_ERROR)line.error;
 
-    if(csvSplit.GetCount() >= FIRST_PARAM_INDEX)
+    if(error == COMPILED_LINE_ERROR::TOO_FEW_COLUMNS)
     {
-        // Check thread ID.
-        uint32_t threadId;
-        if(StrRangeToUint(csvSplit.GetRange(0), threadId))
+        if(IssueWarning())
         {
-            const auto it = m_Threads.find(threadId);
-            if(it != m_Threads.end())
-            {
-                ++it->second.callCount;
-            }
-            else
-            {
-                Thread threadInfo{};
-                threadInfo.callCount = 1;
-                m_Threads[threadId] = threadInfo;
-            }
+            printf("Line %zu: Too few columns.\n", lineNumber);
         }
-        else
+        return;
+    }
+
+    // Check thread ID.
+    if(line.threadIndex != CompiledRecording::NULL_INDEX)
+    {
+        ++m_Threads[line.threadIndex].callCount;
+    }
+    else
+    {
+        if(IssueWarning())
         {
-            if(IssueWarning())
-            {
-                printf("Line %zu: Incorrect thread ID.\n", lineNumber);
-            }
+            printf("Line %zu: Incorrect thread ID.\n", lineNumber);
         }
+    }
 
-        // Save time.
-        csvSplit.GetRange(1).to_str(m_LastLineTimeStr);
-
-        // Update VMA current frame index.
-        StrRange frameIndexStr = csvSplit.GetRange(2);
-        uint32_t frameIndex;
-        if(StrRangeToUint(frameIndexStr, frameIndex))
+    // Update VMA current frame index.
+    if((line.flags & COMPILED_LINE_FLAG_FRAME_INDEX_VALID) != 0)
+    {
+        SetCurrentFrameIndex(line.frameIndex);
+    }
+    else
+    {
+        if(IssueWarning())
         {
-            if(frameIndex != m_VmaFrameIndex)
-            {
-                vmaSetCurrentFrameIndex(m_Allocator, frameIndex);
-                m_VmaFrameIndex = frameIndex;
-            }
+            printf("Line %zu: Incorrect frame index.\n", lineNumber);
         }
-        else
+    }
+
+    if(error == COMPILED_LINE_ERROR::UNKNOWN_FUNCTION)
+    {
+        if(IssueWarning())
         {
-            if(IssueWarning())
-            {
-                printf("Line %zu: Incorrect frame index.\n", lineNumber);
-            }
+            printf("Line %zu: Unknown function.\n", lineNumber);
         }
+        return;
+    }
 
-        StrRange functionName = csvSplit.GetRange(3);
+    const VMA_FUNCTION func = (VMA_FUNCTION)line.function;
+    if(func != VMA_FUNCTION::CreateAllocator && func != VMA_FUNCTION::DestroyAllocator)
+    {
+        m_Stats.RegisterFunctionCall(func);
+    }
 
-        if(StrRangeEq(functionName, "vmaCreateAllocator"))
-        {
-            if(ValidateFunctionParameterCount(lineNumber, csvSplit, 0, false))
-            {
-                // Nothing.
-            }
-        }
-        else if(StrRangeEq(functionName, "vmaDestroyAllocator"))
-        {
-            if(ValidateFunctionParameterCount(lineNumber, csvSplit, 0, false))
-            {
-                // Nothing.
-            }
-        }
-        else if(StrRangeEq(functionName, VMA_FUNCTION_NAMES[(uint32_t)VMA_FUNCTION::CreatePool]))
-            ExecuteCreatePool(lineNumber, csvSplit);
-        else if(StrRangeEq(functionName, VMA_FUNCTION_NAMES[(uint32_t)VMA_FUNCTION::DestroyPool]))
-            ExecuteDestroyPool(lineNumber, csvSplit);
-        else if(StrRangeEq(functionName, VMA_FUNCTION_NAMES[(uint32_t)VMA_FUNCTION::SetAllocationUserData]))
-            ExecuteSetAllocationUserData(lineNumber, csvSplit);
-        else if(StrRangeEq(functionName, VMA_FUNCTION_NAMES[(uint32_t)VMA_FUNCTION::CreateBuffer]))
-            ExecuteCreateBuffer(lineNumber, csvSplit);
-        else if(StrRangeEq(functionName, VMA_FUNCTION_NAMES[(uint32_t)VMA_FUNCTION::DestroyBuffer]))
-            ExecuteDestroyBuffer(lineNumber, csvSplit);
-        else if(StrRangeEq(functionName, VMA_FUNCTION_NAMES[(uint32_t)VMA_FUNCTION::CreateImage]))
-            ExecuteCreateImage(lineNumber, csvSplit);
-        else if(StrRangeEq(functionName, VMA_FUNCTION_NAMES[(uint32_t)VMA_FUNCTION::DestroyImage]))
-            ExecuteDestroyImage(lineNumber, csvSplit);
-        else if(StrRangeEq(functionName, VMA_FUNCTION_NAMES[(uint32_t)VMA_FUNCTION::FreeMemory]))
-            ExecuteFreeMemory(lineNumber, csvSplit);
-        else if(StrRangeEq(functionName, VMA_FUNCTION_NAMES[(uint32_t)VMA_FUNCTION::FreeMemoryPages]))
-            ExecuteFreeMemoryPages(lineNumber, csvSplit);
-        else if(StrRangeEq(functionName, VMA_FUNCTION_NAMES[(uint32_t)VMA_FUNCTION::CreateLostAllocation]))
-            ExecuteCreateLostAllocation(lineNumber, csvSplit);
-        else if(StrRangeEq(functionName, VMA_FUNCTION_NAMES[(uint32_t)VMA_FUNCTION::AllocateMemory]))
-            ExecuteAllocateMemory(lineNumber, csvSplit);
-        else if(StrRangeEq(functionName, VMA_FUNCTION_NAMES[(uint32_t)VMA_FUNCTION::AllocateMemoryPages]))
-            ExecuteAllocateMemoryPages(lineNumber, csvSplit);
-        else if(StrRangeEq(functionName, VMA_FUNCTION_NAMES[(uint32_t)VMA_FUNCTION::AllocateMemoryForBuffer]))
-            ExecuteAllocateMemoryForBufferOrImage(lineNumber, csvSplit, OBJECT_TYPE::BUFFER);
-        else if(StrRangeEq(functionName, VMA_FUNCTION_NAMES[(uint32_t)VMA_FUNCTION::AllocateMemoryForImage]))
-            ExecuteAllocateMemoryForBufferOrImage(lineNumber, csvSplit, OBJECT_TYPE::IMAGE);
-        else if(StrRangeEq(functionName, VMA_FUNCTION_NAMES[(uint32_t)VMA_FUNCTION::MapMemory]))
-            ExecuteMapMemory(lineNumber, csvSplit);
-        else if(StrRangeEq(functionName, VMA_FUNCTION_NAMES[(uint32_t)VMA_FUNCTION::UnmapMemory]))
-            ExecuteUnmapMemory(lineNumber, csvSplit);
-        else if(StrRangeEq(functionName, VMA_FUNCTION_NAMES[(uint32_t)VMA_FUNCTION::FlushAllocation]))
-            ExecuteFlushAllocation(lineNumber, csvSplit);
-        else if(StrRangeEq(functionName, VMA_FUNCTION_NAMES[(uint32_t)VMA_FUNCTION::InvalidateAllocation]))
-            ExecuteInvalidateAllocation(lineNumber, csvSplit);
-        else if(StrRangeEq(functionName, VMA_FUNCTION_NAMES[(uint32_t)VMA_FUNCTION::TouchAllocation]))
-            ExecuteTouchAllocation(lineNumber, csvSplit);
-        else if(StrRangeEq(functionName, VMA_FUNCTION_NAMES[(uint32_t)VMA_FUNCTION::GetAllocationInfo]))
-            ExecuteGetAllocationInfo(lineNumber, csvSplit);
-        else if(StrRangeEq(functionName, VMA_FUNCTION_NAMES[(uint32_t)VMA_FUNCTION::MakePoolAllocationsLost]))
-            ExecuteMakePoolAllocationsLost(lineNumber, csvSplit);
-        else if(StrRangeEq(functionName, VMA_FUNCTION_NAMES[(uint32_t)VMA_FUNCTION::ResizeAllocation]))
-            ExecuteResizeAllocation(lineNumber, csvSplit);
-        else if(StrRangeEq(functionName, VMA_FUNCTION_NAMES[(uint32_t)VMA_FUNCTION::DefragmentationBegin]))
-            ExecuteDefragmentationBegin(lineNumber, csvSplit);
-        else if(StrRangeEq(functionName, VMA_FUNCTION_NAMES[(uint32_t)VMA_FUNCTION::DefragmentationEnd]))
-            ExecuteDefragmentationEnd(lineNumber, csvSplit);
-        else
+    if(func == VMA_FUNCTION::SetAllocationUserData && !g_UserDataEnabled)
+    {
+        return;
+    }
+
+    if(error == COMPILED_LINE_ERROR::INCORRECT_PARAMETER_COUNT)
+    {
+        if(IssueWarning())
         {
-            if(IssueWarning())
-            {
-                printf("Line %zu: Unknown function.\n", lineNumber);
-            }
+            printf("Line %zu: Incorrect number of function parameters.\n", lineNumber);
         }
+        return;
     }
-    else
+    if(error == COMPILED_LINE_ERROR::INVALID_PARAMETERS)
     {
         if(IssueWarning())
         {
-            printf("Line %zu: Too few columns.\n", lineNumber);
+            const bool allocateForBufferOrImage =
+                func == VMA_FUNCTION::AllocateMemoryForBuffer ||
+                func == VMA_FUNCTION::AllocateMemoryForImage;
+            printf("Line %zu: Invalid parameters for %s.\n", lineNumber,
+                allocateForBufferOrImage ?
+                    "vmaAllocateMemoryForBuffer or vmaAllocateMemoryForImage" :
+                    VMA_FUNCTION_NAMES[(size_t)func]);
         }
+        return;
+    }
+
+    CompiledParamReader params(m_Recording, line);
+    switch(func)
+    {
+    case VMA_FUNCTION::CreatePool:
+        ExecuteCreatePool(lineNumber, params);
+        break;
+    case VMA_FUNCTION::DestroyPool:
+        ExecuteDestroyPool(lineNumber, params);
+        break;
+    case VMA_FUNCTION::SetAllocationUserData:
+        ExecuteSetAllocationUserData(lineNumber, params);
+        break;
+    case VMA_FUNCTION::CreateBuffer:
+        ExecuteCreateBuffer(lineNumber, params);
+        break;
+    case VMA_FUNCTION::CreateImage:
+        ExecuteCreateImage(lineNumber, params);
+        break;
+    case VMA_FUNCTION::DestroyBuffer:
+    case VMA_FUNCTION::DestroyImage:
+    case VMA_FUNCTION::FreeMemory:
+        ExecuteDestroyAllocation(lineNumber, params);
+        break;
+    case VMA_FUNCTION::FreeMemoryPages:
+        ExecuteFreeMemoryPages(lineNumber, params);
+        break;
+    case VMA_FUNCTION::CreateLostAllocation:
+        ExecuteCreateLostAllocation(lineNumber, params);
+        break;
+    case VMA_FUNCTION::AllocateMemory:
+        ExecuteAllocateMemory(lineNumber, params);
+        break;
+    case VMA_FUNCTION::AllocateMemoryPages:
+        ExecuteAllocateMemoryPages(lineNumber, params);
+        break;
+    case VMA_FUNCTION::AllocateMemoryForBuffer:
+    case VMA_FUNCTION::AllocateMemoryForImage:
+        ExecuteAllocateMemoryForBufferOrImage(lineNumber, params);
+        break;
+    case VMA_FUNCTION::MapMemory:
+        ExecuteMapMemory(lineNumber, params);
+        break;
+    case VMA_FUNCTION::UnmapMemory:
+        ExecuteUnmapMemory(lineNumber, params);
+        break;
+    case VMA_FUNCTION::FlushAllocation:
+        ExecuteFlushAllocation(lineNumber, params);
+        break;
+    case VMA_FUNCTION::InvalidateAllocation:
+        ExecuteInvalidateAllocation(lineNumber, params);
+        break;
+    case VMA_FUNCTION::TouchAllocation:
+        ExecuteTouchAllocation(lineNumber, params);
+        break;
+    case VMA_FUNCTION::GetAllocationInfo:
+        ExecuteGetAllocationInfo(lineNumber, params);
+        break;
+    case VMA_FUNCTION::MakePoolAllocationsLost:
+        ExecuteMakePoolAllocationsLost(lineNumber, params);
+        break;
+    case VMA_FUNCTION::ResizeAllocation:
+        ExecuteResizeAllocation(lineNumber, params);
+        break;
+    case VMA_FUNCTION::DefragmentationBegin:
+        ExecuteDefragmentationBegin(lineNumber, params);
+        break;
+    case VMA_FUNCTION::DefragmentationEnd:
+        ExecuteDefragmentationEnd(lineNumber, params);
+        break;
+    case VMA_FUNCTION::FreePoolAllocations:
+        ExecuteFreePoolAllocations(lineNumber, params);
+        break;
+    case VMA_FUNCTION::AllocateMemoryWithoutHandle:
+        ExecuteAllocateMemoryWithoutHandle(lineNumber, params);
+        break;
+    default:
+        // vmaCreateAllocator, vmaDestroyAllocator: Nothing.
+        break;
+    }
+}
+
+void Player::SetCurrentFrameIndex(uint32_t frameIndex)
+{
+    if(frameIndex != m_VmaFrameIndex)
+    {
+        vmaSetCurrentFrameIndex(m_Allocator, frameIndex);
+        m_VmaFrameIndex = frameIndex;
     }
 }
 
@@ -1841,12 +2131,11 @@ void Player::DumpStats(const char* fileNameFormat, size_t lineNumber, bool detai
     char* pStatsString = nullptr;
     vmaBuildStatsString(m_Allocator, &pStatsString, detailed ? VK_TRUE : VK_FALSE);
 
-    char fileName[MAX_PATH];
-    sprintf_s(fileName, fileNameFormat, lineNumber);
+    char fileName[1024];
+    snprintf(fileName, sizeof(fileName), fileNameFormat, lineNumber);
 
-    FILE* file = nullptr;
-    errno_t err = fopen_s(&file, fileName, "wb");
-    if(err == 0)
+    FILE* file = fopen(fileName, "wb");
+    if(file != nullptr)
     {
         fwrite(pStatsString, 1, strlen(pStatsString), file);
         fclose(file);
@@ -1874,23 +2163,23 @@ void Player::Destroy(const Allocation& alloc)
         vmaFreeMemory(m_Allocator, alloc.allocation);
 }
 
-bool Player::FindPool(size_t lineNumber, uint64_t origPool, VmaPool& outPool)
+bool Player::FindPool(size_t lineNumber, uint32_t poolIndex, VmaPool& outPool)
 {
     outPool = VK_NULL_HANDLE;
 
-    if(origPool != 0)
+    if(poolIndex != CompiledRecording::NULL_INDEX)
     {
-        const auto poolIt = m_Pools.find(origPool);
-        if(poolIt != m_Pools.end())
+        const Pool* const pool = m_Pools.Find(poolIndex);
+        if(pool != nullptr)
         {
-            outPool = poolIt->second.pool;
+            outPool = pool->pool;
             return true;
         }
         else
         {
             if(IssueWarning())
             {
-                printf("Line %zu: Pool %llX not found.\n", lineNumber, origPool);
+                printf("Line %zu: Pool %llX not found.\n", lineNumber, GetOrigPtr(m_Recording.pools, poolIndex));
             }
         }
     }
@@ -1898,9 +2187,9 @@ bool Player::FindPool(size_t lineNumber, uint64_t origPool, VmaPool& outPool)
     return true;
 }
 
-void Player::AddAllocation(size_t lineNumber, uint64_t origPtr, VkResult res, const char* functionName, Allocation&& allocDesc)
+void Player::AddAllocation(size_t lineNumber, uint32_t allocIndex, VkResult res, const char* functionName, Allocation&& allocDesc)
 {
-    if(origPtr)
+    if(allocIndex != CompiledRecording::NULL_INDEX)
     {
         if(res == VK_SUCCESS)
         {
@@ -1917,15 +2206,13 @@ void Player::AddAllocation(size_t lineNumber, uint64_t origPtr, VkResult res, co
             }
         }
 
-        const auto existingIt = m_Allocations.find(origPtr);
-        if(existingIt != m_Allocations.end())
+        if(!m_Allocations.Insert(allocIndex, allocDesc))
         {
             if(IssueWarning())
             {
-                printf("Line %zu: Allocation %llX already exists.\n", lineNumber, origPtr);
+                printf("Line %zu: Allocation %llX already exists.\n", lineNumber, GetOrigPtr(m_Recording.allocations, allocIndex));
             }
         }
-        m_Allocations[origPtr] = std::move(allocDesc);
     }
     else
     {
@@ -2202,33 +2489,15 @@ int Player::InitVulkan()
     vkGetDeviceQueue(m_Device, m_GraphicsQueueFamilyIndex, 0, &m_GraphicsQueue);
     vkGetDeviceQueue(m_Device, m_TransferQueueFamilyIndex, 0, &m_TransferQueue);
 
-    // Create memory allocator
+    m_pvkDestroyBuffer = vkDestroyBuffer;
+    m_pvkDestroyImage = vkDestroyImage;
 
-    VmaDeviceMemoryCallbacks deviceMemoryCallbacks = {};
-    deviceMemoryCallbacks.pfnAllocate = AllocateDeviceMemoryCallback;
-    deviceMemoryCallbacks.pfnFree = FreeDeviceMemoryCallback;
-
-    VmaAllocatorCreateInfo allocatorInfo = {};
-    allocatorInfo.physicalDevice = m_PhysicalDevice;
-    allocatorInfo.device = m_Device;
-    allocatorInfo.flags = VMA_ALLOCATOR_CREATE_EXTERNALLY_SYNCHRONIZED_BIT;
-    allocatorInfo.pDeviceMemoryCallbacks = &deviceMemoryCallbacks;
-
-    if(m_DedicatedAllocationEnabled)
-    {
-        allocatorInfo.flags |= VMA_ALLOCATOR_CREATE_KHR_DEDICATED_ALLOCATION_BIT;
-    }
-
-    res = vmaCreateAllocator(&allocatorInfo, &m_Allocator);
-    if(res != VK_SUCCESS)
+    int result = CreateAllocator(nullptr);
+    if(result != 0)
     {
-        printf("ERROR: vmaCreateAllocator failed (%d)\n", res);
-        return RESULT_ERROR_VULKAN;
+        return result;
     }
 
-    vmaGetPhysicalDeviceProperties(m_Allocator, &m_DevProps);
-    vmaGetMemoryProperties(m_Allocator, &m_MemProps);
-
     // Create command pool
 
     VkCommandPoolCreateInfo cmdPoolCreateInfo = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
@@ -2258,58 +2527,139 @@ int Player::InitVulkan()
     return 0;
 }
 
-void Player::FinalizeVulkan()
+int Player::InitNullDevice(const ConfigurationParser& configParser)
 {
-    if(!m_DefragmentationContexts.empty())
+    if(g_Verbosity == VERBOSITY::MAXIMUM)
     {
-        printf("WARNING: Defragmentation contexts not destroyed: %zu.\n", m_DefragmentationContexts.size());
-
-        if(CLEANUP_LEAKED_OBJECTS)
-        {
-            for(const auto& it : m_DefragmentationContexts)
-            {
-                vmaDefragmentationEnd(m_Allocator, it.second);
-            }
-        }
-
-        m_DefragmentationContexts.clear();
+        printf("Initializing null device...\n");
     }
 
-    if(!m_Allocations.empty())
+    // Null device resembles the device on which the file was recorded.
+    NullDeviceDesc desc;
+    configParser.GetNullDeviceDesc(desc);
+    desc.allocateMemoryLatency = g_NullDeviceAllocateMemoryLatency;
+    desc.freeMemoryLatency = g_NullDeviceFreeMemoryLatency;
+    desc.otherCallLatency = g_NullDeviceOtherCallLatency;
+
+    switch(g_VK_KHR_dedicated_allocation_request)
     {
-        printf("WARNING: Allocations not destroyed: %zu.\n", m_Allocations.size());
+    case VULKAN_EXTENSION_REQUEST::DISABLED:
+        desc.dedicatedAllocationExtension = false;
+        break;
+    case VULKAN_EXTENSION_REQUEST::DEFAULT:
+        break;
+    case VULKAN_EXTENSION_REQUEST::ENABLED:
+        desc.dedicatedAllocationExtension = true;
+        break;
+    default: assert(0);
+    }
+    m_DedicatedAllocationEnabled = desc.dedicatedAllocationExtension;
 
-        if(CLEANUP_LEAKED_OBJECTS)
-        {
-            for(const auto it : m_Allocations)
-            {
-                Destroy(it.second);
-            }
-        }
+    m_NullDevice.reset(new NullDevice(desc));
+    m_PhysicalDevice = m_NullDevice->GetPhysicalDevice();
+    m_Device = m_NullDevice->GetDevice();
+    m_CommandBuffer = m_NullDevice->GetCommandBuffer();
+    m_pvkDestroyBuffer = m_NullDevice->GetVulkanFunctions().vkDestroyBuffer;
+    m_pvkDestroyImage = m_NullDevice->GetVulkanFunctions().vkDestroyImage;
 
-        m_Allocations.clear();
+    if(g_Verbosity == VERBOSITY::MAXIMUM)
+    {
+        printf("Null device: %s, %u memory heaps, %u memory types\n",
+            desc.properties.deviceName,
+            desc.memoryProperties.memoryHeapCount,
+            desc.memoryProperties.memoryTypeCount);
     }
 
-    if(!m_Pools.empty())
-    {
-        printf("WARNING: Custom pools not destroyed: %zu.\n", m_Pools.size());
+    return CreateAllocator(&m_NullDevice->GetVulkanFunctions());
+}
+
+int Player::CreateAllocator(const VmaVulkanFunctions* pVulkanFunctions)
+{
+    VmaDeviceMemoryCallbacks deviceMemoryCallbacks = {};
+    deviceMemoryCallbacks.pfnAllocate = AllocateDeviceMemoryCallback;
+    deviceMemoryCallbacks.pfnFree = FreeDeviceMemoryCallback;
+
+    VmaAllocatorCreateInfo allocatorInfo = {};
+    allocatorInfo.physicalDevice = m_PhysicalDevice;
+    allocatorInfo.device = m_Device;
+    // Multithreaded playback calls the allocator from many threads at once.
+    allocatorInfo.flags = g_MultithreadedEnabled ? 0 : VMA_ALLOCATOR_CREATE_EXTERNALLY_SYNCHRONIZED_BIT;
+    allocatorInfo.pDeviceMemoryCallbacks = &deviceMemoryCallbacks;
+    allocatorInfo.pVulkanFunctions = pVulkanFunctions;
+
+    if(m_DedicatedAllocationEnabled)
+    {
+        allocatorInfo.flags |= VMA_ALLOCATOR_CREATE_KHR_DEDICATED_ALLOCATION_BIT;
+    }
+
+    VkResult res = vmaCreateAllocator(&allocatorInfo, &m_Allocator);
+    if(res != VK_SUCCESS)
+    {
+        printf("ERROR: vmaCreateAllocator failed (%d)\n", res);
+        return RESULT_ERROR_VULKAN;
+    }
+
+    vmaGetPhysicalDeviceProperties(m_Allocator, &m_DevProps);
+    vmaGetMemoryProperties(m_Allocator, &m_MemProps);
+
+    return 0;
+}
+
+void Player::FinalizeVulkan()
+{
+    if(m_DefragmentationContexts.GetCount() > 0)
+    {
+        printf("WARNING: Defragmentation contexts not destroyed: %zu.\n", m_DefragmentationContexts.GetCount());
 
         if(CLEANUP_LEAKED_OBJECTS)
         {
-            for(const auto it : m_Pools)
-            {
-                vmaDestroyPool(m_Allocator, it.second.pool);
-            }
+            m_DefragmentationContexts.ForEach([this](VmaDefragmentationContext defragCtx) {
+                vmaDefragmentationEnd(m_Allocator, defragCtx);
+            });
+        }
+
+        m_DefragmentationContexts.Clear();
+    }
+
+    if(m_Allocations.GetCount() > 0)
+    {
+        printf("WARNING: Allocations not destroyed: %zu.\n", m_Allocations.GetCount());
+
+        if(CLEANUP_LEAKED_OBJECTS)
+        {
+            m_Allocations.ForEach([this](const Allocation& alloc) {
+                Destroy(alloc);
+            });
+        }
+
+        m_Allocations.Clear();
+    }
+
+    if(m_Pools.GetCount() > 0)
+    {
+        printf("WARNING: Custom pools not destroyed: %zu.\n", m_Pools.GetCount());
+
+        if(CLEANUP_LEAKED_OBJECTS)
+        {
+            m_Pools.ForEach([this](const Pool& pool) {
+                vmaDestroyPool(m_Allocator, pool.pool);
+            });
         }
 
-        m_Pools.clear();
+        m_Pools.Clear();
     }
 
-    vkDeviceWaitIdle(m_Device);
+    if(m_NullDevice == nullptr && m_Device != VK_NULL_HANDLE)
+    {
+        vkDeviceWaitIdle(m_Device);
+    }
 
     if(m_CommandBuffer != VK_NULL_HANDLE)
     {
-        vkFreeCommandBuffers(m_Device, m_CommandPool, 1, &m_CommandBuffer);
+        if(m_NullDevice == nullptr)
+        {
+            vkFreeCommandBuffers(m_Device, m_CommandPool, 1, &m_CommandBuffer);
+        }
         m_CommandBuffer = VK_NULL_HANDLE;
     }
 
@@ -2325,7 +2675,13 @@ void Player::FinalizeVulkan()
         m_Allocator = nullptr;
     }
 
-    if(m_Device != VK_NULL_HANDLE)
+    if(m_NullDevice != nullptr)
+    {
+        m_NullDevice.reset();
+        m_Device = nullptr;
+        m_PhysicalDevice = nullptr;
+    }
+    else if(m_Device != VK_NULL_HANDLE)
     {
         vkDestroyDevice(m_Device, nullptr);
         m_Device = nullptr;
@@ -2371,37 +2727,68 @@ void Player::RegisterDebugCallbacks()
     assert(res == VK_SUCCESS);
 }
 
+VkResult Player::BeginCommandBuffer()
+{
+    if(m_NullDevice != nullptr)
+    {
+        return VK_SUCCESS;
+    }
+
+    VkCommandBufferBeginInfo cmdBufBeginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+    cmdBufBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    return vkBeginCommandBuffer(m_CommandBuffer, &cmdBufBeginInfo);
+}
+
+void Player::EndCommandBuffer()
+{
+    if(m_NullDevice == nullptr)
+    {
+        vkEndCommandBuffer(m_CommandBuffer);
+    }
+}
+
+void Player::SubmitCommandBufferAndWait()
+{
+    if(m_NullDevice == nullptr)
+    {
+        VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &m_CommandBuffer;
+        vkQueueSubmit(m_TransferQueue, 1, &submitInfo, VK_NULL_HANDLE);
+        vkQueueWaitIdle(m_TransferQueue);
+    }
+}
+
 void Player::Defragment()
 {
     VmaStats stats;
     vmaCalculateStats(m_Allocator, &stats);
     PrintStats(stats, "before defragmentation");
 
-    const size_t allocCount = m_Allocations.size();
-    std::vector<VmaAllocation> allocations(allocCount);
-    size_t notNullAllocCount = 0;
-    for(const auto& it : m_Allocations)
-    {
-        if(it.second.allocation != VK_NULL_HANDLE)
+    std::vector<VmaAllocation> allocations;
+    // Allocation object for every element of allocations.
+    std::vector<Allocation*> allocationDescs;
+    allocations.reserve(m_Allocations.GetCount());
+    allocationDescs.reserve(m_Allocations.GetCount());
+    m_Allocations.ForEach([&](Allocation& alloc) {
+        if(alloc.allocation != VK_NULL_HANDLE)
         {
-            allocations[notNullAllocCount] = it.second.allocation;
-            ++notNullAllocCount;
+            allocations.push_back(alloc.allocation);
+            allocationDescs.push_back(&alloc);
         }
-    }
+    });
+    const size_t notNullAllocCount = allocations.size();
     if(notNullAllocCount == 0)
     {
         printf("    Nothing to defragment.\n");
         return;
     }
 
-    allocations.resize(notNullAllocCount);
     std::vector<VkBool32> allocationsChanged(notNullAllocCount);
 
     VmaDefragmentationStats defragStats = {};
 
-    VkCommandBufferBeginInfo cmdBufBeginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
-    cmdBufBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-    VkResult res = vkBeginCommandBuffer(m_CommandBuffer, &cmdBufBeginInfo);
+    VkResult res = BeginCommandBuffer();
     if(res != VK_SUCCESS)
     {
         printf("ERROR: vkBeginCommandBuffer failed (%d)\n", res);
@@ -2426,15 +2813,11 @@ void Player::Defragment()
     
     const time_point timeAfterDefragBegin = std::chrono::high_resolution_clock::now();
 
-    vkEndCommandBuffer(m_CommandBuffer);
+    EndCommandBuffer();
 
     if(res >= VK_SUCCESS)
     {
-        VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &m_CommandBuffer;
-        vkQueueSubmit(m_TransferQueue, 1, &submitInfo, VK_NULL_HANDLE);
-        vkQueueWaitIdle(m_TransferQueue);
+        SubmitCommandBufferAndWait();
 
         const time_point timeAfterGpu = std::chrono::high_resolution_clock::now();
 
@@ -2450,23 +2833,22 @@ void Player::Defragment()
         if(defragStats.allocationsMoved > 0)
         {
             // Go over allocation that changed and destroy their buffers and images.
-            size_t i = 0;
-            for(auto& it : m_Allocations)
+            for(size_t i = 0; i < notNullAllocCount; ++i)
             {
                 if(allocationsChanged[i] != VK_FALSE)
                 {
-                    if(it.second.buffer != VK_NULL_HANDLE)
+                    Allocation& alloc = *allocationDescs[i];
+                    if(alloc.buffer != VK_NULL_HANDLE)
                     {
-                        vkDestroyBuffer(m_Device, it.second.buffer, nullptr);
-                        it.second.buffer = VK_NULL_HANDLE;
+                        m_pvkDestroyBuffer(m_Device, alloc.buffer, nullptr);
+                        alloc.buffer = VK_NULL_HANDLE;
                     }
-                    if(it.second.image != VK_NULL_HANDLE)
+                    if(alloc.image != VK_NULL_HANDLE)
                     {
-                        vkDestroyImage(m_Device, it.second.image, nullptr);
-                        it.second.image = VK_NULL_HANDLE;
+                        m_pvkDestroyImage(m_Device, alloc.image, nullptr);
+                        alloc.image = VK_NULL_HANDLE;
                     }
                 }
-                ++i;
             }
         }
 
@@ -2496,7 +2878,10 @@ void Player::Defragment()
         printf("vmaDefragmentationBegin failed (%d).\n", res);
     }
 
-    vkResetCommandPool(m_Device, m_CommandPool, 0);
+    if(m_NullDevice == nullptr)
+    {
+        vkResetCommandPool(m_Device, m_CommandPool, 0);
+    }
 }
 
 void Player::PrintStats()
@@ -2555,25 +2940,38 @@ void Player::PrintStats()
         printf("    Total custom pools created: %zu\n", m_Stats.GetPoolCreationCount());
     }
 
-    float lastTime;
-    if(!m_LastLineTimeStr.empty() && StrRangeToFloat(StrRange(m_LastLineTimeStr), lastTime))
+    // Time of the last played line. Lines may be played on many threads, so it is looked up after playback.
+    for(size_t i = m_Recording.lines.size(); i--; )
     {
-        std::string origTimeStr;
-        SecondsToFriendlyStr(lastTime, origTimeStr);
-        printf("    Original recording time: %s\n", origTimeStr.c_str());
+        const CompiledLine& line = m_Recording.lines[i];
+        if((COMPILED_LINE_ERROR)line.error != COMPILED_LINE_ERROR::TOO_FEW_COLUMNS &&
+            (g_LineRanges.IsEmpty() || g_LineRanges.Includes((size_t)line.lineNumber)))
+        {
+            if((line.flags & COMPILED_LINE_FLAG_TIME_VALID) != 0)
+            {
+                std::string origTimeStr;
+                SecondsToFriendlyStr(line.time, origTimeStr);
+                printf("    Original recording time: %s\n", origTimeStr.c_str());
+            }
+            break;
+        }
     }
 
     // Thread statistics.
-    const size_t threadCount = m_Threads.size();
-    if(threadCount > 1)
+    size_t threadCount = 0;
+    uint32_t threadCallCountMax = 0;
+    uint32_t threadCallCountSum = 0;
+    for(const Thread& thread : m_Threads)
     {
-        uint32_t threadCallCountMax = 0;
-        uint32_t threadCallCountSum = 0;
-        for(const auto& it : m_Threads)
+        if(thread.callCount > 0)
         {
-            threadCallCountMax = std::max(threadCallCountMax, it.second.callCount);
-            threadCallCountSum += it.second.callCount;
+            ++threadCount;
+            threadCallCountMax = std::max(threadCallCountMax, thread.callCount);
+            threadCallCountSum += thread.callCount;
         }
+    }
+    if(threadCount > 1)
+    {
         printf("    Threads making calls to VMA: %zu\n", threadCount);
         printf("        %.2f%% calls from most active thread.\n",
             (float)threadCallCountMax * 100.f / (float)threadCallCountSum);
@@ -2609,26 +3007,7 @@ void Player::PrintStats()
     }
 }
 
-bool Player::ValidateFunctionParameterCount(size_t lineNumber, const CsvSplit& csvSplit, size_t expectedParamCount, bool lastUnbound)
-{
-    bool ok;
-    if(lastUnbound)
-        ok = csvSplit.GetCount() >= FIRST_PARAM_INDEX + expectedParamCount - 1;
-    else
-        ok = csvSplit.GetCount() == FIRST_PARAM_INDEX + expectedParamCount;
-
-    if(!ok)
-    {
-        if(IssueWarning())
-        {
-            printf("Line %zu: Incorrect number of function parameters.\n", lineNumber);
-        }
-    }
-
-    return ok;
-}
-
-bool Player::PrepareUserData(size_t lineNumber, uint32_t allocCreateFlags, const StrRange& userDataColumn, const StrRange& wholeLine, void*& outUserData)
+bool Player::PrepareUserData(size_t lineNumber, uint32_t allocCreateFlags, const char* userData, void*& outUserData)
 {
     if(!g_UserDataEnabled)
     {
@@ -2639,18 +3018,15 @@ bool Player::PrepareUserData(size_t lineNumber, uint32_t allocCreateFlags, const
     // String
     if((allocCreateFlags & VMA_ALLOCATION_CREATE_USER_DATA_COPY_STRING_BIT) != 0)
     {
-        const size_t len = wholeLine.end - userDataColumn.beg;
-        m_UserDataTmpStr.resize(len + 1);
-        memcpy(m_UserDataTmpStr.data(), userDataColumn.beg, len);
-        m_UserDataTmpStr[len] = '\0';
-        outUserData = m_UserDataTmpStr.data();
+        // Null-terminated copy of the rest of the line is stored in the compiled recording.
+        outUserData = const_cast<char*>(userData);
         return true;
     }
     // Pointer
     else
     {
         uint64_t pUserData = 0;
-        if(StrRangeToPtr(userDataColumn, pUserData))
+        if(StrRangeToPtr(StrRange(userData, userData + strcspn(userData, ",")), pUserData))
         {
             outUserData = (void*)(uintptr_t)pUserData;
             return true;
@@ -2677,265 +3053,183 @@ void Player::UpdateMemStats()
     m_Stats.UpdateMemStats(stats);
 }
 
-void Player::ExecuteCreatePool(size_t lineNumber, const CsvSplit& csvSplit)
+void Player::ExecuteCreatePool(size_t lineNumber, CompiledParamReader& params)
 {
-    m_Stats.RegisterFunctionCall(VMA_FUNCTION::CreatePool);
-
-    if(ValidateFunctionParameterCount(lineNumber, csvSplit, 7, false))
-    {
-        VmaPoolCreateInfo poolCreateInfo = {};
-        uint64_t origPtr = 0;
-
-        if(StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX), poolCreateInfo.memoryTypeIndex) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 1), poolCreateInfo.flags) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 2), poolCreateInfo.blockSize) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 3), poolCreateInfo.minBlockCount) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 4), poolCreateInfo.maxBlockCount) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 5), poolCreateInfo.frameInUseCount) &&
-            StrRangeToPtr(csvSplit.GetRange(FIRST_PARAM_INDEX + 6), origPtr))
-        {
-            m_Stats.RegisterCreatePool(poolCreateInfo);
+    VmaPoolCreateInfo poolCreateInfo = {};
+    poolCreateInfo.memoryTypeIndex = params.GetUint32();
+    poolCreateInfo.flags = params.GetUint32();
+    poolCreateInfo.blockSize = params.GetUint64();
+    poolCreateInfo.minBlockCount = (size_t)params.GetUint64();
+    poolCreateInfo.maxBlockCount = (size_t)params.GetUint64();
+    poolCreateInfo.frameInUseCount = params.GetUint32();
+    const uint32_t poolIndex = params.GetIndex();
 
-            Pool poolDesc = {};
-            VkResult res = vmaCreatePool(m_Allocator, &poolCreateInfo, &poolDesc.pool);
+    m_Stats.RegisterCreatePool(poolCreateInfo);
 
-            if(origPtr)
-            {
-                if(res == VK_SUCCESS)
-                {
-                    // Originally succeeded, currently succeeded.
-                    // Just save pointer (done below).
-                }
-                else
-                {
-                    // Originally succeeded, currently failed.
-                    // Print warning. Save null pointer.
-                    if(IssueWarning())
-                    {
-                        printf("Line %zu: vmaCreatePool failed (%d), while originally succeeded.\n", lineNumber, res);
-                    }
-               }
+    Pool poolDesc = {};
+    VkResult res = vmaCreatePool(m_Allocator, &poolCreateInfo, &poolDesc.pool);
 
-                const auto existingIt = m_Pools.find(origPtr);
-                if(existingIt != m_Pools.end())
-                {
-                    if(IssueWarning())
-                    {
-                        printf("Line %zu: Pool %llX already exists.\n", lineNumber, origPtr);
-                    }
-                }
-                m_Pools[origPtr] = poolDesc;
-            }
-            else
+    if(poolIndex != CompiledRecording::NULL_INDEX)
+    {
+        if(res == VK_SUCCESS)
+        {
+            // Originally succeeded, currently succeeded.
+            // Just save pointer (done below).
+        }
+        else
+        {
+            // Originally succeeded, currently failed.
+            // Print warning. Save null pointer.
+            if(IssueWarning())
             {
-                if(res == VK_SUCCESS)
-                {
-                    // Originally failed, currently succeeded.
-                    // Print warning, destroy the pool.
-                    if(IssueWarning())
-                    {
-                        printf("Line %zu: vmaCreatePool succeeded, originally failed.\n", lineNumber);
-                    }
-
-                    vmaDestroyPool(m_Allocator, poolDesc.pool);
-                }
-                else
-                {
-                    // Originally failed, currently failed.
-                    // Print warning.
-                    if(IssueWarning())
-                    {
-                        printf("Line %zu: vmaCreatePool failed (%d), originally also failed.\n", lineNumber, res);
-                    }
-                }
+                printf("Line %zu: vmaCreatePool failed (%d), while originally succeeded.\n", lineNumber, res);
             }
-
-            UpdateMemStats();
         }
-        else
+
+        if(!m_Pools.Insert(poolIndex, poolDesc))
         {
             if(IssueWarning())
             {
-                printf("Line %zu: Invalid parameters for vmaCreatePool.\n", lineNumber);
+                printf("Line %zu: Pool %llX already exists.\n", lineNumber, GetOrigPtr(m_Recording.pools, poolIndex));
             }
         }
     }
-}
-
-void Player::ExecuteDestroyPool(size_t lineNumber, const CsvSplit& csvSplit)
-{
-    m_Stats.RegisterFunctionCall(VMA_FUNCTION::DestroyPool);
-
-    if(ValidateFunctionParameterCount(lineNumber, csvSplit, 1, false))
+    else
     {
-        uint64_t origPtr = 0;
-
-        if(StrRangeToPtr(csvSplit.GetRange(FIRST_PARAM_INDEX), origPtr))
+        if(res == VK_SUCCESS)
         {
-            if(origPtr != 0)
+            // Originally failed, currently succeeded.
+            // Print warning, destroy the pool.
+            if(IssueWarning())
             {
-                const auto it = m_Pools.find(origPtr);
-                if(it != m_Pools.end())
-                {
-                    vmaDestroyPool(m_Allocator, it->second.pool);
-                    UpdateMemStats();
-                    m_Pools.erase(it);
-                }
-                else
-                {
-                    if(IssueWarning())
-                    {
-                        printf("Line %zu: Pool %llX not found.\n", lineNumber, origPtr);
-                    }
-                }
+                printf("Line %zu: vmaCreatePool succeeded, originally failed.\n", lineNumber);
             }
+
+            vmaDestroyPool(m_Allocator, poolDesc.pool);
         }
         else
         {
+            // Originally failed, currently failed.
+            // Print warning.
             if(IssueWarning())
             {
-                printf("Line %zu: Invalid parameters for vmaDestroyPool.\n", lineNumber);
+                printf("Line %zu: vmaCreatePool failed (%d), originally also failed.\n", lineNumber, res);
             }
         }
     }
+
+    UpdateMemStats();
 }
 
-void Player::ExecuteSetAllocationUserData(size_t lineNumber, const CsvSplit& csvSplit)
+void Player::ExecuteDestroyPool(size_t lineNumber, CompiledParamReader& params)
 {
-    m_Stats.RegisterFunctionCall(VMA_FUNCTION::SetAllocationUserData);
-
-    if(!g_UserDataEnabled)
-    {
-        return;
-    }
-
-    if(ValidateFunctionParameterCount(lineNumber, csvSplit, 2, true))
+    const uint32_t poolIndex = params.GetIndex();
+    if(poolIndex != CompiledRecording::NULL_INDEX)
     {
-        uint64_t origPtr = 0;
-        if(StrRangeToPtr(csvSplit.GetRange(FIRST_PARAM_INDEX), origPtr))
+        const Pool* const pool = m_Pools.Find(poolIndex);
+        if(pool != nullptr)
         {
-            const auto it = m_Allocations.find(origPtr);
-            if(it != m_Allocations.end())
-            {
-                void* pUserData = nullptr;
-                if(csvSplit.GetCount() > FIRST_PARAM_INDEX + 1)
-                {
-                    PrepareUserData(
-                        lineNumber,
-                        it->second.allocationFlags,
-                        csvSplit.GetRange(FIRST_PARAM_INDEX + 1),
-                        csvSplit.GetLine(),
-                        pUserData);
-                }
-
-                vmaSetAllocationUserData(m_Allocator, it->second.allocation, pUserData);
-            }
-            else
-            {
-                if(IssueWarning())
-                {
-                    printf("Line %zu: Allocation %llX not found.\n", lineNumber, origPtr);
-                }
-            }
+            vmaDestroyPool(m_Allocator, pool->pool);
+            UpdateMemStats();
+            m_Pools.Remove(poolIndex);
         }
         else
         {
             if(IssueWarning())
             {
-                printf("Line %zu: Invalid parameters for vmaSetAllocationUserData.\n", lineNumber);
+                printf("Line %zu: Pool %llX not found.\n", lineNumber, GetOrigPtr(m_Recording.pools, poolIndex));
             }
         }
     }
 }
 
-void Player::ExecuteCreateBuffer(size_t lineNumber, const CsvSplit& csvSplit)
+void Player::ExecuteSetAllocationUserData(size_t lineNumber, CompiledParamReader& params)
 {
-    m_Stats.RegisterFunctionCall(VMA_FUNCTION::CreateBuffer);
+    const uint32_t allocIndex = params.GetIndex();
+    const char* const userData = params.GetUserData();
 
-    if(ValidateFunctionParameterCount(lineNumber, csvSplit, 12, true))
+    const Allocation* const alloc = m_Allocations.Find(allocIndex);
+    if(alloc != nullptr)
     {
-        VkBufferCreateInfo bufCreateInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
-        VmaAllocationCreateInfo allocCreateInfo = {};
-        uint64_t origPool = 0;
-        uint64_t origPtr = 0;
-
-        if(StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX), bufCreateInfo.flags) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 1), bufCreateInfo.size) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 2), bufCreateInfo.usage) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 3), (uint32_t&)bufCreateInfo.sharingMode) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 4), allocCreateInfo.flags) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 5), (uint32_t&)allocCreateInfo.usage) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 6), allocCreateInfo.requiredFlags) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 7), allocCreateInfo.preferredFlags) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 8), allocCreateInfo.memoryTypeBits) &&
-            StrRangeToPtr(csvSplit.GetRange(FIRST_PARAM_INDEX + 9), origPool) &&
-            StrRangeToPtr(csvSplit.GetRange(FIRST_PARAM_INDEX + 10), origPtr))
+        void* pUserData = nullptr;
+        if(userData != nullptr)
         {
-            FindPool(lineNumber, origPool, allocCreateInfo.pool);
-
-            if(csvSplit.GetCount() > FIRST_PARAM_INDEX + 11)
-            {
-                PrepareUserData(
-                    lineNumber,
-                    allocCreateInfo.flags,
-                    csvSplit.GetRange(FIRST_PARAM_INDEX + 11),
-                    csvSplit.GetLine(),
-                    allocCreateInfo.pUserData);
-            }
-
-            m_Stats.RegisterCreateBuffer(bufCreateInfo);
-            m_Stats.RegisterCreateAllocation(allocCreateInfo);
-
-            // Forcing VK_SHARING_MODE_EXCLUSIVE because we use only one queue anyway.
-            bufCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-            Allocation allocDesc = { };
-            allocDesc.allocationFlags = allocCreateInfo.flags;
-            VkResult res = vmaCreateBuffer(m_Allocator, &bufCreateInfo, &allocCreateInfo, &allocDesc.buffer, &allocDesc.allocation, nullptr);
-            UpdateMemStats();
-            AddAllocation(lineNumber, origPtr, res, "vmaCreateBuffer", std::move(allocDesc));
+            PrepareUserData(
+                lineNumber,
+                alloc->allocationFlags,
+                userData,
+                pUserData);
         }
-        else
+
+        vmaSetAllocationUserData(m_Allocator, alloc->allocation, pUserData);
+    }
+    else
+    {
+        if(IssueWarning())
         {
-            if(IssueWarning())
-            {
-                printf("Line %zu: Invalid parameters for vmaCreateBuffer.\n", lineNumber);
-            }
+            printf("Line %zu: Allocation %llX not found.\n", lineNumber, GetOrigPtr(m_Recording.allocations, allocIndex));
         }
     }
 }
 
-void Player::DestroyAllocation(size_t lineNumber, const CsvSplit& csvSplit, const char* functionName)
+void Player::ExecuteCreateBuffer(size_t lineNumber, CompiledParamReader& params)
 {
-    if(ValidateFunctionParameterCount(lineNumber, csvSplit, 1, false))
-    {
-        uint64_t origAllocPtr = 0;
+    VkBufferCreateInfo bufCreateInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+    VmaAllocationCreateInfo allocCreateInfo = {};
+    bufCreateInfo.flags = params.GetUint32();
+    bufCreateInfo.size = params.GetUint64();
+    bufCreateInfo.usage = params.GetUint32();
+    bufCreateInfo.sharingMode = (VkSharingMode)params.GetUint32();
+    allocCreateInfo.flags = params.GetUint32();
+    allocCreateInfo.usage = (VmaMemoryUsage)params.GetUint32();
+    allocCreateInfo.requiredFlags = params.GetUint32();
+    allocCreateInfo.preferredFlags = params.GetUint32();
+    allocCreateInfo.memoryTypeBits = params.GetUint32();
+    const uint32_t poolIndex = params.GetIndex();
+    const uint32_t allocIndex = params.GetIndex();
+    const char* const userData = params.GetUserData();
+
+    FindPool(lineNumber, poolIndex, allocCreateInfo.pool);
+
+    if(userData != nullptr)
+    {
+        PrepareUserData(
+            lineNumber,
+            allocCreateInfo.flags,
+            userData,
+            allocCreateInfo.pUserData);
+    }
+
+    m_Stats.RegisterCreateBuffer(bufCreateInfo);
+    m_Stats.RegisterCreateAllocation(allocCreateInfo);
+
+    // Forcing VK_SHARING_MODE_EXCLUSIVE because we use only one queue anyway.
+    bufCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    Allocation allocDesc = { };
+    allocDesc.allocationFlags = allocCreateInfo.flags;
+    VkResult res = vmaCreateBuffer(m_Allocator, &bufCreateInfo, &allocCreateInfo, &allocDesc.buffer, &allocDesc.allocation, nullptr);
+    UpdateMemStats();
+    AddAllocation(lineNumber, allocIndex, res, "vmaCreateBuffer", std::move(allocDesc));
+}
 
-        if(StrRangeToPtr(csvSplit.GetRange(FIRST_PARAM_INDEX), origAllocPtr))
+void Player::ExecuteDestroyAllocation(size_t lineNumber, CompiledParamReader& params)
+{
+    const uint32_t allocIndex = params.GetIndex();
+    if(allocIndex != CompiledRecording::NULL_INDEX)
+    {
+        const Allocation* const alloc = m_Allocations.Find(allocIndex);
+        if(alloc != nullptr)
         {
-            if(origAllocPtr != 0)
-            {
-                const auto it = m_Allocations.find(origAllocPtr);
-                if(it != m_Allocations.end())
-                {
-                    Destroy(it->second);
-                    UpdateMemStats();
-                    m_Allocations.erase(it);
-                }
-                else
-                {
-                    if(IssueWarning())
-                    {
-                        printf("Line %zu: Allocation %llX not found.\n", lineNumber, origAllocPtr);
-                    }
-                }
-            }
+            Destroy(*alloc);
+            UpdateMemStats();
+            m_Allocations.Remove(allocIndex);
         }
         else
         {
             if(IssueWarning())
             {
-                printf("Line %zu: Invalid parameters for %s.\n", lineNumber, functionName);
+                printf("Line %zu: Allocation %llX not found.\n", lineNumber, GetOrigPtr(m_Recording.allocations, allocIndex));
             }
         }
     }
@@ -2977,248 +3271,288 @@ void Player::PrintStatInfo(const VmaStatInfo& info)
     printf("            unusedRangeSizeMax: %llu\n", info.unusedRangeSizeMax);
 }
 
-void Player::ExecuteCreateImage(size_t lineNumber, const CsvSplit& csvSplit)
-{
-    m_Stats.RegisterFunctionCall(VMA_FUNCTION::CreateImage);
-
-    if(ValidateFunctionParameterCount(lineNumber, csvSplit, 21, true))
-    {
-        VkImageCreateInfo imageCreateInfo = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
-        VmaAllocationCreateInfo allocCreateInfo = {};
-        uint64_t origPool = 0;
-        uint64_t origPtr = 0;
-
-        if(StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX), imageCreateInfo.flags) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 1), (uint32_t&)imageCreateInfo.imageType) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 2), (uint32_t&)imageCreateInfo.format) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 3), imageCreateInfo.extent.width) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 4), imageCreateInfo.extent.height) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 5), imageCreateInfo.extent.depth) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 6), imageCreateInfo.mipLevels) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 7), imageCreateInfo.arrayLayers) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 8), (uint32_t&)imageCreateInfo.samples) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 9), (uint32_t&)imageCreateInfo.tiling) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 10), imageCreateInfo.usage) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 11), (uint32_t&)imageCreateInfo.sharingMode) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 12), (uint32_t&)imageCreateInfo.initialLayout) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 13), allocCreateInfo.flags) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 14), (uint32_t&)allocCreateInfo.usage) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 15), allocCreateInfo.requiredFlags) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 16), allocCreateInfo.preferredFlags) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 17), allocCreateInfo.memoryTypeBits) &&
-            StrRangeToPtr(csvSplit.GetRange(FIRST_PARAM_INDEX + 18), origPool) &&
-            StrRangeToPtr(csvSplit.GetRange(FIRST_PARAM_INDEX + 19), origPtr))
-        {
-            FindPool(lineNumber, origPool, allocCreateInfo.pool);
-
-            if(csvSplit.GetCount() > FIRST_PARAM_INDEX + 20)
-            {
-                PrepareUserData(
-                    lineNumber,
-                    allocCreateInfo.flags,
-                    csvSplit.GetRange(FIRST_PARAM_INDEX + 20),
-                    csvSplit.GetLine(),
-                    allocCreateInfo.pUserData);
-            }
 
-            m_Stats.RegisterCreateImage(imageCreateInfo);
-            m_Stats.RegisterCreateAllocation(allocCreateInfo);
+void Player::ExecuteCreateImage(size_t lineNumber, CompiledParamReader& params)
+{
+    VkImageCreateInfo imageCreateInfo = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+    VmaAllocationCreateInfo allocCreateInfo = {};
+    imageCreateInfo.flags = params.GetUint32();
+    imageCreateInfo.imageType = (VkImageType)params.GetUint32();
+    imageCreateInfo.format = (VkFormat)params.GetUint32();
+    imageCreateInfo.extent.width = params.GetUint32();
+    imageCreateInfo.extent.height = params.GetUint32();
+    imageCreateInfo.extent.depth = params.GetUint32();
+    imageCreateInfo.mipLevels = params.GetUint32();
+    imageCreateInfo.arrayLayers = params.GetUint32();
+    imageCreateInfo.samples = (VkSampleCountFlagBits)params.GetUint32();
+    imageCreateInfo.tiling = (VkImageTiling)params.GetUint32();
+    imageCreateInfo.usage = params.GetUint32();
+    imageCreateInfo.sharingMode = (VkSharingMode)params.GetUint32();
+    imageCreateInfo.initialLayout = (VkImageLayout)params.GetUint32();
+    allocCreateInfo.flags = params.GetUint32();
+    allocCreateInfo.usage = (VmaMemoryUsage)params.GetUint32();
+    allocCreateInfo.requiredFlags = params.GetUint32();
+    allocCreateInfo.preferredFlags = params.GetUint32();
+    allocCreateInfo.memoryTypeBits = params.GetUint32();
+    const uint32_t poolIndex = params.GetIndex();
+    const uint32_t allocIndex = params.GetIndex();
+    const char* const userData = params.GetUserData();
+
+    FindPool(lineNumber, poolIndex, allocCreateInfo.pool);
+
+    if(userData != nullptr)
+    {
+        PrepareUserData(
+            lineNumber,
+            allocCreateInfo.flags,
+            userData,
+            allocCreateInfo.pUserData);
+    }
+
+    m_Stats.RegisterCreateImage(imageCreateInfo);
+    m_Stats.RegisterCreateAllocation(allocCreateInfo);
+
+    // Forcing VK_SHARING_MODE_EXCLUSIVE because we use only one queue anyway.
+    imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    Allocation allocDesc = {};
+    allocDesc.allocationFlags = allocCreateInfo.flags;
+    VkResult res = vmaCreateImage(m_Allocator, &imageCreateInfo, &allocCreateInfo, &allocDesc.image, &allocDesc.allocation, nullptr);
+    UpdateMemStats();
+    AddAllocation(lineNumber, allocIndex, res, "vmaCreateImage", std::move(allocDesc));
+}
 
-            // Forcing VK_SHARING_MODE_EXCLUSIVE because we use only one queue anyway.
-            imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+void Player::ExecuteFreeMemoryPages(size_t lineNumber, CompiledParamReader& params)
+{
+    const uint32_t* allocIndices = nullptr;
+    const uint32_t allocCount = params.GetIndexList(allocIndices);
 
-            Allocation allocDesc = {};
-            allocDesc.allocationFlags = allocCreateInfo.flags;
-            VkResult res = vmaCreateImage(m_Allocator, &imageCreateInfo, &allocCreateInfo, &allocDesc.image, &allocDesc.allocation, nullptr);
-            UpdateMemStats();
-            AddAllocation(lineNumber, origPtr, res, "vmaCreateImage", std::move(allocDesc));
-        }
-        else
+    size_t notNullCount = 0;
+    for(uint32_t i = 0; i < allocCount; ++i)
+    {
+        const uint32_t allocIndex = allocIndices[i];
+        if(allocIndex != CompiledRecording::NULL_INDEX)
         {
-            if(IssueWarning())
+            const Allocation* const alloc = m_Allocations.Find(allocIndex);
+            if(alloc != nullptr)
+            {
+                Destroy(*alloc);
+                m_Allocations.Remove(allocIndex);
+                ++notNullCount;
+            }
+            else
             {
-                printf("Line %zu: Invalid parameters for vmaCreateImage.\n", lineNumber);
+                if(IssueWarning())
+                {
+                    printf("Line %zu: Allocation %llX not found.\n", lineNumber, GetOrigPtr(m_Recording.allocations, allocIndex));
+                }
             }
         }
     }
+    if(notNullCount)
+    {
+        UpdateMemStats();
+    }
 }
 
-void Player::ExecuteFreeMemoryPages(size_t lineNumber, const CsvSplit& csvSplit)
+void Player::ExecuteCreateLostAllocation(size_t lineNumber, CompiledParamReader& params)
 {
-    m_Stats.RegisterFunctionCall(VMA_FUNCTION::FreeMemoryPages);
-    
-    if(ValidateFunctionParameterCount(lineNumber, csvSplit, 1, false))
-    {
-        std::vector<uint64_t> origAllocPtrs;
-        if(StrRangeToPtrList(csvSplit.GetRange(FIRST_PARAM_INDEX), origAllocPtrs))
+    const uint32_t allocIndex = params.GetIndex();
+
+    Allocation allocDesc = {};
+    vmaCreateLostAllocation(m_Allocator, &allocDesc.allocation);
+    UpdateMemStats();
+    m_Stats.RegisterCreateLostAllocation();
+
+    AddAllocation(lineNumber, allocIndex, VK_SUCCESS, "vmaCreateLostAllocation", std::move(allocDesc));
+}
+
+void Player::ExecuteAllocateMemory(size_t lineNumber, CompiledParamReader& params)
+{
+    VkMemoryRequirements memReq = {};
+    VmaAllocationCreateInfo allocCreateInfo = {};
+    memReq.size = params.GetUint64();
+    memReq.alignment = params.GetUint64();
+    memReq.memoryTypeBits = params.GetUint32();
+    allocCreateInfo.flags = params.GetUint32();
+    allocCreateInfo.usage = (VmaMemoryUsage)params.GetUint32();
+    allocCreateInfo.requiredFlags = params.GetUint32();
+    allocCreateInfo.preferredFlags = params.GetUint32();
+    allocCreateInfo.memoryTypeBits = params.GetUint32();
+    const uint32_t poolIndex = params.GetIndex();
+    const uint32_t allocIndex = params.GetIndex();
+    const char* const userData = params.GetUserData();
+
+    FindPool(lineNumber, poolIndex, allocCreateInfo.pool);
+
+    if(userData != nullptr)
+    {
+        PrepareUserData(
+            lineNumber,
+            allocCreateInfo.flags,
+            userData,
+            allocCreateInfo.pUserData);
+    }
+
+    UpdateMemStats();
+    m_Stats.RegisterCreateAllocation(allocCreateInfo);
+
+    Allocation allocDesc = {};
+    allocDesc.allocationFlags = allocCreateInfo.flags;
+    VkResult res = vmaAllocateMemory(m_Allocator, &memReq, &allocCreateInfo, &allocDesc.allocation, nullptr);
+    AddAllocation(lineNumber, allocIndex, res, "vmaAllocateMemory", std::move(allocDesc));
+}
+
+void Player::ExecuteAllocateMemoryPages(size_t lineNumber, CompiledParamReader& params)
+{
+    VkMemoryRequirements memReq = {};
+    VmaAllocationCreateInfo allocCreateInfo = {};
+    memReq.size = params.GetUint64();
+    memReq.alignment = params.GetUint64();
+    memReq.memoryTypeBits = params.GetUint32();
+    allocCreateInfo.flags = params.GetUint32();
+    allocCreateInfo.usage = (VmaMemoryUsage)params.GetUint32();
+    allocCreateInfo.requiredFlags = params.GetUint32();
+    allocCreateInfo.preferredFlags = params.GetUint32();
+    allocCreateInfo.memoryTypeBits = params.GetUint32();
+    const uint32_t poolIndex = params.GetIndex();
+    const uint32_t* allocIndices = nullptr;
+    const uint32_t allocCount = params.GetIndexList(allocIndices);
+    const char* const userData = params.GetUserData();
+
+    if(allocCount > 0)
+    {
+        FindPool(lineNumber, poolIndex, allocCreateInfo.pool);
+
+        if(userData != nullptr)
         {
-            const size_t allocCount = origAllocPtrs.size();
-            size_t notNullCount = 0;
-            for(size_t i = 0; i < allocCount; ++i)
-            {
-                const uint64_t origAllocPtr = origAllocPtrs[i];
-                if(origAllocPtr != 0)
-                {
-                    const auto it = m_Allocations.find(origAllocPtr);
-                    if(it != m_Allocations.end())
-                    {
-                        Destroy(it->second);
-                        m_Allocations.erase(it);
-                        ++notNullCount;
-                    }
-                    else
-                    {
-                        if(IssueWarning())
-                        {
-                            printf("Line %zu: Allocation %llX not found.\n", lineNumber, origAllocPtr);
-                        }
-                    }
-                }
-            }
-            if(notNullCount)
-            {
-                UpdateMemStats();
-            }
+            PrepareUserData(
+                lineNumber,
+                allocCreateInfo.flags,
+                userData,
+                allocCreateInfo.pUserData);
         }
-        else
+
+        UpdateMemStats();
+        m_Stats.RegisterCreateAllocation(allocCreateInfo, allocCount);
+        m_Stats.RegisterAllocateMemoryPages(allocCount);
+
+        std::vector<VmaAllocation> allocations(allocCount);
+
+        VkResult res = vmaAllocateMemoryPages(m_Allocator, &memReq, &allocCreateInfo, allocCount, allocations.data(), nullptr);
+        for(uint32_t i = 0; i < allocCount; ++i)
         {
-            if(IssueWarning())
-            {
-                printf("Line %zu: Invalid parameters for vmaFreeMemoryPages.\n", lineNumber);
-            }
+            Allocation allocDesc = {};
+            allocDesc.allocationFlags = allocCreateInfo.flags;
+            allocDesc.allocation = allocations[i];
+            AddAllocation(lineNumber, allocIndices[i], res, "vmaAllocateMemoryPages", std::move(allocDesc));
         }
     }
 }
 
-void Player::ExecuteCreateLostAllocation(size_t lineNumber, const CsvSplit& csvSplit)
+void Player::ExecuteAllocateMemoryForBufferOrImage(size_t lineNumber, CompiledParamReader& params)
 {
-    m_Stats.RegisterFunctionCall(VMA_FUNCTION::CreateLostAllocation);
+    VkMemoryRequirements memReq = {};
+    VmaAllocationCreateInfo allocCreateInfo = {};
+    memReq.size = params.GetUint64();
+    memReq.alignment = params.GetUint64();
+    memReq.memoryTypeBits = params.GetUint32();
+    allocCreateInfo.flags = params.GetUint32();
+    const bool requiresDedicatedAllocation = params.GetBool();
+    const bool prefersDedicatedAllocation = params.GetBool();
+    allocCreateInfo.usage = (VmaMemoryUsage)params.GetUint32();
+    allocCreateInfo.requiredFlags = params.GetUint32();
+    allocCreateInfo.preferredFlags = params.GetUint32();
+    allocCreateInfo.memoryTypeBits = params.GetUint32();
+    const uint32_t poolIndex = params.GetIndex();
+    const uint32_t allocIndex = params.GetIndex();
+    const char* const userData = params.GetUserData();
+
+    FindPool(lineNumber, poolIndex, allocCreateInfo.pool);
 
-    if(ValidateFunctionParameterCount(lineNumber, csvSplit, 1, false))
+    if(userData != nullptr)
     {
-        uint64_t origPtr = 0;
+        PrepareUserData(
+            lineNumber,
+            allocCreateInfo.flags,
+            userData,
+            allocCreateInfo.pUserData);
+    }
 
-        if(StrRangeToPtr(csvSplit.GetRange(FIRST_PARAM_INDEX), origPtr))
-        {
-            Allocation allocDesc = {};
-            vmaCreateLostAllocation(m_Allocator, &allocDesc.allocation);
-            UpdateMemStats();
-            m_Stats.RegisterCreateLostAllocation();
+    UpdateMemStats();
+    m_Stats.RegisterCreateAllocation(allocCreateInfo);
 
-            AddAllocation(lineNumber, origPtr, VK_SUCCESS, "vmaCreateLostAllocation", std::move(allocDesc));
-        }
-        else
+    if(requiresDedicatedAllocation || prefersDedicatedAllocation)
+    {
+        allocCreateInfo.flags |= VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+    }
+
+    if(!m_AllocateForBufferImageWarningIssued.exchange(true))
+    {
+        if(IssueWarning())
         {
-            if(IssueWarning())
-            {
-                printf("Line %zu: Invalid parameters for vmaCreateLostAllocation.\n", lineNumber);
-            }
+            printf("Line %zu: vmaAllocateMemoryForBuffer or vmaAllocateMemoryForImage cannot be replayed accurately. Using vmaCreateAllocation instead.\n", lineNumber);
         }
     }
+
+    Allocation allocDesc = {};
+    allocDesc.allocationFlags = allocCreateInfo.flags;
+    VkResult res = vmaAllocateMemory(m_Allocator, &memReq, &allocCreateInfo, &allocDesc.allocation, nullptr);
+    AddAllocation(lineNumber, allocIndex, res, "vmaAllocateMemory (called as vmaAllocateMemoryForBuffer or vmaAllocateMemoryForImage)", std::move(allocDesc));
 }
 
-void Player::ExecuteAllocateMemory(size_t lineNumber, const CsvSplit& csvSplit)
+void Player::ExecuteMapMemory(size_t lineNumber, CompiledParamReader& params)
 {
-    m_Stats.RegisterFunctionCall(VMA_FUNCTION::AllocateMemory);
-
-    if(ValidateFunctionParameterCount(lineNumber, csvSplit, 11, true))
+    const uint32_t allocIndex = params.GetIndex();
+    if(allocIndex != CompiledRecording::NULL_INDEX)
     {
-        VkMemoryRequirements memReq = {};
-        VmaAllocationCreateInfo allocCreateInfo = {};
-        uint64_t origPool = 0;
-        uint64_t origPtr = 0;
-
-        if(StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX), memReq.size) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 1), memReq.alignment) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 2), memReq.memoryTypeBits) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 3), allocCreateInfo.flags) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 4), (uint32_t&)allocCreateInfo.usage) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 5), allocCreateInfo.requiredFlags) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 6), allocCreateInfo.preferredFlags) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 7), allocCreateInfo.memoryTypeBits) &&
-            StrRangeToPtr(csvSplit.GetRange(FIRST_PARAM_INDEX + 8), origPool) &&
-            StrRangeToPtr(csvSplit.GetRange(FIRST_PARAM_INDEX + 9), origPtr))
+        const Allocation* const alloc = m_Allocations.Find(allocIndex);
+        if(alloc != nullptr)
         {
-            FindPool(lineNumber, origPool, allocCreateInfo.pool);
-
-            if(csvSplit.GetCount() > FIRST_PARAM_INDEX + 10)
+            if(alloc->allocation)
             {
-                PrepareUserData(
-                    lineNumber,
-                    allocCreateInfo.flags,
-                    csvSplit.GetRange(FIRST_PARAM_INDEX + 10),
-                    csvSplit.GetLine(),
-                    allocCreateInfo.pUserData);
+                void* pData;
+                VkResult res = vmaMapMemory(m_Allocator, alloc->allocation, &pData);
+                if(res != VK_SUCCESS)
+                {
+                    printf("Line %zu: vmaMapMemory failed (%d)\n", lineNumber, res);
+                }
+            }
+            else
+            {
+                if(IssueWarning())
+                {
+                    printf("Line %zu: Cannot call vmaMapMemory - allocation is null.\n", lineNumber);
+                }
             }
-
-            UpdateMemStats();
-            m_Stats.RegisterCreateAllocation(allocCreateInfo);
-
-            Allocation allocDesc = {};
-            allocDesc.allocationFlags = allocCreateInfo.flags;
-            VkResult res = vmaAllocateMemory(m_Allocator, &memReq, &allocCreateInfo, &allocDesc.allocation, nullptr);
-            AddAllocation(lineNumber, origPtr, res, "vmaAllocateMemory", std::move(allocDesc));
         }
         else
         {
             if(IssueWarning())
             {
-                printf("Line %zu: Invalid parameters for vmaAllocateMemory.\n", lineNumber);
+                printf("Line %zu: Allocation %llX not found.\n", lineNumber, GetOrigPtr(m_Recording.allocations, allocIndex));
             }
         }
     }
 }
 
-void Player::ExecuteAllocateMemoryPages(size_t lineNumber, const CsvSplit& csvSplit)
+void Player::ExecuteUnmapMemory(size_t lineNumber, CompiledParamReader& params)
 {
-    m_Stats.RegisterFunctionCall(VMA_FUNCTION::AllocateMemoryPages);
-
-    if(ValidateFunctionParameterCount(lineNumber, csvSplit, 11, true))
+    const uint32_t allocIndex = params.GetIndex();
+    if(allocIndex != CompiledRecording::NULL_INDEX)
     {
-        VkMemoryRequirements memReq = {};
-        VmaAllocationCreateInfo allocCreateInfo = {};
-        uint64_t origPool = 0;
-        std::vector<uint64_t> origPtrs;
-
-        if(StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX), memReq.size) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 1), memReq.alignment) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 2), memReq.memoryTypeBits) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 3), allocCreateInfo.flags) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 4), (uint32_t&)allocCreateInfo.usage) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 5), allocCreateInfo.requiredFlags) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 6), allocCreateInfo.preferredFlags) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 7), allocCreateInfo.memoryTypeBits) &&
-            StrRangeToPtr(csvSplit.GetRange(FIRST_PARAM_INDEX + 8), origPool) &&
-            StrRangeToPtrList(csvSplit.GetRange(FIRST_PARAM_INDEX + 9), origPtrs))
+        const Allocation* const alloc = m_Allocations.Find(allocIndex);
+        if(alloc != nullptr)
         {
-            const size_t allocCount = origPtrs.size();
-            if(allocCount > 0)
+            if(alloc->allocation)
             {
-                FindPool(lineNumber, origPool, allocCreateInfo.pool);
-
-                if(csvSplit.GetCount() > FIRST_PARAM_INDEX + 10)
-                {
-                    PrepareUserData(
-                        lineNumber,
-                        allocCreateInfo.flags,
-                        csvSplit.GetRange(FIRST_PARAM_INDEX + 10),
-                        csvSplit.GetLine(),
-                        allocCreateInfo.pUserData);
-                }
-
-                UpdateMemStats();
-                m_Stats.RegisterCreateAllocation(allocCreateInfo, allocCount);
-                m_Stats.RegisterAllocateMemoryPages(allocCount);
-
-                std::vector<VmaAllocation> allocations(allocCount);
-
-                VkResult res = vmaAllocateMemoryPages(m_Allocator, &memReq, &allocCreateInfo, allocCount, allocations.data(), nullptr);
-                for(size_t i = 0; i < allocCount; ++i)
+                vmaUnmapMemory(m_Allocator, alloc->allocation);
+            }
+            else
+            {
+                if(IssueWarning())
                 {
-                    Allocation allocDesc = {};
-                    allocDesc.allocationFlags = allocCreateInfo.flags;
-                    allocDesc.allocation = allocations[i];
-                    AddAllocation(lineNumber, origPtrs[i], res, "vmaAllocateMemoryPages", std::move(allocDesc));
+                    printf("Line %zu: Cannot call vmaUnmapMemory - allocation is null.\n", lineNumber);
                 }
             }
         }
@@ -3226,129 +3560,63 @@ void Player::ExecuteAllocateMemoryPages(size_t lineNumber, const CsvSplit& csvSp
         {
             if(IssueWarning())
             {
-                printf("Line %zu: Invalid parameters for vmaAllocateMemoryPages.\n", lineNumber);
+                printf("Line %zu: Allocation %llX not found.\n", lineNumber, GetOrigPtr(m_Recording.allocations, allocIndex));
             }
         }
     }
 }
 
-void Player::ExecuteAllocateMemoryForBufferOrImage(size_t lineNumber, const CsvSplit& csvSplit, OBJECT_TYPE objType)
+void Player::ExecuteFlushAllocation(size_t lineNumber, CompiledParamReader& params)
 {
-    switch(objType)
-    {
-    case OBJECT_TYPE::BUFFER:
-        m_Stats.RegisterFunctionCall(VMA_FUNCTION::AllocateMemoryForBuffer);
-        break;
-    case OBJECT_TYPE::IMAGE:
-        m_Stats.RegisterFunctionCall(VMA_FUNCTION::AllocateMemoryForImage);
-        break;
-    default: assert(0);
-    }
-
-    if(ValidateFunctionParameterCount(lineNumber, csvSplit, 13, true))
+    const uint32_t allocIndex = params.GetIndex();
+    const uint64_t offset = params.GetUint64();
+    const uint64_t size = params.GetUint64();
+    if(allocIndex != CompiledRecording::NULL_INDEX)
     {
-        VkMemoryRequirements memReq = {};
-        VmaAllocationCreateInfo allocCreateInfo = {};
-        bool requiresDedicatedAllocation = false;
-        bool prefersDedicatedAllocation = false;
-        uint64_t origPool = 0;
-        uint64_t origPtr = 0;
-
-        if(StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX), memReq.size) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 1), memReq.alignment) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 2), memReq.memoryTypeBits) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 3), allocCreateInfo.flags) &&
-            StrRangeToBool(csvSplit.GetRange(FIRST_PARAM_INDEX + 4), requiresDedicatedAllocation) &&
-            StrRangeToBool(csvSplit.GetRange(FIRST_PARAM_INDEX + 5), prefersDedicatedAllocation) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 6), (uint32_t&)allocCreateInfo.usage) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 7), allocCreateInfo.requiredFlags) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 8), allocCreateInfo.preferredFlags) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 9), allocCreateInfo.memoryTypeBits) &&
-            StrRangeToPtr(csvSplit.GetRange(FIRST_PARAM_INDEX + 10), origPool) &&
-            StrRangeToPtr(csvSplit.GetRange(FIRST_PARAM_INDEX + 11), origPtr))
+        const Allocation* const alloc = m_Allocations.Find(allocIndex);
+        if(alloc != nullptr)
         {
-            FindPool(lineNumber, origPool, allocCreateInfo.pool);
-
-            if(csvSplit.GetCount() > FIRST_PARAM_INDEX + 12)
-            {
-                PrepareUserData(
-                    lineNumber,
-                    allocCreateInfo.flags,
-                    csvSplit.GetRange(FIRST_PARAM_INDEX + 12),
-                    csvSplit.GetLine(),
-                    allocCreateInfo.pUserData);
-            }
-
-            UpdateMemStats();
-            m_Stats.RegisterCreateAllocation(allocCreateInfo);
-
-            if(requiresDedicatedAllocation || prefersDedicatedAllocation)
+            if(alloc->allocation)
             {
-                allocCreateInfo.flags |= VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+                vmaFlushAllocation(m_Allocator, alloc->allocation, offset, size);
             }
-
-            if(!m_AllocateForBufferImageWarningIssued)
+            else
             {
                 if(IssueWarning())
                 {
-                    printf("Line %zu: vmaAllocateMemoryForBuffer or vmaAllocateMemoryForImage cannot be replayed accurately. Using vmaCreateAllocation instead.\n", lineNumber);
+                    printf("Line %zu: Cannot call vmaFlushAllocation - allocation is null.\n", lineNumber);
                 }
-                m_AllocateForBufferImageWarningIssued = true;
             }
-
-            Allocation allocDesc = {};
-            allocDesc.allocationFlags = allocCreateInfo.flags;
-            VkResult res = vmaAllocateMemory(m_Allocator, &memReq, &allocCreateInfo, &allocDesc.allocation, nullptr);
-            AddAllocation(lineNumber, origPtr, res, "vmaAllocateMemory (called as vmaAllocateMemoryForBuffer or vmaAllocateMemoryForImage)", std::move(allocDesc));
         }
         else
         {
             if(IssueWarning())
             {
-                printf("Line %zu: Invalid parameters for vmaAllocateMemoryForBuffer or vmaAllocateMemoryForImage.\n", lineNumber);
+                printf("Line %zu: Allocation %llX not found.\n", lineNumber, GetOrigPtr(m_Recording.allocations, allocIndex));
             }
         }
     }
 }
 
-void Player::ExecuteMapMemory(size_t lineNumber, const CsvSplit& csvSplit)
+void Player::ExecuteInvalidateAllocation(size_t lineNumber, CompiledParamReader& params)
 {
-    m_Stats.RegisterFunctionCall(VMA_FUNCTION::MapMemory);
-
-    if(ValidateFunctionParameterCount(lineNumber, csvSplit, 1, false))
+    const uint32_t allocIndex = params.GetIndex();
+    const uint64_t offset = params.GetUint64();
+    const uint64_t size = params.GetUint64();
+    if(allocIndex != CompiledRecording::NULL_INDEX)
     {
-        uint64_t origPtr = 0;
-
-        if(StrRangeToPtr(csvSplit.GetRange(FIRST_PARAM_INDEX), origPtr))
+        const Allocation* const alloc = m_Allocations.Find(allocIndex);
+        if(alloc != nullptr)
         {
-            if(origPtr != 0)
+            if(alloc->allocation)
             {
-                const auto it = m_Allocations.find(origPtr);
-                if(it != m_Allocations.end())
-                {
-                    if(it->second.allocation)
-                    {
-                        void* pData;
-                        VkResult res = vmaMapMemory(m_Allocator, it->second.allocation, &pData);
-                        if(res != VK_SUCCESS)
-                        {
-                            printf("Line %zu: vmaMapMemory failed (%d)\n", lineNumber, res);
-                        }
-                    }
-                    else
-                    {
-                        if(IssueWarning())
-                        {
-                            printf("Line %zu: Cannot call vmaMapMemory - allocation is null.\n", lineNumber);
-                        }
-                    }
-                }
-                else
+                vmaInvalidateAllocation(m_Allocator, alloc->allocation, offset, size);
+            }
+            else
+            {
+                if(IssueWarning())
                 {
-                    if(IssueWarning())
-                    {
-                        printf("Line %zu: Allocation %llX not found.\n", lineNumber, origPtr);
-                    }
+                    printf("Line %zu: Cannot call vmaInvalidateAllocation - allocation is null.\n", lineNumber);
                 }
             }
         }
@@ -3356,511 +3624,623 @@ void Player::ExecuteMapMemory(size_t lineNumber, const CsvSplit& csvSplit)
         {
             if(IssueWarning())
             {
-                printf("Line %zu: Invalid parameters for vmaMapMemory.\n", lineNumber);
+                printf("Line %zu: Allocation %llX not found.\n", lineNumber, GetOrigPtr(m_Recording.allocations, allocIndex));
             }
         }
     }
 }
 
-void Player::ExecuteUnmapMemory(size_t lineNumber, const CsvSplit& csvSplit)
+void Player::ExecuteTouchAllocation(size_t lineNumber, CompiledParamReader& params)
 {
-    m_Stats.RegisterFunctionCall(VMA_FUNCTION::UnmapMemory);
-
-    if(ValidateFunctionParameterCount(lineNumber, csvSplit, 1, false))
+    const uint32_t allocIndex = params.GetIndex();
+    const Allocation* const alloc = m_Allocations.Find(allocIndex);
+    if(alloc != nullptr)
     {
-        uint64_t origPtr = 0;
-
-        if(StrRangeToPtr(csvSplit.GetRange(FIRST_PARAM_INDEX), origPtr))
+        if(alloc->allocation)
         {
-            if(origPtr != 0)
-            {
-                const auto it = m_Allocations.find(origPtr);
-                if(it != m_Allocations.end())
-                {
-                    if(it->second.allocation)
-                    {
-                        vmaUnmapMemory(m_Allocator, it->second.allocation);
-                    }
-                    else
-                    {
-                        if(IssueWarning())
-                        {
-                            printf("Line %zu: Cannot call vmaUnmapMemory - allocation is null.\n", lineNumber);
-                        }
-                    }
-                }
-                else
-                {
-                    if(IssueWarning())
-                    {
-                        printf("Line %zu: Allocation %llX not found.\n", lineNumber, origPtr);
-                    }
-                }
-            }
+            vmaTouchAllocation(m_Allocator, alloc->allocation);
         }
         else
         {
             if(IssueWarning())
             {
-                printf("Line %zu: Invalid parameters for vmaMapMemory.\n", lineNumber);
+                printf("Line %zu: Cannot call vmaTouchAllocation - allocation is null.\n", lineNumber);
             }
         }
     }
+    else
+    {
+        if(IssueWarning())
+        {
+            printf("Line %zu: Allocation %llX not found.\n", lineNumber, GetOrigPtr(m_Recording.allocations, allocIndex));
+        }
+    }
 }
 
-void Player::ExecuteFlushAllocation(size_t lineNumber, const CsvSplit& csvSplit)
+void Player::ExecuteGetAllocationInfo(size_t lineNumber, CompiledParamReader& params)
 {
-    m_Stats.RegisterFunctionCall(VMA_FUNCTION::FlushAllocation);
-
-    if(ValidateFunctionParameterCount(lineNumber, csvSplit, 3, false))
+    const uint32_t allocIndex = params.GetIndex();
+    const Allocation* const alloc = m_Allocations.Find(allocIndex);
+    if(alloc != nullptr)
     {
-        uint64_t origPtr = 0;
-        uint64_t offset = 0;
-        uint64_t size = 0;
-
-        if(StrRangeToPtr(csvSplit.GetRange(FIRST_PARAM_INDEX), origPtr) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 1), offset) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 2), size))
+        if(alloc->allocation)
         {
-            if(origPtr != 0)
-            {
-                const auto it = m_Allocations.find(origPtr);
-                if(it != m_Allocations.end())
-                {
-                    if(it->second.allocation)
-                    {
-                        vmaFlushAllocation(m_Allocator, it->second.allocation, offset, size);
-                    }
-                    else
-                    {
-                        if(IssueWarning())
-                        {
-                            printf("Line %zu: Cannot call vmaFlushAllocation - allocation is null.\n", lineNumber);
-                        }
-                    }
-                }
-                else
-                {
-                    if(IssueWarning())
-                    {
-                        printf("Line %zu: Allocation %llX not found.\n", lineNumber, origPtr);
-                    }
-                }
-            }
+            VmaAllocationInfo allocInfo;
+            vmaGetAllocationInfo(m_Allocator, alloc->allocation, &allocInfo);
         }
         else
         {
             if(IssueWarning())
             {
-                printf("Line %zu: Invalid parameters for vmaFlushAllocation.\n", lineNumber);
+                printf("Line %zu: Cannot call vmaGetAllocationInfo - allocation is null.\n", lineNumber);
             }
         }
     }
+    else
+    {
+        if(IssueWarning())
+        {
+            printf("Line %zu: Allocation %llX not found.\n", lineNumber, GetOrigPtr(m_Recording.allocations, allocIndex));
+        }
+    }
 }
 
-void Player::ExecuteInvalidateAllocation(size_t lineNumber, const CsvSplit& csvSplit)
+void Player::ExecuteMakePoolAllocationsLost(size_t lineNumber, CompiledParamReader& params)
 {
-    m_Stats.RegisterFunctionCall(VMA_FUNCTION::InvalidateAllocation);
-
-    if(ValidateFunctionParameterCount(lineNumber, csvSplit, 3, false))
+    const uint32_t poolIndex = params.GetIndex();
+    if(poolIndex != CompiledRecording::NULL_INDEX)
     {
-        uint64_t origPtr = 0;
-        uint64_t offset = 0;
-        uint64_t size = 0;
-
-        if(StrRangeToPtr(csvSplit.GetRange(FIRST_PARAM_INDEX), origPtr) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 1), offset) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 2), size))
+        const Pool* const pool = m_Pools.Find(poolIndex);
+        if(pool != nullptr)
         {
-            if(origPtr != 0)
-            {
-                const auto it = m_Allocations.find(origPtr);
-                if(it != m_Allocations.end())
-                {
-                    if(it->second.allocation)
-                    {
-                        vmaInvalidateAllocation(m_Allocator, it->second.allocation, offset, size);
-                    }
-                    else
-                    {
-                        if(IssueWarning())
-                        {
-                            printf("Line %zu: Cannot call vmaInvalidateAllocation - allocation is null.\n", lineNumber);
-                        }
-                    }
-                }
-                else
-                {
-                    if(IssueWarning())
-                    {
-                        printf("Line %zu: Allocation %llX not found.\n", lineNumber, origPtr);
-                    }
-                }
-            }
+            vmaMakePoolAllocationsLost(m_Allocator, pool->pool, nullptr);
+            UpdateMemStats();
         }
         else
         {
             if(IssueWarning())
             {
-                printf("Line %zu: Invalid parameters for vmaInvalidateAllocation.\n", lineNumber);
+                printf("Line %zu: Pool %llX not found.\n", lineNumber, GetOrigPtr(m_Recording.pools, poolIndex));
             }
         }
     }
 }
 
-void Player::ExecuteTouchAllocation(size_t lineNumber, const CsvSplit& csvSplit)
+void Player::ExecuteFreePoolAllocations(size_t lineNumber, CompiledParamReader& params)
 {
-    m_Stats.RegisterFunctionCall(VMA_FUNCTION::TouchAllocation);
+    const uint32_t poolIndex = params.GetIndex();
+    const uint32_t lastFrameIndex = params.GetUint32();
+    const uint64_t origFreedCount = params.GetUint64();
+    const uint32_t* allocIndices = nullptr;
+    const uint32_t allocCount = params.GetIndexList(allocIndices);
 
-    if(ValidateFunctionParameterCount(lineNumber, csvSplit, 1, false))
+    if(poolIndex == CompiledRecording::NULL_INDEX)
+    {
+        return;
+    }
+    const Pool* const pool = m_Pools.Find(poolIndex);
+    if(pool == nullptr)
     {
-        uint64_t origPtr = 0;
-        if(StrRangeToPtr(csvSplit.GetRange(FIRST_PARAM_INDEX), origPtr))
+        if(IssueWarning())
         {
-            const auto it = m_Allocations.find(origPtr);
-            if(it != m_Allocations.end())
+            printf("Line %zu: Pool %llX not found.\n", lineNumber, GetOrigPtr(m_Recording.pools, poolIndex));
+        }
+        return;
+    }
+
+    /*
+    Allocation objects listed in the recording are destroyed by the call,
+    so they are just forgotten. Buffers and images bound to them are destroyed
+    here, as the call doesn't do that.
+    */
+    for(uint32_t i = 0; i < allocCount; ++i)
+    {
+        const uint32_t allocIndex = allocIndices[i];
+        if(allocIndex == CompiledRecording::NULL_INDEX)
+        {
+            continue;
+        }
+        const Allocation* const alloc = m_Allocations.Find(allocIndex);
+        if(alloc != nullptr)
+        {
+            if(alloc->buffer)
             {
-                if(it->second.allocation)
-                {
-                    vmaTouchAllocation(m_Allocator, it->second.allocation);
-                }
-                else
-                {
-                    if(IssueWarning())
-                    {
-                        printf("Line %zu: Cannot call vmaTouchAllocation - allocation is null.\n", lineNumber);
-                    }
-                }
+                m_pvkDestroyBuffer(m_Device, alloc->buffer, nullptr);
             }
-            else
+            else if(alloc->image)
             {
-                if(IssueWarning())
-                {
-                    printf("Line %zu: Allocation %llX not found.\n", lineNumber, origPtr);
-                }
+                m_pvkDestroyImage(m_Device, alloc->image, nullptr);
             }
+            m_Allocations.Remove(allocIndex);
         }
         else
         {
             if(IssueWarning())
             {
-                printf("Line %zu: Invalid parameters for vmaTouchAllocation.\n", lineNumber);
+                printf("Line %zu: Allocation %llX not found.\n", lineNumber, GetOrigPtr(m_Recording.allocations, allocIndex));
             }
         }
     }
-}
 
-void Player::ExecuteGetAllocationInfo(size_t lineNumber, const CsvSplit& csvSplit)
-{
-    m_Stats.RegisterFunctionCall(VMA_FUNCTION::GetAllocationInfo);
-
-    if(ValidateFunctionParameterCount(lineNumber, csvSplit, 1, false))
+    if(pool->pool != VK_NULL_HANDLE)
     {
-        uint64_t origPtr = 0;
-        if(StrRangeToPtr(csvSplit.GetRange(FIRST_PARAM_INDEX), origPtr))
+        size_t freedCount = 0;
+        const VkResult res = vmaFreePoolAllocations(m_Allocator, pool->pool, lastFrameIndex, &freedCount);
+        UpdateMemStats();
+        if(res != VK_SUCCESS)
         {
-            const auto it = m_Allocations.find(origPtr);
-            if(it != m_Allocations.end())
+            if(IssueWarning())
             {
-                if(it->second.allocation)
-                {
-                    VmaAllocationInfo allocInfo;
-                    vmaGetAllocationInfo(m_Allocator, it->second.allocation, &allocInfo);
-                }
-                else
-                {
-                    if(IssueWarning())
-                    {
-                        printf("Line %zu: Cannot call vmaGetAllocationInfo - allocation is null.\n", lineNumber);
-                    }
-                }
-            }
-            else
-            {
-                if(IssueWarning())
-                {
-                    printf("Line %zu: Allocation %llX not found.\n", lineNumber, origPtr);
-                }
+                printf("Line %zu: vmaFreePoolAllocations failed (%d).\n", lineNumber, res);
             }
         }
-        else
+        else if((uint64_t)freedCount != origFreedCount)
         {
             if(IssueWarning())
             {
-                printf("Line %zu: Invalid parameters for vmaGetAllocationInfo.\n", lineNumber);
+                printf("Line %zu: vmaFreePoolAllocations freed %zu allocations, originally %llu.\n",
+                    lineNumber, freedCount, (unsigned long long)origFreedCount);
             }
         }
     }
 }
 
-void Player::ExecuteMakePoolAllocationsLost(size_t lineNumber, const CsvSplit& csvSplit)
+void Player::ExecuteAllocateMemoryWithoutHandle(size_t lineNumber, CompiledParamReader& params)
 {
-    m_Stats.RegisterFunctionCall(VMA_FUNCTION::MakePoolAllocationsLost);
+    VkMemoryRequirements memReq = {};
+    VmaAllocationCreateInfo allocCreateInfo = {};
+    memReq.size = params.GetUint64();
+    memReq.alignment = params.GetUint64();
+    memReq.memoryTypeBits = params.GetUint32();
+    allocCreateInfo.flags = params.GetUint32();
+    allocCreateInfo.usage = (VmaMemoryUsage)params.GetUint32();
+    allocCreateInfo.requiredFlags = params.GetUint32();
+    allocCreateInfo.preferredFlags = params.GetUint32();
+    allocCreateInfo.memoryTypeBits = params.GetUint32();
+    const uint32_t poolIndex = params.GetIndex();
+    const bool origSucceeded = params.GetBool();
+
+    FindPool(lineNumber, poolIndex, allocCreateInfo.pool);
+    // Custom pool is required. If it's missing, warning was already issued.
+    if(allocCreateInfo.pool == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    m_Stats.RegisterCreateAllocation(allocCreateInfo);
 
-    if(ValidateFunctionParameterCount(lineNumber, csvSplit, 1, false))
+    VmaAllocationInfo allocInfo;
+    const VkResult res = vmaAllocateMemoryWithoutHandle(m_Allocator, &memReq, &allocCreateInfo, &allocInfo);
+    UpdateMemStats();
+
+    if(origSucceeded != (res == VK_SUCCESS))
     {
-        uint64_t origPtr = 0;
+        if(IssueWarning())
+        {
+            if(origSucceeded)
+                printf("Line %zu: vmaAllocateMemoryWithoutHandle failed (%d), while originally succeeded.\n", lineNumber, res);
+            else
+                printf("Line %zu: vmaAllocateMemoryWithoutHandle succeeded, originally failed.\n", lineNumber);
+        }
+    }
+}
 
-        if(StrRangeToPtr(csvSplit.GetRange(FIRST_PARAM_INDEX), origPtr))
+void Player::ExecuteResizeAllocation(size_t lineNumber, CompiledParamReader& params)
+{
+    const uint32_t allocIndex = params.GetIndex();
+    const uint64_t newSize = params.GetUint64();
+    if(allocIndex != CompiledRecording::NULL_INDEX)
+    {
+        const Allocation* const alloc = m_Allocations.Find(allocIndex);
+        if(alloc != nullptr)
         {
-            if(origPtr != 0)
-            {
-                const auto it = m_Pools.find(origPtr);
-                if(it != m_Pools.end())
-                {
-                    vmaMakePoolAllocationsLost(m_Allocator, it->second.pool, nullptr);
-                    UpdateMemStats();
-                }
-                else
-                {
-                    if(IssueWarning())
-                    {
-                        printf("Line %zu: Pool %llX not found.\n", lineNumber, origPtr);
-                    }
-                }
-            }
+            vmaResizeAllocation(m_Allocator, alloc->allocation, newSize);
+            UpdateMemStats();
         }
         else
         {
             if(IssueWarning())
             {
-                printf("Line %zu: Invalid parameters for vmaMakePoolAllocationsLost.\n", lineNumber);
+                printf("Line %zu: Allocation %llX not found.\n", lineNumber, GetOrigPtr(m_Recording.allocations, allocIndex));
             }
         }
     }
 }
 
-void Player::ExecuteResizeAllocation(size_t lineNumber, const CsvSplit& csvSplit)
+void Player::ExecuteDefragmentationBegin(size_t lineNumber, CompiledParamReader& params)
 {
-    m_Stats.RegisterFunctionCall(VMA_FUNCTION::ResizeAllocation);
+    VmaDefragmentationInfo2 defragInfo = {};
+    defragInfo.flags = params.GetUint32();
+    const uint32_t* allocIndices = nullptr;
+    const uint32_t allocIndexCount = params.GetIndexList(allocIndices);
+    const uint32_t* poolIndices = nullptr;
+    const uint32_t poolIndexCount = params.GetIndexList(poolIndices);
+    defragInfo.maxCpuBytesToMove = params.GetUint64();
+    defragInfo.maxCpuAllocationsToMove = params.GetUint32();
+    defragInfo.maxGpuBytesToMove = params.GetUint64();
+    defragInfo.maxGpuAllocationsToMove = params.GetUint32();
+    const uint64_t cmdBufOrigPtr = params.GetUint64();
+    const uint32_t defragCtxIndex = params.GetIndex();
+
+    std::vector<VmaAllocation> allocations;
+    allocations.reserve(allocIndexCount);
+    for(uint32_t i = 0; i < allocIndexCount; ++i)
+    {
+        const Allocation* const alloc = m_Allocations.Find(allocIndices[i]);
+        if(alloc != nullptr && alloc->allocation)
+        {
+            allocations.push_back(alloc->allocation);
+        }
+    }
+    if(!allocations.empty())
+    {
+        defragInfo.allocationCount = (uint32_t)allocations.size();
+        defragInfo.pAllocations = allocations.data();
+    }
+
+    std::vector<VmaPool> pools;
+    pools.reserve(poolIndexCount);
+    for(uint32_t i = 0; i < poolIndexCount; ++i)
+    {
+        const Pool* const pool = m_Pools.Find(poolIndices[i]);
+        if(pool != nullptr && pool->pool)
+        {
+            pools.push_back(pool->pool);
+        }
+    }
+    if(!pools.empty())
+    {
+        defragInfo.poolCount = (uint32_t)pools.size();
+        defragInfo.pPools = pools.data();
+    }
 
-    if(ValidateFunctionParameterCount(lineNumber, csvSplit, 2, false))
+    if(allocations.size() != allocIndexCount ||
+        pools.size() != poolIndexCount)
     {
-        uint64_t origPtr = 0;
-        uint64_t newSize = 0;
+        if(IssueWarning())
+        {
+            printf("Line %zu: Passing %zu allocations and %zu pools to vmaDefragmentationBegin, while originally %u allocations and %u pools were passed.\n",
+                lineNumber,
+                allocations.size(), pools.size(),
+                allocIndexCount, poolIndexCount);
+        }
+    }
 
-        if(StrRangeToPtr(csvSplit.GetRange(FIRST_PARAM_INDEX), origPtr) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 1), newSize))
+    if(cmdBufOrigPtr)
+    {
+        VkResult res = BeginCommandBuffer();
+        if(res == VK_SUCCESS)
         {
-            if(origPtr != 0)
-            {
-                const auto it = m_Allocations.find(origPtr);
-                if(it != m_Allocations.end())
-                {
-                    vmaResizeAllocation(m_Allocator, it->second.allocation, newSize);
-                    UpdateMemStats();
-                }
-                else
-                {
-                    if(IssueWarning())
-                    {
-                        printf("Line %zu: Allocation %llX not found.\n", lineNumber, origPtr);
-                    }
-                }
-            }
+            defragInfo.commandBuffer = m_CommandBuffer;
         }
         else
         {
-            if(IssueWarning())
-            {
-                printf("Line %zu: Invalid parameters for vmaResizeAllocation.\n", lineNumber);
-            }
+            printf("Line %zu: vkBeginCommandBuffer failed (%d)\n", lineNumber, res);
         }
     }
-}
 
-void Player::ExecuteDefragmentationBegin(size_t lineNumber, const CsvSplit& csvSplit)
-{
-    m_Stats.RegisterFunctionCall(VMA_FUNCTION::DefragmentationBegin);
+    m_Stats.RegisterDefragmentation(defragInfo);
+
+    VmaDefragmentationContext defragCtx = nullptr;
+    VkResult res = vmaDefragmentationBegin(m_Allocator, &defragInfo, nullptr, &defragCtx);
 
-    if(ValidateFunctionParameterCount(lineNumber, csvSplit, 9, false))
+    if(defragInfo.commandBuffer)
     {
-        VmaDefragmentationInfo2 defragInfo = {};
-        std::vector<uint64_t> allocationOrigPtrs;
-        std::vector<uint64_t> poolOrigPtrs;
-        uint64_t cmdBufOrigPtr = 0;
-        uint64_t defragCtxOrigPtr = 0;
+        EndCommandBuffer();
+        SubmitCommandBufferAndWait();
+    }
 
-        if(StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX), defragInfo.flags) &&
-            StrRangeToPtrList(csvSplit.GetRange(FIRST_PARAM_INDEX + 1), allocationOrigPtrs) &&
-            StrRangeToPtrList(csvSplit.GetRange(FIRST_PARAM_INDEX + 2), poolOrigPtrs) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 3), defragInfo.maxCpuBytesToMove) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 4), defragInfo.maxCpuAllocationsToMove) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 5), defragInfo.maxGpuBytesToMove) &&
-            StrRangeToUint(csvSplit.GetRange(FIRST_PARAM_INDEX + 6), defragInfo.maxGpuAllocationsToMove) &&
-            StrRangeToPtr(csvSplit.GetRange(FIRST_PARAM_INDEX + 7), cmdBufOrigPtr) &&
-            StrRangeToPtr(csvSplit.GetRange(FIRST_PARAM_INDEX + 8), defragCtxOrigPtr))
+    if(res >= VK_SUCCESS)
+    {
+        if(defragCtx)
         {
-            const size_t allocationOrigPtrCount = allocationOrigPtrs.size();
-            std::vector<VmaAllocation> allocations;
-            allocations.reserve(allocationOrigPtrCount);
-            for(size_t i = 0; i < allocationOrigPtrCount; ++i)
+            if(defragCtxIndex != CompiledRecording::NULL_INDEX)
             {
-                const auto it = m_Allocations.find(allocationOrigPtrs[i]);
-                if(it != m_Allocations.end() && it->second.allocation)
-                {
-                    allocations.push_back(it->second.allocation);
-                }
+                // We have defragmentation context, originally had defragmentation context: Store it.
+                m_DefragmentationContexts.Insert(defragCtxIndex, defragCtx);
             }
-            if(!allocations.empty())
+            else
             {
-                defragInfo.allocationCount = (uint32_t)allocations.size();
-                defragInfo.pAllocations = allocations.data();
+                // We have defragmentation context, originally it was null: End immediately.
+                vmaDefragmentationEnd(m_Allocator, defragCtx);
             }
-
-            const size_t poolOrigPtrCount = poolOrigPtrs.size();
-            std::vector<VmaPool> pools;
-            pools.reserve(poolOrigPtrCount);
-            for(size_t i = 0; i < poolOrigPtrCount; ++i)
+        }
+        else
+        {
+            if(defragCtxIndex != CompiledRecording::NULL_INDEX)
             {
-                const auto it = m_Pools.find(poolOrigPtrs[i]);
-                if(it != m_Pools.end() && it->second.pool)
-                {
-                    pools.push_back(it->second.pool);
-                }
+                // We have no defragmentation context, originally there was one: Store null.
+                m_DefragmentationContexts.Insert(defragCtxIndex, nullptr);
             }
-            if(!pools.empty())
+            else
             {
-                defragInfo.poolCount = (uint32_t)pools.size();
-                defragInfo.pPools = pools.data();
+                // We have no defragmentation context, originally there wasn't as well - nothing to do.
             }
-
-            if(allocations.size() != allocationOrigPtrCount ||
-                pools.size() != poolOrigPtrCount)
+        }
+    }
+    else
+    {
+        if(defragCtxIndex != CompiledRecording::NULL_INDEX)
+        {
+            // Currently failed, originally succeeded.
+            if(IssueWarning())
             {
-                if(IssueWarning())
-                {
-                    printf("Line %zu: Passing %zu allocations and %zu pools to vmaDefragmentationBegin, while originally %zu allocations and %zu pools were passed.\n",
-                        lineNumber,
-                        allocations.size(), pools.size(),
-                        allocationOrigPtrCount, poolOrigPtrCount);
-                }
+                printf("Line %zu: vmaDefragmentationBegin failed (%d), while originally succeeded.\n", lineNumber, res);
             }
+        }
+        else
+        {
+            // Currently failed, originally don't know.
+            if(IssueWarning())
+            {
+                printf("Line %zu: vmaDefragmentationBegin failed (%d).\n", lineNumber, res);
+            }
+        }
+    }
+}
 
-            if(cmdBufOrigPtr)
+void Player::ExecuteDefragmentationEnd(size_t lineNumber, CompiledParamReader& params)
+{
+    const uint32_t defragCtxIndex = params.GetIndex();
+    if(defragCtxIndex != CompiledRecording::NULL_INDEX)
+    {
+        VmaDefragmentationContext* const defragCtx = m_DefragmentationContexts.Find(defragCtxIndex);
+        if(defragCtx != nullptr)
+        {
+            vmaDefragmentationEnd(m_Allocator, *defragCtx);
+            m_DefragmentationContexts.Remove(defragCtxIndex);
+        }
+        else
+        {
+            if(IssueWarning())
             {
-                VkCommandBufferBeginInfo cmdBufBeginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
-                cmdBufBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-                VkResult res = vkBeginCommandBuffer(m_CommandBuffer, &cmdBufBeginInfo);
-                if(res == VK_SUCCESS)
-                {
-                    defragInfo.commandBuffer = m_CommandBuffer;
-                }
-                else
-                {
-                    printf("Line %zu: vkBeginCommandBuffer failed (%d)\n", lineNumber, res);
-                }
+                printf("Line %zu: Defragmentation context %llX not found.\n", lineNumber, GetOrigPtr(m_Recording.defragmentationContexts, defragCtxIndex));
             }
+        }
+    }
+}
 
-            m_Stats.RegisterDefragmentation(defragInfo);
+////////////////////////////////////////////////////////////////////////////////
+// class ThreadedPlayback
+
+/*
+Plays calls of every recorded thread on a separate worker thread, so VMA is
+called from as many threads as in the original application.
+
+Lines are queued to their workers until a line that must be played alone:
+defragmentation, change of frame index, or line with incorrect thread ID. Then
+all queued lines are played (Flush) and the line is executed on the calling
+thread. Within a batch, a line waits until lines of other threads that it
+depends on (see FindCompiledDependencies) are done, which reproduces the
+original order of calls using the same objects.
+*/
+class ThreadedPlayback
+{
+public:
+    ThreadedPlayback(Player& player, const CompiledRecording& recording, const CompiledDependencies& dependencies);
+    ~ThreadedPlayback();
 
-            VmaDefragmentationContext defragCtx = nullptr;
-            VkResult res = vmaDefragmentationBegin(m_Allocator, &defragInfo, nullptr, &defragCtx);
+    void PlayLine(size_t lineIndex);
+    // Plays all queued lines and waits until they are done.
+    void Flush();
 
-            if(defragInfo.commandBuffer)
-            {
-                vkEndCommandBuffer(m_CommandBuffer);
+    void PrintStats();
 
-                VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
-                submitInfo.commandBufferCount = 1;
-                submitInfo.pCommandBuffers = &m_CommandBuffer;
-                vkQueueSubmit(m_TransferQueue, 1, &submitInfo, VK_NULL_HANDLE);
-                vkQueueWaitIdle(m_TransferQueue);
-            }
+private:
+    struct Worker
+    {
+        std::thread thread;
+        // Lines to play in current batch, indices into CompiledRecording::lines.
+        std::vector<uint32_t> lineIndices;
+
+        size_t callCount = 0;
+        uint64_t callNanoseconds = 0;
+        uint64_t maxCallNanoseconds = 0;
+        uint64_t dependencyWaitNanoseconds = 0;
+        uint64_t statsLockWaitNanoseconds = 0;
+        // Copy of g_LockWaitStats of this thread after its last batch.
+        LockWaitStats lockWait = {};
+    };
 
-            if(res >= VK_SUCCESS)
-            {
-                if(defragCtx)
-                {
-                    if(defragCtxOrigPtr)
-                    {
-                        // We have defragmentation context, originally had defragmentation context: Store it.
-                        m_DefragmentationContexts[defragCtxOrigPtr] = defragCtx;
-                    }
-                    else
-                    {
-                        // We have defragmentation context, originally it was null: End immediately.
-                        vmaDefragmentationEnd(m_Allocator, defragCtx);
-                    }
-                }
-                else
-                {
-                    if(defragCtxOrigPtr)
-                    {
-                        // We have no defragmentation context, originally there was one: Store null.
-                        m_DefragmentationContexts[defragCtxOrigPtr] = nullptr;
-                    }
-                    else
-                    {
-                        // We have no defragmentation context, originally there wasn't as well - nothing to do.
-                    }
-                }
-            }
-            else
+    Player& m_Player;
+    const CompiledRecording& m_Recording;
+    const CompiledDependencies& m_Dependencies;
+    std::unique_ptr<std::atomic<bool>[]> m_LineDone;
+    // Indexed like CompiledRecording::threadIds.
+    std::vector<Worker> m_Workers;
+    size_t m_MainThreadCallCount = 0;
+    bool m_Queued = false;
+
+    std::mutex m_Mutex;
+    std::condition_variable m_StartCond;
+    std::condition_variable m_FinishCond;
+    uint64_t m_Batch = 0;
+    size_t m_RunningCount = 0;
+    bool m_Exit = false;
+
+    void WorkerThreadMain(size_t workerIndex);
+    void ExecuteLine(Worker& worker, uint32_t lineIndex);
+};
+
+ThreadedPlayback::ThreadedPlayback(Player& player, const CompiledRecording& recording, const CompiledDependencies& dependencies) :
+    m_Player(player),
+    m_Recording(recording),
+    m_Dependencies(dependencies),
+    m_LineDone(new std::atomic<bool>[recording.lines.size()]),
+    m_Workers(recording.threadIds.size())
+{
+    for(size_t i = 0; i < recording.lines.size(); ++i)
+    {
+        m_LineDone[i].store(false, std::memory_order_relaxed);
+    }
+    for(size_t i = 0; i < m_Workers.size(); ++i)
+    {
+        m_Workers[i].thread = std::thread([this, i]() { WorkerThreadMain(i); });
+    }
+}
+
+ThreadedPlayback::~ThreadedPlayback()
+{
+    Flush();
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Exit = true;
+    }
+    m_StartCond.notify_all();
+    for(auto& worker : m_Workers)
+    {
+        worker.thread.join();
+    }
+}
+
+void ThreadedPlayback::PlayLine(size_t lineIndex)
+{
+    const CompiledLine& line = m_Recording.lines[lineIndex];
+
+    const bool serial = line.threadIndex == CompiledRecording::NULL_INDEX ||
+        ((COMPILED_LINE_ERROR)line.error == COMPILED_LINE_ERROR::NONE &&
+            ((VMA_FUNCTION)line.function == VMA_FUNCTION::DefragmentationBegin ||
+            (VMA_FUNCTION)line.function == VMA_FUNCTION::DefragmentationEnd));
+    if(serial)
+    {
+        Flush();
+        m_Player.ExecuteLine(line);
+        m_LineDone[lineIndex].store(true, std::memory_order_release);
+        ++m_MainThreadCallCount;
+        return;
+    }
+
+    // Frame index is global for the allocator, so it changes between batches.
+    if((line.flags & COMPILED_LINE_FLAG_FRAME_INDEX_VALID) != 0 &&
+        line.frameIndex != m_Player.GetCurrentFrameIndex())
+    {
+        Flush();
+        m_Player.SetCurrentFrameIndex(line.frameIndex);
+    }
+
+    m_Workers[line.threadIndex].lineIndices.push_back((uint32_t)lineIndex);
+    m_Queued = true;
+}
+
+void ThreadedPlayback::Flush()
+{
+    if(!m_Queued)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_RunningCount = m_Workers.size();
+        ++m_Batch;
+    }
+    m_StartCond.notify_all();
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_FinishCond.wait(lock, [this]() { return m_RunningCount == 0; });
+    }
+
+    for(auto& worker : m_Workers)
+    {
+        worker.lineIndices.clear();
+    }
+    m_Queued = false;
+}
+
+void ThreadedPlayback::WorkerThreadMain(size_t workerIndex)
+{
+    Worker& worker = m_Workers[workerIndex];
+    uint64_t batch = 0;
+    for(;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_StartCond.wait(lock, [this, batch]() { return m_Exit || m_Batch != batch; });
+            if(m_Exit)
             {
-                if(defragCtxOrigPtr)
-                {
-                    // Currently failed, originally succeeded.
-                    if(IssueWarning())
-                    {
-                        printf("Line %zu: vmaDefragmentationBegin failed (%d), while originally succeeded.\n", lineNumber, res);
-                    }
-                }
-                else
-                {
-                    // Currently failed, originally don't know.
-                    if(IssueWarning())
-                    {
-                        printf("Line %zu: vmaDefragmentationBegin failed (%d).\n", lineNumber, res);
-                    }
-                }
+                return;
             }
+            batch = m_Batch;
+        }
+
+        for(uint32_t lineIndex : worker.lineIndices)
+        {
+            ExecuteLine(worker, lineIndex);
         }
-        else
+        worker.lockWait = g_LockWaitStats;
+
         {
-            if(IssueWarning())
-            {
-                printf("Line %zu: Invalid parameters for vmaDefragmentationBegin.\n", lineNumber);
-            }
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            --m_RunningCount;
         }
+        m_FinishCond.notify_one();
     }
 }
 
-void Player::ExecuteDefragmentationEnd(size_t lineNumber, const CsvSplit& csvSplit)
+void ThreadedPlayback::ExecuteLine(Worker& worker, uint32_t lineIndex)
 {
-    m_Stats.RegisterFunctionCall(VMA_FUNCTION::DefragmentationEnd);
-
-    if(ValidateFunctionParameterCount(lineNumber, csvSplit, 1, false))
+    const uint32_t dependencyBeg = m_Dependencies.offsets[lineIndex];
+    const uint32_t dependencyEnd = m_Dependencies.offsets[lineIndex + 1];
+    for(uint32_t i = dependencyBeg; i < dependencyEnd; ++i)
     {
-        uint64_t origPtr = 0;
-
-        if(StrRangeToPtr(csvSplit.GetRange(FIRST_PARAM_INDEX), origPtr))
+        const std::atomic<bool>& dependencyDone = m_LineDone[m_Dependencies.lineIndices[i]];
+        if(!dependencyDone.load(std::memory_order_acquire))
         {
-            if(origPtr != 0)
+            const time_point waitBeg = std::chrono::high_resolution_clock::now();
+            while(!dependencyDone.load(std::memory_order_acquire))
             {
-                const auto it = m_DefragmentationContexts.find(origPtr);
-                if(it != m_DefragmentationContexts.end())
-                {
-                    vmaDefragmentationEnd(m_Allocator, it->second);
-                    m_DefragmentationContexts.erase(it);
-                }
-                else
-                {
-                    if(IssueWarning())
-                    {
-                        printf("Line %zu: Defragmentation context %llX not found.\n", lineNumber, origPtr);
-                    }
-                }
+                std::this_thread::yield();
             }
+            worker.dependencyWaitNanoseconds += (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::high_resolution_clock::now() - waitBeg).count();
         }
-        else
+    }
+
+    const uint64_t statsLockWaitBeg = g_StatsLockWaitNanoseconds;
+    const time_point callBeg = std::chrono::high_resolution_clock::now();
+    m_Player.ExecuteLine(m_Recording.lines[lineIndex]);
+    const uint64_t statsLockWaitNanoseconds = g_StatsLockWaitNanoseconds - statsLockWaitBeg;
+    const uint64_t callNanoseconds = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::high_resolution_clock::now() - callBeg).count() - statsLockWaitNanoseconds;
+
+    m_LineDone[lineIndex].store(true, std::memory_order_release);
+
+    ++worker.callCount;
+    worker.callNanoseconds += callNanoseconds;
+    worker.maxCallNanoseconds = std::max(worker.maxCallNanoseconds, callNanoseconds);
+    worker.statsLockWaitNanoseconds += statsLockWaitNanoseconds;
+}
+
+void ThreadedPlayback::PrintStats()
+{
+    if(g_Verbosity == VERBOSITY::MINIMUM)
+    {
+        return;
+    }
+
+    printf("Multithreaded playback:\n");
+    for(size_t i = 0; i < m_Workers.size(); ++i)
+    {
+        const Worker& worker = m_Workers[i];
+        if(worker.callCount == 0)
         {
-            if(IssueWarning())
-            {
-                printf("Line %zu: Invalid parameters for vmaDefragmentationEnd.\n", lineNumber);
-            }
+            continue;
         }
+
+        std::string avgLatencyStr, maxLatencyStr, dependencyWaitStr, lockWaitStr, statsLockWaitStr;
+        SecondsToFriendlyStr((float)(worker.callNanoseconds / worker.callCount) * 1e-9f, avgLatencyStr);
+        SecondsToFriendlyStr((float)worker.maxCallNanoseconds * 1e-9f, maxLatencyStr);
+        SecondsToFriendlyStr((float)worker.dependencyWaitNanoseconds * 1e-9f, dependencyWaitStr);
+        SecondsToFriendlyStr((float)worker.lockWait.nanoseconds * 1e-9f, lockWaitStr);
+        SecondsToFriendlyStr((float)worker.statsLockWaitNanoseconds * 1e-9f, statsLockWaitStr);
+
+        printf("    Thread %u: %zu calls\n", m_Recording.threadIds[i], worker.callCount);
+        printf("        Call latency: average %s, max %s\n", avgLatencyStr.c_str(), maxLatencyStr.c_str());
+        printf("        Waiting for other threads: %s\n", dependencyWaitStr.c_str());
+        printf("        Waiting for VMA locks: %s (%llu times)\n", lockWaitStr.c_str(), (unsigned long long)worker.lockWait.count);
+        printf("        Waiting for statistics of playback, not included in latency: %s\n", statsLockWaitStr.c_str());
     }
+    printf("    Played alone on main thread: %zu calls\n", m_MainThreadCallCount);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -3870,7 +4250,7 @@ static void PrintCommandLineSyntax()
 {
     printf(
         "Command line syntax:\n"
-        "    VmaReplay [Options] <SrcFile.csv>\n"
+        "    VmaReplay [Options] <SrcFile.csv|SrcFile.bin|SrcFile.csv.gz|SrcFile.bin.gz>\n"
         "Available options:\n"
         "    -v <Number> - Verbosity level:\n"
         "        0 - Minimum verbosity. Prints only warnings and errors.\n"
@@ -3896,18 +4276,23 @@ static void PrintCommandLineSyntax()
         "        By default the layers are silently enabled if available.\n"
         "    --VK_KHR_dedicated_allocation <Value> - 0 to disable or 1 to enable this extension.\n"
         "        By default the extension is silently enabled if available.\n"
+        "    --NullDevice <Value> - 0 to use Vulkan or 1 to replay on built-in null device. Default is 0.\n"
+        "        Null device doesn't need a GPU. It simulates memory heaps and types recorded in the file in host memory.\n"
+        "    --NullDeviceLatency <AllocateMemory>[,<FreeMemory>[,<Other>]] - Time in microseconds spent by null device\n"
+        "        in vkAllocateMemory, vkFreeMemory and other functions respectively. Default is 0.\n"
+        "    --CompiledCache <Value> - 0 to disable or 1 to enable cache of compiled recording. Default is 0.\n"
+        "        Whole source file is compiled before playback and kept in memory, typically 50-80 B per call.\n"
+        "        When enabled, result is saved to <SrcFile>.compiled\n"
+        "        and loaded instead of compiling again, as long as the source file doesn't change.\n"
+        "    --Multithreaded <Value> - 0 to play all calls on one thread or 1 to play calls of each recorded thread\n"
+        "        on a separate thread. Default is 0. Calls using the same objects keep their original order.\n"
+        "        Latency of calls and time spent waiting for other threads and VMA locks are printed per thread.\n"
     );
 }
 
-static int ProcessFile(size_t iterationIndex, const char* data, size_t numBytes, duration& outDuration)
+// Parses header, format version and configuration that precede recorded calls.
+static int ParsePrologue(LineSplit& lineSplit, ConfigurationParser& outConfigParser)
 {
-    outDuration = duration::max();
-
-    const bool useLineRanges = !g_LineRanges.IsEmpty();
-    const bool useDumpStatsAfterLine = !g_DumpStatsAfterLine.empty();
-    const bool useDefragmentAfterLine = !g_DefragmentAfterLine.empty();
-
-    LineSplit lineSplit(data, numBytes);
     StrRange line;
 
     if(!lineSplit.GetNextLine(line) ||
@@ -3923,32 +4308,252 @@ static int ProcessFile(size_t iterationIndex, const char* data, size_t numBytes,
         return RESULT_ERROR_FORMAT;
     }
 
+    // Parse configuration
+    if(g_FileVersion >= MakeVersion(1, 3))
+    {
+        if(!outConfigParser.Parse(lineSplit))
+        {
+            return RESULT_ERROR_FORMAT;
+        }
+    }
+
+    return 0;
+}
+
+static void PrintCompileStats(const CompiledRecording& recording, time_point timeBeg)
+{
     if(g_Verbosity == VERBOSITY::MAXIMUM)
     {
-        printf("Format version: %u,%u\n",
-            GetVersionMajor(g_FileVersion),
-            GetVersionMinor(g_FileVersion));
+        std::string compileDurationStr;
+        SecondsToFriendlyStr(ToFloatSeconds(std::chrono::high_resolution_clock::now() - timeBeg), compileDurationStr);
+        printf("Compiled %zu calls to %zu B in %s\n", recording.lines.size(), recording.GetMemorySize(), compileDurationStr.c_str());
     }
+}
 
-    // Parse configuration
-    const bool configEnabled = g_FileVersion >= MakeVersion(1, 3);
-    ConfigurationParser configParser;
-    if(configEnabled)
+static int CompileFile(LineSplit& lineSplit, ConfigurationParser& outConfigParser, CompiledRecording& outRecording)
+{
+    // Prologue is kept as text, to be parsed again when the recording is loaded from cache.
+    lineSplit.SetLineCopy(&outRecording.prologue);
+    const int result = ParsePrologue(lineSplit, outConfigParser);
+    lineSplit.SetLineCopy(nullptr);
+    if(result != 0)
+    {
+        return result;
+    }
+
+    const time_point timeBeg = std::chrono::high_resolution_clock::now();
+    if(!CompileRecording(lineSplit, outRecording))
     {
-        if(!configParser.Parse(lineSplit))
+        return RESULT_ERROR_FORMAT;
+    }
+
+    PrintCompileStats(outRecording, timeBeg);
+
+    return 0;
+}
+
+static int CompileFileContents(const char* data, size_t numBytes, ConfigurationParser& outConfigParser, CompiledRecording& outRecording)
+{
+    if(IsBinaryRecording(data, numBytes))
+    {
+        if(g_Verbosity == VERBOSITY::MAXIMUM)
+        {
+            printf("Binary format\n");
+        }
+        const time_point timeBeg = std::chrono::high_resolution_clock::now();
+        if(!CompileBinaryRecording(data, numBytes, outRecording))
+        {
+            return RESULT_ERROR_FORMAT;
+        }
+        PrintCompileStats(outRecording, timeBeg);
+        LineSplit prologueSplit(outRecording.prologue.data(), outRecording.prologue.size());
+        return ParsePrologue(prologueSplit, outConfigParser);
+    }
+
+    LineSplit lineSplit(data, numBytes);
+    return CompileFile(lineSplit, outConfigParser, outRecording);
+}
+
+// Compiles data that is read sequentially, like decompressed data or a pipe.
+static int CompileSource(LineSource& source, ConfigurationParser& outConfigParser, CompiledRecording& outRecording)
+{
+    if(!source.Rewind())
+    {
+        return RESULT_ERROR_FORMAT;
+    }
+
+    // Look at the beginning of data to recognize its format.
+    char header[16];
+    const size_t headerSize = source.Read(header, sizeof(header));
+    if(source.HasFailed())
+    {
+        return RESULT_ERROR_FORMAT;
+    }
+    if(IsBinaryRecording(header, headerSize))
+    {
+        if(g_Verbosity == VERBOSITY::MAXIMUM)
+        {
+            printf("Binary format\n");
+        }
+        // Blocks of calls are compiled as they are read, so the whole file is never kept in memory.
+        const time_point timeBeg = std::chrono::high_resolution_clock::now();
+        if(!CompileBinaryRecording(source, header, headerSize, outRecording))
         {
             return RESULT_ERROR_FORMAT;
         }
+        PrintCompileStats(outRecording, timeBeg);
+        LineSplit prologueSplit(outRecording.prologue.data(), outRecording.prologue.size());
+        return ParsePrologue(prologueSplit, outConfigParser);
+    }
+
+    LineSplit lineSplit(source, header, headerSize);
+    const int result = CompileFile(lineSplit, outConfigParser, outRecording);
+    if(source.HasFailed())
+    {
+        return RESULT_ERROR_FORMAT;
+    }
+    return result;
+}
+
+static int CompileCompressedSource(LineSource& input, ConfigurationParser& outConfigParser, CompiledRecording& outRecording)
+{
+    if(g_Verbosity == VERBOSITY::MAXIMUM)
+    {
+        printf("Compressed file, decompressing\n");
+    }
+    GzipFileSource source(input);
+    return CompileSource(source, outConfigParser, outRecording);
+}
+
+static int CompileSourceFile(ConfigurationParser& outConfigParser, CompiledRecording& outRecording)
+{
+    // Regular file is mapped into memory and parsed in place.
+    MappedFile mappedFile;
+    if(mappedFile.Open(g_FilePath.c_str()))
+    {
+        const char* const data = mappedFile.GetData();
+        const size_t fileSize = mappedFile.GetSize();
+        if(fileSize == 0)
+        {
+            printf("ERROR: Source file is empty.\n");
+            return RESULT_ERROR_SOURCE_FILE;
+        }
+
+        // Begin stats.
+        if(g_Verbosity == VERBOSITY::MAXIMUM)
+        {
+            printf("File size: %zu B\n", fileSize);
+        }
+
+        if(IsGzipFile(data, fileSize))
+        {
+            MemorySource input(data, fileSize);
+            return CompileCompressedSource(input, outConfigParser, outRecording);
+        }
+        return CompileFileContents(data, fileSize, outConfigParser, outRecording);
+    }
+
+    // Other files, like pipes, are read in chunks.
+    FILE* file = fopen(g_FilePath.c_str(), "rb");
+    if(file == nullptr)
+    {
+        printf("ERROR: Couldn't open file (%i).\n", errno);
+        return RESULT_ERROR_SOURCE_FILE;
+    }
+
+    int result = 0;
+    StreamFileSource input(file);
+    char signature[2] = {};
+    const size_t signatureSize = input.Peek(signature, sizeof(signature));
+    if(signatureSize == 0)
+    {
+        printf("ERROR: Source file is empty.\n");
+        result = RESULT_ERROR_SOURCE_FILE;
+    }
+    else if(IsGzipFile(signature, signatureSize))
+    {
+        result = CompileCompressedSource(input, outConfigParser, outRecording);
+    }
+    else
+    {
+        result = CompileSource(input, outConfigParser, outRecording);
+    }
+
+    fclose(file);
+    return result;
+}
+
+// Loads compiled recording from the cache file if enabled and up to date.
+// Otherwise compiles the source file and updates the cache.
+static int LoadRecording(ConfigurationParser& outConfigParser, CompiledRecording& outRecording)
+{
+    uint64_t sourceSize = 0;
+    uint64_t sourceModificationTime = 0;
+    const bool cacheEnabled = g_CompiledCacheEnabled &&
+        GetRegularFileInfo(g_FilePath.c_str(), sourceSize, sourceModificationTime);
+    const std::string cachePath = g_FilePath + ".compiled";
+
+    if(cacheEnabled &&
+        LoadCompiledRecording(cachePath.c_str(), sourceSize, sourceModificationTime, outRecording))
+    {
+        if(g_Verbosity == VERBOSITY::MAXIMUM)
+        {
+            printf("Loaded compiled recording \"%s\"\n", cachePath.c_str());
+        }
+        LineSplit prologueSplit(outRecording.prologue.data(), outRecording.prologue.size());
+        return ParsePrologue(prologueSplit, outConfigParser);
+    }
+
+    const int result = CompileSourceFile(outConfigParser, outRecording);
+    if(result == 0 && cacheEnabled)
+    {
+        if(SaveCompiledRecording(cachePath.c_str(), sourceSize, sourceModificationTime, outRecording))
+        {
+            if(g_Verbosity == VERBOSITY::MAXIMUM)
+            {
+                printf("Saved compiled recording \"%s\"\n", cachePath.c_str());
+            }
+        }
+        else
+        {
+            printf("WARNING: Couldn't save compiled recording \"%s\".\n", cachePath.c_str());
+        }
     }
+    return result;
+}
+
+static int PlayRecording(
+    size_t iterationIndex,
+    const ConfigurationParser& origConfigParser,
+    const CompiledRecording& recording,
+    const CompiledDependencies& dependencies,
+    duration& outDuration)
+{
+    outDuration = duration::max();
+
+    const bool useLineRanges = !g_LineRanges.IsEmpty();
+    const bool useDumpStatsAfterLine = !g_DumpStatsAfterLine.empty();
+    const bool useDefragmentAfterLine = !g_DefragmentAfterLine.empty();
 
-    Player player;
-    int result = player.Init();
+    // Copy, so mismatched configuration is reported in every iteration.
+    ConfigurationParser configParser = origConfigParser;
+    const bool configEnabled = g_FileVersion >= MakeVersion(1, 3);
+
+    Player player(recording);
+    int result = player.Init(configParser);
 
     if(configEnabled)
     {
         player.ApplyConfig(configParser);
     }
 
+    // Destroyed before player, as its threads use it.
+    std::unique_ptr<ThreadedPlayback> threadedPlayback;
+    if(result == 0 && g_MultithreadedEnabled)
+    {
+        threadedPlayback.reset(new ThreadedPlayback(player, recording, dependencies));
+    }
+
     size_t executedLineCount = 0;
     if(result == 0)
     {
@@ -3966,9 +4571,10 @@ static int ProcessFile(size_t iterationIndex, const char* data, size_t numBytes,
 
         const time_point timeBeg = std::chrono::high_resolution_clock::now();
 
-        while(lineSplit.GetNextLine(line))
+        for(size_t lineIndex = 0; lineIndex < recording.lines.size(); ++lineIndex)
         {
-            const size_t currLineNumber = lineSplit.GetNextLineIndex();
+            const CompiledLine& compiledLine = recording.lines[lineIndex];
+            const size_t currLineNumber = (size_t)compiledLine.lineNumber;
 
             bool execute = true;
             if(useLineRanges)
@@ -3978,7 +4584,14 @@ static int ProcessFile(size_t iterationIndex, const char* data, size_t numBytes,
 
             if(execute)
             {
-                player.ExecuteLine(currLineNumber, line);
+                if(threadedPlayback)
+                {
+                    threadedPlayback->PlayLine(lineIndex);
+                }
+                else
+                {
+                    player.ExecuteLine(compiledLine);
+                }
                 ++executedLineCount;
             }
 
@@ -3986,6 +4599,11 @@ static int ProcessFile(size_t iterationIndex, const char* data, size_t numBytes,
                 g_DumpStatsAfterLineNextIndex < g_DumpStatsAfterLine.size() &&
                 currLineNumber >= g_DumpStatsAfterLine[g_DumpStatsAfterLineNextIndex].line)
             {
+                if(threadedPlayback)
+                {
+                    threadedPlayback->Flush();
+                }
+
                 const size_t requestedLine = g_DumpStatsAfterLine[g_DumpStatsAfterLineNextIndex].line;
                 const bool detailed = g_DumpStatsAfterLine[g_DumpStatsAfterLineNextIndex].detailed;
                 
@@ -4006,6 +4624,11 @@ static int ProcessFile(size_t iterationIndex, const char* data, size_t numBytes,
                 g_DefragmentAfterLineNextIndex < g_DefragmentAfterLine.size() &&
                 currLineNumber >= g_DefragmentAfterLine[g_DefragmentAfterLineNextIndex])
             {
+                if(threadedPlayback)
+                {
+                    threadedPlayback->Flush();
+                }
+
                 const size_t requestedLine = g_DefragmentAfterLine[g_DefragmentAfterLineNextIndex];
                 if(g_Verbosity >= VERBOSITY::DEFAULT)
                 {
@@ -4022,6 +4645,11 @@ static int ProcessFile(size_t iterationIndex, const char* data, size_t numBytes,
             }
         }
 
+        if(threadedPlayback)
+        {
+            threadedPlayback->Flush();
+        }
+
         const duration playDuration = std::chrono::high_resolution_clock::now() - timeBeg;
         outDuration = playDuration;
 
@@ -4036,73 +4664,95 @@ static int ProcessFile(size_t iterationIndex, const char* data, size_t numBytes,
         }
         if(g_Verbosity == VERBOSITY::MAXIMUM)
         {
-            printf("File lines: %zu\n", lineSplit.GetNextLineIndex());
+            printf("File lines: %zu\n", recording.lineCount);
             printf("Executed %zu file lines\n", executedLineCount);
         }
 
         player.PrintStats();
+        if(threadedPlayback)
+        {
+            threadedPlayback->PrintStats();
+        }
     }
 
     return result;
 }
 
+static void PrintAveragePlaybackTime(duration durationSum)
+{
+    if(g_IterationCount > 1)
+    {
+        std::string playDurationStr;
+        SecondsToFriendlyStr(ToFloatSeconds(durationSum / g_IterationCount), playDurationStr);
+        printf("Average playback time from %zu iterations: %s\n", g_IterationCount, playDurationStr.c_str());
+    }
+}
+
 static int ProcessFile()
 {
     if(g_Verbosity > VERBOSITY::MINIMUM)
     {
         printf("Loading file \"%s\"...\n", g_FilePath.c_str());
     }
-    int result = 0;
 
-    FILE* file = nullptr;
-    const errno_t err = fopen_s(&file, g_FilePath.c_str(), "rb");
-    if(err == 0)
+    // Whole file is compiled once, so every iteration plays it from memory.
+    ConfigurationParser configParser;
+    CompiledRecording recording;
+    const int result = LoadRecording(configParser, recording);
+    if(result != 0)
     {
-        _fseeki64(file, 0, SEEK_END);
-        const size_t fileSize = (size_t)_ftelli64(file);
-        _fseeki64(file, 0, SEEK_SET);
+        return result;
+    }
 
-        if(fileSize > 0)
-        {
-            std::vector<char> fileContents(fileSize);
-            fread(fileContents.data(), 1, fileSize, file);
+    if(g_Verbosity == VERBOSITY::MAXIMUM)
+    {
+        printf("Format version: %u,%u\n",
+            GetVersionMajor(g_FileVersion),
+            GetVersionMinor(g_FileVersion));
+    }
 
-            // Begin stats.
-            if(g_Verbosity == VERBOSITY::MAXIMUM)
-            {
-                printf("File size: %zu B\n", fileSize);
-            }
+    CompiledDependencies dependencies;
+    if(g_MultithreadedEnabled)
+    {
+        FindCompiledDependencies(recording, g_LineRanges, dependencies);
+    }
 
-            duration durationSum = duration::zero();
-            for(size_t i = 0; i < g_IterationCount; ++i)
-            {
-                duration currDuration;
-                ProcessFile(i, fileContents.data(), fileContents.size(), currDuration);
-                durationSum += currDuration;
-            }
+    duration durationSum = duration::zero();
+    for(size_t i = 0; i < g_IterationCount; ++i)
+    {
+        duration currDuration;
+        PlayRecording(i, configParser, recording, dependencies, currDuration);
+        durationSum += currDuration;
+    }
+    PrintAveragePlaybackTime(durationSum);
+    return 0;
+}
 
-            if(g_IterationCount > 1)
-            {
-                std::string playDurationStr;
-                SecondsToFriendlyStr(ToFloatSeconds(durationSum / g_IterationCount), playDurationStr);
-                printf("Average playback time from %zu iterations: %s\n", g_IterationCount, playDurationStr.c_str());
-            }
-        }
-        else
-        {
-            printf("ERROR: Source file is empty.\n");
-            result = RESULT_ERROR_SOURCE_FILE;
-        }
+// Parses "<AllocateMemory>[,<FreeMemory>[,<Other>]]" in microseconds.
+static bool ParseNullDeviceLatency(const StrRange& str)
+{
+    uint64_t* const latencies[] = {
+        &g_NullDeviceAllocateMemoryLatency,
+        &g_NullDeviceFreeMemoryLatency,
+        &g_NullDeviceOtherCallLatency,
+    };
 
-        fclose(file);
+    CsvSplit csvSplit;
+    csvSplit.Set(str);
+    if(csvSplit.GetCount() == 0 || csvSplit.GetCount() > _countof(latencies))
+    {
+        return false;
     }
-    else
+    for(size_t i = 0; i < csvSplit.GetCount(); ++i)
     {
-        printf("ERROR: Couldn't open file (%i).\n", err);
-        result = RESULT_ERROR_SOURCE_FILE;
+        float microseconds;
+        if(!StrRangeToFloat(csvSplit.GetRange(i), microseconds) || microseconds < 0.f)
+        {
+            return false;
+        }
+        *latencies[i] = (uint64_t)(microseconds * 1000.f + 0.5f);
     }
-
-    return result;
+    return true;
 }
 
 static int main2(int argc, char** argv)
@@ -4121,6 +4771,10 @@ static int main2(int argc, char** argv)
     cmdLineParser.RegisterOpt(CMD_LINE_OPT_DEFRAGMENT_AFTER_LINE, "DefragmentAfterLine", true);
     cmdLineParser.RegisterOpt(CMD_LINE_OPT_DEFRAGMENTATION_FLAGS, "DefragmentationFlags", true);
     cmdLineParser.RegisterOpt(CMD_LINE_OPT_DUMP_DETAILED_STATS_AFTER_LINE, "DumpDetailedStatsAfterLine", true);
+    cmdLineParser.RegisterOpt(CMD_LINE_OPT_NULL_DEVICE, "NullDevice", true);
+    cmdLineParser.RegisterOpt(CMD_LINE_OPT_NULL_DEVICE_LATENCY, "NullDeviceLatency", true);
+    cmdLineParser.RegisterOpt(CMD_LINE_OPT_COMPILED_CACHE, "CompiledCache", true);
+    cmdLineParser.RegisterOpt(CMD_LINE_OPT_MULTITHREADED, "Multithreaded", true);
 
     CmdLineParser::RESULT res;
     while((res = cmdLineParser.ReadNext()) != CmdLineParser::RESULT_END)
@@ -4252,6 +4906,34 @@ static int main2(int argc, char** argv)
                     }
                 }
                 break;
+            case CMD_LINE_OPT_NULL_DEVICE:
+                if(!StrRangeToBool(StrRange(cmdLineParser.GetParameter()), g_NullDeviceEnabled))
+                {
+                    PrintCommandLineSyntax();
+                    return RESULT_ERROR_COMMAND_LINE;
+                }
+                break;
+            case CMD_LINE_OPT_NULL_DEVICE_LATENCY:
+                if(!ParseNullDeviceLatency(StrRange(cmdLineParser.GetParameter())))
+                {
+                    PrintCommandLineSyntax();
+                    return RESULT_ERROR_COMMAND_LINE;
+                }
+                break;
+            case CMD_LINE_OPT_COMPILED_CACHE:
+                if(!StrRangeToBool(StrRange(cmdLineParser.GetParameter()), g_CompiledCacheEnabled))
+                {
+                    PrintCommandLineSyntax();
+                    return RESULT_ERROR_COMMAND_LINE;
+                }
+                break;
+            case CMD_LINE_OPT_MULTITHREADED:
+                if(!StrRangeToBool(StrRange(cmdLineParser.GetParameter()), g_MultithreadedEnabled))
+                {
+                    PrintCommandLineSyntax();
+                    return RESULT_ERROR_COMMAND_LINE;
+                }
+                break;
             default:
                 assert(0);
             }
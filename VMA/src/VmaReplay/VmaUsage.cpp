@@ -22,3 +22,5 @@
 
 #define VMA_IMPLEMENTATION
 #include "VmaUsage.h"
+
+thread_local LockWaitStats g_LockWaitStats = {};
@@ -22,11 +22,16 @@
 
 #pragma once
 
+#ifdef _WIN32
+
 #define NOMINMAX
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
 
 #define VK_USE_PLATFORM_WIN32_KHR
+
+#endif // #ifdef _WIN32
+
 #include <vulkan/vulkan.h>
 
 //#define VMA_USE_STL_CONTAINERS 1
@@ -39,12 +44,98 @@
 //#define VMA_DEBUG_DETECT_CORRUPTION 1
 //#define VMA_DEBUG_INITIALIZE_ALLOCATIONS 1
 
-#pragma warning(push, 4)
-#pragma warning(disable: 4127) // conditional expression is constant
-#pragma warning(disable: 4100) // unreferenced formal parameter
-#pragma warning(disable: 4189) // local variable is initialized but not referenced
-#pragma warning(disable: 4324) // structure was padded due to alignment specifier
+/*
+Mutexes used by VMA are replaced with ones that measure how long each thread
+waits for a mutex locked by another thread, for statistics of multithreaded
+playback. Waiting is measured only when the mutex couldn't be locked immediately.
+*/
+
+#include <cstdint>
+#include <chrono>
+#include <mutex>
+
+struct LockWaitStats
+{
+    uint64_t count;
+    uint64_t nanoseconds;
+};
+
+// Waits of the current thread since it started.
+extern thread_local LockWaitStats g_LockWaitStats;
+
+template<typename LockFunc>
+inline void LockAndMeasureWait(LockFunc lockFunc)
+{
+    const std::chrono::steady_clock::time_point waitBeg = std::chrono::steady_clock::now();
+    lockFunc();
+    ++g_LockWaitStats.count;
+    g_LockWaitStats.nanoseconds += (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - waitBeg).count();
+}
+
+class MeasuredMutex
+{
+public:
+    void Lock() { if(!m_Mutex.try_lock()) { LockAndMeasureWait([this]() { m_Mutex.lock(); }); } }
+    bool TryLock() { return m_Mutex.try_lock(); }
+    void Unlock() { m_Mutex.unlock(); }
+private:
+    std::mutex m_Mutex;
+};
+#define VMA_MUTEX MeasuredMutex
+
+// Same choice of implementation as default VMA_RW_MUTEX.
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+    #include <shared_mutex>
+    class MeasuredRWMutex
+    {
+    public:
+        void LockRead() { if(!m_Mutex.try_lock_shared()) { LockAndMeasureWait([this]() { m_Mutex.lock_shared(); }); } }
+        void UnlockRead() { m_Mutex.unlock_shared(); }
+        void LockWrite() { if(!m_Mutex.try_lock()) { LockAndMeasureWait([this]() { m_Mutex.lock(); }); } }
+        bool TryLockWrite() { return m_Mutex.try_lock(); }
+        void UnlockWrite() { m_Mutex.unlock(); }
+    private:
+        std::shared_mutex m_Mutex;
+    };
+#elif defined(_WIN32) && defined(WINVER) && WINVER >= 0x0601
+    class MeasuredRWMutex
+    {
+    public:
+        MeasuredRWMutex() { InitializeSRWLock(&m_Lock); }
+        void LockRead() { if(!TryAcquireSRWLockShared(&m_Lock)) { LockAndMeasureWait([this]() { AcquireSRWLockShared(&m_Lock); }); } }
+        void UnlockRead() { ReleaseSRWLockShared(&m_Lock); }
+        void LockWrite() { if(!TryLockWrite()) { LockAndMeasureWait([this]() { AcquireSRWLockExclusive(&m_Lock); }); } }
+        bool TryLockWrite() { return TryAcquireSRWLockExclusive(&m_Lock) != FALSE; }
+        void UnlockWrite() { ReleaseSRWLockExclusive(&m_Lock); }
+    private:
+        SRWLOCK m_Lock;
+    };
+#else
+    class MeasuredRWMutex
+    {
+    public:
+        void LockRead() { m_Mutex.Lock(); }
+        void UnlockRead() { m_Mutex.Unlock(); }
+        void LockWrite() { m_Mutex.Lock(); }
+        bool TryLockWrite() { return m_Mutex.TryLock(); }
+        void UnlockWrite() { m_Mutex.Unlock(); }
+    private:
+        MeasuredMutex m_Mutex;
+    };
+#endif
+#define VMA_RW_MUTEX MeasuredRWMutex
+
+#ifdef _MSC_VER
+    #pragma warning(push, 4)
+    #pragma warning(disable: 4127) // conditional expression is constant
+    #pragma warning(disable: 4100) // unreferenced formal parameter
+    #pragma warning(disable: 4189) // local variable is initialized but not referenced
+    #pragma warning(disable: 4324) // structure was padded due to alignment specifier
+#endif
 
 #include "../vk_mem_alloc.h"
 
-#pragma warning(pop)
+#ifdef _MSC_VER
+    #pragma warning(pop)
+#endif
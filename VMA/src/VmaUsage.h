@@ -46,6 +46,8 @@ include all public interface declarations. Example:
 //#define VMA_DEBUG_DETECT_CORRUPTION 1
 //#define VMA_DEBUG_INITIALIZE_ALLOCATIONS 1
 //#define VMA_RECORDING_ENABLED 1
+//#define VMA_COUNTERS_ENABLED 0
+//#define VMA_COUNTERS_LOCK_CONTENTION 1
 //#define VMA_DEBUG_MIN_BUFFER_IMAGE_GRANULARITY 256
 //#define VMA_USE_STL_SHARED_MUTEX 0
 //#define VMA_DEBUG_GLOBAL_MUTEX 1
@@ -1768,6 +1768,16 @@ static LRESULT WINAPI WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
                 printf("ERROR: %s\n", ex.what());
             }
             break;
+        case 'N':
+            try
+            {
+                BenchmarkNullDevice();
+            }
+            catch(const std::exception& ex)
+            {
+                printf("ERROR: %s\n", ex.what());
+            }
+            break;
         case 'S':
             try
             {
@@ -1795,8 +1805,23 @@ static LRESULT WINAPI WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
     return DefWindowProc(hWnd, msg, wParam, lParam);
 }
 
-int main()
+int main(int argc, char** argv)
 {
+    // Run benchmarks on null device without creating window and initializing Vulkan.
+    if(argc == 2 && strcmp(argv[1], "--NullDevice") == 0)
+    {
+        try
+        {
+            BenchmarkNullDevice();
+        }
+        catch(const std::exception& ex)
+        {
+            printf("ERROR: %s\n", ex.what());
+            return -1;
+        }
+        return 0;
+    }
+
     g_hAppInstance = (HINSTANCE)GetModuleHandle(NULL);
 
     WNDCLASSEX wndClassDesc = { sizeof(WNDCLASSEX) };
@@ -61,10 +61,13 @@ Documentation of all members: vk_mem_alloc.h
       - [Stack](@ref linear_algorithm_stack)
       - [Double stack](@ref linear_algorithm_double_stack)
       - [Ring buffer](@ref linear_algorithm_ring_buffer)
+      - [Freeing allocations per frame](@ref linear_algorithm_free_per_frame)
     - [Buddy allocation algorithm](@ref buddy_algorithm)
   - \subpage defragmentation
   	- [Defragmenting CPU memory](@ref defragmentation_cpu)
   	- [Defragmenting GPU memory](@ref defragmentation_gpu)
+  	- [Estimating defragmentation](@ref defragmentation_estimate)
+  	- [Automatic defragmentation](@ref defragmentation_automatic)
   	- [Additional notes](@ref defragmentation_additional_notes)
   	- [Writing custom allocation algorithm](@ref defragmentation_custom_algorithm)
   - \subpage lost_allocations
@@ -696,8 +699,44 @@ succeeds.
 
 ![Ring buffer with lost allocations](../gfx/Linear_allocator_6_ring_buffer_lost.png)
 
-Ring buffer is available only in pools with one memory block -
-VmaPoolCreateInfo::maxBlockCount must be 1. Otherwise behavior is undefined.
+Ring buffer can also span multiple memory blocks, when VmaPoolCreateInfo::maxBlockCount
+is greater than 1. Blocks are then used in a chain: the last one is the write head.
+When there is not enough space for a new allocation in it, the oldest block is
+reused if all its allocations have been freed, otherwise a new block is created.
+If maximum number of blocks has been reached, allocations from the beginning of
+the oldest block can become lost, as described above, and that block becomes the
+new write head. This way you can start with a small pool, e.g. for per-frame
+uploads, and let it grow to the size actually needed instead of reserving memory
+for the worst case upfront. As with single block, allocations should be freed in
+the order of their creation.
+
+\subsection linear_algorithm_free_per_frame Freeing allocations per frame
+
+Instead of calling vmaFreeMemory() for each of possibly thousands of allocations
+made during a frame, you can free them all in one call to vmaFreePoolAllocations().
+Each allocation in a pool with linear algorithm remembers the frame index current at
+the time of its creation, as set with vmaSetCurrentFrameIndex(). The function frees
+allocations made in given frame or earlier, starting from the oldest one, and
+destroys their #VmaAllocation objects. Pass `UINT32_MAX` as frame index to free
+all allocations, resetting the pool.
+
+\code
+// When frame (frameIndex - 2) is known to have finished on the GPU:
+vmaFreePoolAllocations(allocator, pool, frameIndex - 2, nullptr);
+\endcode
+
+If you don't need #VmaAllocation objects at all, e.g. for transient buffers that are
+never freed individually, you can allocate using vmaAllocateMemoryWithoutHandle().
+It returns only VmaAllocationInfo describing the allocated memory. Such allocations
+can be freed only by vmaFreePoolAllocations(), and all of them must be freed this
+way before the pool is destroyed. A pool that contains only such allocations is
+reset with `UINT32_MAX` in constant time, while other calls take time proportional
+to the number of freed allocations.
+
+Frame indices are expected to grow monotonically. Freeing stops at the first
+allocation made in a later frame, so allocations created after it are not freed.
+Each memory block, as well as each stack of a [double stack](@ref linear_algorithm_double_stack),
+is processed separately.
 
 \section buddy_algorithm Buddy allocation algorithm
 
@@ -727,14 +766,17 @@ Several limitations apply to pools that use buddy algorithm:
 
 - It is recommended to use VmaPoolCreateInfo::blockSize that is a power of two.
   Otherwise, only largest power of two smaller than the size is used for
-  allocations. The remaining space always stays unused.
+  allocations. The remaining space always stays unused, unless you also add flag
+  #VMA_POOL_CREATE_BUDDY_MULTIPLE_ROOTS_BIT. Then the block is covered by several
+  trees, one for each bit set in its size, e.g. a block of 384 MB consists of trees
+  of 256 MB and 128 MB. An allocation must fit in a single tree, so it can't be bigger
+  than the largest power of two not greater than the block size. Only the remainder
+  smaller than the minimum node size stays unused.
 - [Margins](@ref debugging_memory_usage_margins) and
   [corruption detection](@ref debugging_memory_usage_corruption_detection)
   don't work in such pools.
 - [Lost allocations](@ref lost_allocations) don't work in such pools. You can
   use them, but they never become lost. Support may be added in the future.
-- [Defragmentation](@ref defragmentation) doesn't work with allocations made from
-  such pool.
 
 \page defragmentation Defragmentation
 
@@ -908,6 +950,65 @@ You may try not to block your entire program to wait until defragmentation finis
 but do it in the background, as long as you carefully fullfill requirements described
 in function vmaDefragmentationBegin().
 
+\section defragmentation_estimate Estimating defragmentation
+
+Before starting actual defragmentation, you can check whether it would pay off
+by calling function vmaEstimateDefragmentation() with the same #VmaDefragmentationInfo2.
+It runs the same algorithm on temporary copies of internal data structures of the affected
+memory blocks and returns projected results in #VmaDefragmentationEstimate,
+without changing any allocations or memory contents.
+
+\code
+VmaDefragmentationEstimate estimate;
+vmaEstimateDefragmentation(allocator, &defragInfo, &estimate);
+if(estimate.deviceMemoryBlocksFreed > 0 ||
+    estimate.fragmentationBefore - estimate.fragmentationAfter > 0.25f)
+{
+    VmaDefragmentationContext defragCtx;
+    vmaDefragmentationBegin(allocator, &defragInfo, nullptr, &defragCtx);
+    vmaDefragmentationEnd(allocator, defragCtx);
+}
+\endcode
+
+\section defragmentation_automatic Automatic defragmentation
+
+Each memory pool maintains its fragmentation score, updated with every allocation and
+deallocation. You can query it cheaply at any time using vmaGetPoolFragmentationScore()
+or, for default pools, vmaGetMemoryTypeFragmentationScore(), e.g. to send it to telemetry.
+Member VmaFragmentationScore::fragmentation tells how much free space is scattered, while
+VmaFragmentationScore::blockUtilizationSpread tells how unevenly memory blocks are filled.
+
+A custom pool in `HOST_VISIBLE` and `HOST_COHERENT` memory can also be defragmented
+automatically. Fill #VmaAutoDefragmentationPolicy and call vmaSetPoolAutoDefragmentationPolicy().
+When the score of the pool stays above a threshold for given number of frames,
+the next call to vmaSetCurrentFrameIndex() defragments the pool within given limits and
+calls your callback with the list of allocations that have been moved.
+
+\code
+void VKAPI_PTR MyAllocationsMoved(VmaAllocator allocator, VmaPool pool,
+    uint32_t allocationCount, const VmaAllocation* pAllocations, void* pUserData)
+{
+    for(uint32_t i = 0; i < allocationCount; ++i)
+    {
+        // Destroy buffer bound to pAllocations[i], create it again and bind it
+        // using vmaBindBufferMemory().
+    }
+}
+
+VmaAutoDefragmentationPolicy policy = {};
+policy.fragmentationThreshold = 0.5f;
+policy.frameCount = 60;
+policy.maxBytesToMove = 4ull * 1024 * 1024;
+policy.maxAllocationsToMove = 64;
+policy.pfnAllocationsMoved = MyAllocationsMoved;
+vmaSetPoolAutoDefragmentationPolicy(allocator, pool, &policy);
+\endcode
+
+Allocations may be moved during any call to vmaSetCurrentFrameIndex(), so all
+the buffers in such pool must be ready for it. Pools in other memory types are never
+defragmented automatically - you can check their score yourself and defragment them
+on GPU as described in [Defragmenting GPU memory](@ref defragmentation_gpu).
+
 \section defragmentation_additional_notes Additional notes
 
 It is only legal to defragment allocations bound to:
@@ -933,6 +1034,23 @@ memory blocks to make totally empty to release them, as well as to maximimze con
 empty space inside remaining blocks, while minimizing the number and size of allocations that
 need to be moved. Some fragmentation may still remain - this is normal.
 
+By default, the algorithm is chosen automatically for each memory pool. If your pools
+contain many allocations and many small free ranges between them, consider passing
+#VMA_DEFRAGMENTATION_BEST_FIT_ALGORITHM_BIT in VmaDefragmentationInfo2::flags.
+It usually moves fewer bytes and takes less time, especially when only some of the allocations
+can be moved, at the cost of leaving more small free ranges between allocations than
+the default algorithm would when all allocations can be moved.
+
+Custom pools created with #VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT or #VMA_POOL_CREATE_BUDDY_ALGORITHM_BIT
+are defragmented with their own algorithms, regardless of VmaDefragmentationInfo2::flags:
+
+- In a linear pool, allocations are compacted towards the beginning of the block - or towards
+  its end for the upper stack of a [double stack](@ref linear_algorithm_double_stack) - preserving their order,
+  and moved to free space at the end of previous blocks when it's big enough.
+  A [ring buffer](@ref linear_algorithm_ring_buffer) becomes a single stack.
+- In a buddy pool, allocations are moved to free nodes of the same size placed before them,
+  or to split bigger ones, so free nodes can merge with their buddies into bigger ones.
+
 \section defragmentation_custom_algorithm Writing custom defragmentation algorithm
 
 If you want to implement your own, custom defragmentation algorithm,
@@ -1087,13 +1205,72 @@ It contains #VmaStatInfo - number of allocated blocks, number of allocations
 (occupied ranges in these blocks), number of unused (free) ranges in these blocks,
 number of bytes used and unused (but still allocated from Vulkan) and other information.
 They are summed across memory heaps, memory types and total for whole allocator.
+If you have many custom pools, function vmaCalculateStatsParallel() returns the same
+information faster by processing them on multiple threads, using either your own
+task system described by #VmaTaskSystem or threads started by the library.
 
 You can query for statistics of a custom pool using function vmaGetPoolStats().
 Information are returned using structure #VmaPoolStats.
 
+To help choosing block size and algorithm of a pool, you can fetch distribution of sizes
+of allocations made in it and their lifetimes measured in frames, using function
+vmaGetPoolAllocationHistograms() or, for default pools, vmaGetMemoryTypeAllocationHistograms().
+Information are returned using structure #VmaAllocationHistograms.
+They are also included in the JSON dump described below.
+
 You can query for information about specific allocation using function vmaGetAllocationInfo().
 It fill structure #VmaAllocationInfo.
 
+\section statistics_counters Counters
+
+The allocator also keeps cumulative counters of its operations, like number of allocations,
+number of bytes allocated and freed, number of failed allocations, `VkDeviceMemory` blocks created,
+or time spent waiting for internal mutexes locked by other threads.
+You can fetch them using function vmaGetCounters(), which fills structure #VmaCounters.
+Contrary to other statistics, this function is very cheap, so it can be called every frame.
+Counters are enabled by default. Updating them adds only a few plain increments of memory owned
+by the current thread to every allocation and free. Define macro `VMA_COUNTERS_ENABLED` to 0
+to remove them completely.
+
+Lock contention is not counted by default, because detecting it requires trying to lock
+every mutex first, which is slower than just locking it on some platforms, even when the mutex
+is not locked by another thread. Define macro `VMA_COUNTERS_LOCK_CONTENTION` to 1 to count it.
+It also requires `VMA_RW_MUTEX` to provide method `bool TryLockWrite()`.
+The default implementations have it, except the one based on `SRWLOCK` when compiled for
+Windows older than 7 (`WINVER` < 0x0601). Otherwise, the mutex is just locked
+and `lockContentionCount` and `lockWaitNanoseconds` stay 0.
+
+\section statistics_snapshots Snapshots
+
+To find memory leaks or allocations that are made and freed every frame, you can capture
+statistics of the allocator at two moments using function vmaCreateStatsSnapshot() and compare
+them using vmaCompareStatsSnapshots(). Returned structure #VmaStatsSnapshotDiff tells how statistics
+of every memory type and pool changed, which memory blocks were created, destroyed or changed and,
+if the snapshots were created with #VMA_STATS_SNAPSHOT_CREATE_ALLOCATIONS_BIT, which allocations
+were added and removed.
+
+\code
+VmaStatsSnapshot before;
+vmaCreateStatsSnapshot(allocator, VMA_STATS_SNAPSHOT_CREATE_ALLOCATIONS_BIT, &before);
+
+// Render some frames...
+
+VmaStatsSnapshot after;
+vmaCreateStatsSnapshot(allocator, VMA_STATS_SNAPSHOT_CREATE_ALLOCATIONS_BIT, &after);
+
+VmaStatsSnapshotDiff diff;
+vmaCompareStatsSnapshots(allocator, before, after, &diff);
+for(size_t i = 0; i < diff.addedAllocationCount; ++i)
+{
+    // Allocations still alive, so diff.pAddedAllocations[i].allocation can be used,
+    // e.g. to fetch its name with vmaGetAllocationInfo().
+}
+vmaFreeStatsSnapshotDiff(allocator, &diff);
+
+vmaDestroyStatsSnapshot(allocator, after);
+vmaDestroyStatsSnapshot(allocator, before);
+\endcode
+
 \section statistics_json_dump JSON dump
 
 You can dump internal state of the allocator to a string in JSON format using function vmaBuildStatsString().
@@ -1113,6 +1290,29 @@ It can also contain detailed map of allocated memory blocks and their regions -
 free and occupied by allocations.
 This allows e.g. to visualize the memory or assess fragmentation.
 
+With many allocations, the detailed map can become very large.
+Instead of building it in memory, you can stream the same JSON text to a file or
+your own callback using function vmaWriteStatsToSink():
+
+\code
+FILE* file = fopen("VmaStats.json", "wb");
+
+VmaStatsSink sink = {};
+sink.pFile = file;
+
+vmaWriteStatsToSink(allocator, &sink, VK_TRUE);
+fclose(file);
+\endcode
+
+The text is written in fragments of at most VmaStatsSink::chunkSize bytes,
+so memory needed by this function stays small regardless of the number of allocations.
+
+Function vmaWriteBinaryStats() writes the same information in compact binary format,
+which is several times smaller and much faster to produce than JSON.
+Its format is described in file "docs/Binary stats file format.md".
+Script "tools/VmaDumpVis/VmaBinaryStatsToJson.py" converts it to JSON,
+so it can be used e.g. with VmaDumpVis.
+
 
 \page allocation_annotation Allocation names and user data
 
@@ -1330,16 +1530,60 @@ Basic usage:
 <b>Documentation of file format</b> can be found in file: "docs/Recording file format.md".
 It's a human-readable, text file in CSV format (Comma Separated Values).
 
+If recording overhead is too high, e.g. when many threads call the allocator
+concurrently, use #VMA_RECORD_BINARY_FORMAT_BIT. Calls are then encoded in compact
+binary form into separate buffer of each thread and written to the file by
+a background thread. VmaReplay accepts both formats.
+
+Recordings of long sessions can take a lot of disk space. To compress them,
+define macro `VMA_RECORDING_COMPRESSION` to 1, link your program with zlib,
+and use #VMA_RECORD_COMPRESS_BIT. VmaReplay decompresses such files while replaying them.
+
+To investigate rare failures without recording the whole session, use
+#VMA_RECORD_FLIGHT_RECORDER_BIT. Only the most recent calls of every thread are then
+kept in memory, and they are written to the file when an allocation fails
+or when you call vmaDumpRecording(), e.g. after detecting a problem in your application.
+The dump starts with calls that recreate pools and allocations made before its oldest call,
+including allocations made with vmaAllocateMemoryWithoutHandle(), in the frames in which they were made.
+Their original parameters, like alignment, are not known, so they may be placed differently during replay.
+
+Functions that only query state of allocations, like vmaGetAllocationInfo() or vmaTouchAllocation(),
+are often called much more frequently than others. Their calls can be left out of the recording
+using VmaRecordSettings::disabledFunctions, or recorded only once every few calls using
+VmaRecordSettings::optionalCallSamplingPeriod. Calls that change state of the allocator are always
+recorded, so the recording can still be replayed. To check the overhead of the recording,
+call vmaGetRecordingStats().
+
 \section record_and_replay_additional_considerations Additional considerations
 
 - Replaying file that was recorded on a different GPU (with different parameters
   like `bufferImageGranularity`, `nonCoherentAtomSize`, and especially different
   set of memory heaps and types) may give different performance and memory usage
   results, as well as issue some warnings and errors.
-- Current implementation of recording in VMA, as well as VmaReplay application, is
-  coded and tested only on Windows. Inclusion of recording code is driven by
-  `VMA_RECORDING_ENABLED` macro. Support for other platforms should be easy to
-  add. Contributions are welcomed.
+  To avoid that, or to replay without any GPU, use VmaReplay option `--NullDevice 1`.
+  Vulkan is then replaced by a fake device implemented in "src/NullDevice.h"
+  that keeps memory in host RAM and has the memory heaps, types, and limits
+  recorded in the file. Results are deterministic, so they can be compared
+  between changes in the library. Cost of a real driver can be simulated
+  with `--NullDeviceLatency`.
+- Recording in VMA works on Windows and Linux. Inclusion of recording code is
+  driven by `VMA_RECORDING_ENABLED` macro. On Linux, thread IDs are the ones returned
+  by `gettid()` and timestamps come from time stamp counter of the processor when it
+  is invariant, calibrated against `std::chrono::steady_clock` while the allocator is
+  created, or from `std::chrono::steady_clock` itself otherwise. See macros
+  `VMA_RECORDING_USE_TSC` and `VMA_RECORDING_TSC_CALIBRATION_MILLISECONDS`.
+- VmaReplay application builds on Windows and Linux. Before playback it compiles
+  the whole recording file, which can also be a pipe, into a compact array of calls
+  with parsed parameters, so repeated playback (`-i`) doesn't parse it again and
+  the time of parsing doesn't count into playback time. With option
+  `--CompiledCache 1` the result is saved to a file with `.compiled` extension
+  next to the recording and used on next launches, as long as the recording
+  doesn't change.
+- With option `--Multithreaded 1` VmaReplay plays calls of every recorded thread
+  on a separate thread. Calls using the same pool, allocation or defragmentation
+  context keep their original order, while defragmentation and changes of the
+  frame index are played when other threads are idle. Latency of calls and time
+  spent waiting for other threads and for VMA locks are printed per thread.
 
 
 \page usage_patterns Recommended usage patterns
@@ -1516,6 +1760,10 @@ If you want to provide your own pointers to these functions, e.g. fetched using
 -# Define `VMA_STATIC_VULKAN_FUNCTIONS 0`.
 -# Provide valid pointers through VmaAllocatorCreateInfo::pVulkanFunctions.
 
+Pointers passed through VmaAllocatorCreateInfo::pVulkanFunctions override the
+static ones also when `VMA_STATIC_VULKAN_FUNCTIONS` is 1. Extension functions
+provided this way are not fetched using `vkGetDeviceProcAddr()`.
+
 \section custom_memory_allocator Custom host memory allocator
 
 If you use custom allocator for CPU memory rather than default operator `new`
@@ -1698,7 +1946,7 @@ available through VmaAllocatorCreateInfo::pRecordSettings.
     #include <vulkan/vulkan.h>
 #endif
 
-#if VMA_RECORDING_ENABLED
+#if VMA_RECORDING_ENABLED && defined(_WIN32)
     #include <windows.h>
 #endif
 
@@ -1842,11 +2090,77 @@ typedef enum VmaRecordFlagBits {
     It may degrade performance though.
     */
     VMA_RECORD_FLUSH_AFTER_CALL_BIT = 0x00000001,
-    
+    /** \brief Writes the recording in compact binary format instead of CSV.
+
+    Every thread encodes its calls into its own buffer without taking any lock.
+    Buffers are written to the file by a background thread, so allocation-heavy
+    code is slowed down much less than with the CSV format.
+    VmaReplay reads both formats. Description of the binary format can be found in
+    "docs/Recording file format.md".
+
+    When used together with #VMA_RECORD_FLUSH_AFTER_CALL_BIT, the background thread
+    flushes the file every time it writes the buffers, which happens every few
+    milliseconds, instead of after every call. Calls made in the last few
+    milliseconds before a crash may be missing from the file.
+    */
+    VMA_RECORD_BINARY_FORMAT_BIT = 0x00000002,
+    /** \brief Compresses the file with deflate algorithm, in gzip format.
+
+    Calls are still formatted by the calling thread, but only appended to a buffer in memory.
+    They are compressed and written to the file by a background thread.
+    The file can be decompressed by any tool supporting gzip format, and VmaReplay reads it directly.
+    Can be used together with #VMA_RECORD_BINARY_FORMAT_BIT.
+
+    Available only when macro `VMA_RECORDING_COMPRESSION` is defined to 1, which
+    requires zlib. Otherwise creation of the allocator fails with `VK_ERROR_FEATURE_NOT_PRESENT`.
+
+    When used together with #VMA_RECORD_FLUSH_AFTER_CALL_BIT, the background thread
+    flushes the compressed stream and the file every few milliseconds, instead of after every call.
+    */
+    VMA_RECORD_COMPRESS_BIT = 0x00000004,
+    /** \brief Keeps only the most recent calls in memory and writes them to the file only when requested.
+
+    Calls are encoded in the binary format into a ring buffer of each thread, of size
+    VmaRecordSettings::flightRecorderBufferSize, overwriting the oldest ones.
+    Nothing is written to the file until vmaDumpRecording() is called or an allocation fails
+    for the first time, which dumps the buffers automatically to VmaRecordSettings::pFilePath.
+    The file then contains the calls, preceded by pools and allocations that existed before
+    the first of them, so VmaReplay can recreate the state of the allocator from which
+    the recorded calls start. To make it possible, functions that destroy objects also
+    store their descriptions in the buffer. Parameters of allocations made before that
+    are not known exactly - they are recreated with the same size, alignment, and memory type.
+
+    Implies #VMA_RECORD_BINARY_FORMAT_BIT. Can be used together with #VMA_RECORD_COMPRESS_BIT,
+    which compresses the dumped files. #VMA_RECORD_FLUSH_AFTER_CALL_BIT is ignored.
+
+    Available only when macro `VMA_STATS_STRING_ENABLED` is defined to 1, which it is by default.
+    Otherwise creation of the allocator fails with `VK_ERROR_FEATURE_NOT_PRESENT`.
+    */
+    VMA_RECORD_FLIGHT_RECORDER_BIT = 0x00000008,
+
     VMA_RECORD_FLAG_BITS_MAX_ENUM = 0x7FFFFFFF
 } VmaRecordFlagBits;
 typedef VkFlags VmaRecordFlags;
 
+/** \brief Functions that don't change state of the allocator, so their calls can be left out of the recording.
+
+To be used in VmaRecordSettings::disabledFunctions. Replay of a recording without some of their calls
+gives the same results.
+*/
+typedef enum VmaRecordOptionalFunctionFlagBits {
+    /// vmaTouchAllocation()
+    VMA_RECORD_OPTIONAL_FUNCTION_TOUCH_ALLOCATION_BIT = 0x00000001,
+    /// vmaGetAllocationInfo()
+    VMA_RECORD_OPTIONAL_FUNCTION_GET_ALLOCATION_INFO_BIT = 0x00000002,
+    /// vmaFlushAllocation()
+    VMA_RECORD_OPTIONAL_FUNCTION_FLUSH_ALLOCATION_BIT = 0x00000004,
+    /// vmaInvalidateAllocation()
+    VMA_RECORD_OPTIONAL_FUNCTION_INVALIDATE_ALLOCATION_BIT = 0x00000008,
+
+    VMA_RECORD_OPTIONAL_FUNCTION_FLAG_BITS_MAX_ENUM = 0x7FFFFFFF
+} VmaRecordOptionalFunctionFlagBits;
+typedef VkFlags VmaRecordOptionalFunctionFlags;
+
 /// Parameters for recording calls to VMA functions. To be used in VmaAllocatorCreateInfo::pRecordSettings.
 typedef struct VmaRecordSettings
 {
@@ -1854,12 +2168,34 @@ typedef struct VmaRecordSettings
     VmaRecordFlags flags;
     /** \brief Path to the file that should be written by the recording.
 
-    Suggested extension: "csv".
+    Suggested extension: "csv", or "bin" when #VMA_RECORD_BINARY_FORMAT_BIT is used,
+    followed by ".gz" when #VMA_RECORD_COMPRESS_BIT is used.
     If the file already exists, it will be overwritten.
     It will be opened for the whole time #VmaAllocator object is alive.
     If opening this file fails, creation of the whole allocator object fails.
+
+    With #VMA_RECORD_FLIGHT_RECORDER_BIT, the file is written only by a dump of the recording.
     */
     const char* pFilePath;
+    /** \brief Size of the ring buffer of every thread with #VMA_RECORD_FLIGHT_RECORDER_BIT, in bytes. Optional.
+
+    Set to 0 to use default, which is currently 1 MiB. Rounded up to a power of 2.
+    Ignored without #VMA_RECORD_FLIGHT_RECORDER_BIT.
+    */
+    size_t flightRecorderBufferSize;
+    /** \brief Functions whose calls are not recorded. Optional. Use #VmaRecordOptionalFunctionFlagBits enum.
+
+    Calls of vmaTouchAllocation() and vmaGetAllocationInfo() are still recorded for allocations
+    created with #VMA_ALLOCATION_CREATE_CAN_BECOME_LOST_BIT, because they update
+    their last use frame index.
+    */
+    VmaRecordOptionalFunctionFlags disabledFunctions;
+    /** \brief Records only the first of every `optionalCallSamplingPeriod` calls of each function from #VmaRecordOptionalFunctionFlagBits. Optional.
+
+    Calls are counted separately by every thread. Set to 0 or 1 to record all calls.
+    Same exception applies as for `disabledFunctions`.
+    */
+    uint32_t optionalCallSamplingPeriod;
 } VmaRecordSettings;
 
 /// Description of a Allocator to be created.
@@ -1985,11 +2321,59 @@ This function must be used if you make allocations with
 #VMA_ALLOCATION_CREATE_CAN_MAKE_OTHER_LOST_BIT flags to inform the allocator
 when a new frame begins. Allocations queried using vmaGetAllocationInfo() cannot
 become lost in the current frame.
+
+It is also needed for automatic defragmentation of pools enabled with
+vmaSetPoolAutoDefragmentationPolicy(), which is performed inside this function.
 */
 void vmaSetCurrentFrameIndex(
     VmaAllocator allocator,
     uint32_t frameIndex);
 
+/** \brief Writes calls kept in memory by the recording made with #VMA_RECORD_FLIGHT_RECORDER_BIT to a file.
+
+@param allocator Allocator object.
+@param pFilePath Path to the file to be written. Optional, can be null, which means VmaRecordSettings::pFilePath.
+
+The file is in binary format, compressed if #VMA_RECORD_COMPRESS_BIT was used.
+Recording continues after the dump, and this function can be called many times.
+Other threads can keep calling the allocator, they are stopped only while their buffers are copied.
+Calls they make during the dump may then be missing from it.
+
+\return `VK_ERROR_FEATURE_NOT_PRESENT` if the allocator doesn't record with #VMA_RECORD_FLIGHT_RECORDER_BIT,
+`VK_ERROR_INITIALIZATION_FAILED` if the file couldn't be opened.
+*/
+VkResult vmaDumpRecording(
+    VmaAllocator allocator,
+    const char* pFilePath);
+
+/// Statistics of the recording of calls, returned by vmaGetRecordingStats().
+typedef struct VmaRecordingStats {
+    /// Number of calls recorded so far.
+    uint64_t recordedCallCount;
+    /// Number of calls left out due to VmaRecordSettings::disabledFunctions and VmaRecordSettings::optionalCallSamplingPeriod.
+    uint64_t skippedCallCount;
+    /** \brief Time spent in recording of the calls, in nanoseconds, summed over all threads calling the allocator.
+
+    Includes waiting for locks and for the file to be written. Doesn't include background threads of the recording.
+    */
+    uint64_t recordingTimeNanoseconds;
+    /** \brief Number of bytes of the recording output so far, before compression.
+
+    Calls kept in memory, e.g. in buffers of threads with #VMA_RECORD_BINARY_FORMAT_BIT, are not included until they are written.
+    */
+    uint64_t bytesRecorded;
+    /// Number of bytes written to the file so far. Differs from `bytesRecorded` only with #VMA_RECORD_COMPRESS_BIT.
+    uint64_t bytesWritten;
+} VmaRecordingStats;
+
+/** \brief Retrieves statistics of the recording of calls, to measure its overhead.
+
+\return `VK_ERROR_FEATURE_NOT_PRESENT` if the allocator doesn't record calls.
+*/
+VkResult vmaGetRecordingStats(
+    VmaAllocator allocator,
+    VmaRecordingStats* pStats);
+
 /** \brief Calculated statistics of memory usage in entire allocator.
 */
 typedef struct VmaStatInfo
@@ -2021,6 +2405,129 @@ void vmaCalculateStats(
     VmaAllocator allocator,
     VmaStats* pStats);
 
+/// Function that executes single task of the work passed to #PFN_vmaRunTasksFunction.
+typedef void (VKAPI_PTR *PFN_vmaTaskFunction)(
+    void*             pTaskData,
+    uint32_t          taskIndex);
+
+/** \brief Callback function that executes given number of independent tasks, possibly in parallel.
+
+It must call `pfnTask(pTaskData, taskIndex)` exactly once for every `taskIndex` in range `[0, taskCount)`,
+in any order and from any threads, and return only after all these calls have returned.
+*/
+typedef void (VKAPI_PTR *PFN_vmaRunTasksFunction)(
+    void*               pUserData,
+    PFN_vmaTaskFunction pfnTask,
+    void*               pTaskData,
+    uint32_t            taskCount);
+
+/** \brief Task system of the application that the library can use to spread its work across multiple threads.
+
+Used in vmaCalculateStatsParallel().
+*/
+typedef struct VmaTaskSystem {
+    /// Function that executes tasks. Required.
+    PFN_vmaRunTasksFunction pfnRunTasks;
+    /// Custom pointer passed to `pfnRunTasks`. Optional.
+    void* pUserData;
+} VmaTaskSystem;
+
+/** \brief Retrieves statistics from current state of the Allocator, processing pools in parallel.
+
+Returns exactly the same results as vmaCalculateStats(), but memory blocks of default pools,
+custom pools and dedicated allocations of every memory type are processed as separate tasks,
+which can run on multiple threads. This is useful when there are many custom pools.
+
+\param allocator
+\param pTaskSystem Task system used to run the tasks. Optional.
+    If null, the library starts its own threads for the duration of this call, up to the number
+    of hardware threads, or processes all the pools on the calling thread if `VMA_USE_STL_THREAD`
+    is defined to 0.
+\param[out] pStats
+
+Just like vmaCalculateStats(), every pool is locked for reading only while its own task runs.
+List of custom pools is locked for reading for the duration of the whole call, so new pools
+cannot be created or destroyed until it returns.
+*/
+void vmaCalculateStatsParallel(
+    VmaAllocator allocator,
+    const VmaTaskSystem* pTaskSystem,
+    VmaStats* pStats);
+
+#ifndef VMA_COUNTERS_ENABLED
+#define VMA_COUNTERS_ENABLED 1
+#endif
+
+#if VMA_COUNTERS_ENABLED
+
+/** \brief Cumulative counters of operations performed by the allocator since its creation.
+
+Returned by function vmaGetCounters().
+*/
+typedef struct VmaCounters
+{
+    /// Number of allocations requested, including failed ones. Each page of vmaAllocateMemoryPages() counts separately.
+    uint64_t allocationCount;
+    /// Total size of successful allocations, in bytes.
+    VkDeviceSize allocationBytes;
+    /// Number of requested allocations that failed.
+    uint64_t allocationFailureCount;
+    /// Number of allocations freed, including those freed by vmaFreePoolAllocations().
+    uint64_t freeCount;
+    /// Total size of freed allocations, in bytes.
+    VkDeviceSize freeBytes;
+    /// Number of successful allocations that got their own dedicated `VkDeviceMemory`.
+    uint64_t dedicatedAllocationCount;
+    /** \brief Number of dedicated allocations made only because allocation from a memory block failed.
+
+    These are also included in `dedicatedAllocationCount`.
+    */
+    uint64_t dedicatedFallbackCount;
+    /// Number of `VkDeviceMemory` blocks created for default and custom pools.
+    uint64_t blockCreateCount;
+    /// Total size of `VkDeviceMemory` blocks created for default and custom pools, in bytes.
+    VkDeviceSize blockCreateBytes;
+    /// Number of successful calls to vmaMapMemory().
+    uint64_t mapCount;
+    /// Number of calls to vmaUnmapMemory().
+    uint64_t unmapCount;
+    /// Number of allocations flushed, e.g. with vmaFlushAllocation(), also when the memory is `HOST_COHERENT` and nothing needs to be done.
+    uint64_t flushCount;
+    /// Number of allocations invalidated with vmaInvalidateAllocation(), also when the memory is `HOST_COHERENT` and nothing needs to be done.
+    uint64_t invalidateCount;
+    /// Number of defragmentations started with vmaDefragmentationBegin() or vmaDefragment(), or automatically for a pool with vmaSetPoolAutoDefragmentationPolicy().
+    uint64_t defragmentationCount;
+    /** \brief Number of times a thread had to wait for an internal mutex locked by another thread.
+
+    Only mutexes taken when allocating and freeing memory are measured.
+    Always 0 unless macro `VMA_COUNTERS_LOCK_CONTENTION` is defined to 1 and
+    `VMA_RW_MUTEX` provides method `TryLockWrite()`.
+    */
+    uint64_t lockContentionCount;
+    /// Total time spent waiting for internal mutexes counted in `lockContentionCount`, in nanoseconds.
+    uint64_t lockWaitNanoseconds;
+} VmaCounters;
+
+/** \brief Retrieves cumulative counters of operations performed by the allocator.
+
+Unlike vmaCalculateStats(), this function is very cheap. It doesn't lock any mutex
+and doesn't traverse internal data structures, so it can be called as often as needed,
+e.g. every frame, from any thread.
+
+Counters are updated by other threads without synchronization between them, so
+values returned while other threads use the allocator don't need to be consistent
+with each other. Difference between two snapshots shows activity of the allocator
+between them.
+
+To remove the counters and their small overhead completely, define macro
+`VMA_COUNTERS_ENABLED` to 0.
+*/
+void vmaGetCounters(
+    VmaAllocator allocator,
+    VmaCounters* pCounters);
+
+#endif // #if VMA_COUNTERS_ENABLED
+
 #ifndef VMA_STATS_STRING_ENABLED
 #define VMA_STATS_STRING_ENABLED 1
 #endif
@@ -2039,6 +2546,71 @@ void vmaFreeStatsString(
     VmaAllocator allocator,
     char* pStatsString);
 
+/// Callback function called by vmaWriteStatsToSink() with consecutive fragments of JSON text.
+typedef void (VKAPI_PTR *PFN_vmaWriteStatsFunction)(
+    void*             pUserData,
+    const char*       pData,
+    size_t            size);
+
+/** \brief Describes where vmaWriteStatsToSink() writes its output.
+
+Exactly one of members `pfnWrite`, `pFile` must be set.
+*/
+typedef struct VmaStatsSink {
+    /** \brief Function that receives the text. Optional.
+
+    Fragments are not null-terminated. Their concatenation is the same string as returned by vmaBuildStatsString().
+    */
+    PFN_vmaWriteStatsFunction pfnWrite;
+    /// Custom pointer passed to `pfnWrite`. Optional.
+    void* pUserData;
+    /** \brief `FILE*` opened for writing, to which the text is written using `fwrite`. Optional.
+
+    The file is not flushed or closed by the library.
+    */
+    void* pFile;
+    /** \brief Size of internal buffer, in bytes. Optional.
+
+    Text is collected in a buffer of this size and passed to the sink when the buffer is full,
+    so this is also the maximum length of a single fragment.
+    Set to 0 to use default, which is 4 KiB.
+    */
+    size_t chunkSize;
+} VmaStatsSink;
+
+/** \brief Writes statistics in JSON format to a file or custom callback.
+
+Produces the same text as vmaBuildStatsString(), but instead of building it in memory,
+streams it in fragments as it is generated. Memory used by this function doesn't depend on
+number of allocations, which makes it suitable for dumping detailed map of a large number of allocations.
+
+\return `VK_SUCCESS`, or `VK_INCOMPLETE` if writing to `pFile` failed. In that case the rest of the
+text is discarded, so the output is truncated.
+
+Text is passed to the sink while the library holds its internal locks, so `pfnWrite` must not call
+functions of this library.
+*/
+VkResult vmaWriteStatsToSink(
+    VmaAllocator allocator,
+    const VmaStatsSink* pSink,
+    VkBool32 detailedMap);
+
+/** \brief Writes statistics and detailed map of allocations in compact binary format to a file or custom callback.
+
+Contains the same information as vmaBuildStatsString() with `detailedMap` = `VK_TRUE`, but stored
+as fixed-size records, which are much faster to write and read than JSON.
+Format is described in file "docs/Binary stats file format.md".
+Script "tools/VmaDumpVis/VmaBinaryStatsToJson.py" converts it to JSON.
+
+\return `VK_SUCCESS`, or `VK_INCOMPLETE` if writing to VmaStatsSink::pFile failed.
+
+Memory used by this function doesn't depend on number of allocations,
+except for a copy of all allocation names (user data strings).
+*/
+VkResult vmaWriteBinaryStats(
+    VmaAllocator allocator,
+    const VmaStatsSink* pSink);
+
 #endif // #if VMA_STATS_STRING_ENABLED
 
 /** \struct VmaPool
@@ -2361,6 +2933,18 @@ typedef enum VmaPoolCreateFlagBits {
     */
     VMA_POOL_CREATE_BUDDY_ALGORITHM_BIT = 0x00000008,
 
+    /** \brief Lets buddy algorithm use the whole block when its size is not a power of two.
+
+    Can be used only together with #VMA_POOL_CREATE_BUDDY_ALGORITHM_BIT.
+
+    By default, buddy algorithm uses only the largest power of two not greater than
+    the block size. With this flag, the block is covered by several trees, one for
+    each bit set in its size, so almost no space stays unused.
+
+    For more details, see [Buddy allocation algorithm](@ref buddy_algorithm).
+    */
+    VMA_POOL_CREATE_BUDDY_MULTIPLE_ROOTS_BIT = 0x00000010,
+
     /** Bit mask to extract only `ALGORITHM` bits from entire set of flags.
     */
     VMA_POOL_CREATE_ALGORITHM_MASK =
@@ -2473,6 +3057,57 @@ void vmaGetPoolStats(
     VmaPool pool,
     VmaPoolStats* pPoolStats);
 
+/// Number of buckets in VmaAllocationHistograms::allocationSize.
+#define VMA_SIZE_HISTOGRAM_BUCKET_COUNT 64
+/// Number of buckets in VmaAllocationHistograms::allocationLifetime.
+#define VMA_LIFETIME_HISTOGRAM_BUCKET_COUNT 33
+
+/** \brief Distribution of sizes and lifetimes of allocations made in a pool, returned by vmaGetPoolAllocationHistograms() and vmaGetMemoryTypeAllocationHistograms().
+
+Buckets are logarithmic. Both histograms are cumulative - they count allocations
+since the pool was created, not only the ones that currently exist.
+*/
+typedef struct VmaAllocationHistograms {
+    /** \brief Number of allocations made, by their size.
+
+    Bucket `i` counts allocations with size in range `[2^i, 2^(i+1))` bytes.
+    */
+    uint64_t allocationSize[VMA_SIZE_HISTOGRAM_BUCKET_COUNT];
+    /** \brief Number of allocations freed, by their lifetime in frames.
+
+    Lifetime is the difference between frame index set by vmaSetCurrentFrameIndex()
+    when the allocation was freed and when it was created.
+    Bucket 0 counts allocations freed in the same frame, bucket `i` > 0 counts
+    allocations that lived for `[2^(i-1), 2^i)` frames.
+    Allocations that became lost are not counted.
+    */
+    uint64_t allocationLifetime[VMA_LIFETIME_HISTOGRAM_BUCKET_COUNT];
+} VmaAllocationHistograms;
+
+/** \brief Retrieves histograms of sizes and lifetimes of allocations made in a custom pool.
+
+@param allocator Allocator object.
+@param pool Pool object.
+@param[out] pHistograms Histograms of the pool.
+*/
+void vmaGetPoolAllocationHistograms(
+    VmaAllocator allocator,
+    VmaPool pool,
+    VmaAllocationHistograms* pHistograms);
+
+/** \brief Retrieves histograms of sizes and lifetimes of allocations made in the default pool of given memory type.
+
+@param allocator Allocator object.
+@param memoryTypeIndex Index of the memory type.
+@param[out] pHistograms Histograms of allocations made outside of custom pools in this memory type.
+
+Dedicated allocations are not included.
+*/
+void vmaGetMemoryTypeAllocationHistograms(
+    VmaAllocator allocator,
+    uint32_t memoryTypeIndex,
+    VmaAllocationHistograms* pHistograms);
+
 /** \brief Marks all allocations in given pool as lost if they are not used in current frame or VmaPoolCreateInfo::frameInUseCount back from now.
 
 @param allocator Allocator object.
@@ -2484,6 +3119,28 @@ void vmaMakePoolAllocationsLost(
     VmaPool pool,
     size_t* pLostAllocationCount);
 
+/** \brief Frees at once all allocations in given pool with linear algorithm that were made in frame `lastFrameIndex` or earlier.
+
+@param allocator Allocator object.
+@param pool Pool created with #VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT.
+@param lastFrameIndex Index of the last frame, as set with vmaSetCurrentFrameIndex(), whose allocations are freed.
+    Pass `UINT32_MAX` to free all allocations, resetting the pool.
+@param[out] pFreedAllocationCount Number of freed allocations. Optional - pass null if you don't need this information.
+
+Allocations are freed starting from the oldest one. Allocations made without #VmaAllocation object
+using vmaAllocateMemoryWithoutHandle() are freed too. #VmaAllocation objects of freed allocations
+are destroyed, so you must not use them any more, just like after vmaFreeMemory().
+Allocations that became lost are not affected - you still need to free them with vmaFreeMemory().
+
+Returns `VK_ERROR_FEATURE_NOT_PRESENT` if the pool doesn't use linear algorithm.
+For more information, see [Freeing allocations per frame](@ref linear_algorithm_free_per_frame).
+*/
+VkResult vmaFreePoolAllocations(
+    VmaAllocator allocator,
+    VmaPool pool,
+    uint32_t lastFrameIndex,
+    size_t* pFreedAllocationCount);
+
 /** \brief Checks magic number in margins around all allocations in given memory pool in search for corruptions.
 
 Corruption detection is enabled only when `VMA_DEBUG_DETECT_CORRUPTION` macro is defined to nonzero,
@@ -2634,6 +3291,24 @@ VkResult vmaAllocateMemoryForImage(
     VmaAllocation* pAllocation,
     VmaAllocationInfo* pAllocationInfo);
 
+/** \brief Allocates memory from a custom pool with linear algorithm without creating #VmaAllocation object.
+
+@param[out] pAllocationInfo Information about allocated memory. `pUserData` is always null.
+
+`pCreateInfo->pool` must be a pool created with #VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT.
+Flags #VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT, #VMA_ALLOCATION_CREATE_CAN_BECOME_LOST_BIT
+and #VMA_ALLOCATION_CREATE_USER_DATA_COPY_STRING_BIT are not supported - `VK_ERROR_FEATURE_NOT_PRESENT` is returned.
+
+Such allocation cannot be freed individually. It is freed by vmaFreePoolAllocations()
+together with other allocations made in the same frame or earlier.
+For more information, see [Freeing allocations per frame](@ref linear_algorithm_free_per_frame).
+*/
+VkResult vmaAllocateMemoryWithoutHandle(
+    VmaAllocator allocator,
+    const VkMemoryRequirements* pVkMemoryRequirements,
+    const VmaAllocationCreateInfo* pCreateInfo,
+    VmaAllocationInfo* pAllocationInfo);
+
 /** \brief Frees memory previously allocated using vmaAllocateMemory(), vmaAllocateMemoryForBuffer(), or vmaAllocateMemoryForImage().
 
 Passing `VK_NULL_HANDLE` as `allocation` is valid. Such function call is just skipped.
@@ -2840,6 +3515,179 @@ Possible return values:
 */
 VkResult vmaCheckCorruption(VmaAllocator allocator, uint32_t memoryTypeBits);
 
+#if VMA_STATS_STRING_ENABLED
+
+/** \struct VmaStatsSnapshot
+\brief Represents statistics of the allocator captured at some moment, to be compared with another snapshot.
+
+Create it using function vmaCreateStatsSnapshot(), compare two snapshots using vmaCompareStatsSnapshots()
+and destroy it using vmaDestroyStatsSnapshot().
+*/
+VK_DEFINE_HANDLE(VmaStatsSnapshot)
+
+/// Flags to be passed to vmaCreateStatsSnapshot().
+typedef enum VmaStatsSnapshotCreateFlagBits {
+    /** \brief Capture also every single allocation.
+
+    Without this flag the snapshot contains only statistics of pools, memory types and memory blocks,
+    so it is small and fast to create. With this flag, vmaCompareStatsSnapshots() can also report
+    allocations that were added and removed, but the snapshot takes memory proportional to the
+    number of allocations.
+    */
+    VMA_STATS_SNAPSHOT_CREATE_ALLOCATIONS_BIT = 0x00000001,
+
+    VMA_STATS_SNAPSHOT_CREATE_FLAG_BITS_MAX_ENUM = 0x7FFFFFFF
+} VmaStatsSnapshotCreateFlagBits;
+typedef VkFlags VmaStatsSnapshotCreateFlags;
+
+/** \brief Captures statistics of the allocator.
+
+\param allocator
+\param flags Use #VmaStatsSnapshotCreateFlagBits enum.
+\param[out] pSnapshot Handle to created snapshot. Must be destroyed using vmaDestroyStatsSnapshot().
+
+All pools are locked for reading only while they are being captured, one at a time,
+so snapshot of the allocator used by other threads doesn't need to represent a single moment.
+*/
+VkResult vmaCreateStatsSnapshot(
+    VmaAllocator allocator,
+    VmaStatsSnapshotCreateFlags flags,
+    VmaStatsSnapshot* pSnapshot);
+
+/// Destroys snapshot created with vmaCreateStatsSnapshot().
+void vmaDestroyStatsSnapshot(
+    VmaAllocator allocator,
+    VmaStatsSnapshot snapshot);
+
+/// Difference of statistics of a pool or memory type between two snapshots, calculated as `after - before`.
+typedef struct VmaStatsDelta {
+    /// Difference of number of `VkDeviceMemory` blocks, including dedicated allocations.
+    int64_t blockCount;
+    /// Difference of number of allocations.
+    int64_t allocationCount;
+    /// Difference of number of bytes occupied by allocations.
+    int64_t usedBytes;
+    /// Difference of number of bytes allocated from Vulkan but not occupied by any allocation.
+    int64_t unusedBytes;
+} VmaStatsDelta;
+
+/// Change of a single pool between two snapshots, returned in VmaStatsSnapshotDiff::pPools.
+typedef struct VmaPoolStatsDelta {
+    /// Memory type index of the pool.
+    uint32_t memoryTypeIndex;
+    /// `VK_TRUE` for custom pool, `VK_FALSE` for default pool of the memory type, which doesn't include dedicated allocations.
+    VkBool32 isCustomPool;
+    /// ID of the custom pool, same as in JSON dump. 0 for default pools.
+    uint32_t poolId;
+    /// Change of statistics of the pool. For pool created or destroyed between the snapshots it contains its statistics from the one where it exists.
+    VmaStatsDelta delta;
+} VmaPoolStatsDelta;
+
+/// Memory block of a pool, as captured in a snapshot.
+typedef struct VmaBlockSnapshot {
+    /// Memory type index of the pool.
+    uint32_t memoryTypeIndex;
+    /// `VK_TRUE` if the block belongs to a custom pool, `VK_FALSE` for default pool of the memory type.
+    VkBool32 isCustomPool;
+    /// ID of the custom pool, same as in JSON dump. 0 for default pools.
+    uint32_t poolId;
+    /// ID of the block, unique within its pool, same as in JSON dump.
+    uint32_t blockId;
+    /// Size of the block, in bytes.
+    VkDeviceSize size;
+    /// Number of allocations in the block.
+    uint32_t allocationCount;
+    /// Number of bytes occupied by allocations.
+    VkDeviceSize usedBytes;
+} VmaBlockSnapshot;
+
+/// Allocation as captured in a snapshot.
+typedef struct VmaAllocationSnapshot {
+    /** \brief Handle to the allocation.
+
+    Null for allocations made with vmaAllocateMemoryWithoutHandle().
+    The allocation may have been freed since the snapshot was made, so the handle must not be used
+    unless you know it is still alive, e.g. when it comes from VmaStatsSnapshotDiff::pAddedAllocations
+    and `after` snapshot represents current state.
+    */
+    VmaAllocation allocation;
+    /// Memory type index of the allocation.
+    uint32_t memoryTypeIndex;
+    /// Frame index at the moment the allocation was made.
+    uint32_t creationFrameIndex;
+    /// `VkDeviceMemory` block the allocation was made from, or its own one for dedicated allocation.
+    VkDeviceMemory deviceMemory;
+    /// Offset of the allocation in `deviceMemory`, in bytes.
+    VkDeviceSize offset;
+    /// Size of the allocation, in bytes.
+    VkDeviceSize size;
+} VmaAllocationSnapshot;
+
+/** \brief Difference between two snapshots, returned by vmaCompareStatsSnapshots().
+
+Must be freed using vmaFreeStatsSnapshotDiff().
+*/
+typedef struct VmaStatsSnapshotDiff {
+    /// Change of statistics of the whole allocator, including dedicated allocations.
+    VmaStatsDelta total;
+    /// Change of statistics of each memory type, including dedicated allocations.
+    VmaStatsDelta memoryType[VK_MAX_MEMORY_TYPES];
+    /// Number of elements in `pPools`.
+    uint32_t poolCount;
+    /** \brief Pools whose statistics changed, including pools created or destroyed between the snapshots.
+
+    Default pools come first, sorted by memory type index, followed by custom pools, sorted by ID.
+    */
+    const VmaPoolStatsDelta* pPools;
+    /// Number of elements in `pCreatedBlocks`.
+    uint32_t createdBlockCount;
+    /// Memory blocks of pools that exist only in `after` snapshot, sorted by pool and ID.
+    const VmaBlockSnapshot* pCreatedBlocks;
+    /// Number of elements in `pDestroyedBlocks`.
+    uint32_t destroyedBlockCount;
+    /// Memory blocks of pools that exist only in `before` snapshot, sorted by pool and ID.
+    const VmaBlockSnapshot* pDestroyedBlocks;
+    /// Number of elements in `pChangedBlocks`.
+    uint32_t changedBlockCount;
+    /// Memory blocks that exist in both snapshots but their allocations changed, as captured in `after` snapshot, sorted by pool and ID.
+    const VmaBlockSnapshot* pChangedBlocks;
+    /// Number of elements in `pAddedAllocations`.
+    size_t addedAllocationCount;
+    /** \brief Allocations that exist only in `after` snapshot.
+
+    Empty unless both snapshots were created with #VMA_STATS_SNAPSHOT_CREATE_ALLOCATIONS_BIT.
+    Allocation moved by defragmentation is reported as removed and added.
+    */
+    const VmaAllocationSnapshot* pAddedAllocations;
+    /// Number of elements in `pRemovedAllocations`.
+    size_t removedAllocationCount;
+    /// Allocations that exist only in `before` snapshot. Empty unless both snapshots were created with #VMA_STATS_SNAPSHOT_CREATE_ALLOCATIONS_BIT.
+    const VmaAllocationSnapshot* pRemovedAllocations;
+} VmaStatsSnapshotDiff;
+
+/** \brief Calculates difference between two snapshots of the same allocator.
+
+\param allocator
+\param before Snapshot made earlier.
+\param after Snapshot made later.
+\param[out] pDiff Must be freed using vmaFreeStatsSnapshotDiff().
+
+Both snapshots are kept sorted, so the difference is calculated by merging them in linear time,
+even for millions of allocations.
+*/
+VkResult vmaCompareStatsSnapshots(
+    VmaAllocator allocator,
+    VmaStatsSnapshot before,
+    VmaStatsSnapshot after,
+    VmaStatsSnapshotDiff* pDiff);
+
+/// Frees arrays returned in `pDiff` by vmaCompareStatsSnapshots().
+void vmaFreeStatsSnapshotDiff(
+    VmaAllocator allocator,
+    VmaStatsSnapshotDiff* pDiff);
+
+#endif // #if VMA_STATS_STRING_ENABLED
+
 /** \struct VmaDefragmentationContext
 \brief Represents Opaque object that represents started defragmentation process.
 
@@ -2848,8 +3696,21 @@ Call function vmaDefragmentationEnd() to destroy it.
 */
 VK_DEFINE_HANDLE(VmaDefragmentationContext)
 
-/// Flags to be used in vmaDefragmentationBegin(). None at the moment. Reserved for future use.
+/// Flags to be used in vmaDefragmentationBegin().
 typedef enum VmaDefragmentationFlagBits {
+    /** \brief Use best-fit defragmentation algorithm.
+
+    Keeps a single index of free ranges of all memory blocks of a pool, sorted by size,
+    and moves each allocation, starting from the most "source" ones, to the smallest
+    free range where it fits, found with binary search. Updating that index after each move
+    is linear in the number of free ranges, so the algorithm is not O(n log n), but it is
+    still faster than the default algorithm when there are many allocations and many small
+    free ranges, and it usually leaves less fragmented memory.
+
+    When not specified, the default algorithm is chosen automatically.
+    */
+    VMA_DEFRAGMENTATION_BEST_FIT_ALGORITHM_BIT = 0x00000001,
+
     VMA_DEFRAGMENTATION_FLAG_BITS_MAX_ENUM = 0x7FFFFFFF
 } VmaDefragmentationFlagBits;
 typedef VkFlags VmaDefragmentationFlags;
@@ -2859,7 +3720,7 @@ typedef VkFlags VmaDefragmentationFlags;
 To be used with function vmaDefragmentationBegin().
 */
 typedef struct VmaDefragmentationInfo2 {
-    /** \brief Reserved for future use. Should be 0.
+    /** \brief Use combination of #VmaDefragmentationFlagBits.
     */
     VmaDefragmentationFlags flags;
     /** \brief Number of allocations in `pAllocations` array.
@@ -2959,6 +3820,27 @@ typedef struct VmaDefragmentationStats {
     uint32_t deviceMemoryBlocksFreed;
 } VmaDefragmentationStats;
 
+/** \brief Projected results of defragmentation, returned by function vmaEstimateDefragmentation().
+
+Fragmentation is a number in range 0..1 calculated over all memory pools affected by defragmentation
+as number of free bytes that are outside of the largest free range of their pool,
+divided by the total number of free bytes. 0 means all free space of each pool is continuous.
+*/
+typedef struct VmaDefragmentationEstimate {
+    /// Total number of bytes that would be copied while moving allocations to different places.
+    VkDeviceSize bytesMoved;
+    /// Total number of bytes that would be released to the system by freeing empty `VkDeviceMemory` objects.
+    VkDeviceSize bytesFreed;
+    /// Number of allocations that would be moved to different places.
+    uint32_t allocationsMoved;
+    /// Number of empty `VkDeviceMemory` objects that would be released to the system.
+    uint32_t deviceMemoryBlocksFreed;
+    /// Fragmentation of affected memory pools before defragmentation.
+    float fragmentationBefore;
+    /// Projected fragmentation of affected memory pools after defragmentation.
+    float fragmentationAfter;
+} VmaDefragmentationEstimate;
+
 /** \brief Begins defragmentation process.
 
 @param allocator Allocator object.
@@ -3003,31 +3885,184 @@ VkResult vmaDefragmentationEnd(
     VmaAllocator allocator,
     VmaDefragmentationContext context);
 
-/** \brief Deprecated. Compacts memory by moving allocations.
+/** \brief Calculates projected results of defragmentation without performing it.
 
-@param pAllocations Array of allocations that can be moved during this compation.
-@param allocationCount Number of elements in pAllocations and pAllocationsChanged arrays.
-@param[out] pAllocationsChanged Array of boolean values that will indicate whether matching allocation in pAllocations array has been moved. This parameter is optional. Pass null if you don't need this information.
-@param pDefragmentationInfo Configuration parameters. Optional - pass null to use default values.
-@param[out] pDefragmentationStats Statistics returned by the function. Optional - pass null if you don't need this information.
-@return `VK_SUCCESS` if completed, negative error code in case of error.
+@param allocator Allocator object.
+@param pInfo Structure filled with parameters of defragmentation, same as for vmaDefragmentationBegin().
+@param[out] pEstimate Projected statistics of defragmentation.
 
-\deprecated This is a part of the old interface. It is recommended to use structure #VmaDefragmentationInfo2 and function vmaDefragmentationBegin() instead.
+Runs the same defragmentation algorithm as vmaDefragmentationBegin() would, but on temporary
+copies of metadata of affected memory blocks. No allocations are changed, no memory is mapped
+or copied, and `pInfo->pAllocationsChanged` is not written.
+`pInfo->commandBuffer` is not used, except that null means only CPU defragmentation is considered.
 
-This function works by moving allocations to different places (different
-`VkDeviceMemory` objects and/or different offsets) in order to optimize memory
-usage. Only allocations that are in `pAllocations` array can be moved. All other
-allocations are considered nonmovable in this call. Basic rules:
+Memory blocks affected by the estimate are locked for reading only, so other threads can
+still use allocations from them, but cannot make or free allocations there in the meantime.
+*/
+VkResult vmaEstimateDefragmentation(
+    VmaAllocator allocator,
+    const VmaDefragmentationInfo2* pInfo,
+    VmaDefragmentationEstimate* pEstimate);
 
-- Only allocations made in memory types that have
-  `VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT` and `VK_MEMORY_PROPERTY_HOST_COHERENT_BIT`
-  flags can be compacted. You may pass other allocations but it makes no sense -
-  these will never be moved.
-- Custom pools created with #VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT or
-  #VMA_POOL_CREATE_BUDDY_ALGORITHM_BIT flag are not defragmented. Allocations
-  passed to this function that come from such pools are ignored.
-- Allocations created with #VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT or
-  created as dedicated allocations for any other reason are also ignored.
+/** \brief Current fragmentation of a single pool, returned by vmaGetPoolFragmentationScore() and vmaGetMemoryTypeFragmentationScore().
+
+The score is maintained incrementally by every allocation and deallocation, so querying it is cheap
+and can be done every frame, e.g. to draw it on a graph.
+*/
+typedef struct VmaFragmentationScore {
+    /** \brief Number in range 0..1 calculated as 1 - `unusedRangeSizeMax` / `unusedBytes`.
+
+    0 means all free space of the pool is continuous, or there is no free space.
+    Values close to 1 mean that free space is scattered in many small ranges.
+    */
+    float fragmentation;
+    /** \brief Standard deviation of utilization of memory blocks of the pool, in range 0..0.5.
+
+    Utilization of a block is the number of its used bytes divided by its size.
+    High values mean that some blocks are almost full while others are almost empty,
+    so defragmentation could probably release some of them.
+    */
+    float blockUtilizationSpread;
+    /// Total number of free bytes in all memory blocks of the pool.
+    VkDeviceSize unusedBytes;
+    /// Size of the largest continuous free range in any memory block of the pool.
+    VkDeviceSize unusedRangeSizeMax;
+    /// Number of `VkDeviceMemory` blocks allocated for the pool.
+    size_t blockCount;
+} VmaFragmentationScore;
+
+/** \brief Retrieves current fragmentation score of a custom pool.
+
+@param allocator Allocator object.
+@param pool Pool object.
+@param[out] pScore Current fragmentation score of the pool.
+*/
+void vmaGetPoolFragmentationScore(
+    VmaAllocator allocator,
+    VmaPool pool,
+    VmaFragmentationScore* pScore);
+
+/** \brief Retrieves current fragmentation score of the default pool of given memory type.
+
+@param allocator Allocator object.
+@param memoryTypeIndex Index of the memory type.
+@param[out] pScore Current fragmentation score of allocations made outside of custom pools in this memory type.
+
+Dedicated allocations are not included.
+*/
+void vmaGetMemoryTypeFragmentationScore(
+    VmaAllocator allocator,
+    uint32_t memoryTypeIndex,
+    VmaFragmentationScore* pScore);
+
+/** \brief Callback function called after automatic defragmentation of a pool moved some allocations.
+
+@param allocator Allocator object.
+@param pool Pool that has been defragmented.
+@param allocationCount Number of elements in `pAllocations` array.
+@param pAllocations Allocations that have been moved. Each one occurs only once.
+@param pUserData Value of VmaAutoDefragmentationPolicy::pUserData.
+
+Called from inside vmaSetCurrentFrameIndex(). Data of the allocations has already been copied
+to their new places. You need to destroy buffers and images bound to them, create them
+again and bind them to their new memory using vmaBindBufferMemory() or vmaBindImageMemory().
+
+The callback is called while the list of pools is locked, so it must not create or destroy pools
+or call vmaSetCurrentFrameIndex(), vmaCalculateStats(), vmaBuildStatsString(), vmaCheckCorruption().
+When `VMA_DEBUG_GLOBAL_MUTEX` is enabled, it must not call any functions of the library.
+*/
+typedef void (VKAPI_PTR *PFN_vmaAllocationsMovedFunction)(
+    VmaAllocator      allocator,
+    VmaPool           pool,
+    uint32_t          allocationCount,
+    const VmaAllocation* pAllocations,
+    void*             pUserData);
+
+/** \brief Parameters of automatic defragmentation of a custom pool, to be used with vmaSetPoolAutoDefragmentationPolicy().
+*/
+typedef struct VmaAutoDefragmentationPolicy {
+    /** \brief Value of VmaFragmentationScore::fragmentation considered too high.
+
+    0 means this criterion is not used.
+    */
+    float fragmentationThreshold;
+    /** \brief Value of VmaFragmentationScore::blockUtilizationSpread considered too high.
+
+    0 means this criterion is not used.
+    */
+    float blockUtilizationSpreadThreshold;
+    /** \brief Number of consecutive frames the score must exceed any of the thresholds before defragmentation is performed.
+
+    Frames are counted by calls to vmaSetCurrentFrameIndex(). 0 is treated as 1.
+    */
+    uint32_t frameCount;
+    /// Use combination of #VmaDefragmentationFlagBits.
+    VmaDefragmentationFlags flags;
+    /** \brief Maximum number of bytes that can be copied by a single automatic defragmentation.
+
+    `VK_WHOLE_SIZE` means no limit.
+    */
+    VkDeviceSize maxBytesToMove;
+    /** \brief Maximum number of allocations that can be moved by a single automatic defragmentation.
+
+    `UINT32_MAX` means no limit.
+    */
+    uint32_t maxAllocationsToMove;
+    /// Optional. Called when some allocations have been moved.
+    PFN_vmaAllocationsMovedFunction pfnAllocationsMoved;
+    /// Optional. Passed to `pfnAllocationsMoved`.
+    void* pUserData;
+} VmaAutoDefragmentationPolicy;
+
+/** \brief Enables or disables automatic defragmentation of a custom pool.
+
+@param allocator Allocator object.
+@param pool Pool object.
+@param pPolicy Parameters of automatic defragmentation. Pass null to disable it.
+
+When enabled, every call to vmaSetCurrentFrameIndex() checks fragmentation score of the pool.
+When it exceeds any of the thresholds for `pPolicy->frameCount` consecutive frames,
+defragmentation of the whole pool is performed on CPU within given limits and the frame counter starts from 0 again.
+
+Only pools in memory types that have `VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT` and
+`VK_MEMORY_PROPERTY_HOST_COHERENT_BIT` flags are defragmented. For other pools,
+you can check the score yourself and use vmaDefragmentationBegin() with a command buffer.
+Automatic defragmentation is skipped for a frame when the pool is in the middle of
+defragmentation started with vmaDefragmentationBegin().
+
+All allocations in the pool must be safe to move at any call to vmaSetCurrentFrameIndex(),
+so the pool should contain only resources that you can recreate in `pPolicy->pfnAllocationsMoved`.
+*/
+void vmaSetPoolAutoDefragmentationPolicy(
+    VmaAllocator allocator,
+    VmaPool pool,
+    const VmaAutoDefragmentationPolicy* pPolicy);
+
+/** \brief Deprecated. Compacts memory by moving allocations.
+
+@param pAllocations Array of allocations that can be moved during this compation.
+@param allocationCount Number of elements in pAllocations and pAllocationsChanged arrays.
+@param[out] pAllocationsChanged Array of boolean values that will indicate whether matching allocation in pAllocations array has been moved. This parameter is optional. Pass null if you don't need this information.
+@param pDefragmentationInfo Configuration parameters. Optional - pass null to use default values.
+@param[out] pDefragmentationStats Statistics returned by the function. Optional - pass null if you don't need this information.
+@return `VK_SUCCESS` if completed, negative error code in case of error.
+
+\deprecated This is a part of the old interface. It is recommended to use structure #VmaDefragmentationInfo2 and function vmaDefragmentationBegin() instead.
+
+This function works by moving allocations to different places (different
+`VkDeviceMemory` objects and/or different offsets) in order to optimize memory
+usage. Only allocations that are in `pAllocations` array can be moved. All other
+allocations are considered nonmovable in this call. Basic rules:
+
+- Only allocations made in memory types that have
+  `VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT` and `VK_MEMORY_PROPERTY_HOST_COHERENT_BIT`
+  flags can be compacted. You may pass other allocations but it makes no sense -
+  these will never be moved.
+- Custom pools created with #VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT or
+  #VMA_POOL_CREATE_BUDDY_ALGORITHM_BIT flag are defragmented with algorithms
+  specific to them. See [Additional notes](@ref defragmentation_additional_notes).
+- Allocations created with #VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT or
+  created as dedicated allocations for any other reason are also ignored.
 - Both allocations made with or without #VMA_ALLOCATION_CREATE_MAPPED_BIT
   flag can be compacted. If not persistently mapped, memory will be mapped
   temporarily inside this function if needed.
@@ -3211,6 +4246,7 @@ void vmaDestroyImage(
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <cstdio> // for snprintf, fwrite
 
 /*******************************************************************************
 CONFIGURATION SECTION
@@ -3283,8 +4319,13 @@ remove them if not needed.
 */
 #include <cassert> // for assert
 #include <algorithm> // for min, max
+#include <cmath> // for sqrt
 #include <mutex>
 
+#if defined(_MSC_VER)
+    #include <intrin.h> // for _BitScanForward, _BitScanReverse
+#endif
+
 #ifndef VMA_NULL
    // Value used as null pointer. Define it to e.g.: nullptr, NULL, 0, (void*)0.
    #define VMA_NULL   nullptr
@@ -3410,6 +4451,7 @@ void *aligned_alloc(size_t alignment, size_t size)
     {
     public:
         void Lock() { m_Mutex.lock(); }
+        bool TryLock() { return m_Mutex.try_lock(); }
         void Unlock() { m_Mutex.unlock(); }
     private:
         std::mutex m_Mutex;
@@ -3428,6 +4470,7 @@ void *aligned_alloc(size_t alignment, size_t size)
             void LockRead() { m_Mutex.lock_shared(); }
             void UnlockRead() { m_Mutex.unlock_shared(); }
             void LockWrite() { m_Mutex.lock(); }
+            bool TryLockWrite() { return m_Mutex.try_lock(); }
             void UnlockWrite() { m_Mutex.unlock(); }
         private:
             std::shared_mutex m_Mutex;
@@ -3443,6 +4486,10 @@ void *aligned_alloc(size_t alignment, size_t size)
             void LockRead() { AcquireSRWLockShared(&m_Lock); }
             void UnlockRead() { ReleaseSRWLockShared(&m_Lock); }
             void LockWrite() { AcquireSRWLockExclusive(&m_Lock); }
+        #if WINVER >= 0x0601
+            // TryAcquireSRWLockExclusive requires Windows 7. Without it, lock contention is not counted.
+            bool TryLockWrite() { return TryAcquireSRWLockExclusive(&m_Lock) != FALSE; }
+        #endif
             void UnlockWrite() { ReleaseSRWLockExclusive(&m_Lock); }
         private:
             SRWLOCK m_Lock;
@@ -3456,6 +4503,10 @@ void *aligned_alloc(size_t alignment, size_t size)
             void LockRead() { m_Mutex.Lock(); }
             void UnlockRead() { m_Mutex.Unlock(); }
             void LockWrite() { m_Mutex.Lock(); }
+            // Template, so that it exists only if VMA_MUTEX provides TryLock().
+            template<typename MutexT = VMA_MUTEX>
+            auto TryLockWrite() -> decltype(static_cast<MutexT*>(VMA_NULL)->TryLock())
+                { return static_cast<MutexT&>(m_Mutex).TryLock(); }
             void UnlockWrite() { m_Mutex.Unlock(); }
         private:
             VMA_MUTEX m_Mutex;
@@ -3471,12 +4522,168 @@ If providing your own implementation, you need to implement a subset of std::ato
 - uint32_t load() const
 - void store(uint32_t desired)
 - bool compare_exchange_weak(uint32_t& expected, uint32_t desired)
+- uint32_t fetch_add(uint32_t arg)
+- uint32_t fetch_sub(uint32_t arg)
 */
 #ifndef VMA_ATOMIC_UINT32
     #include <atomic>
     #define VMA_ATOMIC_UINT32 std::atomic<uint32_t>
 #endif
 
+#ifndef VMA_USE_STL_THREAD
+    /*
+    Used by vmaCalculateStatsParallel() called without a task system to start its
+    own worker threads. Define to 0 if `std::thread` is not available on your
+    platform. All the work is then done on the calling thread.
+    */
+    #define VMA_USE_STL_THREAD 1
+#endif
+
+#if VMA_USE_STL_THREAD
+    #include <thread>
+    #include <atomic>
+#endif
+
+#if VMA_COUNTERS_ENABLED
+    /*
+    Used for counters returned by vmaGetCounters(). If providing your own implementation,
+    you need to implement a subset of std::atomic:
+
+    - Default constructor
+    - void store(uint64_t desired, std::memory_order order)
+    - uint64_t load(std::memory_order order) const
+    - uint64_t fetch_add(uint64_t arg, std::memory_order order)
+
+    Lock contention is counted only if VMA_RW_MUTEX also has method
+    bool TryLockWrite(), returning true if the mutex was locked without waiting.
+    It is optional.
+    */
+    #ifndef VMA_ATOMIC_UINT64
+        #include <atomic>
+        #define VMA_ATOMIC_UINT64 std::atomic<uint64_t>
+    #endif
+
+    /*
+    Define to 1 to count lock contention in VmaCounters::lockContentionCount and
+    lockWaitNanoseconds. Mutexes taken when allocating and freeing memory are then first
+    tried with TryLockWrite(), which is slower than LockWrite() on some platforms.
+    */
+    #ifndef VMA_COUNTERS_LOCK_CONTENTION
+        #define VMA_COUNTERS_LOCK_CONTENTION 0
+    #endif
+    #include <chrono> // for steady_clock
+#endif
+
+#if VMA_RECORDING_ENABLED && !defined(_WIN32)
+    #ifndef VMA_RECORDING_USE_TSC
+        /*
+        Define to 0/1 to disable/enable use of processor time stamp counter for
+        timestamps of recorded calls. It is used only when the processor reports
+        invariant TSC, otherwise `std::chrono::steady_clock` is used. On Windows,
+        QueryPerformanceCounter is always used.
+        */
+        #if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+            #define VMA_RECORDING_USE_TSC 1
+        #else
+            #define VMA_RECORDING_USE_TSC 0
+        #endif
+    #endif
+
+    #ifndef VMA_RECORDING_TSC_CALIBRATION_MILLISECONDS
+        /*
+        Time spent in vmaCreateAllocator() to calibrate time stamp counter against
+        steady clock. Longer time gives more accurate timestamps in long recordings.
+        */
+        #define VMA_RECORDING_TSC_CALIBRATION_MILLISECONDS 10
+    #endif
+
+    #include <chrono>
+    #include <functional> // for std::hash
+    #if defined(__linux__)
+        #include <unistd.h>
+        #include <sys/syscall.h> // for SYS_gettid
+    #endif
+    #if VMA_RECORDING_USE_TSC
+        #include <cpuid.h>
+        #include <x86intrin.h>
+    #endif
+#elif !defined(VMA_RECORDING_USE_TSC)
+    #define VMA_RECORDING_USE_TSC 0
+#endif
+
+#if VMA_RECORDING_ENABLED
+    #ifndef VMA_RECORDING_BINARY_THREAD_BUFFER_SIZE
+        /*
+        Size of the buffer that every thread making calls gets with
+        VMA_RECORD_BINARY_FORMAT_BIT. When it gets full before the background
+        thread writes it, the calling thread writes it to the file itself.
+        */
+        #define VMA_RECORDING_BINARY_THREAD_BUFFER_SIZE (64 * 1024)
+    #endif
+
+    #ifndef VMA_RECORDING_BINARY_WRITE_INTERVAL_MILLISECONDS
+        /*
+        Maximum time between two writes of buffers to the file done by the
+        background thread with VMA_RECORD_BINARY_FORMAT_BIT. Also used by the
+        thread compressing the recording with VMA_RECORD_COMPRESS_BIT.
+        */
+        #define VMA_RECORDING_BINARY_WRITE_INTERVAL_MILLISECONDS 10
+    #endif
+
+    #ifndef VMA_RECORDING_FLIGHT_RECORDER_BUFFER_SIZE
+        /*
+        Default size of the ring buffer of every thread with
+        VMA_RECORD_FLIGHT_RECORDER_BIT, when VmaRecordSettings::flightRecorderBufferSize is 0.
+        */
+        #define VMA_RECORDING_FLIGHT_RECORDER_BUFFER_SIZE (1024 * 1024)
+    #endif
+
+    #ifndef VMA_RECORDING_FLIGHT_RECORDER_EXITED_THREAD_BUFFER_COUNT
+        /*
+        Maximum number of ring buffers of threads that have exited, kept with
+        VMA_RECORD_FLIGHT_RECORDER_BIT so that their calls still get to the dump.
+        When there are more, the one with the oldest calls is freed and the dump
+        starts after them, like when a ring buffer is overwritten.
+        */
+        #define VMA_RECORDING_FLIGHT_RECORDER_EXITED_THREAD_BUFFER_COUNT 4
+    #endif
+
+    #ifndef VMA_RECORDING_COMPRESSION
+        /*
+        Define this macro to 1 to make VMA_RECORD_COMPRESS_BIT available.
+        It requires zlib: <zlib.h> is then included and your program must link with it.
+        */
+        #define VMA_RECORDING_COMPRESSION 0
+    #endif
+
+    #include <cstdarg> // for va_list
+    #include <atomic>
+    #include <condition_variable>
+    #include <thread>
+#elif !defined(VMA_RECORDING_COMPRESSION)
+    #define VMA_RECORDING_COMPRESSION 0
+#endif
+
+#if VMA_RECORDING_COMPRESSION
+    #ifndef VMA_RECORDING_COMPRESSION_BUFFER_SIZE
+        /*
+        Size of the buffer where output of the recording is collected with
+        VMA_RECORD_COMPRESS_BIT before the background thread compresses it.
+        When it gets full before that, calls made to the allocator wait.
+        */
+        #define VMA_RECORDING_COMPRESSION_BUFFER_SIZE (1024 * 1024)
+    #endif
+
+    #ifndef VMA_RECORDING_COMPRESSION_LEVEL
+        /*
+        Compression level passed to zlib, from 1 (fastest) to 9 (smallest file).
+        */
+        #define VMA_RECORDING_COMPRESSION_LEVEL 1
+    #endif
+
+    #include <zlib.h>
+#endif
+
 #ifndef VMA_DEBUG_ALWAYS_DEDICATED_MEMORY
     /**
     Every allocation will have its own memory block.
@@ -3579,6 +4786,68 @@ static inline uint32_t VmaCountBitsSet(uint32_t v)
 	return c;
 }
 
+// Returns index of the lowest bit set to 1 in (mask), or UINT32_MAX if mask is 0.
+static inline uint32_t VmaBitScanLSB(uint32_t mask)
+{
+#if defined(_MSC_VER)
+    unsigned long pos;
+    if(_BitScanForward(&pos, mask))
+        return (uint32_t)pos;
+    return UINT32_MAX;
+#elif defined(__GNUC__) || defined(__clang__)
+    return mask != 0 ? (uint32_t)__builtin_ctz(mask) : UINT32_MAX;
+#else
+    for(uint32_t pos = 0; pos < 32; ++pos)
+    {
+        if(mask & (1u << pos))
+            return pos;
+    }
+    return UINT32_MAX;
+#endif
+}
+
+// Returns index of the highest bit set to 1 in (mask), or UINT32_MAX if mask is 0.
+static inline uint32_t VmaBitScanMSB(uint32_t mask)
+{
+#if defined(_MSC_VER)
+    unsigned long pos;
+    if(_BitScanReverse(&pos, mask))
+        return (uint32_t)pos;
+    return UINT32_MAX;
+#elif defined(__GNUC__) || defined(__clang__)
+    return mask != 0 ? 31u - (uint32_t)__builtin_clz(mask) : UINT32_MAX;
+#else
+    for(uint32_t pos = 32; pos--; )
+    {
+        if(mask & (1u << pos))
+            return pos;
+    }
+    return UINT32_MAX;
+#endif
+}
+
+// Returns index of bucket in VmaAllocationHistograms::allocationSize for given allocation size.
+static inline uint32_t VmaSizeHistogramBucket(VkDeviceSize size)
+{
+    const uint32_t sizeHi = (uint32_t)(size >> 32);
+    if(sizeHi != 0)
+    {
+        return 32 + VmaBitScanMSB(sizeHi);
+    }
+    return size != 0 ? VmaBitScanMSB((uint32_t)size) : 0;
+}
+
+// Returns index of bucket in VmaAllocationHistograms::allocationLifetime for allocation freed in currentFrameIndex.
+static inline uint32_t VmaLifetimeHistogramBucket(uint32_t creationFrameIndex, uint32_t currentFrameIndex)
+{
+    // Frame index may have been set back by the user.
+    if(currentFrameIndex <= creationFrameIndex)
+    {
+        return 0;
+    }
+    return VmaBitScanMSB(currentFrameIndex - creationFrameIndex) + 1;
+}
+
 // Aligns given value up to nearest multiply of align value. For example: VmaAlignUp(11, 8) = 16.
 // Use types like uint32_t, uint64_t as T.
 template <typename T>
@@ -3840,83 +5109,350 @@ static void VmaFillGpuDefragmentationBufferCreateInfo(VkBufferCreateInfo& outBuf
     outBufCreateInfo.size = (VkDeviceSize)VMA_DEFAULT_LARGE_HEAP_BLOCK_SIZE; // Example size.
 }
 
-// Helper RAII class to lock a mutex in constructor and unlock it in destructor (at the end of scope).
-struct VmaMutexLock
+#if VMA_COUNTERS_ENABLED && VMA_COUNTERS_LOCK_CONTENTION
+// Has member value = true if mutex type T provides method TryLockWrite().
+template<typename T>
+struct VmaHasTryLockWrite
 {
-    VMA_CLASS_NO_COPY(VmaMutexLock)
-public:
-    VmaMutexLock(VMA_MUTEX& mutex, bool useMutex = true) :
-        m_pMutex(useMutex ? &mutex : VMA_NULL)
-    { if(m_pMutex) { m_pMutex->Lock(); } }
-    ~VmaMutexLock()
-    { if(m_pMutex) { m_pMutex->Unlock(); } }
-private:
-    VMA_MUTEX* m_pMutex;
+    template<typename U>
+    static char Check(decltype(static_cast<U*>(VMA_NULL)->TryLockWrite())*);
+    template<typename U>
+    static int Check(...);
+    enum { value = sizeof(Check<T>(VMA_NULL)) == sizeof(char) };
 };
 
-// Helper RAII class to lock a RW mutex in constructor and unlock it in destructor (at the end of scope), for reading.
-struct VmaMutexLockRead
-{
-    VMA_CLASS_NO_COPY(VmaMutexLockRead)
-public:
-    VmaMutexLockRead(VMA_RW_MUTEX& mutex, bool useMutex) :
-        m_pMutex(useMutex ? &mutex : VMA_NULL)
-    { if(m_pMutex) { m_pMutex->LockRead(); } }
-    ~VmaMutexLockRead() { if(m_pMutex) { m_pMutex->UnlockRead(); } }
-private:
-    VMA_RW_MUTEX* m_pMutex;
-};
+template<bool B> struct VmaBoolTag { };
+#endif // #if VMA_COUNTERS_ENABLED && VMA_COUNTERS_LOCK_CONTENTION
 
-// Helper RAII class to lock a RW mutex in constructor and unlock it in destructor (at the end of scope), for writing.
-struct VmaMutexLockWrite
+/*
+Cumulative counters returned by vmaGetCounters(). Reading them never blocks the allocator.
+With VMA_COUNTERS_ENABLED defined to 0 all methods do nothing, so they can be called
+unconditionally.
+
+Values are split into shards, each on its own cache lines. A thread takes ownership of
+one shard on its first use of any counter and gives it back when it exits. Shard with
+given index is owned by the same thread in all allocators. Only the owner writes to its
+shard, so it increments values with plain relaxed load and store instead of atomic
+read-modify-write, and threads allocating at the same time never touch the same cache
+line. When all shards are taken, remaining threads share the last one and use atomic
+fetch_add. Shards are summed when reading.
+*/
+class VmaAllocatorCounters
 {
-    VMA_CLASS_NO_COPY(VmaMutexLockWrite)
+    VMA_CLASS_NO_COPY(VmaAllocatorCounters)
 public:
-    VmaMutexLockWrite(VMA_RW_MUTEX& mutex, bool useMutex) :
-        m_pMutex(useMutex ? &mutex : VMA_NULL)
-    { if(m_pMutex) { m_pMutex->LockWrite(); } }
-    ~VmaMutexLockWrite() { if(m_pMutex) { m_pMutex->UnlockWrite(); } }
-private:
-    VMA_RW_MUTEX* m_pMutex;
-};
-
-#if VMA_DEBUG_GLOBAL_MUTEX
-    static VMA_MUTEX gDebugGlobalMutex;
-    #define VMA_DEBUG_GLOBAL_MUTEX_LOCK VmaMutexLock debugGlobalMutexLock(gDebugGlobalMutex, true);
-#else
-    #define VMA_DEBUG_GLOBAL_MUTEX_LOCK
-#endif
+    enum COUNTER
+    {
+        COUNTER_ALLOCATION_COUNT,
+        COUNTER_ALLOCATION_BYTES,
+        COUNTER_ALLOCATION_FAILURE_COUNT,
+        COUNTER_FREE_COUNT,
+        COUNTER_FREE_BYTES,
+        COUNTER_DEDICATED_ALLOCATION_COUNT,
+        COUNTER_DEDICATED_FALLBACK_COUNT,
+        COUNTER_BLOCK_CREATE_COUNT,
+        COUNTER_BLOCK_CREATE_BYTES,
+        COUNTER_MAP_COUNT,
+        COUNTER_UNMAP_COUNT,
+        COUNTER_FLUSH_COUNT,
+        COUNTER_INVALIDATE_COUNT,
+        COUNTER_DEFRAGMENTATION_COUNT,
+        COUNTER_LOCK_CONTENTION_COUNT,
+        COUNTER_LOCK_WAIT_NANOSECONDS,
+        COUNTER_COUNT
+    };
 
-// Minimum size of a free suballocation to register it in the free suballocation collection.
-static const VkDeviceSize VMA_MIN_FREE_SUBALLOCATION_SIZE_TO_REGISTER = 16;
+#if VMA_COUNTERS_ENABLED
+    VmaAllocatorCounters()
+    {
+        for(uint32_t shardIndex = 0; shardIndex < SHARD_COUNT; ++shardIndex)
+        {
+            for(uint32_t i = 0; i < COUNTER_COUNT; ++i)
+            {
+                m_Shards[shardIndex].values[i].store(0, std::memory_order_relaxed);
+            }
+        }
+    }
 
-/*
-Performs binary search and returns iterator to first element that is greater or
-equal to (key), according to comparison (cmp).
+    void Add(COUNTER counter, uint64_t value)
+    {
+        const uint32_t shardIndex = GetCurrentThreadShardIndex();
+        AddToShard(shardIndex, counter, value);
+    }
+    // Same as two calls to Add(), but finds the shard of the current thread only once.
+    void Add(COUNTER counter1, uint64_t value1, COUNTER counter2, uint64_t value2)
+    {
+        const uint32_t shardIndex = GetCurrentThreadShardIndex();
+        AddToShard(shardIndex, counter1, value1);
+        AddToShard(shardIndex, counter2, value2);
+    }
 
-Cmp should return true if first argument is less than second argument.
+    /*
+    Locks the mutex for writing. With VMA_COUNTERS_LOCK_CONTENTION, it is first tried with
+    TryLockWrite() and only when that fails, time spent waiting is measured. If VMA_RW_MUTEX
+    doesn't provide TryLockWrite(), it is just locked and nothing is measured.
+    */
+    void LockWrite(VMA_RW_MUTEX& mutex)
+    {
+#if VMA_COUNTERS_LOCK_CONTENTION
+        LockWriteImpl(mutex, VmaBoolTag<VmaHasTryLockWrite<VMA_RW_MUTEX>::value>());
+#else
+        mutex.LockWrite();
+#endif
+    }
 
-Returned value is the found element, if present in the collection or place where
-new element with value (key) should be inserted.
-*/
-template <typename CmpLess, typename IterT, typename KeyT>
-static IterT VmaBinaryFindFirstNotLess(IterT beg, IterT end, const KeyT &key, const CmpLess& cmp)
-{
-    size_t down = 0, up = (end - beg);
-    while(down < up)
+    uint64_t Get(COUNTER counter) const
     {
-        const size_t mid = (down + up) / 2;
-        if(cmp(*(beg+mid), key))
-        {
-            down = mid + 1;
-        }
-        else
+        uint64_t sum = 0;
+        for(uint32_t shardIndex = 0; shardIndex < SHARD_COUNT; ++shardIndex)
         {
-            up = mid;
+            sum += m_Shards[shardIndex].values[counter].load(std::memory_order_relaxed);
         }
+        return sum;
     }
-    return beg + down;
-}
+
+    void GetSnapshot(VmaCounters& outCounters) const
+    {
+        outCounters.allocationCount = Get(COUNTER_ALLOCATION_COUNT);
+        outCounters.allocationBytes = Get(COUNTER_ALLOCATION_BYTES);
+        outCounters.allocationFailureCount = Get(COUNTER_ALLOCATION_FAILURE_COUNT);
+        outCounters.freeCount = Get(COUNTER_FREE_COUNT);
+        outCounters.freeBytes = Get(COUNTER_FREE_BYTES);
+        outCounters.dedicatedAllocationCount = Get(COUNTER_DEDICATED_ALLOCATION_COUNT);
+        outCounters.dedicatedFallbackCount = Get(COUNTER_DEDICATED_FALLBACK_COUNT);
+        outCounters.blockCreateCount = Get(COUNTER_BLOCK_CREATE_COUNT);
+        outCounters.blockCreateBytes = Get(COUNTER_BLOCK_CREATE_BYTES);
+        outCounters.mapCount = Get(COUNTER_MAP_COUNT);
+        outCounters.unmapCount = Get(COUNTER_UNMAP_COUNT);
+        outCounters.flushCount = Get(COUNTER_FLUSH_COUNT);
+        outCounters.invalidateCount = Get(COUNTER_INVALIDATE_COUNT);
+        outCounters.defragmentationCount = Get(COUNTER_DEFRAGMENTATION_COUNT);
+        outCounters.lockContentionCount = Get(COUNTER_LOCK_CONTENTION_COUNT);
+        outCounters.lockWaitNanoseconds = Get(COUNTER_LOCK_WAIT_NANOSECONDS);
+    }
+
+private:
+    // Number of shards that can be owned by threads. Must not exceed number of bits in uint32_t.
+    enum { OWNED_SHARD_COUNT = 32 };
+    // Shard shared by threads that didn't get their own one.
+    enum { SHARED_SHARD_INDEX = OWNED_SHARD_COUNT };
+    enum { SHARD_COUNT = OWNED_SHARD_COUNT + 1 };
+    // Assumed size of cache line, in bytes.
+    enum { CACHE_LINE_SIZE = 64 };
+
+    struct Shard
+    {
+        VMA_ATOMIC_UINT64 values[COUNTER_COUNT];
+        // So that values of neighboring shards never share a cache line.
+        char padding[CACHE_LINE_SIZE];
+    };
+
+    // Lives in a thread_local variable. Gives the shard back when the thread exits.
+    class ShardOwner
+    {
+        VMA_CLASS_NO_COPY(ShardOwner)
+    public:
+        ShardOwner() : m_ShardIndex(SHARED_SHARD_INDEX) { }
+        ~ShardOwner()
+        {
+            if(m_ShardIndex != SHARED_SHARD_INDEX)
+            {
+                // In case counters are still used by destructors of other thread_local objects.
+                GetCurrentThreadShardIndexRef() = SHARED_SHARD_INDEX;
+                ReleaseShard(m_ShardIndex);
+            }
+        }
+        void SetShardIndex(uint32_t shardIndex) { m_ShardIndex = shardIndex; }
+    private:
+        uint32_t m_ShardIndex;
+    };
+
+    Shard m_Shards[SHARD_COUNT];
+
+    void AddToShard(uint32_t shardIndex, COUNTER counter, uint64_t value)
+    {
+        VMA_ATOMIC_UINT64& shardValue = m_Shards[shardIndex].values[counter];
+        if(shardIndex != SHARED_SHARD_INDEX)
+        {
+            shardValue.store(shardValue.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+        }
+        else
+        {
+            shardValue.fetch_add(value, std::memory_order_relaxed);
+        }
+    }
+
+    static uint32_t& GetCurrentThreadShardIndexRef()
+    {
+        // UINT32_MAX until the first use of counters by the current thread.
+        static thread_local uint32_t shardIndex = UINT32_MAX;
+        return shardIndex;
+    }
+
+    static uint32_t GetCurrentThreadShardIndex()
+    {
+        uint32_t& shardIndex = GetCurrentThreadShardIndexRef();
+        if(shardIndex == UINT32_MAX)
+        {
+            shardIndex = AcquireShard();
+        }
+        return shardIndex;
+    }
+
+    // Bit at index `i` is set when shard `i` is owned by some thread.
+    static VMA_ATOMIC_UINT32& GetOwnedShardMask()
+    {
+        static VMA_ATOMIC_UINT32 ownedShardMask(0);
+        return ownedShardMask;
+    }
+
+    /*
+    Called once per thread. Compare-exchange of the mask also makes values written by
+    the previous owner of the shard visible to the current thread.
+    */
+    static uint32_t AcquireShard()
+    {
+        VMA_ATOMIC_UINT32& ownedShardMask = GetOwnedShardMask();
+        uint32_t mask = ownedShardMask.load();
+        for(;;)
+        {
+            uint32_t shardIndex = 0;
+            while(shardIndex < OWNED_SHARD_COUNT && (mask & (1u << shardIndex)) != 0)
+            {
+                ++shardIndex;
+            }
+            if(shardIndex == OWNED_SHARD_COUNT)
+            {
+                return SHARED_SHARD_INDEX;
+            }
+            if(ownedShardMask.compare_exchange_weak(mask, mask | (1u << shardIndex)))
+            {
+                static thread_local ShardOwner shardOwner;
+                shardOwner.SetShardIndex(shardIndex);
+                return shardIndex;
+            }
+        }
+    }
+
+    static void ReleaseShard(uint32_t shardIndex)
+    {
+        VMA_ATOMIC_UINT32& ownedShardMask = GetOwnedShardMask();
+        uint32_t mask = ownedShardMask.load();
+        while(!ownedShardMask.compare_exchange_weak(mask, mask & ~(1u << shardIndex)))
+        {
+        }
+    }
+
+#if VMA_COUNTERS_LOCK_CONTENTION
+    // Templates, so that TryLockWrite() is not referenced if the mutex doesn't provide it.
+    template<typename MutexT>
+    void LockWriteImpl(MutexT& mutex, VmaBoolTag<true>)
+    {
+        if(!mutex.TryLockWrite())
+        {
+            const std::chrono::steady_clock::time_point waitBegin = std::chrono::steady_clock::now();
+            mutex.LockWrite();
+            const std::chrono::steady_clock::duration waitDuration = std::chrono::steady_clock::now() - waitBegin;
+            Add(
+                COUNTER_LOCK_CONTENTION_COUNT, 1,
+                COUNTER_LOCK_WAIT_NANOSECONDS, (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(waitDuration).count());
+        }
+    }
+    template<typename MutexT>
+    void LockWriteImpl(MutexT& mutex, VmaBoolTag<false>)
+    {
+        mutex.LockWrite();
+    }
+#endif // #if VMA_COUNTERS_LOCK_CONTENTION
+#else
+    VmaAllocatorCounters() { }
+    void Add(COUNTER, uint64_t) { }
+    void Add(COUNTER, uint64_t, COUNTER, uint64_t) { }
+    void LockWrite(VMA_RW_MUTEX& mutex) { mutex.LockWrite(); }
+#endif // #if VMA_COUNTERS_ENABLED
+};
+
+// Helper RAII class to lock a mutex in constructor and unlock it in destructor (at the end of scope).
+struct VmaMutexLock
+{
+    VMA_CLASS_NO_COPY(VmaMutexLock)
+public:
+    VmaMutexLock(VMA_MUTEX& mutex, bool useMutex = true) :
+        m_pMutex(useMutex ? &mutex : VMA_NULL)
+    { if(m_pMutex) { m_pMutex->Lock(); } }
+    ~VmaMutexLock()
+    { if(m_pMutex) { m_pMutex->Unlock(); } }
+private:
+    VMA_MUTEX* m_pMutex;
+};
+
+// Helper RAII class to lock a RW mutex in constructor and unlock it in destructor (at the end of scope), for reading.
+struct VmaMutexLockRead
+{
+    VMA_CLASS_NO_COPY(VmaMutexLockRead)
+public:
+    VmaMutexLockRead(VMA_RW_MUTEX& mutex, bool useMutex) :
+        m_pMutex(useMutex ? &mutex : VMA_NULL)
+    { if(m_pMutex) { m_pMutex->LockRead(); } }
+    ~VmaMutexLockRead() { if(m_pMutex) { m_pMutex->UnlockRead(); } }
+private:
+    VMA_RW_MUTEX* m_pMutex;
+};
+
+// Helper RAII class to lock a RW mutex in constructor and unlock it in destructor (at the end of scope), for writing.
+struct VmaMutexLockWrite
+{
+    VMA_CLASS_NO_COPY(VmaMutexLockWrite)
+public:
+    VmaMutexLockWrite(VMA_RW_MUTEX& mutex, bool useMutex) :
+        m_pMutex(useMutex ? &mutex : VMA_NULL)
+    { if(m_pMutex) { m_pMutex->LockWrite(); } }
+    // Also measures time spent waiting for the mutex, if it is contended.
+    VmaMutexLockWrite(VMA_RW_MUTEX& mutex, bool useMutex, VmaAllocatorCounters& counters) :
+        m_pMutex(useMutex ? &mutex : VMA_NULL)
+    { if(m_pMutex) { counters.LockWrite(*m_pMutex); } }
+    ~VmaMutexLockWrite() { if(m_pMutex) { m_pMutex->UnlockWrite(); } }
+private:
+    VMA_RW_MUTEX* m_pMutex;
+};
+
+#if VMA_DEBUG_GLOBAL_MUTEX
+    static VMA_MUTEX gDebugGlobalMutex;
+    #define VMA_DEBUG_GLOBAL_MUTEX_LOCK VmaMutexLock debugGlobalMutexLock(gDebugGlobalMutex, true);
+#else
+    #define VMA_DEBUG_GLOBAL_MUTEX_LOCK
+#endif
+
+// Minimum size of a free suballocation to register it in the free suballocation collection.
+static const VkDeviceSize VMA_MIN_FREE_SUBALLOCATION_SIZE_TO_REGISTER = 16;
+
+/*
+Performs binary search and returns iterator to first element that is greater or
+equal to (key), according to comparison (cmp).
+
+Cmp should return true if first argument is less than second argument.
+
+Returned value is the found element, if present in the collection or place where
+new element with value (key) should be inserted.
+*/
+template <typename CmpLess, typename IterT, typename KeyT>
+static IterT VmaBinaryFindFirstNotLess(IterT beg, IterT end, const KeyT &key, const CmpLess& cmp)
+{
+    size_t down = 0, up = (end - beg);
+    while(down < up)
+    {
+        const size_t mid = (down + up) / 2;
+        if(cmp(*(beg+mid), key))
+        {
+            down = mid + 1;
+        }
+        else
+        {
+            up = mid;
+        }
+    }
+    return beg + down;
+}
 
 template<typename CmpLess, typename IterT, typename KeyT>
 IterT VmaBinaryFindSorted(const IterT& beg, const IterT& end, const KeyT& value, const CmpLess& cmp)
@@ -4180,7 +5716,7 @@ public:
         
         if(newCapacity != m_Capacity)
         {
-            T* const newArray = newCapacity ? VmaAllocateArray<T>(m_Allocator, newCapacity) : VMA_NULL;
+            T* const newArray = newCapacity ? VmaAllocateArray<T>(m_Allocator.m_pCallbacks, newCapacity) : VMA_NULL;
             if(m_Count != 0)
             {
                 memcpy(newArray, m_pArray, m_Count * sizeof(T));
@@ -4224,6 +5760,15 @@ public:
         resize(0, freeMemory);
     }
 
+    // Both vectors must use the same allocation callbacks.
+    void swap(VmaVector<T, AllocatorT>& rhs)
+    {
+        VMA_HEAVY_ASSERT(m_Allocator == rhs.m_Allocator);
+        VMA_SWAP(m_pArray, rhs.m_pArray);
+        VMA_SWAP(m_Count, rhs.m_Count);
+        VMA_SWAP(m_Capacity, rhs.m_Capacity);
+    }
+
     void insert(size_t index, const T& src)
     {
         VMA_HEAVY_ASSERT(index <= m_Count);
@@ -5066,9 +6611,9 @@ public:
         m_SuballocationType = (uint8_t)VMA_SUBALLOCATION_TYPE_UNKNOWN;
         m_MapCount = 0;
         m_Flags = userDataString ? (uint8_t)FLAG_USER_DATA_STRING : 0;
+        m_CreationFrameIndex = currentFrameIndex;
 
 #if VMA_STATS_STRING_ENABLED
-        m_CreationFrameIndex = currentFrameIndex;
         m_BufferImageUsage = 0;
 #endif
     }
@@ -5195,8 +6740,10 @@ public:
     VkResult DedicatedAllocMap(VmaAllocator hAllocator, void** ppData);
     void DedicatedAllocUnmap(VmaAllocator hAllocator);
 
-#if VMA_STATS_STRING_ENABLED
+    // Used by lifetime histograms of block vectors.
     uint32_t GetCreationFrameIndex() const { return m_CreationFrameIndex; }
+
+#if VMA_STATS_STRING_ENABLED
     uint32_t GetBufferImageUsage() const { return m_BufferImageUsage; }
 
     void InitBufferImageUsage(uint32_t bufferImageUsage)
@@ -5244,8 +6791,8 @@ private:
         DedicatedAllocation m_DedicatedAllocation;
     };
 
-#if VMA_STATS_STRING_ENABLED
     uint32_t m_CreationFrameIndex;
+#if VMA_STATS_STRING_ENABLED
     uint32_t m_BufferImageUsage; // 0 if unknown.
 #endif
 
@@ -5260,8 +6807,11 @@ struct VmaSuballocation
 {
     VkDeviceSize offset;
     VkDeviceSize size;
+    // Null for free space. In linear algorithm also for allocations made without VmaAllocation object.
     VmaAllocation hAllocation;
     VmaSuballocationType type;
+    // Frame index at the time of allocation. Used only by linear algorithm.
+    uint32_t frameIndex;
 };
 
 // Comparator for offsets.
@@ -5323,6 +6873,132 @@ struct VmaAllocationRequest
     }
 };
 
+#if VMA_STATS_STRING_ENABLED
+
+/*
+Receives contents of a single memory block from VmaBlockMetadata::VisitDetailedMap().
+Used to write detailed map, either as JSON or in binary form.
+*/
+class VmaDetailedMapVisitor
+{
+public:
+    virtual ~VmaDetailedMapVisitor() { }
+
+    virtual void BeginBlock(
+        VkDeviceSize blockSize,
+        VkDeviceSize unusedBytes,
+        size_t allocationCount,
+        size_t unusedRangeCount) = 0;
+    virtual void Allocation(
+        VkDeviceSize offset,
+        VmaAllocation hAllocation) = 0;
+    // For allocation without VmaAllocation object.
+    virtual void HandlelessAllocation(
+        const VmaSuballocation& suballoc) = 0;
+    virtual void UnusedRange(
+        VkDeviceSize offset,
+        VkDeviceSize size) = 0;
+    virtual void EndBlock() = 0;
+};
+
+
+/*
+Statistics captured by vmaCreateStatsSnapshot(). All vectors are sorted, so that two
+snapshots can be compared by merging them, in VmaAllocator_T::CompareStatsSnapshots().
+*/
+struct VmaStatsSnapshot_T
+{
+    VMA_CLASS_NO_COPY(VmaStatsSnapshot_T)
+public:
+    const uint32_t m_MemoryTypeCount;
+    const bool m_HasAllocations;
+    // Absolute values, including dedicated allocations.
+    VmaStatsDelta m_MemoryTypes[VK_MAX_MEMORY_TYPES];
+    // Absolute values. Sorted by VmaStatsSnapshotPoolLess.
+    VmaVector< VmaPoolStatsDelta, VmaStlAllocator<VmaPoolStatsDelta> > m_Pools;
+    // Sorted by VmaStatsSnapshotBlockLess.
+    VmaVector< VmaBlockSnapshot, VmaStlAllocator<VmaBlockSnapshot> > m_Blocks;
+    // Sorted by VmaStatsSnapshotAllocationLess.
+    VmaVector< VmaAllocationSnapshot, VmaStlAllocator<VmaAllocationSnapshot> > m_Allocations;
+
+    VmaStatsSnapshot_T(
+        const VkAllocationCallbacks* pAllocationCallbacks,
+        uint32_t memoryTypeCount,
+        bool hasAllocations);
+};
+
+/*
+Fills VmaStatsSnapshot_T. Allocations are reported by blocks in order of increasing
+offset, so they are collected as runs, one per VkDeviceMemory, and only the runs
+need to be sorted in Finish().
+*/
+class VmaStatsSnapshotBuilder : public VmaDetailedMapVisitor
+{
+    VMA_CLASS_NO_COPY(VmaStatsSnapshotBuilder)
+public:
+    VmaStatsSnapshotBuilder(
+        const VkAllocationCallbacks* pAllocationCallbacks,
+        VmaStatsSnapshot_T& snapshot);
+
+    bool CapturesAllocations() const { return m_Snapshot.m_HasAllocations; }
+
+    void AddPool(
+        uint32_t memTypeIndex,
+        bool isCustomPool,
+        uint32_t poolId,
+        const VmaStatsDelta& stats);
+    void AddBlock(const VmaBlockSnapshot& block);
+    void AddDedicatedAllocation(
+        uint32_t memTypeIndex,
+        VmaAllocation hAllocation);
+
+    // Allocations reported to the visitor methods belong to this block, until EndBlock().
+    void SetCurrentBlock(
+        uint32_t memTypeIndex,
+        VkDeviceMemory memory);
+
+    virtual void BeginBlock(
+        VkDeviceSize blockSize,
+        VkDeviceSize unusedBytes,
+        size_t allocationCount,
+        size_t unusedRangeCount);
+    virtual void Allocation(
+        VkDeviceSize offset,
+        VmaAllocation hAllocation);
+    virtual void HandlelessAllocation(
+        const VmaSuballocation& suballoc);
+    virtual void UnusedRange(
+        VkDeviceSize offset,
+        VkDeviceSize size) { }
+    virtual void EndBlock();
+
+    // Sorts everything captured into the snapshot.
+    void Finish();
+
+private:
+    struct AllocationRun
+    {
+        VkDeviceMemory memory;
+        size_t firstIndex;
+        size_t count;
+    };
+
+    const VkAllocationCallbacks* const m_pAllocationCallbacks;
+    VmaStatsSnapshot_T& m_Snapshot;
+    // Allocations are captured directly to m_Snapshot.m_Allocations and reordered in Finish() if needed.
+    VmaVector< AllocationRun, VmaStlAllocator<AllocationRun> > m_Runs;
+    uint32_t m_CurrentMemTypeIndex;
+    VkDeviceMemory m_CurrentMemory;
+
+    void AddAllocation(
+        VmaAllocation hAllocation,
+        VkDeviceSize offset,
+        VkDeviceSize size,
+        uint32_t creationFrameIndex);
+};
+
+#endif // #if VMA_STATS_STRING_ENABLED
+
 /*
 Data structure used for bookkeeping of allocations and unused ranges of memory
 in a single VkDeviceMemory block.
@@ -5348,7 +7024,9 @@ public:
     virtual void AddPoolStats(VmaPoolStats& inoutStats) const = 0;
 
 #if VMA_STATS_STRING_ENABLED
-    virtual void PrintDetailedMap(class VmaJsonWriter& json) const = 0;
+    // Reports all allocations and unused ranges of this block to the visitor, in order of increasing offset.
+    virtual void VisitDetailedMap(class VmaDetailedMapVisitor& visitor) const = 0;
+    void PrintDetailedMap(class VmaJsonWriter& json) const;
 #endif
 
     // Tries to find a place for suballocation with given parameters inside this block.
@@ -5390,19 +7068,6 @@ public:
 protected:
     const VkAllocationCallbacks* GetAllocationCallbacks() const { return m_pAllocationCallbacks; }
 
-#if VMA_STATS_STRING_ENABLED
-    void PrintDetailedMap_Begin(class VmaJsonWriter& json,
-        VkDeviceSize unusedBytes,
-        size_t allocationCount,
-        size_t unusedRangeCount) const;
-    void PrintDetailedMap_Allocation(class VmaJsonWriter& json,
-        VkDeviceSize offset,
-        VmaAllocation hAllocation) const;
-    void PrintDetailedMap_UnusedRange(class VmaJsonWriter& json,
-        VkDeviceSize offset,
-        VkDeviceSize size) const;
-    void PrintDetailedMap_End(class VmaJsonWriter& json) const;
-#endif
 
 private:
     VkDeviceSize m_Size;
@@ -5432,7 +7097,7 @@ public:
     virtual void AddPoolStats(VmaPoolStats& inoutStats) const;
 
 #if VMA_STATS_STRING_ENABLED
-    virtual void PrintDetailedMap(class VmaJsonWriter& json) const;
+    virtual void VisitDetailedMap(class VmaDetailedMapVisitor& visitor) const;
 #endif
 
     virtual bool CreateAllocationRequest(
@@ -5472,10 +7137,19 @@ public:
         VkDeviceSize bufferImageGranularity,
         VmaSuballocationType& inOutPrevSuballocType) const;
 
+    /*
+    Use instead of Init(). Makes this object a copy of src, to be modified by defragmentation dry run.
+    Allocations referenced by the copy are not updated when it changes.
+    */
+    void InitSnapshot(const VmaBlockMetadata_Generic& src);
+
 private:
     friend class VmaDefragmentationAlgorithm_Generic;
     friend class VmaDefragmentationAlgorithm_Fast;
+    friend class VmaDefragmentationAlgorithm_BestFit;
 
+    // True if created by InitSnapshot(), so offsets of allocations may not match suballocations.
+    bool m_IsSnapshot;
     uint32_t m_FreeCount;
     VkDeviceSize m_SumFreeSize;
     VmaSuballocationList m_Suballocations;
@@ -5610,7 +7284,7 @@ public:
     virtual void AddPoolStats(VmaPoolStats& inoutStats) const;
 
 #if VMA_STATS_STRING_ENABLED
-    virtual void PrintDetailedMap(class VmaJsonWriter& json) const;
+    virtual void VisitDetailedMap(class VmaDetailedMapVisitor& visitor) const;
 #endif
 
     virtual bool CreateAllocationRequest(
@@ -5643,7 +7317,33 @@ public:
     virtual void Free(const VmaAllocation allocation);
     virtual void FreeAtOffset(VkDeviceSize offset);
 
+    /*
+    Frees allocations made in frame lastFrameIndex or earlier, starting from the oldest one
+    and stopping at the first newer one. UINT32_MAX frees all of them.
+    Handles of freed allocations are appended to outAllocations. Allocations made without
+    VmaAllocation object are freed too. If pOutSuballocations is not null, all freed
+    allocations are appended to it in the same order. Lifetimes of all freed allocations,
+    as of currentFrameIndex, are added to inoutHistograms. Returns number of all freed allocations.
+    */
+    size_t FreeUpToFrame(
+        uint32_t lastFrameIndex,
+        uint32_t currentFrameIndex,
+        VmaAllocationHistograms& inoutHistograms,
+        VmaVector< VmaAllocation, VmaStlAllocator<VmaAllocation> >& outAllocations,
+        VmaVector< VmaSuballocation, VmaStlAllocator<VmaSuballocation> >* pOutSuballocations);
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // For defragmentation
+
+    /*
+    Use instead of Init(). Makes this object a copy of src, to be modified by defragmentation dry run.
+    Allocations referenced by the copy are not updated when it changes.
+    */
+    void InitSnapshot(const VmaBlockMetadata_Linear& src);
+
 private:
+    friend class VmaDefragmentationAlgorithm_Linear;
+
     /*
     There are two suballocation vectors, used in ping-pong way.
     The one with index m_1stVectorIndex is called 1st.
@@ -5669,6 +7369,8 @@ private:
         SECOND_VECTOR_DOUBLE_STACK,
     };
 
+    // True if created by InitSnapshot(), so offsets of allocations may not match suballocations.
+    bool m_IsSnapshot;
     VkDeviceSize m_SumFreeSize;
     SuballocationVectorType m_Suballocations0, m_Suballocations1;
     uint32_t m_1stVectorIndex;
@@ -5685,9 +7387,16 @@ private:
     size_t m_1stNullItemsMiddleCount;
     // Number of items in 2nd vector with hAllocation = null.
     size_t m_2ndNullItemsCount;
+    // Number of allocations made without VmaAllocation object, in both vectors.
+    size_t m_HandlelessCount;
 
     bool ShouldCompact1st() const;
     void CleanupAfterFree();
+    // Used by FreeUpToFrame().
+    void FreeSuballocationUpToFrame(
+        VmaSuballocation& suballoc,
+        VmaVector< VmaAllocation, VmaStlAllocator<VmaAllocation> >& outAllocations,
+        VmaVector< VmaSuballocation, VmaStlAllocator<VmaSuballocation> >* pOutSuballocations);
 
     bool CreateAllocationRequest_LowerAddress(
         uint32_t currentFrameIndex,
@@ -5713,12 +7422,18 @@ private:
 
 /*
 - GetSize() is the original size of allocated memory block.
-- m_UsableSize is this size aligned down to a power of two.
-  All allocations and calculations happen relative to m_UsableSize.
-- GetUnusableSize() is the difference between them.
+- m_Level0NodeSize is this size aligned down to a power of two.
+  All levels and node sizes are calculated relative to m_Level0NodeSize.
+- With m_MultipleRoots, the block is covered by multiple trees (roots), one for each
+  bit set in GetSize() that is not smaller than MIN_NODE_SIZE. Otherwise there is
+  only the root at level 0. They are placed one after another, from the
+  largest one at offset 0. The root of size m_Level0NodeSize >> level is at that level.
+  Roots have no parent or buddy, so they are never merged.
+- m_UsableSize is the sum of sizes of all roots.
+- GetUnusableSize() is the difference between GetSize() and m_UsableSize.
   It is repoted as separate, unused range, not available for allocations.
 
-Node at level 0 has size = m_UsableSize.
+Node at level 0 has size = m_Level0NodeSize.
 Each next level contains nodes with size 2 times smaller than current level.
 m_LevelCount is the maximum number of levels to use in the current object.
 */
@@ -5726,7 +7441,7 @@ class VmaBlockMetadata_Buddy : public VmaBlockMetadata
 {
     VMA_CLASS_NO_COPY(VmaBlockMetadata_Buddy)
 public:
-    VmaBlockMetadata_Buddy(VmaAllocator hAllocator);
+    VmaBlockMetadata_Buddy(VmaAllocator hAllocator, bool multipleRoots);
     virtual ~VmaBlockMetadata_Buddy();
     virtual void Init(VkDeviceSize size);
 
@@ -5734,13 +7449,14 @@ public:
     virtual size_t GetAllocationCount() const { return m_AllocationCount; }
     virtual VkDeviceSize GetSumFreeSize() const { return m_SumFreeSize + GetUnusableSize(); }
     virtual VkDeviceSize GetUnusedRangeSizeMax() const;
-    virtual bool IsEmpty() const { return m_Root->type == Node::TYPE_FREE; }
+    // Free buddies are always merged, so all roots are free when there are no allocations.
+    virtual bool IsEmpty() const { return m_AllocationCount == 0; }
 
     virtual void CalcAllocationStatInfo(VmaStatInfo& outInfo) const;
     virtual void AddPoolStats(VmaPoolStats& inoutStats) const;
 
 #if VMA_STATS_STRING_ENABLED
-    virtual void PrintDetailedMap(class VmaJsonWriter& json) const;
+    virtual void VisitDetailedMap(class VmaDetailedMapVisitor& visitor) const;
 #endif
 
     virtual bool CreateAllocationRequest(
@@ -5773,8 +7489,20 @@ public:
     virtual void Free(const VmaAllocation allocation) { FreeAtOffset(allocation, allocation->GetOffset()); }
     virtual void FreeAtOffset(VkDeviceSize offset) { FreeAtOffset(VMA_NULL, offset); }
 
+    ////////////////////////////////////////////////////////////////////////////////
+    // For defragmentation
+
+    /*
+    Use instead of Init(). Makes this object a copy of src, to be modified by defragmentation dry run.
+    Allocations referenced by the copy are not updated when it changes.
+    */
+    void InitSnapshot(const VmaBlockMetadata_Buddy& src);
+
 private:
+    friend class VmaDefragmentationAlgorithm_Buddy;
+
     static const VkDeviceSize MIN_NODE_SIZE = 32;
+    // Must not exceed number of bits in m_FreeListNonEmptyMask, m_RootLevelMask.
     static const size_t MAX_LEVELS = 30;
 
     struct ValidationContext
@@ -5820,11 +7548,18 @@ private:
         };
     };
 
+    // Whether Init() creates roots for lower bits of the size, not only level 0.
+    const bool m_MultipleRoots;
     // Size of the memory block aligned down to a power of two.
+    VkDeviceSize m_Level0NodeSize;
+    // Sum of sizes of all roots.
     VkDeviceSize m_UsableSize;
     uint32_t m_LevelCount;
 
-    Node* m_Root;
+    // Root of the tree at given level, or null. Roots at higher levels have higher offsets.
+    Node* m_Roots[MAX_LEVELS];
+    // Bit at index `level` is set when m_Roots[level] is not null.
+    uint32_t m_RootLevelMask;
     struct {
         Node* front;
         Node* back;
@@ -5835,12 +7570,21 @@ private:
     size_t m_FreeCount;
     // This includes space wasted due to internal fragmentation. Doesn't include unusable size.
     VkDeviceSize m_SumFreeSize;
+    // Bit at index `level` is set when m_FreeList[level] is not empty.
+    uint32_t m_FreeListNonEmptyMask;
+    // All nodes of the tree. Splitting and merging nodes doesn't need to call allocation callbacks.
+    VmaPoolAllocator<Node> m_NodeAllocator;
 
     VkDeviceSize GetUnusableSize() const { return GetSize() - m_UsableSize; }
-    void DeleteNode(Node* node);
+    // Creates deep copy of srcNode and its children. Free list links are left undefined.
+    Node* CopyNode(const Node* srcNode, Node* parent);
+    // Returns root of the tree that contains given offset and its level.
+    Node* FindRoot(VkDeviceSize offset, uint32_t& outLevel) const;
+    // Returns node at given level that contains given offset. It must exist.
+    Node* FindNode(VkDeviceSize offset, uint32_t level) const;
     bool ValidateNode(ValidationContext& ctx, const Node* parent, const Node* curr, uint32_t level, VkDeviceSize levelNodeSize) const;
     uint32_t AllocSizeToLevel(VkDeviceSize allocSize) const;
-    inline VkDeviceSize LevelToNodeSize(uint32_t level) const { return m_UsableSize >> level; }
+    inline VkDeviceSize LevelToNodeSize(uint32_t level) const { return m_Level0NodeSize >> level; }
     // Alloc passed just for validation. Can be null.
     void FreeAtOffset(VmaAllocation alloc, VkDeviceSize offset);
     void CalcAllocationStatInfoNode(VmaStatInfo& outInfo, const Node* node, VkDeviceSize levelNodeSize) const;
@@ -5854,7 +7598,7 @@ private:
     void RemoveFromFreeList(uint32_t level, Node* node);
 
 #if VMA_STATS_STRING_ENABLED
-    void PrintDetailedMapNode(class VmaJsonWriter& json, const Node* node, VkDeviceSize levelNodeSize) const;
+    void VisitDetailedMapNode(class VmaDetailedMapVisitor& visitor, const Node* node, VkDeviceSize levelNodeSize) const;
 #endif
 };
 
@@ -5886,7 +7630,8 @@ public:
         VkDeviceMemory newMemory,
         VkDeviceSize newSize,
         uint32_t id,
-        uint32_t algorithm);
+        uint32_t algorithm,
+        bool buddyMultipleRoots);
     // Always call before destruction.
     void Destroy(VmaAllocator allocator);
     
@@ -5904,6 +7649,12 @@ public:
     // ppData can be null.
     VkResult Map(VmaAllocator hAllocator, uint32_t count, void** ppData);
     void Unmap(VmaAllocator hAllocator, uint32_t count);
+    /*
+    For allocations made without VmaAllocation object with MAPPED flag. The block is mapped
+    once for all of them and stays mapped until Destroy(). To be called while parent's
+    VmaBlockVector::m_Mutex is locked for writing.
+    */
+    VkResult MapForHandlelessAllocations(VmaAllocator hAllocator, void** ppData);
 
     VkResult WriteMagicValueAroundAllocation(VmaAllocator hAllocator, VkDeviceSize allocOffset, VkDeviceSize allocSize);
     VkResult ValidateMagicValueAroundAllocation(VmaAllocator hAllocator, VkDeviceSize allocOffset, VkDeviceSize allocSize);
@@ -5935,6 +7686,8 @@ private:
     VMA_MUTEX m_Mutex;
     uint32_t m_MapCount;
     void* m_pMappedData;
+    // True if one reference in m_MapCount is held by MapForHandlelessAllocations().
+    bool m_HandlelessMapped;
 };
 
 struct VmaPointerLess
@@ -5954,6 +7707,29 @@ struct VmaDefragmentationMove
     VkDeviceSize size;
 };
 
+/*
+Sums of free space of a set of block vectors, used to calculate their fragmentation.
+Free bytes that are outside of the largest free range of their block vector are
+considered fragmented.
+*/
+struct VmaFragmentationSums
+{
+    VkDeviceSize unusedBytes;
+    VkDeviceSize fragmentedBytes;
+
+    void AddBlockVector(VkDeviceSize blockVectorUnusedBytes, VkDeviceSize blockVectorUnusedRangeSizeMax)
+    {
+        VMA_ASSERT(blockVectorUnusedRangeSizeMax <= blockVectorUnusedBytes);
+        unusedBytes += blockVectorUnusedBytes;
+        fragmentedBytes += blockVectorUnusedBytes - blockVectorUnusedRangeSizeMax;
+    }
+    // Returns number in range 0..1.
+    float GetFragmentation() const
+    {
+        return unusedBytes > 0 ? (float)((double)fragmentedBytes / (double)unusedBytes) : 0.f;
+    }
+};
+
 class VmaDefragmentationAlgorithm;
 
 /*
@@ -5977,7 +7753,8 @@ public:
         uint32_t frameInUseCount,
         bool isCustomPool,
         bool explicitBlockSize,
-        uint32_t algorithm);
+        uint32_t algorithm,
+        bool buddyMultipleRoots);
     ~VmaBlockVector();
 
     VkResult CreateMinBlocks();
@@ -5990,8 +7767,12 @@ public:
     uint32_t GetAlgorithm() const { return m_Algorithm; }
 
     void GetPoolStats(VmaPoolStats* pStats);
+    void GetFragmentationScore(VmaFragmentationScore* pScore);
+    void GetAllocationHistograms(VmaAllocationHistograms* pHistograms);
 
     bool IsEmpty() const { return m_Blocks.empty(); }
+    // True between Defragment() that started defragmentation and DefragmentationEnd().
+    bool IsDefragmentationInProgress() const { return m_DefragmentationInProgress.load() != 0; }
     bool IsCorruptionDetectionEnabled() const;
 
     VkResult Allocate(
@@ -6006,13 +7787,51 @@ public:
     void Free(
         VmaAllocation hAllocation);
 
-    // Adds statistics of this BlockVector to pStats.
-    void AddStats(VmaStats* pStats);
-
-#if VMA_STATS_STRING_ENABLED
-    void PrintDetailedMap(class VmaJsonWriter& json);
-#endif
-
+    /*
+    Linear algorithm only. Makes single allocation without VmaAllocation object and
+    describes it in *pAllocationInfo. It can be freed only with FreeUpToFrame().
+    */
+    VkResult AllocateWithoutHandle(
+        uint32_t currentFrameIndex,
+        VkDeviceSize size,
+        VkDeviceSize alignment,
+        const VmaAllocationCreateInfo& createInfo,
+        VmaSuballocationType suballocType,
+        VmaAllocationInfo* pAllocationInfo);
+
+    /*
+    Linear algorithm only. Frees allocations made in frame lastFrameIndex or earlier in all
+    blocks, see VmaBlockMetadata_Linear::FreeUpToFrame(). Handles of freed allocations are
+    appended to outAllocations - the caller must destroy them. pOutSuballocations is optional.
+    Returns number of all freed allocations.
+    */
+    size_t FreeUpToFrame(
+        uint32_t lastFrameIndex,
+        VmaVector< VmaAllocation, VmaStlAllocator<VmaAllocation> >& outAllocations,
+        VmaVector< VmaSuballocation, VmaStlAllocator<VmaSuballocation> >* pOutSuballocations);
+
+    // Adds statistics of this BlockVector to pStats.
+    void AddStats(VmaStats* pStats);
+    // Calculates statistics of all blocks of this BlockVector, without postprocessing.
+    void CalcStatInfo(VmaStatInfo& outInfo);
+
+#if VMA_STATS_STRING_ENABLED
+    void PrintDetailedMap(class VmaJsonWriter& json);
+    // poolId is ignored for default pools.
+    void WriteBinaryStats(class VmaBinaryStatsWriter& writer, uint32_t poolId);
+    // poolId is ignored for default pools.
+    void AddToStatsSnapshot(class VmaStatsSnapshotBuilder& builder, uint32_t poolId);
+#if VMA_RECORDING_ENABLED
+    // Passes the pool, if custom, and all its allocations to the recorder, for VmaRecorder::Dump().
+    void RecordLiveObjects(class VmaRecorder& recorder, uint32_t frameIndex);
+#endif
+#endif
+
+#if VMA_RECORDING_ENABLED
+    // Reconstructs parameters of a custom pool, as it could be created by vmaCreatePool().
+    void GetPoolCreateInfo(VmaPoolCreateInfo& outCreateInfo) const;
+#endif
+
     void MakePoolAllocationsLost(
         uint32_t currentFrameIndex,
         size_t* pLostAllocationCount);
@@ -6028,6 +7847,18 @@ public:
     void DefragmentationEnd(
         class VmaBlockVectorDefragmentationContext* pCtx,
         VmaDefragmentationStats* pStats);
+    /*
+    Runs defragmentation algorithm on copies of metadata of all blocks and adds projected
+    results to inoutEstimate and inoutSumsBefore/After. Doesn't change allocations or memory.
+    Locks m_Mutex for reading just for the time of the call. Saves result in pCtx->res.
+    */
+    void EstimateDefragmentation(
+        class VmaBlockVectorDefragmentationContext* pCtx,
+        VmaDefragmentationEstimate& inoutEstimate,
+        VmaFragmentationSums& inoutSumsBefore,
+        VmaFragmentationSums& inoutSumsAfter,
+        VkDeviceSize& maxCpuBytesToMove, uint32_t& maxCpuAllocationsToMove,
+        VkDeviceSize& maxGpuBytesToMove, uint32_t& maxGpuAllocationsToMove);
 
     ////////////////////////////////////////////////////////////////////////////////
     // To be used only while the m_Mutex is locked. Used during defragmentation.
@@ -6051,6 +7882,7 @@ private:
     const bool m_IsCustomPool;
     const bool m_ExplicitBlockSize;
     const uint32_t m_Algorithm;
+    const bool m_BuddyMultipleRoots;
     /* There can be at most one allocation that is completely empty - a
     hysteresis to avoid pessimistic case of alternating creation and destruction
     of a VkDeviceMemory. */
@@ -6059,23 +7891,53 @@ private:
     // Incrementally sorted by sumFreeSize, ascending.
     VmaVector< VmaDeviceMemoryBlock*, VmaStlAllocator<VmaDeviceMemoryBlock*> > m_Blocks;
     uint32_t m_NextBlockId;
+    // Written only while m_Mutex is locked for writing, so it can be read without the lock.
+    VMA_ATOMIC_UINT32 m_DefragmentationInProgress;
+
+    /* Terms of fragmentation score of all blocks, updated incrementally.
+    Protected by m_Mutex. */
+    VkDeviceSize m_UnusedBytes;
+    VkDeviceSize m_UnusedRangeSizeMax;
+    double m_SumBlockUtilization;
+    double m_SumBlockUtilizationSq;
+
+    // Protected by m_Mutex.
+    VmaAllocationHistograms m_Histograms;
 
     VkDeviceSize CalcMaxBlockSize() const;
 
+    /*
+    To be called while m_Mutex is locked for writing, after metadata of pBlock changed.
+    prevSumFreeSize and prevUnusedRangeSizeMax are values returned by the metadata before the change.
+    */
+    void UpdateFragmentationScore(
+        const VmaDeviceMemoryBlock* pBlock,
+        VkDeviceSize prevSumFreeSize,
+        VkDeviceSize prevUnusedRangeSizeMax);
+    // Calculates fragmentation score from scratch. To be called after blocks were added or removed.
+    void RecalculateFragmentationScore();
+    // Checks that incrementally updated fragmentation score matches the one calculated from scratch.
+    bool ValidateFragmentationScore() const;
+
     // Finds and removes given block from vector.
     void Remove(VmaDeviceMemoryBlock* pBlock);
+    // Linear algorithm only. Blocks are kept in ring buffer order, from the oldest to the write head.
+    // Makes the oldest block the write head.
+    void MoveFirstBlockToBack();
 
     // Performs single step in sorting m_Blocks. They may not be fully sorted
     // after this call.
     void IncrementallySortBlocks();
 
+    // If pHandlelessAllocationInfo is not null, allocation is made without VmaAllocation object and pAllocation is ignored.
     VkResult AllocatePage(
         uint32_t currentFrameIndex,
         VkDeviceSize size,
         VkDeviceSize alignment,
         const VmaAllocationCreateInfo& createInfo,
         VmaSuballocationType suballocType,
-        VmaAllocation* pAllocation);
+        VmaAllocation* pAllocation,
+        VmaAllocationInfo* pHandlelessAllocationInfo);
 
     // To be used only without CAN_MAKE_OTHER_LOST flag.
     VkResult AllocateFromBlock(
@@ -6087,10 +7949,26 @@ private:
         void* pUserData,
         VmaSuballocationType suballocType,
         uint32_t strategy,
-        VmaAllocation* pAllocation);
+        VmaAllocation* pAllocation,
+        VmaAllocationInfo* pHandlelessAllocationInfo);
+
+    // Makes allocation without VmaAllocation object in pBlock, according to request that succeeded.
+    VkResult CommitHandlelessAllocation(
+        VmaDeviceMemoryBlock* pBlock,
+        const VmaAllocationRequest& request,
+        VkDeviceSize size,
+        VmaSuballocationType suballocType,
+        bool mapped,
+        VmaAllocationInfo* pAllocationInfo);
 
     VkResult CreateBlock(VkDeviceSize blockSize, size_t* pNewBlockIndex);
 
+    // Returns false if this block vector cannot be defragmented within given limits.
+    bool ChooseDefragmentationMethod(
+        VkDeviceSize maxCpuBytesToMove, uint32_t maxCpuAllocationsToMove,
+        VkDeviceSize maxGpuBytesToMove, uint32_t maxGpuAllocationsToMove,
+        bool& outDefragmentOnGpu) const;
+
     // Saves result to pCtx->res.
     void ApplyDefragmentationMovesCpu(
         class VmaBlockVectorDefragmentationContext* pDefragCtx,
@@ -6123,12 +8001,30 @@ public:
     uint32_t GetId() const { return m_Id; }
     void SetId(uint32_t id) { VMA_ASSERT(m_Id == 0); m_Id = id; }
 
+    /*
+    Functions related to automatic defragmentation. To be called only while
+    VmaAllocator_T::m_PoolsMutex is locked for writing.
+    */
+    bool IsAutoDefragmentationEnabled() const { return m_AutoDefragmentationEnabled; }
+    const VmaAutoDefragmentationPolicy& GetAutoDefragmentationPolicy() const { return m_AutoDefragmentationPolicy; }
+    // pPolicy can be null, which disables automatic defragmentation.
+    void SetAutoDefragmentationPolicy(const VmaAutoDefragmentationPolicy* pPolicy);
+    /*
+    Checks fragmentation score against thresholds of the policy, to be called once per frame.
+    Returns true if the pool should be defragmented now.
+    */
+    bool UpdateAutoDefragmentationFrameCounter();
+
 #if VMA_STATS_STRING_ENABLED
     //void PrintDetailedMap(class VmaStringBuilder& sb);
 #endif
 
 private:
     uint32_t m_Id;
+    bool m_AutoDefragmentationEnabled;
+    VmaAutoDefragmentationPolicy m_AutoDefragmentationPolicy;
+    // Number of consecutive frames when fragmentation score exceeded any of the thresholds.
+    uint32_t m_AutoDefragmentationFrameCounter;
 };
 
 /*
@@ -6148,13 +8044,27 @@ public:
         uint32_t currentFrameIndex) :
         m_hAllocator(hAllocator),
         m_pBlockVector(pBlockVector),
-        m_CurrentFrameIndex(currentFrameIndex)
+        m_CurrentFrameIndex(currentFrameIndex),
+        m_ppDryRunMetadata(VMA_NULL),
+        m_pMovedAllocations(VMA_NULL)
     {
     }
     virtual ~VmaDefragmentationAlgorithm()
     {
     }
 
+    /*
+    Makes Defragment() work on given copies of block metadata, indexed the same as
+    blocks of m_pBlockVector, instead of the real ones. Allocations are then not changed -
+    only moves and statistics are calculated. Must be called before Defragment().
+    */
+    void SetDryRun(VmaBlockMetadata* const* ppBlockMetadata) { m_ppDryRunMetadata = ppBlockMetadata; }
+    /*
+    Makes Defragment() append every allocation it moves to given vector, also when
+    the allocation was added by AddAll(). The same allocation may appear more than once.
+    */
+    void SetMovedAllocations(VmaVector< VmaAllocation, VmaStlAllocator<VmaAllocation> >* pMovedAllocations) { m_pMovedAllocations = pMovedAllocations; }
+
     virtual void AddAllocation(VmaAllocation hAlloc, VkBool32* pChanged) = 0;
     virtual void AddAll() = 0;
 
@@ -6170,6 +8080,41 @@ protected:
     VmaAllocator const m_hAllocator;
     VmaBlockVector* const m_pBlockVector;
     const uint32_t m_CurrentFrameIndex;
+    // Null if not a dry run.
+    VmaBlockMetadata* const* m_ppDryRunMetadata;
+    // Optional.
+    VmaVector< VmaAllocation, VmaStlAllocator<VmaAllocation> >* m_pMovedAllocations;
+
+    bool IsDryRun() const { return m_ppDryRunMetadata != VMA_NULL; }
+    // To be called after an allocation was given its new place. pChanged is optional.
+    void OnAllocationMoved(VmaAllocation hAlloc, VkBool32* pChanged)
+    {
+        if(pChanged != VMA_NULL)
+        {
+            *pChanged = VK_TRUE;
+        }
+        if(m_pMovedAllocations != VMA_NULL)
+        {
+            m_pMovedAllocations->push_back(hAlloc);
+        }
+    }
+    // Returns metadata the algorithm should work on for block with given index in m_pBlockVector.
+    VmaBlockMetadata* GetBlockMetadata(size_t blockIndex) const
+    {
+        return IsDryRun() ?
+            m_ppDryRunMetadata[blockIndex] :
+            m_pBlockVector->GetBlock(blockIndex)->m_pMetadata;
+    }
+
+    /*
+    Merges runs of consecutive moves that have the same source and destination
+    block and contiguous source and destination ranges into single moves.
+    Only changes `moves` - allocations are already updated by the algorithm.
+    Order of remaining moves is preserved.
+    */
+    static void CoalesceMoves(
+        VmaVector< VmaDefragmentationMove, VmaStlAllocator<VmaDefragmentationMove> >& moves,
+        bool overlappingMoveSupported);
 
     struct AllocationInfo
     {
@@ -6187,6 +8132,18 @@ protected:
         {
         }
     };
+
+    struct AllocationInfoHandleLess
+    {
+        bool operator()(const AllocationInfo& lhs, const AllocationInfo& rhs) const
+        {
+            return lhs.m_hAllocation < rhs.m_hAllocation;
+        }
+        bool operator()(const AllocationInfo& lhs, VmaAllocation rhsAllocation) const
+        {
+            return lhs.m_hAllocation < rhsAllocation;
+        }
+    };
 };
 
 class VmaDefragmentationAlgorithm_Generic : public VmaDefragmentationAlgorithm
@@ -6212,6 +8169,8 @@ public:
     virtual uint32_t GetAllocationsMoved() const { return m_AllocationsMoved; }
 
 private:
+    const bool m_OverlappingMoveSupported;
+
     uint32_t m_AllocationCount;
     bool m_AllAllocations;
 
@@ -6464,6 +8423,332 @@ private:
     void InsertSuballoc(VmaBlockMetadata_Generic* pMetadata, const VmaSuballocation& suballoc);
 };
 
+/*
+Keeps all free ranges of all blocks in a single vector sorted by size, so that
+for each allocation, starting from the most "source" ones, the smallest free range
+in a more "destination" place that can hold it is found with binary search.
+Lookup is O(log n), but every move also inserts and removes free ranges, which
+shifts the vector like in m_FreeSuballocationsBySize, so the whole pass is O(n^2)
+in the worst case, with n being number of free ranges. The shifts are memmove of
+small structures, which in practice cost less than the per-block scans of the
+generic algorithm. Like the generic algorithm, it supports non-movable allocations, VMA_DEBUG_MARGIN
+and bufferImageGranularity, because it places allocations using
+VmaBlockMetadata_Generic::CheckAllocation().
+*/
+class VmaDefragmentationAlgorithm_BestFit : public VmaDefragmentationAlgorithm
+{
+    VMA_CLASS_NO_COPY(VmaDefragmentationAlgorithm_BestFit)
+public:
+    VmaDefragmentationAlgorithm_BestFit(
+        VmaAllocator hAllocator,
+        VmaBlockVector* pBlockVector,
+        uint32_t currentFrameIndex,
+        bool overlappingMoveSupported);
+    virtual ~VmaDefragmentationAlgorithm_BestFit();
+
+    virtual void AddAllocation(VmaAllocation hAlloc, VkBool32* pChanged);
+    virtual void AddAll() { m_AllAllocations = true; }
+
+    virtual VkResult Defragment(
+        VmaVector< VmaDefragmentationMove, VmaStlAllocator<VmaDefragmentationMove> >& moves,
+        VkDeviceSize maxBytesToMove,
+        uint32_t maxAllocationsToMove);
+
+    virtual VkDeviceSize GetBytesMoved() const { return m_BytesMoved; }
+    virtual uint32_t GetAllocationsMoved() const { return m_AllocationsMoved; }
+
+private:
+    struct BlockInfo
+    {
+        size_t origBlockIndex;
+        size_t movableAllocationCount;
+        VkDeviceSize movableBytes;
+    };
+
+    // Free range registered in m_FreeRanges.
+    struct FreeRange
+    {
+        VkDeviceSize size;
+        // Index to m_BlockInfos.
+        size_t blockInfoIndex;
+        VkDeviceSize offset;
+        VmaSuballocationList::iterator item;
+    };
+
+    // Orders by size, then from most "destination" to most "source" place.
+    struct FreeRangeLess
+    {
+        bool operator()(const FreeRange& lhs, const FreeRange& rhs) const
+        {
+            if(lhs.size != rhs.size)
+            {
+                return lhs.size < rhs.size;
+            }
+            if(lhs.blockInfoIndex != rhs.blockInfoIndex)
+            {
+                return lhs.blockInfoIndex < rhs.blockInfoIndex;
+            }
+            return lhs.offset < rhs.offset;
+        }
+        bool operator()(const FreeRange& lhs, VkDeviceSize rhsSize) const
+        {
+            return lhs.size < rhsSize;
+        }
+    };
+
+    // Allocation to be moved.
+    struct MoveSource
+    {
+        // Index to m_BlockInfos.
+        size_t blockInfoIndex;
+        VmaSuballocationList::iterator item;
+        VkBool32* pChanged;
+    };
+
+    // Orders from most "destination" to most "source" place.
+    struct MoveSourceLess
+    {
+        bool operator()(const MoveSource& lhs, const MoveSource& rhs) const
+        {
+            if(lhs.blockInfoIndex != rhs.blockInfoIndex)
+            {
+                return lhs.blockInfoIndex < rhs.blockInfoIndex;
+            }
+            return lhs.item->offset < rhs.item->offset;
+        }
+    };
+
+    struct MoveSourceSizeLess
+    {
+        bool operator()(const MoveSource& lhs, const MoveSource& rhs) const
+        {
+            return lhs.item->size < rhs.item->size;
+        }
+    };
+
+    const bool m_OverlappingMoveSupported;
+
+    bool m_AllAllocations;
+    // Allocations passed to AddAllocation(). Sorted by handle in Defragment().
+    VmaVector< AllocationInfo, VmaStlAllocator<AllocationInfo> > m_Allocations;
+
+    VkDeviceSize m_BytesMoved;
+    uint32_t m_AllocationsMoved;
+
+    // Sorted from most "destination" to most "source" block.
+    VmaVector< BlockInfo, VmaStlAllocator<BlockInfo> > m_BlockInfos;
+    // Sorted by FreeRangeLess. Insert and remove are O(n).
+    VmaVector< FreeRange, VmaStlAllocator<FreeRange> > m_FreeRanges;
+
+    VmaBlockMetadata_Generic* GetBlockInfoMetadata(size_t blockInfoIndex) const
+    {
+        return (VmaBlockMetadata_Generic*)GetBlockMetadata(m_BlockInfos[blockInfoIndex].origBlockIndex);
+    }
+    /*
+    Tries to move each of sources, starting from the last one, to free ranges of blocks
+    with index < dstBlockInfoCount. Moved ones are removed from sources.
+    Returns true if limit of bytes or allocations to move was reached.
+    */
+    bool DefragmentRound(
+        VmaVector< MoveSource, VmaStlAllocator<MoveSource> >& sources,
+        size_t dstBlockInfoCount,
+        VmaVector< VmaDefragmentationMove, VmaStlAllocator<VmaDefragmentationMove> >& moves,
+        VkDeviceSize maxBytesToMove,
+        uint32_t maxAllocationsToMove);
+    // Given free suballocation, it inserts it into m_FreeRanges if it's suitable.
+    void RegisterFreeRange(size_t blockInfoIndex, VmaSuballocationList::iterator item);
+    // Given free suballocation, it removes it from m_FreeRanges if it's there.
+    void UnregisterFreeRange(size_t blockInfoIndex, VmaSuballocationList::iterator item);
+
+    static bool MoveMakesSense(
+        size_t dstBlockInfoIndex, VkDeviceSize dstOffset,
+        size_t srcBlockInfoIndex, VkDeviceSize srcOffset);
+};
+
+/*
+Defragmentation of blocks of a pool created with VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT.
+Compacts lower side of each block (2nd vector of ring buffer and 1st vector, which
+becomes a single stack) towards its beginning and upper side of double stack towards
+its end, preserving order of allocations. Allocations from the lower side are first
+tried at the end of previous blocks, so the last blocks become empty.
+Non-movable allocations stay in place. Supports VMA_DEBUG_MARGIN and bufferImageGranularity.
+*/
+class VmaDefragmentationAlgorithm_Linear : public VmaDefragmentationAlgorithm
+{
+    VMA_CLASS_NO_COPY(VmaDefragmentationAlgorithm_Linear)
+public:
+    VmaDefragmentationAlgorithm_Linear(
+        VmaAllocator hAllocator,
+        VmaBlockVector* pBlockVector,
+        uint32_t currentFrameIndex,
+        bool overlappingMoveSupported);
+    virtual ~VmaDefragmentationAlgorithm_Linear();
+
+    virtual void AddAllocation(VmaAllocation hAlloc, VkBool32* pChanged);
+    virtual void AddAll() { m_AllAllocations = true; }
+
+    virtual VkResult Defragment(
+        VmaVector< VmaDefragmentationMove, VmaStlAllocator<VmaDefragmentationMove> >& moves,
+        VkDeviceSize maxBytesToMove,
+        uint32_t maxAllocationsToMove);
+
+    virtual VkDeviceSize GetBytesMoved() const { return m_BytesMoved; }
+    virtual uint32_t GetAllocationsMoved() const { return m_AllocationsMoved; }
+
+private:
+    typedef VmaBlockMetadata_Linear::SuballocationVectorType SuballocationVectorType;
+
+    const bool m_OverlappingMoveSupported;
+
+    bool m_AllAllocations;
+    // Allocations passed to AddAllocation(). Sorted by handle in Defragment().
+    VmaVector< AllocationInfo, VmaStlAllocator<AllocationInfo> > m_Allocations;
+
+    VkDeviceSize m_BytesMoved;
+    uint32_t m_AllocationsMoved;
+
+    // Suballocations of the side of the block being compacted, in their new places.
+    SuballocationVectorType m_NewSuballocations;
+
+    VmaBlockMetadata_Linear* GetLinearMetadata(size_t blockIndex) const
+    {
+        return (VmaBlockMetadata_Linear*)GetBlockMetadata(blockIndex);
+    }
+    // Returns false if hAlloc is not one of allocations to move.
+    bool IsMovable(VmaAllocation hAlloc, VkBool32** ppChanged) const;
+    /*
+    Compacts block with given index, trying to move allocations from its lower side to
+    previous blocks first. Leaves it without null items.
+    Returns true if limit of bytes or allocations to move was reached.
+    */
+    bool CompactBlock(
+        size_t blockIndex,
+        VmaVector< VmaDefragmentationMove, VmaStlAllocator<VmaDefragmentationMove> >& moves,
+        VkDeviceSize maxBytesToMove,
+        uint32_t maxAllocationsToMove);
+    void AddMove(
+        size_t srcBlockIndex, const VmaSuballocation& srcSuballoc,
+        size_t dstBlockIndex, VkDeviceSize dstOffset,
+        VkBool32* pChanged,
+        VmaVector< VmaDefragmentationMove, VmaStlAllocator<VmaDefragmentationMove> >& moves);
+
+    // Returns offset for suballoc placed after the last of suballocations, like
+    // VmaBlockMetadata_Linear::CreateAllocationRequest_LowerAddress() calculates it.
+    static VkDeviceSize CalcLowerOffset(
+        const SuballocationVectorType& suballocations,
+        const VmaSuballocation& suballoc,
+        VkDeviceSize alignment,
+        VkDeviceSize bufferImageGranularity);
+    // Returns offset for suballoc placed before the last of upper suballocations or at the end of
+    // the block, like VmaBlockMetadata_Linear::CreateAllocationRequest_UpperAddress() calculates it.
+    static VkDeviceSize CalcUpperOffset(
+        const SuballocationVectorType& suballocations,
+        const VmaSuballocation& suballoc,
+        VkDeviceSize blockSize,
+        VkDeviceSize alignment,
+        VkDeviceSize bufferImageGranularity);
+};
+
+/*
+Defragmentation of blocks of a pool created with VMA_POOL_CREATE_BUDDY_ALGORITHM_BIT.
+Moves allocations, starting from the most "source" ones, to free nodes of the same
+size placed before them, or if there are none, to the smallest bigger ones, which are
+then split. Freeing the source lets its node merge with its free buddies, so free space
+gathers in big nodes at the end of blocks and in whole blocks.
+*/
+class VmaDefragmentationAlgorithm_Buddy : public VmaDefragmentationAlgorithm
+{
+    VMA_CLASS_NO_COPY(VmaDefragmentationAlgorithm_Buddy)
+public:
+    VmaDefragmentationAlgorithm_Buddy(
+        VmaAllocator hAllocator,
+        VmaBlockVector* pBlockVector,
+        uint32_t currentFrameIndex,
+        bool overlappingMoveSupported);
+    virtual ~VmaDefragmentationAlgorithm_Buddy();
+
+    virtual void AddAllocation(VmaAllocation hAlloc, VkBool32* pChanged);
+    virtual void AddAll() { m_AllAllocations = true; }
+
+    virtual VkResult Defragment(
+        VmaVector< VmaDefragmentationMove, VmaStlAllocator<VmaDefragmentationMove> >& moves,
+        VkDeviceSize maxBytesToMove,
+        uint32_t maxAllocationsToMove);
+
+    virtual VkDeviceSize GetBytesMoved() const { return m_BytesMoved; }
+    virtual uint32_t GetAllocationsMoved() const { return m_AllocationsMoved; }
+
+private:
+    typedef VmaBlockMetadata_Buddy::Node Node;
+
+    // Allocation to be moved.
+    struct MoveSource
+    {
+        size_t blockIndex;
+        // Node of type TYPE_ALLOCATION. It is not deleted until the allocation is moved.
+        Node* node;
+        uint32_t level;
+        VkBool32* pChanged;
+    };
+
+    // Free node registered in m_FreeNodes.
+    struct FreeNode
+    {
+        VkDeviceSize size;
+        size_t blockIndex;
+        VkDeviceSize offset;
+    };
+
+    // Orders by size, then from most "source" to most "destination" place,
+    // so the best destination of given size is the last one.
+    struct FreeNodeLess
+    {
+        bool operator()(const FreeNode& lhs, const FreeNode& rhs) const
+        {
+            if(lhs.size != rhs.size)
+            {
+                return lhs.size < rhs.size;
+            }
+            if(lhs.blockIndex != rhs.blockIndex)
+            {
+                return lhs.blockIndex > rhs.blockIndex;
+            }
+            return lhs.offset > rhs.offset;
+        }
+        bool operator()(const FreeNode& lhs, VkDeviceSize rhsSize) const
+        {
+            return lhs.size < rhsSize;
+        }
+    };
+
+    const bool m_OverlappingMoveSupported;
+
+    bool m_AllAllocations;
+    // Allocations passed to AddAllocation(). Sorted by handle in Defragment().
+    VmaVector< AllocationInfo, VmaStlAllocator<AllocationInfo> > m_Allocations;
+
+    VkDeviceSize m_BytesMoved;
+    uint32_t m_AllocationsMoved;
+
+    // Sorted by FreeNodeLess.
+    VmaVector< FreeNode, VmaStlAllocator<FreeNode> > m_FreeNodes;
+
+    VmaBlockMetadata_Buddy* GetBuddyMetadata(size_t blockIndex) const
+    {
+        return (VmaBlockMetadata_Buddy*)GetBlockMetadata(blockIndex);
+    }
+    // Appends allocation nodes to move to sources and free nodes to m_FreeNodes, in order of offsets.
+    void GatherNodes(
+        size_t blockIndex,
+        Node* node,
+        uint32_t level,
+        VmaVector< MoveSource, VmaStlAllocator<MoveSource> >& sources);
+
+    static bool MoveMakesSense(
+        size_t dstBlockIndex, VkDeviceSize dstOffset,
+        size_t srcBlockIndex, VkDeviceSize srcOffset);
+};
+
 struct VmaBlockDefragmentationContext
 {
     enum BLOCK_FLAG
@@ -6486,7 +8771,8 @@ public:
         VmaAllocator hAllocator,
         VmaPool hCustomPool, // Optional.
         VmaBlockVector* pBlockVector,
-        uint32_t currFrameIndex);
+        uint32_t currFrameIndex,
+        uint32_t flags);
     ~VmaBlockVectorDefragmentationContext();
 
     VmaPool GetCustomPool() const { return m_hCustomPool; }
@@ -6495,6 +8781,8 @@ public:
 
     void AddAllocation(VmaAllocation hAlloc, VkBool32* pChanged);
     void AddAll() { m_AllAllocations = true; }
+    // Optional. Passed to the algorithm in Begin().
+    void SetMovedAllocations(VmaVector< VmaAllocation, VmaStlAllocator<VmaAllocation> >* pMovedAllocations) { m_pMovedAllocations = pMovedAllocations; }
 
     void Begin(bool overlappingMoveSupported);
 
@@ -6505,6 +8793,8 @@ private:
     // Redundant, for convenience not to fetch from m_hCustomPool->m_BlockVector or m_hAllocator->m_pBlockVectors.
     VmaBlockVector* const m_pBlockVector;
     const uint32_t m_CurrFrameIndex;
+    // Combination of VmaDefragmentationFlagBits.
+    const uint32_t m_Flags;
     // Owner of this object.
     VmaDefragmentationAlgorithm* m_pAlgorithm;
 
@@ -6516,6 +8806,7 @@ private:
     // Used between constructor and Begin.
     VmaVector< AllocInfo, VmaStlAllocator<AllocInfo> > m_Allocations;
     bool m_AllAllocations;
+    VmaVector< VmaAllocation, VmaStlAllocator<VmaAllocation> >* m_pMovedAllocations;
 };
 
 struct VmaDefragmentationContext_T
@@ -6547,11 +8838,22 @@ public:
         VkDeviceSize maxGpuBytesToMove, uint32_t maxGpuAllocationsToMove,
         VkCommandBuffer commandBuffer, VmaDefragmentationStats* pStats);
 
-private:
+    /*
+    Use instead of Defragment(). Only calculates projected results, leaving allocations
+    and memory untouched. The object can be destroyed immediately after it.
+    */
+    VkResult Estimate(
+        VkDeviceSize maxCpuBytesToMove, uint32_t maxCpuAllocationsToMove,
+        VkDeviceSize maxGpuBytesToMove, uint32_t maxGpuAllocationsToMove,
+        VkCommandBuffer commandBuffer, VmaDefragmentationEstimate* pEstimate);
+
+private:
     const VmaAllocator m_hAllocator;
     const uint32_t m_CurrFrameIndex;
     const uint32_t m_Flags;
     VmaDefragmentationStats* const m_pStats;
+    // True if Estimate() was called. Block vectors then don't need DefragmentationEnd().
+    bool m_DryRun;
     // Owner of these objects.
     VmaBlockVectorDefragmentationContext* m_DefaultPoolContexts[VK_MAX_MEMORY_TYPES];
     // Owner of these objects.
@@ -6560,10 +8862,68 @@ private:
 
 #if VMA_RECORDING_ENABLED
 
+// Types of blocks in recording file in binary format.
+enum VMA_RECORD_BLOCK_TYPE
+{
+    VMA_RECORD_BLOCK_TYPE_THREAD = 1,
+    VMA_RECORD_BLOCK_TYPE_CALLS = 2,
+    VMA_RECORD_BLOCK_TYPE_END = 3,
+    VMA_RECORD_BLOCK_TYPE_STATE = 4,
+};
+
+// Flags in the header of recording file in binary format.
+enum VMA_RECORD_HEADER_FLAG
+{
+    // Every call is encoded as if it was the first call of its thread. Used by dumps of the flight recorder.
+    VMA_RECORD_HEADER_FLAG_INDEPENDENT_CALLS = 0x00000001,
+};
+
+// Operation codes of calls in recording file in binary format.
+enum VMA_RECORD_OP
+{
+    VMA_RECORD_OP_CREATE_ALLOCATOR = 1,
+    VMA_RECORD_OP_DESTROY_ALLOCATOR,
+    VMA_RECORD_OP_CREATE_POOL,
+    VMA_RECORD_OP_DESTROY_POOL,
+    VMA_RECORD_OP_ALLOCATE_MEMORY,
+    VMA_RECORD_OP_ALLOCATE_MEMORY_PAGES,
+    VMA_RECORD_OP_ALLOCATE_MEMORY_FOR_BUFFER,
+    VMA_RECORD_OP_ALLOCATE_MEMORY_FOR_IMAGE,
+    VMA_RECORD_OP_FREE_MEMORY,
+    VMA_RECORD_OP_FREE_MEMORY_PAGES,
+    VMA_RECORD_OP_SET_ALLOCATION_USER_DATA,
+    VMA_RECORD_OP_CREATE_LOST_ALLOCATION,
+    VMA_RECORD_OP_MAP_MEMORY,
+    VMA_RECORD_OP_UNMAP_MEMORY,
+    VMA_RECORD_OP_FLUSH_ALLOCATION,
+    VMA_RECORD_OP_INVALIDATE_ALLOCATION,
+    VMA_RECORD_OP_CREATE_BUFFER,
+    VMA_RECORD_OP_CREATE_IMAGE,
+    VMA_RECORD_OP_DESTROY_BUFFER,
+    VMA_RECORD_OP_DESTROY_IMAGE,
+    VMA_RECORD_OP_TOUCH_ALLOCATION,
+    VMA_RECORD_OP_GET_ALLOCATION_INFO,
+    VMA_RECORD_OP_MAKE_POOL_ALLOCATIONS_LOST,
+    VMA_RECORD_OP_DEFRAGMENTATION_BEGIN,
+    VMA_RECORD_OP_DEFRAGMENTATION_END,
+    VMA_RECORD_OP_FREE_POOL_ALLOCATIONS,
+    VMA_RECORD_OP_ALLOCATE_MEMORY_WITHOUT_HANDLE,
+};
+
+/*
+With VMA_RECORD_FLIGHT_RECORDER_BIT, set in operation code of a call that describes
+the object destroyed by the call of the same index. VmaRecorder::Dump() moves such calls
+to block of type VMA_RECORD_BLOCK_TYPE_STATE, clearing this bit.
+*/
+static const uint8_t VMA_RECORD_OP_FREED_OBJECT_BIT = 0x80;
+
+// Number of bits defined in VmaRecordOptionalFunctionFlagBits.
+static const uint32_t VMA_RECORD_OPTIONAL_FUNCTION_COUNT = 4;
+
 class VmaRecorder
 {
 public:
-    VmaRecorder();
+    VmaRecorder(VmaAllocator hAllocator);
     VkResult Init(const VmaRecordSettings& settings, bool useMutex);
     void WriteConfiguration(
         const VkPhysicalDeviceProperties& devProps,
@@ -6635,17 +8995,75 @@ public:
         VmaAllocation allocation);
     void RecordMakePoolAllocationsLost(uint32_t frameIndex,
         VmaPool pool);
+    /*
+    pAllocations are freed allocations that had VmaAllocation object, still valid during this call.
+    pSuballocations are all freed allocations in order, passed only with VMA_RECORD_FLIGHT_RECORDER_BIT.
+    */
+    void RecordFreePoolAllocations(uint32_t frameIndex,
+        VmaPool pool,
+        uint32_t lastFrameIndex,
+        uint64_t freedAllocationCount,
+        uint64_t allocationCount,
+        const VmaAllocation* pAllocations,
+        size_t suballocationCount,
+        const VmaSuballocation* pSuballocations);
+    void RecordAllocateMemoryWithoutHandle(uint32_t frameIndex,
+        const VkMemoryRequirements& vkMemReq,
+        const VmaAllocationCreateInfo& createInfo,
+        bool succeeded);
     void RecordDefragmentationBegin(uint32_t frameIndex,
         const VmaDefragmentationInfo2& info,
         VmaDefragmentationContext ctx);
     void RecordDefragmentationEnd(uint32_t frameIndex,
         VmaDefragmentationContext ctx);
 
+    void GetStats(VmaRecordingStats& outStats);
+
+    bool IsFlightRecorder() const { return m_FlightRecorder; }
+    // Writes contents of the ring buffers to the file. pFilePath can be null.
+    VkResult Dump(const char* pFilePath);
+    /*
+    Encode a call that would create the object, to be stored in block of type VMA_RECORD_BLOCK_TYPE_STATE.
+    destroyCallIndex is index of the call that destroys the object, or UINT64_MAX for objects
+    that exist during Dump(), passed by VmaAllocator_T::RecordLiveObjects().
+    */
+    void DescribePool(uint32_t frameIndex,
+        VmaPool pool,
+        uint64_t destroyCallIndex);
+    void DescribeAllocation(uint32_t frameIndex,
+        VmaAllocation allocation,
+        uint64_t destroyCallIndex);
+    // Allocation made with vmaAllocateMemoryWithoutHandle(), described in the frame in which it was made.
+    void DescribeHandlelessAllocation(VmaPool pool,
+        uint32_t memoryTypeIndex,
+        const VmaSuballocation& suballoc,
+        uint64_t destroyCallIndex);
+
 private:
+    // State of a thread: statistics of its calls and, with VMA_RECORD_BINARY_FORMAT_BIT, buffer of encoded calls.
+    class ThreadBuffer;
+    // Buffers of the current thread in all recorders it uses, retired when the thread exits.
+    class ThreadState;
+
+    // All recorders that are initialized and not destroyed yet, so that an exiting thread never touches a destroyed one.
+    struct LiveRecorderList
+    {
+        VMA_MUTEX mutex;
+        VmaRecorder* pFirst;
+        LiveRecorderList() : pFirst(VMA_NULL) { }
+    };
+    static LiveRecorderList& GetLiveRecorders();
+    // LiveRecorderList::mutex must be locked. Comparing ID recognizes a new recorder at the same address.
+    static bool IsLive(const VmaRecorder* pRecorder, uint64_t id);
+
     struct CallParams
     {
         uint32_t threadId;
         double time;
+        // Value of the counter at the beginning of the call.
+        int64_t counter;
+        // Taken before m_FileMutex is locked, as it may lock m_ThreadBuffersMutex.
+        ThreadBuffer* pThreadBuffer;
     };
 
     class UserDataString
@@ -6663,10 +9081,34 @@ private:
     VmaRecordFlags m_Flags;
     FILE* m_File;
     VMA_MUTEX m_FileMutex;
+    // Counter frequency in ticks per second and its value at the beginning of recording.
     int64_t m_Freq;
     int64_t m_StartCounter;
+#if VMA_RECORDING_USE_TSC
+    // True if time stamp counter is invariant and it was calibrated, otherwise steady clock is used.
+    bool m_UseTsc;
+#endif
 
+    void InitCounter();
+    int64_t GetCounter() const;
+    static uint32_t GetThreadId();
     void GetBasicParams(CallParams& outParams);
+    // Finishes call recorded in CSV format. m_FileMutex must be locked, if used.
+    void EndCall(const CallParams& params);
+
+    // Configured by VmaRecordSettings::disabledFunctions and optionalCallSamplingPeriod.
+    VmaRecordOptionalFunctionFlags m_DisabledFunctions;
+    uint32_t m_OptionalCallSamplingPeriod;
+    // Bytes passed to Print() and Write().
+    std::atomic<uint64_t> m_BytesRecorded;
+    // Bytes written to the file, used only with VMA_RECORD_COMPRESS_BIT.
+    std::atomic<uint64_t> m_BytesWritten;
+
+    // Returns false if the call of the function shouldn't be recorded, counting it as skipped.
+    bool ShouldRecordOptionalCall(VmaRecordOptionalFunctionFlagBits function, VmaAllocation allocation);
+
+    // Pointers are written as 16 hexadecimal digits on all platforms, including null.
+    static unsigned long long PtrToUint64(const void* ptr) { return (unsigned long long)(uintptr_t)ptr; }
 
     // T must be a pointer type, e.g. VmaAllocation, VmaPool.
     template<typename T>
@@ -6674,16 +9116,98 @@ private:
     {
         if(count)
         {
-            fprintf(m_File, "%p", pItems[0]);
+            Print("%016llX", PtrToUint64(pItems[0]));
             for(uint64_t i = 1; i < count; ++i)
             {
-                fprintf(m_File, " %p", pItems[i]);
+                Print(" %016llX", PtrToUint64(pItems[i]));
             }
         }
     }
 
     void PrintPointerList(uint64_t count, const VmaAllocation* pItems);
+    // All output goes through these two functions. m_FileMutex must be locked, if used.
+    void Print(const char* format, ...);
+    void Write(const void* pData, size_t size);
     void Flush();
+
+    // Used only with VMA_RECORD_COMPRESS_BIT, otherwise null.
+    class Compressor;
+    Compressor* m_pCompressor;
+
+    // Members below are used only with VMA_RECORD_BINARY_FORMAT_BIT, except m_Id and m_ThreadBuffers.
+    class BinaryCall;
+
+    const VmaAllocator m_hAllocator;
+    const VkAllocationCallbacks* m_pAllocationCallbacks;
+    bool m_BinaryFormat;
+    // Unique among all recorders ever created in the process, never 0.
+    uint64_t m_Id;
+    // Next in LiveRecorderList, protected by its mutex.
+    VmaRecorder* m_pNextLive;
+    // Global order of calls made on different threads.
+    std::atomic<uint64_t> m_NextCallIndex;
+    VMA_MUTEX m_ThreadBuffersMutex;
+    VmaVector< ThreadBuffer*, VmaStlAllocator<ThreadBuffer*> > m_ThreadBuffers;
+    // Members below are protected by m_ThreadBuffersMutex.
+    // Index for the next new buffer. Indices are not reused, as they identify threads in the file.
+    uint32_t m_NextThreadIndex;
+    // Statistics of calls of buffers already freed.
+    uint64_t m_FreedRecordedCallCount;
+    uint64_t m_FreedSkippedCallCount;
+    uint64_t m_FreedRecordingTicks;
+    std::thread m_WriterThread;
+    std::mutex m_WriterMutex;
+    std::condition_variable m_WriterCond;
+    bool m_WriterStop;
+
+    ThreadBuffer& GetThreadBuffer();
+    // Called when the thread owning the buffer exits. Writes its remaining calls and frees it.
+    void RetireThreadBuffer(ThreadBuffer& buffer);
+    // m_ThreadBuffersMutex must be locked.
+    void FreeThreadBuffer(ThreadBuffer& buffer);
+    void WriterThreadMain();
+    // Writes contents of buffers of all threads to the file.
+    void WriteThreadBuffers();
+    // Writes contents of the buffer to the file. m_FileMutex must be locked.
+    void WriteThreadBuffer(ThreadBuffer& buffer);
+    // Writes block of type VMA_RECORD_BLOCK_TYPE_CALLS. m_FileMutex must be locked.
+    void WriteCallsBlock(const ThreadBuffer& buffer, const void* pData1, size_t size1, const void* pData2, size_t size2);
+    // Writes block of type VMA_RECORD_BLOCK_TYPE_THREAD. m_FileMutex must be locked.
+    void WriteThreadBlock(ThreadBuffer& buffer);
+    // flags: combination of VMA_RECORD_HEADER_FLAG.
+    void WriteBinaryHeader(uint32_t flags);
+    void PrintConfiguration(
+        const VkPhysicalDeviceProperties& devProps,
+        const VkPhysicalDeviceMemoryProperties& memProps,
+        bool dedicatedAllocationExtensionEnabled,
+        bool bindMemory2ExtensionEnabled);
+
+    // Members below are used only with VMA_RECORD_FLIGHT_RECORDER_BIT.
+    bool m_FlightRecorder;
+    size_t m_FlightRecorderBufferSize;
+    // Copy of VmaRecordSettings::pFilePath.
+    char* m_pFilePath;
+    // Set while Dump() copies the ring buffers, so threads don't write to them.
+    std::atomic<bool> m_Dumping;
+    // Allows only one Dump() at a time.
+    VMA_MUTEX m_DumpMutex;
+    // Pools and allocations encoded as calls by Dump(), including ones destroyed by calls in the ring buffers.
+    VmaVector< uint8_t, VmaStlAllocator<uint8_t> > m_DumpState;
+    // Set when the recording was dumped because of a failed allocation.
+    std::atomic<bool> m_DumpedOnFailure;
+    // Protected by m_ThreadBuffersMutex. Number of buffers of exited threads still kept.
+    size_t m_ExitedThreadBufferCount;
+    // Protected by m_ThreadBuffersMutex. Calls before it were in freed buffers of exited threads.
+    uint64_t m_FirstDumpedCallIndex;
+
+    // Dumps the recording if it's the first failed allocation. Called after recording it.
+    void AllocationFailed();
+    // Protect ring buffer of the thread against Dump(), without taking any lock.
+    void BeginRingWrite(ThreadBuffer& buffer);
+    void EndRingWrite(ThreadBuffer& buffer);
+    // Writes the file of a dump. m_FileMutex must be locked.
+    VkResult WriteDump(const char* pFilePath);
+    void EndDescription(BinaryCall& call, uint64_t destroyCallIndex);
 };
 
 #endif // #if VMA_RECORDING_ENABLED
@@ -6699,6 +9223,8 @@ public:
 
     VmaAllocation Allocate();
     void Free(VmaAllocation hAlloc);
+    // Frees multiple objects with one lock of the mutex.
+    void Free(size_t count, const VmaAllocation* pAllocations);
 
 private:
     VMA_MUTEX m_Mutex;
@@ -6734,6 +9260,9 @@ public:
     AllocationVectorType* m_pDedicatedAllocations[VK_MAX_MEMORY_TYPES];
     VMA_RW_MUTEX m_DedicatedAllocationsMutex[VK_MAX_MEMORY_TYPES];
 
+    // Returned by vmaGetCounters(). Updated also by block vectors.
+    VmaAllocatorCounters m_Counters;
+
     VmaAllocator_T(const VmaAllocatorCreateInfo* pCreateInfo);
     VkResult Init(const VmaAllocatorCreateInfo* pCreateInfo);
     ~VmaAllocator_T();
@@ -6783,7 +9312,11 @@ public:
 
 #if VMA_RECORDING_ENABLED
     VmaRecorder* GetRecorder() const { return m_pRecorder; }
+    // Passes all pools and allocations to the recorder, for VmaRecorder::Dump().
+    void RecordLiveObjects();
 #endif
+    VkResult GetRecordingStats(VmaRecordingStats* pStats);
+    VkResult DumpRecording(const char* pFilePath);
 
     void GetBufferMemoryRequirements(
         VkBuffer hBuffer,
@@ -6808,6 +9341,13 @@ public:
         size_t allocationCount,
         VmaAllocation* pAllocations);
 
+    // Allocation without VmaAllocation object, from custom pool with linear algorithm.
+    VkResult AllocateMemoryWithoutHandle(
+        const VkMemoryRequirements& vkMemReq,
+        const VmaAllocationCreateInfo& createInfo,
+        VmaSuballocationType suballocType,
+        VmaAllocationInfo* pAllocationInfo);
+
     // Main deallocation function.
     void FreeMemory(
         size_t allocationCount,
@@ -6818,9 +9358,21 @@ public:
         VkDeviceSize newSize);
 
     void CalculateStats(VmaStats* pStats);
+    void CalculateStatsParallel(const VmaTaskSystem* pTaskSystem, VmaStats* pStats);
+    // Calculates statistics of all dedicated allocations of given memory type, without postprocessing.
+    void CalcDedicatedAllocationsStatInfo(uint32_t memTypeIndex, VmaStatInfo& outInfo);
 
 #if VMA_STATS_STRING_ENABLED
     void PrintDetailedMap(class VmaJsonWriter& json);
+    void WriteBinaryDetailedMap(class VmaBinaryStatsWriter& writer);
+
+    VkResult CreateStatsSnapshot(VmaStatsSnapshotCreateFlags flags, VmaStatsSnapshot* pSnapshot);
+    void DestroyStatsSnapshot(VmaStatsSnapshot snapshot);
+    void CompareStatsSnapshots(
+        const VmaStatsSnapshot_T& before,
+        const VmaStatsSnapshot_T& after,
+        VmaStatsSnapshotDiff* pDiff);
+    void FreeStatsSnapshotDiff(VmaStatsSnapshotDiff* pDiff);
 #endif
 
     VkResult DefragmentationBegin(
@@ -6829,6 +9381,9 @@ public:
         VmaDefragmentationContext* pContext);
     VkResult DefragmentationEnd(
         VmaDefragmentationContext context);
+    VkResult EstimateDefragmentation(
+        const VmaDefragmentationInfo2& info,
+        VmaDefragmentationEstimate* pEstimate);
 
     void GetAllocationInfo(VmaAllocation hAllocation, VmaAllocationInfo* pAllocationInfo);
     bool TouchAllocation(VmaAllocation hAllocation);
@@ -6836,6 +9391,11 @@ public:
     VkResult CreatePool(const VmaPoolCreateInfo* pCreateInfo, VmaPool* pPool);
     void DestroyPool(VmaPool pool);
     void GetPoolStats(VmaPool pool, VmaPoolStats* pPoolStats);
+    void GetPoolFragmentationScore(VmaPool pool, VmaFragmentationScore* pScore);
+    void GetMemoryTypeFragmentationScore(uint32_t memoryTypeIndex, VmaFragmentationScore* pScore);
+    void GetPoolAllocationHistograms(VmaPool pool, VmaAllocationHistograms* pHistograms);
+    void GetMemoryTypeAllocationHistograms(uint32_t memoryTypeIndex, VmaAllocationHistograms* pHistograms);
+    void SetPoolAutoDefragmentationPolicy(VmaPool pool, const VmaAutoDefragmentationPolicy* pPolicy);
 
     void SetCurrentFrameIndex(uint32_t frameIndex);
     uint32_t GetCurrentFrameIndex() const { return m_CurrentFrameIndex.load(); }
@@ -6843,6 +9403,10 @@ public:
     void MakePoolAllocationsLost(
         VmaPool hPool,
         size_t* pLostAllocationCount);
+    VkResult FreePoolAllocations(
+        VmaPool hPool,
+        uint32_t lastFrameIndex,
+        size_t* pFreedAllocationCount);
     VkResult CheckPoolCorruption(VmaPool hPool);
     VkResult CheckCorruption(uint32_t memoryTypeBits);
 
@@ -6903,6 +9467,8 @@ private:
     // Protected by m_PoolsMutex. Sorted by pointer value.
     VmaVector<VmaPool, VmaStlAllocator<VmaPool> > m_Pools;
     uint32_t m_NextPoolId;
+    // Number of pools in m_Pools with automatic defragmentation enabled. Written only while m_PoolsMutex is locked for writing.
+    VMA_ATOMIC_UINT32 m_AutoDefragmentationPoolCount;
 
     VmaVulkanFunctions m_VulkanFunctions;
 
@@ -6914,6 +9480,18 @@ private:
 
     VkDeviceSize CalcPreferredBlockSize(uint32_t memTypeIndex);
 
+    // Does the actual work of AllocateMemory(), which only updates m_Counters.
+    VkResult AllocateMemoryUncounted(
+        const VkMemoryRequirements& vkMemReq,
+        bool requiresDedicatedAllocation,
+        bool prefersDedicatedAllocation,
+        VkBuffer dedicatedBuffer,
+        VkImage dedicatedImage,
+        const VmaAllocationCreateInfo& createInfo,
+        VmaSuballocationType suballocType,
+        size_t allocationCount,
+        VmaAllocation* pAllocations);
+
     VkResult AllocateMemoryOfType(
         VkDeviceSize size,
         VkDeviceSize alignment,
@@ -6957,6 +9535,9 @@ private:
     on GPU as they support creation of required buffer for copy operations.
     */
     uint32_t CalculateGpuDefragmentationMemoryTypeBits() const;
+
+    // Performs defragmentation of the whole pool on CPU, as described by its automatic defragmentation policy.
+    void AutoDefragmentPool(VmaPool pool, uint32_t currentFrameIndex);
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -7010,33 +9591,108 @@ static void vma_delete_array(VmaAllocator hAllocator, T* ptr, size_t count)
 
 #if VMA_STATS_STRING_ENABLED
 
+/*
+Collects text in memory, or when created with a sink, passes it to the sink in
+chunks of fixed size, so memory usage stays bounded. In that mode Flush() must
+be called at the end.
+*/
 class VmaStringBuilder
 {
+    VMA_CLASS_NO_COPY(VmaStringBuilder)
 public:
-    VmaStringBuilder(VmaAllocator alloc) : m_Data(VmaStlAllocator<char>(alloc->GetAllocationCallbacks())) { }
+    VmaStringBuilder(VmaAllocator alloc) :
+        m_Data(VmaStlAllocator<char>(alloc->GetAllocationCallbacks())),
+        m_pSink(VMA_NULL),
+        m_ChunkSize(0),
+        m_SinkFailed(false)
+    {
+    }
+    VmaStringBuilder(VmaAllocator alloc, const VmaStatsSink& sink);
+    ~VmaStringBuilder() { VMA_ASSERT(m_pSink == VMA_NULL || m_Data.empty()); }
+
     size_t GetLength() const { return m_Data.size(); }
     const char* GetData() const { return m_Data.data(); }
+    // Returns true if writing to the sink failed and some text was lost.
+    bool SinkFailed() const { return m_SinkFailed; }
 
-    void Add(char ch) { m_Data.push_back(ch); }
-    void Add(const char* pStr);
+    void Add(char ch)
+    {
+        m_Data.push_back(ch);
+        if(m_Data.size() == m_ChunkSize)
+        {
+            Flush();
+        }
+    }
+    void Add(const char* pStr) { AddData(pStr, strlen(pStr)); }
+    void AddData(const void* pData, size_t size);
     void AddNewLine() { Add('\n'); }
     void AddNumber(uint32_t num);
     void AddNumber(uint64_t num);
     void AddPointer(const void* ptr);
 
+    // Passes collected text to the sink. Does nothing if there is no sink.
+    void Flush();
+
 private:
     VmaVector< char, VmaStlAllocator<char> > m_Data;
+    const VmaStatsSink* m_pSink;
+    // Capacity of m_Data when writing to sink, 0 otherwise.
+    size_t m_ChunkSize;
+    bool m_SinkFailed;
 };
 
-void VmaStringBuilder::Add(const char* pStr)
+static const size_t VMA_STATS_SINK_DEFAULT_CHUNK_SIZE = 4096;
+
+VmaStringBuilder::VmaStringBuilder(VmaAllocator alloc, const VmaStatsSink& sink) :
+    m_Data(VmaStlAllocator<char>(alloc->GetAllocationCallbacks())),
+    m_pSink(&sink),
+    m_ChunkSize(sink.chunkSize > 0 ? sink.chunkSize : VMA_STATS_SINK_DEFAULT_CHUNK_SIZE),
+    m_SinkFailed(false)
 {
-    const size_t strLen = strlen(pStr);
-    if(strLen > 0)
+    VMA_ASSERT((sink.pfnWrite != VMA_NULL) != (sink.pFile != VMA_NULL));
+    m_Data.reserve(m_ChunkSize);
+}
+
+void VmaStringBuilder::AddData(const void* pData, size_t size)
+{
+    const char* pSrc = (const char*)pData;
+    while(size > 0)
     {
         const size_t oldCount = m_Data.size();
-        m_Data.resize(oldCount + strLen);
-        memcpy(m_Data.data() + oldCount, pStr, strLen);
+        size_t countToAdd = size;
+        if(m_ChunkSize > 0)
+        {
+            countToAdd = VMA_MIN(countToAdd, m_ChunkSize - oldCount);
+        }
+        m_Data.resize(oldCount + countToAdd);
+        memcpy(m_Data.data() + oldCount, pSrc, countToAdd);
+        pSrc += countToAdd;
+        size -= countToAdd;
+        if(m_Data.size() == m_ChunkSize)
+        {
+            Flush();
+        }
+    }
+}
+
+void VmaStringBuilder::Flush()
+{
+    if(m_pSink == VMA_NULL || m_Data.empty())
+    {
+        return;
+    }
+
+    if(m_pSink->pfnWrite != VMA_NULL)
+    {
+        (*m_pSink->pfnWrite)(m_pSink->pUserData, m_Data.data(), m_Data.size());
+    }
+    else if(!m_SinkFailed)
+    {
+        FILE* const pFile = (FILE*)m_pSink->pFile;
+        m_SinkFailed = fwrite(m_Data.data(), 1, m_Data.size(), pFile) != m_Data.size();
     }
+    // Keeps capacity, so no further reallocations happen.
+    m_Data.resize(0);
 }
 
 void VmaStringBuilder::AddNumber(uint32_t num)
@@ -7744,6359 +10400,11500 @@ VmaBlockMetadata::VmaBlockMetadata(VmaAllocator hAllocator) :
 
 #if VMA_STATS_STRING_ENABLED
 
-void VmaBlockMetadata::PrintDetailedMap_Begin(class VmaJsonWriter& json,
+// Writes contents of a memory block as JSON, as part of the detailed map.
+class VmaJsonDetailedMapVisitor : public VmaDetailedMapVisitor
+{
+public:
+    VmaJsonDetailedMapVisitor(VmaJsonWriter& json) : m_Json(json) { }
+
+    virtual void BeginBlock(
+        VkDeviceSize blockSize,
+        VkDeviceSize unusedBytes,
+        size_t allocationCount,
+        size_t unusedRangeCount);
+    virtual void Allocation(
+        VkDeviceSize offset,
+        VmaAllocation hAllocation);
+    virtual void HandlelessAllocation(
+        const VmaSuballocation& suballoc);
+    virtual void UnusedRange(
+        VkDeviceSize offset,
+        VkDeviceSize size);
+    virtual void EndBlock();
+
+private:
+    VmaJsonWriter& m_Json;
+};
+
+void VmaJsonDetailedMapVisitor::BeginBlock(
+    VkDeviceSize blockSize,
     VkDeviceSize unusedBytes,
     size_t allocationCount,
-    size_t unusedRangeCount) const
+    size_t unusedRangeCount)
 {
-    json.BeginObject();
+    m_Json.BeginObject();
 
-    json.WriteString("TotalBytes");
-    json.WriteNumber(GetSize());
+    m_Json.WriteString("TotalBytes");
+    m_Json.WriteNumber(blockSize);
 
-    json.WriteString("UnusedBytes");
-    json.WriteNumber(unusedBytes);
+    m_Json.WriteString("UnusedBytes");
+    m_Json.WriteNumber(unusedBytes);
 
-    json.WriteString("Allocations");
-    json.WriteNumber((uint64_t)allocationCount);
+    m_Json.WriteString("Allocations");
+    m_Json.WriteNumber((uint64_t)allocationCount);
 
-    json.WriteString("UnusedRanges");
-    json.WriteNumber((uint64_t)unusedRangeCount);
+    m_Json.WriteString("UnusedRanges");
+    m_Json.WriteNumber((uint64_t)unusedRangeCount);
 
-    json.WriteString("Suballocations");
-    json.BeginArray();
+    m_Json.WriteString("Suballocations");
+    m_Json.BeginArray();
 }
 
-void VmaBlockMetadata::PrintDetailedMap_Allocation(class VmaJsonWriter& json,
+void VmaJsonDetailedMapVisitor::Allocation(
     VkDeviceSize offset,
-    VmaAllocation hAllocation) const
+    VmaAllocation hAllocation)
 {
-    json.BeginObject(true);
+    m_Json.BeginObject(true);
         
-    json.WriteString("Offset");
-    json.WriteNumber(offset);
+    m_Json.WriteString("Offset");
+    m_Json.WriteNumber(offset);
 
-    hAllocation->PrintParameters(json);
+    hAllocation->PrintParameters(m_Json);
 
-    json.EndObject();
+    m_Json.EndObject();
 }
 
-void VmaBlockMetadata::PrintDetailedMap_UnusedRange(class VmaJsonWriter& json,
-    VkDeviceSize offset,
-    VkDeviceSize size) const
+void VmaJsonDetailedMapVisitor::HandlelessAllocation(
+    const VmaSuballocation& suballoc)
 {
-    json.BeginObject(true);
+    m_Json.BeginObject(true);
         
-    json.WriteString("Offset");
-    json.WriteNumber(offset);
+    m_Json.WriteString("Offset");
+    m_Json.WriteNumber(suballoc.offset);
 
-    json.WriteString("Type");
-    json.WriteString(VMA_SUBALLOCATION_TYPE_NAMES[VMA_SUBALLOCATION_TYPE_FREE]);
+    m_Json.WriteString("Type");
+    m_Json.WriteString(VMA_SUBALLOCATION_TYPE_NAMES[suballoc.type]);
 
-    json.WriteString("Size");
-    json.WriteNumber(size);
+    m_Json.WriteString("Size");
+    m_Json.WriteNumber(suballoc.size);
 
-    json.EndObject();
+    m_Json.WriteString("CreationFrameIndex");
+    m_Json.WriteNumber(suballoc.frameIndex);
+
+    m_Json.EndObject();
 }
 
-void VmaBlockMetadata::PrintDetailedMap_End(class VmaJsonWriter& json) const
+void VmaJsonDetailedMapVisitor::UnusedRange(
+    VkDeviceSize offset,
+    VkDeviceSize size)
 {
-    json.EndArray();
-    json.EndObject();
-}
+    m_Json.BeginObject(true);
+        
+    m_Json.WriteString("Offset");
+    m_Json.WriteNumber(offset);
 
-#endif // #if VMA_STATS_STRING_ENABLED
+    m_Json.WriteString("Type");
+    m_Json.WriteString(VMA_SUBALLOCATION_TYPE_NAMES[VMA_SUBALLOCATION_TYPE_FREE]);
 
-////////////////////////////////////////////////////////////////////////////////
-// class VmaBlockMetadata_Generic
+    m_Json.WriteString("Size");
+    m_Json.WriteNumber(size);
 
-VmaBlockMetadata_Generic::VmaBlockMetadata_Generic(VmaAllocator hAllocator) :
-    VmaBlockMetadata(hAllocator),
-    m_FreeCount(0),
-    m_SumFreeSize(0),
-    m_Suballocations(VmaStlAllocator<VmaSuballocation>(hAllocator->GetAllocationCallbacks())),
-    m_FreeSuballocationsBySize(VmaStlAllocator<VmaSuballocationList::iterator>(hAllocator->GetAllocationCallbacks()))
-{
+    m_Json.EndObject();
 }
 
-VmaBlockMetadata_Generic::~VmaBlockMetadata_Generic()
+void VmaJsonDetailedMapVisitor::EndBlock()
 {
+    m_Json.EndArray();
+    m_Json.EndObject();
 }
 
-void VmaBlockMetadata_Generic::Init(VkDeviceSize size)
+void VmaBlockMetadata::PrintDetailedMap(class VmaJsonWriter& json) const
 {
-    VmaBlockMetadata::Init(size);
+    VmaJsonDetailedMapVisitor visitor(json);
+    VisitDetailedMap(visitor);
+}
 
-    m_FreeCount = 1;
-    m_SumFreeSize = size;
+/*
+Writes statistics and detailed map in binary format, as described in
+"docs/Binary stats file format.md". All data is written in little-endian byte order,
+as structures below are copied as they are.
+*/
 
-    VmaSuballocation suballoc = {};
-    suballoc.offset = 0;
-    suballoc.size = size;
-    suballoc.type = VMA_SUBALLOCATION_TYPE_FREE;
-    suballoc.hAllocation = VK_NULL_HANDLE;
+static const char VMA_BINARY_STATS_MAGIC[8] = { 'V', 'M', 'A', 'S', 'T', 'A', 'T', 'S' };
+static const uint32_t VMA_BINARY_STATS_VERSION = 1;
 
-    VMA_ASSERT(size > VMA_MIN_FREE_SUBALLOCATION_SIZE_TO_REGISTER);
-    m_Suballocations.push_back(suballoc);
-    VmaSuballocationList::iterator suballocItem = m_Suballocations.end();
-    --suballocItem;
-    m_FreeSuballocationsBySize.push_back(suballocItem);
-}
+enum VMA_BINARY_STATS_RECORD_TYPE
+{
+    VMA_BINARY_STATS_RECORD_TYPE_DEDICATED_ALLOCATION = 1,
+    VMA_BINARY_STATS_RECORD_TYPE_BLOCK_VECTOR = 2,
+    VMA_BINARY_STATS_RECORD_TYPE_BLOCK = 3,
+    VMA_BINARY_STATS_RECORD_TYPE_ALLOCATION = 4,
+    VMA_BINARY_STATS_RECORD_TYPE_UNUSED_RANGE = 5,
+    VMA_BINARY_STATS_RECORD_TYPE_HISTOGRAM_BUCKET = 6,
+};
 
-bool VmaBlockMetadata_Generic::Validate() const
+enum VMA_BINARY_STATS_HISTOGRAM
 {
-    VMA_VALIDATE(!m_Suballocations.empty());
-    
-    // Expected offset of new suballocation as calculated from previous ones.
-    VkDeviceSize calculatedOffset = 0;
-    // Expected number of free suballocations as calculated from traversing their list.
-    uint32_t calculatedFreeCount = 0;
-    // Expected sum size of free suballocations as calculated from traversing their list.
-    VkDeviceSize calculatedSumFreeSize = 0;
-    // Expected number of free suballocations that should be registered in
-    // m_FreeSuballocationsBySize calculated from traversing their list.
-    size_t freeSuballocationsToRegister = 0;
-    // True if previous visited suballocation was free.
-    bool prevFree = false;
+    VMA_BINARY_STATS_HISTOGRAM_ALLOCATION_SIZE = 0,
+    VMA_BINARY_STATS_HISTOGRAM_ALLOCATION_LIFETIME = 1,
+};
 
-    for(VmaSuballocationList::const_iterator suballocItem = m_Suballocations.cbegin();
-        suballocItem != m_Suballocations.cend();
-        ++suballocItem)
-    {
-        const VmaSuballocation& subAlloc = *suballocItem;
-        
-        // Actual offset of this suballocation doesn't match expected one.
-        VMA_VALIDATE(subAlloc.offset == calculatedOffset);
+enum VMA_BINARY_STATS_RECORD_FLAGS
+{
+    // Allocation: u64[2] is value of the user data pointer.
+    VMA_BINARY_STATS_RECORD_FLAG_USER_DATA = 0x1,
+    // Allocation: u64[2] is offset of the user data string in the string table.
+    VMA_BINARY_STATS_RECORD_FLAG_USER_DATA_STRING = 0x2,
+    // Allocation made without VmaAllocation object. Last use frame index is unknown.
+    VMA_BINARY_STATS_RECORD_FLAG_HANDLELESS = 0x4,
+    // Block vector: it belongs to a custom pool.
+    VMA_BINARY_STATS_RECORD_FLAG_CUSTOM_POOL = 0x1,
+};
 
-        const bool currFree = (subAlloc.type == VMA_SUBALLOCATION_TYPE_FREE);
-        // Two adjacent free suballocations are invalid. They should be merged.
-        VMA_VALIDATE(!prevFree || !currFree);
+struct VmaBinaryStatsHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t recordSize;
+    uint32_t memoryHeapCount;
+    uint32_t memoryTypeCount;
+    uint32_t reserved;
+};
 
-        VMA_VALIDATE(currFree == (subAlloc.hAllocation == VK_NULL_HANDLE));
+struct VmaBinaryStatsMemoryHeap
+{
+    uint64_t size;
+    uint32_t flags;
+    uint32_t reserved;
+};
 
-        if(currFree)
-        {
-            calculatedSumFreeSize += subAlloc.size;
-            ++calculatedFreeCount;
-            if(subAlloc.size >= VMA_MIN_FREE_SUBALLOCATION_SIZE_TO_REGISTER)
-            {
-                ++freeSuballocationsToRegister;
-            }
+struct VmaBinaryStatsMemoryType
+{
+    uint32_t propertyFlags;
+    uint32_t heapIndex;
+};
 
-            // Margin required between allocations - every free space must be at least that large.
-            VMA_VALIDATE(subAlloc.size >= VMA_DEBUG_MARGIN);
-        }
-        else
-        {
-            VMA_VALIDATE(subAlloc.hAllocation->GetOffset() == subAlloc.offset);
-            VMA_VALIDATE(subAlloc.hAllocation->GetSize() == subAlloc.size);
+// Same as VmaStatInfo, with explicit padding.
+struct VmaBinaryStatsStatInfo
+{
+    uint32_t blockCount;
+    uint32_t allocationCount;
+    uint32_t unusedRangeCount;
+    uint32_t reserved;
+    uint64_t usedBytes;
+    uint64_t unusedBytes;
+    uint64_t allocationSizeMin, allocationSizeAvg, allocationSizeMax;
+    uint64_t unusedRangeSizeMin, unusedRangeSizeAvg, unusedRangeSizeMax;
+};
 
-            // Margin required between allocations - previous allocation must be free.
-            VMA_VALIDATE(VMA_DEBUG_MARGIN == 0 || prevFree);
-        }
+// Meaning of members depends on type, as described in "docs/Binary stats file format.md".
+struct VmaBinaryStatsRecord
+{
+    uint8_t type; // VMA_BINARY_STATS_RECORD_TYPE
+    uint8_t subType;
+    uint16_t flags; // VMA_BINARY_STATS_RECORD_FLAGS
+    uint32_t u32_0;
+    uint64_t u64[3];
+    uint32_t u32_1;
+    uint32_t u32_2;
+};
 
-        calculatedOffset += subAlloc.size;
-        prevFree = currFree;
-    }
+struct VmaBinaryStatsTrailer
+{
+    uint64_t recordCount;
+    uint64_t stringTableSize;
+};
 
-    // Number of free suballocations registered in m_FreeSuballocationsBySize doesn't
-    // match expected one.
-    VMA_VALIDATE(m_FreeSuballocationsBySize.size() == freeSuballocationsToRegister);
+class VmaBinaryStatsWriter : public VmaDetailedMapVisitor
+{
+    VMA_CLASS_NO_COPY(VmaBinaryStatsWriter)
+public:
+    VmaBinaryStatsWriter(VmaAllocator hAllocator, VmaStringBuilder& sb);
 
-    VkDeviceSize lastSize = 0;
-    for(size_t i = 0; i < m_FreeSuballocationsBySize.size(); ++i)
-    {
-        VmaSuballocationList::iterator suballocItem = m_FreeSuballocationsBySize[i];
-        
-        // Only free suballocations can be registered in m_FreeSuballocationsBySize.
-        VMA_VALIDATE(suballocItem->type == VMA_SUBALLOCATION_TYPE_FREE);
-        // They must be sorted by size ascending.
-        VMA_VALIDATE(suballocItem->size >= lastSize);
+    // Writes header, memory heaps and types, and statistics. Must be called first.
+    void WriteBegin(const VmaStats& stats);
+    void WriteDedicatedAllocation(uint32_t memTypeIndex, VmaAllocation hAllocation);
+    // Following blocks belong to this block vector.
+    void WriteBlockVector(
+        bool isCustomPool,
+        uint32_t poolId,
+        uint32_t memTypeIndex,
+        VkDeviceSize preferredBlockSize,
+        size_t minBlockCount,
+        size_t maxBlockCount,
+        uint32_t frameInUseCount,
+        uint32_t algorithm);
+    // To be called after WriteBlockVector(), before its blocks.
+    void WriteAllocationHistograms(const VmaAllocationHistograms& histograms);
+    // Sets ID to be written by next BeginBlock().
+    void SetBlockId(uint32_t blockId) { m_BlockId = blockId; }
+    // Writes string table and trailer. Must be called last.
+    void WriteEnd();
+
+    virtual void BeginBlock(
+        VkDeviceSize blockSize,
+        VkDeviceSize unusedBytes,
+        size_t allocationCount,
+        size_t unusedRangeCount);
+    virtual void Allocation(
+        VkDeviceSize offset,
+        VmaAllocation hAllocation);
+    virtual void HandlelessAllocation(
+        const VmaSuballocation& suballoc);
+    virtual void UnusedRange(
+        VkDeviceSize offset,
+        VkDeviceSize size);
+    virtual void EndBlock() { }
 
-        lastSize = suballocItem->size;
-    }
+private:
+    const VmaAllocator m_hAllocator;
+    VmaStringBuilder& m_SB;
+    VmaVector< char, VmaStlAllocator<char> > m_StringTable;
+    uint64_t m_RecordCount;
+    uint32_t m_BlockId;
+
+    void WriteRecord(const VmaBinaryStatsRecord& record);
+    void WriteStatInfo(const VmaStatInfo& statInfo);
+    // Fills everything except type and u64[0].
+    void FillAllocationRecord(VmaBinaryStatsRecord& outRecord, VmaAllocation hAllocation);
+};
 
-    // Check if totals match calculacted values.
-    VMA_VALIDATE(ValidateFreeSuballocationList());
-    VMA_VALIDATE(calculatedOffset == GetSize());
-    VMA_VALIDATE(calculatedSumFreeSize == m_SumFreeSize);
-    VMA_VALIDATE(calculatedFreeCount == m_FreeCount);
-
-    return true;
+VmaBinaryStatsWriter::VmaBinaryStatsWriter(VmaAllocator hAllocator, VmaStringBuilder& sb) :
+    m_hAllocator(hAllocator),
+    m_SB(sb),
+    m_StringTable(VmaStlAllocator<char>(hAllocator->GetAllocationCallbacks())),
+    m_RecordCount(0),
+    m_BlockId(0)
+{
+    VMA_ASSERT(sizeof(VmaBinaryStatsHeader) == 32 && sizeof(VmaBinaryStatsRecord) == 40);
+    const uint16_t byteOrderTest = 1;
+    VMA_ASSERT(*(const uint8_t*)&byteOrderTest == 1 && "Binary stats require little-endian platform.");
+    (void)byteOrderTest;
 }
 
-VkDeviceSize VmaBlockMetadata_Generic::GetUnusedRangeSizeMax() const
+void VmaBinaryStatsWriter::WriteBegin(const VmaStats& stats)
 {
-    if(!m_FreeSuballocationsBySize.empty())
+    const uint32_t heapCount = m_hAllocator->GetMemoryHeapCount();
+    const uint32_t typeCount = m_hAllocator->GetMemoryTypeCount();
+
+    VmaBinaryStatsHeader header = {};
+    memcpy(header.magic, VMA_BINARY_STATS_MAGIC, sizeof(header.magic));
+    header.version = VMA_BINARY_STATS_VERSION;
+    header.headerSize = sizeof(VmaBinaryStatsHeader);
+    header.recordSize = sizeof(VmaBinaryStatsRecord);
+    header.memoryHeapCount = heapCount;
+    header.memoryTypeCount = typeCount;
+    m_SB.AddData(&header, sizeof(header));
+
+    for(uint32_t heapIndex = 0; heapIndex < heapCount; ++heapIndex)
     {
-        return m_FreeSuballocationsBySize.back()->size;
+        VmaBinaryStatsMemoryHeap heap = {};
+        heap.size = m_hAllocator->m_MemProps.memoryHeaps[heapIndex].size;
+        heap.flags = m_hAllocator->m_MemProps.memoryHeaps[heapIndex].flags;
+        m_SB.AddData(&heap, sizeof(heap));
     }
-    else
+    for(uint32_t typeIndex = 0; typeIndex < typeCount; ++typeIndex)
     {
-        return 0;
+        VmaBinaryStatsMemoryType type = {};
+        type.propertyFlags = m_hAllocator->m_MemProps.memoryTypes[typeIndex].propertyFlags;
+        type.heapIndex = m_hAllocator->m_MemProps.memoryTypes[typeIndex].heapIndex;
+        m_SB.AddData(&type, sizeof(type));
+    }
+
+    WriteStatInfo(stats.total);
+    for(uint32_t heapIndex = 0; heapIndex < heapCount; ++heapIndex)
+    {
+        WriteStatInfo(stats.memoryHeap[heapIndex]);
+    }
+    for(uint32_t typeIndex = 0; typeIndex < typeCount; ++typeIndex)
+    {
+        WriteStatInfo(stats.memoryType[typeIndex]);
     }
 }
 
-bool VmaBlockMetadata_Generic::IsEmpty() const
+void VmaBinaryStatsWriter::WriteDedicatedAllocation(uint32_t memTypeIndex, VmaAllocation hAllocation)
 {
-    return (m_Suballocations.size() == 1) && (m_FreeCount == 1);
+    VmaBinaryStatsRecord record = {};
+    record.type = VMA_BINARY_STATS_RECORD_TYPE_DEDICATED_ALLOCATION;
+    FillAllocationRecord(record, hAllocation);
+    record.u64[0] = memTypeIndex;
+    WriteRecord(record);
 }
 
-void VmaBlockMetadata_Generic::CalcAllocationStatInfo(VmaStatInfo& outInfo) const
+void VmaBinaryStatsWriter::WriteBlockVector(
+    bool isCustomPool,
+    uint32_t poolId,
+    uint32_t memTypeIndex,
+    VkDeviceSize preferredBlockSize,
+    size_t minBlockCount,
+    size_t maxBlockCount,
+    uint32_t frameInUseCount,
+    uint32_t algorithm)
 {
-    outInfo.blockCount = 1;
-
-    const uint32_t rangeCount = (uint32_t)m_Suballocations.size();
-    outInfo.allocationCount = rangeCount - m_FreeCount;
-    outInfo.unusedRangeCount = m_FreeCount;
-    
-    outInfo.unusedBytes = m_SumFreeSize;
-    outInfo.usedBytes = GetSize() - outInfo.unusedBytes;
+    VmaBinaryStatsRecord record = {};
+    record.type = VMA_BINARY_STATS_RECORD_TYPE_BLOCK_VECTOR;
+    record.subType = (uint8_t)algorithm;
+    record.flags = isCustomPool ? VMA_BINARY_STATS_RECORD_FLAG_CUSTOM_POOL : 0;
+    record.u32_0 = memTypeIndex;
+    record.u64[0] = preferredBlockSize;
+    record.u64[1] = minBlockCount;
+    record.u64[2] = maxBlockCount < SIZE_MAX ? (uint64_t)maxBlockCount : UINT64_MAX;
+    record.u32_1 = isCustomPool ? poolId : 0;
+    record.u32_2 = frameInUseCount;
+    WriteRecord(record);
+}
 
-    outInfo.allocationSizeMin = UINT64_MAX;
-    outInfo.allocationSizeMax = 0;
-    outInfo.unusedRangeSizeMin = UINT64_MAX;
-    outInfo.unusedRangeSizeMax = 0;
+void VmaBinaryStatsWriter::WriteAllocationHistograms(const VmaAllocationHistograms& histograms)
+{
+    VmaBinaryStatsRecord record = {};
+    record.type = VMA_BINARY_STATS_RECORD_TYPE_HISTOGRAM_BUCKET;
 
-    for(VmaSuballocationList::const_iterator suballocItem = m_Suballocations.cbegin();
-        suballocItem != m_Suballocations.cend();
-        ++suballocItem)
+    record.subType = VMA_BINARY_STATS_HISTOGRAM_ALLOCATION_SIZE;
+    for(uint32_t i = 0; i < VMA_SIZE_HISTOGRAM_BUCKET_COUNT; ++i)
     {
-        const VmaSuballocation& suballoc = *suballocItem;
-        if(suballoc.type != VMA_SUBALLOCATION_TYPE_FREE)
+        if(histograms.allocationSize[i] > 0)
         {
-            outInfo.allocationSizeMin = VMA_MIN(outInfo.allocationSizeMin, suballoc.size);
-            outInfo.allocationSizeMax = VMA_MAX(outInfo.allocationSizeMax, suballoc.size);
+            record.u32_0 = i;
+            record.u64[0] = histograms.allocationSize[i];
+            WriteRecord(record);
         }
-        else
+    }
+
+    record.subType = VMA_BINARY_STATS_HISTOGRAM_ALLOCATION_LIFETIME;
+    for(uint32_t i = 0; i < VMA_LIFETIME_HISTOGRAM_BUCKET_COUNT; ++i)
+    {
+        if(histograms.allocationLifetime[i] > 0)
         {
-            outInfo.unusedRangeSizeMin = VMA_MIN(outInfo.unusedRangeSizeMin, suballoc.size);
-            outInfo.unusedRangeSizeMax = VMA_MAX(outInfo.unusedRangeSizeMax, suballoc.size);
+            record.u32_0 = i;
+            record.u64[0] = histograms.allocationLifetime[i];
+            WriteRecord(record);
         }
     }
 }
 
-void VmaBlockMetadata_Generic::AddPoolStats(VmaPoolStats& inoutStats) const
+void VmaBinaryStatsWriter::WriteEnd()
 {
-    const uint32_t rangeCount = (uint32_t)m_Suballocations.size();
+    if(!m_StringTable.empty())
+    {
+        m_SB.AddData(m_StringTable.data(), m_StringTable.size());
+    }
 
-    inoutStats.size += GetSize();
-    inoutStats.unusedSize += m_SumFreeSize;
-    inoutStats.allocationCount += rangeCount - m_FreeCount;
-    inoutStats.unusedRangeCount += m_FreeCount;
-    inoutStats.unusedRangeSizeMax = VMA_MAX(inoutStats.unusedRangeSizeMax, GetUnusedRangeSizeMax());
+    VmaBinaryStatsTrailer trailer = {};
+    trailer.recordCount = m_RecordCount;
+    trailer.stringTableSize = m_StringTable.size();
+    m_SB.AddData(&trailer, sizeof(trailer));
 }
 
-#if VMA_STATS_STRING_ENABLED
+void VmaBinaryStatsWriter::BeginBlock(
+    VkDeviceSize blockSize,
+    VkDeviceSize unusedBytes,
+    size_t allocationCount,
+    size_t unusedRangeCount)
+{
+    VmaBinaryStatsRecord record = {};
+    record.type = VMA_BINARY_STATS_RECORD_TYPE_BLOCK;
+    record.u32_0 = m_BlockId;
+    record.u64[0] = blockSize;
+    record.u64[1] = unusedBytes;
+    record.u64[2] = allocationCount;
+    record.u32_1 = (uint32_t)unusedRangeCount;
+    WriteRecord(record);
+}
 
-void VmaBlockMetadata_Generic::PrintDetailedMap(class VmaJsonWriter& json) const
+void VmaBinaryStatsWriter::Allocation(
+    VkDeviceSize offset,
+    VmaAllocation hAllocation)
 {
-    PrintDetailedMap_Begin(json,
-        m_SumFreeSize, // unusedBytes
-        m_Suballocations.size() - (size_t)m_FreeCount, // allocationCount
-        m_FreeCount); // unusedRangeCount
+    VmaBinaryStatsRecord record = {};
+    record.type = VMA_BINARY_STATS_RECORD_TYPE_ALLOCATION;
+    FillAllocationRecord(record, hAllocation);
+    record.u64[0] = offset;
+    WriteRecord(record);
+}
 
-    size_t i = 0;
-    for(VmaSuballocationList::const_iterator suballocItem = m_Suballocations.cbegin();
-        suballocItem != m_Suballocations.cend();
-        ++suballocItem, ++i)
+void VmaBinaryStatsWriter::HandlelessAllocation(
+    const VmaSuballocation& suballoc)
+{
+    VmaBinaryStatsRecord record = {};
+    record.type = VMA_BINARY_STATS_RECORD_TYPE_ALLOCATION;
+    record.subType = (uint8_t)suballoc.type;
+    record.flags = VMA_BINARY_STATS_RECORD_FLAG_HANDLELESS;
+    record.u64[0] = suballoc.offset;
+    record.u64[1] = suballoc.size;
+    record.u32_1 = suballoc.frameIndex;
+    WriteRecord(record);
+}
+
+void VmaBinaryStatsWriter::UnusedRange(
+    VkDeviceSize offset,
+    VkDeviceSize size)
+{
+    VmaBinaryStatsRecord record = {};
+    record.type = VMA_BINARY_STATS_RECORD_TYPE_UNUSED_RANGE;
+    record.u64[0] = offset;
+    record.u64[1] = size;
+    WriteRecord(record);
+}
+
+void VmaBinaryStatsWriter::WriteRecord(const VmaBinaryStatsRecord& record)
+{
+    m_SB.AddData(&record, sizeof(record));
+    ++m_RecordCount;
+}
+
+void VmaBinaryStatsWriter::WriteStatInfo(const VmaStatInfo& statInfo)
+{
+    VmaBinaryStatsStatInfo dst = {};
+    dst.blockCount = statInfo.blockCount;
+    dst.allocationCount = statInfo.allocationCount;
+    dst.unusedRangeCount = statInfo.unusedRangeCount;
+    dst.usedBytes = statInfo.usedBytes;
+    dst.unusedBytes = statInfo.unusedBytes;
+    dst.allocationSizeMin = statInfo.allocationSizeMin;
+    dst.allocationSizeAvg = statInfo.allocationSizeAvg;
+    dst.allocationSizeMax = statInfo.allocationSizeMax;
+    dst.unusedRangeSizeMin = statInfo.unusedRangeSizeMin;
+    dst.unusedRangeSizeAvg = statInfo.unusedRangeSizeAvg;
+    dst.unusedRangeSizeMax = statInfo.unusedRangeSizeMax;
+    m_SB.AddData(&dst, sizeof(dst));
+}
+
+void VmaBinaryStatsWriter::FillAllocationRecord(VmaBinaryStatsRecord& outRecord, VmaAllocation hAllocation)
+{
+    outRecord.subType = (uint8_t)hAllocation->GetSuballocationType();
+    outRecord.u32_0 = hAllocation->GetBufferImageUsage();
+    outRecord.u64[1] = hAllocation->GetSize();
+    outRecord.u32_1 = hAllocation->GetCreationFrameIndex();
+    outRecord.u32_2 = hAllocation->GetLastUseFrameIndex();
+
+    void* const pUserData = hAllocation->GetUserData();
+    if(pUserData != VMA_NULL)
     {
-        if(suballocItem->type == VMA_SUBALLOCATION_TYPE_FREE)
+        if(hAllocation->IsUserDataString())
         {
-            PrintDetailedMap_UnusedRange(json, suballocItem->offset, suballocItem->size);
+            const char* const pStr = (const char*)pUserData;
+            const size_t strLen = strlen(pStr);
+            const size_t strOffset = m_StringTable.size();
+            m_StringTable.resize(strOffset + strLen + 1);
+            memcpy(m_StringTable.data() + strOffset, pStr, strLen + 1);
+            outRecord.flags = VMA_BINARY_STATS_RECORD_FLAG_USER_DATA_STRING;
+            outRecord.u64[2] = strOffset;
         }
         else
         {
-            PrintDetailedMap_Allocation(json, suballocItem->offset, suballocItem->hAllocation);
+            outRecord.flags = VMA_BINARY_STATS_RECORD_FLAG_USER_DATA;
+            outRecord.u64[2] = (uint64_t)(uintptr_t)pUserData;
         }
     }
-
-    PrintDetailedMap_End(json);
 }
 
-#endif // #if VMA_STATS_STRING_ENABLED
 
-bool VmaBlockMetadata_Generic::CreateAllocationRequest(
-    uint32_t currentFrameIndex,
-    uint32_t frameInUseCount,
-    VkDeviceSize bufferImageGranularity,
-    VkDeviceSize allocSize,
-    VkDeviceSize allocAlignment,
-    bool upperAddress,
-    VmaSuballocationType allocType,
-    bool canMakeOtherLost,
-    uint32_t strategy,
-    VmaAllocationRequest* pAllocationRequest)
-{
-    VMA_ASSERT(allocSize > 0);
-    VMA_ASSERT(!upperAddress);
-    VMA_ASSERT(allocType != VMA_SUBALLOCATION_TYPE_FREE);
-    VMA_ASSERT(pAllocationRequest != VMA_NULL);
-    VMA_HEAVY_ASSERT(Validate());
+////////////////////////////////////////////////////////////////////////////////
+// VmaStatsSnapshot_T, VmaStatsSnapshotBuilder
 
-    pAllocationRequest->type = VmaAllocationRequestType::Normal;
+static inline uint64_t VmaStatsSnapshotPoolKey(bool isCustomPool, uint32_t poolId, uint32_t memTypeIndex)
+{
+    // Default pools first, sorted by memory type index, then custom pools sorted by ID.
+    return isCustomPool ? ((1ull << 32) | poolId) : memTypeIndex;
+}
 
-    // There is not enough total free space in this block to fullfill the request: Early return.
-    if(canMakeOtherLost == false &&
-        m_SumFreeSize < allocSize + 2 * VMA_DEBUG_MARGIN)
+struct VmaStatsSnapshotPoolLess
+{
+    bool operator()(const VmaPoolStatsDelta& lhs, const VmaPoolStatsDelta& rhs) const
     {
-        return false;
+        return VmaStatsSnapshotPoolKey(lhs.isCustomPool != VK_FALSE, lhs.poolId, lhs.memoryTypeIndex) <
+            VmaStatsSnapshotPoolKey(rhs.isCustomPool != VK_FALSE, rhs.poolId, rhs.memoryTypeIndex);
     }
+};
 
-    // New algorithm, efficiently searching freeSuballocationsBySize.
-    const size_t freeSuballocCount = m_FreeSuballocationsBySize.size();
-    if(freeSuballocCount > 0)
+struct VmaStatsSnapshotBlockLess
+{
+    bool operator()(const VmaBlockSnapshot& lhs, const VmaBlockSnapshot& rhs) const
     {
-        if(strategy == VMA_ALLOCATION_CREATE_STRATEGY_BEST_FIT_BIT)
-        {
-            // Find first free suballocation with size not less than allocSize + 2 * VMA_DEBUG_MARGIN.
-            VmaSuballocationList::iterator* const it = VmaBinaryFindFirstNotLess(
-                m_FreeSuballocationsBySize.data(),
-                m_FreeSuballocationsBySize.data() + freeSuballocCount,
-                allocSize + 2 * VMA_DEBUG_MARGIN,
-                VmaSuballocationItemSizeLess());
-            size_t index = it - m_FreeSuballocationsBySize.data();
-            for(; index < freeSuballocCount; ++index)
-            {
-                if(CheckAllocation(
-                    currentFrameIndex,
-                    frameInUseCount,
-                    bufferImageGranularity,
-                    allocSize,
-                    allocAlignment,
-                    allocType,
-                    m_FreeSuballocationsBySize[index],
-                    false, // canMakeOtherLost
-                    &pAllocationRequest->offset,
-                    &pAllocationRequest->itemsToMakeLostCount,
-                    &pAllocationRequest->sumFreeSize,
-                    &pAllocationRequest->sumItemSize))
-                {
-                    pAllocationRequest->item = m_FreeSuballocationsBySize[index];
-                    return true;
-                }
-            }
-        }
-        else if(strategy == VMA_ALLOCATION_INTERNAL_STRATEGY_MIN_OFFSET)
-        {
-            for(VmaSuballocationList::iterator it = m_Suballocations.begin();
-                it != m_Suballocations.end();
-                ++it)
-            {
-                if(it->type == VMA_SUBALLOCATION_TYPE_FREE && CheckAllocation(
-                    currentFrameIndex,
-                    frameInUseCount,
-                    bufferImageGranularity,
-                    allocSize,
-                    allocAlignment,
-                    allocType,
-                    it,
-                    false, // canMakeOtherLost
-                    &pAllocationRequest->offset,
-                    &pAllocationRequest->itemsToMakeLostCount,
-                    &pAllocationRequest->sumFreeSize,
-                    &pAllocationRequest->sumItemSize))
-                {
-                    pAllocationRequest->item = it;
-                    return true;
-                }
-            }
-        }
-        else // WORST_FIT, FIRST_FIT
+        const uint64_t lhsPoolKey = VmaStatsSnapshotPoolKey(lhs.isCustomPool != VK_FALSE, lhs.poolId, lhs.memoryTypeIndex);
+        const uint64_t rhsPoolKey = VmaStatsSnapshotPoolKey(rhs.isCustomPool != VK_FALSE, rhs.poolId, rhs.memoryTypeIndex);
+        if(lhsPoolKey != rhsPoolKey)
         {
-            // Search staring from biggest suballocations.
-            for(size_t index = freeSuballocCount; index--; )
-            {
-                if(CheckAllocation(
-                    currentFrameIndex,
-                    frameInUseCount,
-                    bufferImageGranularity,
-                    allocSize,
-                    allocAlignment,
-                    allocType,
-                    m_FreeSuballocationsBySize[index],
-                    false, // canMakeOtherLost
-                    &pAllocationRequest->offset,
-                    &pAllocationRequest->itemsToMakeLostCount,
-                    &pAllocationRequest->sumFreeSize,
-                    &pAllocationRequest->sumItemSize))
-                {
-                    pAllocationRequest->item = m_FreeSuballocationsBySize[index];
-                    return true;
-                }
-            }
+            return lhsPoolKey < rhsPoolKey;
         }
+        return lhs.blockId < rhs.blockId;
     }
+};
 
-    if(canMakeOtherLost)
+// Allocations are identified by position in memory. Other members are compared separately.
+struct VmaStatsSnapshotAllocationLess
+{
+    bool operator()(const VmaAllocationSnapshot& lhs, const VmaAllocationSnapshot& rhs) const
     {
-        // Brute-force algorithm. TODO: Come up with something better.
-
-        bool found = false;
-        VmaAllocationRequest tmpAllocRequest = {};
-        tmpAllocRequest.type = VmaAllocationRequestType::Normal;
-        for(VmaSuballocationList::iterator suballocIt = m_Suballocations.begin();
-            suballocIt != m_Suballocations.end();
-            ++suballocIt)
+        if(lhs.deviceMemory != rhs.deviceMemory)
         {
-            if(suballocIt->type == VMA_SUBALLOCATION_TYPE_FREE ||
-                suballocIt->hAllocation->CanBecomeLost())
-            {
-                if(CheckAllocation(
-                    currentFrameIndex,
-                    frameInUseCount,
-                    bufferImageGranularity,
-                    allocSize,
-                    allocAlignment,
-                    allocType,
-                    suballocIt,
-                    canMakeOtherLost,
-                    &tmpAllocRequest.offset,
-                    &tmpAllocRequest.itemsToMakeLostCount,
-                    &tmpAllocRequest.sumFreeSize,
-                    &tmpAllocRequest.sumItemSize))
-                {
-                    if(strategy == VMA_ALLOCATION_CREATE_STRATEGY_FIRST_FIT_BIT)
-                    {
-                        *pAllocationRequest = tmpAllocRequest;
-                        pAllocationRequest->item = suballocIt;
-                        break;
-                    }
-                    if(!found || tmpAllocRequest.CalcCost() < pAllocationRequest->CalcCost())
-                    {
-                        *pAllocationRequest = tmpAllocRequest;
-                        pAllocationRequest->item = suballocIt;
-                        found = true;
-                    }
-                }
-            }
+            return lhs.deviceMemory < rhs.deviceMemory;
         }
-
-        return found;
+        return lhs.offset < rhs.offset;
     }
+};
 
-    return false;
+VmaStatsSnapshot_T::VmaStatsSnapshot_T(
+    const VkAllocationCallbacks* pAllocationCallbacks,
+    uint32_t memoryTypeCount,
+    bool hasAllocations) :
+    m_MemoryTypeCount(memoryTypeCount),
+    m_HasAllocations(hasAllocations),
+    m_Pools(VmaStlAllocator<VmaPoolStatsDelta>(pAllocationCallbacks)),
+    m_Blocks(VmaStlAllocator<VmaBlockSnapshot>(pAllocationCallbacks)),
+    m_Allocations(VmaStlAllocator<VmaAllocationSnapshot>(pAllocationCallbacks))
+{
+    memset(m_MemoryTypes, 0, sizeof(m_MemoryTypes));
 }
 
-bool VmaBlockMetadata_Generic::MakeRequestedAllocationsLost(
-    uint32_t currentFrameIndex,
-    uint32_t frameInUseCount,
-    VmaAllocationRequest* pAllocationRequest)
+VmaStatsSnapshotBuilder::VmaStatsSnapshotBuilder(
+    const VkAllocationCallbacks* pAllocationCallbacks,
+    VmaStatsSnapshot_T& snapshot) :
+    m_pAllocationCallbacks(pAllocationCallbacks),
+    m_Snapshot(snapshot),
+    m_Runs(VmaStlAllocator<AllocationRun>(pAllocationCallbacks)),
+    m_CurrentMemTypeIndex(UINT32_MAX),
+    m_CurrentMemory(VK_NULL_HANDLE)
 {
-    VMA_ASSERT(pAllocationRequest && pAllocationRequest->type == VmaAllocationRequestType::Normal);
+}
 
-    while(pAllocationRequest->itemsToMakeLostCount > 0)
-    {
-        if(pAllocationRequest->item->type == VMA_SUBALLOCATION_TYPE_FREE)
-        {
-            ++pAllocationRequest->item;
-        }
-        VMA_ASSERT(pAllocationRequest->item != m_Suballocations.end());
-        VMA_ASSERT(pAllocationRequest->item->hAllocation != VK_NULL_HANDLE);
-        VMA_ASSERT(pAllocationRequest->item->hAllocation->CanBecomeLost());
-        if(pAllocationRequest->item->hAllocation->MakeLost(currentFrameIndex, frameInUseCount))
-        {
-            pAllocationRequest->item = FreeSuballocation(pAllocationRequest->item);
-            --pAllocationRequest->itemsToMakeLostCount;
-        }
-        else
-        {
-            return false;
-        }
-    }
+void VmaStatsSnapshotBuilder::AddPool(
+    uint32_t memTypeIndex,
+    bool isCustomPool,
+    uint32_t poolId,
+    const VmaStatsDelta& stats)
+{
+    VmaPoolStatsDelta pool = {};
+    pool.memoryTypeIndex = memTypeIndex;
+    pool.isCustomPool = isCustomPool ? VK_TRUE : VK_FALSE;
+    pool.poolId = isCustomPool ? poolId : 0;
+    pool.delta = stats;
+    m_Snapshot.m_Pools.push_back(pool);
 
-    VMA_HEAVY_ASSERT(Validate());
-    VMA_ASSERT(pAllocationRequest->item != m_Suballocations.end());
-    VMA_ASSERT(pAllocationRequest->item->type == VMA_SUBALLOCATION_TYPE_FREE);
-    
-    return true;
+    VmaStatsDelta& memTypeStats = m_Snapshot.m_MemoryTypes[memTypeIndex];
+    memTypeStats.blockCount += stats.blockCount;
+    memTypeStats.allocationCount += stats.allocationCount;
+    memTypeStats.usedBytes += stats.usedBytes;
+    memTypeStats.unusedBytes += stats.unusedBytes;
 }
 
-uint32_t VmaBlockMetadata_Generic::MakeAllocationsLost(uint32_t currentFrameIndex, uint32_t frameInUseCount)
+void VmaStatsSnapshotBuilder::AddBlock(const VmaBlockSnapshot& block)
 {
-    uint32_t lostAllocationCount = 0;
-    for(VmaSuballocationList::iterator it = m_Suballocations.begin();
-        it != m_Suballocations.end();
-        ++it)
-    {
-        if(it->type != VMA_SUBALLOCATION_TYPE_FREE &&
-            it->hAllocation->CanBecomeLost() &&
-            it->hAllocation->MakeLost(currentFrameIndex, frameInUseCount))
-        {
-            it = FreeSuballocation(it);
-            ++lostAllocationCount;
-        }
-    }
-    return lostAllocationCount;
+    m_Snapshot.m_Blocks.push_back(block);
 }
 
-VkResult VmaBlockMetadata_Generic::CheckCorruption(const void* pBlockData)
+void VmaStatsSnapshotBuilder::AddDedicatedAllocation(
+    uint32_t memTypeIndex,
+    VmaAllocation hAllocation)
 {
-    for(VmaSuballocationList::iterator it = m_Suballocations.begin();
-        it != m_Suballocations.end();
-        ++it)
+    const VkDeviceSize size = hAllocation->GetSize();
+
+    VmaStatsDelta& memTypeStats = m_Snapshot.m_MemoryTypes[memTypeIndex];
+    ++memTypeStats.blockCount;
+    ++memTypeStats.allocationCount;
+    memTypeStats.usedBytes += (int64_t)size;
+
+    if(CapturesAllocations())
     {
-        if(it->type != VMA_SUBALLOCATION_TYPE_FREE)
-        {
-            if(!VmaValidateMagicValue(pBlockData, it->offset - VMA_DEBUG_MARGIN))
-            {
-                VMA_ASSERT(0 && "MEMORY CORRUPTION DETECTED BEFORE VALIDATED ALLOCATION!");
-                return VK_ERROR_VALIDATION_FAILED_EXT;
-            }
-            if(!VmaValidateMagicValue(pBlockData, it->offset + it->size))
-            {
-                VMA_ASSERT(0 && "MEMORY CORRUPTION DETECTED AFTER VALIDATED ALLOCATION!");
-                return VK_ERROR_VALIDATION_FAILED_EXT;
-            }
-        }
+        SetCurrentBlock(memTypeIndex, hAllocation->GetMemory());
+        AddAllocation(hAllocation, 0, size, hAllocation->GetCreationFrameIndex());
+        EndBlock();
     }
+}
 
-    return VK_SUCCESS;
+void VmaStatsSnapshotBuilder::SetCurrentBlock(
+    uint32_t memTypeIndex,
+    VkDeviceMemory memory)
+{
+    m_CurrentMemTypeIndex = memTypeIndex;
+    m_CurrentMemory = memory;
+    const AllocationRun run = { memory, m_Snapshot.m_Allocations.size(), 0 };
+    m_Runs.push_back(run);
 }
 
-void VmaBlockMetadata_Generic::Alloc(
-    const VmaAllocationRequest& request,
-    VmaSuballocationType type,
-    VkDeviceSize allocSize,
-    VmaAllocation hAllocation)
+void VmaStatsSnapshotBuilder::BeginBlock(
+    VkDeviceSize blockSize,
+    VkDeviceSize unusedBytes,
+    size_t allocationCount,
+    size_t unusedRangeCount)
 {
-    VMA_ASSERT(request.type == VmaAllocationRequestType::Normal);
-    VMA_ASSERT(request.item != m_Suballocations.end());
-    VmaSuballocation& suballoc = *request.item;
-    // Given suballocation is a free block.
-    VMA_ASSERT(suballoc.type == VMA_SUBALLOCATION_TYPE_FREE);
-    // Given offset is inside this suballocation.
-    VMA_ASSERT(request.offset >= suballoc.offset);
-    const VkDeviceSize paddingBegin = request.offset - suballoc.offset;
-    VMA_ASSERT(suballoc.size >= paddingBegin + allocSize);
-    const VkDeviceSize paddingEnd = suballoc.size - paddingBegin - allocSize;
+    m_Snapshot.m_Allocations.reserve(m_Snapshot.m_Allocations.size() + allocationCount);
+}
 
-    // Unregister this free suballocation from m_FreeSuballocationsBySize and update
-    // it to become used.
-    UnregisterFreeSuballocation(request.item);
+void VmaStatsSnapshotBuilder::Allocation(
+    VkDeviceSize offset,
+    VmaAllocation hAllocation)
+{
+    AddAllocation(hAllocation, offset, hAllocation->GetSize(), hAllocation->GetCreationFrameIndex());
+}
 
-    suballoc.offset = request.offset;
-    suballoc.size = allocSize;
-    suballoc.type = type;
-    suballoc.hAllocation = hAllocation;
+void VmaStatsSnapshotBuilder::HandlelessAllocation(
+    const VmaSuballocation& suballoc)
+{
+    AddAllocation(VK_NULL_HANDLE, suballoc.offset, suballoc.size, suballoc.frameIndex);
+}
 
-    // If there are any free bytes remaining at the end, insert new free suballocation after current one.
-    if(paddingEnd)
+void VmaStatsSnapshotBuilder::EndBlock()
+{
+    AllocationRun& run = m_Runs.back();
+    run.count = m_Snapshot.m_Allocations.size() - run.firstIndex;
+    if(run.count == 0)
     {
-        VmaSuballocation paddingSuballoc = {};
-        paddingSuballoc.offset = request.offset + allocSize;
-        paddingSuballoc.size = paddingEnd;
-        paddingSuballoc.type = VMA_SUBALLOCATION_TYPE_FREE;
-        VmaSuballocationList::iterator next = request.item;
-        ++next;
-        const VmaSuballocationList::iterator paddingEndItem =
-            m_Suballocations.insert(next, paddingSuballoc);
-        RegisterFreeSuballocation(paddingEndItem);
+        m_Runs.pop_back();
     }
+    m_CurrentMemory = VK_NULL_HANDLE;
+}
 
-    // If there are any free bytes remaining at the beginning, insert new free suballocation before current one.
-    if(paddingBegin)
+void VmaStatsSnapshotBuilder::AddAllocation(
+    VmaAllocation hAllocation,
+    VkDeviceSize offset,
+    VkDeviceSize size,
+    uint32_t creationFrameIndex)
+{
+    VMA_ASSERT(m_CurrentMemory != VK_NULL_HANDLE);
+    VmaAllocationSnapshot alloc = {};
+    alloc.allocation = hAllocation;
+    alloc.memoryTypeIndex = m_CurrentMemTypeIndex;
+    alloc.creationFrameIndex = creationFrameIndex;
+    alloc.deviceMemory = m_CurrentMemory;
+    alloc.offset = offset;
+    alloc.size = size;
+    m_Snapshot.m_Allocations.push_back(alloc);
+}
+
+struct VmaStatsSnapshotAllocationRunLess
+{
+    template<typename RunT>
+    bool operator()(const RunT& lhs, const RunT& rhs) const
     {
-        VmaSuballocation paddingSuballoc = {};
-        paddingSuballoc.offset = request.offset - paddingBegin;
-        paddingSuballoc.size = paddingBegin;
-        paddingSuballoc.type = VMA_SUBALLOCATION_TYPE_FREE;
-        const VmaSuballocationList::iterator paddingBeginItem =
-            m_Suballocations.insert(request.item, paddingSuballoc);
-        RegisterFreeSuballocation(paddingBeginItem);
+        return lhs.memory < rhs.memory;
     }
+};
 
-    // Update totals.
-    m_FreeCount = m_FreeCount - 1;
-    if(paddingBegin > 0)
+void VmaStatsSnapshotBuilder::Finish()
+{
+    VMA_SORT(m_Snapshot.m_Pools.begin(), m_Snapshot.m_Pools.end(), VmaStatsSnapshotPoolLess());
+    VMA_SORT(m_Snapshot.m_Blocks.begin(), m_Snapshot.m_Blocks.end(), VmaStatsSnapshotBlockLess());
+
+    // Each run is already sorted by offset, so it's enough to sort runs by memory.
+    const VmaStatsSnapshotAllocationRunLess runLess;
+    bool runsSorted = true;
+    for(size_t runIndex = 1; runsSorted && runIndex < m_Runs.size(); ++runIndex)
     {
-        ++m_FreeCount;
+        runsSorted = runLess(m_Runs[runIndex - 1], m_Runs[runIndex]);
     }
-    if(paddingEnd > 0)
+    if(runsSorted)
     {
-        ++m_FreeCount;
+        return;
     }
-    m_SumFreeSize -= allocSize;
-}
 
-void VmaBlockMetadata_Generic::Free(const VmaAllocation allocation)
-{
-    for(VmaSuballocationList::iterator suballocItem = m_Suballocations.begin();
-        suballocItem != m_Suballocations.end();
-        ++suballocItem)
+    VMA_SORT(m_Runs.begin(), m_Runs.end(), runLess);
+    // Take over captured allocations and copy the runs back in sorted order.
+    const VmaStlAllocator<VmaAllocationSnapshot> stlAllocator(m_pAllocationCallbacks);
+    VmaVector< VmaAllocationSnapshot, VmaStlAllocator<VmaAllocationSnapshot> > capturedAllocations(stlAllocator);
+    capturedAllocations.swap(m_Snapshot.m_Allocations);
+    m_Snapshot.m_Allocations.resize(capturedAllocations.size());
+    size_t dstIndex = 0;
+    for(size_t runIndex = 0; runIndex < m_Runs.size(); ++runIndex)
     {
-        VmaSuballocation& suballoc = *suballocItem;
-        if(suballoc.hAllocation == allocation)
-        {
-            FreeSuballocation(suballocItem);
-            VMA_HEAVY_ASSERT(Validate());
-            return;
-        }
+        const AllocationRun& run = m_Runs[runIndex];
+        memcpy(m_Snapshot.m_Allocations.data() + dstIndex, capturedAllocations.data() + run.firstIndex,
+            run.count * sizeof(VmaAllocationSnapshot));
+        dstIndex += run.count;
     }
-    VMA_ASSERT(0 && "Not found!");
+    VMA_ASSERT(dstIndex == capturedAllocations.size());
 }
 
-void VmaBlockMetadata_Generic::FreeAtOffset(VkDeviceSize offset)
+#endif // #if VMA_STATS_STRING_ENABLED
+
+////////////////////////////////////////////////////////////////////////////////
+// class VmaBlockMetadata_Generic
+
+VmaBlockMetadata_Generic::VmaBlockMetadata_Generic(VmaAllocator hAllocator) :
+    VmaBlockMetadata(hAllocator),
+    m_IsSnapshot(false),
+    m_FreeCount(0),
+    m_SumFreeSize(0),
+    m_Suballocations(VmaStlAllocator<VmaSuballocation>(hAllocator->GetAllocationCallbacks())),
+    m_FreeSuballocationsBySize(VmaStlAllocator<VmaSuballocationList::iterator>(hAllocator->GetAllocationCallbacks()))
 {
-    for(VmaSuballocationList::iterator suballocItem = m_Suballocations.begin();
-        suballocItem != m_Suballocations.end();
-        ++suballocItem)
-    {
-        VmaSuballocation& suballoc = *suballocItem;
-        if(suballoc.offset == offset)
-        {
-            FreeSuballocation(suballocItem);
-            return;
-        }
-    }
-    VMA_ASSERT(0 && "Not found!");
 }
 
-bool VmaBlockMetadata_Generic::ValidateFreeSuballocationList() const
+VmaBlockMetadata_Generic::~VmaBlockMetadata_Generic()
 {
-    VkDeviceSize lastSize = 0;
-    for(size_t i = 0, count = m_FreeSuballocationsBySize.size(); i < count; ++i)
-    {
-        const VmaSuballocationList::iterator it = m_FreeSuballocationsBySize[i];
+}
 
-        VMA_VALIDATE(it->type == VMA_SUBALLOCATION_TYPE_FREE);
-        VMA_VALIDATE(it->size >= VMA_MIN_FREE_SUBALLOCATION_SIZE_TO_REGISTER);
-        VMA_VALIDATE(it->size >= lastSize);
-        lastSize = it->size;
-    }
-    return true;
+void VmaBlockMetadata_Generic::Init(VkDeviceSize size)
+{
+    VmaBlockMetadata::Init(size);
+
+    m_FreeCount = 1;
+    m_SumFreeSize = size;
+
+    VmaSuballocation suballoc = {};
+    suballoc.offset = 0;
+    suballoc.size = size;
+    suballoc.type = VMA_SUBALLOCATION_TYPE_FREE;
+    suballoc.hAllocation = VK_NULL_HANDLE;
+
+    VMA_ASSERT(size > VMA_MIN_FREE_SUBALLOCATION_SIZE_TO_REGISTER);
+    m_Suballocations.push_back(suballoc);
+    VmaSuballocationList::iterator suballocItem = m_Suballocations.end();
+    --suballocItem;
+    m_FreeSuballocationsBySize.push_back(suballocItem);
 }
 
-bool VmaBlockMetadata_Generic::CheckAllocation(
-    uint32_t currentFrameIndex,
-    uint32_t frameInUseCount,
-    VkDeviceSize bufferImageGranularity,
-    VkDeviceSize allocSize,
-    VkDeviceSize allocAlignment,
-    VmaSuballocationType allocType,
-    VmaSuballocationList::const_iterator suballocItem,
-    bool canMakeOtherLost,
-    VkDeviceSize* pOffset,
-    size_t* itemsToMakeLostCount,
-    VkDeviceSize* pSumFreeSize,
-    VkDeviceSize* pSumItemSize) const
+bool VmaBlockMetadata_Generic::Validate() const
 {
-    VMA_ASSERT(allocSize > 0);
-    VMA_ASSERT(allocType != VMA_SUBALLOCATION_TYPE_FREE);
-    VMA_ASSERT(suballocItem != m_Suballocations.cend());
-    VMA_ASSERT(pOffset != VMA_NULL);
+    VMA_VALIDATE(!m_Suballocations.empty());
     
-    *itemsToMakeLostCount = 0;
-    *pSumFreeSize = 0;
-    *pSumItemSize = 0;
+    // Expected offset of new suballocation as calculated from previous ones.
+    VkDeviceSize calculatedOffset = 0;
+    // Expected number of free suballocations as calculated from traversing their list.
+    uint32_t calculatedFreeCount = 0;
+    // Expected sum size of free suballocations as calculated from traversing their list.
+    VkDeviceSize calculatedSumFreeSize = 0;
+    // Expected number of free suballocations that should be registered in
+    // m_FreeSuballocationsBySize calculated from traversing their list.
+    size_t freeSuballocationsToRegister = 0;
+    // True if previous visited suballocation was free.
+    bool prevFree = false;
 
-    if(canMakeOtherLost)
+    for(VmaSuballocationList::const_iterator suballocItem = m_Suballocations.cbegin();
+        suballocItem != m_Suballocations.cend();
+        ++suballocItem)
     {
-        if(suballocItem->type == VMA_SUBALLOCATION_TYPE_FREE)
-        {
-            *pSumFreeSize = suballocItem->size;
-        }
-        else
-        {
-            if(suballocItem->hAllocation->CanBecomeLost() &&
-                suballocItem->hAllocation->GetLastUseFrameIndex() + frameInUseCount < currentFrameIndex)
-            {
-                ++*itemsToMakeLostCount;
-                *pSumItemSize = suballocItem->size;
-            }
-            else
-            {
-                return false;
-            }
-        }
+        const VmaSuballocation& subAlloc = *suballocItem;
+        
+        // Actual offset of this suballocation doesn't match expected one.
+        VMA_VALIDATE(subAlloc.offset == calculatedOffset);
 
-        // Remaining size is too small for this request: Early return.
-        if(GetSize() - suballocItem->offset < allocSize)
-        {
-            return false;
-        }
+        const bool currFree = (subAlloc.type == VMA_SUBALLOCATION_TYPE_FREE);
+        // Two adjacent free suballocations are invalid. They should be merged.
+        VMA_VALIDATE(!prevFree || !currFree);
 
-        // Start from offset equal to beginning of this suballocation.
-        *pOffset = suballocItem->offset;
-    
-        // Apply VMA_DEBUG_MARGIN at the beginning.
-        if(VMA_DEBUG_MARGIN > 0)
-        {
-            *pOffset += VMA_DEBUG_MARGIN;
-        }
-    
-        // Apply alignment.
-        *pOffset = VmaAlignUp(*pOffset, allocAlignment);
+        VMA_VALIDATE(currFree == (subAlloc.hAllocation == VK_NULL_HANDLE));
 
-        // Check previous suballocations for BufferImageGranularity conflicts.
-        // Make bigger alignment if necessary.
-        if(bufferImageGranularity > 1)
+        if(currFree)
         {
-            bool bufferImageGranularityConflict = false;
-            VmaSuballocationList::const_iterator prevSuballocItem = suballocItem;
-            while(prevSuballocItem != m_Suballocations.cbegin())
-            {
-                --prevSuballocItem;
-                const VmaSuballocation& prevSuballoc = *prevSuballocItem;
-                if(VmaBlocksOnSamePage(prevSuballoc.offset, prevSuballoc.size, *pOffset, bufferImageGranularity))
-                {
-                    if(VmaIsBufferImageGranularityConflict(prevSuballoc.type, allocType))
-                    {
-                        bufferImageGranularityConflict = true;
-                        break;
-                    }
-                }
-                else
-                    // Already on previous page.
-                    break;
-            }
-            if(bufferImageGranularityConflict)
+            calculatedSumFreeSize += subAlloc.size;
+            ++calculatedFreeCount;
+            if(subAlloc.size >= VMA_MIN_FREE_SUBALLOCATION_SIZE_TO_REGISTER)
             {
-                *pOffset = VmaAlignUp(*pOffset, bufferImageGranularity);
+                ++freeSuballocationsToRegister;
             }
+
+            // Margin required between allocations - every free space must be at least that large.
+            VMA_VALIDATE(subAlloc.size >= VMA_DEBUG_MARGIN);
         }
-    
-        // Now that we have final *pOffset, check if we are past suballocItem.
-        // If yes, return false - this function should be called for another suballocItem as starting point.
-        if(*pOffset >= suballocItem->offset + suballocItem->size)
+        else
         {
-            return false;
+            VMA_VALIDATE(m_IsSnapshot || subAlloc.hAllocation->GetOffset() == subAlloc.offset);
+            VMA_VALIDATE(subAlloc.hAllocation->GetSize() == subAlloc.size);
+
+            // Margin required between allocations - previous allocation must be free.
+            VMA_VALIDATE(VMA_DEBUG_MARGIN == 0 || prevFree);
         }
-    
-        // Calculate padding at the beginning based on current offset.
-        const VkDeviceSize paddingBegin = *pOffset - suballocItem->offset;
 
-        // Calculate required margin at the end.
-        const VkDeviceSize requiredEndMargin = VMA_DEBUG_MARGIN;
+        calculatedOffset += subAlloc.size;
+        prevFree = currFree;
+    }
 
-        const VkDeviceSize totalSize = paddingBegin + allocSize + requiredEndMargin;
-        // Another early return check.
-        if(suballocItem->offset + totalSize > GetSize())
-        {
-            return false;
-        }
+    // Number of free suballocations registered in m_FreeSuballocationsBySize doesn't
+    // match expected one.
+    VMA_VALIDATE(m_FreeSuballocationsBySize.size() == freeSuballocationsToRegister);
 
-        // Advance lastSuballocItem until desired size is reached.
-        // Update itemsToMakeLostCount.
-        VmaSuballocationList::const_iterator lastSuballocItem = suballocItem;
-        if(totalSize > suballocItem->size)
-        {
-            VkDeviceSize remainingSize = totalSize - suballocItem->size;
-            while(remainingSize > 0)
-            {
-                ++lastSuballocItem;
-                if(lastSuballocItem == m_Suballocations.cend())
-                {
-                    return false;
-                }
-                if(lastSuballocItem->type == VMA_SUBALLOCATION_TYPE_FREE)
-                {
-                    *pSumFreeSize += lastSuballocItem->size;
-                }
-                else
-                {
-                    VMA_ASSERT(lastSuballocItem->hAllocation != VK_NULL_HANDLE);
-                    if(lastSuballocItem->hAllocation->CanBecomeLost() &&
-                        lastSuballocItem->hAllocation->GetLastUseFrameIndex() + frameInUseCount < currentFrameIndex)
-                    {
-                        ++*itemsToMakeLostCount;
-                        *pSumItemSize += lastSuballocItem->size;
-                    }
-                    else
-                    {
-                        return false;
-                    }
-                }
-                remainingSize = (lastSuballocItem->size < remainingSize) ?
-                    remainingSize - lastSuballocItem->size : 0;
-            }
-        }
+    VkDeviceSize lastSize = 0;
+    for(size_t i = 0; i < m_FreeSuballocationsBySize.size(); ++i)
+    {
+        VmaSuballocationList::iterator suballocItem = m_FreeSuballocationsBySize[i];
+        
+        // Only free suballocations can be registered in m_FreeSuballocationsBySize.
+        VMA_VALIDATE(suballocItem->type == VMA_SUBALLOCATION_TYPE_FREE);
+        // They must be sorted by size ascending.
+        VMA_VALIDATE(suballocItem->size >= lastSize);
 
-        // Check next suballocations for BufferImageGranularity conflicts.
-        // If conflict exists, we must mark more allocations lost or fail.
-        if(bufferImageGranularity > 1)
-        {
-            VmaSuballocationList::const_iterator nextSuballocItem = lastSuballocItem;
-            ++nextSuballocItem;
-            while(nextSuballocItem != m_Suballocations.cend())
-            {
-                const VmaSuballocation& nextSuballoc = *nextSuballocItem;
-                if(VmaBlocksOnSamePage(*pOffset, allocSize, nextSuballoc.offset, bufferImageGranularity))
-                {
-                    if(VmaIsBufferImageGranularityConflict(allocType, nextSuballoc.type))
-                    {
-                        VMA_ASSERT(nextSuballoc.hAllocation != VK_NULL_HANDLE);
-                        if(nextSuballoc.hAllocation->CanBecomeLost() &&
-                            nextSuballoc.hAllocation->GetLastUseFrameIndex() + frameInUseCount < currentFrameIndex)
-                        {
-                            ++*itemsToMakeLostCount;
-                        }
-                        else
-                        {
-                            return false;
-                        }
-                    }
-                }
-                else
-                {
-                    // Already on next page.
-                    break;
-                }
-                ++nextSuballocItem;
-            }
-        }
+        lastSize = suballocItem->size;
+    }
+
+    // Check if totals match calculacted values.
+    VMA_VALIDATE(ValidateFreeSuballocationList());
+    VMA_VALIDATE(calculatedOffset == GetSize());
+    VMA_VALIDATE(calculatedSumFreeSize == m_SumFreeSize);
+    VMA_VALIDATE(calculatedFreeCount == m_FreeCount);
+
+    return true;
+}
+
+VkDeviceSize VmaBlockMetadata_Generic::GetUnusedRangeSizeMax() const
+{
+    if(!m_FreeSuballocationsBySize.empty())
+    {
+        return m_FreeSuballocationsBySize.back()->size;
     }
     else
     {
-        const VmaSuballocation& suballoc = *suballocItem;
-        VMA_ASSERT(suballoc.type == VMA_SUBALLOCATION_TYPE_FREE);
+        return 0;
+    }
+}
 
-        *pSumFreeSize = suballoc.size;
+bool VmaBlockMetadata_Generic::IsEmpty() const
+{
+    return (m_Suballocations.size() == 1) && (m_FreeCount == 1);
+}
 
-        // Size of this suballocation is too small for this request: Early return.
-        if(suballoc.size < allocSize)
-        {
-            return false;
-        }
+void VmaBlockMetadata_Generic::CalcAllocationStatInfo(VmaStatInfo& outInfo) const
+{
+    outInfo.blockCount = 1;
 
-        // Start from offset equal to beginning of this suballocation.
-        *pOffset = suballoc.offset;
+    const uint32_t rangeCount = (uint32_t)m_Suballocations.size();
+    outInfo.allocationCount = rangeCount - m_FreeCount;
+    outInfo.unusedRangeCount = m_FreeCount;
     
-        // Apply VMA_DEBUG_MARGIN at the beginning.
-        if(VMA_DEBUG_MARGIN > 0)
+    outInfo.unusedBytes = m_SumFreeSize;
+    outInfo.usedBytes = GetSize() - outInfo.unusedBytes;
+
+    outInfo.allocationSizeMin = UINT64_MAX;
+    outInfo.allocationSizeMax = 0;
+    outInfo.unusedRangeSizeMin = UINT64_MAX;
+    outInfo.unusedRangeSizeMax = 0;
+
+    for(VmaSuballocationList::const_iterator suballocItem = m_Suballocations.cbegin();
+        suballocItem != m_Suballocations.cend();
+        ++suballocItem)
+    {
+        const VmaSuballocation& suballoc = *suballocItem;
+        if(suballoc.type != VMA_SUBALLOCATION_TYPE_FREE)
         {
-            *pOffset += VMA_DEBUG_MARGIN;
+            outInfo.allocationSizeMin = VMA_MIN(outInfo.allocationSizeMin, suballoc.size);
+            outInfo.allocationSizeMax = VMA_MAX(outInfo.allocationSizeMax, suballoc.size);
         }
-    
-        // Apply alignment.
-        *pOffset = VmaAlignUp(*pOffset, allocAlignment);
-    
-        // Check previous suballocations for BufferImageGranularity conflicts.
-        // Make bigger alignment if necessary.
-        if(bufferImageGranularity > 1)
+        else
         {
-            bool bufferImageGranularityConflict = false;
-            VmaSuballocationList::const_iterator prevSuballocItem = suballocItem;
-            while(prevSuballocItem != m_Suballocations.cbegin())
-            {
-                --prevSuballocItem;
-                const VmaSuballocation& prevSuballoc = *prevSuballocItem;
-                if(VmaBlocksOnSamePage(prevSuballoc.offset, prevSuballoc.size, *pOffset, bufferImageGranularity))
-                {
-                    if(VmaIsBufferImageGranularityConflict(prevSuballoc.type, allocType))
-                    {
-                        bufferImageGranularityConflict = true;
-                        break;
-                    }
-                }
-                else
-                    // Already on previous page.
-                    break;
-            }
-            if(bufferImageGranularityConflict)
-            {
-                *pOffset = VmaAlignUp(*pOffset, bufferImageGranularity);
-            }
-        }
-    
-        // Calculate padding at the beginning based on current offset.
-        const VkDeviceSize paddingBegin = *pOffset - suballoc.offset;
-
-        // Calculate required margin at the end.
-        const VkDeviceSize requiredEndMargin = VMA_DEBUG_MARGIN;
-
-        // Fail if requested size plus margin before and after is bigger than size of this suballocation.
-        if(paddingBegin + allocSize + requiredEndMargin > suballoc.size)
-        {
-            return false;
-        }
-
-        // Check next suballocations for BufferImageGranularity conflicts.
-        // If conflict exists, allocation cannot be made here.
-        if(bufferImageGranularity > 1)
-        {
-            VmaSuballocationList::const_iterator nextSuballocItem = suballocItem;
-            ++nextSuballocItem;
-            while(nextSuballocItem != m_Suballocations.cend())
-            {
-                const VmaSuballocation& nextSuballoc = *nextSuballocItem;
-                if(VmaBlocksOnSamePage(*pOffset, allocSize, nextSuballoc.offset, bufferImageGranularity))
-                {
-                    if(VmaIsBufferImageGranularityConflict(allocType, nextSuballoc.type))
-                    {
-                        return false;
-                    }
-                }
-                else
-                {
-                    // Already on next page.
-                    break;
-                }
-                ++nextSuballocItem;
-            }
+            outInfo.unusedRangeSizeMin = VMA_MIN(outInfo.unusedRangeSizeMin, suballoc.size);
+            outInfo.unusedRangeSizeMax = VMA_MAX(outInfo.unusedRangeSizeMax, suballoc.size);
         }
     }
-
-    // All tests passed: Success. pOffset is already filled.
-    return true;
 }
 
-void VmaBlockMetadata_Generic::MergeFreeWithNext(VmaSuballocationList::iterator item)
+void VmaBlockMetadata_Generic::AddPoolStats(VmaPoolStats& inoutStats) const
 {
-    VMA_ASSERT(item != m_Suballocations.end());
-    VMA_ASSERT(item->type == VMA_SUBALLOCATION_TYPE_FREE);
-    
-    VmaSuballocationList::iterator nextItem = item;
-    ++nextItem;
-    VMA_ASSERT(nextItem != m_Suballocations.end());
-    VMA_ASSERT(nextItem->type == VMA_SUBALLOCATION_TYPE_FREE);
+    const uint32_t rangeCount = (uint32_t)m_Suballocations.size();
 
-    item->size += nextItem->size;
-    --m_FreeCount;
-    m_Suballocations.erase(nextItem);
+    inoutStats.size += GetSize();
+    inoutStats.unusedSize += m_SumFreeSize;
+    inoutStats.allocationCount += rangeCount - m_FreeCount;
+    inoutStats.unusedRangeCount += m_FreeCount;
+    inoutStats.unusedRangeSizeMax = VMA_MAX(inoutStats.unusedRangeSizeMax, GetUnusedRangeSizeMax());
 }
 
-VmaSuballocationList::iterator VmaBlockMetadata_Generic::FreeSuballocation(VmaSuballocationList::iterator suballocItem)
-{
-    // Change this suballocation to be marked as free.
-    VmaSuballocation& suballoc = *suballocItem;
-    suballoc.type = VMA_SUBALLOCATION_TYPE_FREE;
-    suballoc.hAllocation = VK_NULL_HANDLE;
-    
-    // Update totals.
-    ++m_FreeCount;
-    m_SumFreeSize += suballoc.size;
-
-    // Merge with previous and/or next suballocation if it's also free.
-    bool mergeWithNext = false;
-    bool mergeWithPrev = false;
-    
-    VmaSuballocationList::iterator nextItem = suballocItem;
-    ++nextItem;
-    if((nextItem != m_Suballocations.end()) && (nextItem->type == VMA_SUBALLOCATION_TYPE_FREE))
-    {
-        mergeWithNext = true;
-    }
-
-    VmaSuballocationList::iterator prevItem = suballocItem;
-    if(suballocItem != m_Suballocations.begin())
-    {
-        --prevItem;
-        if(prevItem->type == VMA_SUBALLOCATION_TYPE_FREE)
-        {
-            mergeWithPrev = true;
-        }
-    }
-
-    if(mergeWithNext)
-    {
-        UnregisterFreeSuballocation(nextItem);
-        MergeFreeWithNext(suballocItem);
-    }
-
-    if(mergeWithPrev)
-    {
-        UnregisterFreeSuballocation(prevItem);
-        MergeFreeWithNext(prevItem);
-        RegisterFreeSuballocation(prevItem);
-        return prevItem;
-    }
-    else
-    {
-        RegisterFreeSuballocation(suballocItem);
-        return suballocItem;
-    }
-}
+#if VMA_STATS_STRING_ENABLED
 
-void VmaBlockMetadata_Generic::RegisterFreeSuballocation(VmaSuballocationList::iterator item)
+void VmaBlockMetadata_Generic::VisitDetailedMap(class VmaDetailedMapVisitor& visitor) const
 {
-    VMA_ASSERT(item->type == VMA_SUBALLOCATION_TYPE_FREE);
-    VMA_ASSERT(item->size > 0);
-
-    // You may want to enable this validation at the beginning or at the end of
-    // this function, depending on what do you want to check.
-    VMA_HEAVY_ASSERT(ValidateFreeSuballocationList());
+    visitor.BeginBlock(
+        GetSize(), // blockSize
+        m_SumFreeSize, // unusedBytes
+        m_Suballocations.size() - (size_t)m_FreeCount, // allocationCount
+        m_FreeCount); // unusedRangeCount
 
-    if(item->size >= VMA_MIN_FREE_SUBALLOCATION_SIZE_TO_REGISTER)
+    size_t i = 0;
+    for(VmaSuballocationList::const_iterator suballocItem = m_Suballocations.cbegin();
+        suballocItem != m_Suballocations.cend();
+        ++suballocItem, ++i)
     {
-        if(m_FreeSuballocationsBySize.empty())
+        if(suballocItem->type == VMA_SUBALLOCATION_TYPE_FREE)
         {
-            m_FreeSuballocationsBySize.push_back(item);
+            visitor.UnusedRange(suballocItem->offset, suballocItem->size);
         }
         else
         {
-            VmaVectorInsertSorted<VmaSuballocationItemSizeLess>(m_FreeSuballocationsBySize, item);
+            visitor.Allocation(suballocItem->offset, suballocItem->hAllocation);
         }
     }
 
-    //VMA_HEAVY_ASSERT(ValidateFreeSuballocationList());
+    visitor.EndBlock();
 }
 
+#endif // #if VMA_STATS_STRING_ENABLED
 
-void VmaBlockMetadata_Generic::UnregisterFreeSuballocation(VmaSuballocationList::iterator item)
+bool VmaBlockMetadata_Generic::CreateAllocationRequest(
+    uint32_t currentFrameIndex,
+    uint32_t frameInUseCount,
+    VkDeviceSize bufferImageGranularity,
+    VkDeviceSize allocSize,
+    VkDeviceSize allocAlignment,
+    bool upperAddress,
+    VmaSuballocationType allocType,
+    bool canMakeOtherLost,
+    uint32_t strategy,
+    VmaAllocationRequest* pAllocationRequest)
 {
-    VMA_ASSERT(item->type == VMA_SUBALLOCATION_TYPE_FREE);
-    VMA_ASSERT(item->size > 0);
-
-    // You may want to enable this validation at the beginning or at the end of
-    // this function, depending on what do you want to check.
-    VMA_HEAVY_ASSERT(ValidateFreeSuballocationList());
-
-    if(item->size >= VMA_MIN_FREE_SUBALLOCATION_SIZE_TO_REGISTER)
-    {
-        VmaSuballocationList::iterator* const it = VmaBinaryFindFirstNotLess(
-            m_FreeSuballocationsBySize.data(),
-            m_FreeSuballocationsBySize.data() + m_FreeSuballocationsBySize.size(),
-            item,
-            VmaSuballocationItemSizeLess());
-        for(size_t index = it - m_FreeSuballocationsBySize.data();
-            index < m_FreeSuballocationsBySize.size();
-            ++index)
-        {
-            if(m_FreeSuballocationsBySize[index] == item)
-            {
-                VmaVectorRemove(m_FreeSuballocationsBySize, index);
-                return;
-            }
-            VMA_ASSERT((m_FreeSuballocationsBySize[index]->size == item->size) && "Not found.");
-        }
-        VMA_ASSERT(0 && "Not found.");
-    }
+    VMA_ASSERT(allocSize > 0);
+    VMA_ASSERT(!upperAddress);
+    VMA_ASSERT(allocType != VMA_SUBALLOCATION_TYPE_FREE);
+    VMA_ASSERT(pAllocationRequest != VMA_NULL);
+    VMA_HEAVY_ASSERT(Validate());
 
-    //VMA_HEAVY_ASSERT(ValidateFreeSuballocationList());
-}
+    pAllocationRequest->type = VmaAllocationRequestType::Normal;
 
-bool VmaBlockMetadata_Generic::IsBufferImageGranularityConflictPossible(
-    VkDeviceSize bufferImageGranularity,
-    VmaSuballocationType& inOutPrevSuballocType) const
-{
-    if(bufferImageGranularity == 1 || IsEmpty())
+    // There is not enough total free space in this block to fullfill the request: Early return.
+    if(canMakeOtherLost == false &&
+        m_SumFreeSize < allocSize + 2 * VMA_DEBUG_MARGIN)
     {
         return false;
     }
 
-    VkDeviceSize minAlignment = VK_WHOLE_SIZE;
-    bool typeConflictFound = false;
-    for(VmaSuballocationList::const_iterator it = m_Suballocations.cbegin();
-        it != m_Suballocations.cend();
-        ++it)
+    // New algorithm, efficiently searching freeSuballocationsBySize.
+    const size_t freeSuballocCount = m_FreeSuballocationsBySize.size();
+    if(freeSuballocCount > 0)
     {
-        const VmaSuballocationType suballocType = it->type;
-        if(suballocType != VMA_SUBALLOCATION_TYPE_FREE)
+        if(strategy == VMA_ALLOCATION_CREATE_STRATEGY_BEST_FIT_BIT)
         {
-            minAlignment = VMA_MIN(minAlignment, it->hAllocation->GetAlignment());
-            if(VmaIsBufferImageGranularityConflict(inOutPrevSuballocType, suballocType))
+            // Find first free suballocation with size not less than allocSize + 2 * VMA_DEBUG_MARGIN.
+            VmaSuballocationList::iterator* const it = VmaBinaryFindFirstNotLess(
+                m_FreeSuballocationsBySize.data(),
+                m_FreeSuballocationsBySize.data() + freeSuballocCount,
+                allocSize + 2 * VMA_DEBUG_MARGIN,
+                VmaSuballocationItemSizeLess());
+            size_t index = it - m_FreeSuballocationsBySize.data();
+            for(; index < freeSuballocCount; ++index)
             {
-                typeConflictFound = true;
+                if(CheckAllocation(
+                    currentFrameIndex,
+                    frameInUseCount,
+                    bufferImageGranularity,
+                    allocSize,
+                    allocAlignment,
+                    allocType,
+                    m_FreeSuballocationsBySize[index],
+                    false, // canMakeOtherLost
+                    &pAllocationRequest->offset,
+                    &pAllocationRequest->itemsToMakeLostCount,
+                    &pAllocationRequest->sumFreeSize,
+                    &pAllocationRequest->sumItemSize))
+                {
+                    pAllocationRequest->item = m_FreeSuballocationsBySize[index];
+                    return true;
+                }
             }
-            inOutPrevSuballocType = suballocType;
         }
-    }
-
-    return typeConflictFound || minAlignment >= bufferImageGranularity;
-}
-
-////////////////////////////////////////////////////////////////////////////////
-// class VmaBlockMetadata_Linear
-
-VmaBlockMetadata_Linear::VmaBlockMetadata_Linear(VmaAllocator hAllocator) :
-    VmaBlockMetadata(hAllocator),
-    m_SumFreeSize(0),
-    m_Suballocations0(VmaStlAllocator<VmaSuballocation>(hAllocator->GetAllocationCallbacks())),
-    m_Suballocations1(VmaStlAllocator<VmaSuballocation>(hAllocator->GetAllocationCallbacks())),
-    m_1stVectorIndex(0),
-    m_2ndVectorMode(SECOND_VECTOR_EMPTY),
-    m_1stNullItemsBeginCount(0),
-    m_1stNullItemsMiddleCount(0),
-    m_2ndNullItemsCount(0)
-{
-}
-
-VmaBlockMetadata_Linear::~VmaBlockMetadata_Linear()
-{
-}
-
-void VmaBlockMetadata_Linear::Init(VkDeviceSize size)
-{
-    VmaBlockMetadata::Init(size);
-    m_SumFreeSize = size;
-}
-
-bool VmaBlockMetadata_Linear::Validate() const
-{
-    const SuballocationVectorType& suballocations1st = AccessSuballocations1st();
-    const SuballocationVectorType& suballocations2nd = AccessSuballocations2nd();
-
-    VMA_VALIDATE(suballocations2nd.empty() == (m_2ndVectorMode == SECOND_VECTOR_EMPTY));
-    VMA_VALIDATE(!suballocations1st.empty() ||
-        suballocations2nd.empty() ||
-        m_2ndVectorMode != SECOND_VECTOR_RING_BUFFER);
-
-    if(!suballocations1st.empty())
-    {
-        // Null item at the beginning should be accounted into m_1stNullItemsBeginCount.
-        VMA_VALIDATE(suballocations1st[m_1stNullItemsBeginCount].hAllocation != VK_NULL_HANDLE);
-        // Null item at the end should be just pop_back().
-        VMA_VALIDATE(suballocations1st.back().hAllocation != VK_NULL_HANDLE);
-    }
-    if(!suballocations2nd.empty())
-    {
-        // Null item at the end should be just pop_back().
-        VMA_VALIDATE(suballocations2nd.back().hAllocation != VK_NULL_HANDLE);
-    }
-
-    VMA_VALIDATE(m_1stNullItemsBeginCount + m_1stNullItemsMiddleCount <= suballocations1st.size());
-    VMA_VALIDATE(m_2ndNullItemsCount <= suballocations2nd.size());
-
-    VkDeviceSize sumUsedSize = 0;
-    const size_t suballoc1stCount = suballocations1st.size();
-    VkDeviceSize offset = VMA_DEBUG_MARGIN;
-
-    if(m_2ndVectorMode == SECOND_VECTOR_RING_BUFFER)
-    {
-        const size_t suballoc2ndCount = suballocations2nd.size();
-        size_t nullItem2ndCount = 0;
-        for(size_t i = 0; i < suballoc2ndCount; ++i)
+        else if(strategy == VMA_ALLOCATION_INTERNAL_STRATEGY_MIN_OFFSET)
         {
-            const VmaSuballocation& suballoc = suballocations2nd[i];
-            const bool currFree = (suballoc.type == VMA_SUBALLOCATION_TYPE_FREE);
-
-            VMA_VALIDATE(currFree == (suballoc.hAllocation == VK_NULL_HANDLE));
-            VMA_VALIDATE(suballoc.offset >= offset);
-
-            if(!currFree)
+            for(VmaSuballocationList::iterator it = m_Suballocations.begin();
+                it != m_Suballocations.end();
+                ++it)
             {
-                VMA_VALIDATE(suballoc.hAllocation->GetOffset() == suballoc.offset);
-                VMA_VALIDATE(suballoc.hAllocation->GetSize() == suballoc.size);
-                sumUsedSize += suballoc.size;
+                if(it->type == VMA_SUBALLOCATION_TYPE_FREE && CheckAllocation(
+                    currentFrameIndex,
+                    frameInUseCount,
+                    bufferImageGranularity,
+                    allocSize,
+                    allocAlignment,
+                    allocType,
+                    it,
+                    false, // canMakeOtherLost
+                    &pAllocationRequest->offset,
+                    &pAllocationRequest->itemsToMakeLostCount,
+                    &pAllocationRequest->sumFreeSize,
+                    &pAllocationRequest->sumItemSize))
+                {
+                    pAllocationRequest->item = it;
+                    return true;
+                }
             }
-            else
+        }
+        else // WORST_FIT, FIRST_FIT
+        {
+            // Search staring from biggest suballocations.
+            for(size_t index = freeSuballocCount; index--; )
             {
-                ++nullItem2ndCount;
+                if(CheckAllocation(
+                    currentFrameIndex,
+                    frameInUseCount,
+                    bufferImageGranularity,
+                    allocSize,
+                    allocAlignment,
+                    allocType,
+                    m_FreeSuballocationsBySize[index],
+                    false, // canMakeOtherLost
+                    &pAllocationRequest->offset,
+                    &pAllocationRequest->itemsToMakeLostCount,
+                    &pAllocationRequest->sumFreeSize,
+                    &pAllocationRequest->sumItemSize))
+                {
+                    pAllocationRequest->item = m_FreeSuballocationsBySize[index];
+                    return true;
+                }
             }
-
-            offset = suballoc.offset + suballoc.size + VMA_DEBUG_MARGIN;
         }
-
-        VMA_VALIDATE(nullItem2ndCount == m_2ndNullItemsCount);
     }
 
-    for(size_t i = 0; i < m_1stNullItemsBeginCount; ++i)
+    if(canMakeOtherLost)
     {
-        const VmaSuballocation& suballoc = suballocations1st[i];
-        VMA_VALIDATE(suballoc.type == VMA_SUBALLOCATION_TYPE_FREE &&
-            suballoc.hAllocation == VK_NULL_HANDLE);
-    }
+        // Brute-force algorithm. TODO: Come up with something better.
 
-    size_t nullItem1stCount = m_1stNullItemsBeginCount;
+        bool found = false;
+        VmaAllocationRequest tmpAllocRequest = {};
+        tmpAllocRequest.type = VmaAllocationRequestType::Normal;
+        for(VmaSuballocationList::iterator suballocIt = m_Suballocations.begin();
+            suballocIt != m_Suballocations.end();
+            ++suballocIt)
+        {
+            if(suballocIt->type == VMA_SUBALLOCATION_TYPE_FREE ||
+                suballocIt->hAllocation->CanBecomeLost())
+            {
+                if(CheckAllocation(
+                    currentFrameIndex,
+                    frameInUseCount,
+                    bufferImageGranularity,
+                    allocSize,
+                    allocAlignment,
+                    allocType,
+                    suballocIt,
+                    canMakeOtherLost,
+                    &tmpAllocRequest.offset,
+                    &tmpAllocRequest.itemsToMakeLostCount,
+                    &tmpAllocRequest.sumFreeSize,
+                    &tmpAllocRequest.sumItemSize))
+                {
+                    if(strategy == VMA_ALLOCATION_CREATE_STRATEGY_FIRST_FIT_BIT)
+                    {
+                        *pAllocationRequest = tmpAllocRequest;
+                        pAllocationRequest->item = suballocIt;
+                        break;
+                    }
+                    if(!found || tmpAllocRequest.CalcCost() < pAllocationRequest->CalcCost())
+                    {
+                        *pAllocationRequest = tmpAllocRequest;
+                        pAllocationRequest->item = suballocIt;
+                        found = true;
+                    }
+                }
+            }
+        }
 
-    for(size_t i = m_1stNullItemsBeginCount; i < suballoc1stCount; ++i)
-    {
-        const VmaSuballocation& suballoc = suballocations1st[i];
-        const bool currFree = (suballoc.type == VMA_SUBALLOCATION_TYPE_FREE);
+        return found;
+    }
 
-        VMA_VALIDATE(currFree == (suballoc.hAllocation == VK_NULL_HANDLE));
-        VMA_VALIDATE(suballoc.offset >= offset);
-        VMA_VALIDATE(i >= m_1stNullItemsBeginCount || currFree);
+    return false;
+}
 
-        if(!currFree)
+bool VmaBlockMetadata_Generic::MakeRequestedAllocationsLost(
+    uint32_t currentFrameIndex,
+    uint32_t frameInUseCount,
+    VmaAllocationRequest* pAllocationRequest)
+{
+    VMA_ASSERT(pAllocationRequest && pAllocationRequest->type == VmaAllocationRequestType::Normal);
+
+    while(pAllocationRequest->itemsToMakeLostCount > 0)
+    {
+        if(pAllocationRequest->item->type == VMA_SUBALLOCATION_TYPE_FREE)
         {
-            VMA_VALIDATE(suballoc.hAllocation->GetOffset() == suballoc.offset);
-            VMA_VALIDATE(suballoc.hAllocation->GetSize() == suballoc.size);
-            sumUsedSize += suballoc.size;
+            ++pAllocationRequest->item;
+        }
+        VMA_ASSERT(pAllocationRequest->item != m_Suballocations.end());
+        VMA_ASSERT(pAllocationRequest->item->hAllocation != VK_NULL_HANDLE);
+        VMA_ASSERT(pAllocationRequest->item->hAllocation->CanBecomeLost());
+        if(pAllocationRequest->item->hAllocation->MakeLost(currentFrameIndex, frameInUseCount))
+        {
+            pAllocationRequest->item = FreeSuballocation(pAllocationRequest->item);
+            --pAllocationRequest->itemsToMakeLostCount;
         }
         else
         {
-            ++nullItem1stCount;
+            return false;
         }
-
-        offset = suballoc.offset + suballoc.size + VMA_DEBUG_MARGIN;
     }
-    VMA_VALIDATE(nullItem1stCount == m_1stNullItemsBeginCount + m_1stNullItemsMiddleCount);
 
-    if(m_2ndVectorMode == SECOND_VECTOR_DOUBLE_STACK)
+    VMA_HEAVY_ASSERT(Validate());
+    VMA_ASSERT(pAllocationRequest->item != m_Suballocations.end());
+    VMA_ASSERT(pAllocationRequest->item->type == VMA_SUBALLOCATION_TYPE_FREE);
+    
+    return true;
+}
+
+uint32_t VmaBlockMetadata_Generic::MakeAllocationsLost(uint32_t currentFrameIndex, uint32_t frameInUseCount)
+{
+    uint32_t lostAllocationCount = 0;
+    for(VmaSuballocationList::iterator it = m_Suballocations.begin();
+        it != m_Suballocations.end();
+        ++it)
     {
-        const size_t suballoc2ndCount = suballocations2nd.size();
-        size_t nullItem2ndCount = 0;
-        for(size_t i = suballoc2ndCount; i--; )
+        if(it->type != VMA_SUBALLOCATION_TYPE_FREE &&
+            it->hAllocation->CanBecomeLost() &&
+            it->hAllocation->MakeLost(currentFrameIndex, frameInUseCount))
         {
-            const VmaSuballocation& suballoc = suballocations2nd[i];
-            const bool currFree = (suballoc.type == VMA_SUBALLOCATION_TYPE_FREE);
-
-            VMA_VALIDATE(currFree == (suballoc.hAllocation == VK_NULL_HANDLE));
-            VMA_VALIDATE(suballoc.offset >= offset);
+            it = FreeSuballocation(it);
+            ++lostAllocationCount;
+        }
+    }
+    return lostAllocationCount;
+}
 
-            if(!currFree)
+VkResult VmaBlockMetadata_Generic::CheckCorruption(const void* pBlockData)
+{
+    for(VmaSuballocationList::iterator it = m_Suballocations.begin();
+        it != m_Suballocations.end();
+        ++it)
+    {
+        if(it->type != VMA_SUBALLOCATION_TYPE_FREE)
+        {
+            if(!VmaValidateMagicValue(pBlockData, it->offset - VMA_DEBUG_MARGIN))
             {
-                VMA_VALIDATE(suballoc.hAllocation->GetOffset() == suballoc.offset);
-                VMA_VALIDATE(suballoc.hAllocation->GetSize() == suballoc.size);
-                sumUsedSize += suballoc.size;
+                VMA_ASSERT(0 && "MEMORY CORRUPTION DETECTED BEFORE VALIDATED ALLOCATION!");
+                return VK_ERROR_VALIDATION_FAILED_EXT;
             }
-            else
+            if(!VmaValidateMagicValue(pBlockData, it->offset + it->size))
             {
-                ++nullItem2ndCount;
+                VMA_ASSERT(0 && "MEMORY CORRUPTION DETECTED AFTER VALIDATED ALLOCATION!");
+                return VK_ERROR_VALIDATION_FAILED_EXT;
             }
-
-            offset = suballoc.offset + suballoc.size + VMA_DEBUG_MARGIN;
         }
-
-        VMA_VALIDATE(nullItem2ndCount == m_2ndNullItemsCount);
     }
 
-    VMA_VALIDATE(offset <= GetSize());
-    VMA_VALIDATE(m_SumFreeSize == GetSize() - sumUsedSize);
-
-    return true;
-}
-
-size_t VmaBlockMetadata_Linear::GetAllocationCount() const
-{
-    return AccessSuballocations1st().size() - (m_1stNullItemsBeginCount + m_1stNullItemsMiddleCount) +
-        AccessSuballocations2nd().size() - m_2ndNullItemsCount;
+    return VK_SUCCESS;
 }
 
-VkDeviceSize VmaBlockMetadata_Linear::GetUnusedRangeSizeMax() const
+void VmaBlockMetadata_Generic::Alloc(
+    const VmaAllocationRequest& request,
+    VmaSuballocationType type,
+    VkDeviceSize allocSize,
+    VmaAllocation hAllocation)
 {
-    const VkDeviceSize size = GetSize();
+    VMA_ASSERT(request.type == VmaAllocationRequestType::Normal);
+    VMA_ASSERT(request.item != m_Suballocations.end());
+    VmaSuballocation& suballoc = *request.item;
+    // Given suballocation is a free block.
+    VMA_ASSERT(suballoc.type == VMA_SUBALLOCATION_TYPE_FREE);
+    // Given offset is inside this suballocation.
+    VMA_ASSERT(request.offset >= suballoc.offset);
+    const VkDeviceSize paddingBegin = request.offset - suballoc.offset;
+    VMA_ASSERT(suballoc.size >= paddingBegin + allocSize);
+    const VkDeviceSize paddingEnd = suballoc.size - paddingBegin - allocSize;
 
-    /*
-    We don't consider gaps inside allocation vectors with freed allocations because
-    they are not suitable for reuse in linear allocator. We consider only space that
-    is available for new allocations.
-    */
-    if(IsEmpty())
+    // Unregister this free suballocation from m_FreeSuballocationsBySize and update
+    // it to become used.
+    UnregisterFreeSuballocation(request.item);
+
+    suballoc.offset = request.offset;
+    suballoc.size = allocSize;
+    suballoc.type = type;
+    suballoc.hAllocation = hAllocation;
+
+    // If there are any free bytes remaining at the end, insert new free suballocation after current one.
+    if(paddingEnd)
     {
-        return size;
+        VmaSuballocation paddingSuballoc = {};
+        paddingSuballoc.offset = request.offset + allocSize;
+        paddingSuballoc.size = paddingEnd;
+        paddingSuballoc.type = VMA_SUBALLOCATION_TYPE_FREE;
+        VmaSuballocationList::iterator next = request.item;
+        ++next;
+        const VmaSuballocationList::iterator paddingEndItem =
+            m_Suballocations.insert(next, paddingSuballoc);
+        RegisterFreeSuballocation(paddingEndItem);
     }
-    
-    const SuballocationVectorType& suballocations1st = AccessSuballocations1st();
 
-    switch(m_2ndVectorMode)
+    // If there are any free bytes remaining at the beginning, insert new free suballocation before current one.
+    if(paddingBegin)
     {
-    case SECOND_VECTOR_EMPTY:
-        /*
-        Available space is after end of 1st, as well as before beginning of 1st (which
-        whould make it a ring buffer).
-        */
-        {
-            const size_t suballocations1stCount = suballocations1st.size();
-            VMA_ASSERT(suballocations1stCount > m_1stNullItemsBeginCount);
-            const VmaSuballocation& firstSuballoc = suballocations1st[m_1stNullItemsBeginCount];
-            const VmaSuballocation& lastSuballoc  = suballocations1st[suballocations1stCount - 1];
-            return VMA_MAX(
-                firstSuballoc.offset,
-                size - (lastSuballoc.offset + lastSuballoc.size));
-        }
-        break;
+        VmaSuballocation paddingSuballoc = {};
+        paddingSuballoc.offset = request.offset - paddingBegin;
+        paddingSuballoc.size = paddingBegin;
+        paddingSuballoc.type = VMA_SUBALLOCATION_TYPE_FREE;
+        const VmaSuballocationList::iterator paddingBeginItem =
+            m_Suballocations.insert(request.item, paddingSuballoc);
+        RegisterFreeSuballocation(paddingBeginItem);
+    }
 
-    case SECOND_VECTOR_RING_BUFFER:
-        /*
-        Available space is only between end of 2nd and beginning of 1st.
-        */
+    // Update totals.
+    m_FreeCount = m_FreeCount - 1;
+    if(paddingBegin > 0)
+    {
+        ++m_FreeCount;
+    }
+    if(paddingEnd > 0)
+    {
+        ++m_FreeCount;
+    }
+    m_SumFreeSize -= allocSize;
+}
+
+void VmaBlockMetadata_Generic::Free(const VmaAllocation allocation)
+{
+    for(VmaSuballocationList::iterator suballocItem = m_Suballocations.begin();
+        suballocItem != m_Suballocations.end();
+        ++suballocItem)
+    {
+        VmaSuballocation& suballoc = *suballocItem;
+        if(suballoc.hAllocation == allocation)
         {
-            const SuballocationVectorType& suballocations2nd = AccessSuballocations2nd();
-            const VmaSuballocation& lastSuballoc2nd = suballocations2nd.back();
-            const VmaSuballocation& firstSuballoc1st = suballocations1st[m_1stNullItemsBeginCount];
-            return firstSuballoc1st.offset - (lastSuballoc2nd.offset + lastSuballoc2nd.size);
+            FreeSuballocation(suballocItem);
+            VMA_HEAVY_ASSERT(Validate());
+            return;
         }
-        break;
+    }
+    VMA_ASSERT(0 && "Not found!");
+}
 
-    case SECOND_VECTOR_DOUBLE_STACK:
-        /*
-        Available space is only between end of 1st and top of 2nd.
-        */
+void VmaBlockMetadata_Generic::FreeAtOffset(VkDeviceSize offset)
+{
+    for(VmaSuballocationList::iterator suballocItem = m_Suballocations.begin();
+        suballocItem != m_Suballocations.end();
+        ++suballocItem)
+    {
+        VmaSuballocation& suballoc = *suballocItem;
+        if(suballoc.offset == offset)
         {
-            const SuballocationVectorType& suballocations2nd = AccessSuballocations2nd();
-            const VmaSuballocation& topSuballoc2nd = suballocations2nd.back();
-            const VmaSuballocation& lastSuballoc1st = suballocations1st.back();
-            return topSuballoc2nd.offset - (lastSuballoc1st.offset + lastSuballoc1st.size);
+            FreeSuballocation(suballocItem);
+            return;
         }
-        break;
-
-    default:
-        VMA_ASSERT(0);
-        return 0;
     }
+    VMA_ASSERT(0 && "Not found!");
 }
 
-void VmaBlockMetadata_Linear::CalcAllocationStatInfo(VmaStatInfo& outInfo) const
+bool VmaBlockMetadata_Generic::ValidateFreeSuballocationList() const
 {
-    const VkDeviceSize size = GetSize();
-    const SuballocationVectorType& suballocations1st = AccessSuballocations1st();
-    const SuballocationVectorType& suballocations2nd = AccessSuballocations2nd();
-    const size_t suballoc1stCount = suballocations1st.size();
-    const size_t suballoc2ndCount = suballocations2nd.size();
+    VkDeviceSize lastSize = 0;
+    for(size_t i = 0, count = m_FreeSuballocationsBySize.size(); i < count; ++i)
+    {
+        const VmaSuballocationList::iterator it = m_FreeSuballocationsBySize[i];
 
-    outInfo.blockCount = 1;
-    outInfo.allocationCount = (uint32_t)GetAllocationCount();
-    outInfo.unusedRangeCount = 0;
-    outInfo.usedBytes = 0;
-    outInfo.allocationSizeMin = UINT64_MAX;
-    outInfo.allocationSizeMax = 0;
-    outInfo.unusedRangeSizeMin = UINT64_MAX;
-    outInfo.unusedRangeSizeMax = 0;
+        VMA_VALIDATE(it->type == VMA_SUBALLOCATION_TYPE_FREE);
+        VMA_VALIDATE(it->size >= VMA_MIN_FREE_SUBALLOCATION_SIZE_TO_REGISTER);
+        VMA_VALIDATE(it->size >= lastSize);
+        lastSize = it->size;
+    }
+    return true;
+}
 
-    VkDeviceSize lastOffset = 0;
+bool VmaBlockMetadata_Generic::CheckAllocation(
+    uint32_t currentFrameIndex,
+    uint32_t frameInUseCount,
+    VkDeviceSize bufferImageGranularity,
+    VkDeviceSize allocSize,
+    VkDeviceSize allocAlignment,
+    VmaSuballocationType allocType,
+    VmaSuballocationList::const_iterator suballocItem,
+    bool canMakeOtherLost,
+    VkDeviceSize* pOffset,
+    size_t* itemsToMakeLostCount,
+    VkDeviceSize* pSumFreeSize,
+    VkDeviceSize* pSumItemSize) const
+{
+    VMA_ASSERT(allocSize > 0);
+    VMA_ASSERT(allocType != VMA_SUBALLOCATION_TYPE_FREE);
+    VMA_ASSERT(suballocItem != m_Suballocations.cend());
+    VMA_ASSERT(pOffset != VMA_NULL);
+    
+    *itemsToMakeLostCount = 0;
+    *pSumFreeSize = 0;
+    *pSumItemSize = 0;
 
-    if(m_2ndVectorMode == SECOND_VECTOR_RING_BUFFER)
+    if(canMakeOtherLost)
     {
-        const VkDeviceSize freeSpace2ndTo1stEnd = suballocations1st[m_1stNullItemsBeginCount].offset;
-        size_t nextAlloc2ndIndex = 0;
-        while(lastOffset < freeSpace2ndTo1stEnd)
+        if(suballocItem->type == VMA_SUBALLOCATION_TYPE_FREE)
         {
-            // Find next non-null allocation or move nextAllocIndex to the end.
-            while(nextAlloc2ndIndex < suballoc2ndCount &&
-                suballocations2nd[nextAlloc2ndIndex].hAllocation == VK_NULL_HANDLE)
-            {
-                ++nextAlloc2ndIndex;
-            }
-
-            // Found non-null allocation.
-            if(nextAlloc2ndIndex < suballoc2ndCount)
+            *pSumFreeSize = suballocItem->size;
+        }
+        else
+        {
+            if(suballocItem->hAllocation->CanBecomeLost() &&
+                suballocItem->hAllocation->GetLastUseFrameIndex() + frameInUseCount < currentFrameIndex)
             {
-                const VmaSuballocation& suballoc = suballocations2nd[nextAlloc2ndIndex];
-            
-                // 1. Process free space before this allocation.
-                if(lastOffset < suballoc.offset)
-                {
-                    // There is free space from lastOffset to suballoc.offset.
-                    const VkDeviceSize unusedRangeSize = suballoc.offset - lastOffset;
-                    ++outInfo.unusedRangeCount;
-                    outInfo.unusedBytes += unusedRangeSize;
-                    outInfo.unusedRangeSizeMin = VMA_MIN(outInfo.unusedRangeSizeMin, unusedRangeSize);
-                    outInfo.unusedRangeSizeMax = VMA_MIN(outInfo.unusedRangeSizeMax, unusedRangeSize);
-                }
-            
-                // 2. Process this allocation.
-                // There is allocation with suballoc.offset, suballoc.size.
-                outInfo.usedBytes += suballoc.size;
-                outInfo.allocationSizeMin = VMA_MIN(outInfo.allocationSizeMin, suballoc.size);
-                outInfo.allocationSizeMax = VMA_MIN(outInfo.allocationSizeMax, suballoc.size);
-            
-                // 3. Prepare for next iteration.
-                lastOffset = suballoc.offset + suballoc.size;
-                ++nextAlloc2ndIndex;
+                ++*itemsToMakeLostCount;
+                *pSumItemSize = suballocItem->size;
             }
-            // We are at the end.
             else
             {
-                // There is free space from lastOffset to freeSpace2ndTo1stEnd.
-                if(lastOffset < freeSpace2ndTo1stEnd)
-                {
-                    const VkDeviceSize unusedRangeSize = freeSpace2ndTo1stEnd - lastOffset;
-                    ++outInfo.unusedRangeCount;
-                    outInfo.unusedBytes += unusedRangeSize;
-                    outInfo.unusedRangeSizeMin = VMA_MIN(outInfo.unusedRangeSizeMin, unusedRangeSize);
-                    outInfo.unusedRangeSizeMax = VMA_MIN(outInfo.unusedRangeSizeMax, unusedRangeSize);
-               }
-
-                // End of loop.
-                lastOffset = freeSpace2ndTo1stEnd;
+                return false;
             }
         }
-    }
 
-    size_t nextAlloc1stIndex = m_1stNullItemsBeginCount;
-    const VkDeviceSize freeSpace1stTo2ndEnd =
-        m_2ndVectorMode == SECOND_VECTOR_DOUBLE_STACK ? suballocations2nd.back().offset : size;
-    while(lastOffset < freeSpace1stTo2ndEnd)
-    {
-        // Find next non-null allocation or move nextAllocIndex to the end.
-        while(nextAlloc1stIndex < suballoc1stCount &&
-            suballocations1st[nextAlloc1stIndex].hAllocation == VK_NULL_HANDLE)
+        // Remaining size is too small for this request: Early return.
+        if(GetSize() - suballocItem->offset < allocSize)
         {
-            ++nextAlloc1stIndex;
+            return false;
         }
 
-        // Found non-null allocation.
-        if(nextAlloc1stIndex < suballoc1stCount)
+        // Start from offset equal to beginning of this suballocation.
+        *pOffset = suballocItem->offset;
+    
+        // Apply VMA_DEBUG_MARGIN at the beginning.
+        if(VMA_DEBUG_MARGIN > 0)
         {
-            const VmaSuballocation& suballoc = suballocations1st[nextAlloc1stIndex];
-            
-            // 1. Process free space before this allocation.
-            if(lastOffset < suballoc.offset)
+            *pOffset += VMA_DEBUG_MARGIN;
+        }
+    
+        // Apply alignment.
+        *pOffset = VmaAlignUp(*pOffset, allocAlignment);
+
+        // Check previous suballocations for BufferImageGranularity conflicts.
+        // Make bigger alignment if necessary.
+        if(bufferImageGranularity > 1)
+        {
+            bool bufferImageGranularityConflict = false;
+            VmaSuballocationList::const_iterator prevSuballocItem = suballocItem;
+            while(prevSuballocItem != m_Suballocations.cbegin())
             {
-                // There is free space from lastOffset to suballoc.offset.
-                const VkDeviceSize unusedRangeSize = suballoc.offset - lastOffset;
-                ++outInfo.unusedRangeCount;
-                outInfo.unusedBytes += unusedRangeSize;
-                outInfo.unusedRangeSizeMin = VMA_MIN(outInfo.unusedRangeSizeMin, unusedRangeSize);
-                outInfo.unusedRangeSizeMax = VMA_MIN(outInfo.unusedRangeSizeMax, unusedRangeSize);
+                --prevSuballocItem;
+                const VmaSuballocation& prevSuballoc = *prevSuballocItem;
+                if(VmaBlocksOnSamePage(prevSuballoc.offset, prevSuballoc.size, *pOffset, bufferImageGranularity))
+                {
+                    if(VmaIsBufferImageGranularityConflict(prevSuballoc.type, allocType))
+                    {
+                        bufferImageGranularityConflict = true;
+                        break;
+                    }
+                }
+                else
+                    // Already on previous page.
+                    break;
+            }
+            if(bufferImageGranularityConflict)
+            {
+                *pOffset = VmaAlignUp(*pOffset, bufferImageGranularity);
             }
-            
-            // 2. Process this allocation.
-            // There is allocation with suballoc.offset, suballoc.size.
-            outInfo.usedBytes += suballoc.size;
-            outInfo.allocationSizeMin = VMA_MIN(outInfo.allocationSizeMin, suballoc.size);
-            outInfo.allocationSizeMax = VMA_MIN(outInfo.allocationSizeMax, suballoc.size);
-            
-            // 3. Prepare for next iteration.
-            lastOffset = suballoc.offset + suballoc.size;
-            ++nextAlloc1stIndex;
         }
-        // We are at the end.
-        else
+    
+        // Now that we have final *pOffset, check if we are past suballocItem.
+        // If yes, return false - this function should be called for another suballocItem as starting point.
+        if(*pOffset >= suballocItem->offset + suballocItem->size)
         {
-            // There is free space from lastOffset to freeSpace1stTo2ndEnd.
-            if(lastOffset < freeSpace1stTo2ndEnd)
-            {
-                const VkDeviceSize unusedRangeSize = freeSpace1stTo2ndEnd - lastOffset;
-                ++outInfo.unusedRangeCount;
-                outInfo.unusedBytes += unusedRangeSize;
-                outInfo.unusedRangeSizeMin = VMA_MIN(outInfo.unusedRangeSizeMin, unusedRangeSize);
-                outInfo.unusedRangeSizeMax = VMA_MIN(outInfo.unusedRangeSizeMax, unusedRangeSize);
-           }
-
-            // End of loop.
-            lastOffset = freeSpace1stTo2ndEnd;
+            return false;
         }
-    }
+    
+        // Calculate padding at the beginning based on current offset.
+        const VkDeviceSize paddingBegin = *pOffset - suballocItem->offset;
 
-    if(m_2ndVectorMode == SECOND_VECTOR_DOUBLE_STACK)
-    {
-        size_t nextAlloc2ndIndex = suballocations2nd.size() - 1;
-        while(lastOffset < size)
+        // Calculate required margin at the end.
+        const VkDeviceSize requiredEndMargin = VMA_DEBUG_MARGIN;
+
+        const VkDeviceSize totalSize = paddingBegin + allocSize + requiredEndMargin;
+        // Another early return check.
+        if(suballocItem->offset + totalSize > GetSize())
         {
-            // Find next non-null allocation or move nextAllocIndex to the end.
-            while(nextAlloc2ndIndex != SIZE_MAX &&
-                suballocations2nd[nextAlloc2ndIndex].hAllocation == VK_NULL_HANDLE)
-            {
-                --nextAlloc2ndIndex;
-            }
+            return false;
+        }
 
-            // Found non-null allocation.
-            if(nextAlloc2ndIndex != SIZE_MAX)
+        // Advance lastSuballocItem until desired size is reached.
+        // Update itemsToMakeLostCount.
+        VmaSuballocationList::const_iterator lastSuballocItem = suballocItem;
+        if(totalSize > suballocItem->size)
+        {
+            VkDeviceSize remainingSize = totalSize - suballocItem->size;
+            while(remainingSize > 0)
             {
-                const VmaSuballocation& suballoc = suballocations2nd[nextAlloc2ndIndex];
-            
-                // 1. Process free space before this allocation.
-                if(lastOffset < suballoc.offset)
+                ++lastSuballocItem;
+                if(lastSuballocItem == m_Suballocations.cend())
                 {
-                    // There is free space from lastOffset to suballoc.offset.
-                    const VkDeviceSize unusedRangeSize = suballoc.offset - lastOffset;
-                    ++outInfo.unusedRangeCount;
-                    outInfo.unusedBytes += unusedRangeSize;
-                    outInfo.unusedRangeSizeMin = VMA_MIN(outInfo.unusedRangeSizeMin, unusedRangeSize);
-                    outInfo.unusedRangeSizeMax = VMA_MIN(outInfo.unusedRangeSizeMax, unusedRangeSize);
+                    return false;
                 }
-            
-                // 2. Process this allocation.
-                // There is allocation with suballoc.offset, suballoc.size.
-                outInfo.usedBytes += suballoc.size;
-                outInfo.allocationSizeMin = VMA_MIN(outInfo.allocationSizeMin, suballoc.size);
-                outInfo.allocationSizeMax = VMA_MIN(outInfo.allocationSizeMax, suballoc.size);
-            
-                // 3. Prepare for next iteration.
-                lastOffset = suballoc.offset + suballoc.size;
-                --nextAlloc2ndIndex;
-            }
-            // We are at the end.
-            else
-            {
-                // There is free space from lastOffset to size.
-                if(lastOffset < size)
+                if(lastSuballocItem->type == VMA_SUBALLOCATION_TYPE_FREE)
                 {
-                    const VkDeviceSize unusedRangeSize = size - lastOffset;
-                    ++outInfo.unusedRangeCount;
-                    outInfo.unusedBytes += unusedRangeSize;
-                    outInfo.unusedRangeSizeMin = VMA_MIN(outInfo.unusedRangeSizeMin, unusedRangeSize);
-                    outInfo.unusedRangeSizeMax = VMA_MIN(outInfo.unusedRangeSizeMax, unusedRangeSize);
-               }
-
-                // End of loop.
-                lastOffset = size;
+                    *pSumFreeSize += lastSuballocItem->size;
+                }
+                else
+                {
+                    VMA_ASSERT(lastSuballocItem->hAllocation != VK_NULL_HANDLE);
+                    if(lastSuballocItem->hAllocation->CanBecomeLost() &&
+                        lastSuballocItem->hAllocation->GetLastUseFrameIndex() + frameInUseCount < currentFrameIndex)
+                    {
+                        ++*itemsToMakeLostCount;
+                        *pSumItemSize += lastSuballocItem->size;
+                    }
+                    else
+                    {
+                        return false;
+                    }
+                }
+                remainingSize = (lastSuballocItem->size < remainingSize) ?
+                    remainingSize - lastSuballocItem->size : 0;
             }
         }
-    }
-
-    outInfo.unusedBytes = size - outInfo.usedBytes;
-}
-
-void VmaBlockMetadata_Linear::AddPoolStats(VmaPoolStats& inoutStats) const
-{
-    const SuballocationVectorType& suballocations1st = AccessSuballocations1st();
-    const SuballocationVectorType& suballocations2nd = AccessSuballocations2nd();
-    const VkDeviceSize size = GetSize();
-    const size_t suballoc1stCount = suballocations1st.size();
-    const size_t suballoc2ndCount = suballocations2nd.size();
-
-    inoutStats.size += size;
-
-    VkDeviceSize lastOffset = 0;
 
-    if(m_2ndVectorMode == SECOND_VECTOR_RING_BUFFER)
-    {
-        const VkDeviceSize freeSpace2ndTo1stEnd = suballocations1st[m_1stNullItemsBeginCount].offset;
-        size_t nextAlloc2ndIndex = m_1stNullItemsBeginCount;
-        while(lastOffset < freeSpace2ndTo1stEnd)
+        // Check next suballocations for BufferImageGranularity conflicts.
+        // If conflict exists, we must mark more allocations lost or fail.
+        if(bufferImageGranularity > 1)
         {
-            // Find next non-null allocation or move nextAlloc2ndIndex to the end.
-            while(nextAlloc2ndIndex < suballoc2ndCount &&
-                suballocations2nd[nextAlloc2ndIndex].hAllocation == VK_NULL_HANDLE)
-            {
-                ++nextAlloc2ndIndex;
-            }
-
-            // Found non-null allocation.
-            if(nextAlloc2ndIndex < suballoc2ndCount)
+            VmaSuballocationList::const_iterator nextSuballocItem = lastSuballocItem;
+            ++nextSuballocItem;
+            while(nextSuballocItem != m_Suballocations.cend())
             {
-                const VmaSuballocation& suballoc = suballocations2nd[nextAlloc2ndIndex];
-            
-                // 1. Process free space before this allocation.
-                if(lastOffset < suballoc.offset)
+                const VmaSuballocation& nextSuballoc = *nextSuballocItem;
+                if(VmaBlocksOnSamePage(*pOffset, allocSize, nextSuballoc.offset, bufferImageGranularity))
                 {
-                    // There is free space from lastOffset to suballoc.offset.
-                    const VkDeviceSize unusedRangeSize = suballoc.offset - lastOffset;
-                    inoutStats.unusedSize += unusedRangeSize;
-                    ++inoutStats.unusedRangeCount;
-                    inoutStats.unusedRangeSizeMax = VMA_MAX(inoutStats.unusedRangeSizeMax, unusedRangeSize);
+                    if(VmaIsBufferImageGranularityConflict(allocType, nextSuballoc.type))
+                    {
+                        VMA_ASSERT(nextSuballoc.hAllocation != VK_NULL_HANDLE);
+                        if(nextSuballoc.hAllocation->CanBecomeLost() &&
+                            nextSuballoc.hAllocation->GetLastUseFrameIndex() + frameInUseCount < currentFrameIndex)
+                        {
+                            ++*itemsToMakeLostCount;
+                        }
+                        else
+                        {
+                            return false;
+                        }
+                    }
                 }
-            
-                // 2. Process this allocation.
-                // There is allocation with suballoc.offset, suballoc.size.
-                ++inoutStats.allocationCount;
-            
-                // 3. Prepare for next iteration.
-                lastOffset = suballoc.offset + suballoc.size;
-                ++nextAlloc2ndIndex;
-            }
-            // We are at the end.
-            else
-            {
-                if(lastOffset < freeSpace2ndTo1stEnd)
+                else
                 {
-                    // There is free space from lastOffset to freeSpace2ndTo1stEnd.
-                    const VkDeviceSize unusedRangeSize = freeSpace2ndTo1stEnd - lastOffset;
-                    inoutStats.unusedSize += unusedRangeSize;
-                    ++inoutStats.unusedRangeCount;
-                    inoutStats.unusedRangeSizeMax = VMA_MAX(inoutStats.unusedRangeSizeMax, unusedRangeSize);
+                    // Already on next page.
+                    break;
                 }
-
-                // End of loop.
-                lastOffset = freeSpace2ndTo1stEnd;
+                ++nextSuballocItem;
             }
         }
     }
-
-    size_t nextAlloc1stIndex = m_1stNullItemsBeginCount;
-    const VkDeviceSize freeSpace1stTo2ndEnd =
-        m_2ndVectorMode == SECOND_VECTOR_DOUBLE_STACK ? suballocations2nd.back().offset : size;
-    while(lastOffset < freeSpace1stTo2ndEnd)
+    else
     {
-        // Find next non-null allocation or move nextAllocIndex to the end.
-        while(nextAlloc1stIndex < suballoc1stCount &&
-            suballocations1st[nextAlloc1stIndex].hAllocation == VK_NULL_HANDLE)
+        const VmaSuballocation& suballoc = *suballocItem;
+        VMA_ASSERT(suballoc.type == VMA_SUBALLOCATION_TYPE_FREE);
+
+        *pSumFreeSize = suballoc.size;
+
+        // Size of this suballocation is too small for this request: Early return.
+        if(suballoc.size < allocSize)
         {
-            ++nextAlloc1stIndex;
+            return false;
         }
 
-        // Found non-null allocation.
-        if(nextAlloc1stIndex < suballoc1stCount)
+        // Start from offset equal to beginning of this suballocation.
+        *pOffset = suballoc.offset;
+    
+        // Apply VMA_DEBUG_MARGIN at the beginning.
+        if(VMA_DEBUG_MARGIN > 0)
         {
-            const VmaSuballocation& suballoc = suballocations1st[nextAlloc1stIndex];
-            
-            // 1. Process free space before this allocation.
-            if(lastOffset < suballoc.offset)
-            {
-                // There is free space from lastOffset to suballoc.offset.
-                const VkDeviceSize unusedRangeSize = suballoc.offset - lastOffset;
-                inoutStats.unusedSize += unusedRangeSize;
-                ++inoutStats.unusedRangeCount;
-                inoutStats.unusedRangeSizeMax = VMA_MAX(inoutStats.unusedRangeSizeMax, unusedRangeSize);
-            }
-            
-            // 2. Process this allocation.
-            // There is allocation with suballoc.offset, suballoc.size.
-            ++inoutStats.allocationCount;
-            
-            // 3. Prepare for next iteration.
-            lastOffset = suballoc.offset + suballoc.size;
-            ++nextAlloc1stIndex;
+            *pOffset += VMA_DEBUG_MARGIN;
         }
-        // We are at the end.
-        else
+    
+        // Apply alignment.
+        *pOffset = VmaAlignUp(*pOffset, allocAlignment);
+    
+        // Check previous suballocations for BufferImageGranularity conflicts.
+        // Make bigger alignment if necessary.
+        if(bufferImageGranularity > 1)
         {
-            if(lastOffset < freeSpace1stTo2ndEnd)
+            bool bufferImageGranularityConflict = false;
+            VmaSuballocationList::const_iterator prevSuballocItem = suballocItem;
+            while(prevSuballocItem != m_Suballocations.cbegin())
             {
-                // There is free space from lastOffset to freeSpace1stTo2ndEnd.
-                const VkDeviceSize unusedRangeSize = freeSpace1stTo2ndEnd - lastOffset;
-                inoutStats.unusedSize += unusedRangeSize;
-                ++inoutStats.unusedRangeCount;
-                inoutStats.unusedRangeSizeMax = VMA_MAX(inoutStats.unusedRangeSizeMax, unusedRangeSize);
+                --prevSuballocItem;
+                const VmaSuballocation& prevSuballoc = *prevSuballocItem;
+                if(VmaBlocksOnSamePage(prevSuballoc.offset, prevSuballoc.size, *pOffset, bufferImageGranularity))
+                {
+                    if(VmaIsBufferImageGranularityConflict(prevSuballoc.type, allocType))
+                    {
+                        bufferImageGranularityConflict = true;
+                        break;
+                    }
+                }
+                else
+                    // Already on previous page.
+                    break;
+            }
+            if(bufferImageGranularityConflict)
+            {
+                *pOffset = VmaAlignUp(*pOffset, bufferImageGranularity);
             }
-
-            // End of loop.
-            lastOffset = freeSpace1stTo2ndEnd;
         }
-    }
+    
+        // Calculate padding at the beginning based on current offset.
+        const VkDeviceSize paddingBegin = *pOffset - suballoc.offset;
 
-    if(m_2ndVectorMode == SECOND_VECTOR_DOUBLE_STACK)
-    {
-        size_t nextAlloc2ndIndex = suballocations2nd.size() - 1;
-        while(lastOffset < size)
+        // Calculate required margin at the end.
+        const VkDeviceSize requiredEndMargin = VMA_DEBUG_MARGIN;
+
+        // Fail if requested size plus margin before and after is bigger than size of this suballocation.
+        if(paddingBegin + allocSize + requiredEndMargin > suballoc.size)
         {
-            // Find next non-null allocation or move nextAlloc2ndIndex to the end.
-            while(nextAlloc2ndIndex != SIZE_MAX &&
-                suballocations2nd[nextAlloc2ndIndex].hAllocation == VK_NULL_HANDLE)
-            {
-                --nextAlloc2ndIndex;
-            }
+            return false;
+        }
 
-            // Found non-null allocation.
-            if(nextAlloc2ndIndex != SIZE_MAX)
+        // Check next suballocations for BufferImageGranularity conflicts.
+        // If conflict exists, allocation cannot be made here.
+        if(bufferImageGranularity > 1)
+        {
+            VmaSuballocationList::const_iterator nextSuballocItem = suballocItem;
+            ++nextSuballocItem;
+            while(nextSuballocItem != m_Suballocations.cend())
             {
-                const VmaSuballocation& suballoc = suballocations2nd[nextAlloc2ndIndex];
-            
-                // 1. Process free space before this allocation.
-                if(lastOffset < suballoc.offset)
+                const VmaSuballocation& nextSuballoc = *nextSuballocItem;
+                if(VmaBlocksOnSamePage(*pOffset, allocSize, nextSuballoc.offset, bufferImageGranularity))
                 {
-                    // There is free space from lastOffset to suballoc.offset.
-                    const VkDeviceSize unusedRangeSize = suballoc.offset - lastOffset;
-                    inoutStats.unusedSize += unusedRangeSize;
-                    ++inoutStats.unusedRangeCount;
-                    inoutStats.unusedRangeSizeMax = VMA_MAX(inoutStats.unusedRangeSizeMax, unusedRangeSize);
+                    if(VmaIsBufferImageGranularityConflict(allocType, nextSuballoc.type))
+                    {
+                        return false;
+                    }
                 }
-            
-                // 2. Process this allocation.
-                // There is allocation with suballoc.offset, suballoc.size.
-                ++inoutStats.allocationCount;
-            
-                // 3. Prepare for next iteration.
-                lastOffset = suballoc.offset + suballoc.size;
-                --nextAlloc2ndIndex;
-            }
-            // We are at the end.
-            else
-            {
-                if(lastOffset < size)
+                else
                 {
-                    // There is free space from lastOffset to size.
-                    const VkDeviceSize unusedRangeSize = size - lastOffset;
-                    inoutStats.unusedSize += unusedRangeSize;
-                    ++inoutStats.unusedRangeCount;
-                    inoutStats.unusedRangeSizeMax = VMA_MAX(inoutStats.unusedRangeSizeMax, unusedRangeSize);
+                    // Already on next page.
+                    break;
                 }
-
-                // End of loop.
-                lastOffset = size;
+                ++nextSuballocItem;
             }
         }
     }
+
+    // All tests passed: Success. pOffset is already filled.
+    return true;
 }
 
-#if VMA_STATS_STRING_ENABLED
-void VmaBlockMetadata_Linear::PrintDetailedMap(class VmaJsonWriter& json) const
+void VmaBlockMetadata_Generic::MergeFreeWithNext(VmaSuballocationList::iterator item)
 {
-    const VkDeviceSize size = GetSize();
-    const SuballocationVectorType& suballocations1st = AccessSuballocations1st();
-    const SuballocationVectorType& suballocations2nd = AccessSuballocations2nd();
-    const size_t suballoc1stCount = suballocations1st.size();
-    const size_t suballoc2ndCount = suballocations2nd.size();
+    VMA_ASSERT(item != m_Suballocations.end());
+    VMA_ASSERT(item->type == VMA_SUBALLOCATION_TYPE_FREE);
+    
+    VmaSuballocationList::iterator nextItem = item;
+    ++nextItem;
+    VMA_ASSERT(nextItem != m_Suballocations.end());
+    VMA_ASSERT(nextItem->type == VMA_SUBALLOCATION_TYPE_FREE);
 
-    // FIRST PASS
+    item->size += nextItem->size;
+    --m_FreeCount;
+    m_Suballocations.erase(nextItem);
+}
 
-    size_t unusedRangeCount = 0;
-    VkDeviceSize usedBytes = 0;
+VmaSuballocationList::iterator VmaBlockMetadata_Generic::FreeSuballocation(VmaSuballocationList::iterator suballocItem)
+{
+    // Change this suballocation to be marked as free.
+    VmaSuballocation& suballoc = *suballocItem;
+    suballoc.type = VMA_SUBALLOCATION_TYPE_FREE;
+    suballoc.hAllocation = VK_NULL_HANDLE;
+    
+    // Update totals.
+    ++m_FreeCount;
+    m_SumFreeSize += suballoc.size;
 
-    VkDeviceSize lastOffset = 0;
+    // Merge with previous and/or next suballocation if it's also free.
+    bool mergeWithNext = false;
+    bool mergeWithPrev = false;
+    
+    VmaSuballocationList::iterator nextItem = suballocItem;
+    ++nextItem;
+    if((nextItem != m_Suballocations.end()) && (nextItem->type == VMA_SUBALLOCATION_TYPE_FREE))
+    {
+        mergeWithNext = true;
+    }
 
-    size_t alloc2ndCount = 0;
-    if(m_2ndVectorMode == SECOND_VECTOR_RING_BUFFER)
+    VmaSuballocationList::iterator prevItem = suballocItem;
+    if(suballocItem != m_Suballocations.begin())
     {
-        const VkDeviceSize freeSpace2ndTo1stEnd = suballocations1st[m_1stNullItemsBeginCount].offset;
-        size_t nextAlloc2ndIndex = 0;
-        while(lastOffset < freeSpace2ndTo1stEnd)
+        --prevItem;
+        if(prevItem->type == VMA_SUBALLOCATION_TYPE_FREE)
         {
-            // Find next non-null allocation or move nextAlloc2ndIndex to the end.
-            while(nextAlloc2ndIndex < suballoc2ndCount &&
-                suballocations2nd[nextAlloc2ndIndex].hAllocation == VK_NULL_HANDLE)
-            {
-                ++nextAlloc2ndIndex;
-            }
+            mergeWithPrev = true;
+        }
+    }
 
-            // Found non-null allocation.
-            if(nextAlloc2ndIndex < suballoc2ndCount)
-            {
-                const VmaSuballocation& suballoc = suballocations2nd[nextAlloc2ndIndex];
-            
-                // 1. Process free space before this allocation.
-                if(lastOffset < suballoc.offset)
-                {
-                    // There is free space from lastOffset to suballoc.offset.
-                    ++unusedRangeCount;
-                }
-            
-                // 2. Process this allocation.
-                // There is allocation with suballoc.offset, suballoc.size.
-                ++alloc2ndCount;
-                usedBytes += suballoc.size;
-            
-                // 3. Prepare for next iteration.
-                lastOffset = suballoc.offset + suballoc.size;
-                ++nextAlloc2ndIndex;
-            }
-            // We are at the end.
-            else
-            {
-                if(lastOffset < freeSpace2ndTo1stEnd)
-                {
-                    // There is free space from lastOffset to freeSpace2ndTo1stEnd.
-                    ++unusedRangeCount;
-                }
+    if(mergeWithNext)
+    {
+        UnregisterFreeSuballocation(nextItem);
+        MergeFreeWithNext(suballocItem);
+    }
 
-                // End of loop.
-                lastOffset = freeSpace2ndTo1stEnd;
-            }
-        }
+    if(mergeWithPrev)
+    {
+        UnregisterFreeSuballocation(prevItem);
+        MergeFreeWithNext(prevItem);
+        RegisterFreeSuballocation(prevItem);
+        return prevItem;
+    }
+    else
+    {
+        RegisterFreeSuballocation(suballocItem);
+        return suballocItem;
     }
+}
 
-    size_t nextAlloc1stIndex = m_1stNullItemsBeginCount;
-    size_t alloc1stCount = 0;
-    const VkDeviceSize freeSpace1stTo2ndEnd =
-        m_2ndVectorMode == SECOND_VECTOR_DOUBLE_STACK ? suballocations2nd.back().offset : size;
-    while(lastOffset < freeSpace1stTo2ndEnd)
+void VmaBlockMetadata_Generic::RegisterFreeSuballocation(VmaSuballocationList::iterator item)
+{
+    VMA_ASSERT(item->type == VMA_SUBALLOCATION_TYPE_FREE);
+    VMA_ASSERT(item->size > 0);
+
+    // You may want to enable this validation at the beginning or at the end of
+    // this function, depending on what do you want to check.
+    VMA_HEAVY_ASSERT(ValidateFreeSuballocationList());
+
+    if(item->size >= VMA_MIN_FREE_SUBALLOCATION_SIZE_TO_REGISTER)
     {
-        // Find next non-null allocation or move nextAllocIndex to the end.
-        while(nextAlloc1stIndex < suballoc1stCount &&
-            suballocations1st[nextAlloc1stIndex].hAllocation == VK_NULL_HANDLE)
+        if(m_FreeSuballocationsBySize.empty())
         {
-            ++nextAlloc1stIndex;
+            m_FreeSuballocationsBySize.push_back(item);
         }
-
-        // Found non-null allocation.
-        if(nextAlloc1stIndex < suballoc1stCount)
+        else
         {
-            const VmaSuballocation& suballoc = suballocations1st[nextAlloc1stIndex];
-            
-            // 1. Process free space before this allocation.
-            if(lastOffset < suballoc.offset)
-            {
-                // There is free space from lastOffset to suballoc.offset.
-                ++unusedRangeCount;
-            }
-            
-            // 2. Process this allocation.
-            // There is allocation with suballoc.offset, suballoc.size.
-            ++alloc1stCount;
-            usedBytes += suballoc.size;
-            
-            // 3. Prepare for next iteration.
-            lastOffset = suballoc.offset + suballoc.size;
-            ++nextAlloc1stIndex;
+            VmaVectorInsertSorted<VmaSuballocationItemSizeLess>(m_FreeSuballocationsBySize, item);
         }
-        // We are at the end.
-        else
+    }
+
+    //VMA_HEAVY_ASSERT(ValidateFreeSuballocationList());
+}
+
+
+void VmaBlockMetadata_Generic::UnregisterFreeSuballocation(VmaSuballocationList::iterator item)
+{
+    VMA_ASSERT(item->type == VMA_SUBALLOCATION_TYPE_FREE);
+    VMA_ASSERT(item->size > 0);
+
+    // You may want to enable this validation at the beginning or at the end of
+    // this function, depending on what do you want to check.
+    VMA_HEAVY_ASSERT(ValidateFreeSuballocationList());
+
+    if(item->size >= VMA_MIN_FREE_SUBALLOCATION_SIZE_TO_REGISTER)
+    {
+        VmaSuballocationList::iterator* const it = VmaBinaryFindFirstNotLess(
+            m_FreeSuballocationsBySize.data(),
+            m_FreeSuballocationsBySize.data() + m_FreeSuballocationsBySize.size(),
+            item,
+            VmaSuballocationItemSizeLess());
+        for(size_t index = it - m_FreeSuballocationsBySize.data();
+            index < m_FreeSuballocationsBySize.size();
+            ++index)
         {
-            if(lastOffset < size)
+            if(m_FreeSuballocationsBySize[index] == item)
             {
-                // There is free space from lastOffset to freeSpace1stTo2ndEnd.
-                ++unusedRangeCount;
+                VmaVectorRemove(m_FreeSuballocationsBySize, index);
+                return;
             }
-
-            // End of loop.
-            lastOffset = freeSpace1stTo2ndEnd;
+            VMA_ASSERT((m_FreeSuballocationsBySize[index]->size == item->size) && "Not found.");
         }
+        VMA_ASSERT(0 && "Not found.");
     }
 
-    if(m_2ndVectorMode == SECOND_VECTOR_DOUBLE_STACK)
+    //VMA_HEAVY_ASSERT(ValidateFreeSuballocationList());
+}
+
+bool VmaBlockMetadata_Generic::IsBufferImageGranularityConflictPossible(
+    VkDeviceSize bufferImageGranularity,
+    VmaSuballocationType& inOutPrevSuballocType) const
+{
+    if(bufferImageGranularity == 1 || IsEmpty())
     {
-        size_t nextAlloc2ndIndex = suballocations2nd.size() - 1;
-        while(lastOffset < size)
+        return false;
+    }
+
+    VkDeviceSize minAlignment = VK_WHOLE_SIZE;
+    bool typeConflictFound = false;
+    for(VmaSuballocationList::const_iterator it = m_Suballocations.cbegin();
+        it != m_Suballocations.cend();
+        ++it)
+    {
+        const VmaSuballocationType suballocType = it->type;
+        if(suballocType != VMA_SUBALLOCATION_TYPE_FREE)
         {
-            // Find next non-null allocation or move nextAlloc2ndIndex to the end.
-            while(nextAlloc2ndIndex != SIZE_MAX &&
-                suballocations2nd[nextAlloc2ndIndex].hAllocation == VK_NULL_HANDLE)
+            minAlignment = VMA_MIN(minAlignment, it->hAllocation->GetAlignment());
+            if(VmaIsBufferImageGranularityConflict(inOutPrevSuballocType, suballocType))
             {
-                --nextAlloc2ndIndex;
+                typeConflictFound = true;
             }
+            inOutPrevSuballocType = suballocType;
+        }
+    }
 
-            // Found non-null allocation.
-            if(nextAlloc2ndIndex != SIZE_MAX)
-            {
-                const VmaSuballocation& suballoc = suballocations2nd[nextAlloc2ndIndex];
-            
-                // 1. Process free space before this allocation.
-                if(lastOffset < suballoc.offset)
-                {
-                    // There is free space from lastOffset to suballoc.offset.
-                    ++unusedRangeCount;
-                }
-            
-                // 2. Process this allocation.
-                // There is allocation with suballoc.offset, suballoc.size.
-                ++alloc2ndCount;
-                usedBytes += suballoc.size;
-            
-                // 3. Prepare for next iteration.
-                lastOffset = suballoc.offset + suballoc.size;
-                --nextAlloc2ndIndex;
-            }
-            // We are at the end.
-            else
-            {
-                if(lastOffset < size)
-                {
-                    // There is free space from lastOffset to size.
-                    ++unusedRangeCount;
-                }
+    return typeConflictFound || minAlignment >= bufferImageGranularity;
+}
 
-                // End of loop.
-                lastOffset = size;
-            }
+void VmaBlockMetadata_Generic::InitSnapshot(const VmaBlockMetadata_Generic& src)
+{
+    VmaBlockMetadata::Init(src.GetSize());
+
+    m_IsSnapshot = true;
+    m_FreeCount = src.m_FreeCount;
+    m_SumFreeSize = src.m_SumFreeSize;
+
+    // Registered free suballocations of the copy, sorted by offset.
+    const VmaStlAllocator< VmaSuballocationList::iterator > iteratorAllocator(GetAllocationCallbacks());
+    VmaVector< VmaSuballocationList::iterator, VmaStlAllocator< VmaSuballocationList::iterator > > freeSuballocationsByOffset(iteratorAllocator);
+    freeSuballocationsByOffset.reserve(src.m_FreeSuballocationsBySize.size());
+    for(VmaSuballocationList::const_iterator srcIt = src.m_Suballocations.cbegin();
+        srcIt != src.m_Suballocations.cend();
+        ++srcIt)
+    {
+        m_Suballocations.push_back(*srcIt);
+        if(srcIt->type == VMA_SUBALLOCATION_TYPE_FREE &&
+            srcIt->size >= VMA_MIN_FREE_SUBALLOCATION_SIZE_TO_REGISTER)
+        {
+            VmaSuballocationList::iterator suballocItem = m_Suballocations.end();
+            --suballocItem;
+            freeSuballocationsByOffset.push_back(suballocItem);
         }
     }
 
-    const VkDeviceSize unusedBytes = size - usedBytes;
-    PrintDetailedMap_Begin(json, unusedBytes, alloc1stCount + alloc2ndCount, unusedRangeCount);
+    // Keep exactly the same order of items with equal size as in src, so the copy makes the same choices.
+    m_FreeSuballocationsBySize.resize(src.m_FreeSuballocationsBySize.size());
+    for(size_t i = 0; i < src.m_FreeSuballocationsBySize.size(); ++i)
+    {
+        const VkDeviceSize offset = src.m_FreeSuballocationsBySize[i]->offset;
+        VmaSuballocationList::iterator* const pItem = VmaBinaryFindFirstNotLess(
+            freeSuballocationsByOffset.data(),
+            freeSuballocationsByOffset.data() + freeSuballocationsByOffset.size(),
+            offset,
+            [](const VmaSuballocationList::iterator& lhs, VkDeviceSize rhsOffset) -> bool {
+                return lhs->offset < rhsOffset;
+            });
+        VMA_ASSERT(pItem != freeSuballocationsByOffset.data() + freeSuballocationsByOffset.size() &&
+            (*pItem)->offset == offset);
+        m_FreeSuballocationsBySize[i] = *pItem;
+    }
 
-    // SECOND PASS
-    lastOffset = 0;
+    VMA_HEAVY_ASSERT(Validate());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// class VmaBlockMetadata_Linear
+
+VmaBlockMetadata_Linear::VmaBlockMetadata_Linear(VmaAllocator hAllocator) :
+    VmaBlockMetadata(hAllocator),
+    m_IsSnapshot(false),
+    m_SumFreeSize(0),
+    m_Suballocations0(VmaStlAllocator<VmaSuballocation>(hAllocator->GetAllocationCallbacks())),
+    m_Suballocations1(VmaStlAllocator<VmaSuballocation>(hAllocator->GetAllocationCallbacks())),
+    m_1stVectorIndex(0),
+    m_2ndVectorMode(SECOND_VECTOR_EMPTY),
+    m_1stNullItemsBeginCount(0),
+    m_1stNullItemsMiddleCount(0),
+    m_2ndNullItemsCount(0),
+    m_HandlelessCount(0)
+{
+}
+
+VmaBlockMetadata_Linear::~VmaBlockMetadata_Linear()
+{
+}
+
+void VmaBlockMetadata_Linear::Init(VkDeviceSize size)
+{
+    VmaBlockMetadata::Init(size);
+    m_SumFreeSize = size;
+}
+
+void VmaBlockMetadata_Linear::InitSnapshot(const VmaBlockMetadata_Linear& src)
+{
+    VmaBlockMetadata::Init(src.GetSize());
+
+    m_IsSnapshot = true;
+    m_SumFreeSize = src.m_SumFreeSize;
+    m_Suballocations0 = src.m_Suballocations0;
+    m_Suballocations1 = src.m_Suballocations1;
+    m_1stVectorIndex = src.m_1stVectorIndex;
+    m_2ndVectorMode = src.m_2ndVectorMode;
+    m_1stNullItemsBeginCount = src.m_1stNullItemsBeginCount;
+    m_1stNullItemsMiddleCount = src.m_1stNullItemsMiddleCount;
+    m_2ndNullItemsCount = src.m_2ndNullItemsCount;
+    m_HandlelessCount = src.m_HandlelessCount;
+
+    VMA_HEAVY_ASSERT(Validate());
+}
+
+bool VmaBlockMetadata_Linear::Validate() const
+{
+    const SuballocationVectorType& suballocations1st = AccessSuballocations1st();
+    const SuballocationVectorType& suballocations2nd = AccessSuballocations2nd();
+
+    VMA_VALIDATE(suballocations2nd.empty() == (m_2ndVectorMode == SECOND_VECTOR_EMPTY));
+    VMA_VALIDATE(!suballocations1st.empty() ||
+        suballocations2nd.empty() ||
+        m_2ndVectorMode != SECOND_VECTOR_RING_BUFFER);
+
+    if(!suballocations1st.empty())
+    {
+        // Null item at the beginning should be accounted into m_1stNullItemsBeginCount.
+        VMA_VALIDATE(suballocations1st[m_1stNullItemsBeginCount].type != VMA_SUBALLOCATION_TYPE_FREE);
+        // Null item at the end should be just pop_back().
+        VMA_VALIDATE(suballocations1st.back().type != VMA_SUBALLOCATION_TYPE_FREE);
+    }
+    if(!suballocations2nd.empty())
+    {
+        // Null item at the end should be just pop_back().
+        VMA_VALIDATE(suballocations2nd.back().type != VMA_SUBALLOCATION_TYPE_FREE);
+    }
+
+    VMA_VALIDATE(m_1stNullItemsBeginCount + m_1stNullItemsMiddleCount <= suballocations1st.size());
+    VMA_VALIDATE(m_2ndNullItemsCount <= suballocations2nd.size());
+
+    VkDeviceSize sumUsedSize = 0;
+    size_t handlelessCount = 0;
+    const size_t suballoc1stCount = suballocations1st.size();
+    VkDeviceSize offset = VMA_DEBUG_MARGIN;
 
     if(m_2ndVectorMode == SECOND_VECTOR_RING_BUFFER)
     {
-        const VkDeviceSize freeSpace2ndTo1stEnd = suballocations1st[m_1stNullItemsBeginCount].offset;
-        size_t nextAlloc2ndIndex = 0;
-        while(lastOffset < freeSpace2ndTo1stEnd)
+        const size_t suballoc2ndCount = suballocations2nd.size();
+        size_t nullItem2ndCount = 0;
+        for(size_t i = 0; i < suballoc2ndCount; ++i)
         {
-            // Find next non-null allocation or move nextAlloc2ndIndex to the end.
-            while(nextAlloc2ndIndex < suballoc2ndCount &&
-                suballocations2nd[nextAlloc2ndIndex].hAllocation == VK_NULL_HANDLE)
-            {
-                ++nextAlloc2ndIndex;
-            }
+            const VmaSuballocation& suballoc = suballocations2nd[i];
+            const bool currFree = (suballoc.type == VMA_SUBALLOCATION_TYPE_FREE);
 
-            // Found non-null allocation.
-            if(nextAlloc2ndIndex < suballoc2ndCount)
+            VMA_VALIDATE(!currFree || suballoc.hAllocation == VK_NULL_HANDLE);
+            VMA_VALIDATE(suballoc.offset >= offset);
+
+            if(!currFree)
             {
-                const VmaSuballocation& suballoc = suballocations2nd[nextAlloc2ndIndex];
-            
-                // 1. Process free space before this allocation.
-                if(lastOffset < suballoc.offset)
+                if(suballoc.hAllocation != VK_NULL_HANDLE)
                 {
-                    // There is free space from lastOffset to suballoc.offset.
-                    const VkDeviceSize unusedRangeSize = suballoc.offset - lastOffset;
-                    PrintDetailedMap_UnusedRange(json, lastOffset, unusedRangeSize);
+                    VMA_VALIDATE(m_IsSnapshot || suballoc.hAllocation->GetOffset() == suballoc.offset);
+                    VMA_VALIDATE(suballoc.hAllocation->GetSize() == suballoc.size);
                 }
-            
-                // 2. Process this allocation.
-                // There is allocation with suballoc.offset, suballoc.size.
-                PrintDetailedMap_Allocation(json, suballoc.offset, suballoc.hAllocation);
-            
-                // 3. Prepare for next iteration.
-                lastOffset = suballoc.offset + suballoc.size;
-                ++nextAlloc2ndIndex;
+                else
+                {
+                    ++handlelessCount;
+                }
+                sumUsedSize += suballoc.size;
             }
-            // We are at the end.
             else
             {
-                if(lastOffset < freeSpace2ndTo1stEnd)
-                {
-                    // There is free space from lastOffset to freeSpace2ndTo1stEnd.
-                    const VkDeviceSize unusedRangeSize = freeSpace2ndTo1stEnd - lastOffset;
-                    PrintDetailedMap_UnusedRange(json, lastOffset, unusedRangeSize);
-                }
-
-                // End of loop.
-                lastOffset = freeSpace2ndTo1stEnd;
+                ++nullItem2ndCount;
             }
+
+            offset = suballoc.offset + suballoc.size + VMA_DEBUG_MARGIN;
         }
+
+        VMA_VALIDATE(nullItem2ndCount == m_2ndNullItemsCount);
     }
 
-    nextAlloc1stIndex = m_1stNullItemsBeginCount;
-    while(lastOffset < freeSpace1stTo2ndEnd)
+    for(size_t i = 0; i < m_1stNullItemsBeginCount; ++i)
     {
-        // Find next non-null allocation or move nextAllocIndex to the end.
-        while(nextAlloc1stIndex < suballoc1stCount &&
-            suballocations1st[nextAlloc1stIndex].hAllocation == VK_NULL_HANDLE)
+        const VmaSuballocation& suballoc = suballocations1st[i];
+        VMA_VALIDATE(suballoc.type == VMA_SUBALLOCATION_TYPE_FREE &&
+            suballoc.hAllocation == VK_NULL_HANDLE);
+    }
+
+    size_t nullItem1stCount = m_1stNullItemsBeginCount;
+
+    for(size_t i = m_1stNullItemsBeginCount; i < suballoc1stCount; ++i)
+    {
+        const VmaSuballocation& suballoc = suballocations1st[i];
+        const bool currFree = (suballoc.type == VMA_SUBALLOCATION_TYPE_FREE);
+
+        VMA_VALIDATE(!currFree || suballoc.hAllocation == VK_NULL_HANDLE);
+        VMA_VALIDATE(suballoc.offset >= offset);
+        VMA_VALIDATE(i >= m_1stNullItemsBeginCount || currFree);
+
+        if(!currFree)
+        {
+            if(suballoc.hAllocation != VK_NULL_HANDLE)
+            {
+                VMA_VALIDATE(m_IsSnapshot || suballoc.hAllocation->GetOffset() == suballoc.offset);
+                VMA_VALIDATE(suballoc.hAllocation->GetSize() == suballoc.size);
+            }
+            else
+            {
+                ++handlelessCount;
+            }
+            sumUsedSize += suballoc.size;
+        }
+        else
+        {
+            ++nullItem1stCount;
+        }
+
+        offset = suballoc.offset + suballoc.size + VMA_DEBUG_MARGIN;
+    }
+    VMA_VALIDATE(nullItem1stCount == m_1stNullItemsBeginCount + m_1stNullItemsMiddleCount);
+
+    if(m_2ndVectorMode == SECOND_VECTOR_DOUBLE_STACK)
+    {
+        const size_t suballoc2ndCount = suballocations2nd.size();
+        size_t nullItem2ndCount = 0;
+        for(size_t i = suballoc2ndCount; i--; )
+        {
+            const VmaSuballocation& suballoc = suballocations2nd[i];
+            const bool currFree = (suballoc.type == VMA_SUBALLOCATION_TYPE_FREE);
+
+            VMA_VALIDATE(!currFree || suballoc.hAllocation == VK_NULL_HANDLE);
+            VMA_VALIDATE(suballoc.offset >= offset);
+
+            if(!currFree)
+            {
+                if(suballoc.hAllocation != VK_NULL_HANDLE)
+                {
+                    VMA_VALIDATE(m_IsSnapshot || suballoc.hAllocation->GetOffset() == suballoc.offset);
+                    VMA_VALIDATE(suballoc.hAllocation->GetSize() == suballoc.size);
+                }
+                else
+                {
+                    ++handlelessCount;
+                }
+                sumUsedSize += suballoc.size;
+            }
+            else
+            {
+                ++nullItem2ndCount;
+            }
+
+            offset = suballoc.offset + suballoc.size + VMA_DEBUG_MARGIN;
+        }
+
+        VMA_VALIDATE(nullItem2ndCount == m_2ndNullItemsCount);
+    }
+
+    VMA_VALIDATE(offset <= GetSize());
+    VMA_VALIDATE(m_SumFreeSize == GetSize() - sumUsedSize);
+    VMA_VALIDATE(handlelessCount == m_HandlelessCount);
+
+    return true;
+}
+
+size_t VmaBlockMetadata_Linear::GetAllocationCount() const
+{
+    return AccessSuballocations1st().size() - (m_1stNullItemsBeginCount + m_1stNullItemsMiddleCount) +
+        AccessSuballocations2nd().size() - m_2ndNullItemsCount;
+}
+
+VkDeviceSize VmaBlockMetadata_Linear::GetUnusedRangeSizeMax() const
+{
+    const VkDeviceSize size = GetSize();
+
+    /*
+    We don't consider gaps inside allocation vectors with freed allocations because
+    they are not suitable for reuse in linear allocator. We consider only space that
+    is available for new allocations.
+    */
+    if(IsEmpty())
+    {
+        return size;
+    }
+    
+    const SuballocationVectorType& suballocations1st = AccessSuballocations1st();
+
+    switch(m_2ndVectorMode)
+    {
+    case SECOND_VECTOR_EMPTY:
+        /*
+        Available space is after end of 1st, as well as before beginning of 1st (which
+        whould make it a ring buffer).
+        */
+        {
+            const size_t suballocations1stCount = suballocations1st.size();
+            VMA_ASSERT(suballocations1stCount > m_1stNullItemsBeginCount);
+            const VmaSuballocation& firstSuballoc = suballocations1st[m_1stNullItemsBeginCount];
+            const VmaSuballocation& lastSuballoc  = suballocations1st[suballocations1stCount - 1];
+            return VMA_MAX(
+                firstSuballoc.offset,
+                size - (lastSuballoc.offset + lastSuballoc.size));
+        }
+        break;
+
+    case SECOND_VECTOR_RING_BUFFER:
+        /*
+        Available space is only between end of 2nd and beginning of 1st.
+        */
+        {
+            const SuballocationVectorType& suballocations2nd = AccessSuballocations2nd();
+            const VmaSuballocation& lastSuballoc2nd = suballocations2nd.back();
+            const VmaSuballocation& firstSuballoc1st = suballocations1st[m_1stNullItemsBeginCount];
+            return firstSuballoc1st.offset - (lastSuballoc2nd.offset + lastSuballoc2nd.size);
+        }
+        break;
+
+    case SECOND_VECTOR_DOUBLE_STACK:
+        /*
+        Available space is only between end of 1st and top of 2nd.
+        */
+        {
+            const SuballocationVectorType& suballocations2nd = AccessSuballocations2nd();
+            const VmaSuballocation& topSuballoc2nd = suballocations2nd.back();
+            // 1st vector is empty when there are only allocations in the upper stack.
+            const VkDeviceSize end1st = suballocations1st.empty() ?
+                0 : suballocations1st.back().offset + suballocations1st.back().size;
+            return topSuballoc2nd.offset - end1st;
+        }
+        break;
+
+    default:
+        VMA_ASSERT(0);
+        return 0;
+    }
+}
+
+void VmaBlockMetadata_Linear::CalcAllocationStatInfo(VmaStatInfo& outInfo) const
+{
+    const VkDeviceSize size = GetSize();
+    const SuballocationVectorType& suballocations1st = AccessSuballocations1st();
+    const SuballocationVectorType& suballocations2nd = AccessSuballocations2nd();
+    const size_t suballoc1stCount = suballocations1st.size();
+    const size_t suballoc2ndCount = suballocations2nd.size();
+
+    outInfo.blockCount = 1;
+    outInfo.allocationCount = (uint32_t)GetAllocationCount();
+    outInfo.unusedRangeCount = 0;
+    outInfo.usedBytes = 0;
+    outInfo.allocationSizeMin = UINT64_MAX;
+    outInfo.allocationSizeMax = 0;
+    outInfo.unusedRangeSizeMin = UINT64_MAX;
+    outInfo.unusedRangeSizeMax = 0;
+
+    VkDeviceSize lastOffset = 0;
+
+    if(m_2ndVectorMode == SECOND_VECTOR_RING_BUFFER)
+    {
+        const VkDeviceSize freeSpace2ndTo1stEnd = suballocations1st[m_1stNullItemsBeginCount].offset;
+        size_t nextAlloc2ndIndex = 0;
+        while(lastOffset < freeSpace2ndTo1stEnd)
+        {
+            // Find next non-null allocation or move nextAllocIndex to the end.
+            while(nextAlloc2ndIndex < suballoc2ndCount &&
+                suballocations2nd[nextAlloc2ndIndex].type == VMA_SUBALLOCATION_TYPE_FREE)
+            {
+                ++nextAlloc2ndIndex;
+            }
+
+            // Found non-null allocation.
+            if(nextAlloc2ndIndex < suballoc2ndCount)
+            {
+                const VmaSuballocation& suballoc = suballocations2nd[nextAlloc2ndIndex];
+            
+                // 1. Process free space before this allocation.
+                if(lastOffset < suballoc.offset)
+                {
+                    // There is free space from lastOffset to suballoc.offset.
+                    const VkDeviceSize unusedRangeSize = suballoc.offset - lastOffset;
+                    ++outInfo.unusedRangeCount;
+                    outInfo.unusedBytes += unusedRangeSize;
+                    outInfo.unusedRangeSizeMin = VMA_MIN(outInfo.unusedRangeSizeMin, unusedRangeSize);
+                    outInfo.unusedRangeSizeMax = VMA_MIN(outInfo.unusedRangeSizeMax, unusedRangeSize);
+                }
+            
+                // 2. Process this allocation.
+                // There is allocation with suballoc.offset, suballoc.size.
+                outInfo.usedBytes += suballoc.size;
+                outInfo.allocationSizeMin = VMA_MIN(outInfo.allocationSizeMin, suballoc.size);
+                outInfo.allocationSizeMax = VMA_MIN(outInfo.allocationSizeMax, suballoc.size);
+            
+                // 3. Prepare for next iteration.
+                lastOffset = suballoc.offset + suballoc.size;
+                ++nextAlloc2ndIndex;
+            }
+            // We are at the end.
+            else
+            {
+                // There is free space from lastOffset to freeSpace2ndTo1stEnd.
+                if(lastOffset < freeSpace2ndTo1stEnd)
+                {
+                    const VkDeviceSize unusedRangeSize = freeSpace2ndTo1stEnd - lastOffset;
+                    ++outInfo.unusedRangeCount;
+                    outInfo.unusedBytes += unusedRangeSize;
+                    outInfo.unusedRangeSizeMin = VMA_MIN(outInfo.unusedRangeSizeMin, unusedRangeSize);
+                    outInfo.unusedRangeSizeMax = VMA_MIN(outInfo.unusedRangeSizeMax, unusedRangeSize);
+               }
+
+                // End of loop.
+                lastOffset = freeSpace2ndTo1stEnd;
+            }
+        }
+    }
+
+    size_t nextAlloc1stIndex = m_1stNullItemsBeginCount;
+    const VkDeviceSize freeSpace1stTo2ndEnd =
+        m_2ndVectorMode == SECOND_VECTOR_DOUBLE_STACK ? suballocations2nd.back().offset : size;
+    while(lastOffset < freeSpace1stTo2ndEnd)
+    {
+        // Find next non-null allocation or move nextAllocIndex to the end.
+        while(nextAlloc1stIndex < suballoc1stCount &&
+            suballocations1st[nextAlloc1stIndex].type == VMA_SUBALLOCATION_TYPE_FREE)
+        {
+            ++nextAlloc1stIndex;
+        }
+
+        // Found non-null allocation.
+        if(nextAlloc1stIndex < suballoc1stCount)
+        {
+            const VmaSuballocation& suballoc = suballocations1st[nextAlloc1stIndex];
+            
+            // 1. Process free space before this allocation.
+            if(lastOffset < suballoc.offset)
+            {
+                // There is free space from lastOffset to suballoc.offset.
+                const VkDeviceSize unusedRangeSize = suballoc.offset - lastOffset;
+                ++outInfo.unusedRangeCount;
+                outInfo.unusedBytes += unusedRangeSize;
+                outInfo.unusedRangeSizeMin = VMA_MIN(outInfo.unusedRangeSizeMin, unusedRangeSize);
+                outInfo.unusedRangeSizeMax = VMA_MIN(outInfo.unusedRangeSizeMax, unusedRangeSize);
+            }
+            
+            // 2. Process this allocation.
+            // There is allocation with suballoc.offset, suballoc.size.
+            outInfo.usedBytes += suballoc.size;
+            outInfo.allocationSizeMin = VMA_MIN(outInfo.allocationSizeMin, suballoc.size);
+            outInfo.allocationSizeMax = VMA_MIN(outInfo.allocationSizeMax, suballoc.size);
+            
+            // 3. Prepare for next iteration.
+            lastOffset = suballoc.offset + suballoc.size;
+            ++nextAlloc1stIndex;
+        }
+        // We are at the end.
+        else
+        {
+            // There is free space from lastOffset to freeSpace1stTo2ndEnd.
+            if(lastOffset < freeSpace1stTo2ndEnd)
+            {
+                const VkDeviceSize unusedRangeSize = freeSpace1stTo2ndEnd - lastOffset;
+                ++outInfo.unusedRangeCount;
+                outInfo.unusedBytes += unusedRangeSize;
+                outInfo.unusedRangeSizeMin = VMA_MIN(outInfo.unusedRangeSizeMin, unusedRangeSize);
+                outInfo.unusedRangeSizeMax = VMA_MIN(outInfo.unusedRangeSizeMax, unusedRangeSize);
+           }
+
+            // End of loop.
+            lastOffset = freeSpace1stTo2ndEnd;
+        }
+    }
+
+    if(m_2ndVectorMode == SECOND_VECTOR_DOUBLE_STACK)
+    {
+        size_t nextAlloc2ndIndex = suballocations2nd.size() - 1;
+        while(lastOffset < size)
+        {
+            // Find next non-null allocation or move nextAllocIndex to the end.
+            while(nextAlloc2ndIndex != SIZE_MAX &&
+                suballocations2nd[nextAlloc2ndIndex].type == VMA_SUBALLOCATION_TYPE_FREE)
+            {
+                --nextAlloc2ndIndex;
+            }
+
+            // Found non-null allocation.
+            if(nextAlloc2ndIndex != SIZE_MAX)
+            {
+                const VmaSuballocation& suballoc = suballocations2nd[nextAlloc2ndIndex];
+            
+                // 1. Process free space before this allocation.
+                if(lastOffset < suballoc.offset)
+                {
+                    // There is free space from lastOffset to suballoc.offset.
+                    const VkDeviceSize unusedRangeSize = suballoc.offset - lastOffset;
+                    ++outInfo.unusedRangeCount;
+                    outInfo.unusedBytes += unusedRangeSize;
+                    outInfo.unusedRangeSizeMin = VMA_MIN(outInfo.unusedRangeSizeMin, unusedRangeSize);
+                    outInfo.unusedRangeSizeMax = VMA_MIN(outInfo.unusedRangeSizeMax, unusedRangeSize);
+                }
+            
+                // 2. Process this allocation.
+                // There is allocation with suballoc.offset, suballoc.size.
+                outInfo.usedBytes += suballoc.size;
+                outInfo.allocationSizeMin = VMA_MIN(outInfo.allocationSizeMin, suballoc.size);
+                outInfo.allocationSizeMax = VMA_MIN(outInfo.allocationSizeMax, suballoc.size);
+            
+                // 3. Prepare for next iteration.
+                lastOffset = suballoc.offset + suballoc.size;
+                --nextAlloc2ndIndex;
+            }
+            // We are at the end.
+            else
+            {
+                // There is free space from lastOffset to size.
+                if(lastOffset < size)
+                {
+                    const VkDeviceSize unusedRangeSize = size - lastOffset;
+                    ++outInfo.unusedRangeCount;
+                    outInfo.unusedBytes += unusedRangeSize;
+                    outInfo.unusedRangeSizeMin = VMA_MIN(outInfo.unusedRangeSizeMin, unusedRangeSize);
+                    outInfo.unusedRangeSizeMax = VMA_MIN(outInfo.unusedRangeSizeMax, unusedRangeSize);
+               }
+
+                // End of loop.
+                lastOffset = size;
+            }
+        }
+    }
+
+    outInfo.unusedBytes = size - outInfo.usedBytes;
+}
+
+void VmaBlockMetadata_Linear::AddPoolStats(VmaPoolStats& inoutStats) const
+{
+    const SuballocationVectorType& suballocations1st = AccessSuballocations1st();
+    const SuballocationVectorType& suballocations2nd = AccessSuballocations2nd();
+    const VkDeviceSize size = GetSize();
+    const size_t suballoc1stCount = suballocations1st.size();
+    const size_t suballoc2ndCount = suballocations2nd.size();
+
+    inoutStats.size += size;
+
+    VkDeviceSize lastOffset = 0;
+
+    if(m_2ndVectorMode == SECOND_VECTOR_RING_BUFFER)
+    {
+        const VkDeviceSize freeSpace2ndTo1stEnd = suballocations1st[m_1stNullItemsBeginCount].offset;
+        size_t nextAlloc2ndIndex = 0;
+        while(lastOffset < freeSpace2ndTo1stEnd)
+        {
+            // Find next non-null allocation or move nextAlloc2ndIndex to the end.
+            while(nextAlloc2ndIndex < suballoc2ndCount &&
+                suballocations2nd[nextAlloc2ndIndex].type == VMA_SUBALLOCATION_TYPE_FREE)
+            {
+                ++nextAlloc2ndIndex;
+            }
+
+            // Found non-null allocation.
+            if(nextAlloc2ndIndex < suballoc2ndCount)
+            {
+                const VmaSuballocation& suballoc = suballocations2nd[nextAlloc2ndIndex];
+            
+                // 1. Process free space before this allocation.
+                if(lastOffset < suballoc.offset)
+                {
+                    // There is free space from lastOffset to suballoc.offset.
+                    const VkDeviceSize unusedRangeSize = suballoc.offset - lastOffset;
+                    inoutStats.unusedSize += unusedRangeSize;
+                    ++inoutStats.unusedRangeCount;
+                    inoutStats.unusedRangeSizeMax = VMA_MAX(inoutStats.unusedRangeSizeMax, unusedRangeSize);
+                }
+            
+                // 2. Process this allocation.
+                // There is allocation with suballoc.offset, suballoc.size.
+                ++inoutStats.allocationCount;
+            
+                // 3. Prepare for next iteration.
+                lastOffset = suballoc.offset + suballoc.size;
+                ++nextAlloc2ndIndex;
+            }
+            // We are at the end.
+            else
+            {
+                if(lastOffset < freeSpace2ndTo1stEnd)
+                {
+                    // There is free space from lastOffset to freeSpace2ndTo1stEnd.
+                    const VkDeviceSize unusedRangeSize = freeSpace2ndTo1stEnd - lastOffset;
+                    inoutStats.unusedSize += unusedRangeSize;
+                    ++inoutStats.unusedRangeCount;
+                    inoutStats.unusedRangeSizeMax = VMA_MAX(inoutStats.unusedRangeSizeMax, unusedRangeSize);
+                }
+
+                // End of loop.
+                lastOffset = freeSpace2ndTo1stEnd;
+            }
+        }
+    }
+
+    size_t nextAlloc1stIndex = m_1stNullItemsBeginCount;
+    const VkDeviceSize freeSpace1stTo2ndEnd =
+        m_2ndVectorMode == SECOND_VECTOR_DOUBLE_STACK ? suballocations2nd.back().offset : size;
+    while(lastOffset < freeSpace1stTo2ndEnd)
+    {
+        // Find next non-null allocation or move nextAllocIndex to the end.
+        while(nextAlloc1stIndex < suballoc1stCount &&
+            suballocations1st[nextAlloc1stIndex].type == VMA_SUBALLOCATION_TYPE_FREE)
+        {
+            ++nextAlloc1stIndex;
+        }
+
+        // Found non-null allocation.
+        if(nextAlloc1stIndex < suballoc1stCount)
+        {
+            const VmaSuballocation& suballoc = suballocations1st[nextAlloc1stIndex];
+            
+            // 1. Process free space before this allocation.
+            if(lastOffset < suballoc.offset)
+            {
+                // There is free space from lastOffset to suballoc.offset.
+                const VkDeviceSize unusedRangeSize = suballoc.offset - lastOffset;
+                inoutStats.unusedSize += unusedRangeSize;
+                ++inoutStats.unusedRangeCount;
+                inoutStats.unusedRangeSizeMax = VMA_MAX(inoutStats.unusedRangeSizeMax, unusedRangeSize);
+            }
+            
+            // 2. Process this allocation.
+            // There is allocation with suballoc.offset, suballoc.size.
+            ++inoutStats.allocationCount;
+            
+            // 3. Prepare for next iteration.
+            lastOffset = suballoc.offset + suballoc.size;
+            ++nextAlloc1stIndex;
+        }
+        // We are at the end.
+        else
+        {
+            if(lastOffset < freeSpace1stTo2ndEnd)
+            {
+                // There is free space from lastOffset to freeSpace1stTo2ndEnd.
+                const VkDeviceSize unusedRangeSize = freeSpace1stTo2ndEnd - lastOffset;
+                inoutStats.unusedSize += unusedRangeSize;
+                ++inoutStats.unusedRangeCount;
+                inoutStats.unusedRangeSizeMax = VMA_MAX(inoutStats.unusedRangeSizeMax, unusedRangeSize);
+            }
+
+            // End of loop.
+            lastOffset = freeSpace1stTo2ndEnd;
+        }
+    }
+
+    if(m_2ndVectorMode == SECOND_VECTOR_DOUBLE_STACK)
+    {
+        size_t nextAlloc2ndIndex = suballocations2nd.size() - 1;
+        while(lastOffset < size)
+        {
+            // Find next non-null allocation or move nextAlloc2ndIndex to the end.
+            while(nextAlloc2ndIndex != SIZE_MAX &&
+                suballocations2nd[nextAlloc2ndIndex].type == VMA_SUBALLOCATION_TYPE_FREE)
+            {
+                --nextAlloc2ndIndex;
+            }
+
+            // Found non-null allocation.
+            if(nextAlloc2ndIndex != SIZE_MAX)
+            {
+                const VmaSuballocation& suballoc = suballocations2nd[nextAlloc2ndIndex];
+            
+                // 1. Process free space before this allocation.
+                if(lastOffset < suballoc.offset)
+                {
+                    // There is free space from lastOffset to suballoc.offset.
+                    const VkDeviceSize unusedRangeSize = suballoc.offset - lastOffset;
+                    inoutStats.unusedSize += unusedRangeSize;
+                    ++inoutStats.unusedRangeCount;
+                    inoutStats.unusedRangeSizeMax = VMA_MAX(inoutStats.unusedRangeSizeMax, unusedRangeSize);
+                }
+            
+                // 2. Process this allocation.
+                // There is allocation with suballoc.offset, suballoc.size.
+                ++inoutStats.allocationCount;
+            
+                // 3. Prepare for next iteration.
+                lastOffset = suballoc.offset + suballoc.size;
+                --nextAlloc2ndIndex;
+            }
+            // We are at the end.
+            else
+            {
+                if(lastOffset < size)
+                {
+                    // There is free space from lastOffset to size.
+                    const VkDeviceSize unusedRangeSize = size - lastOffset;
+                    inoutStats.unusedSize += unusedRangeSize;
+                    ++inoutStats.unusedRangeCount;
+                    inoutStats.unusedRangeSizeMax = VMA_MAX(inoutStats.unusedRangeSizeMax, unusedRangeSize);
+                }
+
+                // End of loop.
+                lastOffset = size;
+            }
+        }
+    }
+}
+
+#if VMA_STATS_STRING_ENABLED
+void VmaBlockMetadata_Linear::VisitDetailedMap(class VmaDetailedMapVisitor& visitor) const
+{
+    const VkDeviceSize size = GetSize();
+    const SuballocationVectorType& suballocations1st = AccessSuballocations1st();
+    const SuballocationVectorType& suballocations2nd = AccessSuballocations2nd();
+    const size_t suballoc1stCount = suballocations1st.size();
+    const size_t suballoc2ndCount = suballocations2nd.size();
+
+    // FIRST PASS
+
+    size_t unusedRangeCount = 0;
+    VkDeviceSize usedBytes = 0;
+
+    VkDeviceSize lastOffset = 0;
+
+    size_t alloc2ndCount = 0;
+    if(m_2ndVectorMode == SECOND_VECTOR_RING_BUFFER)
+    {
+        const VkDeviceSize freeSpace2ndTo1stEnd = suballocations1st[m_1stNullItemsBeginCount].offset;
+        size_t nextAlloc2ndIndex = 0;
+        while(lastOffset < freeSpace2ndTo1stEnd)
+        {
+            // Find next non-null allocation or move nextAlloc2ndIndex to the end.
+            while(nextAlloc2ndIndex < suballoc2ndCount &&
+                suballocations2nd[nextAlloc2ndIndex].type == VMA_SUBALLOCATION_TYPE_FREE)
+            {
+                ++nextAlloc2ndIndex;
+            }
+
+            // Found non-null allocation.
+            if(nextAlloc2ndIndex < suballoc2ndCount)
+            {
+                const VmaSuballocation& suballoc = suballocations2nd[nextAlloc2ndIndex];
+            
+                // 1. Process free space before this allocation.
+                if(lastOffset < suballoc.offset)
+                {
+                    // There is free space from lastOffset to suballoc.offset.
+                    ++unusedRangeCount;
+                }
+            
+                // 2. Process this allocation.
+                // There is allocation with suballoc.offset, suballoc.size.
+                ++alloc2ndCount;
+                usedBytes += suballoc.size;
+            
+                // 3. Prepare for next iteration.
+                lastOffset = suballoc.offset + suballoc.size;
+                ++nextAlloc2ndIndex;
+            }
+            // We are at the end.
+            else
+            {
+                if(lastOffset < freeSpace2ndTo1stEnd)
+                {
+                    // There is free space from lastOffset to freeSpace2ndTo1stEnd.
+                    ++unusedRangeCount;
+                }
+
+                // End of loop.
+                lastOffset = freeSpace2ndTo1stEnd;
+            }
+        }
+    }
+
+    size_t nextAlloc1stIndex = m_1stNullItemsBeginCount;
+    size_t alloc1stCount = 0;
+    const VkDeviceSize freeSpace1stTo2ndEnd =
+        m_2ndVectorMode == SECOND_VECTOR_DOUBLE_STACK ? suballocations2nd.back().offset : size;
+    while(lastOffset < freeSpace1stTo2ndEnd)
+    {
+        // Find next non-null allocation or move nextAllocIndex to the end.
+        while(nextAlloc1stIndex < suballoc1stCount &&
+            suballocations1st[nextAlloc1stIndex].type == VMA_SUBALLOCATION_TYPE_FREE)
+        {
+            ++nextAlloc1stIndex;
+        }
+
+        // Found non-null allocation.
+        if(nextAlloc1stIndex < suballoc1stCount)
+        {
+            const VmaSuballocation& suballoc = suballocations1st[nextAlloc1stIndex];
+            
+            // 1. Process free space before this allocation.
+            if(lastOffset < suballoc.offset)
+            {
+                // There is free space from lastOffset to suballoc.offset.
+                ++unusedRangeCount;
+            }
+            
+            // 2. Process this allocation.
+            // There is allocation with suballoc.offset, suballoc.size.
+            ++alloc1stCount;
+            usedBytes += suballoc.size;
+            
+            // 3. Prepare for next iteration.
+            lastOffset = suballoc.offset + suballoc.size;
+            ++nextAlloc1stIndex;
+        }
+        // We are at the end.
+        else
+        {
+            if(lastOffset < size)
+            {
+                // There is free space from lastOffset to freeSpace1stTo2ndEnd.
+                ++unusedRangeCount;
+            }
+
+            // End of loop.
+            lastOffset = freeSpace1stTo2ndEnd;
+        }
+    }
+
+    if(m_2ndVectorMode == SECOND_VECTOR_DOUBLE_STACK)
+    {
+        size_t nextAlloc2ndIndex = suballocations2nd.size() - 1;
+        while(lastOffset < size)
+        {
+            // Find next non-null allocation or move nextAlloc2ndIndex to the end.
+            while(nextAlloc2ndIndex != SIZE_MAX &&
+                suballocations2nd[nextAlloc2ndIndex].type == VMA_SUBALLOCATION_TYPE_FREE)
+            {
+                --nextAlloc2ndIndex;
+            }
+
+            // Found non-null allocation.
+            if(nextAlloc2ndIndex != SIZE_MAX)
+            {
+                const VmaSuballocation& suballoc = suballocations2nd[nextAlloc2ndIndex];
+            
+                // 1. Process free space before this allocation.
+                if(lastOffset < suballoc.offset)
+                {
+                    // There is free space from lastOffset to suballoc.offset.
+                    ++unusedRangeCount;
+                }
+            
+                // 2. Process this allocation.
+                // There is allocation with suballoc.offset, suballoc.size.
+                ++alloc2ndCount;
+                usedBytes += suballoc.size;
+            
+                // 3. Prepare for next iteration.
+                lastOffset = suballoc.offset + suballoc.size;
+                --nextAlloc2ndIndex;
+            }
+            // We are at the end.
+            else
+            {
+                if(lastOffset < size)
+                {
+                    // There is free space from lastOffset to size.
+                    ++unusedRangeCount;
+                }
+
+                // End of loop.
+                lastOffset = size;
+            }
+        }
+    }
+
+    const VkDeviceSize unusedBytes = size - usedBytes;
+    visitor.BeginBlock(GetSize(), unusedBytes, alloc1stCount + alloc2ndCount, unusedRangeCount);
+
+    // SECOND PASS
+    lastOffset = 0;
+
+    if(m_2ndVectorMode == SECOND_VECTOR_RING_BUFFER)
+    {
+        const VkDeviceSize freeSpace2ndTo1stEnd = suballocations1st[m_1stNullItemsBeginCount].offset;
+        size_t nextAlloc2ndIndex = 0;
+        while(lastOffset < freeSpace2ndTo1stEnd)
+        {
+            // Find next non-null allocation or move nextAlloc2ndIndex to the end.
+            while(nextAlloc2ndIndex < suballoc2ndCount &&
+                suballocations2nd[nextAlloc2ndIndex].type == VMA_SUBALLOCATION_TYPE_FREE)
+            {
+                ++nextAlloc2ndIndex;
+            }
+
+            // Found non-null allocation.
+            if(nextAlloc2ndIndex < suballoc2ndCount)
+            {
+                const VmaSuballocation& suballoc = suballocations2nd[nextAlloc2ndIndex];
+            
+                // 1. Process free space before this allocation.
+                if(lastOffset < suballoc.offset)
+                {
+                    // There is free space from lastOffset to suballoc.offset.
+                    const VkDeviceSize unusedRangeSize = suballoc.offset - lastOffset;
+                    visitor.UnusedRange(lastOffset, unusedRangeSize);
+                }
+            
+                // 2. Process this allocation.
+                // There is allocation with suballoc.offset, suballoc.size.
+                if(suballoc.hAllocation != VK_NULL_HANDLE)
+                {
+                    visitor.Allocation(suballoc.offset, suballoc.hAllocation);
+                }
+                else
+                {
+                    visitor.HandlelessAllocation(suballoc);
+                }
+            
+                // 3. Prepare for next iteration.
+                lastOffset = suballoc.offset + suballoc.size;
+                ++nextAlloc2ndIndex;
+            }
+            // We are at the end.
+            else
+            {
+                if(lastOffset < freeSpace2ndTo1stEnd)
+                {
+                    // There is free space from lastOffset to freeSpace2ndTo1stEnd.
+                    const VkDeviceSize unusedRangeSize = freeSpace2ndTo1stEnd - lastOffset;
+                    visitor.UnusedRange(lastOffset, unusedRangeSize);
+                }
+
+                // End of loop.
+                lastOffset = freeSpace2ndTo1stEnd;
+            }
+        }
+    }
+
+    nextAlloc1stIndex = m_1stNullItemsBeginCount;
+    while(lastOffset < freeSpace1stTo2ndEnd)
+    {
+        // Find next non-null allocation or move nextAllocIndex to the end.
+        while(nextAlloc1stIndex < suballoc1stCount &&
+            suballocations1st[nextAlloc1stIndex].type == VMA_SUBALLOCATION_TYPE_FREE)
+        {
+            ++nextAlloc1stIndex;
+        }
+
+        // Found non-null allocation.
+        if(nextAlloc1stIndex < suballoc1stCount)
+        {
+            const VmaSuballocation& suballoc = suballocations1st[nextAlloc1stIndex];
+            
+            // 1. Process free space before this allocation.
+            if(lastOffset < suballoc.offset)
+            {
+                // There is free space from lastOffset to suballoc.offset.
+                const VkDeviceSize unusedRangeSize = suballoc.offset - lastOffset;
+                visitor.UnusedRange(lastOffset, unusedRangeSize);
+            }
+            
+            // 2. Process this allocation.
+            // There is allocation with suballoc.offset, suballoc.size.
+            if(suballoc.hAllocation != VK_NULL_HANDLE)
+            {
+                visitor.Allocation(suballoc.offset, suballoc.hAllocation);
+            }
+            else
+            {
+                visitor.HandlelessAllocation(suballoc);
+            }
+            
+            // 3. Prepare for next iteration.
+            lastOffset = suballoc.offset + suballoc.size;
+            ++nextAlloc1stIndex;
+        }
+        // We are at the end.
+        else
+        {
+            if(lastOffset < freeSpace1stTo2ndEnd)
+            {
+                // There is free space from lastOffset to freeSpace1stTo2ndEnd.
+                const VkDeviceSize unusedRangeSize = freeSpace1stTo2ndEnd - lastOffset;
+                visitor.UnusedRange(lastOffset, unusedRangeSize);
+            }
+
+            // End of loop.
+            lastOffset = freeSpace1stTo2ndEnd;
+        }
+    }
+
+    if(m_2ndVectorMode == SECOND_VECTOR_DOUBLE_STACK)
+    {
+        size_t nextAlloc2ndIndex = suballocations2nd.size() - 1;
+        while(lastOffset < size)
+        {
+            // Find next non-null allocation or move nextAlloc2ndIndex to the end.
+            while(nextAlloc2ndIndex != SIZE_MAX &&
+                suballocations2nd[nextAlloc2ndIndex].type == VMA_SUBALLOCATION_TYPE_FREE)
+            {
+                --nextAlloc2ndIndex;
+            }
+
+            // Found non-null allocation.
+            if(nextAlloc2ndIndex != SIZE_MAX)
+            {
+                const VmaSuballocation& suballoc = suballocations2nd[nextAlloc2ndIndex];
+            
+                // 1. Process free space before this allocation.
+                if(lastOffset < suballoc.offset)
+                {
+                    // There is free space from lastOffset to suballoc.offset.
+                    const VkDeviceSize unusedRangeSize = suballoc.offset - lastOffset;
+                    visitor.UnusedRange(lastOffset, unusedRangeSize);
+                }
+            
+                // 2. Process this allocation.
+                // There is allocation with suballoc.offset, suballoc.size.
+                if(suballoc.hAllocation != VK_NULL_HANDLE)
+                {
+                    visitor.Allocation(suballoc.offset, suballoc.hAllocation);
+                }
+                else
+                {
+                    visitor.HandlelessAllocation(suballoc);
+                }
+            
+                // 3. Prepare for next iteration.
+                lastOffset = suballoc.offset + suballoc.size;
+                --nextAlloc2ndIndex;
+            }
+            // We are at the end.
+            else
+            {
+                if(lastOffset < size)
+                {
+                    // There is free space from lastOffset to size.
+                    const VkDeviceSize unusedRangeSize = size - lastOffset;
+                    visitor.UnusedRange(lastOffset, unusedRangeSize);
+                }
+
+                // End of loop.
+                lastOffset = size;
+            }
+        }
+    }
+
+    visitor.EndBlock();
+}
+#endif // #if VMA_STATS_STRING_ENABLED
+
+bool VmaBlockMetadata_Linear::CreateAllocationRequest(
+    uint32_t currentFrameIndex,
+    uint32_t frameInUseCount,
+    VkDeviceSize bufferImageGranularity,
+    VkDeviceSize allocSize,
+    VkDeviceSize allocAlignment,
+    bool upperAddress,
+    VmaSuballocationType allocType,
+    bool canMakeOtherLost,
+    uint32_t strategy,
+    VmaAllocationRequest* pAllocationRequest)
+{
+    VMA_ASSERT(allocSize > 0);
+    VMA_ASSERT(allocType != VMA_SUBALLOCATION_TYPE_FREE);
+    VMA_ASSERT(pAllocationRequest != VMA_NULL);
+    VMA_HEAVY_ASSERT(Validate());
+    // Frame index is stored with the new suballocation in Alloc().
+    pAllocationRequest->customData = (void*)(uintptr_t)currentFrameIndex;
+    return upperAddress ?
+        CreateAllocationRequest_UpperAddress(
+            currentFrameIndex, frameInUseCount, bufferImageGranularity,
+            allocSize, allocAlignment, allocType, canMakeOtherLost, strategy, pAllocationRequest) :
+        CreateAllocationRequest_LowerAddress(
+            currentFrameIndex, frameInUseCount, bufferImageGranularity,
+            allocSize, allocAlignment, allocType, canMakeOtherLost, strategy, pAllocationRequest);
+}
+
+bool VmaBlockMetadata_Linear::CreateAllocationRequest_UpperAddress(
+    uint32_t currentFrameIndex,
+    uint32_t frameInUseCount,
+    VkDeviceSize bufferImageGranularity,
+    VkDeviceSize allocSize,
+    VkDeviceSize allocAlignment,
+    VmaSuballocationType allocType,
+    bool canMakeOtherLost,
+    uint32_t strategy,
+    VmaAllocationRequest* pAllocationRequest)
+{
+    const VkDeviceSize size = GetSize();
+    SuballocationVectorType& suballocations1st = AccessSuballocations1st();
+    SuballocationVectorType& suballocations2nd = AccessSuballocations2nd();
+
+    if(m_2ndVectorMode == SECOND_VECTOR_RING_BUFFER)
+    {
+        VMA_ASSERT(0 && "Trying to use pool with linear algorithm as double stack, while it is already being used as ring buffer.");
+        return false;
+    }
+
+    // Try to allocate before 2nd.back(), or end of block if 2nd.empty().
+    if(allocSize > size)
+    {
+        return false;
+    }
+    VkDeviceSize resultBaseOffset = size - allocSize;
+    if(!suballocations2nd.empty())
+    {
+        const VmaSuballocation& lastSuballoc = suballocations2nd.back();
+        resultBaseOffset = lastSuballoc.offset - allocSize;
+        if(allocSize > lastSuballoc.offset)
+        {
+            return false;
+        }
+    }
+
+    // Start from offset equal to end of free space.
+    VkDeviceSize resultOffset = resultBaseOffset;
+
+    // Apply VMA_DEBUG_MARGIN at the end.
+    if(VMA_DEBUG_MARGIN > 0)
+    {
+        if(resultOffset < VMA_DEBUG_MARGIN)
+        {
+            return false;
+        }
+        resultOffset -= VMA_DEBUG_MARGIN;
+    }
+
+    // Apply alignment.
+    resultOffset = VmaAlignDown(resultOffset, allocAlignment);
+
+    // Check next suballocations from 2nd for BufferImageGranularity conflicts.
+    // Make bigger alignment if necessary.
+    if(bufferImageGranularity > 1 && !suballocations2nd.empty())
+    {
+        bool bufferImageGranularityConflict = false;
+        for(size_t nextSuballocIndex = suballocations2nd.size(); nextSuballocIndex--; )
+        {
+            const VmaSuballocation& nextSuballoc = suballocations2nd[nextSuballocIndex];
+            if(VmaBlocksOnSamePage(resultOffset, allocSize, nextSuballoc.offset, bufferImageGranularity))
+            {
+                if(VmaIsBufferImageGranularityConflict(nextSuballoc.type, allocType))
+                {
+                    bufferImageGranularityConflict = true;
+                    break;
+                }
+            }
+            else
+                // Already on previous page.
+                break;
+        }
+        if(bufferImageGranularityConflict)
+        {
+            resultOffset = VmaAlignDown(resultOffset, bufferImageGranularity);
+        }
+    }
+
+    // There is enough free space.
+    const VkDeviceSize endOf1st = !suballocations1st.empty() ?
+        suballocations1st.back().offset + suballocations1st.back().size :
+        0;
+    if(endOf1st + VMA_DEBUG_MARGIN <= resultOffset)
+    {
+        // Check previous suballocations for BufferImageGranularity conflicts.
+        // If conflict exists, allocation cannot be made here.
+        if(bufferImageGranularity > 1)
+        {
+            for(size_t prevSuballocIndex = suballocations1st.size(); prevSuballocIndex--; )
+            {
+                const VmaSuballocation& prevSuballoc = suballocations1st[prevSuballocIndex];
+                if(VmaBlocksOnSamePage(prevSuballoc.offset, prevSuballoc.size, resultOffset, bufferImageGranularity))
+                {
+                    if(VmaIsBufferImageGranularityConflict(allocType, prevSuballoc.type))
+                    {
+                        return false;
+                    }
+                }
+                else
+                {
+                    // Already on next page.
+                    break;
+                }
+            }
+        }
+
+        // All tests passed: Success.
+        pAllocationRequest->offset = resultOffset;
+        pAllocationRequest->sumFreeSize = resultBaseOffset + allocSize - endOf1st;
+        pAllocationRequest->sumItemSize = 0;
+        // pAllocationRequest->item unused.
+        pAllocationRequest->itemsToMakeLostCount = 0;
+        pAllocationRequest->type = VmaAllocationRequestType::UpperAddress;
+        return true;
+    }
+
+    return false;
+}
+
+bool VmaBlockMetadata_Linear::CreateAllocationRequest_LowerAddress(
+    uint32_t currentFrameIndex,
+    uint32_t frameInUseCount,
+    VkDeviceSize bufferImageGranularity,
+    VkDeviceSize allocSize,
+    VkDeviceSize allocAlignment,
+    VmaSuballocationType allocType,
+    bool canMakeOtherLost,
+    uint32_t strategy,
+    VmaAllocationRequest* pAllocationRequest)
+{
+    const VkDeviceSize size = GetSize();
+    SuballocationVectorType& suballocations1st = AccessSuballocations1st();
+    SuballocationVectorType& suballocations2nd = AccessSuballocations2nd();
+
+    if(m_2ndVectorMode == SECOND_VECTOR_EMPTY || m_2ndVectorMode == SECOND_VECTOR_DOUBLE_STACK)
+    {
+        // Try to allocate at the end of 1st vector.
+
+        VkDeviceSize resultBaseOffset = 0;
+        if(!suballocations1st.empty())
+        {
+            const VmaSuballocation& lastSuballoc = suballocations1st.back();
+            resultBaseOffset = lastSuballoc.offset + lastSuballoc.size;
+        }
+
+        // Start from offset equal to beginning of free space.
+        VkDeviceSize resultOffset = resultBaseOffset;
+
+        // Apply VMA_DEBUG_MARGIN at the beginning.
+        if(VMA_DEBUG_MARGIN > 0)
+        {
+            resultOffset += VMA_DEBUG_MARGIN;
+        }
+
+        // Apply alignment.
+        resultOffset = VmaAlignUp(resultOffset, allocAlignment);
+
+        // Check previous suballocations for BufferImageGranularity conflicts.
+        // Make bigger alignment if necessary.
+        if(bufferImageGranularity > 1 && !suballocations1st.empty())
+        {
+            bool bufferImageGranularityConflict = false;
+            for(size_t prevSuballocIndex = suballocations1st.size(); prevSuballocIndex--; )
+            {
+                const VmaSuballocation& prevSuballoc = suballocations1st[prevSuballocIndex];
+                if(VmaBlocksOnSamePage(prevSuballoc.offset, prevSuballoc.size, resultOffset, bufferImageGranularity))
+                {
+                    if(VmaIsBufferImageGranularityConflict(prevSuballoc.type, allocType))
+                    {
+                        bufferImageGranularityConflict = true;
+                        break;
+                    }
+                }
+                else
+                    // Already on previous page.
+                    break;
+            }
+            if(bufferImageGranularityConflict)
+            {
+                resultOffset = VmaAlignUp(resultOffset, bufferImageGranularity);
+            }
+        }
+
+        const VkDeviceSize freeSpaceEnd = m_2ndVectorMode == SECOND_VECTOR_DOUBLE_STACK ?
+            suballocations2nd.back().offset : size;
+
+        // There is enough free space at the end after alignment.
+        if(resultOffset + allocSize + VMA_DEBUG_MARGIN <= freeSpaceEnd)
+        {
+            // Check next suballocations for BufferImageGranularity conflicts.
+            // If conflict exists, allocation cannot be made here.
+            if(bufferImageGranularity > 1 && m_2ndVectorMode == SECOND_VECTOR_DOUBLE_STACK)
+            {
+                for(size_t nextSuballocIndex = suballocations2nd.size(); nextSuballocIndex--; )
+                {
+                    const VmaSuballocation& nextSuballoc = suballocations2nd[nextSuballocIndex];
+                    if(VmaBlocksOnSamePage(resultOffset, allocSize, nextSuballoc.offset, bufferImageGranularity))
+                    {
+                        if(VmaIsBufferImageGranularityConflict(allocType, nextSuballoc.type))
+                        {
+                            return false;
+                        }
+                    }
+                    else
+                    {
+                        // Already on previous page.
+                        break;
+                    }
+                }
+            }
+
+            // All tests passed: Success.
+            pAllocationRequest->offset = resultOffset;
+            pAllocationRequest->sumFreeSize = freeSpaceEnd - resultBaseOffset;
+            pAllocationRequest->sumItemSize = 0;
+            // pAllocationRequest->item unused.
+            pAllocationRequest->type = VmaAllocationRequestType::EndOf1st;
+            pAllocationRequest->itemsToMakeLostCount = 0;
+            return true;
+        }
+    }
+
+    // Wrap-around to end of 2nd vector. Try to allocate there, watching for the
+    // beginning of 1st vector as the end of free space.
+    if(m_2ndVectorMode == SECOND_VECTOR_EMPTY || m_2ndVectorMode == SECOND_VECTOR_RING_BUFFER)
+    {
+        VMA_ASSERT(!suballocations1st.empty());
+
+        VkDeviceSize resultBaseOffset = 0;
+        if(!suballocations2nd.empty())
+        {
+            const VmaSuballocation& lastSuballoc = suballocations2nd.back();
+            resultBaseOffset = lastSuballoc.offset + lastSuballoc.size;
+        }
+
+        // Start from offset equal to beginning of free space.
+        VkDeviceSize resultOffset = resultBaseOffset;
+
+        // Apply VMA_DEBUG_MARGIN at the beginning.
+        if(VMA_DEBUG_MARGIN > 0)
+        {
+            resultOffset += VMA_DEBUG_MARGIN;
+        }
+
+        // Apply alignment.
+        resultOffset = VmaAlignUp(resultOffset, allocAlignment);
+
+        // Check previous suballocations for BufferImageGranularity conflicts.
+        // Make bigger alignment if necessary.
+        if(bufferImageGranularity > 1 && !suballocations2nd.empty())
+        {
+            bool bufferImageGranularityConflict = false;
+            for(size_t prevSuballocIndex = suballocations2nd.size(); prevSuballocIndex--; )
+            {
+                const VmaSuballocation& prevSuballoc = suballocations2nd[prevSuballocIndex];
+                if(VmaBlocksOnSamePage(prevSuballoc.offset, prevSuballoc.size, resultOffset, bufferImageGranularity))
+                {
+                    if(VmaIsBufferImageGranularityConflict(prevSuballoc.type, allocType))
+                    {
+                        bufferImageGranularityConflict = true;
+                        break;
+                    }
+                }
+                else
+                    // Already on previous page.
+                    break;
+            }
+            if(bufferImageGranularityConflict)
+            {
+                resultOffset = VmaAlignUp(resultOffset, bufferImageGranularity);
+            }
+        }
+
+        pAllocationRequest->itemsToMakeLostCount = 0;
+        pAllocationRequest->sumItemSize = 0;
+        size_t index1st = m_1stNullItemsBeginCount;
+
+        if(canMakeOtherLost)
+        {
+            while(index1st < suballocations1st.size() &&
+                resultOffset + allocSize + VMA_DEBUG_MARGIN > suballocations1st[index1st].offset)
+            {
+                // Next colliding allocation at the beginning of 1st vector found. Try to make it lost.
+                const VmaSuballocation& suballoc = suballocations1st[index1st];
+                if(suballoc.type == VMA_SUBALLOCATION_TYPE_FREE)
+                {
+                    // No problem.
+                }
+                else
+                {
+                    // Allocations without VmaAllocation object cannot become lost.
+                    if(suballoc.hAllocation != VK_NULL_HANDLE &&
+                        suballoc.hAllocation->CanBecomeLost() &&
+                        suballoc.hAllocation->GetLastUseFrameIndex() + frameInUseCount < currentFrameIndex)
+                    {
+                        ++pAllocationRequest->itemsToMakeLostCount;
+                        pAllocationRequest->sumItemSize += suballoc.size;
+                    }
+                    else
+                    {
+                        return false;
+                    }
+                }
+                ++index1st;
+            }
+
+            // Check next suballocations for BufferImageGranularity conflicts.
+            // If conflict exists, we must mark more allocations lost or fail.
+            if(bufferImageGranularity > 1)
+            {
+                while(index1st < suballocations1st.size())
+                {
+                    const VmaSuballocation& suballoc = suballocations1st[index1st];
+                    if(VmaBlocksOnSamePage(resultOffset, allocSize, suballoc.offset, bufferImageGranularity))
+                    {
+                        if(suballoc.type != VMA_SUBALLOCATION_TYPE_FREE)
+                        {
+                            // Not checking actual VmaIsBufferImageGranularityConflict(allocType, suballoc.type).
+                            if(suballoc.hAllocation != VK_NULL_HANDLE &&
+                                suballoc.hAllocation->CanBecomeLost() &&
+                                suballoc.hAllocation->GetLastUseFrameIndex() + frameInUseCount < currentFrameIndex)
+                            {
+                                ++pAllocationRequest->itemsToMakeLostCount;
+                                pAllocationRequest->sumItemSize += suballoc.size;
+                            }
+                            else
+                            {
+                                return false;
+                            }
+                        }
+                    }
+                    else
+                    {
+                        // Already on next page.
+                        break;
+                    }
+                    ++index1st;
+                }
+            }
+
+            // Special case: There is not enough room at the end for this allocation, even after making all from the 1st lost.
+            // Wrap around once more: start from the beginning of the block, making lost allocations from
+            // the beginning of 2nd vector, which are the oldest ones after those from 1st vector.
+            if(index1st == suballocations1st.size() &&
+                resultOffset + allocSize + VMA_DEBUG_MARGIN > size)
+            {
+                resultBaseOffset = 0;
+                resultOffset = VMA_DEBUG_MARGIN;
+                resultOffset = VmaAlignUp(resultOffset, allocAlignment);
+
+                VkDeviceSize sumItemSize2nd = 0;
+                size_t index2nd = 0;
+                while(index2nd < suballocations2nd.size() &&
+                    resultOffset + allocSize + VMA_DEBUG_MARGIN > suballocations2nd[index2nd].offset)
+                {
+                    const VmaSuballocation& suballoc = suballocations2nd[index2nd];
+                    if(suballoc.type != VMA_SUBALLOCATION_TYPE_FREE)
+                    {
+                        if(suballoc.hAllocation != VK_NULL_HANDLE &&
+                            suballoc.hAllocation->CanBecomeLost() &&
+                            suballoc.hAllocation->GetLastUseFrameIndex() + frameInUseCount < currentFrameIndex)
+                        {
+                            ++pAllocationRequest->itemsToMakeLostCount;
+                            sumItemSize2nd += suballoc.size;
+                        }
+                        else
+                        {
+                            return false;
+                        }
+                    }
+                    ++index2nd;
+                }
+
+                // Check next suballocations for BufferImageGranularity conflicts.
+                if(bufferImageGranularity > 1)
+                {
+                    while(index2nd < suballocations2nd.size())
+                    {
+                        const VmaSuballocation& suballoc = suballocations2nd[index2nd];
+                        if(VmaBlocksOnSamePage(resultOffset, allocSize, suballoc.offset, bufferImageGranularity))
+                        {
+                            if(suballoc.type != VMA_SUBALLOCATION_TYPE_FREE)
+                            {
+                                // Not checking actual VmaIsBufferImageGranularityConflict(allocType, suballoc.type).
+                                if(suballoc.hAllocation != VK_NULL_HANDLE &&
+                                    suballoc.hAllocation->CanBecomeLost() &&
+                                    suballoc.hAllocation->GetLastUseFrameIndex() + frameInUseCount < currentFrameIndex)
+                                {
+                                    ++pAllocationRequest->itemsToMakeLostCount;
+                                    sumItemSize2nd += suballoc.size;
+                                }
+                                else
+                                {
+                                    return false;
+                                }
+                            }
+                        }
+                        else
+                        {
+                            // Already on next page.
+                            break;
+                        }
+                        ++index2nd;
+                    }
+                }
+
+                const VkDeviceSize freeSpaceEnd = index2nd < suballocations2nd.size() ?
+                    suballocations2nd[index2nd].offset : size;
+                if(resultOffset + allocSize + VMA_DEBUG_MARGIN > freeSpaceEnd)
+                {
+                    return false;
+                }
+
+                pAllocationRequest->offset = resultOffset;
+                pAllocationRequest->sumItemSize += sumItemSize2nd;
+                pAllocationRequest->sumFreeSize = freeSpaceEnd - resultBaseOffset - sumItemSize2nd;
+                pAllocationRequest->type = VmaAllocationRequestType::EndOf2nd;
+                // pAllocationRequest->item unused.
+                return true;
+            }
+        }
+
+        // There is enough free space at the end after alignment.
+        if((index1st == suballocations1st.size() && resultOffset + allocSize + VMA_DEBUG_MARGIN <= size) ||
+            (index1st < suballocations1st.size() && resultOffset + allocSize + VMA_DEBUG_MARGIN <= suballocations1st[index1st].offset))
+        {
+            // Check next suballocations for BufferImageGranularity conflicts.
+            // If conflict exists, allocation cannot be made here.
+            if(bufferImageGranularity > 1)
+            {
+                for(size_t nextSuballocIndex = index1st;
+                    nextSuballocIndex < suballocations1st.size();
+                    nextSuballocIndex++)
+                {
+                    const VmaSuballocation& nextSuballoc = suballocations1st[nextSuballocIndex];
+                    if(VmaBlocksOnSamePage(resultOffset, allocSize, nextSuballoc.offset, bufferImageGranularity))
+                    {
+                        if(VmaIsBufferImageGranularityConflict(allocType, nextSuballoc.type))
+                        {
+                            return false;
+                        }
+                    }
+                    else
+                    {
+                        // Already on next page.
+                        break;
+                    }
+                }
+            }
+
+            // All tests passed: Success.
+            pAllocationRequest->offset = resultOffset;
+            pAllocationRequest->sumFreeSize =
+                (index1st < suballocations1st.size() ? suballocations1st[index1st].offset : size)
+                - resultBaseOffset
+                - pAllocationRequest->sumItemSize;
+            pAllocationRequest->type = VmaAllocationRequestType::EndOf2nd;
+            // pAllocationRequest->item unused.
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool VmaBlockMetadata_Linear::MakeRequestedAllocationsLost(
+    uint32_t currentFrameIndex,
+    uint32_t frameInUseCount,
+    VmaAllocationRequest* pAllocationRequest)
+{
+    if(pAllocationRequest->itemsToMakeLostCount == 0)
+    {
+        return true;
+    }
+
+    VMA_ASSERT(m_2ndVectorMode == SECOND_VECTOR_EMPTY || m_2ndVectorMode == SECOND_VECTOR_RING_BUFFER);
+    
+    // We always start from 1st.
+    SuballocationVectorType* suballocations = &AccessSuballocations1st();
+    size_t index = m_1stNullItemsBeginCount;
+    size_t madeLostCount = 0;
+    while(madeLostCount < pAllocationRequest->itemsToMakeLostCount)
+    {
+        if(index == suballocations->size())
+        {
+            index = 0;
+            // If we get to the end of 1st, we wrap around to beginning of 2nd of 1st.
+            if(m_2ndVectorMode == SECOND_VECTOR_RING_BUFFER)
+            {
+                suballocations = &AccessSuballocations2nd();
+            }
+            // else: m_2ndVectorMode == SECOND_VECTOR_EMPTY:
+            // suballocations continues pointing at AccessSuballocations1st().
+            VMA_ASSERT(!suballocations->empty());
+        }
+        VmaSuballocation& suballoc = (*suballocations)[index];
+        if(suballoc.type != VMA_SUBALLOCATION_TYPE_FREE)
+        {
+            VMA_ASSERT(suballoc.hAllocation != VK_NULL_HANDLE);
+            VMA_ASSERT(suballoc.hAllocation->CanBecomeLost());
+            if(suballoc.hAllocation->MakeLost(currentFrameIndex, frameInUseCount))
+            {
+                suballoc.type = VMA_SUBALLOCATION_TYPE_FREE;
+                suballoc.hAllocation = VK_NULL_HANDLE;
+                m_SumFreeSize += suballoc.size;
+                if(suballocations == &AccessSuballocations1st())
+                {
+                    ++m_1stNullItemsMiddleCount;
+                }
+                else
+                {
+                    ++m_2ndNullItemsCount;
+                }
+                ++madeLostCount;
+            }
+            else
+            {
+                return false;
+            }
+        }
+        ++index;
+    }
+
+    CleanupAfterFree();
+    //VMA_HEAVY_ASSERT(Validate()); // Already called by ClanupAfterFree().
+    
+    return true;
+}
+
+uint32_t VmaBlockMetadata_Linear::MakeAllocationsLost(uint32_t currentFrameIndex, uint32_t frameInUseCount)
+{
+    uint32_t lostAllocationCount = 0;
+    
+    SuballocationVectorType& suballocations1st = AccessSuballocations1st();
+    for(size_t i = m_1stNullItemsBeginCount, count = suballocations1st.size(); i < count; ++i)
+    {
+        VmaSuballocation& suballoc = suballocations1st[i];
+        if(suballoc.type != VMA_SUBALLOCATION_TYPE_FREE &&
+            suballoc.hAllocation != VK_NULL_HANDLE &&
+            suballoc.hAllocation->CanBecomeLost() &&
+            suballoc.hAllocation->MakeLost(currentFrameIndex, frameInUseCount))
+        {
+            suballoc.type = VMA_SUBALLOCATION_TYPE_FREE;
+            suballoc.hAllocation = VK_NULL_HANDLE;
+            ++m_1stNullItemsMiddleCount;
+            m_SumFreeSize += suballoc.size;
+            ++lostAllocationCount;
+        }
+    }
+
+    SuballocationVectorType& suballocations2nd = AccessSuballocations2nd();
+    for(size_t i = 0, count = suballocations2nd.size(); i < count; ++i)
+    {
+        VmaSuballocation& suballoc = suballocations2nd[i];
+        if(suballoc.type != VMA_SUBALLOCATION_TYPE_FREE &&
+            suballoc.hAllocation != VK_NULL_HANDLE &&
+            suballoc.hAllocation->CanBecomeLost() &&
+            suballoc.hAllocation->MakeLost(currentFrameIndex, frameInUseCount))
+        {
+            suballoc.type = VMA_SUBALLOCATION_TYPE_FREE;
+            suballoc.hAllocation = VK_NULL_HANDLE;
+            ++m_2ndNullItemsCount;
+            m_SumFreeSize += suballoc.size;
+            ++lostAllocationCount;
+        }
+    }
+
+    if(lostAllocationCount)
+    {
+        CleanupAfterFree();
+    }
+
+    return lostAllocationCount;
+}
+
+VkResult VmaBlockMetadata_Linear::CheckCorruption(const void* pBlockData)
+{
+    SuballocationVectorType& suballocations1st = AccessSuballocations1st();
+    for(size_t i = m_1stNullItemsBeginCount, count = suballocations1st.size(); i < count; ++i)
+    {
+        const VmaSuballocation& suballoc = suballocations1st[i];
+        if(suballoc.type != VMA_SUBALLOCATION_TYPE_FREE)
+        {
+            if(!VmaValidateMagicValue(pBlockData, suballoc.offset - VMA_DEBUG_MARGIN))
+            {
+                VMA_ASSERT(0 && "MEMORY CORRUPTION DETECTED BEFORE VALIDATED ALLOCATION!");
+                return VK_ERROR_VALIDATION_FAILED_EXT;
+            }
+            if(!VmaValidateMagicValue(pBlockData, suballoc.offset + suballoc.size))
+            {
+                VMA_ASSERT(0 && "MEMORY CORRUPTION DETECTED AFTER VALIDATED ALLOCATION!");
+                return VK_ERROR_VALIDATION_FAILED_EXT;
+            }
+        }
+    }
+
+    SuballocationVectorType& suballocations2nd = AccessSuballocations2nd();
+    for(size_t i = 0, count = suballocations2nd.size(); i < count; ++i)
+    {
+        const VmaSuballocation& suballoc = suballocations2nd[i];
+        if(suballoc.type != VMA_SUBALLOCATION_TYPE_FREE)
+        {
+            if(!VmaValidateMagicValue(pBlockData, suballoc.offset - VMA_DEBUG_MARGIN))
+            {
+                VMA_ASSERT(0 && "MEMORY CORRUPTION DETECTED BEFORE VALIDATED ALLOCATION!");
+                return VK_ERROR_VALIDATION_FAILED_EXT;
+            }
+            if(!VmaValidateMagicValue(pBlockData, suballoc.offset + suballoc.size))
+            {
+                VMA_ASSERT(0 && "MEMORY CORRUPTION DETECTED AFTER VALIDATED ALLOCATION!");
+                return VK_ERROR_VALIDATION_FAILED_EXT;
+            }
+        }
+    }
+
+    return VK_SUCCESS;
+}
+
+void VmaBlockMetadata_Linear::Alloc(
+    const VmaAllocationRequest& request,
+    VmaSuballocationType type,
+    VkDeviceSize allocSize,
+    VmaAllocation hAllocation)
+{
+    const VmaSuballocation newSuballoc = {
+        request.offset, allocSize, hAllocation, type, (uint32_t)(uintptr_t)request.customData };
+
+    switch(request.type)
+    {
+    case VmaAllocationRequestType::UpperAddress:
+        {
+            VMA_ASSERT(m_2ndVectorMode != SECOND_VECTOR_RING_BUFFER &&
+                "CRITICAL ERROR: Trying to use linear allocator as double stack while it was already used as ring buffer.");
+            SuballocationVectorType& suballocations2nd = AccessSuballocations2nd();
+            suballocations2nd.push_back(newSuballoc);
+            m_2ndVectorMode = SECOND_VECTOR_DOUBLE_STACK;
+        }
+        break;
+    case VmaAllocationRequestType::EndOf1st:
+        {
+            SuballocationVectorType& suballocations1st = AccessSuballocations1st();
+
+            VMA_ASSERT(suballocations1st.empty() ||
+                request.offset >= suballocations1st.back().offset + suballocations1st.back().size);
+            // Check if it fits before the end of the block.
+            VMA_ASSERT(request.offset + allocSize <= GetSize());
+
+            suballocations1st.push_back(newSuballoc);
+        }
+        break;
+    case VmaAllocationRequestType::EndOf2nd:
+        {
+            SuballocationVectorType& suballocations1st = AccessSuballocations1st();
+            /*
+            MakeRequestedAllocationsLost() might have made all allocations from 1st vector lost.
+            CleanupAfterFree() then cleared it or swapped it with 2nd vector, which now ends
+            before the new allocation, so it becomes the last one in 1st vector.
+            */
+            if(suballocations1st.empty() ||
+                request.offset >= suballocations1st.back().offset + suballocations1st.back().size)
+            {
+                VMA_ASSERT(m_2ndVectorMode == SECOND_VECTOR_EMPTY);
+                VMA_ASSERT(request.offset + allocSize <= GetSize());
+                suballocations1st.push_back(newSuballoc);
+                break;
+            }
+            // New allocation at the end of 2-part ring buffer, so before first allocation from 1st vector.
+            VMA_ASSERT(!suballocations1st.empty() &&
+                request.offset + allocSize <= suballocations1st[m_1stNullItemsBeginCount].offset);
+            SuballocationVectorType& suballocations2nd = AccessSuballocations2nd();
+
+            switch(m_2ndVectorMode)
+            {
+            case SECOND_VECTOR_EMPTY:
+                // First allocation from second part ring buffer.
+                VMA_ASSERT(suballocations2nd.empty());
+                m_2ndVectorMode = SECOND_VECTOR_RING_BUFFER;
+                break;
+            case SECOND_VECTOR_RING_BUFFER:
+                // 2-part ring buffer is already started.
+                VMA_ASSERT(!suballocations2nd.empty());
+                break;
+            case SECOND_VECTOR_DOUBLE_STACK:
+                VMA_ASSERT(0 && "CRITICAL ERROR: Trying to use linear allocator as ring buffer while it was already used as double stack.");
+                break;
+            default:
+                VMA_ASSERT(0);
+            }
+
+            suballocations2nd.push_back(newSuballoc);
+        }
+        break;
+    default:
+        VMA_ASSERT(0 && "CRITICAL INTERNAL ERROR.");
+    }
+
+    m_SumFreeSize -= newSuballoc.size;
+    if(hAllocation == VK_NULL_HANDLE)
+    {
+        ++m_HandlelessCount;
+    }
+}
+
+void VmaBlockMetadata_Linear::Free(const VmaAllocation allocation)
+{
+    FreeAtOffset(allocation->GetOffset());
+}
+
+void VmaBlockMetadata_Linear::FreeAtOffset(VkDeviceSize offset)
+{
+    SuballocationVectorType& suballocations1st = AccessSuballocations1st();
+    SuballocationVectorType& suballocations2nd = AccessSuballocations2nd();
+
+    if(!suballocations1st.empty())
+    {
+        // First allocation: Mark it as next empty at the beginning.
+        VmaSuballocation& firstSuballoc = suballocations1st[m_1stNullItemsBeginCount];
+        if(firstSuballoc.offset == offset)
+        {
+            firstSuballoc.type = VMA_SUBALLOCATION_TYPE_FREE;
+            firstSuballoc.hAllocation = VK_NULL_HANDLE;
+            m_SumFreeSize += firstSuballoc.size;
+            ++m_1stNullItemsBeginCount;
+            CleanupAfterFree();
+            return;
+        }
+    }
+
+    // Last allocation in 2-part ring buffer or top of upper stack (same logic).
+    if(m_2ndVectorMode == SECOND_VECTOR_RING_BUFFER ||
+        m_2ndVectorMode == SECOND_VECTOR_DOUBLE_STACK)
+    {
+        VmaSuballocation& lastSuballoc = suballocations2nd.back();
+        if(lastSuballoc.offset == offset)
+        {
+            m_SumFreeSize += lastSuballoc.size;
+            suballocations2nd.pop_back();
+            CleanupAfterFree();
+            return;
+        }
+    }
+    // Last allocation in 1st vector.
+    else if(m_2ndVectorMode == SECOND_VECTOR_EMPTY)
+    {
+        VmaSuballocation& lastSuballoc = suballocations1st.back();
+        if(lastSuballoc.offset == offset)
+        {
+            m_SumFreeSize += lastSuballoc.size;
+            suballocations1st.pop_back();
+            CleanupAfterFree();
+            return;
+        }
+    }
+
+    // Item from the middle of 1st vector.
+    {
+        VmaSuballocation refSuballoc;
+        refSuballoc.offset = offset;
+        // Rest of members stays uninitialized intentionally for better performance.
+        SuballocationVectorType::iterator it = VmaBinaryFindSorted(
+            suballocations1st.begin() + m_1stNullItemsBeginCount,
+            suballocations1st.end(),
+            refSuballoc,
+            VmaSuballocationOffsetLess());
+        if(it != suballocations1st.end())
+        {
+            it->type = VMA_SUBALLOCATION_TYPE_FREE;
+            it->hAllocation = VK_NULL_HANDLE;
+            ++m_1stNullItemsMiddleCount;
+            m_SumFreeSize += it->size;
+            CleanupAfterFree();
+            return;
+        }
+    }
+
+    if(m_2ndVectorMode != SECOND_VECTOR_EMPTY)
+    {
+        // Item from the middle of 2nd vector.
+        VmaSuballocation refSuballoc;
+        refSuballoc.offset = offset;
+        // Rest of members stays uninitialized intentionally for better performance.
+        SuballocationVectorType::iterator it = m_2ndVectorMode == SECOND_VECTOR_RING_BUFFER ?
+            VmaBinaryFindSorted(suballocations2nd.begin(), suballocations2nd.end(), refSuballoc, VmaSuballocationOffsetLess()) :
+            VmaBinaryFindSorted(suballocations2nd.begin(), suballocations2nd.end(), refSuballoc, VmaSuballocationOffsetGreater());
+        if(it != suballocations2nd.end())
+        {
+            it->type = VMA_SUBALLOCATION_TYPE_FREE;
+            it->hAllocation = VK_NULL_HANDLE;
+            ++m_2ndNullItemsCount;
+            m_SumFreeSize += it->size;
+            CleanupAfterFree();
+            return;
+        }
+    }
+
+    VMA_ASSERT(0 && "Allocation to free not found in linear allocator!");
+}
+
+size_t VmaBlockMetadata_Linear::FreeUpToFrame(
+    uint32_t lastFrameIndex,
+    uint32_t currentFrameIndex,
+    VmaAllocationHistograms& inoutHistograms,
+    VmaVector< VmaAllocation, VmaStlAllocator<VmaAllocation> >& outAllocations,
+    VmaVector< VmaSuballocation, VmaStlAllocator<VmaSuballocation> >* pOutSuballocations)
+{
+    SuballocationVectorType& suballocations1st = AccessSuballocations1st();
+    SuballocationVectorType& suballocations2nd = AccessSuballocations2nd();
+    const size_t allocationCount = GetAllocationCount();
+
+    // Only allocations without VmaAllocation object: nothing to return, so just truncate everything.
+    if(lastFrameIndex == UINT32_MAX && allocationCount == m_HandlelessCount)
+    {
+        for(size_t i = m_1stNullItemsBeginCount, count = suballocations1st.size(); i < count; ++i)
+        {
+            if(suballocations1st[i].type != VMA_SUBALLOCATION_TYPE_FREE)
+            {
+                ++inoutHistograms.allocationLifetime[VmaLifetimeHistogramBucket(suballocations1st[i].frameIndex, currentFrameIndex)];
+                if(pOutSuballocations != VMA_NULL)
+                {
+                    pOutSuballocations->push_back(suballocations1st[i]);
+                }
+            }
+        }
+        for(size_t i = 0, count = suballocations2nd.size(); i < count; ++i)
+        {
+            if(suballocations2nd[i].type != VMA_SUBALLOCATION_TYPE_FREE)
+            {
+                ++inoutHistograms.allocationLifetime[VmaLifetimeHistogramBucket(suballocations2nd[i].frameIndex, currentFrameIndex)];
+                if(pOutSuballocations != VMA_NULL)
+                {
+                    pOutSuballocations->push_back(suballocations2nd[i]);
+                }
+            }
+        }
+
+        suballocations1st.clear();
+        suballocations2nd.clear();
+        m_1stNullItemsBeginCount = 0;
+        m_1stNullItemsMiddleCount = 0;
+        m_2ndNullItemsCount = 0;
+        m_2ndVectorMode = SECOND_VECTOR_EMPTY;
+        m_HandlelessCount = 0;
+        m_SumFreeSize = GetSize();
+        VMA_HEAVY_ASSERT(Validate());
+        return allocationCount;
+    }
+
+    size_t freedCount = 0;
+    bool newerFound = false;
+
+    // 1st vector holds the oldest allocations, in order of creation.
+    for(size_t i = m_1stNullItemsBeginCount, count = suballocations1st.size(); i < count; ++i)
+    {
+        VmaSuballocation& suballoc = suballocations1st[i];
+        if(suballoc.type == VMA_SUBALLOCATION_TYPE_FREE)
+        {
+            continue;
+        }
+        if(suballoc.frameIndex > lastFrameIndex)
+        {
+            newerFound = true;
+            break;
+        }
+        ++inoutHistograms.allocationLifetime[VmaLifetimeHistogramBucket(suballoc.frameIndex, currentFrameIndex)];
+        FreeSuballocationUpToFrame(suballoc, outAllocations, pOutSuballocations);
+        ++m_1stNullItemsMiddleCount;
+        ++freedCount;
+    }
+
+    /*
+    2nd vector of ring buffer continues after the end of 1st, so it's visited only when
+    whole 1st was freed. Upper stack of double stack is independent, starting from its bottom.
+    */
+    if(m_2ndVectorMode == SECOND_VECTOR_DOUBLE_STACK ||
+        (m_2ndVectorMode == SECOND_VECTOR_RING_BUFFER && !newerFound))
+    {
+        for(size_t i = 0, count = suballocations2nd.size(); i < count; ++i)
+        {
+            VmaSuballocation& suballoc = suballocations2nd[i];
+            if(suballoc.type == VMA_SUBALLOCATION_TYPE_FREE)
+            {
+                continue;
+            }
+            if(suballoc.frameIndex > lastFrameIndex)
+            {
+                break;
+            }
+            ++inoutHistograms.allocationLifetime[VmaLifetimeHistogramBucket(suballoc.frameIndex, currentFrameIndex)];
+            FreeSuballocationUpToFrame(suballoc, outAllocations, pOutSuballocations);
+            ++m_2ndNullItemsCount;
+            ++freedCount;
+        }
+    }
+
+    if(freedCount > 0)
+    {
+        CleanupAfterFree();
+    }
+    return freedCount;
+}
+
+void VmaBlockMetadata_Linear::FreeSuballocationUpToFrame(
+    VmaSuballocation& suballoc,
+    VmaVector< VmaAllocation, VmaStlAllocator<VmaAllocation> >& outAllocations,
+    VmaVector< VmaSuballocation, VmaStlAllocator<VmaSuballocation> >* pOutSuballocations)
+{
+    if(pOutSuballocations != VMA_NULL)
+    {
+        pOutSuballocations->push_back(suballoc);
+    }
+    if(suballoc.hAllocation != VK_NULL_HANDLE)
+    {
+        outAllocations.push_back(suballoc.hAllocation);
+        suballoc.hAllocation = VK_NULL_HANDLE;
+    }
+    else
+    {
+        VMA_ASSERT(m_HandlelessCount > 0);
+        --m_HandlelessCount;
+    }
+    suballoc.type = VMA_SUBALLOCATION_TYPE_FREE;
+    m_SumFreeSize += suballoc.size;
+}
+
+bool VmaBlockMetadata_Linear::ShouldCompact1st() const
+{
+    const size_t nullItemCount = m_1stNullItemsBeginCount + m_1stNullItemsMiddleCount;
+    const size_t suballocCount = AccessSuballocations1st().size();
+    return suballocCount > 32 && nullItemCount * 2 >= (suballocCount - nullItemCount) * 3;
+}
+
+void VmaBlockMetadata_Linear::CleanupAfterFree()
+{
+    SuballocationVectorType& suballocations1st = AccessSuballocations1st();
+    SuballocationVectorType& suballocations2nd = AccessSuballocations2nd();
+
+    if(IsEmpty())
+    {
+        suballocations1st.clear();
+        suballocations2nd.clear();
+        m_1stNullItemsBeginCount = 0;
+        m_1stNullItemsMiddleCount = 0;
+        m_2ndNullItemsCount = 0;
+        m_2ndVectorMode = SECOND_VECTOR_EMPTY;
+    }
+    else
+    {
+        const size_t suballoc1stCount = suballocations1st.size();
+        const size_t nullItem1stCount = m_1stNullItemsBeginCount + m_1stNullItemsMiddleCount;
+        VMA_ASSERT(nullItem1stCount <= suballoc1stCount);
+
+        // Find more null items at the beginning of 1st vector.
+        while(m_1stNullItemsBeginCount < suballoc1stCount &&
+            suballocations1st[m_1stNullItemsBeginCount].type == VMA_SUBALLOCATION_TYPE_FREE)
+        {
+            ++m_1stNullItemsBeginCount;
+            --m_1stNullItemsMiddleCount;
+        }
+
+        // Find more null items at the end of 1st vector.
+        while(m_1stNullItemsMiddleCount > 0 &&
+            suballocations1st.back().type == VMA_SUBALLOCATION_TYPE_FREE)
+        {
+            --m_1stNullItemsMiddleCount;
+            suballocations1st.pop_back();
+        }
+
+        // Find more null items at the end of 2nd vector.
+        while(m_2ndNullItemsCount > 0 &&
+            suballocations2nd.back().type == VMA_SUBALLOCATION_TYPE_FREE)
+        {
+            --m_2ndNullItemsCount;
+            suballocations2nd.pop_back();
+        }
+
+        // Find more null items at the beginning of 2nd vector and remove them all at once.
+        size_t null2ndBeginCount = 0;
+        while(null2ndBeginCount < m_2ndNullItemsCount &&
+            suballocations2nd[null2ndBeginCount].type == VMA_SUBALLOCATION_TYPE_FREE)
+        {
+            ++null2ndBeginCount;
+        }
+        if(null2ndBeginCount > 0)
+        {
+            const size_t new2ndCount = suballocations2nd.size() - null2ndBeginCount;
+            for(size_t i = 0; i < new2ndCount; ++i)
+            {
+                suballocations2nd[i] = suballocations2nd[i + null2ndBeginCount];
+            }
+            suballocations2nd.resize(new2ndCount);
+            m_2ndNullItemsCount -= null2ndBeginCount;
+        }
+
+        if(ShouldCompact1st())
+        {
+            const size_t nonNullItemCount = suballoc1stCount - nullItem1stCount;
+            size_t srcIndex = m_1stNullItemsBeginCount;
+            for(size_t dstIndex = 0; dstIndex < nonNullItemCount; ++dstIndex)
+            {
+                while(suballocations1st[srcIndex].type == VMA_SUBALLOCATION_TYPE_FREE)
+                {
+                    ++srcIndex;
+                }
+                if(dstIndex != srcIndex)
+                {
+                    suballocations1st[dstIndex] = suballocations1st[srcIndex];
+                }
+                ++srcIndex;
+            }
+            suballocations1st.resize(nonNullItemCount);
+            m_1stNullItemsBeginCount = 0;
+            m_1stNullItemsMiddleCount = 0;
+        }
+
+        // 2nd vector became empty.
+        if(suballocations2nd.empty())
+        {
+            m_2ndVectorMode = SECOND_VECTOR_EMPTY;
+        }
+
+        // 1st vector became empty.
+        if(suballocations1st.size() - m_1stNullItemsBeginCount == 0)
+        {
+            suballocations1st.clear();
+            m_1stNullItemsBeginCount = 0;
+
+            if(!suballocations2nd.empty() && m_2ndVectorMode == SECOND_VECTOR_RING_BUFFER)
+            {
+                // Swap 1st with 2nd. Now 2nd is empty.
+                m_2ndVectorMode = SECOND_VECTOR_EMPTY;
+                m_1stNullItemsMiddleCount = m_2ndNullItemsCount;
+                while(m_1stNullItemsBeginCount < suballocations2nd.size() &&
+                    suballocations2nd[m_1stNullItemsBeginCount].type == VMA_SUBALLOCATION_TYPE_FREE)
+                {
+                    ++m_1stNullItemsBeginCount;
+                    --m_1stNullItemsMiddleCount;
+                }
+                m_2ndNullItemsCount = 0;
+                m_1stVectorIndex ^= 1;
+            }
+        }
+    }
+
+    VMA_HEAVY_ASSERT(Validate());
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// class VmaBlockMetadata_Buddy
+
+VmaBlockMetadata_Buddy::VmaBlockMetadata_Buddy(VmaAllocator hAllocator, bool multipleRoots) :
+    VmaBlockMetadata(hAllocator),
+    m_MultipleRoots(multipleRoots),
+    m_Level0NodeSize(0),
+    m_UsableSize(0),
+    m_LevelCount(0),
+    m_RootLevelMask(0),
+    m_AllocationCount(0),
+    m_FreeCount(0),
+    m_SumFreeSize(0),
+    m_FreeListNonEmptyMask(0),
+    m_NodeAllocator(hAllocator->GetAllocationCallbacks(), 32) // firstBlockCapacity
+{
+    memset(m_Roots, 0, sizeof(m_Roots));
+    memset(m_FreeList, 0, sizeof(m_FreeList));
+}
+
+VmaBlockMetadata_Buddy::~VmaBlockMetadata_Buddy()
+{
+    // Nodes are released together with m_NodeAllocator.
+}
+
+void VmaBlockMetadata_Buddy::Init(VkDeviceSize size)
+{
+    VmaBlockMetadata::Init(size);
+
+    m_Level0NodeSize = VmaPrevPow2(size);
+
+    // Calculate m_LevelCount.
+    m_LevelCount = 1;
+    while(m_LevelCount < MAX_LEVELS &&
+        LevelToNodeSize(m_LevelCount) >= MIN_NODE_SIZE)
+    {
+        ++m_LevelCount;
+    }
+
+    // Create a root for each bit set in size, from the largest one.
+    // Without m_MultipleRoots, only the root at level 0 is created.
+    m_UsableSize = 0;
+    const uint32_t rootLevelCount = m_MultipleRoots ? m_LevelCount : 1;
+    for(uint32_t level = 0; level < rootLevelCount; ++level)
+    {
+        const VkDeviceSize levelNodeSize = LevelToNodeSize(level);
+        if((size & levelNodeSize) != 0)
+        {
+            Node* rootNode = m_NodeAllocator.Alloc();
+            rootNode->offset = m_UsableSize;
+            rootNode->type = Node::TYPE_FREE;
+            rootNode->parent = VMA_NULL;
+            rootNode->buddy = VMA_NULL;
+
+            m_Roots[level] = rootNode;
+            m_RootLevelMask |= 1u << level;
+            AddToFreeListFront(level, rootNode);
+
+            m_UsableSize += levelNodeSize;
+            ++m_FreeCount;
+        }
+    }
+    m_SumFreeSize = m_UsableSize;
+}
+
+void VmaBlockMetadata_Buddy::InitSnapshot(const VmaBlockMetadata_Buddy& src)
+{
+    VmaBlockMetadata::Init(src.GetSize());
+
+    m_Level0NodeSize = src.m_Level0NodeSize;
+    m_UsableSize = src.m_UsableSize;
+    m_LevelCount = src.m_LevelCount;
+    m_AllocationCount = src.m_AllocationCount;
+    m_FreeCount = src.m_FreeCount;
+    m_SumFreeSize = src.m_SumFreeSize;
+    m_RootLevelMask = src.m_RootLevelMask;
+    for(uint32_t level = 0; level < m_LevelCount; ++level)
+    {
+        if(src.m_Roots[level] != VMA_NULL)
+        {
+            m_Roots[level] = CopyNode(src.m_Roots[level], VMA_NULL);
+        }
+    }
+
+    // Keep exactly the same order of nodes in free lists as in src, so the copy makes the same choices.
+    for(uint32_t level = 0; level < m_LevelCount; ++level)
+    {
+        for(const Node* srcNode = src.m_FreeList[level].back;
+            srcNode != VMA_NULL;
+            srcNode = srcNode->free.prev)
+        {
+            AddToFreeListFront(level, FindNode(srcNode->offset, level));
+        }
+    }
+
+    VMA_HEAVY_ASSERT(Validate());
+}
+
+bool VmaBlockMetadata_Buddy::Validate() const
+{
+    // Validate trees.
+    ValidationContext ctx;
+    VkDeviceSize rootOffset = 0;
+    for(uint32_t level = 0; level < MAX_LEVELS; ++level)
+    {
+        const Node* const rootNode = m_Roots[level];
+        VMA_VALIDATE((rootNode != VMA_NULL) == ((m_RootLevelMask & (1u << level)) != 0));
+        if(rootNode != VMA_NULL)
+        {
+            VMA_VALIDATE(rootNode->offset == rootOffset);
+            if(!ValidateNode(ctx, VMA_NULL, rootNode, level, LevelToNodeSize(level)))
+            {
+                VMA_VALIDATE(false && "ValidateNode failed.");
+            }
+            rootOffset += LevelToNodeSize(level);
+        }
+    }
+    VMA_VALIDATE(rootOffset == m_UsableSize && m_UsableSize <= GetSize());
+    VMA_VALIDATE(m_AllocationCount == ctx.calculatedAllocationCount);
+    VMA_VALIDATE(m_FreeCount == ctx.calculatedFreeCount);
+    VMA_VALIDATE(m_SumFreeSize == ctx.calculatedSumFreeSize);
+
+    // Validate free node lists.
+    for(uint32_t level = 0; level < m_LevelCount; ++level)
+    {
+        VMA_VALIDATE(m_FreeList[level].front == VMA_NULL ||
+            m_FreeList[level].front->free.prev == VMA_NULL);
+
+        for(Node* node = m_FreeList[level].front;
+            node != VMA_NULL;
+            node = node->free.next)
+        {
+            VMA_VALIDATE(node->type == Node::TYPE_FREE);
+            
+            if(node->free.next == VMA_NULL)
+            {
+                VMA_VALIDATE(m_FreeList[level].back == node);
+            }
+            else
+            {
+                VMA_VALIDATE(node->free.next->free.prev == node);
+            }
+        }
+    }
+
+    // Validate that free lists ar higher levels are empty.
+    for(uint32_t level = m_LevelCount; level < MAX_LEVELS; ++level)
+    {
+        VMA_VALIDATE(m_FreeList[level].front == VMA_NULL && m_FreeList[level].back == VMA_NULL);
+    }
+
+    // Validate mask of non-empty free lists.
+    for(uint32_t level = 0; level < MAX_LEVELS; ++level)
+    {
+        VMA_VALIDATE(((m_FreeListNonEmptyMask & (1u << level)) != 0) == (m_FreeList[level].front != VMA_NULL));
+    }
+
+    return true;
+}
+
+VkDeviceSize VmaBlockMetadata_Buddy::GetUnusedRangeSizeMax() const
+{
+    // Lowest level with free nodes has the biggest ones.
+    const uint32_t level = VmaBitScanLSB(m_FreeListNonEmptyMask);
+    return level != UINT32_MAX ? LevelToNodeSize(level) : 0;
+}
+
+void VmaBlockMetadata_Buddy::CalcAllocationStatInfo(VmaStatInfo& outInfo) const
+{
+    const VkDeviceSize unusableSize = GetUnusableSize();
+
+    outInfo.blockCount = 1;
+
+    outInfo.allocationCount = outInfo.unusedRangeCount = 0;
+    outInfo.usedBytes = outInfo.unusedBytes = 0;
+
+    outInfo.allocationSizeMax = outInfo.unusedRangeSizeMax = 0;
+    outInfo.allocationSizeMin = outInfo.unusedRangeSizeMin = UINT64_MAX;
+    outInfo.allocationSizeAvg = outInfo.unusedRangeSizeAvg = 0; // Unused.
+
+    for(uint32_t level = 0; level < m_LevelCount; ++level)
+    {
+        if(m_Roots[level] != VMA_NULL)
+        {
+            CalcAllocationStatInfoNode(outInfo, m_Roots[level], LevelToNodeSize(level));
+        }
+    }
+
+    if(unusableSize > 0)
+    {
+        ++outInfo.unusedRangeCount;
+        outInfo.unusedBytes += unusableSize;
+        outInfo.unusedRangeSizeMax = VMA_MAX(outInfo.unusedRangeSizeMax, unusableSize);
+        outInfo.unusedRangeSizeMin = VMA_MIN(outInfo.unusedRangeSizeMin, unusableSize);
+    }
+}
+
+void VmaBlockMetadata_Buddy::AddPoolStats(VmaPoolStats& inoutStats) const
+{
+    const VkDeviceSize unusableSize = GetUnusableSize();
+
+    inoutStats.size += GetSize();
+    inoutStats.unusedSize += m_SumFreeSize + unusableSize;
+    inoutStats.allocationCount += m_AllocationCount;
+    inoutStats.unusedRangeCount += m_FreeCount;
+    inoutStats.unusedRangeSizeMax = VMA_MAX(inoutStats.unusedRangeSizeMax, GetUnusedRangeSizeMax());
+
+    if(unusableSize > 0)
+    {
+        ++inoutStats.unusedRangeCount;
+        // Not updating inoutStats.unusedRangeSizeMax with unusableSize because this space is not available for allocations.
+    }
+}
+
+#if VMA_STATS_STRING_ENABLED
+
+void VmaBlockMetadata_Buddy::VisitDetailedMap(class VmaDetailedMapVisitor& visitor) const
+{
+    // TODO optimize
+    VmaStatInfo stat;
+    CalcAllocationStatInfo(stat);
+
+    visitor.BeginBlock(
+        GetSize(), // blockSize
+        stat.unusedBytes,
+        stat.allocationCount,
+        stat.unusedRangeCount);
+
+    for(uint32_t level = 0; level < m_LevelCount; ++level)
+    {
+        if(m_Roots[level] != VMA_NULL)
+        {
+            VisitDetailedMapNode(visitor, m_Roots[level], LevelToNodeSize(level));
+        }
+    }
+
+    const VkDeviceSize unusableSize = GetUnusableSize();
+    if(unusableSize > 0)
+    {
+        visitor.UnusedRange(
+            m_UsableSize, // offset
+            unusableSize); // size
+    }
+
+    visitor.EndBlock();
+}
+
+#endif // #if VMA_STATS_STRING_ENABLED
+
+bool VmaBlockMetadata_Buddy::CreateAllocationRequest(
+    uint32_t currentFrameIndex,
+    uint32_t frameInUseCount,
+    VkDeviceSize bufferImageGranularity,
+    VkDeviceSize allocSize,
+    VkDeviceSize allocAlignment,
+    bool upperAddress,
+    VmaSuballocationType allocType,
+    bool canMakeOtherLost,
+    uint32_t strategy,
+    VmaAllocationRequest* pAllocationRequest)
+{
+    VMA_ASSERT(!upperAddress && "VMA_ALLOCATION_CREATE_UPPER_ADDRESS_BIT can be used only with linear algorithm.");
+
+    // Simple way to respect bufferImageGranularity. May be optimized some day.
+    // Whenever it might be an OPTIMAL image...
+    if(allocType == VMA_SUBALLOCATION_TYPE_UNKNOWN ||
+        allocType == VMA_SUBALLOCATION_TYPE_IMAGE_UNKNOWN ||
+        allocType == VMA_SUBALLOCATION_TYPE_IMAGE_OPTIMAL)
+    {
+        allocAlignment = VMA_MAX(allocAlignment, bufferImageGranularity);
+        allocSize = VMA_MAX(allocSize, bufferImageGranularity);
+    }
+
+    if(allocSize > m_Level0NodeSize)
+    {
+        return false;
+    }
+
+    const uint32_t targetLevel = AllocSizeToLevel(allocSize);
+    // Levels from 0 to targetLevel that have free nodes. Try the one with the smallest nodes first.
+    uint32_t levelMask = m_FreeListNonEmptyMask & ((2u << targetLevel) - 1u);
+    while(levelMask != 0)
+    {
+        const uint32_t level = VmaBitScanMSB(levelMask);
+        levelMask &= ~(1u << level);
+
+        Node* freeNode = m_FreeList[level].front;
+        // Offsets of all nodes at this level are multiples of node size, so only bigger alignment needs a search.
+        if(LevelToNodeSize(level) % allocAlignment != 0)
+        {
+            while(freeNode != VMA_NULL && freeNode->offset % allocAlignment != 0)
+            {
+                freeNode = freeNode->free.next;
+            }
+        }
+        if(freeNode != VMA_NULL)
+        {
+            pAllocationRequest->type = VmaAllocationRequestType::Normal;
+            pAllocationRequest->offset = freeNode->offset;
+            pAllocationRequest->sumFreeSize = LevelToNodeSize(level);
+            pAllocationRequest->sumItemSize = 0;
+            pAllocationRequest->itemsToMakeLostCount = 0;
+            pAllocationRequest->customData = (void*)(uintptr_t)level;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool VmaBlockMetadata_Buddy::MakeRequestedAllocationsLost(
+    uint32_t currentFrameIndex,
+    uint32_t frameInUseCount,
+    VmaAllocationRequest* pAllocationRequest)
+{
+    /*
+    Lost allocations are not supported in buddy allocator at the moment.
+    Support might be added in the future.
+    */
+    return pAllocationRequest->itemsToMakeLostCount == 0;
+}
+
+uint32_t VmaBlockMetadata_Buddy::MakeAllocationsLost(uint32_t currentFrameIndex, uint32_t frameInUseCount)
+{
+    /*
+    Lost allocations are not supported in buddy allocator at the moment.
+    Support might be added in the future.
+    */
+    return 0;
+}
+
+void VmaBlockMetadata_Buddy::Alloc(
+    const VmaAllocationRequest& request,
+    VmaSuballocationType type,
+    VkDeviceSize allocSize,
+    VmaAllocation hAllocation)
+{
+    VMA_ASSERT(request.type == VmaAllocationRequestType::Normal);
+
+    const uint32_t targetLevel = AllocSizeToLevel(allocSize);
+    uint32_t currLevel = (uint32_t)(uintptr_t)request.customData;
+    
+    Node* currNode = FindNode(request.offset, currLevel);
+    VMA_ASSERT(currNode->type == Node::TYPE_FREE);
+    
+    // Go down, splitting free nodes.
+    while(currLevel < targetLevel)
+    {
+        // Remove currNode from list of free nodes at this currLevel.
+        RemoveFromFreeList(currLevel, currNode);
+         
+        const uint32_t childrenLevel = currLevel + 1;
+
+        // Create two free sub-nodes.
+        Node* leftChild = m_NodeAllocator.Alloc();
+        Node* rightChild = m_NodeAllocator.Alloc();
+
+        leftChild->offset = currNode->offset;
+        leftChild->type = Node::TYPE_FREE;
+        leftChild->parent = currNode;
+        leftChild->buddy = rightChild;
+
+        rightChild->offset = currNode->offset + LevelToNodeSize(childrenLevel);
+        rightChild->type = Node::TYPE_FREE;
+        rightChild->parent = currNode;
+        rightChild->buddy = leftChild;
+
+        // Convert current currNode to split type.
+        currNode->type = Node::TYPE_SPLIT;
+        currNode->split.leftChild = leftChild;
+
+        // Add child nodes to free list. Order is important!
+        AddToFreeListFront(childrenLevel, rightChild);
+        AddToFreeListFront(childrenLevel, leftChild);
+
+        ++m_FreeCount;
+        //m_SumFreeSize -= LevelToNodeSize(currLevel) % 2; // Useful only when level node sizes can be non power of 2.
+        ++currLevel;
+        currNode = m_FreeList[currLevel].front;
+
+        /*
+        We can be sure that currNode, as left child of node previously split,
+        also fullfills the alignment requirement.
+        */
+    }
+
+    // Remove from free list.
+    VMA_ASSERT(currLevel == targetLevel &&
+        currNode != VMA_NULL &&
+        currNode->type == Node::TYPE_FREE);
+    RemoveFromFreeList(currLevel, currNode);
+
+    // Convert to allocation node.
+    currNode->type = Node::TYPE_ALLOCATION;
+    currNode->allocation.alloc = hAllocation;
+
+    ++m_AllocationCount;
+    --m_FreeCount;
+    m_SumFreeSize -= allocSize;
+}
+
+VmaBlockMetadata_Buddy::Node* VmaBlockMetadata_Buddy::CopyNode(const Node* srcNode, Node* parent)
+{
+    Node* const node = m_NodeAllocator.Alloc();
+    node->offset = srcNode->offset;
+    node->type = srcNode->type;
+    node->parent = parent;
+    node->buddy = VMA_NULL;
+
+    switch(srcNode->type)
+    {
+    case Node::TYPE_FREE:
+        node->free.prev = node->free.next = VMA_NULL;
+        break;
+    case Node::TYPE_ALLOCATION:
+        node->allocation.alloc = srcNode->allocation.alloc;
+        break;
+    case Node::TYPE_SPLIT:
+        {
+            Node* const leftChild = CopyNode(srcNode->split.leftChild, node);
+            Node* const rightChild = CopyNode(srcNode->split.leftChild->buddy, node);
+            leftChild->buddy = rightChild;
+            rightChild->buddy = leftChild;
+            node->split.leftChild = leftChild;
+        }
+        break;
+    default:
+        VMA_ASSERT(0);
+    }
+
+    return node;
+}
+
+VmaBlockMetadata_Buddy::Node* VmaBlockMetadata_Buddy::FindRoot(VkDeviceSize offset, uint32_t& outLevel) const
+{
+    VMA_ASSERT(offset < m_UsableSize);
+    // Roots are ordered by offset. Their end offsets grow as bits of m_RootLevelMask are visited from the lowest.
+    uint32_t rootLevelMask = m_RootLevelMask;
+    for(;;)
+    {
+        const uint32_t level = VmaBitScanLSB(rootLevelMask);
+        VMA_ASSERT(level != UINT32_MAX);
+        Node* const rootNode = m_Roots[level];
+        if(offset < rootNode->offset + LevelToNodeSize(level))
+        {
+            outLevel = level;
+            return rootNode;
+        }
+        rootLevelMask &= ~(1u << level);
+    }
+}
+
+VmaBlockMetadata_Buddy::Node* VmaBlockMetadata_Buddy::FindNode(VkDeviceSize offset, uint32_t level) const
+{
+    uint32_t rootLevel = 0;
+    Node* node = FindRoot(offset, rootLevel);
+    VMA_ASSERT(rootLevel <= level);
+    for(uint32_t currLevel = rootLevel; currLevel < level; ++currLevel)
+    {
+        VMA_ASSERT(node->type == Node::TYPE_SPLIT);
+        Node* const rightChild = node->split.leftChild->buddy;
+        node = offset < rightChild->offset ? node->split.leftChild : rightChild;
+    }
+    VMA_ASSERT(node->offset == offset);
+    return node;
+}
+
+bool VmaBlockMetadata_Buddy::ValidateNode(ValidationContext& ctx, const Node* parent, const Node* curr, uint32_t level, VkDeviceSize levelNodeSize) const
+{
+    VMA_VALIDATE(level < m_LevelCount);
+    VMA_VALIDATE(curr->parent == parent);
+    VMA_VALIDATE((curr->buddy == VMA_NULL) == (parent == VMA_NULL));
+    VMA_VALIDATE(curr->buddy == VMA_NULL || curr->buddy->buddy == curr);
+    switch(curr->type)
+    {
+    case Node::TYPE_FREE:
+        // curr->free.prev, next are validated separately.
+        ctx.calculatedSumFreeSize += levelNodeSize;
+        ++ctx.calculatedFreeCount;
+        break;
+    case Node::TYPE_ALLOCATION:
+        ++ctx.calculatedAllocationCount;
+        ctx.calculatedSumFreeSize += levelNodeSize - curr->allocation.alloc->GetSize();
+        VMA_VALIDATE(curr->allocation.alloc != VK_NULL_HANDLE);
+        break;
+    case Node::TYPE_SPLIT:
+        {
+            const uint32_t childrenLevel = level + 1;
+            const VkDeviceSize childrenLevelNodeSize = levelNodeSize / 2;
+            const Node* const leftChild = curr->split.leftChild;
+            VMA_VALIDATE(leftChild != VMA_NULL);
+            VMA_VALIDATE(leftChild->offset == curr->offset);
+            if(!ValidateNode(ctx, curr, leftChild, childrenLevel, childrenLevelNodeSize))
+            {
+                VMA_VALIDATE(false && "ValidateNode for left child failed.");
+            }
+            const Node* const rightChild = leftChild->buddy;
+            VMA_VALIDATE(rightChild->offset == curr->offset + childrenLevelNodeSize);
+            if(!ValidateNode(ctx, curr, rightChild, childrenLevel, childrenLevelNodeSize))
+            {
+                VMA_VALIDATE(false && "ValidateNode for right child failed.");
+            }
+        }
+        break;
+    default:
+        return false;
+    }
+
+    return true;
+}
+
+uint32_t VmaBlockMetadata_Buddy::AllocSizeToLevel(VkDeviceSize allocSize) const
+{
+    // I know this could be optimized somehow e.g. by using std::log2p1 from C++20.
+    uint32_t level = 0;
+    VkDeviceSize currLevelNodeSize = m_Level0NodeSize;
+    VkDeviceSize nextLevelNodeSize = currLevelNodeSize >> 1;
+    while(allocSize <= nextLevelNodeSize && level + 1 < m_LevelCount)
+    {
+        ++level;
+        currLevelNodeSize = nextLevelNodeSize;
+        nextLevelNodeSize = currLevelNodeSize >> 1;
+    }
+    return level;
+}
+
+void VmaBlockMetadata_Buddy::FreeAtOffset(VmaAllocation alloc, VkDeviceSize offset)
+{
+    // Find node and level.
+    uint32_t level = 0;
+    Node* node = FindRoot(offset, level);
+    VkDeviceSize nodeOffset = node->offset;
+    VkDeviceSize levelNodeSize = LevelToNodeSize(level);
+    while(node->type == Node::TYPE_SPLIT)
+    {
+        const VkDeviceSize nextLevelSize = levelNodeSize >> 1;
+        if(offset < nodeOffset + nextLevelSize)
+        {
+            node = node->split.leftChild;
+        }
+        else
+        {
+            node = node->split.leftChild->buddy;
+            nodeOffset += nextLevelSize;
+        }
+        ++level;
+        levelNodeSize = nextLevelSize;
+    }
+
+    VMA_ASSERT(node != VMA_NULL && node->type == Node::TYPE_ALLOCATION);
+    VMA_ASSERT(alloc == VK_NULL_HANDLE || node->allocation.alloc == alloc);
+
+    ++m_FreeCount;
+    --m_AllocationCount;
+    m_SumFreeSize += node->allocation.alloc->GetSize();
+
+    node->type = Node::TYPE_FREE;
+
+    // Join free nodes if possible. Roots have no buddies.
+    while(node->buddy != VMA_NULL && node->buddy->type == Node::TYPE_FREE)
+    {
+        RemoveFromFreeList(level, node->buddy);
+        Node* const parent = node->parent;
+
+        m_NodeAllocator.Free(node->buddy);
+        m_NodeAllocator.Free(node);
+        parent->type = Node::TYPE_FREE;
+        
+        node = parent;
+        --level;
+        //m_SumFreeSize += LevelToNodeSize(level) % 2; // Useful only when level node sizes can be non power of 2.
+        --m_FreeCount;
+    }
+
+    AddToFreeListFront(level, node);
+}
+
+void VmaBlockMetadata_Buddy::CalcAllocationStatInfoNode(VmaStatInfo& outInfo, const Node* node, VkDeviceSize levelNodeSize) const
+{
+    switch(node->type)
+    {
+    case Node::TYPE_FREE:
+        ++outInfo.unusedRangeCount;
+        outInfo.unusedBytes += levelNodeSize;
+        outInfo.unusedRangeSizeMax = VMA_MAX(outInfo.unusedRangeSizeMax, levelNodeSize);
+        outInfo.unusedRangeSizeMin = VMA_MAX(outInfo.unusedRangeSizeMin, levelNodeSize);
+        break;
+    case Node::TYPE_ALLOCATION:
+        {
+            const VkDeviceSize allocSize = node->allocation.alloc->GetSize();
+            ++outInfo.allocationCount;
+            outInfo.usedBytes += allocSize;
+            outInfo.allocationSizeMax = VMA_MAX(outInfo.allocationSizeMax, allocSize);
+            outInfo.allocationSizeMin = VMA_MAX(outInfo.allocationSizeMin, allocSize);
+
+            const VkDeviceSize unusedRangeSize = levelNodeSize - allocSize;
+            if(unusedRangeSize > 0)
+            {
+                ++outInfo.unusedRangeCount;
+                outInfo.unusedBytes += unusedRangeSize;
+                outInfo.unusedRangeSizeMax = VMA_MAX(outInfo.unusedRangeSizeMax, unusedRangeSize);
+                outInfo.unusedRangeSizeMin = VMA_MAX(outInfo.unusedRangeSizeMin, unusedRangeSize);
+            }
+        }
+        break;
+    case Node::TYPE_SPLIT:
+        {
+            const VkDeviceSize childrenNodeSize = levelNodeSize / 2;
+            const Node* const leftChild = node->split.leftChild;
+            CalcAllocationStatInfoNode(outInfo, leftChild, childrenNodeSize);
+            const Node* const rightChild = leftChild->buddy;
+            CalcAllocationStatInfoNode(outInfo, rightChild, childrenNodeSize);
+        }
+        break;
+    default:
+        VMA_ASSERT(0);
+    }
+}
+
+void VmaBlockMetadata_Buddy::AddToFreeListFront(uint32_t level, Node* node)
+{
+    VMA_ASSERT(node->type == Node::TYPE_FREE);
+
+    // List is empty.
+    Node* const frontNode = m_FreeList[level].front;
+    if(frontNode == VMA_NULL)
+    {
+        VMA_ASSERT(m_FreeList[level].back == VMA_NULL);
+        node->free.prev = node->free.next = VMA_NULL;
+        m_FreeList[level].front = m_FreeList[level].back = node;
+        m_FreeListNonEmptyMask |= 1u << level;
+    }
+    else
+    {
+        VMA_ASSERT(frontNode->free.prev == VMA_NULL);
+        node->free.prev = VMA_NULL;
+        node->free.next = frontNode;
+        frontNode->free.prev = node;
+        m_FreeList[level].front = node;
+    }
+}
+
+void VmaBlockMetadata_Buddy::RemoveFromFreeList(uint32_t level, Node* node)
+{
+    VMA_ASSERT(m_FreeList[level].front != VMA_NULL);
+
+    // It is at the front.
+    if(node->free.prev == VMA_NULL)
+    {
+        VMA_ASSERT(m_FreeList[level].front == node);
+        m_FreeList[level].front = node->free.next;
+    }
+    else
+    {
+        Node* const prevFreeNode = node->free.prev;
+        VMA_ASSERT(prevFreeNode->free.next == node);
+        prevFreeNode->free.next = node->free.next;
+    }
+
+    // It is at the back.
+    if(node->free.next == VMA_NULL)
+    {
+        VMA_ASSERT(m_FreeList[level].back == node);
+        m_FreeList[level].back = node->free.prev;
+    }
+    else
+    {
+        Node* const nextFreeNode = node->free.next;
+        VMA_ASSERT(nextFreeNode->free.prev == node);
+        nextFreeNode->free.prev = node->free.prev;
+    }
+
+    if(m_FreeList[level].front == VMA_NULL)
+    {
+        m_FreeListNonEmptyMask &= ~(1u << level);
+    }
+}
+
+#if VMA_STATS_STRING_ENABLED
+void VmaBlockMetadata_Buddy::VisitDetailedMapNode(class VmaDetailedMapVisitor& visitor, const Node* node, VkDeviceSize levelNodeSize) const
+{
+    switch(node->type)
+    {
+    case Node::TYPE_FREE:
+        visitor.UnusedRange(node->offset, levelNodeSize);
+        break;
+    case Node::TYPE_ALLOCATION:
+        {   
+            visitor.Allocation(node->offset, node->allocation.alloc);
+            const VkDeviceSize allocSize = node->allocation.alloc->GetSize();
+            if(allocSize < levelNodeSize)
+            {
+                visitor.UnusedRange(node->offset + allocSize, levelNodeSize - allocSize);
+            }
+        }
+        break;
+    case Node::TYPE_SPLIT:
+        {
+            const VkDeviceSize childrenNodeSize = levelNodeSize / 2;
+            const Node* const leftChild = node->split.leftChild;
+            VisitDetailedMapNode(visitor, leftChild, childrenNodeSize);
+            const Node* const rightChild = leftChild->buddy;
+            VisitDetailedMapNode(visitor, rightChild, childrenNodeSize);
+        }
+        break;
+    default:
+        VMA_ASSERT(0);
+    }
+}
+#endif // #if VMA_STATS_STRING_ENABLED
+
+
+////////////////////////////////////////////////////////////////////////////////
+// class VmaDeviceMemoryBlock
+
+VmaDeviceMemoryBlock::VmaDeviceMemoryBlock(VmaAllocator hAllocator) :
+    m_pMetadata(VMA_NULL),
+    m_MemoryTypeIndex(UINT32_MAX),
+    m_Id(0),
+    m_hMemory(VK_NULL_HANDLE),
+    m_MapCount(0),
+    m_pMappedData(VMA_NULL),
+    m_HandlelessMapped(false)
+{
+}
+
+void VmaDeviceMemoryBlock::Init(
+    VmaAllocator hAllocator,
+    VmaPool hParentPool,
+    uint32_t newMemoryTypeIndex,
+    VkDeviceMemory newMemory,
+    VkDeviceSize newSize,
+    uint32_t id,
+    uint32_t algorithm,
+    bool buddyMultipleRoots)
+{
+    VMA_ASSERT(m_hMemory == VK_NULL_HANDLE);
+
+    m_hParentPool = hParentPool;
+    m_MemoryTypeIndex = newMemoryTypeIndex;
+    m_Id = id;
+    m_hMemory = newMemory;
+
+    switch(algorithm)
+    {
+    case VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT:
+        m_pMetadata = vma_new(hAllocator, VmaBlockMetadata_Linear)(hAllocator);
+        break;
+    case VMA_POOL_CREATE_BUDDY_ALGORITHM_BIT:
+        m_pMetadata = vma_new(hAllocator, VmaBlockMetadata_Buddy)(hAllocator, buddyMultipleRoots);
+        break;
+    default:
+        VMA_ASSERT(0);
+        // Fall-through.
+    case 0:
+        m_pMetadata = vma_new(hAllocator, VmaBlockMetadata_Generic)(hAllocator);
+    }
+    m_pMetadata->Init(newSize);
+}
+
+void VmaDeviceMemoryBlock::Destroy(VmaAllocator allocator)
+{
+    // This is the most important assert in the entire library.
+    // Hitting it means you have some memory leak - unreleased VmaAllocation objects.
+    VMA_ASSERT(m_pMetadata->IsEmpty() && "Some allocations were not freed before destruction of this memory block!");
+
+    if(m_HandlelessMapped)
+    {
+        Unmap(allocator, 1);
+        m_HandlelessMapped = false;
+    }
+
+    VMA_ASSERT(m_hMemory != VK_NULL_HANDLE);
+    allocator->FreeVulkanMemory(m_MemoryTypeIndex, m_pMetadata->GetSize(), m_hMemory);
+    m_hMemory = VK_NULL_HANDLE;
+
+    vma_delete(allocator, m_pMetadata);
+    m_pMetadata = VMA_NULL;
+}
+
+bool VmaDeviceMemoryBlock::Validate() const
+{
+    VMA_VALIDATE((m_hMemory != VK_NULL_HANDLE) &&
+        (m_pMetadata->GetSize() != 0));
+    
+    return m_pMetadata->Validate();
+}
+
+VkResult VmaDeviceMemoryBlock::CheckCorruption(VmaAllocator hAllocator)
+{
+    void* pData = nullptr;
+    VkResult res = Map(hAllocator, 1, &pData);
+    if(res != VK_SUCCESS)
+    {
+        return res;
+    }
+
+    res = m_pMetadata->CheckCorruption(pData);
+
+    Unmap(hAllocator, 1);
+
+    return res;
+}
+
+VkResult VmaDeviceMemoryBlock::Map(VmaAllocator hAllocator, uint32_t count, void** ppData)
+{
+    if(count == 0)
+    {
+        return VK_SUCCESS;
+    }
+
+    VmaMutexLock lock(m_Mutex, hAllocator->m_UseMutex);
+    if(m_MapCount != 0)
+    {
+        m_MapCount += count;
+        VMA_ASSERT(m_pMappedData != VMA_NULL);
+        if(ppData != VMA_NULL)
+        {
+            *ppData = m_pMappedData;
+        }
+        return VK_SUCCESS;
+    }
+    else
+    {
+        VkResult result = (*hAllocator->GetVulkanFunctions().vkMapMemory)(
+            hAllocator->m_hDevice,
+            m_hMemory,
+            0, // offset
+            VK_WHOLE_SIZE,
+            0, // flags
+            &m_pMappedData);
+        if(result == VK_SUCCESS)
+        {
+            if(ppData != VMA_NULL)
+            {
+                *ppData = m_pMappedData;
+            }
+            m_MapCount = count;
+        }
+        return result;
+    }
+}
+
+VkResult VmaDeviceMemoryBlock::MapForHandlelessAllocations(VmaAllocator hAllocator, void** ppData)
+{
+    if(m_HandlelessMapped)
+    {
+        // Pointer doesn't change while the block is mapped.
+        *ppData = m_pMappedData;
+        return VK_SUCCESS;
+    }
+    const VkResult res = Map(hAllocator, 1, ppData);
+    if(res == VK_SUCCESS)
+    {
+        m_HandlelessMapped = true;
+    }
+    return res;
+}
+
+void VmaDeviceMemoryBlock::Unmap(VmaAllocator hAllocator, uint32_t count)
+{
+    if(count == 0)
+    {
+        return;
+    }
+
+    VmaMutexLock lock(m_Mutex, hAllocator->m_UseMutex);
+    if(m_MapCount >= count)
+    {
+        m_MapCount -= count;
+        if(m_MapCount == 0)
+        {
+            m_pMappedData = VMA_NULL;
+            (*hAllocator->GetVulkanFunctions().vkUnmapMemory)(hAllocator->m_hDevice, m_hMemory);
+        }
+    }
+    else
+    {
+        VMA_ASSERT(0 && "VkDeviceMemory block is being unmapped while it was not previously mapped.");
+    }
+}
+
+VkResult VmaDeviceMemoryBlock::WriteMagicValueAroundAllocation(VmaAllocator hAllocator, VkDeviceSize allocOffset, VkDeviceSize allocSize)
+{
+    VMA_ASSERT(VMA_DEBUG_MARGIN > 0 && VMA_DEBUG_MARGIN % 4 == 0 && VMA_DEBUG_DETECT_CORRUPTION);
+    VMA_ASSERT(allocOffset >= VMA_DEBUG_MARGIN);
+
+    void* pData;
+    VkResult res = Map(hAllocator, 1, &pData);
+    if(res != VK_SUCCESS)
+    {
+        return res;
+    }
+
+    VmaWriteMagicValue(pData, allocOffset - VMA_DEBUG_MARGIN);
+    VmaWriteMagicValue(pData, allocOffset + allocSize);
+
+    Unmap(hAllocator, 1);
+
+    return VK_SUCCESS;
+}
+
+VkResult VmaDeviceMemoryBlock::ValidateMagicValueAroundAllocation(VmaAllocator hAllocator, VkDeviceSize allocOffset, VkDeviceSize allocSize)
+{
+    VMA_ASSERT(VMA_DEBUG_MARGIN > 0 && VMA_DEBUG_MARGIN % 4 == 0 && VMA_DEBUG_DETECT_CORRUPTION);
+    VMA_ASSERT(allocOffset >= VMA_DEBUG_MARGIN);
+
+    void* pData;
+    VkResult res = Map(hAllocator, 1, &pData);
+    if(res != VK_SUCCESS)
+    {
+        return res;
+    }
+
+    if(!VmaValidateMagicValue(pData, allocOffset - VMA_DEBUG_MARGIN))
+    {
+        VMA_ASSERT(0 && "MEMORY CORRUPTION DETECTED BEFORE FREED ALLOCATION!");
+    }
+    else if(!VmaValidateMagicValue(pData, allocOffset + allocSize))
+    {
+        VMA_ASSERT(0 && "MEMORY CORRUPTION DETECTED AFTER FREED ALLOCATION!");
+    }
+
+    Unmap(hAllocator, 1);
+
+    return VK_SUCCESS;
+}
+
+VkResult VmaDeviceMemoryBlock::BindBufferMemory(
+    const VmaAllocator hAllocator,
+    const VmaAllocation hAllocation,
+    VkDeviceSize allocationLocalOffset,
+    VkBuffer hBuffer,
+    const void* pNext)
+{
+    VMA_ASSERT(hAllocation->GetType() == VmaAllocation_T::ALLOCATION_TYPE_BLOCK &&
+        hAllocation->GetBlock() == this);
+    VMA_ASSERT(allocationLocalOffset < hAllocation->GetSize() &&
+        "Invalid allocationLocalOffset. Did you forget that this offset is relative to the beginning of the allocation, not the whole memory block?");
+    const VkDeviceSize memoryOffset = hAllocation->GetOffset() + allocationLocalOffset;
+    // This lock is important so that we don't call vkBind... and/or vkMap... simultaneously on the same VkDeviceMemory from multiple threads.
+    VmaMutexLock lock(m_Mutex, hAllocator->m_UseMutex);
+    return hAllocator->BindVulkanBuffer(m_hMemory, memoryOffset, hBuffer, pNext);
+}
+
+VkResult VmaDeviceMemoryBlock::BindImageMemory(
+    const VmaAllocator hAllocator,
+    const VmaAllocation hAllocation,
+    VkDeviceSize allocationLocalOffset,
+    VkImage hImage,
+    const void* pNext)
+{
+    VMA_ASSERT(hAllocation->GetType() == VmaAllocation_T::ALLOCATION_TYPE_BLOCK &&
+        hAllocation->GetBlock() == this);
+    VMA_ASSERT(allocationLocalOffset < hAllocation->GetSize() &&
+        "Invalid allocationLocalOffset. Did you forget that this offset is relative to the beginning of the allocation, not the whole memory block?");
+    const VkDeviceSize memoryOffset = hAllocation->GetOffset() + allocationLocalOffset;
+    // This lock is important so that we don't call vkBind... and/or vkMap... simultaneously on the same VkDeviceMemory from multiple threads.
+    VmaMutexLock lock(m_Mutex, hAllocator->m_UseMutex);
+    return hAllocator->BindVulkanImage(m_hMemory, memoryOffset, hImage, pNext);
+}
+
+static void InitStatInfo(VmaStatInfo& outInfo)
+{
+    memset(&outInfo, 0, sizeof(outInfo));
+    outInfo.allocationSizeMin = UINT64_MAX;
+    outInfo.unusedRangeSizeMin = UINT64_MAX;
+}
+
+// Adds statistics srcInfo into inoutInfo, like: inoutInfo += srcInfo.
+static void VmaAddStatInfo(VmaStatInfo& inoutInfo, const VmaStatInfo& srcInfo)
+{
+    inoutInfo.blockCount += srcInfo.blockCount;
+    inoutInfo.allocationCount += srcInfo.allocationCount;
+    inoutInfo.unusedRangeCount += srcInfo.unusedRangeCount;
+    inoutInfo.usedBytes += srcInfo.usedBytes;
+    inoutInfo.unusedBytes += srcInfo.unusedBytes;
+    inoutInfo.allocationSizeMin = VMA_MIN(inoutInfo.allocationSizeMin, srcInfo.allocationSizeMin);
+    inoutInfo.allocationSizeMax = VMA_MAX(inoutInfo.allocationSizeMax, srcInfo.allocationSizeMax);
+    inoutInfo.unusedRangeSizeMin = VMA_MIN(inoutInfo.unusedRangeSizeMin, srcInfo.unusedRangeSizeMin);
+    inoutInfo.unusedRangeSizeMax = VMA_MAX(inoutInfo.unusedRangeSizeMax, srcInfo.unusedRangeSizeMax);
+}
+
+static void VmaPostprocessCalcStatInfo(VmaStatInfo& inoutInfo)
+{
+    inoutInfo.allocationSizeAvg = (inoutInfo.allocationCount > 0) ?
+        VmaRoundDiv<VkDeviceSize>(inoutInfo.usedBytes, inoutInfo.allocationCount) : 0;
+    inoutInfo.unusedRangeSizeAvg = (inoutInfo.unusedRangeCount > 0) ?
+        VmaRoundDiv<VkDeviceSize>(inoutInfo.unusedBytes, inoutInfo.unusedRangeCount) : 0;
+}
+
+VmaPool_T::VmaPool_T(
+    VmaAllocator hAllocator,
+    const VmaPoolCreateInfo& createInfo,
+    VkDeviceSize preferredBlockSize) :
+    m_BlockVector(
+        hAllocator,
+        this, // hParentPool
+        createInfo.memoryTypeIndex,
+        createInfo.blockSize != 0 ? createInfo.blockSize : preferredBlockSize,
+        createInfo.minBlockCount,
+        createInfo.maxBlockCount,
+        (createInfo.flags & VMA_POOL_CREATE_IGNORE_BUFFER_IMAGE_GRANULARITY_BIT) != 0 ? 1 : hAllocator->GetBufferImageGranularity(),
+        createInfo.frameInUseCount,
+        true, // isCustomPool
+        createInfo.blockSize != 0, // explicitBlockSize
+        createInfo.flags & VMA_POOL_CREATE_ALGORITHM_MASK, // algorithm
+        (createInfo.flags & VMA_POOL_CREATE_BUDDY_MULTIPLE_ROOTS_BIT) != 0), // buddyMultipleRoots
+    m_Id(0),
+    m_AutoDefragmentationEnabled(false),
+    m_AutoDefragmentationFrameCounter(0)
+{
+    memset(&m_AutoDefragmentationPolicy, 0, sizeof(m_AutoDefragmentationPolicy));
+}
+
+VmaPool_T::~VmaPool_T()
+{
+}
+
+void VmaPool_T::SetAutoDefragmentationPolicy(const VmaAutoDefragmentationPolicy* pPolicy)
+{
+    m_AutoDefragmentationEnabled = pPolicy != VMA_NULL;
+    if(pPolicy != VMA_NULL)
+    {
+        m_AutoDefragmentationPolicy = *pPolicy;
+    }
+    else
+    {
+        memset(&m_AutoDefragmentationPolicy, 0, sizeof(m_AutoDefragmentationPolicy));
+    }
+    m_AutoDefragmentationFrameCounter = 0;
+}
+
+bool VmaPool_T::UpdateAutoDefragmentationFrameCounter()
+{
+    VMA_ASSERT(m_AutoDefragmentationEnabled);
+
+    VmaFragmentationScore score;
+    m_BlockVector.GetFragmentationScore(&score);
+
+    const VmaAutoDefragmentationPolicy& policy = m_AutoDefragmentationPolicy;
+    const bool exceeded =
+        (policy.fragmentationThreshold > 0.f && score.fragmentation >= policy.fragmentationThreshold) ||
+        (policy.blockUtilizationSpreadThreshold > 0.f && score.blockUtilizationSpread >= policy.blockUtilizationSpreadThreshold);
+    if(!exceeded)
+    {
+        m_AutoDefragmentationFrameCounter = 0;
+        return false;
+    }
+
+    if(++m_AutoDefragmentationFrameCounter < VMA_MAX(policy.frameCount, 1u))
+    {
+        return false;
+    }
+    m_AutoDefragmentationFrameCounter = 0;
+    return true;
+}
+
+#if VMA_STATS_STRING_ENABLED
+
+#endif // #if VMA_STATS_STRING_ENABLED
+
+VmaBlockVector::VmaBlockVector(
+    VmaAllocator hAllocator,
+    VmaPool hParentPool,
+    uint32_t memoryTypeIndex,
+    VkDeviceSize preferredBlockSize,
+    size_t minBlockCount,
+    size_t maxBlockCount,
+    VkDeviceSize bufferImageGranularity,
+    uint32_t frameInUseCount,
+    bool isCustomPool,
+    bool explicitBlockSize,
+    uint32_t algorithm,
+    bool buddyMultipleRoots) :
+    m_hAllocator(hAllocator),
+    m_hParentPool(hParentPool),
+    m_MemoryTypeIndex(memoryTypeIndex),
+    m_PreferredBlockSize(preferredBlockSize),
+    m_MinBlockCount(minBlockCount),
+    m_MaxBlockCount(maxBlockCount),
+    m_BufferImageGranularity(bufferImageGranularity),
+    m_FrameInUseCount(frameInUseCount),
+    m_IsCustomPool(isCustomPool),
+    m_ExplicitBlockSize(explicitBlockSize),
+    m_Algorithm(algorithm),
+    m_BuddyMultipleRoots(buddyMultipleRoots),
+    m_HasEmptyBlock(false),
+    m_Blocks(VmaStlAllocator<VmaDeviceMemoryBlock*>(hAllocator->GetAllocationCallbacks())),
+    m_NextBlockId(0),
+    m_DefragmentationInProgress(0),
+    m_UnusedBytes(0),
+    m_UnusedRangeSizeMax(0),
+    m_SumBlockUtilization(0.0),
+    m_SumBlockUtilizationSq(0.0)
+{
+    memset(&m_Histograms, 0, sizeof(m_Histograms));
+}
+
+VmaBlockVector::~VmaBlockVector()
+{
+    for(size_t i = m_Blocks.size(); i--; )
+    {
+        m_Blocks[i]->Destroy(m_hAllocator);
+        vma_delete(m_hAllocator, m_Blocks[i]);
+    }
+}
+
+VkResult VmaBlockVector::CreateMinBlocks()
+{
+    for(size_t i = 0; i < m_MinBlockCount; ++i)
+    {
+        VkResult res = CreateBlock(m_PreferredBlockSize, VMA_NULL);
+        if(res != VK_SUCCESS)
         {
-            ++nextAlloc1stIndex;
+            return res;
         }
+    }
+    return VK_SUCCESS;
+}
 
-        // Found non-null allocation.
-        if(nextAlloc1stIndex < suballoc1stCount)
-        {
-            const VmaSuballocation& suballoc = suballocations1st[nextAlloc1stIndex];
-            
-            // 1. Process free space before this allocation.
-            if(lastOffset < suballoc.offset)
-            {
-                // There is free space from lastOffset to suballoc.offset.
-                const VkDeviceSize unusedRangeSize = suballoc.offset - lastOffset;
-                PrintDetailedMap_UnusedRange(json, lastOffset, unusedRangeSize);
-            }
-            
-            // 2. Process this allocation.
-            // There is allocation with suballoc.offset, suballoc.size.
-            PrintDetailedMap_Allocation(json, suballoc.offset, suballoc.hAllocation);
-            
-            // 3. Prepare for next iteration.
-            lastOffset = suballoc.offset + suballoc.size;
-            ++nextAlloc1stIndex;
-        }
-        // We are at the end.
-        else
-        {
-            if(lastOffset < freeSpace1stTo2ndEnd)
-            {
-                // There is free space from lastOffset to freeSpace1stTo2ndEnd.
-                const VkDeviceSize unusedRangeSize = freeSpace1stTo2ndEnd - lastOffset;
-                PrintDetailedMap_UnusedRange(json, lastOffset, unusedRangeSize);
-            }
+void VmaBlockVector::GetPoolStats(VmaPoolStats* pStats)
+{
+    VmaMutexLockRead lock(m_Mutex, m_hAllocator->m_UseMutex);
 
-            // End of loop.
-            lastOffset = freeSpace1stTo2ndEnd;
-        }
+    const size_t blockCount = m_Blocks.size();
+
+    pStats->size = 0;
+    pStats->unusedSize = 0;
+    pStats->allocationCount = 0;
+    pStats->unusedRangeCount = 0;
+    pStats->unusedRangeSizeMax = 0;
+    pStats->blockCount = blockCount;
+
+    for(uint32_t blockIndex = 0; blockIndex < blockCount; ++blockIndex)
+    {
+        const VmaDeviceMemoryBlock* const pBlock = m_Blocks[blockIndex];
+        VMA_ASSERT(pBlock);
+        VMA_HEAVY_ASSERT(pBlock->Validate());
+        pBlock->m_pMetadata->AddPoolStats(*pStats);
     }
+}
 
-    if(m_2ndVectorMode == SECOND_VECTOR_DOUBLE_STACK)
+static double VmaCalcBlockUtilization(VkDeviceSize blockSize, VkDeviceSize sumFreeSize)
+{
+    return blockSize > 0 ? 1.0 - (double)sumFreeSize / (double)blockSize : 0.0;
+}
+
+void VmaBlockVector::GetFragmentationScore(VmaFragmentationScore* pScore)
+{
+    VmaMutexLockRead lock(m_Mutex, m_hAllocator->m_UseMutex);
+
+    VMA_HEAVY_ASSERT(ValidateFragmentationScore());
+
+    const size_t blockCount = m_Blocks.size();
+
+    VmaFragmentationSums sums = {};
+    sums.AddBlockVector(m_UnusedBytes, m_UnusedRangeSizeMax);
+
+    pScore->fragmentation = sums.GetFragmentation();
+    pScore->blockUtilizationSpread = 0.f;
+    if(blockCount > 1)
     {
-        size_t nextAlloc2ndIndex = suballocations2nd.size() - 1;
-        while(lastOffset < size)
-        {
-            // Find next non-null allocation or move nextAlloc2ndIndex to the end.
-            while(nextAlloc2ndIndex != SIZE_MAX &&
-                suballocations2nd[nextAlloc2ndIndex].hAllocation == VK_NULL_HANDLE)
-            {
-                --nextAlloc2ndIndex;
-            }
+        const double mean = m_SumBlockUtilization / (double)blockCount;
+        const double variance = m_SumBlockUtilizationSq / (double)blockCount - mean * mean;
+        // Accumulated rounding errors can make it slightly negative.
+        pScore->blockUtilizationSpread = variance > 0.0 ? (float)std::sqrt(variance) : 0.f;
+    }
+    pScore->unusedBytes = m_UnusedBytes;
+    pScore->unusedRangeSizeMax = m_UnusedRangeSizeMax;
+    pScore->blockCount = blockCount;
+}
 
-            // Found non-null allocation.
-            if(nextAlloc2ndIndex != SIZE_MAX)
-            {
-                const VmaSuballocation& suballoc = suballocations2nd[nextAlloc2ndIndex];
-            
-                // 1. Process free space before this allocation.
-                if(lastOffset < suballoc.offset)
-                {
-                    // There is free space from lastOffset to suballoc.offset.
-                    const VkDeviceSize unusedRangeSize = suballoc.offset - lastOffset;
-                    PrintDetailedMap_UnusedRange(json, lastOffset, unusedRangeSize);
-                }
-            
-                // 2. Process this allocation.
-                // There is allocation with suballoc.offset, suballoc.size.
-                PrintDetailedMap_Allocation(json, suballoc.offset, suballoc.hAllocation);
-            
-                // 3. Prepare for next iteration.
-                lastOffset = suballoc.offset + suballoc.size;
-                --nextAlloc2ndIndex;
-            }
-            // We are at the end.
-            else
-            {
-                if(lastOffset < size)
-                {
-                    // There is free space from lastOffset to size.
-                    const VkDeviceSize unusedRangeSize = size - lastOffset;
-                    PrintDetailedMap_UnusedRange(json, lastOffset, unusedRangeSize);
-                }
+void VmaBlockVector::GetAllocationHistograms(VmaAllocationHistograms* pHistograms)
+{
+    VmaMutexLockRead lock(m_Mutex, m_hAllocator->m_UseMutex);
+    *pHistograms = m_Histograms;
+}
 
-                // End of loop.
-                lastOffset = size;
-            }
+void VmaBlockVector::UpdateFragmentationScore(
+    const VmaDeviceMemoryBlock* pBlock,
+    VkDeviceSize prevSumFreeSize,
+    VkDeviceSize prevUnusedRangeSizeMax)
+{
+    const VmaBlockMetadata* const pMetadata = pBlock->m_pMetadata;
+    const VkDeviceSize blockSize = pMetadata->GetSize();
+    const VkDeviceSize sumFreeSize = pMetadata->GetSumFreeSize();
+    const VkDeviceSize unusedRangeSizeMax = pMetadata->GetUnusedRangeSizeMax();
+
+    m_UnusedBytes = m_UnusedBytes - prevSumFreeSize + sumFreeSize;
+
+    const double prevUtilization = VmaCalcBlockUtilization(blockSize, prevSumFreeSize);
+    const double utilization = VmaCalcBlockUtilization(blockSize, sumFreeSize);
+    m_SumBlockUtilization += utilization - prevUtilization;
+    m_SumBlockUtilizationSq += utilization * utilization - prevUtilization * prevUtilization;
+
+    if(unusedRangeSizeMax >= m_UnusedRangeSizeMax)
+    {
+        m_UnusedRangeSizeMax = unusedRangeSizeMax;
+    }
+    // This block may have had the largest free range, which is now smaller - search all blocks.
+    else if(prevUnusedRangeSizeMax == m_UnusedRangeSizeMax)
+    {
+        m_UnusedRangeSizeMax = unusedRangeSizeMax;
+        for(size_t blockIndex = m_Blocks.size(); blockIndex--; )
+        {
+            m_UnusedRangeSizeMax = VMA_MAX(m_UnusedRangeSizeMax, m_Blocks[blockIndex]->m_pMetadata->GetUnusedRangeSizeMax());
         }
     }
+}
 
-    PrintDetailedMap_End(json);
+bool VmaBlockVector::ValidateFragmentationScore() const
+{
+    VkDeviceSize unusedBytes = 0;
+    VkDeviceSize unusedRangeSizeMax = 0;
+    double sumBlockUtilization = 0.0;
+    for(size_t blockIndex = m_Blocks.size(); blockIndex--; )
+    {
+        const VmaBlockMetadata* const pMetadata = m_Blocks[blockIndex]->m_pMetadata;
+        unusedBytes += pMetadata->GetSumFreeSize();
+        unusedRangeSizeMax = VMA_MAX(unusedRangeSizeMax, pMetadata->GetUnusedRangeSizeMax());
+        sumBlockUtilization += VmaCalcBlockUtilization(pMetadata->GetSize(), pMetadata->GetSumFreeSize());
+    }
+    VMA_VALIDATE(unusedBytes == m_UnusedBytes);
+    VMA_VALIDATE(unusedRangeSizeMax == m_UnusedRangeSizeMax);
+    VMA_VALIDATE(sumBlockUtilization - m_SumBlockUtilization < 1e-6 && m_SumBlockUtilization - sumBlockUtilization < 1e-6);
+    return true;
 }
-#endif // #if VMA_STATS_STRING_ENABLED
 
-bool VmaBlockMetadata_Linear::CreateAllocationRequest(
-    uint32_t currentFrameIndex,
-    uint32_t frameInUseCount,
-    VkDeviceSize bufferImageGranularity,
-    VkDeviceSize allocSize,
-    VkDeviceSize allocAlignment,
-    bool upperAddress,
-    VmaSuballocationType allocType,
-    bool canMakeOtherLost,
-    uint32_t strategy,
-    VmaAllocationRequest* pAllocationRequest)
+void VmaBlockVector::RecalculateFragmentationScore()
 {
-    VMA_ASSERT(allocSize > 0);
-    VMA_ASSERT(allocType != VMA_SUBALLOCATION_TYPE_FREE);
-    VMA_ASSERT(pAllocationRequest != VMA_NULL);
-    VMA_HEAVY_ASSERT(Validate());
-    return upperAddress ?
-        CreateAllocationRequest_UpperAddress(
-            currentFrameIndex, frameInUseCount, bufferImageGranularity,
-            allocSize, allocAlignment, allocType, canMakeOtherLost, strategy, pAllocationRequest) :
-        CreateAllocationRequest_LowerAddress(
-            currentFrameIndex, frameInUseCount, bufferImageGranularity,
-            allocSize, allocAlignment, allocType, canMakeOtherLost, strategy, pAllocationRequest);
+    m_UnusedBytes = 0;
+    m_UnusedRangeSizeMax = 0;
+    m_SumBlockUtilization = 0.0;
+    m_SumBlockUtilizationSq = 0.0;
+    for(size_t blockIndex = m_Blocks.size(); blockIndex--; )
+    {
+        const VmaBlockMetadata* const pMetadata = m_Blocks[blockIndex]->m_pMetadata;
+        const VkDeviceSize sumFreeSize = pMetadata->GetSumFreeSize();
+        const double utilization = VmaCalcBlockUtilization(pMetadata->GetSize(), sumFreeSize);
+        m_UnusedBytes += sumFreeSize;
+        m_UnusedRangeSizeMax = VMA_MAX(m_UnusedRangeSizeMax, pMetadata->GetUnusedRangeSizeMax());
+        m_SumBlockUtilization += utilization;
+        m_SumBlockUtilizationSq += utilization * utilization;
+    }
 }
 
-bool VmaBlockMetadata_Linear::CreateAllocationRequest_UpperAddress(
+bool VmaBlockVector::IsCorruptionDetectionEnabled() const
+{
+    const uint32_t requiredMemFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    return (VMA_DEBUG_DETECT_CORRUPTION != 0) &&
+        (VMA_DEBUG_MARGIN > 0) &&
+        (m_Algorithm == 0 || m_Algorithm == VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT) &&
+        (m_hAllocator->m_MemProps.memoryTypes[m_MemoryTypeIndex].propertyFlags & requiredMemFlags) == requiredMemFlags;
+}
+
+static const uint32_t VMA_ALLOCATION_TRY_COUNT = 32;
+
+VkResult VmaBlockVector::Allocate(
     uint32_t currentFrameIndex,
-    uint32_t frameInUseCount,
-    VkDeviceSize bufferImageGranularity,
-    VkDeviceSize allocSize,
-    VkDeviceSize allocAlignment,
-    VmaSuballocationType allocType,
-    bool canMakeOtherLost,
-    uint32_t strategy,
-    VmaAllocationRequest* pAllocationRequest)
+    VkDeviceSize size,
+    VkDeviceSize alignment,
+    const VmaAllocationCreateInfo& createInfo,
+    VmaSuballocationType suballocType,
+    size_t allocationCount,
+    VmaAllocation* pAllocations)
 {
-    const VkDeviceSize size = GetSize();
-    SuballocationVectorType& suballocations1st = AccessSuballocations1st();
-    SuballocationVectorType& suballocations2nd = AccessSuballocations2nd();
+    size_t allocIndex;
+    VkResult res = VK_SUCCESS;
 
-    if(m_2ndVectorMode == SECOND_VECTOR_RING_BUFFER)
+    if(IsCorruptionDetectionEnabled())
     {
-        VMA_ASSERT(0 && "Trying to use pool with linear algorithm as double stack, while it is already being used as ring buffer.");
-        return false;
+        size = VmaAlignUp<VkDeviceSize>(size, sizeof(VMA_CORRUPTION_DETECTION_MAGIC_VALUE));
+        alignment = VmaAlignUp<VkDeviceSize>(alignment, sizeof(VMA_CORRUPTION_DETECTION_MAGIC_VALUE));
     }
 
-    // Try to allocate before 2nd.back(), or end of block if 2nd.empty().
-    if(allocSize > size)
     {
-        return false;
+        VmaMutexLockWrite lock(m_Mutex, m_hAllocator->m_UseMutex, m_hAllocator->m_Counters);
+        for(allocIndex = 0; allocIndex < allocationCount; ++allocIndex)
+        {
+            res = AllocatePage(
+                currentFrameIndex,
+                size,
+                alignment,
+                createInfo,
+                suballocType,
+                pAllocations + allocIndex,
+                VMA_NULL); // pHandlelessAllocationInfo
+            if(res != VK_SUCCESS)
+            {
+                break;
+            }
+            ++m_Histograms.allocationSize[VmaSizeHistogramBucket(size)];
+        }
     }
-    VkDeviceSize resultBaseOffset = size - allocSize;
-    if(!suballocations2nd.empty())
+
+    if(res != VK_SUCCESS)
     {
-        const VmaSuballocation& lastSuballoc = suballocations2nd.back();
-        resultBaseOffset = lastSuballoc.offset - allocSize;
-        if(allocSize > lastSuballoc.offset)
+        // Free all already created allocations.
+        while(allocIndex--)
         {
-            return false;
+            Free(pAllocations[allocIndex]);
         }
+        memset(pAllocations, 0, sizeof(VmaAllocation) * allocationCount);
     }
 
-    // Start from offset equal to end of free space.
-    VkDeviceSize resultOffset = resultBaseOffset;
+    return res;
+}
 
-    // Apply VMA_DEBUG_MARGIN at the end.
-    if(VMA_DEBUG_MARGIN > 0)
+VkResult VmaBlockVector::AllocatePage(
+    uint32_t currentFrameIndex,
+    VkDeviceSize size,
+    VkDeviceSize alignment,
+    const VmaAllocationCreateInfo& createInfo,
+    VmaSuballocationType suballocType,
+    VmaAllocation* pAllocation,
+    VmaAllocationInfo* pHandlelessAllocationInfo)
+{
+    const bool isUpperAddress = (createInfo.flags & VMA_ALLOCATION_CREATE_UPPER_ADDRESS_BIT) != 0;
+    const bool canMakeOtherLost = (createInfo.flags & VMA_ALLOCATION_CREATE_CAN_MAKE_OTHER_LOST_BIT) != 0;
+    const bool mapped = (createInfo.flags & VMA_ALLOCATION_CREATE_MAPPED_BIT) != 0;
+    const bool isUserDataString = (createInfo.flags & VMA_ALLOCATION_CREATE_USER_DATA_COPY_STRING_BIT) != 0;
+    const bool canCreateNewBlock =
+        ((createInfo.flags & VMA_ALLOCATION_CREATE_NEVER_ALLOCATE_BIT) == 0) &&
+        (m_Blocks.size() < m_MaxBlockCount);
+    uint32_t strategy = createInfo.flags & VMA_ALLOCATION_CREATE_STRATEGY_MASK;
+
+    // Upper address can only be used with linear allocator and within single memory block.
+    if(isUpperAddress &&
+        (m_Algorithm != VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT || m_MaxBlockCount > 1))
     {
-        if(resultOffset < VMA_DEBUG_MARGIN)
-        {
-            return false;
-        }
-        resultOffset -= VMA_DEBUG_MARGIN;
+        return VK_ERROR_FEATURE_NOT_PRESENT;
+    }
+
+    // Validate strategy.
+    switch(strategy)
+    {
+    case 0:
+        strategy = VMA_ALLOCATION_CREATE_STRATEGY_BEST_FIT_BIT;
+        break;
+    case VMA_ALLOCATION_CREATE_STRATEGY_BEST_FIT_BIT:
+    case VMA_ALLOCATION_CREATE_STRATEGY_WORST_FIT_BIT:
+    case VMA_ALLOCATION_CREATE_STRATEGY_FIRST_FIT_BIT:
+        break;
+    default:
+        return VK_ERROR_FEATURE_NOT_PRESENT;
     }
 
-    // Apply alignment.
-    resultOffset = VmaAlignDown(resultOffset, allocAlignment);
+    // Early reject: requested allocation size is larger that maximum block size for this block vector.
+    if(size + 2 * VMA_DEBUG_MARGIN > m_PreferredBlockSize)
+    {
+        return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+    }
 
-    // Check next suballocations from 2nd for BufferImageGranularity conflicts.
-    // Make bigger alignment if necessary.
-    if(bufferImageGranularity > 1 && !suballocations2nd.empty())
+    /*
+    Under certain condition, this whole section can be skipped for optimization, so
+    we move on directly to trying to allocate with canMakeOtherLost. That's the case
+    e.g. for custom pools with linear algorithm.
+    */
+    if(!canMakeOtherLost || canCreateNewBlock)
     {
-        bool bufferImageGranularityConflict = false;
-        for(size_t nextSuballocIndex = suballocations2nd.size(); nextSuballocIndex--; )
+        // 1. Search existing allocations. Try to allocate without making other allocations lost.
+        VmaAllocationCreateFlags allocFlagsCopy = createInfo.flags;
+        allocFlagsCopy &= ~VMA_ALLOCATION_CREATE_CAN_MAKE_OTHER_LOST_BIT;
+
+        if(m_Algorithm == VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT)
         {
-            const VmaSuballocation& nextSuballoc = suballocations2nd[nextSuballocIndex];
-            if(VmaBlocksOnSamePage(resultOffset, allocSize, nextSuballoc.offset, bufferImageGranularity))
+            // Use only last block - the write head.
+            if(!m_Blocks.empty())
             {
-                if(VmaIsBufferImageGranularityConflict(nextSuballoc.type, allocType))
+                VmaDeviceMemoryBlock* const pCurrBlock = m_Blocks.back();
+                VMA_ASSERT(pCurrBlock);
+                VkResult res = AllocateFromBlock(
+                    pCurrBlock,
+                    currentFrameIndex,
+                    size,
+                    alignment,
+                    allocFlagsCopy,
+                    createInfo.pUserData,
+                    suballocType,
+                    strategy,
+                    pAllocation,
+                    pHandlelessAllocationInfo);
+                if(res == VK_SUCCESS)
                 {
-                    bufferImageGranularityConflict = true;
-                    break;
+                    VMA_DEBUG_LOG("    Returned from last block #%u", (uint32_t)(m_Blocks.size() - 1));
+                    return VK_SUCCESS;
+                }
+            }
+            // Multi-block ring buffer: the oldest block, once all its allocations are freed, becomes the new write head.
+            if(m_Blocks.size() > 1 && m_Blocks[0]->m_pMetadata->IsEmpty())
+            {
+                VmaDeviceMemoryBlock* const pOldestBlock = m_Blocks[0];
+                VkResult res = AllocateFromBlock(
+                    pOldestBlock,
+                    currentFrameIndex,
+                    size,
+                    alignment,
+                    allocFlagsCopy,
+                    createInfo.pUserData,
+                    suballocType,
+                    strategy,
+                    pAllocation,
+                    pHandlelessAllocationInfo);
+                if(res == VK_SUCCESS)
+                {
+                    MoveFirstBlockToBack();
+                    VMA_DEBUG_LOG("    Returned from oldest block, which became last");
+                    return VK_SUCCESS;
                 }
             }
-            else
-                // Already on previous page.
-                break;
-        }
-        if(bufferImageGranularityConflict)
-        {
-            resultOffset = VmaAlignDown(resultOffset, bufferImageGranularity);
         }
-    }
-
-    // There is enough free space.
-    const VkDeviceSize endOf1st = !suballocations1st.empty() ?
-        suballocations1st.back().offset + suballocations1st.back().size :
-        0;
-    if(endOf1st + VMA_DEBUG_MARGIN <= resultOffset)
-    {
-        // Check previous suballocations for BufferImageGranularity conflicts.
-        // If conflict exists, allocation cannot be made here.
-        if(bufferImageGranularity > 1)
+        else
         {
-            for(size_t prevSuballocIndex = suballocations1st.size(); prevSuballocIndex--; )
+            if(strategy == VMA_ALLOCATION_CREATE_STRATEGY_BEST_FIT_BIT)
             {
-                const VmaSuballocation& prevSuballoc = suballocations1st[prevSuballocIndex];
-                if(VmaBlocksOnSamePage(prevSuballoc.offset, prevSuballoc.size, resultOffset, bufferImageGranularity))
+                // Forward order in m_Blocks - prefer blocks with smallest amount of free space.
+                for(size_t blockIndex = 0; blockIndex < m_Blocks.size(); ++blockIndex )
                 {
-                    if(VmaIsBufferImageGranularityConflict(allocType, prevSuballoc.type))
+                    VmaDeviceMemoryBlock* const pCurrBlock = m_Blocks[blockIndex];
+                    VMA_ASSERT(pCurrBlock);
+                    VkResult res = AllocateFromBlock(
+                        pCurrBlock,
+                        currentFrameIndex,
+                        size,
+                        alignment,
+                        allocFlagsCopy,
+                        createInfo.pUserData,
+                        suballocType,
+                        strategy,
+                        pAllocation,
+                        pHandlelessAllocationInfo);
+                    if(res == VK_SUCCESS)
                     {
-                        return false;
+                        VMA_DEBUG_LOG("    Returned from existing block #%u", (uint32_t)blockIndex);
+                        return VK_SUCCESS;
                     }
                 }
-                else
+            }
+            else // WORST_FIT, FIRST_FIT
+            {
+                // Backward order in m_Blocks - prefer blocks with largest amount of free space.
+                for(size_t blockIndex = m_Blocks.size(); blockIndex--; )
                 {
-                    // Already on next page.
-                    break;
+                    VmaDeviceMemoryBlock* const pCurrBlock = m_Blocks[blockIndex];
+                    VMA_ASSERT(pCurrBlock);
+                    VkResult res = AllocateFromBlock(
+                        pCurrBlock,
+                        currentFrameIndex,
+                        size,
+                        alignment,
+                        allocFlagsCopy,
+                        createInfo.pUserData,
+                        suballocType,
+                        strategy,
+                        pAllocation,
+                        pHandlelessAllocationInfo);
+                    if(res == VK_SUCCESS)
+                    {
+                        VMA_DEBUG_LOG("    Returned from existing block #%u", (uint32_t)blockIndex);
+                        return VK_SUCCESS;
+                    }
                 }
             }
         }
 
-        // All tests passed: Success.
-        pAllocationRequest->offset = resultOffset;
-        pAllocationRequest->sumFreeSize = resultBaseOffset + allocSize - endOf1st;
-        pAllocationRequest->sumItemSize = 0;
-        // pAllocationRequest->item unused.
-        pAllocationRequest->itemsToMakeLostCount = 0;
-        pAllocationRequest->type = VmaAllocationRequestType::UpperAddress;
-        return true;
-    }
+        // 2. Try to create new block.
+        if(canCreateNewBlock)
+        {
+            // Calculate optimal size for new block.
+            VkDeviceSize newBlockSize = m_PreferredBlockSize;
+            uint32_t newBlockSizeShift = 0;
+            const uint32_t NEW_BLOCK_SIZE_SHIFT_MAX = 3;
 
-    return false;
-}
+            if(!m_ExplicitBlockSize)
+            {
+                // Allocate 1/8, 1/4, 1/2 as first blocks.
+                const VkDeviceSize maxExistingBlockSize = CalcMaxBlockSize();
+                for(uint32_t i = 0; i < NEW_BLOCK_SIZE_SHIFT_MAX; ++i)
+                {
+                    const VkDeviceSize smallerNewBlockSize = newBlockSize / 2;
+                    if(smallerNewBlockSize > maxExistingBlockSize && smallerNewBlockSize >= size * 2)
+                    {
+                        newBlockSize = smallerNewBlockSize;
+                        ++newBlockSizeShift;
+                    }
+                    else
+                    {
+                        break;
+                    }
+                }
+            }
 
-bool VmaBlockMetadata_Linear::CreateAllocationRequest_LowerAddress(
-    uint32_t currentFrameIndex,
-    uint32_t frameInUseCount,
-    VkDeviceSize bufferImageGranularity,
-    VkDeviceSize allocSize,
-    VkDeviceSize allocAlignment,
-    VmaSuballocationType allocType,
-    bool canMakeOtherLost,
-    uint32_t strategy,
-    VmaAllocationRequest* pAllocationRequest)
-{
-    const VkDeviceSize size = GetSize();
-    SuballocationVectorType& suballocations1st = AccessSuballocations1st();
-    SuballocationVectorType& suballocations2nd = AccessSuballocations2nd();
+            size_t newBlockIndex = 0;
+            VkResult res = CreateBlock(newBlockSize, &newBlockIndex);
+            // Allocation of this size failed? Try 1/2, 1/4, 1/8 of m_PreferredBlockSize.
+            if(!m_ExplicitBlockSize)
+            {
+                while(res < 0 && newBlockSizeShift < NEW_BLOCK_SIZE_SHIFT_MAX)
+                {
+                    const VkDeviceSize smallerNewBlockSize = newBlockSize / 2;
+                    if(smallerNewBlockSize >= size)
+                    {
+                        newBlockSize = smallerNewBlockSize;
+                        ++newBlockSizeShift;
+                        res = CreateBlock(newBlockSize, &newBlockIndex);
+                    }
+                    else
+                    {
+                        break;
+                    }
+                }
+            }
 
-    if(m_2ndVectorMode == SECOND_VECTOR_EMPTY || m_2ndVectorMode == SECOND_VECTOR_DOUBLE_STACK)
-    {
-        // Try to allocate at the end of 1st vector.
+            if(res == VK_SUCCESS)
+            {
+                VmaDeviceMemoryBlock* const pBlock = m_Blocks[newBlockIndex];
+                VMA_ASSERT(pBlock->m_pMetadata->GetSize() >= size);
 
-        VkDeviceSize resultBaseOffset = 0;
-        if(!suballocations1st.empty())
-        {
-            const VmaSuballocation& lastSuballoc = suballocations1st.back();
-            resultBaseOffset = lastSuballoc.offset + lastSuballoc.size;
+                res = AllocateFromBlock(
+                    pBlock,
+                    currentFrameIndex,
+                    size,
+                    alignment,
+                    allocFlagsCopy,
+                    createInfo.pUserData,
+                    suballocType,
+                    strategy,
+                    pAllocation,
+                    pHandlelessAllocationInfo);
+                if(res == VK_SUCCESS)
+                {
+                    VMA_DEBUG_LOG("    Created new block Size=%llu", newBlockSize);
+                    return VK_SUCCESS;
+                }
+                else
+                {
+                    // Allocation from new block failed, possibly due to VMA_DEBUG_MARGIN or alignment.
+                    return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+                }
+            }
         }
+    }
 
-        // Start from offset equal to beginning of free space.
-        VkDeviceSize resultOffset = resultBaseOffset;
-
-        // Apply VMA_DEBUG_MARGIN at the beginning.
-        if(VMA_DEBUG_MARGIN > 0)
+    // 3. Try to allocate from existing blocks with making other allocations lost.
+    if(canMakeOtherLost)
+    {
+        uint32_t tryIndex = 0;
+        for(; tryIndex < VMA_ALLOCATION_TRY_COUNT; ++tryIndex)
         {
-            resultOffset += VMA_DEBUG_MARGIN;
-        }
-
-        // Apply alignment.
-        resultOffset = VmaAlignUp(resultOffset, allocAlignment);
+            VmaDeviceMemoryBlock* pBestRequestBlock = VMA_NULL;
+            VmaAllocationRequest bestRequest = {};
+            VkDeviceSize bestRequestCost = VK_WHOLE_SIZE;
 
-        // Check previous suballocations for BufferImageGranularity conflicts.
-        // Make bigger alignment if necessary.
-        if(bufferImageGranularity > 1 && !suballocations1st.empty())
-        {
-            bool bufferImageGranularityConflict = false;
-            for(size_t prevSuballocIndex = suballocations1st.size(); prevSuballocIndex--; )
+            // 1. Search existing allocations.
+            if(m_Algorithm == VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT)
             {
-                const VmaSuballocation& prevSuballoc = suballocations1st[prevSuballocIndex];
-                if(VmaBlocksOnSamePage(prevSuballoc.offset, prevSuballoc.size, resultOffset, bufferImageGranularity))
+                /*
+                Ring buffer: continue at the write head (last block), making lost its oldest
+                allocations. When not possible, move on to the oldest block (first one), which
+                then becomes the write head. Blocks in between hold more recent allocations.
+                Cost is not compared, as preferring the oldest block when it's cheaper would
+                leave older allocations behind in the head, breaking FIFO order of blocks.
+                */
+                const size_t candidateCount = VMA_MIN(m_Blocks.size(), (size_t)2);
+                for(size_t candidateIndex = 0; candidateIndex < candidateCount; ++candidateIndex)
                 {
-                    if(VmaIsBufferImageGranularityConflict(prevSuballoc.type, allocType))
+                    VmaDeviceMemoryBlock* const pCurrBlock = candidateIndex == 0 ? m_Blocks.back() : m_Blocks[0];
+                    VMA_ASSERT(pCurrBlock);
+                    if(pCurrBlock->m_pMetadata->CreateAllocationRequest(
+                        currentFrameIndex,
+                        m_FrameInUseCount,
+                        m_BufferImageGranularity,
+                        size,
+                        alignment,
+                        (createInfo.flags & VMA_ALLOCATION_CREATE_UPPER_ADDRESS_BIT) != 0,
+                        suballocType,
+                        canMakeOtherLost,
+                        strategy,
+                        &bestRequest))
                     {
-                        bufferImageGranularityConflict = true;
+                        pBestRequestBlock = pCurrBlock;
                         break;
                     }
                 }
-                else
-                    // Already on previous page.
-                    break;
             }
-            if(bufferImageGranularityConflict)
+            else if(strategy == VMA_ALLOCATION_CREATE_STRATEGY_BEST_FIT_BIT)
             {
-                resultOffset = VmaAlignUp(resultOffset, bufferImageGranularity);
+                // Forward order in m_Blocks - prefer blocks with smallest amount of free space.
+                for(size_t blockIndex = 0; blockIndex < m_Blocks.size(); ++blockIndex )
+                {
+                    VmaDeviceMemoryBlock* const pCurrBlock = m_Blocks[blockIndex];
+                    VMA_ASSERT(pCurrBlock);
+                    VmaAllocationRequest currRequest = {};
+                    if(pCurrBlock->m_pMetadata->CreateAllocationRequest(
+                        currentFrameIndex,
+                        m_FrameInUseCount,
+                        m_BufferImageGranularity,
+                        size,
+                        alignment,
+                        (createInfo.flags & VMA_ALLOCATION_CREATE_UPPER_ADDRESS_BIT) != 0,
+                        suballocType,
+                        canMakeOtherLost,
+                        strategy,
+                        &currRequest))
+                    {
+                        const VkDeviceSize currRequestCost = currRequest.CalcCost();
+                        if(pBestRequestBlock == VMA_NULL ||
+                            currRequestCost < bestRequestCost)
+                        {
+                            pBestRequestBlock = pCurrBlock;
+                            bestRequest = currRequest;
+                            bestRequestCost = currRequestCost;
+
+                            if(bestRequestCost == 0)
+                            {
+                                break;
+                            }
+                        }
+                    }
+                }
             }
-        }
+            else // WORST_FIT, FIRST_FIT
+            {
+                // Backward order in m_Blocks - prefer blocks with largest amount of free space.
+                for(size_t blockIndex = m_Blocks.size(); blockIndex--; )
+                {
+                    VmaDeviceMemoryBlock* const pCurrBlock = m_Blocks[blockIndex];
+                    VMA_ASSERT(pCurrBlock);
+                    VmaAllocationRequest currRequest = {};
+                    if(pCurrBlock->m_pMetadata->CreateAllocationRequest(
+                        currentFrameIndex,
+                        m_FrameInUseCount,
+                        m_BufferImageGranularity,
+                        size,
+                        alignment,
+                        (createInfo.flags & VMA_ALLOCATION_CREATE_UPPER_ADDRESS_BIT) != 0,
+                        suballocType,
+                        canMakeOtherLost,
+                        strategy,
+                        &currRequest))
+                    {
+                        const VkDeviceSize currRequestCost = currRequest.CalcCost();
+                        if(pBestRequestBlock == VMA_NULL ||
+                            currRequestCost < bestRequestCost ||
+                            strategy == VMA_ALLOCATION_CREATE_STRATEGY_FIRST_FIT_BIT)
+                        {
+                            pBestRequestBlock = pCurrBlock;
+                            bestRequest = currRequest;
+                            bestRequestCost = currRequestCost;
 
-        const VkDeviceSize freeSpaceEnd = m_2ndVectorMode == SECOND_VECTOR_DOUBLE_STACK ?
-            suballocations2nd.back().offset : size;
+                            if(bestRequestCost == 0 ||
+                                strategy == VMA_ALLOCATION_CREATE_STRATEGY_FIRST_FIT_BIT)
+                            {
+                                break;
+                            }
+                        }
+                    }
+                }
+            }
 
-        // There is enough free space at the end after alignment.
-        if(resultOffset + allocSize + VMA_DEBUG_MARGIN <= freeSpaceEnd)
-        {
-            // Check next suballocations for BufferImageGranularity conflicts.
-            // If conflict exists, allocation cannot be made here.
-            if(bufferImageGranularity > 1 && m_2ndVectorMode == SECOND_VECTOR_DOUBLE_STACK)
+            if(pBestRequestBlock != VMA_NULL)
             {
-                for(size_t nextSuballocIndex = suballocations2nd.size(); nextSuballocIndex--; )
+                if(mapped && pHandlelessAllocationInfo == VMA_NULL)
                 {
-                    const VmaSuballocation& nextSuballoc = suballocations2nd[nextSuballocIndex];
-                    if(VmaBlocksOnSamePage(resultOffset, allocSize, nextSuballoc.offset, bufferImageGranularity))
+                    VkResult res = pBestRequestBlock->Map(m_hAllocator, 1, VMA_NULL);
+                    if(res != VK_SUCCESS)
                     {
-                        if(VmaIsBufferImageGranularityConflict(allocType, nextSuballoc.type))
+                        return res;
+                    }
+                }
+
+                const VkDeviceSize prevSumFreeSize = pBestRequestBlock->m_pMetadata->GetSumFreeSize();
+                const VkDeviceSize prevUnusedRangeSizeMax = pBestRequestBlock->m_pMetadata->GetUnusedRangeSizeMax();
+                if(pBestRequestBlock->m_pMetadata->MakeRequestedAllocationsLost(
+                    currentFrameIndex,
+                    m_FrameInUseCount,
+                    &bestRequest))
+                {
+                    if(pHandlelessAllocationInfo != VMA_NULL)
+                    {
+                        UpdateFragmentationScore(pBestRequestBlock, prevSumFreeSize, prevUnusedRangeSizeMax);
+                        const VkResult res = CommitHandlelessAllocation(
+                            pBestRequestBlock, bestRequest, size, suballocType, mapped, pHandlelessAllocationInfo);
+                        if(res == VK_SUCCESS && m_Blocks.size() > 1 && pBestRequestBlock == m_Blocks[0])
                         {
-                            return false;
+                            MoveFirstBlockToBack();
                         }
+                        return res;
                     }
-                    else
+                    // We no longer have an empty Allocation.
+                    if(pBestRequestBlock->m_pMetadata->IsEmpty())
                     {
-                        // Already on previous page.
-                        break;
+                        m_HasEmptyBlock = false;
+                    }
+                    // Allocate from this pBlock.
+                    *pAllocation = m_hAllocator->m_AllocationObjectAllocator.Allocate();
+                    (*pAllocation)->Ctor(currentFrameIndex, isUserDataString);
+                    pBestRequestBlock->m_pMetadata->Alloc(bestRequest, suballocType, size, *pAllocation);
+                    UpdateFragmentationScore(pBestRequestBlock, prevSumFreeSize, prevUnusedRangeSizeMax);
+                    if(m_Algorithm == VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT &&
+                        m_Blocks.size() > 1 &&
+                        pBestRequestBlock == m_Blocks[0])
+                    {
+                        MoveFirstBlockToBack();
+                    }
+                    (*pAllocation)->InitBlockAllocation(
+                        pBestRequestBlock,
+                        bestRequest.offset,
+                        alignment,
+                        size,
+                        suballocType,
+                        mapped,
+                        (createInfo.flags & VMA_ALLOCATION_CREATE_CAN_BECOME_LOST_BIT) != 0);
+                    VMA_HEAVY_ASSERT(pBestRequestBlock->Validate());
+                    VMA_DEBUG_LOG("    Returned from existing block");
+                    (*pAllocation)->SetUserData(m_hAllocator, createInfo.pUserData);
+                    if(VMA_DEBUG_INITIALIZE_ALLOCATIONS)
+                    {
+                        m_hAllocator->FillAllocation(*pAllocation, VMA_ALLOCATION_FILL_PATTERN_CREATED);
+                    }
+                    if(IsCorruptionDetectionEnabled())
+                    {
+                        VkResult res = pBestRequestBlock->WriteMagicValueAroundAllocation(m_hAllocator, bestRequest.offset, size);
+                        VMA_ASSERT(res == VK_SUCCESS && "Couldn't map block memory to write magic value.");
                     }
+                    return VK_SUCCESS;
                 }
+                // else: Some allocations must have been touched while we are here. Next try.
+                // Others may have already been made lost.
+                UpdateFragmentationScore(pBestRequestBlock, prevSumFreeSize, prevUnusedRangeSizeMax);
             }
-
-            // All tests passed: Success.
-            pAllocationRequest->offset = resultOffset;
-            pAllocationRequest->sumFreeSize = freeSpaceEnd - resultBaseOffset;
-            pAllocationRequest->sumItemSize = 0;
-            // pAllocationRequest->item, customData unused.
-            pAllocationRequest->type = VmaAllocationRequestType::EndOf1st;
-            pAllocationRequest->itemsToMakeLostCount = 0;
-            return true;
+            else
+            {
+                // Could not find place in any of the blocks - break outer loop.
+                break;
+            }
+        }
+        /* Maximum number of tries exceeded - a very unlike event when many other
+        threads are simultaneously touching allocations making it impossible to make
+        lost at the same time as we try to allocate. */
+        if(tryIndex == VMA_ALLOCATION_TRY_COUNT)
+        {
+            return VK_ERROR_TOO_MANY_OBJECTS;
         }
     }
 
-    // Wrap-around to end of 2nd vector. Try to allocate there, watching for the
-    // beginning of 1st vector as the end of free space.
-    if(m_2ndVectorMode == SECOND_VECTOR_EMPTY || m_2ndVectorMode == SECOND_VECTOR_RING_BUFFER)
-    {
-        VMA_ASSERT(!suballocations1st.empty());
+    return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+}
 
-        VkDeviceSize resultBaseOffset = 0;
-        if(!suballocations2nd.empty())
-        {
-            const VmaSuballocation& lastSuballoc = suballocations2nd.back();
-            resultBaseOffset = lastSuballoc.offset + lastSuballoc.size;
-        }
+void VmaBlockVector::Free(
+    VmaAllocation hAllocation)
+{
+    VmaDeviceMemoryBlock* pBlockToDelete = VMA_NULL;
 
-        // Start from offset equal to beginning of free space.
-        VkDeviceSize resultOffset = resultBaseOffset;
+    // Scope for lock.
+    {
+        VmaMutexLockWrite lock(m_Mutex, m_hAllocator->m_UseMutex, m_hAllocator->m_Counters);
 
-        // Apply VMA_DEBUG_MARGIN at the beginning.
-        if(VMA_DEBUG_MARGIN > 0)
+        VmaDeviceMemoryBlock* pBlock = hAllocation->GetBlock();
+
+        if(IsCorruptionDetectionEnabled())
         {
-            resultOffset += VMA_DEBUG_MARGIN;
+            VkResult res = pBlock->ValidateMagicValueAroundAllocation(m_hAllocator, hAllocation->GetOffset(), hAllocation->GetSize());
+            VMA_ASSERT(res == VK_SUCCESS && "Couldn't map block memory to validate magic value.");
         }
 
-        // Apply alignment.
-        resultOffset = VmaAlignUp(resultOffset, allocAlignment);
-
-        // Check previous suballocations for BufferImageGranularity conflicts.
-        // Make bigger alignment if necessary.
-        if(bufferImageGranularity > 1 && !suballocations2nd.empty())
+        if(hAllocation->IsPersistentMap())
         {
-            bool bufferImageGranularityConflict = false;
-            for(size_t prevSuballocIndex = suballocations2nd.size(); prevSuballocIndex--; )
-            {
-                const VmaSuballocation& prevSuballoc = suballocations2nd[prevSuballocIndex];
-                if(VmaBlocksOnSamePage(prevSuballoc.offset, prevSuballoc.size, resultOffset, bufferImageGranularity))
-                {
-                    if(VmaIsBufferImageGranularityConflict(prevSuballoc.type, allocType))
-                    {
-                        bufferImageGranularityConflict = true;
-                        break;
-                    }
-                }
-                else
-                    // Already on previous page.
-                    break;
-            }
-            if(bufferImageGranularityConflict)
-            {
-                resultOffset = VmaAlignUp(resultOffset, bufferImageGranularity);
-            }
+            pBlock->Unmap(m_hAllocator, 1);
         }
 
-        pAllocationRequest->itemsToMakeLostCount = 0;
-        pAllocationRequest->sumItemSize = 0;
-        size_t index1st = m_1stNullItemsBeginCount;
-
-        if(canMakeOtherLost)
-        {
-            while(index1st < suballocations1st.size() &&
-                resultOffset + allocSize + VMA_DEBUG_MARGIN > suballocations1st[index1st].offset)
-            {
-                // Next colliding allocation at the beginning of 1st vector found. Try to make it lost.
-                const VmaSuballocation& suballoc = suballocations1st[index1st];
-                if(suballoc.type == VMA_SUBALLOCATION_TYPE_FREE)
-                {
-                    // No problem.
-                }
-                else
-                {
-                    VMA_ASSERT(suballoc.hAllocation != VK_NULL_HANDLE);
-                    if(suballoc.hAllocation->CanBecomeLost() &&
-                        suballoc.hAllocation->GetLastUseFrameIndex() + frameInUseCount < currentFrameIndex)
-                    {
-                        ++pAllocationRequest->itemsToMakeLostCount;
-                        pAllocationRequest->sumItemSize += suballoc.size;
-                    }
-                    else
-                    {
-                        return false;
-                    }
-                }
-                ++index1st;
-            }
+        const VkDeviceSize prevSumFreeSize = pBlock->m_pMetadata->GetSumFreeSize();
+        const VkDeviceSize prevUnusedRangeSizeMax = pBlock->m_pMetadata->GetUnusedRangeSizeMax();
+        pBlock->m_pMetadata->Free(hAllocation);
+        VMA_HEAVY_ASSERT(pBlock->Validate());
+        UpdateFragmentationScore(pBlock, prevSumFreeSize, prevUnusedRangeSizeMax);
+        ++m_Histograms.allocationLifetime[VmaLifetimeHistogramBucket(
+            hAllocation->GetCreationFrameIndex(), m_hAllocator->GetCurrentFrameIndex())];
 
-            // Check next suballocations for BufferImageGranularity conflicts.
-            // If conflict exists, we must mark more allocations lost or fail.
-            if(bufferImageGranularity > 1)
+        VMA_DEBUG_LOG("  Freed from MemoryTypeIndex=%u", m_MemoryTypeIndex);
+
+        // pBlock became empty after this deallocation.
+        if(pBlock->m_pMetadata->IsEmpty())
+        {
+            // Already has empty Allocation. We don't want to have two, so delete this one.
+            if(m_HasEmptyBlock && m_Blocks.size() > m_MinBlockCount)
             {
-                while(index1st < suballocations1st.size())
-                {
-                    const VmaSuballocation& suballoc = suballocations1st[index1st];
-                    if(VmaBlocksOnSamePage(resultOffset, allocSize, suballoc.offset, bufferImageGranularity))
-                    {
-                        if(suballoc.hAllocation != VK_NULL_HANDLE)
-                        {
-                            // Not checking actual VmaIsBufferImageGranularityConflict(allocType, suballoc.type).
-                            if(suballoc.hAllocation->CanBecomeLost() &&
-                                suballoc.hAllocation->GetLastUseFrameIndex() + frameInUseCount < currentFrameIndex)
-                            {
-                                ++pAllocationRequest->itemsToMakeLostCount;
-                                pAllocationRequest->sumItemSize += suballoc.size;
-                            }
-                            else
-                            {
-                                return false;
-                            }
-                        }
-                    }
-                    else
-                    {
-                        // Already on next page.
-                        break;
-                    }
-                    ++index1st;
-                }
+                pBlockToDelete = pBlock;
+                Remove(pBlock);
             }
-
-            // Special case: There is not enough room at the end for this allocation, even after making all from the 1st lost.
-            if(index1st == suballocations1st.size() &&
-                resultOffset + allocSize + VMA_DEBUG_MARGIN > size)
+            // We now have first empty block.
+            else
             {
-                // TODO: This is a known bug that it's not yet implemented and the allocation is failing.
-                VMA_DEBUG_LOG("Unsupported special case in custom pool with linear allocation algorithm used as ring buffer with allocations that can be lost.");
+                m_HasEmptyBlock = true;
             }
         }
-
-        // There is enough free space at the end after alignment.
-        if((index1st == suballocations1st.size() && resultOffset + allocSize + VMA_DEBUG_MARGIN <= size) ||
-            (index1st < suballocations1st.size() && resultOffset + allocSize + VMA_DEBUG_MARGIN <= suballocations1st[index1st].offset))
+        // pBlock didn't become empty, but we have another empty block - find and free that one.
+        // (This is optional, heuristics.)
+        else if(m_HasEmptyBlock)
         {
-            // Check next suballocations for BufferImageGranularity conflicts.
-            // If conflict exists, allocation cannot be made here.
-            if(bufferImageGranularity > 1)
+            VmaDeviceMemoryBlock* pLastBlock = m_Blocks.back();
+            if(pLastBlock->m_pMetadata->IsEmpty() && m_Blocks.size() > m_MinBlockCount)
             {
-                for(size_t nextSuballocIndex = index1st;
-                    nextSuballocIndex < suballocations1st.size();
-                    nextSuballocIndex++)
-                {
-                    const VmaSuballocation& nextSuballoc = suballocations1st[nextSuballocIndex];
-                    if(VmaBlocksOnSamePage(resultOffset, allocSize, nextSuballoc.offset, bufferImageGranularity))
-                    {
-                        if(VmaIsBufferImageGranularityConflict(allocType, nextSuballoc.type))
-                        {
-                            return false;
-                        }
-                    }
-                    else
-                    {
-                        // Already on next page.
-                        break;
-                    }
-                }
+                pBlockToDelete = pLastBlock;
+                m_Blocks.pop_back();
+                m_HasEmptyBlock = false;
             }
+        }
 
-            // All tests passed: Success.
-            pAllocationRequest->offset = resultOffset;
-            pAllocationRequest->sumFreeSize =
-                (index1st < suballocations1st.size() ? suballocations1st[index1st].offset : size)
-                - resultBaseOffset
-                - pAllocationRequest->sumItemSize;
-            pAllocationRequest->type = VmaAllocationRequestType::EndOf2nd;
-            // pAllocationRequest->item, customData unused.
-            return true;
+        if(pBlockToDelete != VMA_NULL)
+        {
+            RecalculateFragmentationScore();
         }
+
+        IncrementallySortBlocks();
     }
 
-    return false;
+    // Destruction of a free Allocation. Deferred until this point, outside of mutex
+    // lock, for performance reason.
+    if(pBlockToDelete != VMA_NULL)
+    {
+        VMA_DEBUG_LOG("    Deleted empty allocation");
+        pBlockToDelete->Destroy(m_hAllocator);
+        vma_delete(m_hAllocator, pBlockToDelete);
+    }
 }
 
-bool VmaBlockMetadata_Linear::MakeRequestedAllocationsLost(
+VkResult VmaBlockVector::AllocateWithoutHandle(
     uint32_t currentFrameIndex,
-    uint32_t frameInUseCount,
-    VmaAllocationRequest* pAllocationRequest)
+    VkDeviceSize size,
+    VkDeviceSize alignment,
+    const VmaAllocationCreateInfo& createInfo,
+    VmaSuballocationType suballocType,
+    VmaAllocationInfo* pAllocationInfo)
 {
-    if(pAllocationRequest->itemsToMakeLostCount == 0)
+    VMA_ASSERT(m_Algorithm == VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT);
+
+    if(IsCorruptionDetectionEnabled())
     {
-        return true;
+        size = VmaAlignUp<VkDeviceSize>(size, sizeof(VMA_CORRUPTION_DETECTION_MAGIC_VALUE));
+        alignment = VmaAlignUp<VkDeviceSize>(alignment, sizeof(VMA_CORRUPTION_DETECTION_MAGIC_VALUE));
     }
 
-    VMA_ASSERT(m_2ndVectorMode == SECOND_VECTOR_EMPTY || m_2ndVectorMode == SECOND_VECTOR_RING_BUFFER);
-    
-    // We always start from 1st.
-    SuballocationVectorType* suballocations = &AccessSuballocations1st();
-    size_t index = m_1stNullItemsBeginCount;
-    size_t madeLostCount = 0;
-    while(madeLostCount < pAllocationRequest->itemsToMakeLostCount)
+    VmaMutexLockWrite lock(m_Mutex, m_hAllocator->m_UseMutex, m_hAllocator->m_Counters);
+    VkResult res = AllocatePage(
+        currentFrameIndex,
+        size,
+        alignment,
+        createInfo,
+        suballocType,
+        VMA_NULL, // pAllocation
+        pAllocationInfo);
+    if(res == VK_SUCCESS)
     {
-        if(index == suballocations->size())
+        ++m_Histograms.allocationSize[VmaSizeHistogramBucket(size)];
+    }
+    return res;
+}
+
+size_t VmaBlockVector::FreeUpToFrame(
+    uint32_t lastFrameIndex,
+    VmaVector< VmaAllocation, VmaStlAllocator<VmaAllocation> >& outAllocations,
+    VmaVector< VmaSuballocation, VmaStlAllocator<VmaSuballocation> >* pOutSuballocations)
+{
+    VMA_ASSERT(m_Algorithm == VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT);
+
+    VmaVector< VmaDeviceMemoryBlock*, VmaStlAllocator<VmaDeviceMemoryBlock*> > blocksToDelete(
+        VmaStlAllocator<VmaDeviceMemoryBlock*>(m_hAllocator->GetAllocationCallbacks()));
+    size_t freedCount = 0;
+    VkDeviceSize freedBytes = 0;
+    const uint32_t currentFrameIndex = m_hAllocator->GetCurrentFrameIndex();
+
+    // Scope for lock.
+    {
+        VmaMutexLockWrite lock(m_Mutex, m_hAllocator->m_UseMutex, m_hAllocator->m_Counters);
+
+        for(size_t blockIndex = 0; blockIndex < m_Blocks.size(); ++blockIndex)
         {
-            index = 0;
-            // If we get to the end of 1st, we wrap around to beginning of 2nd of 1st.
-            if(m_2ndVectorMode == SECOND_VECTOR_RING_BUFFER)
+            VmaDeviceMemoryBlock* const pBlock = m_Blocks[blockIndex];
+            VmaBlockMetadata_Linear* const pMetadata = (VmaBlockMetadata_Linear*)pBlock->m_pMetadata;
+
+            if(IsCorruptionDetectionEnabled())
             {
-                suballocations = &AccessSuballocations2nd();
+                VkResult res = pBlock->CheckCorruption(m_hAllocator);
+                VMA_ASSERT(res == VK_SUCCESS && "Couldn't map block memory to validate magic value.");
+                (void)res;
             }
-            // else: m_2ndVectorMode == SECOND_VECTOR_EMPTY:
-            // suballocations continues pointing at AccessSuballocations1st().
-            VMA_ASSERT(!suballocations->empty());
+
+            const size_t prevAllocationCount = outAllocations.size();
+            const VkDeviceSize prevSumFreeSize = pMetadata->GetSumFreeSize();
+            const VkDeviceSize prevUnusedRangeSizeMax = pMetadata->GetUnusedRangeSizeMax();
+            freedCount += pMetadata->FreeUpToFrame(lastFrameIndex, currentFrameIndex, m_Histograms, outAllocations, pOutSuballocations);
+            freedBytes += pMetadata->GetSumFreeSize() - prevSumFreeSize;
+            VMA_HEAVY_ASSERT(pBlock->Validate());
+            UpdateFragmentationScore(pBlock, prevSumFreeSize, prevUnusedRangeSizeMax);
+
+            // Memory of freed allocations can't be reused before the lock is released.
+            uint32_t persistentMapCount = 0;
+            for(size_t allocIndex = prevAllocationCount; allocIndex < outAllocations.size(); ++allocIndex)
+            {
+                const VmaAllocation hAllocation = outAllocations[allocIndex];
+                if(VMA_DEBUG_INITIALIZE_ALLOCATIONS)
+                {
+                    m_hAllocator->FillAllocation(hAllocation, VMA_ALLOCATION_FILL_PATTERN_DESTROYED);
+                }
+                if(hAllocation->IsPersistentMap())
+                {
+                    ++persistentMapCount;
+                }
+            }
+            pBlock->Unmap(m_hAllocator, persistentMapCount);
         }
-        VmaSuballocation& suballoc = (*suballocations)[index];
-        if(suballoc.type != VMA_SUBALLOCATION_TYPE_FREE)
+
+        // Keep at most one empty block, like Free() does.
+        m_HasEmptyBlock = false;
+        for(size_t blockIndex = m_Blocks.size(); blockIndex--; )
         {
-            VMA_ASSERT(suballoc.hAllocation != VK_NULL_HANDLE);
-            VMA_ASSERT(suballoc.hAllocation->CanBecomeLost());
-            if(suballoc.hAllocation->MakeLost(currentFrameIndex, frameInUseCount))
+            VmaDeviceMemoryBlock* const pBlock = m_Blocks[blockIndex];
+            if(pBlock->m_pMetadata->IsEmpty())
             {
-                suballoc.type = VMA_SUBALLOCATION_TYPE_FREE;
-                suballoc.hAllocation = VK_NULL_HANDLE;
-                m_SumFreeSize += suballoc.size;
-                if(suballocations == &AccessSuballocations1st())
+                if(m_HasEmptyBlock && m_Blocks.size() > m_MinBlockCount)
                 {
-                    ++m_1stNullItemsMiddleCount;
+                    blocksToDelete.push_back(pBlock);
+                    VmaVectorRemove(m_Blocks, blockIndex);
                 }
                 else
                 {
-                    ++m_2ndNullItemsCount;
+                    m_HasEmptyBlock = true;
                 }
-                ++madeLostCount;
-            }
-            else
-            {
-                return false;
             }
         }
-        ++index;
+        if(!blocksToDelete.empty())
+        {
+            RecalculateFragmentationScore();
+        }
     }
 
-    CleanupAfterFree();
-    //VMA_HEAVY_ASSERT(Validate()); // Already called by ClanupAfterFree().
-    
-    return true;
+    // Destruction of empty blocks, outside of mutex lock.
+    for(size_t i = 0; i < blocksToDelete.size(); ++i)
+    {
+        VMA_DEBUG_LOG("    Deleted empty allocation");
+        blocksToDelete[i]->Destroy(m_hAllocator);
+        vma_delete(m_hAllocator, blocksToDelete[i]);
+    }
+
+    m_hAllocator->m_Counters.Add(
+        VmaAllocatorCounters::COUNTER_FREE_COUNT, freedCount,
+        VmaAllocatorCounters::COUNTER_FREE_BYTES, freedBytes);
+    return freedCount;
 }
 
-uint32_t VmaBlockMetadata_Linear::MakeAllocationsLost(uint32_t currentFrameIndex, uint32_t frameInUseCount)
+VkDeviceSize VmaBlockVector::CalcMaxBlockSize() const
 {
-    uint32_t lostAllocationCount = 0;
-    
-    SuballocationVectorType& suballocations1st = AccessSuballocations1st();
-    for(size_t i = m_1stNullItemsBeginCount, count = suballocations1st.size(); i < count; ++i)
+    VkDeviceSize result = 0;
+    for(size_t i = m_Blocks.size(); i--; )
     {
-        VmaSuballocation& suballoc = suballocations1st[i];
-        if(suballoc.type != VMA_SUBALLOCATION_TYPE_FREE &&
-            suballoc.hAllocation->CanBecomeLost() &&
-            suballoc.hAllocation->MakeLost(currentFrameIndex, frameInUseCount))
+        result = VMA_MAX(result, m_Blocks[i]->m_pMetadata->GetSize());
+        if(result >= m_PreferredBlockSize)
         {
-            suballoc.type = VMA_SUBALLOCATION_TYPE_FREE;
-            suballoc.hAllocation = VK_NULL_HANDLE;
-            ++m_1stNullItemsMiddleCount;
-            m_SumFreeSize += suballoc.size;
-            ++lostAllocationCount;
+            break;
         }
     }
+    return result;
+}
 
-    SuballocationVectorType& suballocations2nd = AccessSuballocations2nd();
-    for(size_t i = 0, count = suballocations2nd.size(); i < count; ++i)
+void VmaBlockVector::Remove(VmaDeviceMemoryBlock* pBlock)
+{
+    for(uint32_t blockIndex = 0; blockIndex < m_Blocks.size(); ++blockIndex)
     {
-        VmaSuballocation& suballoc = suballocations2nd[i];
-        if(suballoc.type != VMA_SUBALLOCATION_TYPE_FREE &&
-            suballoc.hAllocation->CanBecomeLost() &&
-            suballoc.hAllocation->MakeLost(currentFrameIndex, frameInUseCount))
+        if(m_Blocks[blockIndex] == pBlock)
         {
-            suballoc.type = VMA_SUBALLOCATION_TYPE_FREE;
-            suballoc.hAllocation = VK_NULL_HANDLE;
-            ++m_2ndNullItemsCount;
-            m_SumFreeSize += suballoc.size;
-            ++lostAllocationCount;
+            VmaVectorRemove(m_Blocks, blockIndex);
+            return;
         }
     }
-
-    if(lostAllocationCount)
-    {
-        CleanupAfterFree();
-    }
-
-    return lostAllocationCount;
+    VMA_ASSERT(0);
 }
 
-VkResult VmaBlockMetadata_Linear::CheckCorruption(const void* pBlockData)
+void VmaBlockVector::MoveFirstBlockToBack()
 {
-    SuballocationVectorType& suballocations1st = AccessSuballocations1st();
-    for(size_t i = m_1stNullItemsBeginCount, count = suballocations1st.size(); i < count; ++i)
-    {
-        const VmaSuballocation& suballoc = suballocations1st[i];
-        if(suballoc.type != VMA_SUBALLOCATION_TYPE_FREE)
-        {
-            if(!VmaValidateMagicValue(pBlockData, suballoc.offset - VMA_DEBUG_MARGIN))
-            {
-                VMA_ASSERT(0 && "MEMORY CORRUPTION DETECTED BEFORE VALIDATED ALLOCATION!");
-                return VK_ERROR_VALIDATION_FAILED_EXT;
-            }
-            if(!VmaValidateMagicValue(pBlockData, suballoc.offset + suballoc.size))
-            {
-                VMA_ASSERT(0 && "MEMORY CORRUPTION DETECTED AFTER VALIDATED ALLOCATION!");
-                return VK_ERROR_VALIDATION_FAILED_EXT;
-            }
-        }
-    }
+    VMA_ASSERT(m_Algorithm == VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT && !m_Blocks.empty());
+    VmaDeviceMemoryBlock* const pBlock = m_Blocks[0];
+    VmaVectorRemove(m_Blocks, 0);
+    m_Blocks.push_back(pBlock);
+}
 
-    SuballocationVectorType& suballocations2nd = AccessSuballocations2nd();
-    for(size_t i = 0, count = suballocations2nd.size(); i < count; ++i)
+void VmaBlockVector::IncrementallySortBlocks()
+{
+    if(m_Algorithm != VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT)
     {
-        const VmaSuballocation& suballoc = suballocations2nd[i];
-        if(suballoc.type != VMA_SUBALLOCATION_TYPE_FREE)
+        // Bubble sort only until first swap.
+        for(size_t i = 1; i < m_Blocks.size(); ++i)
         {
-            if(!VmaValidateMagicValue(pBlockData, suballoc.offset - VMA_DEBUG_MARGIN))
-            {
-                VMA_ASSERT(0 && "MEMORY CORRUPTION DETECTED BEFORE VALIDATED ALLOCATION!");
-                return VK_ERROR_VALIDATION_FAILED_EXT;
-            }
-            if(!VmaValidateMagicValue(pBlockData, suballoc.offset + suballoc.size))
+            if(m_Blocks[i - 1]->m_pMetadata->GetSumFreeSize() > m_Blocks[i]->m_pMetadata->GetSumFreeSize())
             {
-                VMA_ASSERT(0 && "MEMORY CORRUPTION DETECTED AFTER VALIDATED ALLOCATION!");
-                return VK_ERROR_VALIDATION_FAILED_EXT;
+                VMA_SWAP(m_Blocks[i - 1], m_Blocks[i]);
+                return;
             }
         }
     }
-
-    return VK_SUCCESS;
 }
 
-void VmaBlockMetadata_Linear::Alloc(
-    const VmaAllocationRequest& request,
-    VmaSuballocationType type,
-    VkDeviceSize allocSize,
-    VmaAllocation hAllocation)
+VkResult VmaBlockVector::AllocateFromBlock(
+    VmaDeviceMemoryBlock* pBlock,
+    uint32_t currentFrameIndex,
+    VkDeviceSize size,
+    VkDeviceSize alignment,
+    VmaAllocationCreateFlags allocFlags,
+    void* pUserData,
+    VmaSuballocationType suballocType,
+    uint32_t strategy,
+    VmaAllocation* pAllocation,
+    VmaAllocationInfo* pHandlelessAllocationInfo)
 {
-    const VmaSuballocation newSuballoc = { request.offset, allocSize, hAllocation, type };
+    VMA_ASSERT((allocFlags & VMA_ALLOCATION_CREATE_CAN_MAKE_OTHER_LOST_BIT) == 0);
+    const bool isUpperAddress = (allocFlags & VMA_ALLOCATION_CREATE_UPPER_ADDRESS_BIT) != 0;
+    const bool mapped = (allocFlags & VMA_ALLOCATION_CREATE_MAPPED_BIT) != 0;
+    const bool isUserDataString = (allocFlags & VMA_ALLOCATION_CREATE_USER_DATA_COPY_STRING_BIT) != 0;
 
-    switch(request.type)
+    VmaAllocationRequest currRequest = {};
+    if(pBlock->m_pMetadata->CreateAllocationRequest(
+        currentFrameIndex,
+        m_FrameInUseCount,
+        m_BufferImageGranularity,
+        size,
+        alignment,
+        isUpperAddress,
+        suballocType,
+        false, // canMakeOtherLost
+        strategy,
+        &currRequest))
     {
-    case VmaAllocationRequestType::UpperAddress:
+        // Allocate from pCurrBlock.
+        VMA_ASSERT(currRequest.itemsToMakeLostCount == 0);
+
+        if(pHandlelessAllocationInfo != VMA_NULL)
         {
-            VMA_ASSERT(m_2ndVectorMode != SECOND_VECTOR_RING_BUFFER &&
-                "CRITICAL ERROR: Trying to use linear allocator as double stack while it was already used as ring buffer.");
-            SuballocationVectorType& suballocations2nd = AccessSuballocations2nd();
-            suballocations2nd.push_back(newSuballoc);
-            m_2ndVectorMode = SECOND_VECTOR_DOUBLE_STACK;
+            return CommitHandlelessAllocation(pBlock, currRequest, size, suballocType, mapped, pHandlelessAllocationInfo);
         }
-        break;
-    case VmaAllocationRequestType::EndOf1st:
-        {
-            SuballocationVectorType& suballocations1st = AccessSuballocations1st();
-
-            VMA_ASSERT(suballocations1st.empty() ||
-                request.offset >= suballocations1st.back().offset + suballocations1st.back().size);
-            // Check if it fits before the end of the block.
-            VMA_ASSERT(request.offset + allocSize <= GetSize());
 
-            suballocations1st.push_back(newSuballoc);
-        }
-        break;
-    case VmaAllocationRequestType::EndOf2nd:
+        if(mapped)
         {
-            SuballocationVectorType& suballocations1st = AccessSuballocations1st();
-            // New allocation at the end of 2-part ring buffer, so before first allocation from 1st vector.
-            VMA_ASSERT(!suballocations1st.empty() &&
-                request.offset + allocSize <= suballocations1st[m_1stNullItemsBeginCount].offset);
-            SuballocationVectorType& suballocations2nd = AccessSuballocations2nd();
-
-            switch(m_2ndVectorMode)
+            VkResult res = pBlock->Map(m_hAllocator, 1, VMA_NULL);
+            if(res != VK_SUCCESS)
             {
-            case SECOND_VECTOR_EMPTY:
-                // First allocation from second part ring buffer.
-                VMA_ASSERT(suballocations2nd.empty());
-                m_2ndVectorMode = SECOND_VECTOR_RING_BUFFER;
-                break;
-            case SECOND_VECTOR_RING_BUFFER:
-                // 2-part ring buffer is already started.
-                VMA_ASSERT(!suballocations2nd.empty());
-                break;
-            case SECOND_VECTOR_DOUBLE_STACK:
-                VMA_ASSERT(0 && "CRITICAL ERROR: Trying to use linear allocator as ring buffer while it was already used as double stack.");
-                break;
-            default:
-                VMA_ASSERT(0);
+                return res;
             }
-
-            suballocations2nd.push_back(newSuballoc);
         }
-        break;
-    default:
-        VMA_ASSERT(0 && "CRITICAL INTERNAL ERROR.");
+            
+        // We no longer have an empty Allocation.
+        if(pBlock->m_pMetadata->IsEmpty())
+        {
+            m_HasEmptyBlock = false;
+        }
+            
+        *pAllocation = m_hAllocator->m_AllocationObjectAllocator.Allocate();
+        (*pAllocation)->Ctor(currentFrameIndex, isUserDataString);
+        const VkDeviceSize prevSumFreeSize = pBlock->m_pMetadata->GetSumFreeSize();
+        const VkDeviceSize prevUnusedRangeSizeMax = pBlock->m_pMetadata->GetUnusedRangeSizeMax();
+        pBlock->m_pMetadata->Alloc(currRequest, suballocType, size, *pAllocation);
+        UpdateFragmentationScore(pBlock, prevSumFreeSize, prevUnusedRangeSizeMax);
+        (*pAllocation)->InitBlockAllocation(
+            pBlock,
+            currRequest.offset,
+            alignment,
+            size,
+            suballocType,
+            mapped,
+            (allocFlags & VMA_ALLOCATION_CREATE_CAN_BECOME_LOST_BIT) != 0);
+        VMA_HEAVY_ASSERT(pBlock->Validate());
+        (*pAllocation)->SetUserData(m_hAllocator, pUserData);
+        if(VMA_DEBUG_INITIALIZE_ALLOCATIONS)
+        {
+            m_hAllocator->FillAllocation(*pAllocation, VMA_ALLOCATION_FILL_PATTERN_CREATED);
+        }
+        if(IsCorruptionDetectionEnabled())
+        {
+            VkResult res = pBlock->WriteMagicValueAroundAllocation(m_hAllocator, currRequest.offset, size);
+            VMA_ASSERT(res == VK_SUCCESS && "Couldn't map block memory to write magic value.");
+        }
+        return VK_SUCCESS;
     }
-
-    m_SumFreeSize -= newSuballoc.size;
-}
-
-void VmaBlockMetadata_Linear::Free(const VmaAllocation allocation)
-{
-    FreeAtOffset(allocation->GetOffset());
+    return VK_ERROR_OUT_OF_DEVICE_MEMORY;
 }
 
-void VmaBlockMetadata_Linear::FreeAtOffset(VkDeviceSize offset)
+VkResult VmaBlockVector::CommitHandlelessAllocation(
+    VmaDeviceMemoryBlock* pBlock,
+    const VmaAllocationRequest& request,
+    VkDeviceSize size,
+    VmaSuballocationType suballocType,
+    bool mapped,
+    VmaAllocationInfo* pAllocationInfo)
 {
-    SuballocationVectorType& suballocations1st = AccessSuballocations1st();
-    SuballocationVectorType& suballocations2nd = AccessSuballocations2nd();
+    VMA_ASSERT(m_Algorithm == VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT);
 
-    if(!suballocations1st.empty())
+    void* pBlockData = VMA_NULL;
+    if(mapped)
     {
-        // First allocation: Mark it as next empty at the beginning.
-        VmaSuballocation& firstSuballoc = suballocations1st[m_1stNullItemsBeginCount];
-        if(firstSuballoc.offset == offset)
+        VkResult res = pBlock->MapForHandlelessAllocations(m_hAllocator, &pBlockData);
+        if(res != VK_SUCCESS)
         {
-            firstSuballoc.type = VMA_SUBALLOCATION_TYPE_FREE;
-            firstSuballoc.hAllocation = VK_NULL_HANDLE;
-            m_SumFreeSize += firstSuballoc.size;
-            ++m_1stNullItemsBeginCount;
-            CleanupAfterFree();
-            return;
+            return res;
         }
     }
 
-    // Last allocation in 2-part ring buffer or top of upper stack (same logic).
-    if(m_2ndVectorMode == SECOND_VECTOR_RING_BUFFER ||
-        m_2ndVectorMode == SECOND_VECTOR_DOUBLE_STACK)
+    // We no longer have an empty Allocation.
+    if(pBlock->m_pMetadata->IsEmpty())
     {
-        VmaSuballocation& lastSuballoc = suballocations2nd.back();
-        if(lastSuballoc.offset == offset)
-        {
-            m_SumFreeSize += lastSuballoc.size;
-            suballocations2nd.pop_back();
-            CleanupAfterFree();
-            return;
-        }
+        m_HasEmptyBlock = false;
     }
-    // Last allocation in 1st vector.
-    else if(m_2ndVectorMode == SECOND_VECTOR_EMPTY)
+
+    const VkDeviceSize prevSumFreeSize = pBlock->m_pMetadata->GetSumFreeSize();
+    const VkDeviceSize prevUnusedRangeSizeMax = pBlock->m_pMetadata->GetUnusedRangeSizeMax();
+    pBlock->m_pMetadata->Alloc(request, suballocType, size, VK_NULL_HANDLE);
+    UpdateFragmentationScore(pBlock, prevSumFreeSize, prevUnusedRangeSizeMax);
+    VMA_HEAVY_ASSERT(pBlock->Validate());
+    if(IsCorruptionDetectionEnabled())
     {
-        VmaSuballocation& lastSuballoc = suballocations1st.back();
-        if(lastSuballoc.offset == offset)
-        {
-            m_SumFreeSize += lastSuballoc.size;
-            suballocations1st.pop_back();
-            CleanupAfterFree();
-            return;
-        }
+        VkResult res = pBlock->WriteMagicValueAroundAllocation(m_hAllocator, request.offset, size);
+        VMA_ASSERT(res == VK_SUCCESS && "Couldn't map block memory to write magic value.");
+        (void)res;
     }
 
-    // Item from the middle of 1st vector.
+    pAllocationInfo->memoryType = m_MemoryTypeIndex;
+    pAllocationInfo->deviceMemory = pBlock->GetDeviceMemory();
+    pAllocationInfo->offset = request.offset;
+    pAllocationInfo->size = size;
+    pAllocationInfo->pMappedData = mapped ? (char*)pBlockData + request.offset : VMA_NULL;
+    pAllocationInfo->pUserData = VMA_NULL;
+    return VK_SUCCESS;
+}
+
+VkResult VmaBlockVector::CreateBlock(VkDeviceSize blockSize, size_t* pNewBlockIndex)
+{
+    VkMemoryAllocateInfo allocInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+    allocInfo.memoryTypeIndex = m_MemoryTypeIndex;
+    allocInfo.allocationSize = blockSize;
+    VkDeviceMemory mem = VK_NULL_HANDLE;
+    VkResult res = m_hAllocator->AllocateVulkanMemory(&allocInfo, &mem);
+    if(res < 0)
     {
-        VmaSuballocation refSuballoc;
-        refSuballoc.offset = offset;
-        // Rest of members stays uninitialized intentionally for better performance.
-        SuballocationVectorType::iterator it = VmaBinaryFindSorted(
-            suballocations1st.begin() + m_1stNullItemsBeginCount,
-            suballocations1st.end(),
-            refSuballoc,
-            VmaSuballocationOffsetLess());
-        if(it != suballocations1st.end())
-        {
-            it->type = VMA_SUBALLOCATION_TYPE_FREE;
-            it->hAllocation = VK_NULL_HANDLE;
-            ++m_1stNullItemsMiddleCount;
-            m_SumFreeSize += it->size;
-            CleanupAfterFree();
-            return;
-        }
+        return res;
     }
 
-    if(m_2ndVectorMode != SECOND_VECTOR_EMPTY)
+    // New VkDeviceMemory successfully created.
+
+    // Create new Allocation for it.
+    VmaDeviceMemoryBlock* const pBlock = vma_new(m_hAllocator, VmaDeviceMemoryBlock)(m_hAllocator);
+    pBlock->Init(
+        m_hAllocator,
+        m_hParentPool,
+        m_MemoryTypeIndex,
+        mem,
+        allocInfo.allocationSize,
+        m_NextBlockId++,
+        m_Algorithm,
+        m_BuddyMultipleRoots);
+
+    m_Blocks.push_back(pBlock);
+    if(pNewBlockIndex != VMA_NULL)
     {
-        // Item from the middle of 2nd vector.
-        VmaSuballocation refSuballoc;
-        refSuballoc.offset = offset;
-        // Rest of members stays uninitialized intentionally for better performance.
-        SuballocationVectorType::iterator it = m_2ndVectorMode == SECOND_VECTOR_RING_BUFFER ?
-            VmaBinaryFindSorted(suballocations2nd.begin(), suballocations2nd.end(), refSuballoc, VmaSuballocationOffsetLess()) :
-            VmaBinaryFindSorted(suballocations2nd.begin(), suballocations2nd.end(), refSuballoc, VmaSuballocationOffsetGreater());
-        if(it != suballocations2nd.end())
-        {
-            it->type = VMA_SUBALLOCATION_TYPE_FREE;
-            it->hAllocation = VK_NULL_HANDLE;
-            ++m_2ndNullItemsCount;
-            m_SumFreeSize += it->size;
-            CleanupAfterFree();
-            return;
-        }
+        *pNewBlockIndex = m_Blocks.size() - 1;
     }
+    RecalculateFragmentationScore();
 
-    VMA_ASSERT(0 && "Allocation to free not found in linear allocator!");
+    m_hAllocator->m_Counters.Add(
+        VmaAllocatorCounters::COUNTER_BLOCK_CREATE_COUNT, 1,
+        VmaAllocatorCounters::COUNTER_BLOCK_CREATE_BYTES, blockSize);
+    return VK_SUCCESS;
 }
 
-bool VmaBlockMetadata_Linear::ShouldCompact1st() const
+void VmaBlockVector::ApplyDefragmentationMovesCpu(
+    class VmaBlockVectorDefragmentationContext* pDefragCtx,
+    const VmaVector< VmaDefragmentationMove, VmaStlAllocator<VmaDefragmentationMove> >& moves)
 {
-    const size_t nullItemCount = m_1stNullItemsBeginCount + m_1stNullItemsMiddleCount;
-    const size_t suballocCount = AccessSuballocations1st().size();
-    return suballocCount > 32 && nullItemCount * 2 >= (suballocCount - nullItemCount) * 3;
-}
+    const size_t blockCount = m_Blocks.size();
+    const bool isNonCoherent = m_hAllocator->IsMemoryTypeNonCoherent(m_MemoryTypeIndex);
+
+    enum BLOCK_FLAG
+    {
+        BLOCK_FLAG_USED = 0x00000001,
+        BLOCK_FLAG_MAPPED_FOR_DEFRAGMENTATION = 0x00000002,
+    };
 
-void VmaBlockMetadata_Linear::CleanupAfterFree()
-{
-    SuballocationVectorType& suballocations1st = AccessSuballocations1st();
-    SuballocationVectorType& suballocations2nd = AccessSuballocations2nd();
+    struct BlockInfo
+    {
+        uint32_t flags;
+        void* pMappedData;
+    };
+    VmaVector< BlockInfo, VmaStlAllocator<BlockInfo> >
+        blockInfo(blockCount, BlockInfo(), VmaStlAllocator<BlockInfo>(m_hAllocator->GetAllocationCallbacks()));
+    memset(blockInfo.data(), 0, blockCount * sizeof(BlockInfo));
 
-    if(IsEmpty())
+    // Go over all moves. Mark blocks that are used with BLOCK_FLAG_USED.
+    const size_t moveCount = moves.size();
+    for(size_t moveIndex = 0; moveIndex < moveCount; ++moveIndex)
     {
-        suballocations1st.clear();
-        suballocations2nd.clear();
-        m_1stNullItemsBeginCount = 0;
-        m_1stNullItemsMiddleCount = 0;
-        m_2ndNullItemsCount = 0;
-        m_2ndVectorMode = SECOND_VECTOR_EMPTY;
+        const VmaDefragmentationMove& move = moves[moveIndex];
+        blockInfo[move.srcBlockIndex].flags |= BLOCK_FLAG_USED;
+        blockInfo[move.dstBlockIndex].flags |= BLOCK_FLAG_USED;
     }
-    else
-    {
-        const size_t suballoc1stCount = suballocations1st.size();
-        const size_t nullItem1stCount = m_1stNullItemsBeginCount + m_1stNullItemsMiddleCount;
-        VMA_ASSERT(nullItem1stCount <= suballoc1stCount);
 
-        // Find more null items at the beginning of 1st vector.
-        while(m_1stNullItemsBeginCount < suballoc1stCount &&
-            suballocations1st[m_1stNullItemsBeginCount].hAllocation == VK_NULL_HANDLE)
-        {
-            ++m_1stNullItemsBeginCount;
-            --m_1stNullItemsMiddleCount;
-        }
+    VMA_ASSERT(pDefragCtx->res == VK_SUCCESS);
 
-        // Find more null items at the end of 1st vector.
-        while(m_1stNullItemsMiddleCount > 0 &&
-            suballocations1st.back().hAllocation == VK_NULL_HANDLE)
+    // Go over all blocks. Get mapped pointer or map if necessary.
+    for(size_t blockIndex = 0; pDefragCtx->res == VK_SUCCESS && blockIndex < blockCount; ++blockIndex)
+    {
+        BlockInfo& currBlockInfo = blockInfo[blockIndex];
+        VmaDeviceMemoryBlock* pBlock = m_Blocks[blockIndex];
+        if((currBlockInfo.flags & BLOCK_FLAG_USED) != 0)
         {
-            --m_1stNullItemsMiddleCount;
-            suballocations1st.pop_back();
+            currBlockInfo.pMappedData = pBlock->GetMappedData();
+            // It is not originally mapped - map it.
+            if(currBlockInfo.pMappedData == VMA_NULL)
+            {
+                pDefragCtx->res = pBlock->Map(m_hAllocator, 1, &currBlockInfo.pMappedData);
+                if(pDefragCtx->res == VK_SUCCESS)
+                {
+                    currBlockInfo.flags |= BLOCK_FLAG_MAPPED_FOR_DEFRAGMENTATION;
+                }
+            }
         }
+    }
 
-        // Find more null items at the end of 2nd vector.
-        while(m_2ndNullItemsCount > 0 &&
-            suballocations2nd.back().hAllocation == VK_NULL_HANDLE)
-        {
-            --m_2ndNullItemsCount;
-            suballocations2nd.pop_back();
-        }
+    // Go over all moves. Do actual data transfer.
+    if(pDefragCtx->res == VK_SUCCESS)
+    {
+        const VkDeviceSize nonCoherentAtomSize = m_hAllocator->m_PhysicalDeviceProperties.limits.nonCoherentAtomSize;
+        VkMappedMemoryRange memRange = { VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE };
 
-        // Find more null items at the beginning of 2nd vector.
-        while(m_2ndNullItemsCount > 0 &&
-            suballocations2nd[0].hAllocation == VK_NULL_HANDLE)
+        for(size_t moveIndex = 0; moveIndex < moveCount; ++moveIndex)
         {
-            --m_2ndNullItemsCount;
-            VmaVectorRemove(suballocations2nd, 0);
-        }
+            const VmaDefragmentationMove& move = moves[moveIndex];
 
-        if(ShouldCompact1st())
-        {
-            const size_t nonNullItemCount = suballoc1stCount - nullItem1stCount;
-            size_t srcIndex = m_1stNullItemsBeginCount;
-            for(size_t dstIndex = 0; dstIndex < nonNullItemCount; ++dstIndex)
+            const BlockInfo& srcBlockInfo = blockInfo[move.srcBlockIndex];
+            const BlockInfo& dstBlockInfo = blockInfo[move.dstBlockIndex];
+
+            VMA_ASSERT(srcBlockInfo.pMappedData && dstBlockInfo.pMappedData);
+
+            // Invalidate source.
+            if(isNonCoherent)
             {
-                while(suballocations1st[srcIndex].hAllocation == VK_NULL_HANDLE)
-                {
-                    ++srcIndex;
-                }
-                if(dstIndex != srcIndex)
-                {
-                    suballocations1st[dstIndex] = suballocations1st[srcIndex];
-                }
-                ++srcIndex;
+                VmaDeviceMemoryBlock* const pSrcBlock = m_Blocks[move.srcBlockIndex];
+                memRange.memory = pSrcBlock->GetDeviceMemory();
+                memRange.offset = VmaAlignDown(move.srcOffset, nonCoherentAtomSize);
+                memRange.size = VMA_MIN(
+                    VmaAlignUp(move.size + (move.srcOffset - memRange.offset), nonCoherentAtomSize),
+                    pSrcBlock->m_pMetadata->GetSize() - memRange.offset);
+                (*m_hAllocator->GetVulkanFunctions().vkInvalidateMappedMemoryRanges)(m_hAllocator->m_hDevice, 1, &memRange);
             }
-            suballocations1st.resize(nonNullItemCount);
-            m_1stNullItemsBeginCount = 0;
-            m_1stNullItemsMiddleCount = 0;
-        }
 
-        // 2nd vector became empty.
-        if(suballocations2nd.empty())
-        {
-            m_2ndVectorMode = SECOND_VECTOR_EMPTY;
-        }
+            // THE PLACE WHERE ACTUAL DATA COPY HAPPENS.
+            memmove(
+                reinterpret_cast<char*>(dstBlockInfo.pMappedData) + move.dstOffset,
+                reinterpret_cast<char*>(srcBlockInfo.pMappedData) + move.srcOffset,
+                static_cast<size_t>(move.size));
 
-        // 1st vector became empty.
-        if(suballocations1st.size() - m_1stNullItemsBeginCount == 0)
-        {
-            suballocations1st.clear();
-            m_1stNullItemsBeginCount = 0;
+            if(IsCorruptionDetectionEnabled())
+            {
+                VmaWriteMagicValue(dstBlockInfo.pMappedData, move.dstOffset - VMA_DEBUG_MARGIN);
+                VmaWriteMagicValue(dstBlockInfo.pMappedData, move.dstOffset + move.size);
+            }
 
-            if(!suballocations2nd.empty() && m_2ndVectorMode == SECOND_VECTOR_RING_BUFFER)
+            // Flush destination.
+            if(isNonCoherent)
             {
-                // Swap 1st with 2nd. Now 2nd is empty.
-                m_2ndVectorMode = SECOND_VECTOR_EMPTY;
-                m_1stNullItemsMiddleCount = m_2ndNullItemsCount;
-                while(m_1stNullItemsBeginCount < suballocations2nd.size() &&
-                    suballocations2nd[m_1stNullItemsBeginCount].hAllocation == VK_NULL_HANDLE)
-                {
-                    ++m_1stNullItemsBeginCount;
-                    --m_1stNullItemsMiddleCount;
-                }
-                m_2ndNullItemsCount = 0;
-                m_1stVectorIndex ^= 1;
+                VmaDeviceMemoryBlock* const pDstBlock = m_Blocks[move.dstBlockIndex];
+                memRange.memory = pDstBlock->GetDeviceMemory();
+                memRange.offset = VmaAlignDown(move.dstOffset, nonCoherentAtomSize);
+                memRange.size = VMA_MIN(
+                    VmaAlignUp(move.size + (move.dstOffset - memRange.offset), nonCoherentAtomSize),
+                    pDstBlock->m_pMetadata->GetSize() - memRange.offset);
+                (*m_hAllocator->GetVulkanFunctions().vkFlushMappedMemoryRanges)(m_hAllocator->m_hDevice, 1, &memRange);
             }
         }
     }
 
-    VMA_HEAVY_ASSERT(Validate());
+    // Go over all blocks in reverse order. Unmap those that were mapped just for defragmentation.
+    // Regardless of pCtx->res == VK_SUCCESS.
+    for(size_t blockIndex = blockCount; blockIndex--; )
+    {
+        const BlockInfo& currBlockInfo = blockInfo[blockIndex];
+        if((currBlockInfo.flags & BLOCK_FLAG_MAPPED_FOR_DEFRAGMENTATION) != 0)
+        {
+            VmaDeviceMemoryBlock* pBlock = m_Blocks[blockIndex];
+            pBlock->Unmap(m_hAllocator, 1);
+        }
+    }
 }
 
-
-////////////////////////////////////////////////////////////////////////////////
-// class VmaBlockMetadata_Buddy
-
-VmaBlockMetadata_Buddy::VmaBlockMetadata_Buddy(VmaAllocator hAllocator) :
-    VmaBlockMetadata(hAllocator),
-    m_Root(VMA_NULL),
-    m_AllocationCount(0),
-    m_FreeCount(1),
-    m_SumFreeSize(0)
+void VmaBlockVector::ApplyDefragmentationMovesGpu(
+    class VmaBlockVectorDefragmentationContext* pDefragCtx,
+    const VmaVector< VmaDefragmentationMove, VmaStlAllocator<VmaDefragmentationMove> >& moves,
+    VkCommandBuffer commandBuffer)
 {
-    memset(m_FreeList, 0, sizeof(m_FreeList));
-}
+    const size_t blockCount = m_Blocks.size();
 
-VmaBlockMetadata_Buddy::~VmaBlockMetadata_Buddy()
-{
-    DeleteNode(m_Root);
-}
+    pDefragCtx->blockContexts.resize(blockCount);
+    memset(pDefragCtx->blockContexts.data(), 0, blockCount * sizeof(VmaBlockDefragmentationContext));
 
-void VmaBlockMetadata_Buddy::Init(VkDeviceSize size)
-{
-    VmaBlockMetadata::Init(size);
+    // Go over all moves. Mark blocks that are used with BLOCK_FLAG_USED.
+    const size_t moveCount = moves.size();
+    for(size_t moveIndex = 0; moveIndex < moveCount; ++moveIndex)
+    {
+        const VmaDefragmentationMove& move = moves[moveIndex];
+        pDefragCtx->blockContexts[move.srcBlockIndex].flags |= VmaBlockDefragmentationContext::BLOCK_FLAG_USED;
+        pDefragCtx->blockContexts[move.dstBlockIndex].flags |= VmaBlockDefragmentationContext::BLOCK_FLAG_USED;
+    }
 
-    m_UsableSize = VmaPrevPow2(size);
-    m_SumFreeSize = m_UsableSize;
+    VMA_ASSERT(pDefragCtx->res == VK_SUCCESS);
 
-    // Calculate m_LevelCount.
-    m_LevelCount = 1;
-    while(m_LevelCount < MAX_LEVELS &&
-        LevelToNodeSize(m_LevelCount) >= MIN_NODE_SIZE)
+    // Go over all blocks. Create and bind buffer for whole block if necessary.
     {
-        ++m_LevelCount;
+        VkBufferCreateInfo bufCreateInfo;
+        VmaFillGpuDefragmentationBufferCreateInfo(bufCreateInfo);
+
+        for(size_t blockIndex = 0; pDefragCtx->res == VK_SUCCESS && blockIndex < blockCount; ++blockIndex)
+        {
+            VmaBlockDefragmentationContext& currBlockCtx = pDefragCtx->blockContexts[blockIndex];
+            VmaDeviceMemoryBlock* pBlock = m_Blocks[blockIndex];
+            if((currBlockCtx.flags & VmaBlockDefragmentationContext::BLOCK_FLAG_USED) != 0)
+            {
+                bufCreateInfo.size = pBlock->m_pMetadata->GetSize();
+                pDefragCtx->res = (*m_hAllocator->GetVulkanFunctions().vkCreateBuffer)(
+                    m_hAllocator->m_hDevice, &bufCreateInfo, m_hAllocator->GetAllocationCallbacks(), &currBlockCtx.hBuffer);
+                if(pDefragCtx->res == VK_SUCCESS)
+                {
+                    pDefragCtx->res = (*m_hAllocator->GetVulkanFunctions().vkBindBufferMemory)(
+                        m_hAllocator->m_hDevice, currBlockCtx.hBuffer, pBlock->GetDeviceMemory(), 0);
+                }
+            }
+        }
     }
 
-    Node* rootNode = vma_new(GetAllocationCallbacks(), Node)();
-    rootNode->offset = 0;
-    rootNode->type = Node::TYPE_FREE;
-    rootNode->parent = VMA_NULL;
-    rootNode->buddy = VMA_NULL;
+    // Go over all moves. Post data transfer commands to command buffer.
+    if(pDefragCtx->res == VK_SUCCESS)
+    {
+        for(size_t moveIndex = 0; moveIndex < moveCount; ++moveIndex)
+        {
+            const VmaDefragmentationMove& move = moves[moveIndex];
 
-    m_Root = rootNode;
-    AddToFreeListFront(0, rootNode);
-}
+            const VmaBlockDefragmentationContext& srcBlockCtx = pDefragCtx->blockContexts[move.srcBlockIndex];
+            const VmaBlockDefragmentationContext& dstBlockCtx = pDefragCtx->blockContexts[move.dstBlockIndex];
 
-bool VmaBlockMetadata_Buddy::Validate() const
-{
-    // Validate tree.
-    ValidationContext ctx;
-    if(!ValidateNode(ctx, VMA_NULL, m_Root, 0, LevelToNodeSize(0)))
-    {
-        VMA_VALIDATE(false && "ValidateNode failed.");
+            VMA_ASSERT(srcBlockCtx.hBuffer && dstBlockCtx.hBuffer);
+
+            VkBufferCopy region = {
+                move.srcOffset,
+                move.dstOffset,
+                move.size };
+            (*m_hAllocator->GetVulkanFunctions().vkCmdCopyBuffer)(
+                commandBuffer, srcBlockCtx.hBuffer, dstBlockCtx.hBuffer, 1, &region);
+        }
     }
-    VMA_VALIDATE(m_AllocationCount == ctx.calculatedAllocationCount);
-    VMA_VALIDATE(m_SumFreeSize == ctx.calculatedSumFreeSize);
 
-    // Validate free node lists.
-    for(uint32_t level = 0; level < m_LevelCount; ++level)
+    // Save buffers to defrag context for later destruction.
+    if(pDefragCtx->res == VK_SUCCESS && moveCount > 0)
     {
-        VMA_VALIDATE(m_FreeList[level].front == VMA_NULL ||
-            m_FreeList[level].front->free.prev == VMA_NULL);
+        pDefragCtx->res = VK_NOT_READY;
+    }
+}
 
-        for(Node* node = m_FreeList[level].front;
-            node != VMA_NULL;
-            node = node->free.next)
+void VmaBlockVector::FreeEmptyBlocks(VmaDefragmentationStats* pDefragmentationStats)
+{
+    m_HasEmptyBlock = false;
+    for(size_t blockIndex = m_Blocks.size(); blockIndex--; )
+    {
+        VmaDeviceMemoryBlock* pBlock = m_Blocks[blockIndex];
+        if(pBlock->m_pMetadata->IsEmpty())
         {
-            VMA_VALIDATE(node->type == Node::TYPE_FREE);
-            
-            if(node->free.next == VMA_NULL)
+            if(m_Blocks.size() > m_MinBlockCount)
             {
-                VMA_VALIDATE(m_FreeList[level].back == node);
+                if(pDefragmentationStats != VMA_NULL)
+                {
+                    ++pDefragmentationStats->deviceMemoryBlocksFreed;
+                    pDefragmentationStats->bytesFreed += pBlock->m_pMetadata->GetSize();
+                }
+
+                VmaVectorRemove(m_Blocks, blockIndex);
+                pBlock->Destroy(m_hAllocator);
+                vma_delete(m_hAllocator, pBlock);
             }
             else
             {
-                VMA_VALIDATE(node->free.next->free.prev == node);
+                m_HasEmptyBlock = true;
             }
         }
     }
-
-    // Validate that free lists ar higher levels are empty.
-    for(uint32_t level = m_LevelCount; level < MAX_LEVELS; ++level)
-    {
-        VMA_VALIDATE(m_FreeList[level].front == VMA_NULL && m_FreeList[level].back == VMA_NULL);
-    }
-
-    return true;
 }
 
-VkDeviceSize VmaBlockMetadata_Buddy::GetUnusedRangeSizeMax() const
+#if VMA_STATS_STRING_ENABLED
+
+// Writes histograms as object members. Keys are lower bounds of non-empty buckets. Nothing is written for empty histogram.
+static void VmaPrintAllocationHistograms(VmaJsonWriter& json, const VmaAllocationHistograms& histograms)
 {
-    for(uint32_t level = 0; level < m_LevelCount; ++level)
+    bool started = false;
+    for(uint32_t i = 0; i < VMA_SIZE_HISTOGRAM_BUCKET_COUNT; ++i)
     {
-        if(m_FreeList[level].front != VMA_NULL)
+        if(histograms.allocationSize[i] > 0)
         {
-            return LevelToNodeSize(level);
+            if(!started)
+            {
+                json.WriteString("AllocationSizeHistogram");
+                json.BeginObject(true);
+                started = true;
+            }
+            json.BeginString();
+            json.ContinueString((uint64_t)1 << i);
+            json.EndString();
+            json.WriteNumber(histograms.allocationSize[i]);
         }
     }
-    return 0;
-}
-
-void VmaBlockMetadata_Buddy::CalcAllocationStatInfo(VmaStatInfo& outInfo) const
-{
-    const VkDeviceSize unusableSize = GetUnusableSize();
-
-    outInfo.blockCount = 1;
-
-    outInfo.allocationCount = outInfo.unusedRangeCount = 0;
-    outInfo.usedBytes = outInfo.unusedBytes = 0;
-
-    outInfo.allocationSizeMax = outInfo.unusedRangeSizeMax = 0;
-    outInfo.allocationSizeMin = outInfo.unusedRangeSizeMin = UINT64_MAX;
-    outInfo.allocationSizeAvg = outInfo.unusedRangeSizeAvg = 0; // Unused.
-
-    CalcAllocationStatInfoNode(outInfo, m_Root, LevelToNodeSize(0));
-
-    if(unusableSize > 0)
+    if(started)
     {
-        ++outInfo.unusedRangeCount;
-        outInfo.unusedBytes += unusableSize;
-        outInfo.unusedRangeSizeMax = VMA_MAX(outInfo.unusedRangeSizeMax, unusableSize);
-        outInfo.unusedRangeSizeMin = VMA_MIN(outInfo.unusedRangeSizeMin, unusableSize);
+        json.EndObject();
     }
-}
-
-void VmaBlockMetadata_Buddy::AddPoolStats(VmaPoolStats& inoutStats) const
-{
-    const VkDeviceSize unusableSize = GetUnusableSize();
-
-    inoutStats.size += GetSize();
-    inoutStats.unusedSize += m_SumFreeSize + unusableSize;
-    inoutStats.allocationCount += m_AllocationCount;
-    inoutStats.unusedRangeCount += m_FreeCount;
-    inoutStats.unusedRangeSizeMax = VMA_MAX(inoutStats.unusedRangeSizeMax, GetUnusedRangeSizeMax());
 
-    if(unusableSize > 0)
+    started = false;
+    for(uint32_t i = 0; i < VMA_LIFETIME_HISTOGRAM_BUCKET_COUNT; ++i)
     {
-        ++inoutStats.unusedRangeCount;
-        // Not updating inoutStats.unusedRangeSizeMax with unusableSize because this space is not available for allocations.
+        if(histograms.allocationLifetime[i] > 0)
+        {
+            if(!started)
+            {
+                json.WriteString("AllocationLifetimeHistogram");
+                json.BeginObject(true);
+                started = true;
+            }
+            json.BeginString();
+            json.ContinueString(i > 0 ? (uint64_t)1 << (i - 1) : (uint64_t)0);
+            json.EndString();
+            json.WriteNumber(histograms.allocationLifetime[i]);
+        }
+    }
+    if(started)
+    {
+        json.EndObject();
     }
 }
 
-#if VMA_STATS_STRING_ENABLED
-
-void VmaBlockMetadata_Buddy::PrintDetailedMap(class VmaJsonWriter& json) const
+void VmaBlockVector::PrintDetailedMap(class VmaJsonWriter& json)
 {
-    // TODO optimize
-    VmaStatInfo stat;
-    CalcAllocationStatInfo(stat);
-
-    PrintDetailedMap_Begin(
-        json,
-        stat.unusedBytes,
-        stat.allocationCount,
-        stat.unusedRangeCount);
+    VmaMutexLockRead lock(m_Mutex, m_hAllocator->m_UseMutex);
 
-    PrintDetailedMapNode(json, m_Root, LevelToNodeSize(0));
+    json.BeginObject();
 
-    const VkDeviceSize unusableSize = GetUnusableSize();
-    if(unusableSize > 0)
+    if(m_IsCustomPool)
     {
-        PrintDetailedMap_UnusedRange(json,
-            m_UsableSize, // offset
-            unusableSize); // size
-    }
+        json.WriteString("MemoryTypeIndex");
+        json.WriteNumber(m_MemoryTypeIndex);
 
-    PrintDetailedMap_End(json);
-}
+        json.WriteString("BlockSize");
+        json.WriteNumber(m_PreferredBlockSize);
 
-#endif // #if VMA_STATS_STRING_ENABLED
+        json.WriteString("BlockCount");
+        json.BeginObject(true);
+        if(m_MinBlockCount > 0)
+        {
+            json.WriteString("Min");
+            json.WriteNumber((uint64_t)m_MinBlockCount);
+        }
+        if(m_MaxBlockCount < SIZE_MAX)
+        {
+            json.WriteString("Max");
+            json.WriteNumber((uint64_t)m_MaxBlockCount);
+        }
+        json.WriteString("Cur");
+        json.WriteNumber((uint64_t)m_Blocks.size());
+        json.EndObject();
 
-bool VmaBlockMetadata_Buddy::CreateAllocationRequest(
-    uint32_t currentFrameIndex,
-    uint32_t frameInUseCount,
-    VkDeviceSize bufferImageGranularity,
-    VkDeviceSize allocSize,
-    VkDeviceSize allocAlignment,
-    bool upperAddress,
-    VmaSuballocationType allocType,
-    bool canMakeOtherLost,
-    uint32_t strategy,
-    VmaAllocationRequest* pAllocationRequest)
-{
-    VMA_ASSERT(!upperAddress && "VMA_ALLOCATION_CREATE_UPPER_ADDRESS_BIT can be used only with linear algorithm.");
+        if(m_FrameInUseCount > 0)
+        {
+            json.WriteString("FrameInUseCount");
+            json.WriteNumber(m_FrameInUseCount);
+        }
 
-    // Simple way to respect bufferImageGranularity. May be optimized some day.
-    // Whenever it might be an OPTIMAL image...
-    if(allocType == VMA_SUBALLOCATION_TYPE_UNKNOWN ||
-        allocType == VMA_SUBALLOCATION_TYPE_IMAGE_UNKNOWN ||
-        allocType == VMA_SUBALLOCATION_TYPE_IMAGE_OPTIMAL)
-    {
-        allocAlignment = VMA_MAX(allocAlignment, bufferImageGranularity);
-        allocSize = VMA_MAX(allocSize, bufferImageGranularity);
+        if(m_Algorithm != 0)
+        {
+            json.WriteString("Algorithm");
+            json.WriteString(VmaAlgorithmToStr(m_Algorithm));
+        }
     }
-
-    if(allocSize > m_UsableSize)
+    else
     {
-        return false;
+        json.WriteString("PreferredBlockSize");
+        json.WriteNumber(m_PreferredBlockSize);
     }
 
-    const uint32_t targetLevel = AllocSizeToLevel(allocSize);
-    for(uint32_t level = targetLevel + 1; level--; )
+    VmaPrintAllocationHistograms(json, m_Histograms);
+
+    json.WriteString("Blocks");
+    json.BeginObject();
+    for(size_t i = 0; i < m_Blocks.size(); ++i)
     {
-        for(Node* freeNode = m_FreeList[level].front;
-            freeNode != VMA_NULL;
-            freeNode = freeNode->free.next)
-        {
-            if(freeNode->offset % allocAlignment == 0)
-            {
-                pAllocationRequest->type = VmaAllocationRequestType::Normal;
-                pAllocationRequest->offset = freeNode->offset;
-                pAllocationRequest->sumFreeSize = LevelToNodeSize(level);
-                pAllocationRequest->sumItemSize = 0;
-                pAllocationRequest->itemsToMakeLostCount = 0;
-                pAllocationRequest->customData = (void*)(uintptr_t)level;
-                return true;
-            }
-        }
-    }
+        json.BeginString();
+        json.ContinueString(m_Blocks[i]->GetId());
+        json.EndString();
 
-    return false;
-}
+        m_Blocks[i]->m_pMetadata->PrintDetailedMap(json);
+    }
+    json.EndObject();
 
-bool VmaBlockMetadata_Buddy::MakeRequestedAllocationsLost(
-    uint32_t currentFrameIndex,
-    uint32_t frameInUseCount,
-    VmaAllocationRequest* pAllocationRequest)
-{
-    /*
-    Lost allocations are not supported in buddy allocator at the moment.
-    Support might be added in the future.
-    */
-    return pAllocationRequest->itemsToMakeLostCount == 0;
+    json.EndObject();
 }
 
-uint32_t VmaBlockMetadata_Buddy::MakeAllocationsLost(uint32_t currentFrameIndex, uint32_t frameInUseCount)
+void VmaBlockVector::WriteBinaryStats(VmaBinaryStatsWriter& writer, uint32_t poolId)
 {
-    /*
-    Lost allocations are not supported in buddy allocator at the moment.
-    Support might be added in the future.
-    */
-    return 0;
-}
+    VmaMutexLockRead lock(m_Mutex, m_hAllocator->m_UseMutex);
 
-void VmaBlockMetadata_Buddy::Alloc(
-    const VmaAllocationRequest& request,
-    VmaSuballocationType type,
-    VkDeviceSize allocSize,
-    VmaAllocation hAllocation)
-{
-    VMA_ASSERT(request.type == VmaAllocationRequestType::Normal);
+    writer.WriteBlockVector(
+        m_IsCustomPool,
+        poolId,
+        m_MemoryTypeIndex,
+        m_PreferredBlockSize,
+        m_MinBlockCount,
+        m_MaxBlockCount,
+        m_FrameInUseCount,
+        m_Algorithm);
+    writer.WriteAllocationHistograms(m_Histograms);
 
-    const uint32_t targetLevel = AllocSizeToLevel(allocSize);
-    uint32_t currLevel = (uint32_t)(uintptr_t)request.customData;
-    
-    Node* currNode = m_FreeList[currLevel].front;
-    VMA_ASSERT(currNode != VMA_NULL && currNode->type == Node::TYPE_FREE);
-    while(currNode->offset != request.offset)
+    for(size_t i = 0; i < m_Blocks.size(); ++i)
     {
-        currNode = currNode->free.next;
-        VMA_ASSERT(currNode != VMA_NULL && currNode->type == Node::TYPE_FREE);
+        writer.SetBlockId(m_Blocks[i]->GetId());
+        m_Blocks[i]->m_pMetadata->VisitDetailedMap(writer);
     }
-    
-    // Go down, splitting free nodes.
-    while(currLevel < targetLevel)
-    {
-        // currNode is already first free node at currLevel.
-        // Remove it from list of free nodes at this currLevel.
-        RemoveFromFreeList(currLevel, currNode);
-         
-        const uint32_t childrenLevel = currLevel + 1;
-
-        // Create two free sub-nodes.
-        Node* leftChild = vma_new(GetAllocationCallbacks(), Node)();
-        Node* rightChild = vma_new(GetAllocationCallbacks(), Node)();
-
-        leftChild->offset = currNode->offset;
-        leftChild->type = Node::TYPE_FREE;
-        leftChild->parent = currNode;
-        leftChild->buddy = rightChild;
-
-        rightChild->offset = currNode->offset + LevelToNodeSize(childrenLevel);
-        rightChild->type = Node::TYPE_FREE;
-        rightChild->parent = currNode;
-        rightChild->buddy = leftChild;
-
-        // Convert current currNode to split type.
-        currNode->type = Node::TYPE_SPLIT;
-        currNode->split.leftChild = leftChild;
-
-        // Add child nodes to free list. Order is important!
-        AddToFreeListFront(childrenLevel, rightChild);
-        AddToFreeListFront(childrenLevel, leftChild);
-
-        ++m_FreeCount;
-        //m_SumFreeSize -= LevelToNodeSize(currLevel) % 2; // Useful only when level node sizes can be non power of 2.
-        ++currLevel;
-        currNode = m_FreeList[currLevel].front;
+}
 
-        /*
-        We can be sure that currNode, as left child of node previously split,
-        also fullfills the alignment requirement.
-        */
-    }
+void VmaBlockVector::AddToStatsSnapshot(VmaStatsSnapshotBuilder& builder, uint32_t poolId)
+{
+    VmaMutexLockRead lock(m_Mutex, m_hAllocator->m_UseMutex);
 
-    // Remove from free list.
-    VMA_ASSERT(currLevel == targetLevel &&
-        currNode != VMA_NULL &&
-        currNode->type == Node::TYPE_FREE);
-    RemoveFromFreeList(currLevel, currNode);
+    VmaStatsDelta poolStats = {};
+    for(size_t i = 0; i < m_Blocks.size(); ++i)
+    {
+        const VmaDeviceMemoryBlock* const pBlock = m_Blocks[i];
+        const VmaBlockMetadata* const pMetadata = pBlock->m_pMetadata;
+        const VkDeviceSize unusedBytes = pMetadata->GetSumFreeSize();
 
-    // Convert to allocation node.
-    currNode->type = Node::TYPE_ALLOCATION;
-    currNode->allocation.alloc = hAllocation;
+        VmaBlockSnapshot block = {};
+        block.memoryTypeIndex = m_MemoryTypeIndex;
+        block.isCustomPool = m_IsCustomPool ? VK_TRUE : VK_FALSE;
+        block.poolId = m_IsCustomPool ? poolId : 0;
+        block.blockId = pBlock->GetId();
+        block.size = pMetadata->GetSize();
+        block.allocationCount = (uint32_t)pMetadata->GetAllocationCount();
+        block.usedBytes = block.size - unusedBytes;
+        builder.AddBlock(block);
 
-    ++m_AllocationCount;
-    --m_FreeCount;
-    m_SumFreeSize -= allocSize;
+        ++poolStats.blockCount;
+        poolStats.allocationCount += block.allocationCount;
+        poolStats.usedBytes += (int64_t)block.usedBytes;
+        poolStats.unusedBytes += (int64_t)unusedBytes;
+
+        if(builder.CapturesAllocations())
+        {
+            builder.SetCurrentBlock(m_MemoryTypeIndex, pBlock->GetDeviceMemory());
+            pMetadata->VisitDetailedMap(builder);
+        }
+    }
+    builder.AddPool(m_MemoryTypeIndex, m_IsCustomPool, poolId, poolStats);
 }
 
-void VmaBlockMetadata_Buddy::DeleteNode(Node* node)
+#if VMA_RECORDING_ENABLED
+
+/*
+Passes allocations of memory blocks to VmaRecorder::DescribeAllocation().
+
+In pools with linear algorithm they are collected first and described in order of
+frames in which they were made, which vmaFreePoolAllocations() depends on. Blocks are
+visited in order of offsets, which differs from it in a ring buffer. Allocations
+without VmaAllocation object exist only there.
+*/
+class VmaLiveAllocationVisitor : public VmaDetailedMapVisitor
 {
-    if(node->type == Node::TYPE_SPLIT)
+    VMA_CLASS_NO_COPY(VmaLiveAllocationVisitor)
+public:
+    VmaLiveAllocationVisitor(VmaRecorder& recorder, uint32_t frameIndex, VmaPool hPool, uint32_t memoryTypeIndex, bool linear,
+        const VkAllocationCallbacks* pAllocationCallbacks) :
+        m_Recorder(recorder),
+        m_FrameIndex(frameIndex),
+        m_hPool(hPool),
+        m_MemoryTypeIndex(memoryTypeIndex),
+        m_Linear(linear),
+        m_Entries(VmaStlAllocator<Entry>(pAllocationCallbacks))
     {
-        DeleteNode(node->split.leftChild->buddy);
-        DeleteNode(node->split.leftChild);
     }
 
-    vma_delete(GetAllocationCallbacks(), node);
-}
+    virtual void BeginBlock(
+        VkDeviceSize blockSize,
+        VkDeviceSize unusedBytes,
+        size_t allocationCount,
+        size_t unusedRangeCount) { }
+    virtual void Allocation(
+        VkDeviceSize offset,
+        VmaAllocation hAllocation)
+    {
+        if(m_Linear)
+        {
+            const Entry entry = { hAllocation->GetCreationFrameIndex(), m_Entries.size(), hAllocation, VMA_NULL };
+            m_Entries.push_back(entry);
+        }
+        else
+        {
+            m_Recorder.DescribeAllocation(m_FrameIndex, hAllocation, UINT64_MAX);
+        }
+    }
+    virtual void HandlelessAllocation(
+        const VmaSuballocation& suballoc)
+    {
+        VMA_ASSERT(m_Linear);
+        const Entry entry = { suballoc.frameIndex, m_Entries.size(), VK_NULL_HANDLE, &suballoc };
+        m_Entries.push_back(entry);
+    }
+    virtual void UnusedRange(
+        VkDeviceSize offset,
+        VkDeviceSize size) { }
+    virtual void EndBlock() { }
 
-bool VmaBlockMetadata_Buddy::ValidateNode(ValidationContext& ctx, const Node* parent, const Node* curr, uint32_t level, VkDeviceSize levelNodeSize) const
-{
-    VMA_VALIDATE(level < m_LevelCount);
-    VMA_VALIDATE(curr->parent == parent);
-    VMA_VALIDATE((curr->buddy == VMA_NULL) == (parent == VMA_NULL));
-    VMA_VALIDATE(curr->buddy == VMA_NULL || curr->buddy->buddy == curr);
-    switch(curr->type)
+    // Describes allocations collected from a pool with linear algorithm.
+    void DescribeCollected()
     {
-    case Node::TYPE_FREE:
-        // curr->free.prev, next are validated separately.
-        ctx.calculatedSumFreeSize += levelNodeSize;
-        ++ctx.calculatedFreeCount;
-        break;
-    case Node::TYPE_ALLOCATION:
-        ++ctx.calculatedAllocationCount;
-        ctx.calculatedSumFreeSize += levelNodeSize - curr->allocation.alloc->GetSize();
-        VMA_VALIDATE(curr->allocation.alloc != VK_NULL_HANDLE);
-        break;
-    case Node::TYPE_SPLIT:
+        VMA_SORT(m_Entries.begin(), m_Entries.end(), EntryLess());
+        for(size_t i = 0; i < m_Entries.size(); ++i)
         {
-            const uint32_t childrenLevel = level + 1;
-            const VkDeviceSize childrenLevelNodeSize = levelNodeSize / 2;
-            const Node* const leftChild = curr->split.leftChild;
-            VMA_VALIDATE(leftChild != VMA_NULL);
-            VMA_VALIDATE(leftChild->offset == curr->offset);
-            if(!ValidateNode(ctx, curr, leftChild, childrenLevel, childrenLevelNodeSize))
+            const Entry& entry = m_Entries[i];
+            if(entry.hAllocation != VK_NULL_HANDLE)
             {
-                VMA_VALIDATE(false && "ValidateNode for left child failed.");
+                m_Recorder.DescribeAllocation(entry.frameIndex, entry.hAllocation, UINT64_MAX);
             }
-            const Node* const rightChild = leftChild->buddy;
-            VMA_VALIDATE(rightChild->offset == curr->offset + childrenLevelNodeSize);
-            if(!ValidateNode(ctx, curr, rightChild, childrenLevel, childrenLevelNodeSize))
+            else
             {
-                VMA_VALIDATE(false && "ValidateNode for right child failed.");
+                m_Recorder.DescribeHandlelessAllocation(m_hPool, m_MemoryTypeIndex, *entry.pSuballoc, UINT64_MAX);
             }
         }
-        break;
-    default:
-        return false;
     }
 
-    return true;
-}
+private:
+    struct Entry
+    {
+        uint32_t frameIndex;
+        // Order of visiting, to keep it among allocations made in the same frame.
+        size_t order;
+        VmaAllocation hAllocation;
+        // For allocation without VmaAllocation object. Valid as long as the block vector is locked.
+        const VmaSuballocation* pSuballoc;
+    };
+    struct EntryLess
+    {
+        bool operator()(const Entry& lhs, const Entry& rhs) const
+        {
+            return lhs.frameIndex != rhs.frameIndex ? lhs.frameIndex < rhs.frameIndex : lhs.order < rhs.order;
+        }
+    };
 
-uint32_t VmaBlockMetadata_Buddy::AllocSizeToLevel(VkDeviceSize allocSize) const
+    VmaRecorder& m_Recorder;
+    const uint32_t m_FrameIndex;
+    const VmaPool m_hPool;
+    const uint32_t m_MemoryTypeIndex;
+    const bool m_Linear;
+    VmaVector< Entry, VmaStlAllocator<Entry> > m_Entries;
+};
+
+void VmaBlockVector::RecordLiveObjects(VmaRecorder& recorder, uint32_t frameIndex)
 {
-    // I know this could be optimized somehow e.g. by using std::log2p1 from C++20.
-    uint32_t level = 0;
-    VkDeviceSize currLevelNodeSize = m_UsableSize;
-    VkDeviceSize nextLevelNodeSize = currLevelNodeSize >> 1;
-    while(allocSize <= nextLevelNodeSize && level + 1 < m_LevelCount)
+    VmaMutexLockRead lock(m_Mutex, m_hAllocator->m_UseMutex);
+
+    if(m_IsCustomPool)
     {
-        ++level;
-        currLevelNodeSize = nextLevelNodeSize;
-        nextLevelNodeSize = currLevelNodeSize >> 1;
+        recorder.DescribePool(frameIndex, m_hParentPool, UINT64_MAX);
+    }
+
+    const bool linear = m_Algorithm == VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT;
+    VmaLiveAllocationVisitor visitor(recorder, frameIndex, m_hParentPool, m_MemoryTypeIndex, linear,
+        m_hAllocator->GetAllocationCallbacks());
+    for(size_t i = 0; i < m_Blocks.size(); ++i)
+    {
+        m_Blocks[i]->m_pMetadata->VisitDetailedMap(visitor);
+    }
+    if(linear)
+    {
+        visitor.DescribeCollected();
     }
-    return level;
 }
 
-void VmaBlockMetadata_Buddy::FreeAtOffset(VmaAllocation alloc, VkDeviceSize offset)
+#endif // #if VMA_RECORDING_ENABLED
+
+#endif // #if VMA_STATS_STRING_ENABLED
+
+#if VMA_RECORDING_ENABLED
+
+void VmaBlockVector::GetPoolCreateInfo(VmaPoolCreateInfo& outCreateInfo) const
 {
-    // Find node and level.
-    Node* node = m_Root;
-    VkDeviceSize nodeOffset = 0;
-    uint32_t level = 0;
-    VkDeviceSize levelNodeSize = LevelToNodeSize(0);
-    while(node->type == Node::TYPE_SPLIT)
+    VMA_ASSERT(m_IsCustomPool);
+    outCreateInfo = VmaPoolCreateInfo();
+    outCreateInfo.memoryTypeIndex = m_MemoryTypeIndex;
+    outCreateInfo.flags = m_Algorithm;
+    if(m_BuddyMultipleRoots)
     {
-        const VkDeviceSize nextLevelSize = levelNodeSize >> 1;
-        if(offset < nodeOffset + nextLevelSize)
-        {
-            node = node->split.leftChild;
-        }
-        else
-        {
-            node = node->split.leftChild->buddy;
-            nodeOffset += nextLevelSize;
-        }
-        ++level;
-        levelNodeSize = nextLevelSize;
+        outCreateInfo.flags |= VMA_POOL_CREATE_BUDDY_MULTIPLE_ROOTS_BIT;
     }
+    if(m_BufferImageGranularity != m_hAllocator->GetBufferImageGranularity())
+    {
+        outCreateInfo.flags |= VMA_POOL_CREATE_IGNORE_BUFFER_IMAGE_GRANULARITY_BIT;
+    }
+    outCreateInfo.blockSize = m_ExplicitBlockSize ? m_PreferredBlockSize : 0;
+    outCreateInfo.minBlockCount = m_MinBlockCount;
+    // vmaCreatePool() replaces 0 with SIZE_MAX.
+    outCreateInfo.maxBlockCount = m_MaxBlockCount != SIZE_MAX ? m_MaxBlockCount : 0;
+    outCreateInfo.frameInUseCount = m_FrameInUseCount;
+}
 
-    VMA_ASSERT(node != VMA_NULL && node->type == Node::TYPE_ALLOCATION);
-    VMA_ASSERT(alloc == VK_NULL_HANDLE || node->allocation.alloc == alloc);
+#endif // #if VMA_RECORDING_ENABLED
 
-    ++m_FreeCount;
-    --m_AllocationCount;
-    m_SumFreeSize += alloc->GetSize();
+bool VmaBlockVector::ChooseDefragmentationMethod(
+    VkDeviceSize maxCpuBytesToMove, uint32_t maxCpuAllocationsToMove,
+    VkDeviceSize maxGpuBytesToMove, uint32_t maxGpuAllocationsToMove,
+    bool& outDefragmentOnGpu) const
+{
+    const VkMemoryPropertyFlags memPropFlags =
+        m_hAllocator->m_MemProps.memoryTypes[m_MemoryTypeIndex].propertyFlags;
+    const bool isHostVisible = (memPropFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
 
-    node->type = Node::TYPE_FREE;
+    const bool canDefragmentOnCpu = maxCpuBytesToMove > 0 && maxCpuAllocationsToMove > 0 &&
+        isHostVisible;
+    const bool canDefragmentOnGpu = maxGpuBytesToMove > 0 && maxGpuAllocationsToMove > 0 &&
+        !IsCorruptionDetectionEnabled() &&
+        ((1u << m_MemoryTypeIndex) & m_hAllocator->GetGpuDefragmentationMemoryTypeBits()) != 0;
 
-    // Join free nodes if possible.
-    while(level > 0 && node->buddy->type == Node::TYPE_FREE)
+    // There are no options to defragment this memory type.
+    if(!canDefragmentOnCpu && !canDefragmentOnGpu)
     {
-        RemoveFromFreeList(level, node->buddy);
-        Node* const parent = node->parent;
-
-        vma_delete(GetAllocationCallbacks(), node->buddy);
-        vma_delete(GetAllocationCallbacks(), node);
-        parent->type = Node::TYPE_FREE;
-        
-        node = parent;
-        --level;
-        //m_SumFreeSize += LevelToNodeSize(level) % 2; // Useful only when level node sizes can be non power of 2.
-        --m_FreeCount;
+        return false;
     }
 
-    AddToFreeListFront(level, node);
+    // There is only one option to defragment this memory type.
+    if(canDefragmentOnGpu != canDefragmentOnCpu)
+    {
+        outDefragmentOnGpu = canDefragmentOnGpu;
+    }
+    // Both options are available: Heuristics to choose the best one.
+    else
+    {
+        outDefragmentOnGpu = (memPropFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) != 0 ||
+            m_hAllocator->IsIntegratedGpu();
+    }
+    return true;
 }
 
-void VmaBlockMetadata_Buddy::CalcAllocationStatInfoNode(VmaStatInfo& outInfo, const Node* node, VkDeviceSize levelNodeSize) const
+void VmaBlockVector::Defragment(
+    class VmaBlockVectorDefragmentationContext* pCtx,
+    VmaDefragmentationStats* pStats,
+    VkDeviceSize& maxCpuBytesToMove, uint32_t& maxCpuAllocationsToMove,
+    VkDeviceSize& maxGpuBytesToMove, uint32_t& maxGpuAllocationsToMove,
+    VkCommandBuffer commandBuffer)
 {
-    switch(node->type)
+    pCtx->res = VK_SUCCESS;
+    
+    bool defragmentOnGpu;
+    // There are options to defragment this memory type.
+    if(ChooseDefragmentationMethod(
+        maxCpuBytesToMove, maxCpuAllocationsToMove,
+        maxGpuBytesToMove, maxGpuAllocationsToMove,
+        defragmentOnGpu))
     {
-    case Node::TYPE_FREE:
-        ++outInfo.unusedRangeCount;
-        outInfo.unusedBytes += levelNodeSize;
-        outInfo.unusedRangeSizeMax = VMA_MAX(outInfo.unusedRangeSizeMax, levelNodeSize);
-        outInfo.unusedRangeSizeMin = VMA_MAX(outInfo.unusedRangeSizeMin, levelNodeSize);
-        break;
-    case Node::TYPE_ALLOCATION:
+        bool overlappingMoveSupported = !defragmentOnGpu;
+
+        if(m_hAllocator->m_UseMutex)
         {
-            const VkDeviceSize allocSize = node->allocation.alloc->GetSize();
-            ++outInfo.allocationCount;
-            outInfo.usedBytes += allocSize;
-            outInfo.allocationSizeMax = VMA_MAX(outInfo.allocationSizeMax, allocSize);
-            outInfo.allocationSizeMin = VMA_MAX(outInfo.allocationSizeMin, allocSize);
+            m_Mutex.LockWrite();
+            pCtx->mutexLocked = true;
+        }
+        m_DefragmentationInProgress.store(1);
 
-            const VkDeviceSize unusedRangeSize = levelNodeSize - allocSize;
-            if(unusedRangeSize > 0)
+        pCtx->Begin(overlappingMoveSupported);
+
+        // Defragment.
+
+        const VkDeviceSize maxBytesToMove = defragmentOnGpu ? maxGpuBytesToMove : maxCpuBytesToMove;
+        const uint32_t maxAllocationsToMove = defragmentOnGpu ? maxGpuAllocationsToMove : maxCpuAllocationsToMove;
+        VmaVector< VmaDefragmentationMove, VmaStlAllocator<VmaDefragmentationMove> > moves = 
+            VmaVector< VmaDefragmentationMove, VmaStlAllocator<VmaDefragmentationMove> >(VmaStlAllocator<VmaDefragmentationMove>(m_hAllocator->GetAllocationCallbacks()));
+        pCtx->res = pCtx->GetAlgorithm()->Defragment(moves, maxBytesToMove, maxAllocationsToMove);
+
+        // Accumulate statistics.
+        if(pStats != VMA_NULL)
+        {
+            const VkDeviceSize bytesMoved = pCtx->GetAlgorithm()->GetBytesMoved();
+            const uint32_t allocationsMoved = pCtx->GetAlgorithm()->GetAllocationsMoved();
+            pStats->bytesMoved += bytesMoved;
+            pStats->allocationsMoved += allocationsMoved;
+            VMA_ASSERT(bytesMoved <= maxBytesToMove);
+            VMA_ASSERT(allocationsMoved <= maxAllocationsToMove);
+            if(defragmentOnGpu)
             {
-                ++outInfo.unusedRangeCount;
-                outInfo.unusedBytes += unusedRangeSize;
-                outInfo.unusedRangeSizeMax = VMA_MAX(outInfo.unusedRangeSizeMax, unusedRangeSize);
-                outInfo.unusedRangeSizeMin = VMA_MAX(outInfo.unusedRangeSizeMin, unusedRangeSize);
+                maxGpuBytesToMove -= bytesMoved;
+                maxGpuAllocationsToMove -= allocationsMoved;
+            }
+            else
+            {
+                maxCpuBytesToMove -= bytesMoved;
+                maxCpuAllocationsToMove -= allocationsMoved;
             }
         }
-        break;
-    case Node::TYPE_SPLIT:
+    
+        if(pCtx->res >= VK_SUCCESS)
         {
-            const VkDeviceSize childrenNodeSize = levelNodeSize / 2;
-            const Node* const leftChild = node->split.leftChild;
-            CalcAllocationStatInfoNode(outInfo, leftChild, childrenNodeSize);
-            const Node* const rightChild = leftChild->buddy;
-            CalcAllocationStatInfoNode(outInfo, rightChild, childrenNodeSize);
-        }
-        break;
-    default:
-        VMA_ASSERT(0);
-    }
-}
-
-void VmaBlockMetadata_Buddy::AddToFreeListFront(uint32_t level, Node* node)
-{
-    VMA_ASSERT(node->type == Node::TYPE_FREE);
-
-    // List is empty.
-    Node* const frontNode = m_FreeList[level].front;
-    if(frontNode == VMA_NULL)
-    {
-        VMA_ASSERT(m_FreeList[level].back == VMA_NULL);
-        node->free.prev = node->free.next = VMA_NULL;
-        m_FreeList[level].front = m_FreeList[level].back = node;
-    }
-    else
-    {
-        VMA_ASSERT(frontNode->free.prev == VMA_NULL);
-        node->free.prev = VMA_NULL;
-        node->free.next = frontNode;
-        frontNode->free.prev = node;
-        m_FreeList[level].front = node;
+            if(defragmentOnGpu)
+            {
+                ApplyDefragmentationMovesGpu(pCtx, moves, commandBuffer);
+            }
+            else
+            {
+                ApplyDefragmentationMovesCpu(pCtx, moves);
+            }
+        }
     }
 }
 
-void VmaBlockMetadata_Buddy::RemoveFromFreeList(uint32_t level, Node* node)
+void VmaBlockVector::DefragmentationEnd(
+    class VmaBlockVectorDefragmentationContext* pCtx,
+    VmaDefragmentationStats* pStats)
 {
-    VMA_ASSERT(m_FreeList[level].front != VMA_NULL);
-
-    // It is at the front.
-    if(node->free.prev == VMA_NULL)
+    // Destroy buffers.
+    for(size_t blockIndex = pCtx->blockContexts.size(); blockIndex--; )
     {
-        VMA_ASSERT(m_FreeList[level].front == node);
-        m_FreeList[level].front = node->free.next;
+        VmaBlockDefragmentationContext& blockCtx = pCtx->blockContexts[blockIndex];
+        if(blockCtx.hBuffer)
+        {
+            (*m_hAllocator->GetVulkanFunctions().vkDestroyBuffer)(
+                m_hAllocator->m_hDevice, blockCtx.hBuffer, m_hAllocator->GetAllocationCallbacks());
+        }
     }
-    else
+
+    if(pCtx->res >= VK_SUCCESS)
     {
-        Node* const prevFreeNode = node->free.prev;
-        VMA_ASSERT(prevFreeNode->free.next == node);
-        prevFreeNode->free.next = node->free.next;
+        FreeEmptyBlocks(pStats);
     }
 
-    // It is at the back.
-    if(node->free.next == VMA_NULL)
+    // Defragmentation has been started in Defragment().
+    if(pCtx->GetAlgorithm() != VMA_NULL)
     {
-        VMA_ASSERT(m_FreeList[level].back == node);
-        m_FreeList[level].back = node->free.prev;
+        RecalculateFragmentationScore();
+        m_DefragmentationInProgress.store(0);
     }
-    else
+
+    if(pCtx->mutexLocked)
     {
-        Node* const nextFreeNode = node->free.next;
-        VMA_ASSERT(nextFreeNode->free.prev == node);
-        nextFreeNode->free.prev = node->free.prev;
+        VMA_ASSERT(m_hAllocator->m_UseMutex);
+        m_Mutex.UnlockWrite();
     }
 }
 
-#if VMA_STATS_STRING_ENABLED
-void VmaBlockMetadata_Buddy::PrintDetailedMapNode(class VmaJsonWriter& json, const Node* node, VkDeviceSize levelNodeSize) const
+void VmaBlockVector::EstimateDefragmentation(
+    class VmaBlockVectorDefragmentationContext* pCtx,
+    VmaDefragmentationEstimate& inoutEstimate,
+    VmaFragmentationSums& inoutSumsBefore,
+    VmaFragmentationSums& inoutSumsAfter,
+    VkDeviceSize& maxCpuBytesToMove, uint32_t& maxCpuAllocationsToMove,
+    VkDeviceSize& maxGpuBytesToMove, uint32_t& maxGpuAllocationsToMove)
 {
-    switch(node->type)
+    pCtx->res = VK_SUCCESS;
+
+    VmaMutexLockRead lock(m_Mutex, m_hAllocator->m_UseMutex);
+
+    const size_t blockCount = m_Blocks.size();
+
+    // Make copies of metadata of all blocks and sum free space before defragmentation.
+    VmaVector< VmaBlockMetadata*, VmaStlAllocator<VmaBlockMetadata*> > metadataCopies(
+        blockCount, VMA_NULL, VmaStlAllocator<VmaBlockMetadata*>(m_hAllocator->GetAllocationCallbacks()));
+    VkDeviceSize unusedBytes = 0;
+    VkDeviceSize unusedRangeSizeMax = 0;
+    for(size_t blockIndex = 0; blockIndex < blockCount; ++blockIndex)
     {
-    case Node::TYPE_FREE:
-        PrintDetailedMap_UnusedRange(json, node->offset, levelNodeSize);
-        break;
-    case Node::TYPE_ALLOCATION:
-        {   
-            PrintDetailedMap_Allocation(json, node->offset, node->allocation.alloc);
-            const VkDeviceSize allocSize = node->allocation.alloc->GetSize();
-            if(allocSize < levelNodeSize)
+        const VmaBlockMetadata* const pMetadata = m_Blocks[blockIndex]->m_pMetadata;
+        switch(m_Algorithm)
+        {
+        case VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT:
             {
-                PrintDetailedMap_UnusedRange(json, node->offset + allocSize, levelNodeSize - allocSize);
+                VmaBlockMetadata_Linear* const pMetadataCopy = vma_new(m_hAllocator, VmaBlockMetadata_Linear)(m_hAllocator);
+                pMetadataCopy->InitSnapshot(*(const VmaBlockMetadata_Linear*)pMetadata);
+                metadataCopies[blockIndex] = pMetadataCopy;
+            }
+            break;
+        case VMA_POOL_CREATE_BUDDY_ALGORITHM_BIT:
+            {
+                VmaBlockMetadata_Buddy* const pMetadataCopy = vma_new(m_hAllocator, VmaBlockMetadata_Buddy)(m_hAllocator, m_BuddyMultipleRoots);
+                pMetadataCopy->InitSnapshot(*(const VmaBlockMetadata_Buddy*)pMetadata);
+                metadataCopies[blockIndex] = pMetadataCopy;
+            }
+            break;
+        default:
+            VMA_ASSERT(0);
+            // Fall-through.
+        case 0:
+            {
+                VmaBlockMetadata_Generic* const pMetadataCopy = vma_new(m_hAllocator, VmaBlockMetadata_Generic)(m_hAllocator);
+                pMetadataCopy->InitSnapshot(*(const VmaBlockMetadata_Generic*)pMetadata);
+                metadataCopies[blockIndex] = pMetadataCopy;
             }
         }
-        break;
-    case Node::TYPE_SPLIT:
-        {
-            const VkDeviceSize childrenNodeSize = levelNodeSize / 2;
-            const Node* const leftChild = node->split.leftChild;
-            PrintDetailedMapNode(json, leftChild, childrenNodeSize);
-            const Node* const rightChild = leftChild->buddy;
-            PrintDetailedMapNode(json, rightChild, childrenNodeSize);
-        }
-        break;
-    default:
-        VMA_ASSERT(0);
-    }
-}
-#endif // #if VMA_STATS_STRING_ENABLED
-
 
-////////////////////////////////////////////////////////////////////////////////
-// class VmaDeviceMemoryBlock
+        unusedBytes += pMetadata->GetSumFreeSize();
+        unusedRangeSizeMax = VMA_MAX(unusedRangeSizeMax, pMetadata->GetUnusedRangeSizeMax());
+    }
+    inoutSumsBefore.AddBlockVector(unusedBytes, unusedRangeSizeMax);
 
-VmaDeviceMemoryBlock::VmaDeviceMemoryBlock(VmaAllocator hAllocator) :
-    m_pMetadata(VMA_NULL),
-    m_MemoryTypeIndex(UINT32_MAX),
-    m_Id(0),
-    m_hMemory(VK_NULL_HANDLE),
-    m_MapCount(0),
-    m_pMappedData(VMA_NULL)
-{
-}
+    bool defragmentOnGpu;
+    if(ChooseDefragmentationMethod(
+        maxCpuBytesToMove, maxCpuAllocationsToMove,
+        maxGpuBytesToMove, maxGpuAllocationsToMove,
+        defragmentOnGpu))
+    {
+        pCtx->Begin(!defragmentOnGpu);
+        pCtx->GetAlgorithm()->SetDryRun(metadataCopies.data());
 
-void VmaDeviceMemoryBlock::Init(
-    VmaAllocator hAllocator,
-    VmaPool hParentPool,
-    uint32_t newMemoryTypeIndex,
-    VkDeviceMemory newMemory,
-    VkDeviceSize newSize,
-    uint32_t id,
-    uint32_t algorithm)
-{
-    VMA_ASSERT(m_hMemory == VK_NULL_HANDLE);
+        const VkDeviceSize maxBytesToMove = defragmentOnGpu ? maxGpuBytesToMove : maxCpuBytesToMove;
+        const uint32_t maxAllocationsToMove = defragmentOnGpu ? maxGpuAllocationsToMove : maxCpuAllocationsToMove;
+        VmaVector< VmaDefragmentationMove, VmaStlAllocator<VmaDefragmentationMove> > moves = 
+            VmaVector< VmaDefragmentationMove, VmaStlAllocator<VmaDefragmentationMove> >(VmaStlAllocator<VmaDefragmentationMove>(m_hAllocator->GetAllocationCallbacks()));
+        pCtx->res = pCtx->GetAlgorithm()->Defragment(moves, maxBytesToMove, maxAllocationsToMove);
 
-    m_hParentPool = hParentPool;
-    m_MemoryTypeIndex = newMemoryTypeIndex;
-    m_Id = id;
-    m_hMemory = newMemory;
+        const VkDeviceSize bytesMoved = pCtx->GetAlgorithm()->GetBytesMoved();
+        const uint32_t allocationsMoved = pCtx->GetAlgorithm()->GetAllocationsMoved();
+        inoutEstimate.bytesMoved += bytesMoved;
+        inoutEstimate.allocationsMoved += allocationsMoved;
+        if(defragmentOnGpu)
+        {
+            maxGpuBytesToMove -= bytesMoved;
+            maxGpuAllocationsToMove -= allocationsMoved;
+        }
+        else
+        {
+            maxCpuBytesToMove -= bytesMoved;
+            maxCpuAllocationsToMove -= allocationsMoved;
+        }
+    }
 
-    switch(algorithm)
+    // Sum free space after defragmentation, skipping blocks that FreeEmptyBlocks() would release.
+    unusedBytes = 0;
+    unusedRangeSizeMax = 0;
+    size_t remainingBlockCount = blockCount;
+    for(size_t blockIndex = blockCount; blockIndex--; )
     {
-    case VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT:
-        m_pMetadata = vma_new(hAllocator, VmaBlockMetadata_Linear)(hAllocator);
-        break;
-    case VMA_POOL_CREATE_BUDDY_ALGORITHM_BIT:
-        m_pMetadata = vma_new(hAllocator, VmaBlockMetadata_Buddy)(hAllocator);
-        break;
-    default:
-        VMA_ASSERT(0);
-        // Fall-through.
-    case 0:
-        m_pMetadata = vma_new(hAllocator, VmaBlockMetadata_Generic)(hAllocator);
+        VmaBlockMetadata* const pMetadataCopy = metadataCopies[blockIndex];
+        if(pCtx->res >= VK_SUCCESS && pMetadataCopy->IsEmpty() && remainingBlockCount > m_MinBlockCount)
+        {
+            ++inoutEstimate.deviceMemoryBlocksFreed;
+            inoutEstimate.bytesFreed += pMetadataCopy->GetSize();
+            --remainingBlockCount;
+        }
+        else
+        {
+            unusedBytes += pMetadataCopy->GetSumFreeSize();
+            unusedRangeSizeMax = VMA_MAX(unusedRangeSizeMax, pMetadataCopy->GetUnusedRangeSizeMax());
+        }
+        vma_delete(m_hAllocator, pMetadataCopy);
     }
-    m_pMetadata->Init(newSize);
+    inoutSumsAfter.AddBlockVector(unusedBytes, unusedRangeSizeMax);
 }
 
-void VmaDeviceMemoryBlock::Destroy(VmaAllocator allocator)
+size_t VmaBlockVector::CalcAllocationCount() const
 {
-    // This is the most important assert in the entire library.
-    // Hitting it means you have some memory leak - unreleased VmaAllocation objects.
-    VMA_ASSERT(m_pMetadata->IsEmpty() && "Some allocations were not freed before destruction of this memory block!");
-
-    VMA_ASSERT(m_hMemory != VK_NULL_HANDLE);
-    allocator->FreeVulkanMemory(m_MemoryTypeIndex, m_pMetadata->GetSize(), m_hMemory);
-    m_hMemory = VK_NULL_HANDLE;
-
-    vma_delete(allocator, m_pMetadata);
-    m_pMetadata = VMA_NULL;
+    size_t result = 0;
+    for(size_t i = 0; i < m_Blocks.size(); ++i)
+    {
+        result += m_Blocks[i]->m_pMetadata->GetAllocationCount();
+    }
+    return result;
 }
 
-bool VmaDeviceMemoryBlock::Validate() const
+bool VmaBlockVector::IsBufferImageGranularityConflictPossible() const
 {
-    VMA_VALIDATE((m_hMemory != VK_NULL_HANDLE) &&
-        (m_pMetadata->GetSize() != 0));
-    
-    return m_pMetadata->Validate();
+    if(m_BufferImageGranularity == 1)
+    {
+        return false;
+    }
+    VmaSuballocationType lastSuballocType = VMA_SUBALLOCATION_TYPE_FREE;
+    for(size_t i = 0, count = m_Blocks.size(); i < count; ++i)
+    {
+        VmaDeviceMemoryBlock* const pBlock = m_Blocks[i];
+        VMA_ASSERT(m_Algorithm == 0);
+        VmaBlockMetadata_Generic* const pMetadata = (VmaBlockMetadata_Generic*)pBlock->m_pMetadata;
+        if(pMetadata->IsBufferImageGranularityConflictPossible(m_BufferImageGranularity, lastSuballocType))
+        {
+            return true;
+        }
+    }
+    return false;
 }
 
-VkResult VmaDeviceMemoryBlock::CheckCorruption(VmaAllocator hAllocator)
+void VmaBlockVector::MakePoolAllocationsLost(
+    uint32_t currentFrameIndex,
+    size_t* pLostAllocationCount)
 {
-    void* pData = nullptr;
-    VkResult res = Map(hAllocator, 1, &pData);
-    if(res != VK_SUCCESS)
+    VmaMutexLockWrite lock(m_Mutex, m_hAllocator->m_UseMutex);
+    size_t lostAllocationCount = 0;
+    for(uint32_t blockIndex = 0; blockIndex < m_Blocks.size(); ++blockIndex)
     {
-        return res;
+        VmaDeviceMemoryBlock* const pBlock = m_Blocks[blockIndex];
+        VMA_ASSERT(pBlock);
+        lostAllocationCount += pBlock->m_pMetadata->MakeAllocationsLost(currentFrameIndex, m_FrameInUseCount);
+    }
+    RecalculateFragmentationScore();
+    if(pLostAllocationCount != VMA_NULL)
+    {
+        *pLostAllocationCount = lostAllocationCount;
     }
-
-    res = m_pMetadata->CheckCorruption(pData);
-
-    Unmap(hAllocator, 1);
-
-    return res;
 }
 
-VkResult VmaDeviceMemoryBlock::Map(VmaAllocator hAllocator, uint32_t count, void** ppData)
+VkResult VmaBlockVector::CheckCorruption()
 {
-    if(count == 0)
+    if(!IsCorruptionDetectionEnabled())
     {
-        return VK_SUCCESS;
+        return VK_ERROR_FEATURE_NOT_PRESENT;
     }
 
-    VmaMutexLock lock(m_Mutex, hAllocator->m_UseMutex);
-    if(m_MapCount != 0)
+    VmaMutexLockRead lock(m_Mutex, m_hAllocator->m_UseMutex);
+    for(uint32_t blockIndex = 0; blockIndex < m_Blocks.size(); ++blockIndex)
     {
-        m_MapCount += count;
-        VMA_ASSERT(m_pMappedData != VMA_NULL);
-        if(ppData != VMA_NULL)
+        VmaDeviceMemoryBlock* const pBlock = m_Blocks[blockIndex];
+        VMA_ASSERT(pBlock);
+        VkResult res = pBlock->CheckCorruption(m_hAllocator);
+        if(res != VK_SUCCESS)
         {
-            *ppData = m_pMappedData;
+            return res;
         }
-        return VK_SUCCESS;
     }
-    else
+    return VK_SUCCESS;
+}
+
+void VmaBlockVector::AddStats(VmaStats* pStats)
+{
+    const uint32_t memTypeIndex = m_MemoryTypeIndex;
+    const uint32_t memHeapIndex = m_hAllocator->MemoryTypeIndexToHeapIndex(memTypeIndex);
+
+    VmaStatInfo statInfo;
+    CalcStatInfo(statInfo);
+    VmaAddStatInfo(pStats->total, statInfo);
+    VmaAddStatInfo(pStats->memoryType[memTypeIndex], statInfo);
+    VmaAddStatInfo(pStats->memoryHeap[memHeapIndex], statInfo);
+}
+
+void VmaBlockVector::CalcStatInfo(VmaStatInfo& outInfo)
+{
+    InitStatInfo(outInfo);
+
+    VmaMutexLockRead lock(m_Mutex, m_hAllocator->m_UseMutex);
+
+    for(uint32_t blockIndex = 0; blockIndex < m_Blocks.size(); ++blockIndex)
     {
-        VkResult result = (*hAllocator->GetVulkanFunctions().vkMapMemory)(
-            hAllocator->m_hDevice,
-            m_hMemory,
-            0, // offset
-            VK_WHOLE_SIZE,
-            0, // flags
-            &m_pMappedData);
-        if(result == VK_SUCCESS)
-        {
-            if(ppData != VMA_NULL)
-            {
-                *ppData = m_pMappedData;
-            }
-            m_MapCount = count;
-        }
-        return result;
+        const VmaDeviceMemoryBlock* const pBlock = m_Blocks[blockIndex];
+        VMA_ASSERT(pBlock);
+        VMA_HEAVY_ASSERT(pBlock->Validate());
+        VmaStatInfo allocationStatInfo;
+        pBlock->m_pMetadata->CalcAllocationStatInfo(allocationStatInfo);
+        VmaAddStatInfo(outInfo, allocationStatInfo);
     }
 }
 
-void VmaDeviceMemoryBlock::Unmap(VmaAllocator hAllocator, uint32_t count)
+////////////////////////////////////////////////////////////////////////////////
+// VmaDefragmentationAlgorithm members definition
+
+void VmaDefragmentationAlgorithm::CoalesceMoves(
+    VmaVector< VmaDefragmentationMove, VmaStlAllocator<VmaDefragmentationMove> >& moves,
+    bool overlappingMoveSupported)
 {
-    if(count == 0)
+    const size_t moveCount = moves.size();
+    if(moveCount < 2)
     {
         return;
     }
 
-    VmaMutexLock lock(m_Mutex, hAllocator->m_UseMutex);
-    if(m_MapCount >= count)
+    size_t dstMoveIndex = 0;
+    for(size_t srcMoveIndex = 1; srcMoveIndex < moveCount; ++srcMoveIndex)
     {
-        m_MapCount -= count;
-        if(m_MapCount == 0)
+        VmaDefragmentationMove& prevMove = moves[dstMoveIndex];
+        const VmaDefragmentationMove& currMove = moves[srcMoveIndex];
+
+        bool merge = false;
+        VmaDefragmentationMove mergedMove = prevMove;
+        if(currMove.srcBlockIndex == prevMove.srcBlockIndex &&
+            currMove.dstBlockIndex == prevMove.dstBlockIndex)
         {
-            m_pMappedData = VMA_NULL;
-            (*hAllocator->GetVulkanFunctions().vkUnmapMemory)(hAllocator->m_hDevice, m_hMemory);
+            // Current move continues previous one towards higher offsets.
+            if(prevMove.srcOffset + prevMove.size == currMove.srcOffset &&
+                prevMove.dstOffset + prevMove.size == currMove.dstOffset)
+            {
+                merge = true;
+            }
+            // Current move continues previous one towards lower offsets.
+            else if(currMove.srcOffset + currMove.size == prevMove.srcOffset &&
+                currMove.dstOffset + currMove.size == prevMove.dstOffset)
+            {
+                mergedMove.srcOffset = currMove.srcOffset;
+                mergedMove.dstOffset = currMove.dstOffset;
+                merge = true;
+            }
+
+            if(merge)
+            {
+                mergedMove.size += currMove.size;
+
+                // Source and destination of single copy must not overlap if it is not supported.
+                if(!overlappingMoveSupported &&
+                    mergedMove.srcBlockIndex == mergedMove.dstBlockIndex &&
+                    mergedMove.srcOffset < mergedMove.dstOffset + mergedMove.size &&
+                    mergedMove.dstOffset < mergedMove.srcOffset + mergedMove.size)
+                {
+                    merge = false;
+                }
+            }
+        }
+
+        if(merge)
+        {
+            prevMove = mergedMove;
+        }
+        else
+        {
+            ++dstMoveIndex;
+            if(dstMoveIndex != srcMoveIndex)
+            {
+                moves[dstMoveIndex] = currMove;
+            }
         }
     }
-    else
-    {
-        VMA_ASSERT(0 && "VkDeviceMemory block is being unmapped while it was not previously mapped.");
-    }
+    moves.resize(dstMoveIndex + 1);
 }
 
-VkResult VmaDeviceMemoryBlock::WriteMagicValueAroundAllocation(VmaAllocator hAllocator, VkDeviceSize allocOffset, VkDeviceSize allocSize)
-{
-    VMA_ASSERT(VMA_DEBUG_MARGIN > 0 && VMA_DEBUG_MARGIN % 4 == 0 && VMA_DEBUG_DETECT_CORRUPTION);
-    VMA_ASSERT(allocOffset >= VMA_DEBUG_MARGIN);
+////////////////////////////////////////////////////////////////////////////////
+// VmaDefragmentationAlgorithm_Generic members definition
 
-    void* pData;
-    VkResult res = Map(hAllocator, 1, &pData);
-    if(res != VK_SUCCESS)
+VmaDefragmentationAlgorithm_Generic::VmaDefragmentationAlgorithm_Generic(
+    VmaAllocator hAllocator,
+    VmaBlockVector* pBlockVector,
+    uint32_t currentFrameIndex,
+    bool overlappingMoveSupported) :
+    VmaDefragmentationAlgorithm(hAllocator, pBlockVector, currentFrameIndex),
+    m_OverlappingMoveSupported(overlappingMoveSupported),
+    m_AllocationCount(0),
+    m_AllAllocations(false),
+    m_BytesMoved(0),
+    m_AllocationsMoved(0),
+    m_Blocks(VmaStlAllocator<BlockInfo*>(hAllocator->GetAllocationCallbacks()))
+{
+    // Create block info for each block.
+    const size_t blockCount = m_pBlockVector->m_Blocks.size();
+    for(size_t blockIndex = 0; blockIndex < blockCount; ++blockIndex)
     {
-        return res;
+        BlockInfo* pBlockInfo = vma_new(m_hAllocator, BlockInfo)(m_hAllocator->GetAllocationCallbacks());
+        pBlockInfo->m_OriginalBlockIndex = blockIndex;
+        pBlockInfo->m_pBlock = m_pBlockVector->m_Blocks[blockIndex];
+        m_Blocks.push_back(pBlockInfo);
     }
 
-    VmaWriteMagicValue(pData, allocOffset - VMA_DEBUG_MARGIN);
-    VmaWriteMagicValue(pData, allocOffset + allocSize);
-
-    Unmap(hAllocator, 1);
-
-    return VK_SUCCESS;
+    // Sort them by m_pBlock pointer value.
+    VMA_SORT(m_Blocks.begin(), m_Blocks.end(), BlockPointerLess());
 }
 
-VkResult VmaDeviceMemoryBlock::ValidateMagicValueAroundAllocation(VmaAllocator hAllocator, VkDeviceSize allocOffset, VkDeviceSize allocSize)
+VmaDefragmentationAlgorithm_Generic::~VmaDefragmentationAlgorithm_Generic()
 {
-    VMA_ASSERT(VMA_DEBUG_MARGIN > 0 && VMA_DEBUG_MARGIN % 4 == 0 && VMA_DEBUG_DETECT_CORRUPTION);
-    VMA_ASSERT(allocOffset >= VMA_DEBUG_MARGIN);
-
-    void* pData;
-    VkResult res = Map(hAllocator, 1, &pData);
-    if(res != VK_SUCCESS)
+    for(size_t i = m_Blocks.size(); i--; )
     {
-        return res;
+        vma_delete(m_hAllocator, m_Blocks[i]);
     }
+}
 
-    if(!VmaValidateMagicValue(pData, allocOffset - VMA_DEBUG_MARGIN))
+void VmaDefragmentationAlgorithm_Generic::AddAllocation(VmaAllocation hAlloc, VkBool32* pChanged)
+{
+    // Now as we are inside VmaBlockVector::m_Mutex, we can make final check if this allocation was not lost.
+    if(hAlloc->GetLastUseFrameIndex() != VMA_FRAME_INDEX_LOST)
     {
-        VMA_ASSERT(0 && "MEMORY CORRUPTION DETECTED BEFORE FREED ALLOCATION!");
+        VmaDeviceMemoryBlock* pBlock = hAlloc->GetBlock();
+        BlockInfoVector::iterator it = VmaBinaryFindFirstNotLess(m_Blocks.begin(), m_Blocks.end(), pBlock, BlockPointerLess());
+        if(it != m_Blocks.end() && (*it)->m_pBlock == pBlock)
+        {
+            AllocationInfo allocInfo = AllocationInfo(hAlloc, pChanged);
+            (*it)->m_Allocations.push_back(allocInfo);
+        }
+        else
+        {
+            VMA_ASSERT(0);
+        }
+
+        ++m_AllocationCount;
     }
-    else if(!VmaValidateMagicValue(pData, allocOffset + allocSize))
+}
+
+VkResult VmaDefragmentationAlgorithm_Generic::DefragmentRound(
+    VmaVector< VmaDefragmentationMove, VmaStlAllocator<VmaDefragmentationMove> >& moves,
+    VkDeviceSize maxBytesToMove,
+    uint32_t maxAllocationsToMove)
+{
+    if(m_Blocks.empty())
     {
-        VMA_ASSERT(0 && "MEMORY CORRUPTION DETECTED AFTER FREED ALLOCATION!");
+        return VK_SUCCESS;
     }
 
-    Unmap(hAllocator, 1);
+    // This is a choice based on research.
+    // Option 1:
+    uint32_t strategy = VMA_ALLOCATION_CREATE_STRATEGY_MIN_TIME_BIT;
+    // Option 2:
+    //uint32_t strategy = VMA_ALLOCATION_CREATE_STRATEGY_MIN_MEMORY_BIT;
+    // Option 3:
+    //uint32_t strategy = VMA_ALLOCATION_CREATE_STRATEGY_MIN_FRAGMENTATION_BIT;
 
-    return VK_SUCCESS;
-}
+    size_t srcBlockMinIndex = 0;
+    // When FAST_ALGORITHM, move allocations from only last out of blocks that contain non-movable allocations.
+    /*
+    if(m_AlgorithmFlags & VMA_DEFRAGMENTATION_FAST_ALGORITHM_BIT)
+    {
+        const size_t blocksWithNonMovableCount = CalcBlocksWithNonMovableCount();
+        if(blocksWithNonMovableCount > 0)
+        {
+            srcBlockMinIndex = blocksWithNonMovableCount - 1;
+        }
+    }
+    */
 
-VkResult VmaDeviceMemoryBlock::BindBufferMemory(
-    const VmaAllocator hAllocator,
-    const VmaAllocation hAllocation,
-    VkDeviceSize allocationLocalOffset,
-    VkBuffer hBuffer,
-    const void* pNext)
-{
-    VMA_ASSERT(hAllocation->GetType() == VmaAllocation_T::ALLOCATION_TYPE_BLOCK &&
-        hAllocation->GetBlock() == this);
-    VMA_ASSERT(allocationLocalOffset < hAllocation->GetSize() &&
-        "Invalid allocationLocalOffset. Did you forget that this offset is relative to the beginning of the allocation, not the whole memory block?");
-    const VkDeviceSize memoryOffset = hAllocation->GetOffset() + allocationLocalOffset;
-    // This lock is important so that we don't call vkBind... and/or vkMap... simultaneously on the same VkDeviceMemory from multiple threads.
-    VmaMutexLock lock(m_Mutex, hAllocator->m_UseMutex);
-    return hAllocator->BindVulkanBuffer(m_hMemory, memoryOffset, hBuffer, pNext);
-}
+    size_t srcBlockIndex = m_Blocks.size() - 1;
+    size_t srcAllocIndex = SIZE_MAX;
+    for(;;)
+    {
+        // 1. Find next allocation to move.
+        // 1.1. Start from last to first m_Blocks - they are sorted from most "destination" to most "source".
+        // 1.2. Then start from last to first m_Allocations.
+        while(srcAllocIndex >= m_Blocks[srcBlockIndex]->m_Allocations.size())
+        {
+            if(m_Blocks[srcBlockIndex]->m_Allocations.empty())
+            {
+                // Finished: no more allocations to process.
+                if(srcBlockIndex == srcBlockMinIndex)
+                {
+                    return VK_SUCCESS;
+                }
+                else
+                {
+                    --srcBlockIndex;
+                    srcAllocIndex = SIZE_MAX;
+                }
+            }
+            else
+            {
+                srcAllocIndex = m_Blocks[srcBlockIndex]->m_Allocations.size() - 1;
+            }
+        }
+        
+        BlockInfo* pSrcBlockInfo = m_Blocks[srcBlockIndex];
+        AllocationInfo& allocInfo = pSrcBlockInfo->m_Allocations[srcAllocIndex];
 
-VkResult VmaDeviceMemoryBlock::BindImageMemory(
-    const VmaAllocator hAllocator,
-    const VmaAllocation hAllocation,
-    VkDeviceSize allocationLocalOffset,
-    VkImage hImage,
-    const void* pNext)
-{
-    VMA_ASSERT(hAllocation->GetType() == VmaAllocation_T::ALLOCATION_TYPE_BLOCK &&
-        hAllocation->GetBlock() == this);
-    VMA_ASSERT(allocationLocalOffset < hAllocation->GetSize() &&
-        "Invalid allocationLocalOffset. Did you forget that this offset is relative to the beginning of the allocation, not the whole memory block?");
-    const VkDeviceSize memoryOffset = hAllocation->GetOffset() + allocationLocalOffset;
-    // This lock is important so that we don't call vkBind... and/or vkMap... simultaneously on the same VkDeviceMemory from multiple threads.
-    VmaMutexLock lock(m_Mutex, hAllocator->m_UseMutex);
-    return hAllocator->BindVulkanImage(m_hMemory, memoryOffset, hImage, pNext);
-}
+        const VkDeviceSize size = allocInfo.m_hAllocation->GetSize();
+        const VkDeviceSize srcOffset = allocInfo.m_hAllocation->GetOffset();
+        const VkDeviceSize alignment = allocInfo.m_hAllocation->GetAlignment();
+        const VmaSuballocationType suballocType = allocInfo.m_hAllocation->GetSuballocationType();
 
-static void InitStatInfo(VmaStatInfo& outInfo)
-{
-    memset(&outInfo, 0, sizeof(outInfo));
-    outInfo.allocationSizeMin = UINT64_MAX;
-    outInfo.unusedRangeSizeMin = UINT64_MAX;
-}
+        // 2. Try to find new place for this allocation in preceding or current block.
+        for(size_t dstBlockIndex = 0; dstBlockIndex <= srcBlockIndex; ++dstBlockIndex)
+        {
+            BlockInfo* pDstBlockInfo = m_Blocks[dstBlockIndex];
+            VmaBlockMetadata* const pDstMetadata = GetBlockMetadata(pDstBlockInfo->m_OriginalBlockIndex);
+            VmaAllocationRequest dstAllocRequest;
+            if(pDstMetadata->CreateAllocationRequest(
+                m_CurrentFrameIndex,
+                m_pBlockVector->GetFrameInUseCount(),
+                m_pBlockVector->GetBufferImageGranularity(),
+                size,
+                alignment,
+                false, // upperAddress
+                suballocType,
+                false, // canMakeOtherLost
+                strategy,
+                &dstAllocRequest) &&
+            MoveMakesSense(
+                dstBlockIndex, dstAllocRequest.offset, srcBlockIndex, srcOffset))
+            {
+                VMA_ASSERT(dstAllocRequest.itemsToMakeLostCount == 0);
 
-// Adds statistics srcInfo into inoutInfo, like: inoutInfo += srcInfo.
-static void VmaAddStatInfo(VmaStatInfo& inoutInfo, const VmaStatInfo& srcInfo)
-{
-    inoutInfo.blockCount += srcInfo.blockCount;
-    inoutInfo.allocationCount += srcInfo.allocationCount;
-    inoutInfo.unusedRangeCount += srcInfo.unusedRangeCount;
-    inoutInfo.usedBytes += srcInfo.usedBytes;
-    inoutInfo.unusedBytes += srcInfo.unusedBytes;
-    inoutInfo.allocationSizeMin = VMA_MIN(inoutInfo.allocationSizeMin, srcInfo.allocationSizeMin);
-    inoutInfo.allocationSizeMax = VMA_MAX(inoutInfo.allocationSizeMax, srcInfo.allocationSizeMax);
-    inoutInfo.unusedRangeSizeMin = VMA_MIN(inoutInfo.unusedRangeSizeMin, srcInfo.unusedRangeSizeMin);
-    inoutInfo.unusedRangeSizeMax = VMA_MAX(inoutInfo.unusedRangeSizeMax, srcInfo.unusedRangeSizeMax);
-}
+                // Reached limit on number of allocations or bytes to move.
+                if((m_AllocationsMoved + 1 > maxAllocationsToMove) ||
+                    (m_BytesMoved + size > maxBytesToMove))
+                {
+                    return VK_SUCCESS;
+                }
 
-static void VmaPostprocessCalcStatInfo(VmaStatInfo& inoutInfo)
-{
-    inoutInfo.allocationSizeAvg = (inoutInfo.allocationCount > 0) ?
-        VmaRoundDiv<VkDeviceSize>(inoutInfo.usedBytes, inoutInfo.allocationCount) : 0;
-    inoutInfo.unusedRangeSizeAvg = (inoutInfo.unusedRangeCount > 0) ?
-        VmaRoundDiv<VkDeviceSize>(inoutInfo.unusedBytes, inoutInfo.unusedRangeCount) : 0;
-}
+                VmaDefragmentationMove move;
+                move.srcBlockIndex = pSrcBlockInfo->m_OriginalBlockIndex;
+                move.dstBlockIndex = pDstBlockInfo->m_OriginalBlockIndex;
+                move.srcOffset = srcOffset;
+                move.dstOffset = dstAllocRequest.offset;
+                move.size = size;
+                moves.push_back(move);
 
-VmaPool_T::VmaPool_T(
-    VmaAllocator hAllocator,
-    const VmaPoolCreateInfo& createInfo,
-    VkDeviceSize preferredBlockSize) :
-    m_BlockVector(
-        hAllocator,
-        this, // hParentPool
-        createInfo.memoryTypeIndex,
-        createInfo.blockSize != 0 ? createInfo.blockSize : preferredBlockSize,
-        createInfo.minBlockCount,
-        createInfo.maxBlockCount,
-        (createInfo.flags & VMA_POOL_CREATE_IGNORE_BUFFER_IMAGE_GRANULARITY_BIT) != 0 ? 1 : hAllocator->GetBufferImageGranularity(),
-        createInfo.frameInUseCount,
-        true, // isCustomPool
-        createInfo.blockSize != 0, // explicitBlockSize
-        createInfo.flags & VMA_POOL_CREATE_ALGORITHM_MASK), // algorithm
-    m_Id(0)
-{
-}
+                pDstMetadata->Alloc(
+                    dstAllocRequest,
+                    suballocType,
+                    size,
+                    allocInfo.m_hAllocation);
+                GetBlockMetadata(pSrcBlockInfo->m_OriginalBlockIndex)->FreeAtOffset(srcOffset);
+                
+                if(!IsDryRun())
+                {
+                    allocInfo.m_hAllocation->ChangeBlockAllocation(m_hAllocator, pDstBlockInfo->m_pBlock, dstAllocRequest.offset);
+                    OnAllocationMoved(allocInfo.m_hAllocation, allocInfo.m_pChanged);
+                }
 
-VmaPool_T::~VmaPool_T()
-{
-}
+                ++m_AllocationsMoved;
+                m_BytesMoved += size;
 
-#if VMA_STATS_STRING_ENABLED
+                VmaVectorRemove(pSrcBlockInfo->m_Allocations, srcAllocIndex);
 
-#endif // #if VMA_STATS_STRING_ENABLED
+                break;
+            }
+        }
 
-VmaBlockVector::VmaBlockVector(
-    VmaAllocator hAllocator,
-    VmaPool hParentPool,
-    uint32_t memoryTypeIndex,
-    VkDeviceSize preferredBlockSize,
-    size_t minBlockCount,
-    size_t maxBlockCount,
-    VkDeviceSize bufferImageGranularity,
-    uint32_t frameInUseCount,
-    bool isCustomPool,
-    bool explicitBlockSize,
-    uint32_t algorithm) :
-    m_hAllocator(hAllocator),
-    m_hParentPool(hParentPool),
-    m_MemoryTypeIndex(memoryTypeIndex),
-    m_PreferredBlockSize(preferredBlockSize),
-    m_MinBlockCount(minBlockCount),
-    m_MaxBlockCount(maxBlockCount),
-    m_BufferImageGranularity(bufferImageGranularity),
-    m_FrameInUseCount(frameInUseCount),
-    m_IsCustomPool(isCustomPool),
-    m_ExplicitBlockSize(explicitBlockSize),
-    m_Algorithm(algorithm),
-    m_HasEmptyBlock(false),
-    m_Blocks(VmaStlAllocator<VmaDeviceMemoryBlock*>(hAllocator->GetAllocationCallbacks())),
-    m_NextBlockId(0)
-{
-}
+        // If not processed, this allocInfo remains in pBlockInfo->m_Allocations for next round.
 
-VmaBlockVector::~VmaBlockVector()
-{
-    for(size_t i = m_Blocks.size(); i--; )
-    {
-        m_Blocks[i]->Destroy(m_hAllocator);
-        vma_delete(m_hAllocator, m_Blocks[i]);
+        if(srcAllocIndex > 0)
+        {
+            --srcAllocIndex;
+        }
+        else
+        {
+            if(srcBlockIndex > 0)
+            {
+                --srcBlockIndex;
+                srcAllocIndex = SIZE_MAX;
+            }
+            else
+            {
+                return VK_SUCCESS;
+            }
+        }
     }
 }
 
-VkResult VmaBlockVector::CreateMinBlocks()
+size_t VmaDefragmentationAlgorithm_Generic::CalcBlocksWithNonMovableCount() const
 {
-    for(size_t i = 0; i < m_MinBlockCount; ++i)
+    size_t result = 0;
+    for(size_t i = 0; i < m_Blocks.size(); ++i)
     {
-        VkResult res = CreateBlock(m_PreferredBlockSize, VMA_NULL);
-        if(res != VK_SUCCESS)
+        if(m_Blocks[i]->m_HasNonMovableAllocations)
         {
-            return res;
+            ++result;
         }
     }
-    return VK_SUCCESS;
+    return result;
 }
 
-void VmaBlockVector::GetPoolStats(VmaPoolStats* pStats)
+VkResult VmaDefragmentationAlgorithm_Generic::Defragment(
+    VmaVector< VmaDefragmentationMove, VmaStlAllocator<VmaDefragmentationMove> >& moves,
+    VkDeviceSize maxBytesToMove,
+    uint32_t maxAllocationsToMove)
 {
-    VmaMutexLockRead lock(m_Mutex, m_hAllocator->m_UseMutex);
+    if(!m_AllAllocations && m_AllocationCount == 0)
+    {
+        return VK_SUCCESS;
+    }
 
     const size_t blockCount = m_Blocks.size();
+    for(size_t blockIndex = 0; blockIndex < blockCount; ++blockIndex)
+    {
+        BlockInfo* pBlockInfo = m_Blocks[blockIndex];
 
-    pStats->size = 0;
-    pStats->unusedSize = 0;
-    pStats->allocationCount = 0;
-    pStats->unusedRangeCount = 0;
-    pStats->unusedRangeSizeMax = 0;
-    pStats->blockCount = blockCount;
+        if(m_AllAllocations)
+        {
+            VmaBlockMetadata_Generic* pMetadata = (VmaBlockMetadata_Generic*)pBlockInfo->m_pBlock->m_pMetadata;
+            for(VmaSuballocationList::const_iterator it = pMetadata->m_Suballocations.begin();
+                it != pMetadata->m_Suballocations.end();
+                ++it)
+            {
+                if(it->type != VMA_SUBALLOCATION_TYPE_FREE)
+                {
+                    AllocationInfo allocInfo = AllocationInfo(it->hAllocation, VMA_NULL);
+                    pBlockInfo->m_Allocations.push_back(allocInfo);
+                }
+            }
+        }
 
-    for(uint32_t blockIndex = 0; blockIndex < blockCount; ++blockIndex)
+        pBlockInfo->CalcHasNonMovableAllocations();
+        
+        // This is a choice based on research.
+        // Option 1:
+        pBlockInfo->SortAllocationsByOffsetDescending();
+        // Option 2:
+        //pBlockInfo->SortAllocationsBySizeDescending();
+    }
+
+    // Sort m_Blocks this time by the main criterium, from most "destination" to most "source" blocks.
+    VMA_SORT(m_Blocks.begin(), m_Blocks.end(), BlockInfoCompareMoveDestination());
+
+    // This is a choice based on research.
+    const uint32_t roundCount = 2;
+
+    // Execute defragmentation rounds (the main part).
+    VkResult result = VK_SUCCESS;
+    for(uint32_t round = 0; (round < roundCount) && (result == VK_SUCCESS); ++round)
     {
-        const VmaDeviceMemoryBlock* const pBlock = m_Blocks[blockIndex];
-        VMA_ASSERT(pBlock);
-        VMA_HEAVY_ASSERT(pBlock->Validate());
-        pBlock->m_pMetadata->AddPoolStats(*pStats);
+        result = DefragmentRound(moves, maxBytesToMove, maxAllocationsToMove);
     }
-}
 
-bool VmaBlockVector::IsCorruptionDetectionEnabled() const
-{
-    const uint32_t requiredMemFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-    return (VMA_DEBUG_DETECT_CORRUPTION != 0) &&
-        (VMA_DEBUG_MARGIN > 0) &&
-        (m_Algorithm == 0 || m_Algorithm == VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT) &&
-        (m_hAllocator->m_MemProps.memoryTypes[m_MemoryTypeIndex].propertyFlags & requiredMemFlags) == requiredMemFlags;
-}
+    CoalesceMoves(moves, m_OverlappingMoveSupported);
 
-static const uint32_t VMA_ALLOCATION_TRY_COUNT = 32;
+    return result;
+}
 
-VkResult VmaBlockVector::Allocate(
-    uint32_t currentFrameIndex,
-    VkDeviceSize size,
-    VkDeviceSize alignment,
-    const VmaAllocationCreateInfo& createInfo,
-    VmaSuballocationType suballocType,
-    size_t allocationCount,
-    VmaAllocation* pAllocations)
+bool VmaDefragmentationAlgorithm_Generic::MoveMakesSense(
+        size_t dstBlockIndex, VkDeviceSize dstOffset,
+        size_t srcBlockIndex, VkDeviceSize srcOffset)
 {
-    size_t allocIndex;
-    VkResult res = VK_SUCCESS;
-
-    if(IsCorruptionDetectionEnabled())
+    if(dstBlockIndex < srcBlockIndex)
     {
-        size = VmaAlignUp<VkDeviceSize>(size, sizeof(VMA_CORRUPTION_DETECTION_MAGIC_VALUE));
-        alignment = VmaAlignUp<VkDeviceSize>(alignment, sizeof(VMA_CORRUPTION_DETECTION_MAGIC_VALUE));
+        return true;
     }
-
+    if(dstBlockIndex > srcBlockIndex)
     {
-        VmaMutexLockWrite lock(m_Mutex, m_hAllocator->m_UseMutex);
-        for(allocIndex = 0; allocIndex < allocationCount; ++allocIndex)
-        {
-            res = AllocatePage(
-                currentFrameIndex,
-                size,
-                alignment,
-                createInfo,
-                suballocType,
-                pAllocations + allocIndex);
-            if(res != VK_SUCCESS)
-            {
-                break;
-            }
-        }
+        return false;
     }
-
-    if(res != VK_SUCCESS)
+    if(dstOffset < srcOffset)
     {
-        // Free all already created allocations.
-        while(allocIndex--)
-        {
-            Free(pAllocations[allocIndex]);
-        }
-        memset(pAllocations, 0, sizeof(VmaAllocation) * allocationCount);
+        return true;
     }
-
-    return res;
+    return false;
 }
 
-VkResult VmaBlockVector::AllocatePage(
+////////////////////////////////////////////////////////////////////////////////
+// VmaDefragmentationAlgorithm_Fast
+
+VmaDefragmentationAlgorithm_Fast::VmaDefragmentationAlgorithm_Fast(
+    VmaAllocator hAllocator,
+    VmaBlockVector* pBlockVector,
     uint32_t currentFrameIndex,
-    VkDeviceSize size,
-    VkDeviceSize alignment,
-    const VmaAllocationCreateInfo& createInfo,
-    VmaSuballocationType suballocType,
-    VmaAllocation* pAllocation)
+    bool overlappingMoveSupported) :
+    VmaDefragmentationAlgorithm(hAllocator, pBlockVector, currentFrameIndex),
+    m_OverlappingMoveSupported(overlappingMoveSupported),
+    m_AllocationCount(0),
+    m_AllAllocations(false),
+    m_BytesMoved(0),
+    m_AllocationsMoved(0),
+    m_BlockInfos(VmaStlAllocator<BlockInfo>(hAllocator->GetAllocationCallbacks()))
 {
-    const bool isUpperAddress = (createInfo.flags & VMA_ALLOCATION_CREATE_UPPER_ADDRESS_BIT) != 0;
-    bool canMakeOtherLost = (createInfo.flags & VMA_ALLOCATION_CREATE_CAN_MAKE_OTHER_LOST_BIT) != 0;
-    const bool mapped = (createInfo.flags & VMA_ALLOCATION_CREATE_MAPPED_BIT) != 0;
-    const bool isUserDataString = (createInfo.flags & VMA_ALLOCATION_CREATE_USER_DATA_COPY_STRING_BIT) != 0;
-    const bool canCreateNewBlock =
-        ((createInfo.flags & VMA_ALLOCATION_CREATE_NEVER_ALLOCATE_BIT) == 0) &&
-        (m_Blocks.size() < m_MaxBlockCount);
-    uint32_t strategy = createInfo.flags & VMA_ALLOCATION_CREATE_STRATEGY_MASK;
+    VMA_ASSERT(VMA_DEBUG_MARGIN == 0);
+
+}
+
+VmaDefragmentationAlgorithm_Fast::~VmaDefragmentationAlgorithm_Fast()
+{
+}
+
+VkResult VmaDefragmentationAlgorithm_Fast::Defragment(
+    VmaVector< VmaDefragmentationMove, VmaStlAllocator<VmaDefragmentationMove> >& moves,
+    VkDeviceSize maxBytesToMove,
+    uint32_t maxAllocationsToMove)
+{
+    VMA_ASSERT(m_AllAllocations || m_pBlockVector->CalcAllocationCount() == m_AllocationCount);
 
-    // If linearAlgorithm is used, canMakeOtherLost is available only when used as ring buffer.
-    // Which in turn is available only when maxBlockCount = 1.
-    if(m_Algorithm == VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT && m_MaxBlockCount > 1)
+    const size_t blockCount = m_pBlockVector->GetBlockCount();
+    if(blockCount == 0 || maxBytesToMove == 0 || maxAllocationsToMove == 0)
     {
-        canMakeOtherLost = false;
+        return VK_SUCCESS;
     }
 
-    // Upper address can only be used with linear allocator and within single memory block.
-    if(isUpperAddress &&
-        (m_Algorithm != VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT || m_MaxBlockCount > 1))
-    {
-        return VK_ERROR_FEATURE_NOT_PRESENT;
-    }
+    PreprocessMetadata();
 
-    // Validate strategy.
-    switch(strategy)
-    {
-    case 0:
-        strategy = VMA_ALLOCATION_CREATE_STRATEGY_BEST_FIT_BIT;
-        break;
-    case VMA_ALLOCATION_CREATE_STRATEGY_BEST_FIT_BIT:
-    case VMA_ALLOCATION_CREATE_STRATEGY_WORST_FIT_BIT:
-    case VMA_ALLOCATION_CREATE_STRATEGY_FIRST_FIT_BIT:
-        break;
-    default:
-        return VK_ERROR_FEATURE_NOT_PRESENT;
-    }
+    // Sort blocks in order from most destination.
 
-    // Early reject: requested allocation size is larger that maximum block size for this block vector.
-    if(size + 2 * VMA_DEBUG_MARGIN > m_PreferredBlockSize)
+    m_BlockInfos.resize(blockCount);
+    for(size_t i = 0; i < blockCount; ++i)
     {
-        return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+        m_BlockInfos[i].origBlockIndex = i;
     }
 
-    /*
-    Under certain condition, this whole section can be skipped for optimization, so
-    we move on directly to trying to allocate with canMakeOtherLost. That's the case
-    e.g. for custom pools with linear algorithm.
-    */
-    if(!canMakeOtherLost || canCreateNewBlock)
-    {
-        // 1. Search existing allocations. Try to allocate without making other allocations lost.
-        VmaAllocationCreateFlags allocFlagsCopy = createInfo.flags;
-        allocFlagsCopy &= ~VMA_ALLOCATION_CREATE_CAN_MAKE_OTHER_LOST_BIT;
+    VMA_SORT(m_BlockInfos.begin(), m_BlockInfos.end(), [this](const BlockInfo& lhs, const BlockInfo& rhs) -> bool {
+        return GetBlockMetadata(lhs.origBlockIndex)->GetSumFreeSize() <
+            GetBlockMetadata(rhs.origBlockIndex)->GetSumFreeSize();
+    });
 
-        if(m_Algorithm == VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT)
+    // THE MAIN ALGORITHM
+
+    FreeSpaceDatabase freeSpaceDb;
+
+    size_t dstBlockInfoIndex = 0;
+    size_t dstOrigBlockIndex = m_BlockInfos[dstBlockInfoIndex].origBlockIndex;
+    VmaDeviceMemoryBlock* pDstBlock = m_pBlockVector->GetBlock(dstOrigBlockIndex);
+    VmaBlockMetadata_Generic* pDstMetadata = (VmaBlockMetadata_Generic*)GetBlockMetadata(dstOrigBlockIndex);
+    VkDeviceSize dstBlockSize = pDstMetadata->GetSize();
+    VkDeviceSize dstOffset = 0;
+
+    bool end = false;
+    for(size_t srcBlockInfoIndex = 0; !end && srcBlockInfoIndex < blockCount; ++srcBlockInfoIndex)
+    {
+        const size_t srcOrigBlockIndex = m_BlockInfos[srcBlockInfoIndex].origBlockIndex;
+        VmaBlockMetadata_Generic* const pSrcMetadata = (VmaBlockMetadata_Generic*)GetBlockMetadata(srcOrigBlockIndex);
+        for(VmaSuballocationList::iterator srcSuballocIt = pSrcMetadata->m_Suballocations.begin();
+            !end && srcSuballocIt != pSrcMetadata->m_Suballocations.end(); )
         {
-            // Use only last block.
-            if(!m_Blocks.empty())
+            VmaAllocation_T* const pAlloc = srcSuballocIt->hAllocation;
+            const VkDeviceSize srcAllocAlignment = pAlloc->GetAlignment();
+            const VkDeviceSize srcAllocSize = srcSuballocIt->size;
+            if(m_AllocationsMoved == maxAllocationsToMove ||
+                m_BytesMoved + srcAllocSize > maxBytesToMove)
             {
-                VmaDeviceMemoryBlock* const pCurrBlock = m_Blocks.back();
-                VMA_ASSERT(pCurrBlock);
-                VkResult res = AllocateFromBlock(
-                    pCurrBlock,
-                    currentFrameIndex,
-                    size,
-                    alignment,
-                    allocFlagsCopy,
-                    createInfo.pUserData,
-                    suballocType,
-                    strategy,
-                    pAllocation);
-                if(res == VK_SUCCESS)
-                {
-                    VMA_DEBUG_LOG("    Returned from last block #%u", (uint32_t)(m_Blocks.size() - 1));
-                    return VK_SUCCESS;
-                }
+                end = true;
+                break;
             }
-        }
-        else
-        {
-            if(strategy == VMA_ALLOCATION_CREATE_STRATEGY_BEST_FIT_BIT)
+            const VkDeviceSize srcAllocOffset = srcSuballocIt->offset;
+
+            // Try to place it in one of free spaces from the database.
+            size_t freeSpaceInfoIndex;
+            VkDeviceSize dstAllocOffset;
+            if(freeSpaceDb.Fetch(srcAllocAlignment, srcAllocSize,
+                freeSpaceInfoIndex, dstAllocOffset))
             {
-                // Forward order in m_Blocks - prefer blocks with smallest amount of free space.
-                for(size_t blockIndex = 0; blockIndex < m_Blocks.size(); ++blockIndex )
+                size_t freeSpaceOrigBlockIndex = m_BlockInfos[freeSpaceInfoIndex].origBlockIndex;
+                VmaDeviceMemoryBlock* pFreeSpaceBlock = m_pBlockVector->GetBlock(freeSpaceOrigBlockIndex);
+                VmaBlockMetadata_Generic* pFreeSpaceMetadata = (VmaBlockMetadata_Generic*)GetBlockMetadata(freeSpaceOrigBlockIndex);
+
+                // Same block
+                if(freeSpaceInfoIndex == srcBlockInfoIndex)
                 {
-                    VmaDeviceMemoryBlock* const pCurrBlock = m_Blocks[blockIndex];
-                    VMA_ASSERT(pCurrBlock);
-                    VkResult res = AllocateFromBlock(
-                        pCurrBlock,
-                        currentFrameIndex,
-                        size,
-                        alignment,
-                        allocFlagsCopy,
-                        createInfo.pUserData,
-                        suballocType,
-                        strategy,
-                        pAllocation);
-                    if(res == VK_SUCCESS)
+                    VMA_ASSERT(dstAllocOffset <= srcAllocOffset);
+
+                    // MOVE OPTION 1: Move the allocation inside the same block by decreasing offset.
+
+                    VmaSuballocation suballoc = *srcSuballocIt;
+                    suballoc.offset = dstAllocOffset;
+                    if(!IsDryRun())
                     {
-                        VMA_DEBUG_LOG("    Returned from existing block #%u", (uint32_t)blockIndex);
-                        return VK_SUCCESS;
+                        suballoc.hAllocation->ChangeOffset(dstAllocOffset);
+                        OnAllocationMoved(suballoc.hAllocation, VMA_NULL);
                     }
+                    m_BytesMoved += srcAllocSize;
+                    ++m_AllocationsMoved;
+                    
+                    VmaSuballocationList::iterator nextSuballocIt = srcSuballocIt;
+                    ++nextSuballocIt;
+                    pSrcMetadata->m_Suballocations.erase(srcSuballocIt);
+                    srcSuballocIt = nextSuballocIt;
+
+                    InsertSuballoc(pFreeSpaceMetadata, suballoc);
+
+                    VmaDefragmentationMove move = {
+                        srcOrigBlockIndex, freeSpaceOrigBlockIndex,
+                        srcAllocOffset, dstAllocOffset,
+                        srcAllocSize };
+                    moves.push_back(move);
                 }
-            }
-            else // WORST_FIT, FIRST_FIT
-            {
-                // Backward order in m_Blocks - prefer blocks with largest amount of free space.
-                for(size_t blockIndex = m_Blocks.size(); blockIndex--; )
+                // Different block
+                else
                 {
-                    VmaDeviceMemoryBlock* const pCurrBlock = m_Blocks[blockIndex];
-                    VMA_ASSERT(pCurrBlock);
-                    VkResult res = AllocateFromBlock(
-                        pCurrBlock,
-                        currentFrameIndex,
-                        size,
-                        alignment,
-                        allocFlagsCopy,
-                        createInfo.pUserData,
-                        suballocType,
-                        strategy,
-                        pAllocation);
-                    if(res == VK_SUCCESS)
+                    // MOVE OPTION 2: Move the allocation to a different block.
+
+                    VMA_ASSERT(freeSpaceInfoIndex < srcBlockInfoIndex);
+
+                    VmaSuballocation suballoc = *srcSuballocIt;
+                    suballoc.offset = dstAllocOffset;
+                    if(!IsDryRun())
                     {
-                        VMA_DEBUG_LOG("    Returned from existing block #%u", (uint32_t)blockIndex);
-                        return VK_SUCCESS;
+                        suballoc.hAllocation->ChangeBlockAllocation(m_hAllocator, pFreeSpaceBlock, dstAllocOffset);
+                        OnAllocationMoved(suballoc.hAllocation, VMA_NULL);
                     }
+                    m_BytesMoved += srcAllocSize;
+                    ++m_AllocationsMoved;
+
+                    VmaSuballocationList::iterator nextSuballocIt = srcSuballocIt;
+                    ++nextSuballocIt;
+                    pSrcMetadata->m_Suballocations.erase(srcSuballocIt);
+                    srcSuballocIt = nextSuballocIt;
+
+                    InsertSuballoc(pFreeSpaceMetadata, suballoc);
+
+                    VmaDefragmentationMove move = {
+                        srcOrigBlockIndex, freeSpaceOrigBlockIndex,
+                        srcAllocOffset, dstAllocOffset,
+                        srcAllocSize };
+                    moves.push_back(move);
                 }
             }
-        }
+            else
+            {
+                dstAllocOffset = VmaAlignUp(dstOffset, srcAllocAlignment);
 
-        // 2. Try to create new block.
-        if(canCreateNewBlock)
-        {
-            // Calculate optimal size for new block.
-            VkDeviceSize newBlockSize = m_PreferredBlockSize;
-            uint32_t newBlockSizeShift = 0;
-            const uint32_t NEW_BLOCK_SIZE_SHIFT_MAX = 3;
+                // If the allocation doesn't fit before the end of dstBlock, forward to next block.
+                while(dstBlockInfoIndex < srcBlockInfoIndex &&
+                    dstAllocOffset + srcAllocSize > dstBlockSize)
+                {
+                    // But before that, register remaining free space at the end of dst block.
+                    freeSpaceDb.Register(dstBlockInfoIndex, dstOffset, dstBlockSize - dstOffset);
 
-            if(!m_ExplicitBlockSize)
-            {
-                // Allocate 1/8, 1/4, 1/2 as first blocks.
-                const VkDeviceSize maxExistingBlockSize = CalcMaxBlockSize();
-                for(uint32_t i = 0; i < NEW_BLOCK_SIZE_SHIFT_MAX; ++i)
+                    ++dstBlockInfoIndex;
+                    dstOrigBlockIndex = m_BlockInfos[dstBlockInfoIndex].origBlockIndex;
+                    pDstBlock = m_pBlockVector->GetBlock(dstOrigBlockIndex);
+                    pDstMetadata = (VmaBlockMetadata_Generic*)GetBlockMetadata(dstOrigBlockIndex);
+                    dstBlockSize = pDstMetadata->GetSize();
+                    dstOffset = 0;
+                    dstAllocOffset = 0;
+                }
+
+                // Same block
+                if(dstBlockInfoIndex == srcBlockInfoIndex)
                 {
-                    const VkDeviceSize smallerNewBlockSize = newBlockSize / 2;
-                    if(smallerNewBlockSize > maxExistingBlockSize && smallerNewBlockSize >= size * 2)
+                    VMA_ASSERT(dstAllocOffset <= srcAllocOffset);
+
+                    const bool overlap = dstAllocOffset + srcAllocSize > srcAllocOffset;
+
+                    bool skipOver = overlap;
+                    if(overlap && m_OverlappingMoveSupported && dstAllocOffset < srcAllocOffset)
                     {
-                        newBlockSize = smallerNewBlockSize;
-                        ++newBlockSizeShift;
+                        // If destination and source place overlap, skip if it would move it
+                        // by only < 1/64 of its size.
+                        skipOver = (srcAllocOffset - dstAllocOffset) * 64 < srcAllocSize;
                     }
-                    else
+
+                    if(skipOver)
                     {
-                        break;
-                    }
-                }
-            }
+                        freeSpaceDb.Register(dstBlockInfoIndex, dstOffset, srcAllocOffset - dstOffset);
 
-            size_t newBlockIndex = 0;
-            VkResult res = CreateBlock(newBlockSize, &newBlockIndex);
-            // Allocation of this size failed? Try 1/2, 1/4, 1/8 of m_PreferredBlockSize.
-            if(!m_ExplicitBlockSize)
-            {
-                while(res < 0 && newBlockSizeShift < NEW_BLOCK_SIZE_SHIFT_MAX)
-                {
-                    const VkDeviceSize smallerNewBlockSize = newBlockSize / 2;
-                    if(smallerNewBlockSize >= size)
+                        dstOffset = srcAllocOffset + srcAllocSize;
+                        ++srcSuballocIt;
+                    }
+                    // MOVE OPTION 1: Move the allocation inside the same block by decreasing offset.
+                    else
                     {
-                        newBlockSize = smallerNewBlockSize;
-                        ++newBlockSizeShift;
-                        res = CreateBlock(newBlockSize, &newBlockIndex);
+                        srcSuballocIt->offset = dstAllocOffset;
+                        if(!IsDryRun())
+                        {
+                            srcSuballocIt->hAllocation->ChangeOffset(dstAllocOffset);
+                            OnAllocationMoved(srcSuballocIt->hAllocation, VMA_NULL);
+                        }
+                        dstOffset = dstAllocOffset + srcAllocSize;
+                        m_BytesMoved += srcAllocSize;
+                        ++m_AllocationsMoved;
+                        ++srcSuballocIt;
+                        VmaDefragmentationMove move = {
+                            srcOrigBlockIndex, dstOrigBlockIndex,
+                            srcAllocOffset, dstAllocOffset,
+                            srcAllocSize };
+                        moves.push_back(move);
                     }
-                    else
+                }
+                // Different block
+                else
+                {
+                    // MOVE OPTION 2: Move the allocation to a different block.
+
+                    VMA_ASSERT(dstBlockInfoIndex < srcBlockInfoIndex);
+                    VMA_ASSERT(dstAllocOffset + srcAllocSize <= dstBlockSize);
+
+                    VmaSuballocation suballoc = *srcSuballocIt;
+                    suballoc.offset = dstAllocOffset;
+                    if(!IsDryRun())
                     {
-                        break;
+                        suballoc.hAllocation->ChangeBlockAllocation(m_hAllocator, pDstBlock, dstAllocOffset);
+                        OnAllocationMoved(suballoc.hAllocation, VMA_NULL);
                     }
-                }
-            }
+                    dstOffset = dstAllocOffset + srcAllocSize;
+                    m_BytesMoved += srcAllocSize;
+                    ++m_AllocationsMoved;
 
-            if(res == VK_SUCCESS)
-            {
-                VmaDeviceMemoryBlock* const pBlock = m_Blocks[newBlockIndex];
-                VMA_ASSERT(pBlock->m_pMetadata->GetSize() >= size);
+                    VmaSuballocationList::iterator nextSuballocIt = srcSuballocIt;
+                    ++nextSuballocIt;
+                    pSrcMetadata->m_Suballocations.erase(srcSuballocIt);
+                    srcSuballocIt = nextSuballocIt;
 
-                res = AllocateFromBlock(
-                    pBlock,
-                    currentFrameIndex,
-                    size,
-                    alignment,
-                    allocFlagsCopy,
-                    createInfo.pUserData,
-                    suballocType,
-                    strategy,
-                    pAllocation);
-                if(res == VK_SUCCESS)
-                {
-                    VMA_DEBUG_LOG("    Created new block Size=%llu", newBlockSize);
-                    return VK_SUCCESS;
-                }
-                else
-                {
-                    // Allocation from new block failed, possibly due to VMA_DEBUG_MARGIN or alignment.
-                    return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+                    pDstMetadata->m_Suballocations.push_back(suballoc);
+
+                    VmaDefragmentationMove move = {
+                        srcOrigBlockIndex, dstOrigBlockIndex,
+                        srcAllocOffset, dstAllocOffset,
+                        srcAllocSize };
+                    moves.push_back(move);
                 }
             }
         }
     }
 
-    // 3. Try to allocate from existing blocks with making other allocations lost.
-    if(canMakeOtherLost)
+    m_BlockInfos.clear();
+    
+    PostprocessMetadata();
+
+    CoalesceMoves(moves, m_OverlappingMoveSupported);
+
+    return VK_SUCCESS;
+}
+
+void VmaDefragmentationAlgorithm_Fast::PreprocessMetadata()
+{
+    const size_t blockCount = m_pBlockVector->GetBlockCount();
+    for(size_t blockIndex = 0; blockIndex < blockCount; ++blockIndex)
     {
-        uint32_t tryIndex = 0;
-        for(; tryIndex < VMA_ALLOCATION_TRY_COUNT; ++tryIndex)
+        VmaBlockMetadata_Generic* const pMetadata =
+            (VmaBlockMetadata_Generic*)GetBlockMetadata(blockIndex);
+        pMetadata->m_FreeCount = 0;
+        pMetadata->m_SumFreeSize = pMetadata->GetSize();
+        pMetadata->m_FreeSuballocationsBySize.clear();
+        for(VmaSuballocationList::iterator it = pMetadata->m_Suballocations.begin();
+            it != pMetadata->m_Suballocations.end(); )
         {
-            VmaDeviceMemoryBlock* pBestRequestBlock = VMA_NULL;
-            VmaAllocationRequest bestRequest = {};
-            VkDeviceSize bestRequestCost = VK_WHOLE_SIZE;
-
-            // 1. Search existing allocations.
-            if(strategy == VMA_ALLOCATION_CREATE_STRATEGY_BEST_FIT_BIT)
+            if(it->type == VMA_SUBALLOCATION_TYPE_FREE)
             {
-                // Forward order in m_Blocks - prefer blocks with smallest amount of free space.
-                for(size_t blockIndex = 0; blockIndex < m_Blocks.size(); ++blockIndex )
-                {
-                    VmaDeviceMemoryBlock* const pCurrBlock = m_Blocks[blockIndex];
-                    VMA_ASSERT(pCurrBlock);
-                    VmaAllocationRequest currRequest = {};
-                    if(pCurrBlock->m_pMetadata->CreateAllocationRequest(
-                        currentFrameIndex,
-                        m_FrameInUseCount,
-                        m_BufferImageGranularity,
-                        size,
-                        alignment,
-                        (createInfo.flags & VMA_ALLOCATION_CREATE_UPPER_ADDRESS_BIT) != 0,
-                        suballocType,
-                        canMakeOtherLost,
-                        strategy,
-                        &currRequest))
-                    {
-                        const VkDeviceSize currRequestCost = currRequest.CalcCost();
-                        if(pBestRequestBlock == VMA_NULL ||
-                            currRequestCost < bestRequestCost)
-                        {
-                            pBestRequestBlock = pCurrBlock;
-                            bestRequest = currRequest;
-                            bestRequestCost = currRequestCost;
-
-                            if(bestRequestCost == 0)
-                            {
-                                break;
-                            }
-                        }
-                    }
-                }
+                VmaSuballocationList::iterator nextIt = it;
+                ++nextIt;
+                pMetadata->m_Suballocations.erase(it);
+                it = nextIt;
             }
-            else // WORST_FIT, FIRST_FIT
+            else
             {
-                // Backward order in m_Blocks - prefer blocks with largest amount of free space.
-                for(size_t blockIndex = m_Blocks.size(); blockIndex--; )
-                {
-                    VmaDeviceMemoryBlock* const pCurrBlock = m_Blocks[blockIndex];
-                    VMA_ASSERT(pCurrBlock);
-                    VmaAllocationRequest currRequest = {};
-                    if(pCurrBlock->m_pMetadata->CreateAllocationRequest(
-                        currentFrameIndex,
-                        m_FrameInUseCount,
-                        m_BufferImageGranularity,
-                        size,
-                        alignment,
-                        (createInfo.flags & VMA_ALLOCATION_CREATE_UPPER_ADDRESS_BIT) != 0,
-                        suballocType,
-                        canMakeOtherLost,
-                        strategy,
-                        &currRequest))
-                    {
-                        const VkDeviceSize currRequestCost = currRequest.CalcCost();
-                        if(pBestRequestBlock == VMA_NULL ||
-                            currRequestCost < bestRequestCost ||
-                            strategy == VMA_ALLOCATION_CREATE_STRATEGY_FIRST_FIT_BIT)
-                        {
-                            pBestRequestBlock = pCurrBlock;
-                            bestRequest = currRequest;
-                            bestRequestCost = currRequestCost;
-
-                            if(bestRequestCost == 0 ||
-                                strategy == VMA_ALLOCATION_CREATE_STRATEGY_FIRST_FIT_BIT)
-                            {
-                                break;
-                            }
-                        }
-                    }
-                }
+                ++it;
             }
+        }
+    }
+}
 
-            if(pBestRequestBlock != VMA_NULL)
+void VmaDefragmentationAlgorithm_Fast::PostprocessMetadata()
+{
+    const size_t blockCount = m_pBlockVector->GetBlockCount();
+    for(size_t blockIndex = 0; blockIndex < blockCount; ++blockIndex)
+    {
+        VmaBlockMetadata_Generic* const pMetadata =
+            (VmaBlockMetadata_Generic*)GetBlockMetadata(blockIndex);
+        const VkDeviceSize blockSize = pMetadata->GetSize();
+        
+        // No allocations in this block - entire area is free.
+        if(pMetadata->m_Suballocations.empty())
+        {
+            pMetadata->m_FreeCount = 1;
+            //pMetadata->m_SumFreeSize is already set to blockSize.
+            VmaSuballocation suballoc = {
+                0, // offset
+                blockSize, // size
+                VMA_NULL, // hAllocation
+                VMA_SUBALLOCATION_TYPE_FREE };
+            pMetadata->m_Suballocations.push_back(suballoc);
+            pMetadata->RegisterFreeSuballocation(pMetadata->m_Suballocations.begin());
+        }
+        // There are some allocations in this block.
+        else
+        {
+            VkDeviceSize offset = 0;
+            VmaSuballocationList::iterator it;
+            for(it = pMetadata->m_Suballocations.begin();
+                it != pMetadata->m_Suballocations.end();
+                ++it)
             {
-                if(mapped)
-                {
-                    VkResult res = pBestRequestBlock->Map(m_hAllocator, 1, VMA_NULL);
-                    if(res != VK_SUCCESS)
-                    {
-                        return res;
-                    }
-                }
+                VMA_ASSERT(it->type != VMA_SUBALLOCATION_TYPE_FREE);
+                VMA_ASSERT(it->offset >= offset);
 
-                if(pBestRequestBlock->m_pMetadata->MakeRequestedAllocationsLost(
-                    currentFrameIndex,
-                    m_FrameInUseCount,
-                    &bestRequest))
+                // Need to insert preceding free space.
+                if(it->offset > offset)
                 {
-                    // We no longer have an empty Allocation.
-                    if(pBestRequestBlock->m_pMetadata->IsEmpty())
-                    {
-                        m_HasEmptyBlock = false;
-                    }
-                    // Allocate from this pBlock.
-                    *pAllocation = m_hAllocator->m_AllocationObjectAllocator.Allocate();
-                    (*pAllocation)->Ctor(currentFrameIndex, isUserDataString);
-                    pBestRequestBlock->m_pMetadata->Alloc(bestRequest, suballocType, size, *pAllocation);
-                    (*pAllocation)->InitBlockAllocation(
-                        pBestRequestBlock,
-                        bestRequest.offset,
-                        alignment,
-                        size,
-                        suballocType,
-                        mapped,
-                        (createInfo.flags & VMA_ALLOCATION_CREATE_CAN_BECOME_LOST_BIT) != 0);
-                    VMA_HEAVY_ASSERT(pBestRequestBlock->Validate());
-                    VMA_DEBUG_LOG("    Returned from existing block");
-                    (*pAllocation)->SetUserData(m_hAllocator, createInfo.pUserData);
-                    if(VMA_DEBUG_INITIALIZE_ALLOCATIONS)
-                    {
-                        m_hAllocator->FillAllocation(*pAllocation, VMA_ALLOCATION_FILL_PATTERN_CREATED);
-                    }
-                    if(IsCorruptionDetectionEnabled())
+                    ++pMetadata->m_FreeCount;
+                    const VkDeviceSize freeSize = it->offset - offset;
+                    VmaSuballocation suballoc = {
+                        offset, // offset
+                        freeSize, // size
+                        VMA_NULL, // hAllocation
+                        VMA_SUBALLOCATION_TYPE_FREE };
+                    VmaSuballocationList::iterator precedingFreeIt = pMetadata->m_Suballocations.insert(it, suballoc);
+                    if(freeSize >= VMA_MIN_FREE_SUBALLOCATION_SIZE_TO_REGISTER)
                     {
-                        VkResult res = pBestRequestBlock->WriteMagicValueAroundAllocation(m_hAllocator, bestRequest.offset, size);
-                        VMA_ASSERT(res == VK_SUCCESS && "Couldn't map block memory to write magic value.");
+                        pMetadata->m_FreeSuballocationsBySize.push_back(precedingFreeIt);
                     }
-                    return VK_SUCCESS;
                 }
-                // else: Some allocations must have been touched while we are here. Next try.
+
+                pMetadata->m_SumFreeSize -= it->size;
+                offset = it->offset + it->size;
             }
-            else
+
+            // Need to insert trailing free space.
+            if(offset < blockSize)
             {
-                // Could not find place in any of the blocks - break outer loop.
-                break;
+                ++pMetadata->m_FreeCount;
+                const VkDeviceSize freeSize = blockSize - offset;
+                VmaSuballocation suballoc = {
+                    offset, // offset
+                    freeSize, // size
+                    VMA_NULL, // hAllocation
+                    VMA_SUBALLOCATION_TYPE_FREE };
+                VMA_ASSERT(it == pMetadata->m_Suballocations.end());
+                VmaSuballocationList::iterator trailingFreeIt = pMetadata->m_Suballocations.insert(it, suballoc);
+                if(freeSize > VMA_MIN_FREE_SUBALLOCATION_SIZE_TO_REGISTER)
+                {
+                    pMetadata->m_FreeSuballocationsBySize.push_back(trailingFreeIt);
+                }
             }
+
+            VMA_SORT(
+                pMetadata->m_FreeSuballocationsBySize.begin(),
+                pMetadata->m_FreeSuballocationsBySize.end(),
+                VmaSuballocationItemSizeLess());
         }
-        /* Maximum number of tries exceeded - a very unlike event when many other
-        threads are simultaneously touching allocations making it impossible to make
-        lost at the same time as we try to allocate. */
-        if(tryIndex == VMA_ALLOCATION_TRY_COUNT)
+
+        VMA_HEAVY_ASSERT(pMetadata->Validate());
+    }
+}
+
+void VmaDefragmentationAlgorithm_Fast::InsertSuballoc(VmaBlockMetadata_Generic* pMetadata, const VmaSuballocation& suballoc)
+{
+    // TODO: Optimize somehow. Remember iterator instead of searching for it linearly.
+    VmaSuballocationList::iterator it = pMetadata->m_Suballocations.begin();
+    while(it != pMetadata->m_Suballocations.end())
+    {
+        if(it->offset < suballoc.offset)
         {
-            return VK_ERROR_TOO_MANY_OBJECTS;
+            ++it;
+        }
+        else
+        {
+            break;
         }
     }
+    pMetadata->m_Suballocations.insert(it, suballoc);
+}
 
-    return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+////////////////////////////////////////////////////////////////////////////////
+// VmaDefragmentationAlgorithm_BestFit
+
+VmaDefragmentationAlgorithm_BestFit::VmaDefragmentationAlgorithm_BestFit(
+    VmaAllocator hAllocator,
+    VmaBlockVector* pBlockVector,
+    uint32_t currentFrameIndex,
+    bool overlappingMoveSupported) :
+    VmaDefragmentationAlgorithm(hAllocator, pBlockVector, currentFrameIndex),
+    m_OverlappingMoveSupported(overlappingMoveSupported),
+    m_AllAllocations(false),
+    m_Allocations(VmaStlAllocator<AllocationInfo>(hAllocator->GetAllocationCallbacks())),
+    m_BytesMoved(0),
+    m_AllocationsMoved(0),
+    m_BlockInfos(VmaStlAllocator<BlockInfo>(hAllocator->GetAllocationCallbacks())),
+    m_FreeRanges(VmaStlAllocator<FreeRange>(hAllocator->GetAllocationCallbacks()))
+{
 }
 
-void VmaBlockVector::Free(
-    VmaAllocation hAllocation)
+VmaDefragmentationAlgorithm_BestFit::~VmaDefragmentationAlgorithm_BestFit()
 {
-    VmaDeviceMemoryBlock* pBlockToDelete = VMA_NULL;
+}
 
-    // Scope for lock.
+void VmaDefragmentationAlgorithm_BestFit::AddAllocation(VmaAllocation hAlloc, VkBool32* pChanged)
+{
+    // Now as we are inside VmaBlockVector::m_Mutex, we can make final check if this allocation was not lost.
+    if(hAlloc->GetLastUseFrameIndex() != VMA_FRAME_INDEX_LOST)
     {
-        VmaMutexLockWrite lock(m_Mutex, m_hAllocator->m_UseMutex);
-
-        VmaDeviceMemoryBlock* pBlock = hAllocation->GetBlock();
+        m_Allocations.push_back(AllocationInfo(hAlloc, pChanged));
+    }
+}
 
-        if(IsCorruptionDetectionEnabled())
-        {
-            VkResult res = pBlock->ValidateMagicValueAroundAllocation(m_hAllocator, hAllocation->GetOffset(), hAllocation->GetSize());
-            VMA_ASSERT(res == VK_SUCCESS && "Couldn't map block memory to validate magic value.");
-        }
+VkResult VmaDefragmentationAlgorithm_BestFit::Defragment(
+    VmaVector< VmaDefragmentationMove, VmaStlAllocator<VmaDefragmentationMove> >& moves,
+    VkDeviceSize maxBytesToMove,
+    uint32_t maxAllocationsToMove)
+{
+    const size_t blockCount = m_pBlockVector->GetBlockCount();
+    if((!m_AllAllocations && m_Allocations.empty()) ||
+        blockCount == 0 || maxBytesToMove == 0 || maxAllocationsToMove == 0)
+    {
+        return VK_SUCCESS;
+    }
 
-        if(hAllocation->IsPersistentMap())
-        {
-            pBlock->Unmap(m_hAllocator, 1);
-        }
+    VMA_SORT(m_Allocations.begin(), m_Allocations.end(), AllocationInfoHandleLess());
 
-        pBlock->m_pMetadata->Free(hAllocation);
-        VMA_HEAVY_ASSERT(pBlock->Validate());
+    // Find suballocations of allocations to move. blockInfoIndex is temporarily original block index.
 
-        VMA_DEBUG_LOG("  Freed from MemoryTypeIndex=%u", m_MemoryTypeIndex);
+    m_BlockInfos.resize(blockCount);
+    for(size_t blockIndex = 0; blockIndex < blockCount; ++blockIndex)
+    {
+        m_BlockInfos[blockIndex].origBlockIndex = blockIndex;
+        m_BlockInfos[blockIndex].movableAllocationCount = 0;
+        m_BlockInfos[blockIndex].movableBytes = 0;
+    }
 
-        // pBlock became empty after this deallocation.
-        if(pBlock->m_pMetadata->IsEmpty())
+    VmaVector< MoveSource, VmaStlAllocator<MoveSource> > sources =
+        VmaVector< MoveSource, VmaStlAllocator<MoveSource> >(VmaStlAllocator<MoveSource>(m_hAllocator->GetAllocationCallbacks()));
+    for(size_t blockIndex = 0; blockIndex < blockCount; ++blockIndex)
+    {
+        VmaBlockMetadata_Generic* const pMetadata = GetBlockInfoMetadata(blockIndex);
+        for(VmaSuballocationList::iterator it = pMetadata->m_Suballocations.begin();
+            it != pMetadata->m_Suballocations.end();
+            ++it)
         {
-            // Already has empty Allocation. We don't want to have two, so delete this one.
-            if(m_HasEmptyBlock && m_Blocks.size() > m_MinBlockCount)
+            if(it->type == VMA_SUBALLOCATION_TYPE_FREE)
             {
-                pBlockToDelete = pBlock;
-                Remove(pBlock);
+                continue;
             }
-            // We now have first empty block.
-            else
+            MoveSource source = { blockIndex, it, VMA_NULL };
+            if(!m_AllAllocations)
             {
-                m_HasEmptyBlock = true;
+                const AllocationInfo* const pAllocInfo = VmaBinaryFindFirstNotLess(
+                    m_Allocations.data(),
+                    m_Allocations.data() + m_Allocations.size(),
+                    it->hAllocation,
+                    AllocationInfoHandleLess());
+                if(pAllocInfo == m_Allocations.data() + m_Allocations.size() ||
+                    pAllocInfo->m_hAllocation != it->hAllocation)
+                {
+                    continue;
+                }
+                source.pChanged = pAllocInfo->m_pChanged;
             }
+            sources.push_back(source);
+            ++m_BlockInfos[blockIndex].movableAllocationCount;
+            m_BlockInfos[blockIndex].movableBytes += it->size;
         }
-        // pBlock didn't become empty, but we have another empty block - find and free that one.
-        // (This is optional, heuristics.)
-        else if(m_HasEmptyBlock)
+    }
+
+    // Sort blocks from most "destination" to most "source":
+    // 1. Blocks with some non-movable allocations go first.
+    // 2. Blocks with smaller sumFreeSize go first.
+    VMA_SORT(m_BlockInfos.begin(), m_BlockInfos.end(), [this](const BlockInfo& lhs, const BlockInfo& rhs) -> bool {
+        const VmaBlockMetadata* const pLhsMetadata = GetBlockMetadata(lhs.origBlockIndex);
+        const VmaBlockMetadata* const pRhsMetadata = GetBlockMetadata(rhs.origBlockIndex);
+        const bool lhsHasNonMovable = pLhsMetadata->GetAllocationCount() != lhs.movableAllocationCount;
+        const bool rhsHasNonMovable = pRhsMetadata->GetAllocationCount() != rhs.movableAllocationCount;
+        if(lhsHasNonMovable != rhsHasNonMovable)
         {
-            VmaDeviceMemoryBlock* pLastBlock = m_Blocks.back();
-            if(pLastBlock->m_pMetadata->IsEmpty() && m_Blocks.size() > m_MinBlockCount)
-            {
-                pBlockToDelete = pLastBlock;
-                m_Blocks.pop_back();
-                m_HasEmptyBlock = false;
-            }
+            return lhsHasNonMovable;
         }
+        return pLhsMetadata->GetSumFreeSize() < pRhsMetadata->GetSumFreeSize();
+    });
 
-        IncrementallySortBlocks();
+    VmaVector< size_t, VmaStlAllocator<size_t> > blockInfoIndexByOrigIndex(
+        blockCount, SIZE_MAX, VmaStlAllocator<size_t>(m_hAllocator->GetAllocationCallbacks()));
+    for(size_t blockInfoIndex = 0; blockInfoIndex < blockCount; ++blockInfoIndex)
+    {
+        blockInfoIndexByOrigIndex[m_BlockInfos[blockInfoIndex].origBlockIndex] = blockInfoIndex;
     }
-
-    // Destruction of a free Allocation. Deferred until this point, outside of mutex
-    // lock, for performance reason.
-    if(pBlockToDelete != VMA_NULL)
+    for(size_t sourceIndex = 0; sourceIndex < sources.size(); ++sourceIndex)
     {
-        VMA_DEBUG_LOG("    Deleted empty allocation");
-        pBlockToDelete->Destroy(m_hAllocator);
-        vma_delete(m_hAllocator, pBlockToDelete);
+        sources[sourceIndex].blockInfoIndex = blockInfoIndexByOrigIndex[sources[sourceIndex].blockInfoIndex];
     }
-}
+    VMA_SORT(sources.begin(), sources.end(), MoveSourceLess());
 
-VkDeviceSize VmaBlockVector::CalcMaxBlockSize() const
-{
-    VkDeviceSize result = 0;
-    for(size_t i = m_Blocks.size(); i--; )
+    /*
+    Round 1: Find the longest sequence of most "source" blocks that have only movable
+    allocations, which fit into free space of the remaining blocks, and try to empty them,
+    starting from the biggest allocations. This is what makes whole blocks free.
+    */
+    VkDeviceSize sumFreeSize = 0;
+    for(size_t blockInfoIndex = 0; blockInfoIndex < blockCount; ++blockInfoIndex)
     {
-        result = VMA_MAX(result, m_Blocks[i]->m_pMetadata->GetSize());
-        if(result >= m_PreferredBlockSize)
+        sumFreeSize += GetBlockInfoMetadata(blockInfoIndex)->GetSumFreeSize();
+    }
+    size_t firstEmptiedBlockInfoIndex = blockCount;
+    VkDeviceSize emptiedMovableBytes = 0;
+    VkDeviceSize emptiedFreeSize = 0;
+    for(size_t blockInfoIndex = blockCount; blockInfoIndex--; )
+    {
+        const BlockInfo& blockInfo = m_BlockInfos[blockInfoIndex];
+        const VmaBlockMetadata_Generic* const pMetadata = GetBlockInfoMetadata(blockInfoIndex);
+        emptiedMovableBytes += blockInfo.movableBytes;
+        emptiedFreeSize += pMetadata->GetSumFreeSize();
+        if(pMetadata->GetAllocationCount() != blockInfo.movableAllocationCount ||
+            emptiedMovableBytes > sumFreeSize - emptiedFreeSize)
         {
             break;
         }
+        firstEmptiedBlockInfoIndex = blockInfoIndex;
     }
-    return result;
-}
 
-void VmaBlockVector::Remove(VmaDeviceMemoryBlock* pBlock)
-{
-    for(uint32_t blockIndex = 0; blockIndex < m_Blocks.size(); ++blockIndex)
+    size_t firstEmptiedSourceIndex = sources.size();
+    while(firstEmptiedSourceIndex > 0 &&
+        sources[firstEmptiedSourceIndex - 1].blockInfoIndex >= firstEmptiedBlockInfoIndex)
     {
-        if(m_Blocks[blockIndex] == pBlock)
+        --firstEmptiedSourceIndex;
+    }
+    VmaVector< MoveSource, VmaStlAllocator<MoveSource> > emptiedSources =
+        VmaVector< MoveSource, VmaStlAllocator<MoveSource> >(VmaStlAllocator<MoveSource>(m_hAllocator->GetAllocationCallbacks()));
+    for(size_t sourceIndex = firstEmptiedSourceIndex; sourceIndex < sources.size(); ++sourceIndex)
+    {
+        emptiedSources.push_back(sources[sourceIndex]);
+    }
+    sources.resize(firstEmptiedSourceIndex);
+    VMA_SORT(emptiedSources.begin(), emptiedSources.end(), MoveSourceSizeLess());
+
+    bool limitReached = DefragmentRound(
+        emptiedSources, firstEmptiedBlockInfoIndex, moves, maxBytesToMove, maxAllocationsToMove);
+
+    // Round 2: Move remaining allocations to free ranges anywhere before them.
+    if(!limitReached)
+    {
+        for(size_t sourceIndex = 0; sourceIndex < emptiedSources.size(); ++sourceIndex)
         {
-            VmaVectorRemove(m_Blocks, blockIndex);
-            return;
+            sources.push_back(emptiedSources[sourceIndex]);
         }
+        VMA_SORT(sources.begin(), sources.end(), MoveSourceLess());
+
+        DefragmentRound(sources, blockCount, moves, maxBytesToMove, maxAllocationsToMove);
     }
-    VMA_ASSERT(0);
+
+    m_BlockInfos.clear();
+
+    CoalesceMoves(moves, m_OverlappingMoveSupported);
+
+    return VK_SUCCESS;
 }
 
-void VmaBlockVector::IncrementallySortBlocks()
+bool VmaDefragmentationAlgorithm_BestFit::DefragmentRound(
+    VmaVector< MoveSource, VmaStlAllocator<MoveSource> >& sources,
+    size_t dstBlockInfoCount,
+    VmaVector< VmaDefragmentationMove, VmaStlAllocator<VmaDefragmentationMove> >& moves,
+    VkDeviceSize maxBytesToMove,
+    uint32_t maxAllocationsToMove)
 {
-    if(m_Algorithm != VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT)
+    // Build the index of free ranges.
+
+    for(size_t blockInfoIndex = 0; blockInfoIndex < dstBlockInfoCount; ++blockInfoIndex)
     {
-        // Bubble sort only until first swap.
-        for(size_t i = 1; i < m_Blocks.size(); ++i)
+        VmaBlockMetadata_Generic* const pMetadata = GetBlockInfoMetadata(blockInfoIndex);
+        for(VmaSuballocationList::iterator it = pMetadata->m_Suballocations.begin();
+            it != pMetadata->m_Suballocations.end();
+            ++it)
         {
-            if(m_Blocks[i - 1]->m_pMetadata->GetSumFreeSize() > m_Blocks[i]->m_pMetadata->GetSumFreeSize())
+            if(it->type == VMA_SUBALLOCATION_TYPE_FREE &&
+                it->size >= VMA_MIN_FREE_SUBALLOCATION_SIZE_TO_REGISTER)
             {
-                VMA_SWAP(m_Blocks[i - 1], m_Blocks[i]);
-                return;
+                FreeRange range = { it->size, blockInfoIndex, it->offset, it };
+                m_FreeRanges.push_back(range);
             }
         }
     }
-}
-
-VkResult VmaBlockVector::AllocateFromBlock(
-    VmaDeviceMemoryBlock* pBlock,
-    uint32_t currentFrameIndex,
-    VkDeviceSize size,
-    VkDeviceSize alignment,
-    VmaAllocationCreateFlags allocFlags,
-    void* pUserData,
-    VmaSuballocationType suballocType,
-    uint32_t strategy,
-    VmaAllocation* pAllocation)
-{
-    VMA_ASSERT((allocFlags & VMA_ALLOCATION_CREATE_CAN_MAKE_OTHER_LOST_BIT) == 0);
-    const bool isUpperAddress = (allocFlags & VMA_ALLOCATION_CREATE_UPPER_ADDRESS_BIT) != 0;
-    const bool mapped = (allocFlags & VMA_ALLOCATION_CREATE_MAPPED_BIT) != 0;
-    const bool isUserDataString = (allocFlags & VMA_ALLOCATION_CREATE_USER_DATA_COPY_STRING_BIT) != 0;
+    VMA_SORT(m_FreeRanges.begin(), m_FreeRanges.end(), FreeRangeLess());
 
-    VmaAllocationRequest currRequest = {};
-    if(pBlock->m_pMetadata->CreateAllocationRequest(
-        currentFrameIndex,
-        m_FrameInUseCount,
-        m_BufferImageGranularity,
-        size,
-        alignment,
-        isUpperAddress,
-        suballocType,
-        false, // canMakeOtherLost
-        strategy,
-        &currRequest))
+    bool limitReached = false;
+    // Sources that were not moved are gathered at the end of the vector, in the same order.
+    size_t notMovedBegin = sources.size();
+    size_t sourceIndex = sources.size();
+    while(sourceIndex--)
     {
-        // Allocate from pCurrBlock.
-        VMA_ASSERT(currRequest.itemsToMakeLostCount == 0);
+        const MoveSource source = sources[sourceIndex];
+        const VmaAllocation hAlloc = source.item->hAllocation;
+        const VkDeviceSize size = source.item->size;
+        const VkDeviceSize srcOffset = source.item->offset;
+        const VmaSuballocationType suballocType = source.item->type;
 
-        if(mapped)
+        // Find the smallest free range where the allocation fits.
+        VmaAllocationRequest dstRequest = {};
+        size_t rangeIndex = VmaBinaryFindFirstNotLess(
+            m_FreeRanges.data(),
+            m_FreeRanges.data() + m_FreeRanges.size(),
+            size,
+            FreeRangeLess()) - m_FreeRanges.data();
+        while(rangeIndex < m_FreeRanges.size())
         {
-            VkResult res = pBlock->Map(m_hAllocator, 1, VMA_NULL);
-            if(res != VK_SUCCESS)
+            const FreeRange& range = m_FreeRanges[rangeIndex];
+            // Allocations are processed from the most "source" place, so a free range
+            // that is not before this one will not be a destination of a move in this round.
+            if(!MoveMakesSense(range.blockInfoIndex, range.offset, source.blockInfoIndex, srcOffset))
             {
-                return res;
+                VmaVectorRemove(m_FreeRanges, rangeIndex);
+                continue;
+            }
+            if(GetBlockInfoMetadata(range.blockInfoIndex)->CheckAllocation(
+                m_CurrentFrameIndex,
+                m_pBlockVector->GetFrameInUseCount(),
+                m_pBlockVector->GetBufferImageGranularity(),
+                size,
+                hAlloc->GetAlignment(),
+                suballocType,
+                range.item,
+                false, // canMakeOtherLost
+                &dstRequest.offset,
+                &dstRequest.itemsToMakeLostCount,
+                &dstRequest.sumFreeSize,
+                &dstRequest.sumItemSize))
+            {
+                dstRequest.item = range.item;
+                break;
             }
+            ++rangeIndex;
         }
-            
-        // We no longer have an empty Allocation.
-        if(pBlock->m_pMetadata->IsEmpty())
+        if(rangeIndex == m_FreeRanges.size())
         {
-            m_HasEmptyBlock = false;
+            sources[--notMovedBegin] = source;
+            continue;
         }
-            
-        *pAllocation = m_hAllocator->m_AllocationObjectAllocator.Allocate();
-        (*pAllocation)->Ctor(currentFrameIndex, isUserDataString);
-        pBlock->m_pMetadata->Alloc(currRequest, suballocType, size, *pAllocation);
-        (*pAllocation)->InitBlockAllocation(
-            pBlock,
-            currRequest.offset,
-            alignment,
-            size,
-            suballocType,
-            mapped,
-            (allocFlags & VMA_ALLOCATION_CREATE_CAN_BECOME_LOST_BIT) != 0);
-        VMA_HEAVY_ASSERT(pBlock->Validate());
-        (*pAllocation)->SetUserData(m_hAllocator, pUserData);
-        if(VMA_DEBUG_INITIALIZE_ALLOCATIONS)
+
+        // Reached limit on number of allocations or bytes to move.
+        if((m_AllocationsMoved + 1 > maxAllocationsToMove) ||
+            (m_BytesMoved + size > maxBytesToMove))
+        {
+            limitReached = true;
+            break;
+        }
+
+        const size_t dstBlockInfoIndex = m_FreeRanges[rangeIndex].blockInfoIndex;
+        VmaBlockMetadata_Generic* const pDstMetadata = GetBlockInfoMetadata(dstBlockInfoIndex);
+        VmaBlockMetadata_Generic* const pSrcMetadata = GetBlockInfoMetadata(source.blockInfoIndex);
+
+        VmaDefragmentationMove move;
+        move.srcBlockIndex = m_BlockInfos[source.blockInfoIndex].origBlockIndex;
+        move.dstBlockIndex = m_BlockInfos[dstBlockInfoIndex].origBlockIndex;
+        move.srcOffset = srcOffset;
+        move.dstOffset = dstRequest.offset;
+        move.size = size;
+        moves.push_back(move);
+
+        // Allocate in destination and register free space left before and after it.
+        VmaVectorRemove(m_FreeRanges, rangeIndex);
+        dstRequest.type = VmaAllocationRequestType::Normal;
+        pDstMetadata->Alloc(dstRequest, suballocType, size, hAlloc);
+        VmaSuballocationList::iterator prevItem = dstRequest.item;
+        if(prevItem != pDstMetadata->m_Suballocations.begin() &&
+            (--prevItem)->type == VMA_SUBALLOCATION_TYPE_FREE)
+        {
+            RegisterFreeRange(dstBlockInfoIndex, prevItem);
+        }
+        VmaSuballocationList::iterator nextItem = dstRequest.item;
+        ++nextItem;
+        if(nextItem != pDstMetadata->m_Suballocations.end() &&
+            nextItem->type == VMA_SUBALLOCATION_TYPE_FREE)
+        {
+            RegisterFreeRange(dstBlockInfoIndex, nextItem);
+        }
+
+        // Free source place. Free ranges adjacent to it are merged with it, so they must leave the index.
+        // The merged free range is not registered, as it will never be a destination of a move.
+        prevItem = source.item;
+        if(prevItem != pSrcMetadata->m_Suballocations.begin() &&
+            (--prevItem)->type == VMA_SUBALLOCATION_TYPE_FREE)
+        {
+            UnregisterFreeRange(source.blockInfoIndex, prevItem);
+        }
+        nextItem = source.item;
+        ++nextItem;
+        if(nextItem != pSrcMetadata->m_Suballocations.end() &&
+            nextItem->type == VMA_SUBALLOCATION_TYPE_FREE)
+        {
+            UnregisterFreeRange(source.blockInfoIndex, nextItem);
+        }
+        pSrcMetadata->FreeSuballocation(source.item);
+
+        if(!IsDryRun())
         {
-            m_hAllocator->FillAllocation(*pAllocation, VMA_ALLOCATION_FILL_PATTERN_CREATED);
+            hAlloc->ChangeBlockAllocation(m_hAllocator, m_pBlockVector->GetBlock(move.dstBlockIndex), dstRequest.offset);
+            OnAllocationMoved(hAlloc, source.pChanged);
         }
-        if(IsCorruptionDetectionEnabled())
+
+        ++m_AllocationsMoved;
+        m_BytesMoved += size;
+    }
+
+    if(!limitReached)
+    {
+        const size_t notMovedCount = sources.size() - notMovedBegin;
+        for(size_t i = 0; i < notMovedCount; ++i)
         {
-            VkResult res = pBlock->WriteMagicValueAroundAllocation(m_hAllocator, currRequest.offset, size);
-            VMA_ASSERT(res == VK_SUCCESS && "Couldn't map block memory to write magic value.");
+            sources[i] = sources[notMovedBegin + i];
         }
-        return VK_SUCCESS;
+        sources.resize(notMovedCount);
     }
-    return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+
+    m_FreeRanges.clear();
+
+    return limitReached;
 }
 
-VkResult VmaBlockVector::CreateBlock(VkDeviceSize blockSize, size_t* pNewBlockIndex)
+
+void VmaDefragmentationAlgorithm_BestFit::RegisterFreeRange(size_t blockInfoIndex, VmaSuballocationList::iterator item)
 {
-    VkMemoryAllocateInfo allocInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
-    allocInfo.memoryTypeIndex = m_MemoryTypeIndex;
-    allocInfo.allocationSize = blockSize;
-    VkDeviceMemory mem = VK_NULL_HANDLE;
-    VkResult res = m_hAllocator->AllocateVulkanMemory(&allocInfo, &mem);
-    if(res < 0)
+    VMA_ASSERT(item->type == VMA_SUBALLOCATION_TYPE_FREE);
+    if(item->size >= VMA_MIN_FREE_SUBALLOCATION_SIZE_TO_REGISTER)
     {
-        return res;
+        FreeRange range = { item->size, blockInfoIndex, item->offset, item };
+        VmaVectorInsertSorted<FreeRangeLess>(m_FreeRanges, range);
     }
+}
 
-    // New VkDeviceMemory successfully created.
-
-    // Create new Allocation for it.
-    VmaDeviceMemoryBlock* const pBlock = vma_new(m_hAllocator, VmaDeviceMemoryBlock)(m_hAllocator);
-    pBlock->Init(
-        m_hAllocator,
-        m_hParentPool,
-        m_MemoryTypeIndex,
-        mem,
-        allocInfo.allocationSize,
-        m_NextBlockId++,
-        m_Algorithm);
+void VmaDefragmentationAlgorithm_BestFit::UnregisterFreeRange(size_t blockInfoIndex, VmaSuballocationList::iterator item)
+{
+    VMA_ASSERT(item->type == VMA_SUBALLOCATION_TYPE_FREE);
+    FreeRange range = { item->size, blockInfoIndex, item->offset, item };
+    VmaVectorRemoveSorted<FreeRangeLess>(m_FreeRanges, range);
+}
 
-    m_Blocks.push_back(pBlock);
-    if(pNewBlockIndex != VMA_NULL)
+bool VmaDefragmentationAlgorithm_BestFit::MoveMakesSense(
+    size_t dstBlockInfoIndex, VkDeviceSize dstOffset,
+    size_t srcBlockInfoIndex, VkDeviceSize srcOffset)
+{
+    if(dstBlockInfoIndex != srcBlockInfoIndex)
     {
-        *pNewBlockIndex = m_Blocks.size() - 1;
+        return dstBlockInfoIndex < srcBlockInfoIndex;
     }
-
-    return VK_SUCCESS;
+    return dstOffset < srcOffset;
 }
 
-void VmaBlockVector::ApplyDefragmentationMovesCpu(
-    class VmaBlockVectorDefragmentationContext* pDefragCtx,
-    const VmaVector< VmaDefragmentationMove, VmaStlAllocator<VmaDefragmentationMove> >& moves)
+////////////////////////////////////////////////////////////////////////////////
+// VmaDefragmentationAlgorithm_Linear
+
+VmaDefragmentationAlgorithm_Linear::VmaDefragmentationAlgorithm_Linear(
+    VmaAllocator hAllocator,
+    VmaBlockVector* pBlockVector,
+    uint32_t currentFrameIndex,
+    bool overlappingMoveSupported) :
+    VmaDefragmentationAlgorithm(hAllocator, pBlockVector, currentFrameIndex),
+    m_OverlappingMoveSupported(overlappingMoveSupported),
+    m_AllAllocations(false),
+    m_Allocations(VmaStlAllocator<AllocationInfo>(hAllocator->GetAllocationCallbacks())),
+    m_BytesMoved(0),
+    m_AllocationsMoved(0),
+    m_NewSuballocations(VmaStlAllocator<VmaSuballocation>(hAllocator->GetAllocationCallbacks()))
 {
-    const size_t blockCount = m_Blocks.size();
-    const bool isNonCoherent = m_hAllocator->IsMemoryTypeNonCoherent(m_MemoryTypeIndex);
+}
 
-    enum BLOCK_FLAG
-    {
-        BLOCK_FLAG_USED = 0x00000001,
-        BLOCK_FLAG_MAPPED_FOR_DEFRAGMENTATION = 0x00000002,
-    };
+VmaDefragmentationAlgorithm_Linear::~VmaDefragmentationAlgorithm_Linear()
+{
+}
 
-    struct BlockInfo
+void VmaDefragmentationAlgorithm_Linear::AddAllocation(VmaAllocation hAlloc, VkBool32* pChanged)
+{
+    // Now as we are inside VmaBlockVector::m_Mutex, we can make final check if this allocation was not lost.
+    if(hAlloc->GetLastUseFrameIndex() != VMA_FRAME_INDEX_LOST)
     {
-        uint32_t flags;
-        void* pMappedData;
-    };
-    VmaVector< BlockInfo, VmaStlAllocator<BlockInfo> >
-        blockInfo(blockCount, BlockInfo(), VmaStlAllocator<BlockInfo>(m_hAllocator->GetAllocationCallbacks()));
-    memset(blockInfo.data(), 0, blockCount * sizeof(BlockInfo));
+        m_Allocations.push_back(AllocationInfo(hAlloc, pChanged));
+    }
+}
 
-    // Go over all moves. Mark blocks that are used with BLOCK_FLAG_USED.
-    const size_t moveCount = moves.size();
-    for(size_t moveIndex = 0; moveIndex < moveCount; ++moveIndex)
+VkResult VmaDefragmentationAlgorithm_Linear::Defragment(
+    VmaVector< VmaDefragmentationMove, VmaStlAllocator<VmaDefragmentationMove> >& moves,
+    VkDeviceSize maxBytesToMove,
+    uint32_t maxAllocationsToMove)
+{
+    const size_t blockCount = m_pBlockVector->GetBlockCount();
+    if((!m_AllAllocations && m_Allocations.empty()) ||
+        blockCount == 0 || maxBytesToMove == 0 || maxAllocationsToMove == 0)
     {
-        const VmaDefragmentationMove& move = moves[moveIndex];
-        blockInfo[move.srcBlockIndex].flags |= BLOCK_FLAG_USED;
-        blockInfo[move.dstBlockIndex].flags |= BLOCK_FLAG_USED;
+        return VK_SUCCESS;
     }
 
-    VMA_ASSERT(pDefragCtx->res == VK_SUCCESS);
+    VMA_SORT(m_Allocations.begin(), m_Allocations.end(), AllocationInfoHandleLess());
 
-    // Go over all blocks. Get mapped pointer or map if necessary.
-    for(size_t blockIndex = 0; pDefragCtx->res == VK_SUCCESS && blockIndex < blockCount; ++blockIndex)
+    for(size_t blockIndex = 0; blockIndex < blockCount; ++blockIndex)
     {
-        BlockInfo& currBlockInfo = blockInfo[blockIndex];
-        VmaDeviceMemoryBlock* pBlock = m_Blocks[blockIndex];
-        if((currBlockInfo.flags & BLOCK_FLAG_USED) != 0)
+        if(CompactBlock(blockIndex, moves, maxBytesToMove, maxAllocationsToMove))
         {
-            currBlockInfo.pMappedData = pBlock->GetMappedData();
-            // It is not originally mapped - map it.
-            if(currBlockInfo.pMappedData == VMA_NULL)
-            {
-                pDefragCtx->res = pBlock->Map(m_hAllocator, 1, &currBlockInfo.pMappedData);
-                if(pDefragCtx->res == VK_SUCCESS)
-                {
-                    currBlockInfo.flags |= BLOCK_FLAG_MAPPED_FOR_DEFRAGMENTATION;
-                }
-            }
+            break;
         }
     }
 
-    // Go over all moves. Do actual data transfer.
-    if(pDefragCtx->res == VK_SUCCESS)
+    m_NewSuballocations.clear();
+
+    CoalesceMoves(moves, m_OverlappingMoveSupported);
+
+    return VK_SUCCESS;
+}
+
+bool VmaDefragmentationAlgorithm_Linear::IsMovable(VmaAllocation hAlloc, VkBool32** ppChanged) const
+{
+    *ppChanged = VMA_NULL;
+    if(m_AllAllocations)
     {
-        const VkDeviceSize nonCoherentAtomSize = m_hAllocator->m_PhysicalDeviceProperties.limits.nonCoherentAtomSize;
-        VkMappedMemoryRange memRange = { VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE };
+        return true;
+    }
+    const AllocationInfo* const pAllocInfo = VmaBinaryFindFirstNotLess(
+        m_Allocations.data(),
+        m_Allocations.data() + m_Allocations.size(),
+        hAlloc,
+        AllocationInfoHandleLess());
+    if(pAllocInfo == m_Allocations.data() + m_Allocations.size() ||
+        pAllocInfo->m_hAllocation != hAlloc)
+    {
+        return false;
+    }
+    *ppChanged = pAllocInfo->m_pChanged;
+    return true;
+}
 
-        for(size_t moveIndex = 0; moveIndex < moveCount; ++moveIndex)
-        {
-            const VmaDefragmentationMove& move = moves[moveIndex];
+bool VmaDefragmentationAlgorithm_Linear::CompactBlock(
+    size_t blockIndex,
+    VmaVector< VmaDefragmentationMove, VmaStlAllocator<VmaDefragmentationMove> >& moves,
+    VkDeviceSize maxBytesToMove,
+    uint32_t maxAllocationsToMove)
+{
+    const VkDeviceSize bufferImageGranularity = m_pBlockVector->GetBufferImageGranularity();
+    VmaBlockMetadata_Linear* const pMetadata = GetLinearMetadata(blockIndex);
+    VmaBlockMetadata_Linear::SuballocationVectorType& suballocations1st = pMetadata->AccessSuballocations1st();
+    VmaBlockMetadata_Linear::SuballocationVectorType& suballocations2nd = pMetadata->AccessSuballocations2nd();
+    const bool ringBuffer = pMetadata->m_2ndVectorMode == VmaBlockMetadata_Linear::SECOND_VECTOR_RING_BUFFER;
+    const bool doubleStack = pMetadata->m_2ndVectorMode == VmaBlockMetadata_Linear::SECOND_VECTOR_DOUBLE_STACK;
+    bool limitReached = false;
 
-            const BlockInfo& srcBlockInfo = blockInfo[move.srcBlockIndex];
-            const BlockInfo& dstBlockInfo = blockInfo[move.dstBlockIndex];
+    /*
+    Linear allocator uses only free space after the last allocation of each side (and between
+    parts of ring buffer), so moving allocations placed before a non-movable one would only move
+    free space between them. Only allocations after the last non-movable one are moved.
+    */
 
-            VMA_ASSERT(srcBlockInfo.pMappedData && dstBlockInfo.pMappedData);
+    // Lower side: 2nd vector of ring buffer, then 1st vector, in order of increasing offsets.
 
-            // Invalidate source.
-            if(isNonCoherent)
-            {
-                VmaDeviceMemoryBlock* const pSrcBlock = m_Blocks[move.srcBlockIndex];
-                memRange.memory = pSrcBlock->GetDeviceMemory();
-                memRange.offset = VmaAlignDown(move.srcOffset, nonCoherentAtomSize);
-                memRange.size = VMA_MIN(
-                    VmaAlignUp(move.size + (move.srcOffset - memRange.offset), nonCoherentAtomSize),
-                    pSrcBlock->m_pMetadata->GetSize() - memRange.offset);
-                (*m_hAllocator->GetVulkanFunctions().vkInvalidateMappedMemoryRanges)(m_hAllocator->m_hDevice, 1, &memRange);
-            }
+    m_NewSuballocations.clear();
+    const size_t lower2ndCount = ringBuffer ? suballocations2nd.size() : 0;
+    const size_t lowerCount = lower2ndCount + suballocations1st.size();
+    size_t firstMovableLowerIndex = 0;
+    for(size_t lowerIndex = lowerCount; lowerIndex--; )
+    {
+        const VmaSuballocation& suballoc = lowerIndex < lower2ndCount ?
+            suballocations2nd[lowerIndex] :
+            suballocations1st[lowerIndex - lower2ndCount];
+        VkBool32* pChanged = VMA_NULL;
+        // Allocations without VmaAllocation object are never moved.
+        if(suballoc.type != VMA_SUBALLOCATION_TYPE_FREE &&
+            (suballoc.hAllocation == VK_NULL_HANDLE || !IsMovable(suballoc.hAllocation, &pChanged)))
+        {
+            firstMovableLowerIndex = lowerIndex + 1;
+            break;
+        }
+    }
+    // Free space at the end of 1st vector of ring buffer is not available.
+    if(ringBuffer && firstMovableLowerIndex > lower2ndCount)
+    {
+        firstMovableLowerIndex = lowerCount;
+    }
+    // Number of items in m_NewSuballocations that come from 2nd vector of ring buffer.
+    size_t new2ndCount = 0;
+    for(size_t lowerIndex = 0; lowerIndex < lowerCount; ++lowerIndex)
+    {
+        if(lowerIndex == lower2ndCount)
+        {
+            new2ndCount = m_NewSuballocations.size();
+        }
+        const VmaSuballocation& suballoc = lowerIndex < lower2ndCount ?
+            suballocations2nd[lowerIndex] :
+            suballocations1st[lowerIndex - lower2ndCount];
+        if(suballoc.type == VMA_SUBALLOCATION_TYPE_FREE)
+        {
+            continue;
+        }
 
-            // THE PLACE WHERE ACTUAL DATA COPY HAPPENS.
-            memmove(
-                reinterpret_cast<char*>(dstBlockInfo.pMappedData) + move.dstOffset,
-                reinterpret_cast<char*>(srcBlockInfo.pMappedData) + move.srcOffset,
-                static_cast<size_t>(move.size));
+        VkBool32* pChanged = VMA_NULL;
+        if(lowerIndex < firstMovableLowerIndex || limitReached || !IsMovable(suballoc.hAllocation, &pChanged))
+        {
+            m_NewSuballocations.push_back(suballoc);
+            continue;
+        }
+        if((m_AllocationsMoved + 1 > maxAllocationsToMove) ||
+            (m_BytesMoved + suballoc.size > maxBytesToMove))
+        {
+            limitReached = true;
+            m_NewSuballocations.push_back(suballoc);
+            continue;
+        }
 
-            if(IsCorruptionDetectionEnabled())
-            {
-                VmaWriteMagicValue(dstBlockInfo.pMappedData, move.dstOffset - VMA_DEBUG_MARGIN);
-                VmaWriteMagicValue(dstBlockInfo.pMappedData, move.dstOffset + move.size);
-            }
+        const VkDeviceSize alignment = suballoc.hAllocation->GetAlignment();
 
-            // Flush destination.
-            if(isNonCoherent)
+        // Try to move it to the end of one of previous blocks.
+        size_t dstBlockIndex = 0;
+        for(; dstBlockIndex < blockIndex; ++dstBlockIndex)
+        {
+            VmaBlockMetadata_Linear* const pDstMetadata = GetLinearMetadata(dstBlockIndex);
+            VmaBlockMetadata_Linear::SuballocationVectorType& dstSuballocations1st = pDstMetadata->AccessSuballocations1st();
+            const VkDeviceSize dstEnd = pDstMetadata->m_2ndVectorMode == VmaBlockMetadata_Linear::SECOND_VECTOR_DOUBLE_STACK ?
+                pDstMetadata->AccessSuballocations2nd().back().offset :
+                pDstMetadata->GetSize();
+            const VkDeviceSize dstOffset = CalcLowerOffset(
+                dstSuballocations1st, suballoc, alignment, bufferImageGranularity);
+            if(dstOffset + suballoc.size + VMA_DEBUG_MARGIN <= dstEnd)
             {
-                VmaDeviceMemoryBlock* const pDstBlock = m_Blocks[move.dstBlockIndex];
-                memRange.memory = pDstBlock->GetDeviceMemory();
-                memRange.offset = VmaAlignDown(move.dstOffset, nonCoherentAtomSize);
-                memRange.size = VMA_MIN(
-                    VmaAlignUp(move.size + (move.dstOffset - memRange.offset), nonCoherentAtomSize),
-                    pDstBlock->m_pMetadata->GetSize() - memRange.offset);
-                (*m_hAllocator->GetVulkanFunctions().vkFlushMappedMemoryRanges)(m_hAllocator->m_hDevice, 1, &memRange);
+                AddMove(blockIndex, suballoc, dstBlockIndex, dstOffset, pChanged, moves);
+                VmaSuballocation dstSuballoc = suballoc;
+                dstSuballoc.offset = dstOffset;
+                dstSuballocations1st.push_back(dstSuballoc);
+                pDstMetadata->m_SumFreeSize -= suballoc.size;
+                pMetadata->m_SumFreeSize += suballoc.size;
+                break;
             }
         }
-    }
+        if(dstBlockIndex < blockIndex)
+        {
+            continue;
+        }
 
-    // Go over all blocks in reverse order. Unmap those that were mapped just for defragmentation.
-    // Regardless of pCtx->res == VK_SUCCESS.
-    for(size_t blockIndex = blockCount; blockIndex--; )
-    {
-        const BlockInfo& currBlockInfo = blockInfo[blockIndex];
-        if((currBlockInfo.flags & BLOCK_FLAG_MAPPED_FOR_DEFRAGMENTATION) != 0)
+        // Move it down within this block.
+        VmaSuballocation newSuballoc = suballoc;
+        const VkDeviceSize newOffset = CalcLowerOffset(
+            m_NewSuballocations, suballoc, alignment, bufferImageGranularity);
+        if(newOffset < suballoc.offset &&
+            (m_OverlappingMoveSupported || newOffset + suballoc.size <= suballoc.offset))
         {
-            VmaDeviceMemoryBlock* pBlock = m_Blocks[blockIndex];
-            pBlock->Unmap(m_hAllocator, 1);
+            AddMove(blockIndex, suballoc, blockIndex, newOffset, pChanged, moves);
+            newSuballoc.offset = newOffset;
         }
+        m_NewSuballocations.push_back(newSuballoc);
     }
-}
-
-void VmaBlockVector::ApplyDefragmentationMovesGpu(
-    class VmaBlockVectorDefragmentationContext* pDefragCtx,
-    const VmaVector< VmaDefragmentationMove, VmaStlAllocator<VmaDefragmentationMove> >& moves,
-    VkCommandBuffer commandBuffer)
-{
-    const size_t blockCount = m_Blocks.size();
-
-    pDefragCtx->blockContexts.resize(blockCount);
-    memset(pDefragCtx->blockContexts.data(), 0, blockCount * sizeof(VmaBlockDefragmentationContext));
 
-    // Go over all moves. Mark blocks that are used with BLOCK_FLAG_USED.
-    const size_t moveCount = moves.size();
-    for(size_t moveIndex = 0; moveIndex < moveCount; ++moveIndex)
+    if(lower2ndCount == lowerCount)
     {
-        const VmaDefragmentationMove& move = moves[moveIndex];
-        pDefragCtx->blockContexts[move.srcBlockIndex].flags |= VmaBlockDefragmentationContext::BLOCK_FLAG_USED;
-        pDefragCtx->blockContexts[move.dstBlockIndex].flags |= VmaBlockDefragmentationContext::BLOCK_FLAG_USED;
+        new2ndCount = m_NewSuballocations.size();
     }
 
-    VMA_ASSERT(pDefragCtx->res == VK_SUCCESS);
+    /*
+    Remaining lower suballocations usually form single 1st vector. Ring buffer stays only
+    if free space between its parts, which are not contiguous because some allocations
+    could not be moved, is bigger than free space at the end.
+    */
+    bool keepRingBuffer = false;
+    if(new2ndCount > 0 && new2ndCount < m_NewSuballocations.size())
+    {
+        const VmaSuballocation& last2ndSuballoc = m_NewSuballocations[new2ndCount - 1];
+        const VmaSuballocation& lastSuballoc = m_NewSuballocations.back();
+        keepRingBuffer = m_NewSuballocations[new2ndCount].offset - (last2ndSuballoc.offset + last2ndSuballoc.size) >
+            pMetadata->GetSize() - (lastSuballoc.offset + lastSuballoc.size);
+    }
+    if(keepRingBuffer)
+    {
+        suballocations2nd.resize(new2ndCount);
+        memcpy(suballocations2nd.data(), m_NewSuballocations.data(), new2ndCount * sizeof(VmaSuballocation));
+        suballocations1st.resize(m_NewSuballocations.size() - new2ndCount);
+        memcpy(suballocations1st.data(), m_NewSuballocations.data() + new2ndCount, suballocations1st.size() * sizeof(VmaSuballocation));
+        pMetadata->m_2ndNullItemsCount = 0;
+    }
+    else
+    {
+        suballocations1st = m_NewSuballocations;
+        if(!doubleStack)
+        {
+            suballocations2nd.clear();
+            pMetadata->m_2ndNullItemsCount = 0;
+            pMetadata->m_2ndVectorMode = VmaBlockMetadata_Linear::SECOND_VECTOR_EMPTY;
+        }
+    }
+    pMetadata->m_1stNullItemsBeginCount = 0;
+    pMetadata->m_1stNullItemsMiddleCount = 0;
 
-    // Go over all blocks. Create and bind buffer for whole block if necessary.
+    // Upper side of double stack, in order of decreasing offsets.
+    if(doubleStack)
     {
-        VkBufferCreateInfo bufCreateInfo;
-        VmaFillGpuDefragmentationBufferCreateInfo(bufCreateInfo);
+        m_NewSuballocations.clear();
+        size_t firstMovableUpperIndex = 0;
+        for(size_t upperIndex = suballocations2nd.size(); upperIndex--; )
+        {
+            const VmaSuballocation& suballoc = suballocations2nd[upperIndex];
+            VkBool32* pChanged = VMA_NULL;
+            if(suballoc.type != VMA_SUBALLOCATION_TYPE_FREE &&
+                (suballoc.hAllocation == VK_NULL_HANDLE || !IsMovable(suballoc.hAllocation, &pChanged)))
+            {
+                firstMovableUpperIndex = upperIndex + 1;
+                break;
+            }
+        }
 
-        for(size_t blockIndex = 0; pDefragCtx->res == VK_SUCCESS && blockIndex < blockCount; ++blockIndex)
+        for(size_t upperIndex = 0; upperIndex < suballocations2nd.size(); ++upperIndex)
         {
-            VmaBlockDefragmentationContext& currBlockCtx = pDefragCtx->blockContexts[blockIndex];
-            VmaDeviceMemoryBlock* pBlock = m_Blocks[blockIndex];
-            if((currBlockCtx.flags & VmaBlockDefragmentationContext::BLOCK_FLAG_USED) != 0)
+            const VmaSuballocation& suballoc = suballocations2nd[upperIndex];
+            if(suballoc.type == VMA_SUBALLOCATION_TYPE_FREE)
             {
-                bufCreateInfo.size = pBlock->m_pMetadata->GetSize();
-                pDefragCtx->res = (*m_hAllocator->GetVulkanFunctions().vkCreateBuffer)(
-                    m_hAllocator->m_hDevice, &bufCreateInfo, m_hAllocator->GetAllocationCallbacks(), &currBlockCtx.hBuffer);
-                if(pDefragCtx->res == VK_SUCCESS)
+                continue;
+            }
+
+            VmaSuballocation newSuballoc = suballoc;
+            VkBool32* pChanged = VMA_NULL;
+            if(upperIndex >= firstMovableUpperIndex && !limitReached && IsMovable(suballoc.hAllocation, &pChanged))
+            {
+                if((m_AllocationsMoved + 1 > maxAllocationsToMove) ||
+                    (m_BytesMoved + suballoc.size > maxBytesToMove))
                 {
-                    pDefragCtx->res = (*m_hAllocator->GetVulkanFunctions().vkBindBufferMemory)(
-                        m_hAllocator->m_hDevice, currBlockCtx.hBuffer, pBlock->GetDeviceMemory(), 0);
+                    limitReached = true;
+                }
+                else
+                {
+                    const VkDeviceSize newOffset = CalcUpperOffset(
+                        m_NewSuballocations,
+                        suballoc,
+                        pMetadata->GetSize(),
+                        suballoc.hAllocation->GetAlignment(),
+                        bufferImageGranularity);
+                    if(newOffset > suballoc.offset &&
+                        (m_OverlappingMoveSupported || suballoc.offset + suballoc.size <= newOffset))
+                    {
+                        AddMove(blockIndex, suballoc, blockIndex, newOffset, pChanged, moves);
+                        newSuballoc.offset = newOffset;
+                    }
                 }
             }
+            m_NewSuballocations.push_back(newSuballoc);
         }
-    }
 
-    // Go over all moves. Post data transfer commands to command buffer.
-    if(pDefragCtx->res == VK_SUCCESS)
-    {
-        for(size_t moveIndex = 0; moveIndex < moveCount; ++moveIndex)
+        suballocations2nd = m_NewSuballocations;
+        pMetadata->m_2ndNullItemsCount = 0;
+        if(suballocations2nd.empty())
         {
-            const VmaDefragmentationMove& move = moves[moveIndex];
+            pMetadata->m_2ndVectorMode = VmaBlockMetadata_Linear::SECOND_VECTOR_EMPTY;
+        }
+    }
 
-            const VmaBlockDefragmentationContext& srcBlockCtx = pDefragCtx->blockContexts[move.srcBlockIndex];
-            const VmaBlockDefragmentationContext& dstBlockCtx = pDefragCtx->blockContexts[move.dstBlockIndex];
+    VMA_HEAVY_ASSERT(pMetadata->Validate());
+    return limitReached;
+}
 
-            VMA_ASSERT(srcBlockCtx.hBuffer && dstBlockCtx.hBuffer);
+void VmaDefragmentationAlgorithm_Linear::AddMove(
+    size_t srcBlockIndex, const VmaSuballocation& srcSuballoc,
+    size_t dstBlockIndex, VkDeviceSize dstOffset,
+    VkBool32* pChanged,
+    VmaVector< VmaDefragmentationMove, VmaStlAllocator<VmaDefragmentationMove> >& moves)
+{
+    VmaDefragmentationMove move;
+    move.srcBlockIndex = srcBlockIndex;
+    move.dstBlockIndex = dstBlockIndex;
+    move.srcOffset = srcSuballoc.offset;
+    move.dstOffset = dstOffset;
+    move.size = srcSuballoc.size;
+    moves.push_back(move);
 
-            VkBufferCopy region = {
-                move.srcOffset,
-                move.dstOffset,
-                move.size };
-            (*m_hAllocator->GetVulkanFunctions().vkCmdCopyBuffer)(
-                commandBuffer, srcBlockCtx.hBuffer, dstBlockCtx.hBuffer, 1, &region);
+    if(!IsDryRun())
+    {
+        if(dstBlockIndex == srcBlockIndex)
+        {
+            srcSuballoc.hAllocation->ChangeOffset(dstOffset);
         }
+        else
+        {
+            srcSuballoc.hAllocation->ChangeBlockAllocation(m_hAllocator, m_pBlockVector->GetBlock(dstBlockIndex), dstOffset);
+        }
+        OnAllocationMoved(srcSuballoc.hAllocation, pChanged);
     }
 
-    // Save buffers to defrag context for later destruction.
-    if(pDefragCtx->res == VK_SUCCESS && moveCount > 0)
+    ++m_AllocationsMoved;
+    m_BytesMoved += srcSuballoc.size;
+}
+
+VkDeviceSize VmaDefragmentationAlgorithm_Linear::CalcLowerOffset(
+    const SuballocationVectorType& suballocations,
+    const VmaSuballocation& suballoc,
+    VkDeviceSize alignment,
+    VkDeviceSize bufferImageGranularity)
+{
+    VkDeviceSize offset = suballocations.empty() ?
+        0 :
+        suballocations.back().offset + suballocations.back().size;
+    offset = VmaAlignUp(offset + VMA_DEBUG_MARGIN, alignment);
+
+    // Check previous suballocations for BufferImageGranularity conflicts.
+    // If conflict exists, we must mark more space to meet the requirement.
+    if(bufferImageGranularity > 1)
     {
-        pDefragCtx->res = VK_NOT_READY;
+        for(size_t prevIndex = suballocations.size(); prevIndex--; )
+        {
+            const VmaSuballocation& prevSuballoc = suballocations[prevIndex];
+            if(!VmaBlocksOnSamePage(prevSuballoc.offset, prevSuballoc.size, offset, bufferImageGranularity))
+            {
+                break;
+            }
+            if(VmaIsBufferImageGranularityConflict(prevSuballoc.type, suballoc.type))
+            {
+                offset = VmaAlignUp(offset, bufferImageGranularity);
+                break;
+            }
+        }
     }
+
+    return offset;
 }
 
-void VmaBlockVector::FreeEmptyBlocks(VmaDefragmentationStats* pDefragmentationStats)
+VkDeviceSize VmaDefragmentationAlgorithm_Linear::CalcUpperOffset(
+    const SuballocationVectorType& suballocations,
+    const VmaSuballocation& suballoc,
+    VkDeviceSize blockSize,
+    VkDeviceSize alignment,
+    VkDeviceSize bufferImageGranularity)
 {
-    m_HasEmptyBlock = false;
-    for(size_t blockIndex = m_Blocks.size(); blockIndex--; )
+    // The suballocation fits in its current place, so this doesn't underflow.
+    const VkDeviceSize end = suballocations.empty() ? blockSize : suballocations.back().offset;
+    VkDeviceSize offset = VmaAlignDown(end - suballoc.size - VMA_DEBUG_MARGIN, alignment);
+
+    // Check next suballocations for BufferImageGranularity conflicts.
+    // If conflict exists, we must mark more space to meet the requirement.
+    if(bufferImageGranularity > 1)
     {
-        VmaDeviceMemoryBlock* pBlock = m_Blocks[blockIndex];
-        if(pBlock->m_pMetadata->IsEmpty())
+        for(size_t nextIndex = suballocations.size(); nextIndex--; )
         {
-            if(m_Blocks.size() > m_MinBlockCount)
+            const VmaSuballocation& nextSuballoc = suballocations[nextIndex];
+            if(!VmaBlocksOnSamePage(offset, suballoc.size, nextSuballoc.offset, bufferImageGranularity))
             {
-                if(pDefragmentationStats != VMA_NULL)
-                {
-                    ++pDefragmentationStats->deviceMemoryBlocksFreed;
-                    pDefragmentationStats->bytesFreed += pBlock->m_pMetadata->GetSize();
-                }
-
-                VmaVectorRemove(m_Blocks, blockIndex);
-                pBlock->Destroy(m_hAllocator);
-                vma_delete(m_hAllocator, pBlock);
+                break;
             }
-            else
+            if(VmaIsBufferImageGranularityConflict(suballoc.type, nextSuballoc.type))
             {
-                m_HasEmptyBlock = true;
+                offset = VmaAlignDown(offset, bufferImageGranularity);
+                break;
             }
         }
     }
+
+    return offset;
 }
 
-#if VMA_STATS_STRING_ENABLED
+////////////////////////////////////////////////////////////////////////////////
+// VmaDefragmentationAlgorithm_Buddy
 
-void VmaBlockVector::PrintDetailedMap(class VmaJsonWriter& json)
+VmaDefragmentationAlgorithm_Buddy::VmaDefragmentationAlgorithm_Buddy(
+    VmaAllocator hAllocator,
+    VmaBlockVector* pBlockVector,
+    uint32_t currentFrameIndex,
+    bool overlappingMoveSupported) :
+    VmaDefragmentationAlgorithm(hAllocator, pBlockVector, currentFrameIndex),
+    m_OverlappingMoveSupported(overlappingMoveSupported),
+    m_AllAllocations(false),
+    m_Allocations(VmaStlAllocator<AllocationInfo>(hAllocator->GetAllocationCallbacks())),
+    m_BytesMoved(0),
+    m_AllocationsMoved(0),
+    m_FreeNodes(VmaStlAllocator<FreeNode>(hAllocator->GetAllocationCallbacks()))
 {
-    VmaMutexLockRead lock(m_Mutex, m_hAllocator->m_UseMutex);
+}
 
-    json.BeginObject();
+VmaDefragmentationAlgorithm_Buddy::~VmaDefragmentationAlgorithm_Buddy()
+{
+}
 
-    if(m_IsCustomPool)
+void VmaDefragmentationAlgorithm_Buddy::AddAllocation(VmaAllocation hAlloc, VkBool32* pChanged)
+{
+    // Now as we are inside VmaBlockVector::m_Mutex, we can make final check if this allocation was not lost.
+    if(hAlloc->GetLastUseFrameIndex() != VMA_FRAME_INDEX_LOST)
     {
-        json.WriteString("MemoryTypeIndex");
-        json.WriteNumber(m_MemoryTypeIndex);
+        m_Allocations.push_back(AllocationInfo(hAlloc, pChanged));
+    }
+}
 
-        json.WriteString("BlockSize");
-        json.WriteNumber(m_PreferredBlockSize);
+VkResult VmaDefragmentationAlgorithm_Buddy::Defragment(
+    VmaVector< VmaDefragmentationMove, VmaStlAllocator<VmaDefragmentationMove> >& moves,
+    VkDeviceSize maxBytesToMove,
+    uint32_t maxAllocationsToMove)
+{
+    const size_t blockCount = m_pBlockVector->GetBlockCount();
+    if((!m_AllAllocations && m_Allocations.empty()) ||
+        blockCount == 0 || maxBytesToMove == 0 || maxAllocationsToMove == 0)
+    {
+        return VK_SUCCESS;
+    }
 
-        json.WriteString("BlockCount");
-        json.BeginObject(true);
-        if(m_MinBlockCount > 0)
+    VMA_SORT(m_Allocations.begin(), m_Allocations.end(), AllocationInfoHandleLess());
+
+    // Blocks are already sorted from most "destination" to most "source" by VmaBlockVector.
+    VmaVector< MoveSource, VmaStlAllocator<MoveSource> > sources =
+        VmaVector< MoveSource, VmaStlAllocator<MoveSource> >(VmaStlAllocator<MoveSource>(m_hAllocator->GetAllocationCallbacks()));
+    for(size_t blockIndex = 0; blockIndex < blockCount; ++blockIndex)
+    {
+        const VmaBlockMetadata_Buddy* const pMetadata = GetBuddyMetadata(blockIndex);
+        for(uint32_t level = 0; level < pMetadata->m_LevelCount; ++level)
         {
-            json.WriteString("Min");
-            json.WriteNumber((uint64_t)m_MinBlockCount);
+            if(pMetadata->m_Roots[level] != VMA_NULL)
+            {
+                GatherNodes(blockIndex, pMetadata->m_Roots[level], level, sources);
+            }
         }
-        if(m_MaxBlockCount < SIZE_MAX)
+    }
+    VMA_SORT(m_FreeNodes.begin(), m_FreeNodes.end(), FreeNodeLess());
+
+    const VkDeviceSize bufferImageGranularity = m_pBlockVector->GetBufferImageGranularity();
+    for(size_t sourceIndex = sources.size(); sourceIndex--; )
+    {
+        const MoveSource& source = sources[sourceIndex];
+        VmaBlockMetadata_Buddy* const pSrcMetadata = GetBuddyMetadata(source.blockIndex);
+        const VmaAllocation hAlloc = source.node->allocation.alloc;
+        const VkDeviceSize srcOffset = source.node->offset;
+        const VkDeviceSize size = hAlloc->GetSize();
+        const VkDeviceSize nodeSize = pSrcMetadata->LevelToNodeSize(source.level);
+        const VmaSuballocationType suballocType = hAlloc->GetSuballocationType();
+
+        // Same rule as in VmaBlockMetadata_Buddy::CreateAllocationRequest().
+        VkDeviceSize alignment = hAlloc->GetAlignment();
+        if(suballocType == VMA_SUBALLOCATION_TYPE_UNKNOWN ||
+            suballocType == VMA_SUBALLOCATION_TYPE_IMAGE_UNKNOWN ||
+            suballocType == VMA_SUBALLOCATION_TYPE_IMAGE_OPTIMAL)
         {
-            json.WriteString("Max");
-            json.WriteNumber((uint64_t)m_MaxBlockCount);
+            alignment = VMA_MAX(alignment, bufferImageGranularity);
         }
-        json.WriteString("Cur");
-        json.WriteNumber((uint64_t)m_Blocks.size());
-        json.EndObject();
 
-        if(m_FrameInUseCount > 0)
+        // Find free node of the smallest size not less than nodeSize, placed before the source.
+        // Among nodes of the same size, the most "destination" one is the last.
+        size_t freeNodeIndex = SIZE_MAX;
+        VkDeviceSize minNodeSize = nodeSize;
+        for(;;)
         {
-            json.WriteString("FrameInUseCount");
-            json.WriteNumber(m_FrameInUseCount);
+            const size_t groupBegin = VmaBinaryFindFirstNotLess(
+                m_FreeNodes.data(),
+                m_FreeNodes.data() + m_FreeNodes.size(),
+                minNodeSize,
+                FreeNodeLess()) - m_FreeNodes.data();
+            if(groupBegin == m_FreeNodes.size())
+            {
+                break;
+            }
+            const VkDeviceSize groupNodeSize = m_FreeNodes[groupBegin].size;
+            const size_t groupEnd = VmaBinaryFindFirstNotLess(
+                m_FreeNodes.data() + groupBegin,
+                m_FreeNodes.data() + m_FreeNodes.size(),
+                groupNodeSize + 1,
+                FreeNodeLess()) - m_FreeNodes.data();
+            const FreeNode& freeNode = m_FreeNodes[groupEnd - 1];
+            // Sources are processed from the most "source" place, so a free node
+            // that is not before this one will not be a destination of any move.
+            if(!MoveMakesSense(freeNode.blockIndex, freeNode.offset, source.blockIndex, srcOffset))
+            {
+                VmaVectorRemove(m_FreeNodes, groupEnd - 1);
+                continue;
+            }
+            if(freeNode.offset % alignment == 0)
+            {
+                freeNodeIndex = groupEnd - 1;
+                break;
+            }
+            minNodeSize = groupNodeSize + 1;
+        }
+        if(freeNodeIndex == SIZE_MAX)
+        {
+            continue;
         }
 
-        if(m_Algorithm != 0)
+        // Reached limit on number of allocations or bytes to move.
+        if((m_AllocationsMoved + 1 > maxAllocationsToMove) ||
+            (m_BytesMoved + size > maxBytesToMove))
         {
-            json.WriteString("Algorithm");
-            json.WriteString(VmaAlgorithmToStr(m_Algorithm));
+            break;
         }
-    }
-    else
-    {
-        json.WriteString("PreferredBlockSize");
-        json.WriteNumber(m_PreferredBlockSize);
-    }
 
-    json.WriteString("Blocks");
-    json.BeginObject();
-    for(size_t i = 0; i < m_Blocks.size(); ++i)
-    {
-        json.BeginString();
-        json.ContinueString(m_Blocks[i]->GetId());
-        json.EndString();
+        const FreeNode dstFreeNode = m_FreeNodes[freeNodeIndex];
+        VmaVectorRemove(m_FreeNodes, freeNodeIndex);
+        VmaBlockMetadata_Buddy* const pDstMetadata = GetBuddyMetadata(dstFreeNode.blockIndex);
 
-        m_Blocks[i]->m_pMetadata->PrintDetailedMap(json);
-    }
-    json.EndObject();
+        VmaDefragmentationMove move;
+        move.srcBlockIndex = source.blockIndex;
+        move.dstBlockIndex = dstFreeNode.blockIndex;
+        move.srcOffset = srcOffset;
+        move.dstOffset = dstFreeNode.offset;
+        move.size = size;
+        moves.push_back(move);
 
-    json.EndObject();
-}
+        // Allocate in destination node.
+        uint32_t dstLevel = 0;
+        while(pDstMetadata->LevelToNodeSize(dstLevel) > dstFreeNode.size)
+        {
+            ++dstLevel;
+        }
+        VmaAllocationRequest dstRequest = {};
+        dstRequest.type = VmaAllocationRequestType::Normal;
+        dstRequest.offset = dstFreeNode.offset;
+        dstRequest.customData = (void*)(uintptr_t)dstLevel;
+        pDstMetadata->Alloc(dstRequest, suballocType, size, hAlloc);
 
-#endif // #if VMA_STATS_STRING_ENABLED
+        // Splitting the node created free right children of all sizes down to nodeSize.
+        for(VkDeviceSize childSize = dstFreeNode.size >> 1; childSize >= nodeSize; childSize >>= 1)
+        {
+            const FreeNode childFreeNode = { childSize, dstFreeNode.blockIndex, dstFreeNode.offset + childSize };
+            VmaVectorInsertSorted<FreeNodeLess>(m_FreeNodes, childFreeNode);
+        }
 
-void VmaBlockVector::Defragment(
-    class VmaBlockVectorDefragmentationContext* pCtx,
-    VmaDefragmentationStats* pStats,
-    VkDeviceSize& maxCpuBytesToMove, uint32_t& maxCpuAllocationsToMove,
-    VkDeviceSize& maxGpuBytesToMove, uint32_t& maxGpuAllocationsToMove,
-    VkCommandBuffer commandBuffer)
-{
-    pCtx->res = VK_SUCCESS;
-    
-    const VkMemoryPropertyFlags memPropFlags =
-        m_hAllocator->m_MemProps.memoryTypes[m_MemoryTypeIndex].propertyFlags;
-    const bool isHostVisible = (memPropFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+        // Free source node. Free buddies it merges with must leave m_FreeNodes.
+        // The merged node is not registered, as it will never be a destination of a move.
+        const Node* node = source.node;
+        for(uint32_t level = source.level;
+            node->buddy != VMA_NULL && node->buddy->type == Node::TYPE_FREE;
+            --level)
+        {
+            const FreeNode buddyFreeNode = { pSrcMetadata->LevelToNodeSize(level), source.blockIndex, node->buddy->offset };
+            VmaVectorRemoveSorted<FreeNodeLess>(m_FreeNodes, buddyFreeNode);
+            node = node->parent;
+        }
+        pSrcMetadata->FreeAtOffset(srcOffset);
 
-    const bool canDefragmentOnCpu = maxCpuBytesToMove > 0 && maxCpuAllocationsToMove > 0 &&
-        isHostVisible;
-    const bool canDefragmentOnGpu = maxGpuBytesToMove > 0 && maxGpuAllocationsToMove > 0 &&
-        !IsCorruptionDetectionEnabled() &&
-        ((1u << m_MemoryTypeIndex) & m_hAllocator->GetGpuDefragmentationMemoryTypeBits()) != 0;
+        if(!IsDryRun())
+        {
+            hAlloc->ChangeBlockAllocation(m_hAllocator, m_pBlockVector->GetBlock(move.dstBlockIndex), move.dstOffset);
+            OnAllocationMoved(hAlloc, source.pChanged);
+        }
 
-    // There are options to defragment this memory type.
-    if(canDefragmentOnCpu || canDefragmentOnGpu)
+        ++m_AllocationsMoved;
+        m_BytesMoved += size;
+    }
+
+    m_FreeNodes.clear();
+
+    CoalesceMoves(moves, m_OverlappingMoveSupported);
+
+    return VK_SUCCESS;
+}
+
+void VmaDefragmentationAlgorithm_Buddy::GatherNodes(
+    size_t blockIndex,
+    Node* node,
+    uint32_t level,
+    VmaVector< MoveSource, VmaStlAllocator<MoveSource> >& sources)
+{
+    switch(node->type)
     {
-        bool defragmentOnGpu;
-        // There is only one option to defragment this memory type.
-        if(canDefragmentOnGpu != canDefragmentOnCpu)
+    case Node::TYPE_FREE:
         {
-            defragmentOnGpu = canDefragmentOnGpu;
+            const FreeNode freeNode = { GetBuddyMetadata(blockIndex)->LevelToNodeSize(level), blockIndex, node->offset };
+            m_FreeNodes.push_back(freeNode);
         }
-        // Both options are available: Heuristics to choose the best one.
-        else
+        break;
+    case Node::TYPE_ALLOCATION:
         {
-            defragmentOnGpu = (memPropFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) != 0 ||
-                m_hAllocator->IsIntegratedGpu();
+            MoveSource source = { blockIndex, node, level, VMA_NULL };
+            if(!m_AllAllocations)
+            {
+                const AllocationInfo* const pAllocInfo = VmaBinaryFindFirstNotLess(
+                    m_Allocations.data(),
+                    m_Allocations.data() + m_Allocations.size(),
+                    node->allocation.alloc,
+                    AllocationInfoHandleLess());
+                if(pAllocInfo == m_Allocations.data() + m_Allocations.size() ||
+                    pAllocInfo->m_hAllocation != node->allocation.alloc)
+                {
+                    break;
+                }
+                source.pChanged = pAllocInfo->m_pChanged;
+            }
+            sources.push_back(source);
         }
+        break;
+    case Node::TYPE_SPLIT:
+        GatherNodes(blockIndex, node->split.leftChild, level + 1, sources);
+        GatherNodes(blockIndex, node->split.leftChild->buddy, level + 1, sources);
+        break;
+    default:
+        VMA_ASSERT(0);
+    }
+}
 
-        bool overlappingMoveSupported = !defragmentOnGpu;
+bool VmaDefragmentationAlgorithm_Buddy::MoveMakesSense(
+    size_t dstBlockIndex, VkDeviceSize dstOffset,
+    size_t srcBlockIndex, VkDeviceSize srcOffset)
+{
+    if(dstBlockIndex != srcBlockIndex)
+    {
+        return dstBlockIndex < srcBlockIndex;
+    }
+    return dstOffset < srcOffset;
+}
 
-        if(m_hAllocator->m_UseMutex)
-        {
-            m_Mutex.LockWrite();
-            pCtx->mutexLocked = true;
-        }
+////////////////////////////////////////////////////////////////////////////////
+// VmaBlockVectorDefragmentationContext
+
+VmaBlockVectorDefragmentationContext::VmaBlockVectorDefragmentationContext(
+    VmaAllocator hAllocator,
+    VmaPool hCustomPool,
+    VmaBlockVector* pBlockVector,
+    uint32_t currFrameIndex,
+    uint32_t flags) :
+    res(VK_SUCCESS),
+    mutexLocked(false),
+    blockContexts(VmaStlAllocator<VmaBlockDefragmentationContext>(hAllocator->GetAllocationCallbacks())),
+    m_hAllocator(hAllocator),
+    m_hCustomPool(hCustomPool),
+    m_pBlockVector(pBlockVector),
+    m_CurrFrameIndex(currFrameIndex),
+    m_Flags(flags),
+    m_pAlgorithm(VMA_NULL),
+    m_Allocations(VmaStlAllocator<AllocInfo>(hAllocator->GetAllocationCallbacks())),
+    m_AllAllocations(false),
+    m_pMovedAllocations(VMA_NULL)
+{
+}
+
+VmaBlockVectorDefragmentationContext::~VmaBlockVectorDefragmentationContext()
+{
+    vma_delete(m_hAllocator, m_pAlgorithm);
+}
+
+void VmaBlockVectorDefragmentationContext::AddAllocation(VmaAllocation hAlloc, VkBool32* pChanged)
+{
+    AllocInfo info = { hAlloc, pChanged };
+    m_Allocations.push_back(info);
+}
+
+void VmaBlockVectorDefragmentationContext::Begin(bool overlappingMoveSupported)
+{
+    const bool allAllocations = m_AllAllocations ||
+        m_Allocations.size() == m_pBlockVector->CalcAllocationCount();
 
-        pCtx->Begin(overlappingMoveSupported);
+    /********************************
+    HERE IS THE CHOICE OF DEFRAGMENTATION ALGORITHM.
+    ********************************/
 
-        // Defragment.
+    /*
+    Pools with linear and buddy algorithm have their own defragmentation algorithms.
 
-        const VkDeviceSize maxBytesToMove = defragmentOnGpu ? maxGpuBytesToMove : maxCpuBytesToMove;
-        const uint32_t maxAllocationsToMove = defragmentOnGpu ? maxGpuAllocationsToMove : maxCpuAllocationsToMove;
-        VmaVector< VmaDefragmentationMove, VmaStlAllocator<VmaDefragmentationMove> > moves = 
-            VmaVector< VmaDefragmentationMove, VmaStlAllocator<VmaDefragmentationMove> >(VmaStlAllocator<VmaDefragmentationMove>(m_hAllocator->GetAllocationCallbacks()));
-        pCtx->res = pCtx->GetAlgorithm()->Defragment(moves, maxBytesToMove, maxAllocationsToMove);
+    Best-fit algorithm is used only when explicitly requested.
 
-        // Accumulate statistics.
-        if(pStats != VMA_NULL)
-        {
-            const VkDeviceSize bytesMoved = pCtx->GetAlgorithm()->GetBytesMoved();
-            const uint32_t allocationsMoved = pCtx->GetAlgorithm()->GetAllocationsMoved();
-            pStats->bytesMoved += bytesMoved;
-            pStats->allocationsMoved += allocationsMoved;
-            VMA_ASSERT(bytesMoved <= maxBytesToMove);
-            VMA_ASSERT(allocationsMoved <= maxAllocationsToMove);
-            if(defragmentOnGpu)
-            {
-                maxGpuBytesToMove -= bytesMoved;
-                maxGpuAllocationsToMove -= allocationsMoved;
-            }
-            else
-            {
-                maxCpuBytesToMove -= bytesMoved;
-                maxCpuAllocationsToMove -= allocationsMoved;
-            }
-        }
-    
-        if(pCtx->res >= VK_SUCCESS)
-        {
-            if(defragmentOnGpu)
-            {
-                ApplyDefragmentationMovesGpu(pCtx, moves, commandBuffer);
-            }
-            else
-            {
-                ApplyDefragmentationMovesCpu(pCtx, moves);
-            }
-        }
+    Fast algorithm is supported only when certain criteria are met:
+    - VMA_DEBUG_MARGIN is 0.
+    - All allocations in this block vector are moveable.
+    - There is no possibility of image/buffer granularity conflict.
+    */
+    if(m_pBlockVector->GetAlgorithm() == VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT)
+    {
+        m_pAlgorithm = vma_new(m_hAllocator, VmaDefragmentationAlgorithm_Linear)(
+            m_hAllocator, m_pBlockVector, m_CurrFrameIndex, overlappingMoveSupported);
     }
-}
-
-void VmaBlockVector::DefragmentationEnd(
-    class VmaBlockVectorDefragmentationContext* pCtx,
-    VmaDefragmentationStats* pStats)
-{
-    // Destroy buffers.
-    for(size_t blockIndex = pCtx->blockContexts.size(); blockIndex--; )
+    else if(m_pBlockVector->GetAlgorithm() == VMA_POOL_CREATE_BUDDY_ALGORITHM_BIT)
     {
-        VmaBlockDefragmentationContext& blockCtx = pCtx->blockContexts[blockIndex];
-        if(blockCtx.hBuffer)
-        {
-            (*m_hAllocator->GetVulkanFunctions().vkDestroyBuffer)(
-                m_hAllocator->m_hDevice, blockCtx.hBuffer, m_hAllocator->GetAllocationCallbacks());
-        }
+        m_pAlgorithm = vma_new(m_hAllocator, VmaDefragmentationAlgorithm_Buddy)(
+            m_hAllocator, m_pBlockVector, m_CurrFrameIndex, overlappingMoveSupported);
     }
-
-    if(pCtx->res >= VK_SUCCESS)
+    else if((m_Flags & VMA_DEFRAGMENTATION_BEST_FIT_ALGORITHM_BIT) != 0)
     {
-        FreeEmptyBlocks(pStats);
+        m_pAlgorithm = vma_new(m_hAllocator, VmaDefragmentationAlgorithm_BestFit)(
+            m_hAllocator, m_pBlockVector, m_CurrFrameIndex, overlappingMoveSupported);
     }
-
-    if(pCtx->mutexLocked)
+    else if(VMA_DEBUG_MARGIN == 0 &&
+        allAllocations &&
+        !m_pBlockVector->IsBufferImageGranularityConflictPossible())
     {
-        VMA_ASSERT(m_hAllocator->m_UseMutex);
-        m_Mutex.UnlockWrite();
+        m_pAlgorithm = vma_new(m_hAllocator, VmaDefragmentationAlgorithm_Fast)(
+            m_hAllocator, m_pBlockVector, m_CurrFrameIndex, overlappingMoveSupported);
     }
-}
-
-size_t VmaBlockVector::CalcAllocationCount() const
-{
-    size_t result = 0;
-    for(size_t i = 0; i < m_Blocks.size(); ++i)
+    else
     {
-        result += m_Blocks[i]->m_pMetadata->GetAllocationCount();
+        m_pAlgorithm = vma_new(m_hAllocator, VmaDefragmentationAlgorithm_Generic)(
+            m_hAllocator, m_pBlockVector, m_CurrFrameIndex, overlappingMoveSupported);
     }
-    return result;
-}
 
-bool VmaBlockVector::IsBufferImageGranularityConflictPossible() const
-{
-    if(m_BufferImageGranularity == 1)
+    m_pAlgorithm->SetMovedAllocations(m_pMovedAllocations);
+
+    if(allAllocations)
     {
-        return false;
+        m_pAlgorithm->AddAll();
     }
-    VmaSuballocationType lastSuballocType = VMA_SUBALLOCATION_TYPE_FREE;
-    for(size_t i = 0, count = m_Blocks.size(); i < count; ++i)
+    else
     {
-        VmaDeviceMemoryBlock* const pBlock = m_Blocks[i];
-        VMA_ASSERT(m_Algorithm == 0);
-        VmaBlockMetadata_Generic* const pMetadata = (VmaBlockMetadata_Generic*)pBlock->m_pMetadata;
-        if(pMetadata->IsBufferImageGranularityConflictPossible(m_BufferImageGranularity, lastSuballocType))
+        for(size_t i = 0, count = m_Allocations.size(); i < count; ++i)
         {
-            return true;
+            m_pAlgorithm->AddAllocation(m_Allocations[i].hAlloc, m_Allocations[i].pChanged);
         }
     }
-    return false;
 }
 
-void VmaBlockVector::MakePoolAllocationsLost(
-    uint32_t currentFrameIndex,
-    size_t* pLostAllocationCount)
+////////////////////////////////////////////////////////////////////////////////
+// VmaDefragmentationContext
+
+VmaDefragmentationContext_T::VmaDefragmentationContext_T(
+    VmaAllocator hAllocator,
+    uint32_t currFrameIndex,
+    uint32_t flags,
+    VmaDefragmentationStats* pStats) :
+    m_hAllocator(hAllocator),
+    m_CurrFrameIndex(currFrameIndex),
+    m_Flags(flags),
+    m_pStats(pStats),
+    m_DryRun(false),
+    m_CustomPoolContexts(VmaStlAllocator<VmaBlockVectorDefragmentationContext*>(hAllocator->GetAllocationCallbacks()))
 {
-    VmaMutexLockWrite lock(m_Mutex, m_hAllocator->m_UseMutex);
-    size_t lostAllocationCount = 0;
-    for(uint32_t blockIndex = 0; blockIndex < m_Blocks.size(); ++blockIndex)
-    {
-        VmaDeviceMemoryBlock* const pBlock = m_Blocks[blockIndex];
-        VMA_ASSERT(pBlock);
-        lostAllocationCount += pBlock->m_pMetadata->MakeAllocationsLost(currentFrameIndex, m_FrameInUseCount);
-    }
-    if(pLostAllocationCount != VMA_NULL)
-    {
-        *pLostAllocationCount = lostAllocationCount;
-    }
+    memset(m_DefaultPoolContexts, 0, sizeof(m_DefaultPoolContexts));
 }
 
-VkResult VmaBlockVector::CheckCorruption()
+VmaDefragmentationContext_T::~VmaDefragmentationContext_T()
 {
-    if(!IsCorruptionDetectionEnabled())
+    for(size_t i = m_CustomPoolContexts.size(); i--; )
     {
-        return VK_ERROR_FEATURE_NOT_PRESENT;
+        VmaBlockVectorDefragmentationContext* pBlockVectorCtx = m_CustomPoolContexts[i];
+        if(!m_DryRun)
+        {
+            pBlockVectorCtx->GetBlockVector()->DefragmentationEnd(pBlockVectorCtx, m_pStats);
+        }
+        vma_delete(m_hAllocator, pBlockVectorCtx);
     }
-
-    VmaMutexLockRead lock(m_Mutex, m_hAllocator->m_UseMutex);
-    for(uint32_t blockIndex = 0; blockIndex < m_Blocks.size(); ++blockIndex)
+    for(size_t i = m_hAllocator->m_MemProps.memoryTypeCount; i--; )
     {
-        VmaDeviceMemoryBlock* const pBlock = m_Blocks[blockIndex];
-        VMA_ASSERT(pBlock);
-        VkResult res = pBlock->CheckCorruption(m_hAllocator);
-        if(res != VK_SUCCESS)
+        VmaBlockVectorDefragmentationContext* pBlockVectorCtx = m_DefaultPoolContexts[i];
+        if(pBlockVectorCtx)
         {
-            return res;
+            if(!m_DryRun)
+            {
+                pBlockVectorCtx->GetBlockVector()->DefragmentationEnd(pBlockVectorCtx, m_pStats);
+            }
+            vma_delete(m_hAllocator, pBlockVectorCtx);
         }
     }
-    return VK_SUCCESS;
 }
 
-void VmaBlockVector::AddStats(VmaStats* pStats)
+void VmaDefragmentationContext_T::AddPools(uint32_t poolCount, VmaPool* pPools)
 {
-    const uint32_t memTypeIndex = m_MemoryTypeIndex;
-    const uint32_t memHeapIndex = m_hAllocator->MemoryTypeIndexToHeapIndex(memTypeIndex);
-
-    VmaMutexLockRead lock(m_Mutex, m_hAllocator->m_UseMutex);
-
-    for(uint32_t blockIndex = 0; blockIndex < m_Blocks.size(); ++blockIndex)
+    for(uint32_t poolIndex = 0; poolIndex < poolCount; ++poolIndex)
     {
-        const VmaDeviceMemoryBlock* const pBlock = m_Blocks[blockIndex];
-        VMA_ASSERT(pBlock);
-        VMA_HEAVY_ASSERT(pBlock->Validate());
-        VmaStatInfo allocationStatInfo;
-        pBlock->m_pMetadata->CalcAllocationStatInfo(allocationStatInfo);
-        VmaAddStatInfo(pStats->total, allocationStatInfo);
-        VmaAddStatInfo(pStats->memoryType[memTypeIndex], allocationStatInfo);
-        VmaAddStatInfo(pStats->memoryHeap[memHeapIndex], allocationStatInfo);
+        VmaPool pool = pPools[poolIndex];
+        VMA_ASSERT(pool);
+        VmaBlockVectorDefragmentationContext* pBlockVectorDefragCtx = VMA_NULL;
+        
+        for(size_t i = m_CustomPoolContexts.size(); i--; )
+        {
+            if(m_CustomPoolContexts[i]->GetCustomPool() == pool)
+            {
+                pBlockVectorDefragCtx = m_CustomPoolContexts[i];
+                break;
+            }
+        }
+        
+        if(!pBlockVectorDefragCtx)
+        {
+            pBlockVectorDefragCtx = vma_new(m_hAllocator, VmaBlockVectorDefragmentationContext)(
+                m_hAllocator,
+                pool,
+                &pool->m_BlockVector,
+                m_CurrFrameIndex,
+                m_Flags);
+            m_CustomPoolContexts.push_back(pBlockVectorDefragCtx);
+        }
+
+        pBlockVectorDefragCtx->AddAll();
     }
 }
 
-////////////////////////////////////////////////////////////////////////////////
-// VmaDefragmentationAlgorithm_Generic members definition
-
-VmaDefragmentationAlgorithm_Generic::VmaDefragmentationAlgorithm_Generic(
-    VmaAllocator hAllocator,
-    VmaBlockVector* pBlockVector,
-    uint32_t currentFrameIndex,
-    bool overlappingMoveSupported) :
-    VmaDefragmentationAlgorithm(hAllocator, pBlockVector, currentFrameIndex),
-    m_AllocationCount(0),
-    m_AllAllocations(false),
-    m_BytesMoved(0),
-    m_AllocationsMoved(0),
-    m_Blocks(VmaStlAllocator<BlockInfo*>(hAllocator->GetAllocationCallbacks()))
+void VmaDefragmentationContext_T::AddAllocations(
+    uint32_t allocationCount,
+    VmaAllocation* pAllocations,
+    VkBool32* pAllocationsChanged)
 {
-    // Create block info for each block.
-    const size_t blockCount = m_pBlockVector->m_Blocks.size();
-    for(size_t blockIndex = 0; blockIndex < blockCount; ++blockIndex)
+    // Dispatch pAllocations among defragmentators. Create them when necessary.
+    for(uint32_t allocIndex = 0; allocIndex < allocationCount; ++allocIndex)
     {
-        BlockInfo* pBlockInfo = vma_new(m_hAllocator, BlockInfo)(m_hAllocator->GetAllocationCallbacks());
-        pBlockInfo->m_OriginalBlockIndex = blockIndex;
-        pBlockInfo->m_pBlock = m_pBlockVector->m_Blocks[blockIndex];
-        m_Blocks.push_back(pBlockInfo);
+        const VmaAllocation hAlloc = pAllocations[allocIndex];
+        VMA_ASSERT(hAlloc);
+        // DedicatedAlloc cannot be defragmented.
+        if((hAlloc->GetType() == VmaAllocation_T::ALLOCATION_TYPE_BLOCK) &&
+            // Lost allocation cannot be defragmented.
+            (hAlloc->GetLastUseFrameIndex() != VMA_FRAME_INDEX_LOST))
+        {
+            VmaBlockVectorDefragmentationContext* pBlockVectorDefragCtx = VMA_NULL;
+
+            const VmaPool hAllocPool = hAlloc->GetBlock()->GetParentPool();
+            // This allocation belongs to custom pool.
+            if(hAllocPool != VK_NULL_HANDLE)
+            {
+                for(size_t i = m_CustomPoolContexts.size(); i--; )
+                {
+                    if(m_CustomPoolContexts[i]->GetCustomPool() == hAllocPool)
+                    {
+                        pBlockVectorDefragCtx = m_CustomPoolContexts[i];
+                        break;
+                    }
+                }
+                if(!pBlockVectorDefragCtx)
+                {
+                    pBlockVectorDefragCtx = vma_new(m_hAllocator, VmaBlockVectorDefragmentationContext)(
+                        m_hAllocator,
+                        hAllocPool,
+                        &hAllocPool->m_BlockVector,
+                        m_CurrFrameIndex,
+                        m_Flags);
+                    m_CustomPoolContexts.push_back(pBlockVectorDefragCtx);
+                }
+            }
+            // This allocation belongs to default pool.
+            else
+            {
+                const uint32_t memTypeIndex = hAlloc->GetMemoryTypeIndex();
+                pBlockVectorDefragCtx = m_DefaultPoolContexts[memTypeIndex];
+                if(!pBlockVectorDefragCtx)
+                {
+                    pBlockVectorDefragCtx = vma_new(m_hAllocator, VmaBlockVectorDefragmentationContext)(
+                        m_hAllocator,
+                        VMA_NULL, // hCustomPool
+                        m_hAllocator->m_pBlockVectors[memTypeIndex],
+                        m_CurrFrameIndex,
+                        m_Flags);
+                    m_DefaultPoolContexts[memTypeIndex] = pBlockVectorDefragCtx;
+                }
+            }
+
+            if(pBlockVectorDefragCtx)
+            {
+                VkBool32* const pChanged = (pAllocationsChanged != VMA_NULL) ?
+                    &pAllocationsChanged[allocIndex] : VMA_NULL;
+                pBlockVectorDefragCtx->AddAllocation(hAlloc, pChanged);
+            }
+        }
     }
-
-    // Sort them by m_pBlock pointer value.
-    VMA_SORT(m_Blocks.begin(), m_Blocks.end(), BlockPointerLess());
 }
 
-VmaDefragmentationAlgorithm_Generic::~VmaDefragmentationAlgorithm_Generic()
+VkResult VmaDefragmentationContext_T::Defragment(
+    VkDeviceSize maxCpuBytesToMove, uint32_t maxCpuAllocationsToMove,
+    VkDeviceSize maxGpuBytesToMove, uint32_t maxGpuAllocationsToMove,
+    VkCommandBuffer commandBuffer, VmaDefragmentationStats* pStats)
 {
-    for(size_t i = m_Blocks.size(); i--; )
+    if(pStats)
     {
-        vma_delete(m_hAllocator, m_Blocks[i]);
+        memset(pStats, 0, sizeof(VmaDefragmentationStats));
     }
-}
 
-void VmaDefragmentationAlgorithm_Generic::AddAllocation(VmaAllocation hAlloc, VkBool32* pChanged)
-{
-    // Now as we are inside VmaBlockVector::m_Mutex, we can make final check if this allocation was not lost.
-    if(hAlloc->GetLastUseFrameIndex() != VMA_FRAME_INDEX_LOST)
+    if(commandBuffer == VK_NULL_HANDLE)
     {
-        VmaDeviceMemoryBlock* pBlock = hAlloc->GetBlock();
-        BlockInfoVector::iterator it = VmaBinaryFindFirstNotLess(m_Blocks.begin(), m_Blocks.end(), pBlock, BlockPointerLess());
-        if(it != m_Blocks.end() && (*it)->m_pBlock == pBlock)
+        maxGpuBytesToMove = 0;
+        maxGpuAllocationsToMove = 0;
+    }
+
+    VkResult res = VK_SUCCESS;
+
+    // Process default pools.
+    for(uint32_t memTypeIndex = 0;
+        memTypeIndex < m_hAllocator->GetMemoryTypeCount() && res >= VK_SUCCESS;
+        ++memTypeIndex)
+    {
+        VmaBlockVectorDefragmentationContext* pBlockVectorCtx = m_DefaultPoolContexts[memTypeIndex];
+        if(pBlockVectorCtx)
         {
-            AllocationInfo allocInfo = AllocationInfo(hAlloc, pChanged);
-            (*it)->m_Allocations.push_back(allocInfo);
+            VMA_ASSERT(pBlockVectorCtx->GetBlockVector());
+            pBlockVectorCtx->GetBlockVector()->Defragment(
+                pBlockVectorCtx,
+                pStats,
+                maxCpuBytesToMove, maxCpuAllocationsToMove,
+                maxGpuBytesToMove, maxGpuAllocationsToMove,
+                commandBuffer);
+            if(pBlockVectorCtx->res != VK_SUCCESS)
+            {
+                res = pBlockVectorCtx->res;
+            }
         }
-        else
+    }
+
+    // Process custom pools.
+    for(size_t customCtxIndex = 0, customCtxCount = m_CustomPoolContexts.size();
+        customCtxIndex < customCtxCount && res >= VK_SUCCESS;
+        ++customCtxIndex)
+    {
+        VmaBlockVectorDefragmentationContext* pBlockVectorCtx = m_CustomPoolContexts[customCtxIndex];
+        VMA_ASSERT(pBlockVectorCtx && pBlockVectorCtx->GetBlockVector());
+        pBlockVectorCtx->GetBlockVector()->Defragment(
+            pBlockVectorCtx,
+            pStats,
+            maxCpuBytesToMove, maxCpuAllocationsToMove,
+            maxGpuBytesToMove, maxGpuAllocationsToMove,
+            commandBuffer);
+        if(pBlockVectorCtx->res != VK_SUCCESS)
         {
-            VMA_ASSERT(0);
+            res = pBlockVectorCtx->res;
         }
-
-        ++m_AllocationCount;
     }
+
+    return res;
 }
 
-VkResult VmaDefragmentationAlgorithm_Generic::DefragmentRound(
-    VmaVector< VmaDefragmentationMove, VmaStlAllocator<VmaDefragmentationMove> >& moves,
-    VkDeviceSize maxBytesToMove,
-    uint32_t maxAllocationsToMove)
+VkResult VmaDefragmentationContext_T::Estimate(
+    VkDeviceSize maxCpuBytesToMove, uint32_t maxCpuAllocationsToMove,
+    VkDeviceSize maxGpuBytesToMove, uint32_t maxGpuAllocationsToMove,
+    VkCommandBuffer commandBuffer, VmaDefragmentationEstimate* pEstimate)
 {
-    if(m_Blocks.empty())
+    m_DryRun = true;
+    memset(pEstimate, 0, sizeof(VmaDefragmentationEstimate));
+
+    if(commandBuffer == VK_NULL_HANDLE)
     {
-        return VK_SUCCESS;
+        maxGpuBytesToMove = 0;
+        maxGpuAllocationsToMove = 0;
     }
 
-    // This is a choice based on research.
-    // Option 1:
-    uint32_t strategy = VMA_ALLOCATION_CREATE_STRATEGY_MIN_TIME_BIT;
-    // Option 2:
-    //uint32_t strategy = VMA_ALLOCATION_CREATE_STRATEGY_MIN_MEMORY_BIT;
-    // Option 3:
-    //uint32_t strategy = VMA_ALLOCATION_CREATE_STRATEGY_MIN_FRAGMENTATION_BIT;
+    VmaFragmentationSums sumsBefore = {};
+    VmaFragmentationSums sumsAfter = {};
+    VkResult res = VK_SUCCESS;
 
-    size_t srcBlockMinIndex = 0;
-    // When FAST_ALGORITHM, move allocations from only last out of blocks that contain non-movable allocations.
-    /*
-    if(m_AlgorithmFlags & VMA_DEFRAGMENTATION_FAST_ALGORITHM_BIT)
+    // Process default pools.
+    for(uint32_t memTypeIndex = 0;
+        memTypeIndex < m_hAllocator->GetMemoryTypeCount() && res >= VK_SUCCESS;
+        ++memTypeIndex)
     {
-        const size_t blocksWithNonMovableCount = CalcBlocksWithNonMovableCount();
-        if(blocksWithNonMovableCount > 0)
+        VmaBlockVectorDefragmentationContext* pBlockVectorCtx = m_DefaultPoolContexts[memTypeIndex];
+        if(pBlockVectorCtx)
         {
-            srcBlockMinIndex = blocksWithNonMovableCount - 1;
+            VMA_ASSERT(pBlockVectorCtx->GetBlockVector());
+            pBlockVectorCtx->GetBlockVector()->EstimateDefragmentation(
+                pBlockVectorCtx,
+                *pEstimate,
+                sumsBefore,
+                sumsAfter,
+                maxCpuBytesToMove, maxCpuAllocationsToMove,
+                maxGpuBytesToMove, maxGpuAllocationsToMove);
+            if(pBlockVectorCtx->res != VK_SUCCESS)
+            {
+                res = pBlockVectorCtx->res;
+            }
         }
     }
-    */
 
-    size_t srcBlockIndex = m_Blocks.size() - 1;
-    size_t srcAllocIndex = SIZE_MAX;
-    for(;;)
+    // Process custom pools.
+    for(size_t customCtxIndex = 0, customCtxCount = m_CustomPoolContexts.size();
+        customCtxIndex < customCtxCount && res >= VK_SUCCESS;
+        ++customCtxIndex)
     {
-        // 1. Find next allocation to move.
-        // 1.1. Start from last to first m_Blocks - they are sorted from most "destination" to most "source".
-        // 1.2. Then start from last to first m_Allocations.
-        while(srcAllocIndex >= m_Blocks[srcBlockIndex]->m_Allocations.size())
+        VmaBlockVectorDefragmentationContext* pBlockVectorCtx = m_CustomPoolContexts[customCtxIndex];
+        VMA_ASSERT(pBlockVectorCtx && pBlockVectorCtx->GetBlockVector());
+        pBlockVectorCtx->GetBlockVector()->EstimateDefragmentation(
+            pBlockVectorCtx,
+            *pEstimate,
+            sumsBefore,
+            sumsAfter,
+            maxCpuBytesToMove, maxCpuAllocationsToMove,
+            maxGpuBytesToMove, maxGpuAllocationsToMove);
+        if(pBlockVectorCtx->res != VK_SUCCESS)
         {
-            if(m_Blocks[srcBlockIndex]->m_Allocations.empty())
-            {
-                // Finished: no more allocations to process.
-                if(srcBlockIndex == srcBlockMinIndex)
-                {
-                    return VK_SUCCESS;
-                }
-                else
-                {
-                    --srcBlockIndex;
-                    srcAllocIndex = SIZE_MAX;
-                }
-            }
-            else
-            {
-                srcAllocIndex = m_Blocks[srcBlockIndex]->m_Allocations.size() - 1;
-            }
+            res = pBlockVectorCtx->res;
         }
-        
-        BlockInfo* pSrcBlockInfo = m_Blocks[srcBlockIndex];
-        AllocationInfo& allocInfo = pSrcBlockInfo->m_Allocations[srcAllocIndex];
-
-        const VkDeviceSize size = allocInfo.m_hAllocation->GetSize();
-        const VkDeviceSize srcOffset = allocInfo.m_hAllocation->GetOffset();
-        const VkDeviceSize alignment = allocInfo.m_hAllocation->GetAlignment();
-        const VmaSuballocationType suballocType = allocInfo.m_hAllocation->GetSuballocationType();
+    }
 
-        // 2. Try to find new place for this allocation in preceding or current block.
-        for(size_t dstBlockIndex = 0; dstBlockIndex <= srcBlockIndex; ++dstBlockIndex)
-        {
-            BlockInfo* pDstBlockInfo = m_Blocks[dstBlockIndex];
-            VmaAllocationRequest dstAllocRequest;
-            if(pDstBlockInfo->m_pBlock->m_pMetadata->CreateAllocationRequest(
-                m_CurrentFrameIndex,
-                m_pBlockVector->GetFrameInUseCount(),
-                m_pBlockVector->GetBufferImageGranularity(),
-                size,
-                alignment,
-                false, // upperAddress
-                suballocType,
-                false, // canMakeOtherLost
-                strategy,
-                &dstAllocRequest) &&
-            MoveMakesSense(
-                dstBlockIndex, dstAllocRequest.offset, srcBlockIndex, srcOffset))
-            {
-                VMA_ASSERT(dstAllocRequest.itemsToMakeLostCount == 0);
+    pEstimate->fragmentationBefore = sumsBefore.GetFragmentation();
+    pEstimate->fragmentationAfter = sumsAfter.GetFragmentation();
 
-                // Reached limit on number of allocations or bytes to move.
-                if((m_AllocationsMoved + 1 > maxAllocationsToMove) ||
-                    (m_BytesMoved + size > maxBytesToMove))
-                {
-                    return VK_SUCCESS;
-                }
+    return res;
+}
 
-                VmaDefragmentationMove move;
-                move.srcBlockIndex = pSrcBlockInfo->m_OriginalBlockIndex;
-                move.dstBlockIndex = pDstBlockInfo->m_OriginalBlockIndex;
-                move.srcOffset = srcOffset;
-                move.dstOffset = dstAllocRequest.offset;
-                move.size = size;
-                moves.push_back(move);
+////////////////////////////////////////////////////////////////////////////////
+// VmaRecorder
 
-                pDstBlockInfo->m_pBlock->m_pMetadata->Alloc(
-                    dstAllocRequest,
-                    suballocType,
-                    size,
-                    allocInfo.m_hAllocation);
-                pSrcBlockInfo->m_pBlock->m_pMetadata->FreeAtOffset(srcOffset);
-                
-                allocInfo.m_hAllocation->ChangeBlockAllocation(m_hAllocator, pDstBlockInfo->m_pBlock, dstAllocRequest.offset);
+#if VMA_RECORDING_ENABLED
 
-                if(allocInfo.m_pChanged != VMA_NULL)
-                {
-                    *allocInfo.m_pChanged = VK_TRUE;
-                }
+// Writes LEB128 encoded number, returns number of bytes written, at most 10.
+static inline size_t VmaWriteVarUint(uint8_t* pDst, uint64_t value)
+{
+    size_t size = 0;
+    while(value >= 0x80)
+    {
+        pDst[size++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    pDst[size++] = (uint8_t)value;
+    return size;
+}
 
-                ++m_AllocationsMoved;
-                m_BytesMoved += size;
+// Reads LEB128 encoded number written by VmaWriteVarUint(), advances pSrc after it.
+static inline uint64_t VmaReadVarUint(const uint8_t*& pSrc)
+{
+    uint64_t value = 0;
+    for(uint32_t shift = 0; ; shift += 7)
+    {
+        const uint8_t byte = *pSrc++;
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if((byte & 0x80) == 0)
+        {
+            return value;
+        }
+    }
+}
 
-                VmaVectorRemove(pSrcBlockInfo->m_Allocations, srcAllocIndex);
+// Maps signed number to unsigned, so that numbers close to 0 are encoded in few bytes.
+static inline uint64_t VmaZigZagEncode(int64_t value)
+{
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
 
-                break;
-            }
-        }
+class VmaRecorder::ThreadBuffer
+{
+    VMA_CLASS_NO_COPY(ThreadBuffer)
+public:
+    const uint32_t m_RecordedThreadId;
+    // Index of the buffer, used to refer to this thread in the file.
+    const uint32_t m_Index;
+    const size_t m_Capacity;
 
-        // If not processed, this allocInfo remains in pBlockInfo->m_Allocations for next round.
+    /*
+    Ring buffer with encoded calls. Written only by the owning thread,
+    read only by a thread that holds m_FileMutex. Positions are never wrapped.
 
-        if(srcAllocIndex > 0)
-        {
-            --srcAllocIndex;
-        }
-        else
-        {
-            if(srcBlockIndex > 0)
-            {
-                --srcBlockIndex;
-                srcAllocIndex = SIZE_MAX;
-            }
-            else
+    With VMA_RECORD_FLIGHT_RECORDER_BIT, every call is preceded by its size as varint
+    and m_ReadPos is the position of the oldest call. The owning thread moves it forward
+    to make space for new calls. Contents are read only by Dump(), while m_Writing is false.
+    */
+    char* const m_pData;
+    std::atomic<size_t> m_WritePos;
+    std::atomic<size_t> m_ReadPos;
+    // Block of type VMA_RECORD_BLOCK_TYPE_THREAD was written. Accessed under m_FileMutex.
+    bool m_Announced;
+
+    // Members below are used only with VMA_RECORD_FLIGHT_RECORDER_BIT.
+    // True while the owning thread writes to the ring buffer.
+    std::atomic<bool> m_Writing;
+    // Some calls were overwritten, so the buffer doesn't contain all calls of this thread.
+    bool m_Overwritten;
+    // The owning thread has exited. Protected by m_ThreadBuffersMutex.
+    bool m_Exited;
+    // Calls copied from the ring buffer by Dump(), without their sizes.
+    VmaVector< uint8_t, VmaStlAllocator<uint8_t> > m_DumpedCalls;
+
+    // Encoder state, accessed only by the owning thread.
+    VmaVector< uint8_t, VmaStlAllocator<uint8_t> > m_Call;
+    uint64_t m_PrevCallIndex;
+    int64_t m_PrevTime;
+    uint32_t m_PrevFrameIndex;
+    uint64_t m_PrevAllocation;
+    uint64_t m_PrevPool;
+
+    // Statistics of calls made by the owning thread. Written only by it, read by GetStats().
+    std::atomic<uint64_t> m_RecordedCallCount;
+    std::atomic<uint64_t> m_SkippedCallCount;
+    std::atomic<uint64_t> m_RecordingTicks;
+    // Calls of every function from VmaRecordOptionalFunctionFlagBits since the last recorded one.
+    uint32_t m_OptionalCallCounters[VMA_RECORD_OPTIONAL_FUNCTION_COUNT];
+
+    ThreadBuffer(const VkAllocationCallbacks* pAllocationCallbacks, uint32_t recordedThreadId, uint32_t index, size_t capacity) :
+        m_RecordedThreadId(recordedThreadId),
+        m_Index(index),
+        m_Capacity(capacity),
+        m_pData(capacity > 0 ? VmaAllocateArray<char>(pAllocationCallbacks, capacity) : VMA_NULL),
+        m_WritePos(0),
+        m_ReadPos(0),
+        m_Announced(false),
+        m_Writing(false),
+        m_Overwritten(false),
+        m_Exited(false),
+        m_DumpedCalls(VmaStlAllocator<uint8_t>(pAllocationCallbacks)),
+        m_Call(VmaStlAllocator<uint8_t>(pAllocationCallbacks)),
+        m_PrevCallIndex(0),
+        m_PrevTime(0),
+        m_PrevFrameIndex(0),
+        m_PrevAllocation(0),
+        m_PrevPool(0),
+        m_RecordedCallCount(0),
+        m_SkippedCallCount(0),
+        m_RecordingTicks(0),
+        m_pAllocationCallbacks(pAllocationCallbacks)
+    {
+        memset(m_OptionalCallCounters, 0, sizeof(m_OptionalCallCounters));
+        if(capacity > 0)
+        {
+            m_Call.reserve(256);
+        }
+    }
+    ~ThreadBuffer()
+    {
+        if(m_pData != VMA_NULL)
+        {
+            vma_delete_array(m_pAllocationCallbacks, m_pData, m_Capacity);
+        }
+    }
+
+    // Only the owning thread modifies the statistics, so they don't need atomic read-modify-write.
+    static void Increase(std::atomic<uint64_t>& counter, uint64_t value)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+    void AddRecordedCall(int64_t ticks)
+    {
+        Increase(m_RecordedCallCount, 1);
+        Increase(m_RecordingTicks, (uint64_t)ticks);
+    }
+
+    // Copies data to the ring buffer at given position, which may wrap around its end.
+    void Store(size_t pos, const void* pSrc, size_t size)
+    {
+        const size_t offset = pos % m_Capacity;
+        const size_t size1 = VMA_MIN(size, m_Capacity - offset);
+        memcpy(m_pData + offset, pSrc, size1);
+        memcpy(m_pData, (const char*)pSrc + size1, size - size1);
+    }
+    uint8_t Load(size_t pos) const { return (uint8_t)m_pData[pos % m_Capacity]; }
+    // Reads varint from the ring buffer, advances pos after it.
+    uint64_t LoadVarUint(size_t& pos) const
+    {
+        uint64_t value = 0;
+        for(uint32_t shift = 0; ; shift += 7)
+        {
+            const uint8_t byte = Load(pos++);
+            value |= (uint64_t)(byte & 0x7F) << shift;
+            if((byte & 0x80) == 0)
             {
-                return VK_SUCCESS;
+                return value;
             }
         }
     }
-}
+    // With VMA_RECORD_FLIGHT_RECORDER_BIT - returns index of the newest call in the ring buffer, or 0 if it's empty.
+    uint64_t GetNewestCallIndex() const
+    {
+        uint64_t callIndex = 0;
+        const size_t writePos = m_WritePos.load(std::memory_order_relaxed);
+        for(size_t pos = m_ReadPos.load(std::memory_order_relaxed); pos != writePos; )
+        {
+            const size_t callSize = (size_t)LoadVarUint(pos);
+            size_t indexPos = pos + 1; // After op.
+            callIndex = LoadVarUint(indexPos);
+            pos += callSize;
+        }
+        return callIndex;
+    }
 
-size_t VmaDefragmentationAlgorithm_Generic::CalcBlocksWithNonMovableCount() const
+private:
+    const VkAllocationCallbacks* const m_pAllocationCallbacks;
+};
+
+/*
+Lives in a thread_local variable. Finds buffer of the current thread in a recorder
+without any lock. A buffer is identified by this object rather than by thread ID,
+which may be reused by a new thread after the old one exits.
+*/
+class VmaRecorder::ThreadState
 {
-    size_t result = 0;
-    for(size_t i = 0; i < m_Blocks.size(); ++i)
+    VMA_CLASS_NO_COPY(ThreadState)
+public:
+    ThreadState() : m_Count(0) { }
+    // Called when the thread exits.
+    ~ThreadState()
     {
-        if(m_Blocks[i]->m_HasNonMovableAllocations)
+        LiveRecorderList& liveRecorders = GetLiveRecorders();
+        VmaMutexLock lock(liveRecorders.mutex, true);
+        for(uint32_t i = 0; i < m_Count; ++i)
         {
-            ++result;
+            if(IsLive(m_Entries[i].pRecorder, m_Entries[i].recorderId))
+            {
+                m_Entries[i].pRecorder->RetireThreadBuffer(*m_Entries[i].pBuffer);
+            }
         }
     }
-    return result;
-}
 
-VkResult VmaDefragmentationAlgorithm_Generic::Defragment(
-    VmaVector< VmaDefragmentationMove, VmaStlAllocator<VmaDefragmentationMove> >& moves,
-    VkDeviceSize maxBytesToMove,
-    uint32_t maxAllocationsToMove)
-{
-    if(!m_AllAllocations && m_AllocationCount == 0)
+    ThreadBuffer* Find(uint64_t recorderId) const
     {
-        return VK_SUCCESS;
+        for(uint32_t i = 0; i < m_Count; ++i)
+        {
+            if(m_Entries[i].recorderId == recorderId)
+            {
+                return m_Entries[i].pBuffer;
+            }
+        }
+        return VMA_NULL;
     }
 
-    const size_t blockCount = m_Blocks.size();
-    for(size_t blockIndex = 0; blockIndex < blockCount; ++blockIndex)
+    // m_ThreadBuffersMutex of the recorder must not be locked.
+    void Add(VmaRecorder* pRecorder, ThreadBuffer* pBuffer)
     {
-        BlockInfo* pBlockInfo = m_Blocks[blockIndex];
-
-        if(m_AllAllocations)
+        if(m_Count == MAX_ENTRY_COUNT)
         {
-            VmaBlockMetadata_Generic* pMetadata = (VmaBlockMetadata_Generic*)pBlockInfo->m_pBlock->m_pMetadata;
-            for(VmaSuballocationList::const_iterator it = pMetadata->m_Suballocations.begin();
-                it != pMetadata->m_Suballocations.end();
-                ++it)
+            // Forget buffers of destroyed recorders. If there are none, retire the oldest buffer,
+            // as if the thread exited. Calls it makes to that recorder later go to a new buffer.
+            LiveRecorderList& liveRecorders = GetLiveRecorders();
+            VmaMutexLock lock(liveRecorders.mutex, true);
+            uint32_t dstIndex = 0;
+            for(uint32_t srcIndex = 0; srcIndex < m_Count; ++srcIndex)
             {
-                if(it->type != VMA_SUBALLOCATION_TYPE_FREE)
+                if(IsLive(m_Entries[srcIndex].pRecorder, m_Entries[srcIndex].recorderId))
                 {
-                    AllocationInfo allocInfo = AllocationInfo(it->hAllocation, VMA_NULL);
-                    pBlockInfo->m_Allocations.push_back(allocInfo);
+                    m_Entries[dstIndex++] = m_Entries[srcIndex];
                 }
             }
+            m_Count = dstIndex;
+            if(m_Count == MAX_ENTRY_COUNT)
+            {
+                --m_Count;
+                m_Entries[m_Count].pRecorder->RetireThreadBuffer(*m_Entries[m_Count].pBuffer);
+            }
         }
-
-        pBlockInfo->CalcHasNonMovableAllocations();
-        
-        // This is a choice based on research.
-        // Option 1:
-        pBlockInfo->SortAllocationsByOffsetDescending();
-        // Option 2:
-        //pBlockInfo->SortAllocationsBySizeDescending();
+        // Newest first.
+        memmove(m_Entries + 1, m_Entries, m_Count * sizeof(Entry));
+        m_Entries[0].pRecorder = pRecorder;
+        m_Entries[0].recorderId = pRecorder->m_Id;
+        m_Entries[0].pBuffer = pBuffer;
+        ++m_Count;
     }
 
-    // Sort m_Blocks this time by the main criterium, from most "destination" to most "source" blocks.
-    VMA_SORT(m_Blocks.begin(), m_Blocks.end(), BlockInfoCompareMoveDestination());
-
-    // This is a choice based on research.
-    const uint32_t roundCount = 2;
+private:
+    // Maximum number of recorders used by one thread without retiring its buffers.
+    enum { MAX_ENTRY_COUNT = 4 };
 
-    // Execute defragmentation rounds (the main part).
-    VkResult result = VK_SUCCESS;
-    for(uint32_t round = 0; (round < roundCount) && (result == VK_SUCCESS); ++round)
+    struct Entry
     {
-        result = DefragmentRound(moves, maxBytesToMove, maxAllocationsToMove);
+        // Dereferenced only after IsLive() returns true.
+        VmaRecorder* pRecorder;
+        uint64_t recorderId;
+        ThreadBuffer* pBuffer;
+    };
+
+    Entry m_Entries[MAX_ENTRY_COUNT];
+    uint32_t m_Count;
+};
+
+// Encodes single call into the buffer of the current thread.
+class VmaRecorder::BinaryCall
+{
+public:
+    BinaryCall(VmaRecorder& recorder, VMA_RECORD_OP op, uint32_t frameIndex);
+    // With explicit index and time of the call, used by descriptions of objects.
+    BinaryCall(VmaRecorder& recorder, VMA_RECORD_OP op, uint32_t frameIndex, uint64_t callIndex, int64_t time);
+
+    void Uint(uint64_t value);
+    void Pointer(const void* ptr) { Uint((uint64_t)(uintptr_t)ptr); }
+    void Allocation(VmaAllocation allocation) { Handle(m_Buffer.m_PrevAllocation, allocation); }
+    void Pool(VmaPool pool) { Handle(m_Buffer.m_PrevPool, pool); }
+    void AllocationList(uint64_t count, const VmaAllocation* pAllocations);
+    void PoolList(uint64_t count, const VmaPool* pPools);
+    void UserData(bool isString, const void* pUserData);
+    // Adds time from the beginning of the call to statistics of the thread.
+    ~BinaryCall();
+    // Publishes the call to the writer.
+    void End();
+    // Appends call describing a live object to VmaRecorder::m_DumpState.
+    void EndLiveObject();
+    // Publishes call describing an object destroyed by the previous call, marked with VMA_RECORD_OP_FREED_OBJECT_BIT.
+    void EndFreedObject();
+    uint64_t GetCallIndex() const { return m_Buffer.m_PrevCallIndex; }
+
+private:
+    VmaRecorder& m_Recorder;
+    ThreadBuffer& m_Buffer;
+    // Value of the counter at the beginning of the call. 0 for descriptions of objects, which are not counted as calls.
+    int64_t m_BeginCounter;
+
+    void Begin(VMA_RECORD_OP op, uint64_t callIndex, int64_t time, uint32_t frameIndex);
+    // With VMA_RECORD_FLIGHT_RECORDER_BIT - writes the call to the ring buffer, overwriting the oldest calls.
+    void EndFlightRecorder();
+    void Signed(int64_t value) { Uint(VmaZigZagEncode(value)); }
+    // Handles are encoded as difference from the previous handle of the same kind.
+    void Handle(uint64_t& prev, const void* handle)
+    {
+        const uint64_t value = (uint64_t)(uintptr_t)handle;
+        Signed((int64_t)(value - prev));
+        prev = value;
     }
+};
 
-    return result;
+VmaRecorder::BinaryCall::BinaryCall(VmaRecorder& recorder, VMA_RECORD_OP op, uint32_t frameIndex) :
+    m_Recorder(recorder),
+    m_Buffer(recorder.GetThreadBuffer()),
+    m_BeginCounter(recorder.GetCounter())
+{
+    const int64_t time = m_BeginCounter - m_Recorder.m_StartCounter;
+    // Modification order of a single atomic agrees with happens-before, so it can be relaxed.
+    const uint64_t callIndex = m_Recorder.m_NextCallIndex.fetch_add(1, std::memory_order_relaxed);
+    Begin(op, callIndex, time, frameIndex);
 }
 
-bool VmaDefragmentationAlgorithm_Generic::MoveMakesSense(
-        size_t dstBlockIndex, VkDeviceSize dstOffset,
-        size_t srcBlockIndex, VkDeviceSize srcOffset)
+VmaRecorder::BinaryCall::BinaryCall(VmaRecorder& recorder, VMA_RECORD_OP op, uint32_t frameIndex, uint64_t callIndex, int64_t time) :
+    m_Recorder(recorder),
+    m_Buffer(recorder.GetThreadBuffer()),
+    m_BeginCounter(0)
 {
-    if(dstBlockIndex < srcBlockIndex)
-    {
-        return true;
-    }
-    if(dstBlockIndex > srcBlockIndex)
+    Begin(op, callIndex, time, frameIndex);
+}
+
+VmaRecorder::BinaryCall::~BinaryCall()
+{
+    if(m_BeginCounter != 0)
     {
-        return false;
+        m_Buffer.AddRecordedCall(m_Recorder.GetCounter() - m_BeginCounter);
     }
-    if(dstOffset < srcOffset)
+}
+
+void VmaRecorder::BinaryCall::Begin(VMA_RECORD_OP op, uint64_t callIndex, int64_t time, uint32_t frameIndex)
+{
+    VMA_ASSERT(m_Buffer.m_Call.empty());
+    if(m_Recorder.m_FlightRecorder)
     {
-        return true;
+        // Every call must be decodable on its own, as the previous ones may be overwritten.
+        m_Buffer.m_PrevCallIndex = 0;
+        m_Buffer.m_PrevTime = 0;
+        m_Buffer.m_PrevFrameIndex = 0;
+        m_Buffer.m_PrevAllocation = 0;
+        m_Buffer.m_PrevPool = 0;
     }
-    return false;
+    m_Buffer.m_Call.push_back((uint8_t)op);
+    Uint(callIndex - m_Buffer.m_PrevCallIndex);
+    Signed(time - m_Buffer.m_PrevTime);
+    Signed((int64_t)frameIndex - (int64_t)m_Buffer.m_PrevFrameIndex);
+    m_Buffer.m_PrevCallIndex = callIndex;
+    m_Buffer.m_PrevTime = time;
+    m_Buffer.m_PrevFrameIndex = frameIndex;
 }
 
-////////////////////////////////////////////////////////////////////////////////
-// VmaDefragmentationAlgorithm_Fast
+void VmaRecorder::BinaryCall::Uint(uint64_t value)
+{
+    const size_t oldSize = m_Buffer.m_Call.size();
+    m_Buffer.m_Call.resize(oldSize + 10);
+    m_Buffer.m_Call.resize(oldSize + VmaWriteVarUint(m_Buffer.m_Call.data() + oldSize, value));
+}
 
-VmaDefragmentationAlgorithm_Fast::VmaDefragmentationAlgorithm_Fast(
-    VmaAllocator hAllocator,
-    VmaBlockVector* pBlockVector,
-    uint32_t currentFrameIndex,
-    bool overlappingMoveSupported) :
-    VmaDefragmentationAlgorithm(hAllocator, pBlockVector, currentFrameIndex),
-    m_OverlappingMoveSupported(overlappingMoveSupported),
-    m_AllocationCount(0),
-    m_AllAllocations(false),
-    m_BytesMoved(0),
-    m_AllocationsMoved(0),
-    m_BlockInfos(VmaStlAllocator<BlockInfo>(hAllocator->GetAllocationCallbacks()))
+void VmaRecorder::BinaryCall::AllocationList(uint64_t count, const VmaAllocation* pAllocations)
 {
-    VMA_ASSERT(VMA_DEBUG_MARGIN == 0);
+    Uint(count);
+    for(uint64_t i = 0; i < count; ++i)
+    {
+        Allocation(pAllocations[i]);
+    }
+}
 
+void VmaRecorder::BinaryCall::PoolList(uint64_t count, const VmaPool* pPools)
+{
+    Uint(count);
+    for(uint64_t i = 0; i < count; ++i)
+    {
+        Pool(pPools[i]);
+    }
 }
 
-VmaDefragmentationAlgorithm_Fast::~VmaDefragmentationAlgorithm_Fast()
+void VmaRecorder::BinaryCall::UserData(bool isString, const void* pUserData)
 {
+    if(pUserData == VMA_NULL)
+    {
+        Uint(0);
+    }
+    else if(!isString)
+    {
+        Uint(1);
+        Pointer(pUserData);
+    }
+    else
+    {
+        const size_t len = strlen((const char*)pUserData);
+        Uint(2);
+        Uint(len);
+        const size_t oldSize = m_Buffer.m_Call.size();
+        m_Buffer.m_Call.resize(oldSize + len);
+        memcpy(m_Buffer.m_Call.data() + oldSize, pUserData, len);
+    }
 }
 
-VkResult VmaDefragmentationAlgorithm_Fast::Defragment(
-    VmaVector< VmaDefragmentationMove, VmaStlAllocator<VmaDefragmentationMove> >& moves,
-    VkDeviceSize maxBytesToMove,
-    uint32_t maxAllocationsToMove)
+void VmaRecorder::BinaryCall::End()
 {
-    VMA_ASSERT(m_AllAllocations || m_pBlockVector->CalcAllocationCount() == m_AllocationCount);
+    if(m_Recorder.m_FlightRecorder)
+    {
+        EndFlightRecorder();
+        return;
+    }
 
-    const size_t blockCount = m_pBlockVector->GetBlockCount();
-    if(blockCount == 0 || maxBytesToMove == 0 || maxAllocationsToMove == 0)
+    ThreadBuffer& buf = m_Buffer;
+    const size_t size = buf.m_Call.size();
+    const size_t writePos = buf.m_WritePos.load(std::memory_order_relaxed);
+    size_t usedSize = writePos - buf.m_ReadPos.load(std::memory_order_acquire);
+    if(buf.m_Capacity - usedSize < size)
     {
-        return VK_SUCCESS;
+        // Buffer is full - write it to the file from this thread.
+        VmaMutexLock lock(m_Recorder.m_FileMutex, true);
+        m_Recorder.WriteThreadBuffer(buf);
+        if(size > buf.m_Capacity)
+        {
+            m_Recorder.WriteCallsBlock(buf, buf.m_Call.data(), size, VMA_NULL, 0);
+            buf.m_Call.clear();
+            return;
+        }
+        usedSize = 0;
     }
 
-    PreprocessMetadata();
+    buf.Store(writePos, buf.m_Call.data(), size);
+    buf.m_WritePos.store(writePos + size, std::memory_order_release);
+    buf.m_Call.clear();
 
-    // Sort blocks in order from most destination.
+    // Wake up the writer when the buffer becomes half full.
+    if(usedSize < buf.m_Capacity / 2 && usedSize + size >= buf.m_Capacity / 2)
+    {
+        m_Recorder.m_WriterCond.notify_one();
+    }
+}
 
-    m_BlockInfos.resize(blockCount);
-    for(size_t i = 0; i < blockCount; ++i)
+void VmaRecorder::BinaryCall::EndFlightRecorder()
+{
+    ThreadBuffer& buf = m_Buffer;
+    uint8_t header[10];
+    const size_t callSize = buf.m_Call.size();
+    const size_t headerSize = VmaWriteVarUint(header, callSize);
+    const size_t recordSize = headerSize + callSize;
+    // Call that doesn't fit in the whole buffer is not recorded.
+    if(recordSize <= buf.m_Capacity)
     {
-        m_BlockInfos[i].origBlockIndex = i;
+        m_Recorder.BeginRingWrite(buf);
+        const size_t writePos = buf.m_WritePos.load(std::memory_order_relaxed);
+        size_t readPos = buf.m_ReadPos.load(std::memory_order_relaxed);
+        while(buf.m_Capacity - (writePos - readPos) < recordSize)
+        {
+            const uint64_t oldCallSize = buf.LoadVarUint(readPos);
+            readPos += (size_t)oldCallSize;
+            buf.m_Overwritten = true;
+        }
+        buf.Store(writePos, header, headerSize);
+        buf.Store(writePos + headerSize, buf.m_Call.data(), callSize);
+        buf.m_ReadPos.store(readPos, std::memory_order_relaxed);
+        buf.m_WritePos.store(writePos + recordSize, std::memory_order_relaxed);
+        m_Recorder.EndRingWrite(buf);
     }
+    buf.m_Call.clear();
+}
 
-    VMA_SORT(m_BlockInfos.begin(), m_BlockInfos.end(), [this](const BlockInfo& lhs, const BlockInfo& rhs) -> bool {
-        return m_pBlockVector->GetBlock(lhs.origBlockIndex)->m_pMetadata->GetSumFreeSize() <
-            m_pBlockVector->GetBlock(rhs.origBlockIndex)->m_pMetadata->GetSumFreeSize();
-    });
+void VmaRecorder::BinaryCall::EndLiveObject()
+{
+    VmaVector< uint8_t, VmaStlAllocator<uint8_t> >& state = m_Recorder.m_DumpState;
+    const size_t oldSize = state.size();
+    state.resize(oldSize + m_Buffer.m_Call.size());
+    memcpy(state.data() + oldSize, m_Buffer.m_Call.data(), m_Buffer.m_Call.size());
+    m_Buffer.m_Call.clear();
+}
 
-    // THE MAIN ALGORITHM
+void VmaRecorder::BinaryCall::EndFreedObject()
+{
+    m_Buffer.m_Call[0] |= VMA_RECORD_OP_FREED_OBJECT_BIT;
+    End();
+}
 
-    FreeSpaceDatabase freeSpaceDb;
+#if VMA_RECORDING_COMPRESSION
 
-    size_t dstBlockInfoIndex = 0;
-    size_t dstOrigBlockIndex = m_BlockInfos[dstBlockInfoIndex].origBlockIndex;
-    VmaDeviceMemoryBlock* pDstBlock = m_pBlockVector->GetBlock(dstOrigBlockIndex);
-    VmaBlockMetadata_Generic* pDstMetadata = (VmaBlockMetadata_Generic*)pDstBlock->m_pMetadata;
-    VkDeviceSize dstBlockSize = pDstMetadata->GetSize();
-    VkDeviceSize dstOffset = 0;
+// Collects output of the recording in memory and compresses it to the file on a background thread.
+class VmaRecorder::Compressor
+{
+    VMA_CLASS_NO_COPY(Compressor)
+public:
+    // bytesWritten is increased by the number of compressed bytes written to the file.
+    Compressor(const VkAllocationCallbacks* pAllocationCallbacks, FILE* file, bool flushAfterWrite, std::atomic<uint64_t>& bytesWritten);
+    // Writes remaining data and finishes the compressed stream. Doesn't close the file.
+    ~Compressor();
+    VkResult Init();
 
-    bool end = false;
-    for(size_t srcBlockInfoIndex = 0; !end && srcBlockInfoIndex < blockCount; ++srcBlockInfoIndex)
+    void Write(const void* pData, size_t size);
+    // Returns number of characters written.
+    int PrintV(const char* format, va_list args);
+
+private:
+    typedef VmaVector< char, VmaStlAllocator<char> > Buffer;
+
+    const VkAllocationCallbacks* const m_pAllocationCallbacks;
+    FILE* const m_File;
+    const bool m_FlushAfterWrite;
+    std::atomic<uint64_t>& m_BytesWritten;
+    z_stream m_Stream;
+    bool m_StreamInitialized;
+    std::thread m_Thread;
+
+    std::mutex m_Mutex;
+    // Wakes up the background thread.
+    std::condition_variable m_DataCond;
+    // Wakes up threads waiting for free space in the pending buffer.
+    std::condition_variable m_SpaceCond;
+    bool m_Stop;
+    Buffer m_Buffer1;
+    Buffer m_Buffer2;
+    // Data to be compressed. Accessed under m_Mutex.
+    Buffer* m_pPending;
+    // Data being compressed. Accessed only by the background thread.
+    Buffer* m_pCompressing;
+    // Compressed data. Accessed only by the background thread.
+    VmaVector< Bytef, VmaStlAllocator<Bytef> > m_Output;
+
+    // Waits until there is space in the pending buffer. Returns its current size.
+    size_t BeginAppend(std::unique_lock<std::mutex>& lock);
+    void EndAppend(size_t oldSize);
+    void ThreadMain();
+    void Deflate(int flush);
+
+    static voidpf ZAlloc(voidpf opaque, uInt items, uInt size);
+    static void ZFree(voidpf opaque, voidpf address);
+};
+
+VmaRecorder::Compressor::Compressor(const VkAllocationCallbacks* pAllocationCallbacks, FILE* file, bool flushAfterWrite, std::atomic<uint64_t>& bytesWritten) :
+    m_pAllocationCallbacks(pAllocationCallbacks),
+    m_File(file),
+    m_FlushAfterWrite(flushAfterWrite),
+    m_BytesWritten(bytesWritten),
+    m_StreamInitialized(false),
+    m_Stop(false),
+    m_Buffer1(VmaStlAllocator<char>(pAllocationCallbacks)),
+    m_Buffer2(VmaStlAllocator<char>(pAllocationCallbacks)),
+    m_pPending(&m_Buffer1),
+    m_pCompressing(&m_Buffer2),
+    m_Output(VmaStlAllocator<Bytef>(pAllocationCallbacks))
+{
+    memset(&m_Stream, 0, sizeof(m_Stream));
+}
+
+VmaRecorder::Compressor::~Compressor()
+{
+    if(m_Thread.joinable())
     {
-        const size_t srcOrigBlockIndex = m_BlockInfos[srcBlockInfoIndex].origBlockIndex;
-        VmaDeviceMemoryBlock* const pSrcBlock = m_pBlockVector->GetBlock(srcOrigBlockIndex);
-        VmaBlockMetadata_Generic* const pSrcMetadata = (VmaBlockMetadata_Generic*)pSrcBlock->m_pMetadata;
-        for(VmaSuballocationList::iterator srcSuballocIt = pSrcMetadata->m_Suballocations.begin();
-            !end && srcSuballocIt != pSrcMetadata->m_Suballocations.end(); )
         {
-            VmaAllocation_T* const pAlloc = srcSuballocIt->hAllocation;
-            const VkDeviceSize srcAllocAlignment = pAlloc->GetAlignment();
-            const VkDeviceSize srcAllocSize = srcSuballocIt->size;
-            if(m_AllocationsMoved == maxAllocationsToMove ||
-                m_BytesMoved + srcAllocSize > maxBytesToMove)
-            {
-                end = true;
-                break;
-            }
-            const VkDeviceSize srcAllocOffset = srcSuballocIt->offset;
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Stop = true;
+        }
+        m_DataCond.notify_one();
+        m_Thread.join();
+    }
+    if(m_StreamInitialized)
+    {
+        deflateEnd(&m_Stream);
+    }
+}
 
-            // Try to place it in one of free spaces from the database.
-            size_t freeSpaceInfoIndex;
-            VkDeviceSize dstAllocOffset;
-            if(freeSpaceDb.Fetch(srcAllocAlignment, srcAllocSize,
-                freeSpaceInfoIndex, dstAllocOffset))
-            {
-                size_t freeSpaceOrigBlockIndex = m_BlockInfos[freeSpaceInfoIndex].origBlockIndex;
-                VmaDeviceMemoryBlock* pFreeSpaceBlock = m_pBlockVector->GetBlock(freeSpaceOrigBlockIndex);
-                VmaBlockMetadata_Generic* pFreeSpaceMetadata = (VmaBlockMetadata_Generic*)pFreeSpaceBlock->m_pMetadata;
+VkResult VmaRecorder::Compressor::Init()
+{
+    m_Stream.zalloc = ZAlloc;
+    m_Stream.zfree = ZFree;
+    m_Stream.opaque = (voidpf)m_pAllocationCallbacks;
+    // Window bits above 15 select gzip format.
+    if(deflateInit2(&m_Stream, VMA_RECORDING_COMPRESSION_LEVEL, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+    m_StreamInitialized = true;
 
-                // Same block
-                if(freeSpaceInfoIndex == srcBlockInfoIndex)
-                {
-                    VMA_ASSERT(dstAllocOffset <= srcAllocOffset);
+    m_Buffer1.reserve(VMA_RECORDING_COMPRESSION_BUFFER_SIZE);
+    m_Buffer2.reserve(VMA_RECORDING_COMPRESSION_BUFFER_SIZE);
+    m_Output.resize(64 * 1024);
 
-                    // MOVE OPTION 1: Move the allocation inside the same block by decreasing offset.
+    m_Thread = std::thread(&Compressor::ThreadMain, this);
+    return VK_SUCCESS;
+}
 
-                    VmaSuballocation suballoc = *srcSuballocIt;
-                    suballoc.offset = dstAllocOffset;
-                    suballoc.hAllocation->ChangeOffset(dstAllocOffset);
-                    m_BytesMoved += srcAllocSize;
-                    ++m_AllocationsMoved;
-                    
-                    VmaSuballocationList::iterator nextSuballocIt = srcSuballocIt;
-                    ++nextSuballocIt;
-                    pSrcMetadata->m_Suballocations.erase(srcSuballocIt);
-                    srcSuballocIt = nextSuballocIt;
+void VmaRecorder::Compressor::Write(const void* pData, size_t size)
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    const size_t oldSize = BeginAppend(lock);
+    m_pPending->resize(oldSize + size);
+    memcpy(m_pPending->data() + oldSize, pData, size);
+    EndAppend(oldSize);
+}
 
-                    InsertSuballoc(pFreeSpaceMetadata, suballoc);
+int VmaRecorder::Compressor::PrintV(const char* format, va_list args)
+{
+    // Most lines fit in this size, so they are formatted only once.
+    const size_t expectedMaxSize = 256;
 
-                    VmaDefragmentationMove move = {
-                        srcOrigBlockIndex, freeSpaceOrigBlockIndex,
-                        srcAllocOffset, dstAllocOffset,
-                        srcAllocSize };
-                    moves.push_back(move);
-                }
-                // Different block
-                else
-                {
-                    // MOVE OPTION 2: Move the allocation to a different block.
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    const size_t oldSize = BeginAppend(lock);
+    va_list argsCopy;
+    va_copy(argsCopy, args);
+    m_pPending->resize(oldSize + expectedMaxSize);
+    const int len = vsnprintf(m_pPending->data() + oldSize, expectedMaxSize, format, args);
+    if(len >= (int)expectedMaxSize)
+    {
+        m_pPending->resize(oldSize + (size_t)len + 1);
+        vsnprintf(m_pPending->data() + oldSize, (size_t)len + 1, format, argsCopy);
+    }
+    va_end(argsCopy);
+    m_pPending->resize(oldSize + (len > 0 ? (size_t)len : 0));
+    EndAppend(oldSize);
+    return len;
+}
 
-                    VMA_ASSERT(freeSpaceInfoIndex < srcBlockInfoIndex);
+size_t VmaRecorder::Compressor::BeginAppend(std::unique_lock<std::mutex>& lock)
+{
+    while(m_pPending->size() >= VMA_RECORDING_COMPRESSION_BUFFER_SIZE)
+    {
+        m_DataCond.notify_one();
+        m_SpaceCond.wait(lock);
+    }
+    return m_pPending->size();
+}
 
-                    VmaSuballocation suballoc = *srcSuballocIt;
-                    suballoc.offset = dstAllocOffset;
-                    suballoc.hAllocation->ChangeBlockAllocation(m_hAllocator, pFreeSpaceBlock, dstAllocOffset);
-                    m_BytesMoved += srcAllocSize;
-                    ++m_AllocationsMoved;
+void VmaRecorder::Compressor::EndAppend(size_t oldSize)
+{
+    // Wake up the background thread when the buffer becomes half full.
+    const size_t threshold = VMA_RECORDING_COMPRESSION_BUFFER_SIZE / 2;
+    if(oldSize < threshold && m_pPending->size() >= threshold)
+    {
+        m_DataCond.notify_one();
+    }
+}
 
-                    VmaSuballocationList::iterator nextSuballocIt = srcSuballocIt;
-                    ++nextSuballocIt;
-                    pSrcMetadata->m_Suballocations.erase(srcSuballocIt);
-                    srcSuballocIt = nextSuballocIt;
+void VmaRecorder::Compressor::ThreadMain()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    for(;;)
+    {
+        if(!m_Stop && m_pPending->size() < VMA_RECORDING_COMPRESSION_BUFFER_SIZE / 2)
+        {
+            m_DataCond.wait_for(lock, std::chrono::milliseconds(VMA_RECORDING_BINARY_WRITE_INTERVAL_MILLISECONDS));
+        }
+        const bool stop = m_Stop;
+        VMA_SWAP(m_pPending, m_pCompressing);
+        lock.unlock();
+        m_SpaceCond.notify_all();
 
-                    InsertSuballoc(pFreeSpaceMetadata, suballoc);
+        if(stop)
+        {
+            Deflate(Z_FINISH);
+        }
+        else if(!m_pCompressing->empty())
+        {
+            // Sync flush makes everything written so far possible to decompress.
+            Deflate(m_FlushAfterWrite ? Z_SYNC_FLUSH : Z_NO_FLUSH);
+        }
+        m_pCompressing->clear();
+
+        if(stop)
+        {
+            return;
+        }
+        lock.lock();
+    }
+}
 
-                    VmaDefragmentationMove move = {
-                        srcOrigBlockIndex, freeSpaceOrigBlockIndex,
-                        srcAllocOffset, dstAllocOffset,
-                        srcAllocSize };
-                    moves.push_back(move);
-                }
-            }
-            else
-            {
-                dstAllocOffset = VmaAlignUp(dstOffset, srcAllocAlignment);
+void VmaRecorder::Compressor::Deflate(int flush)
+{
+    m_Stream.next_in = (Bytef*)m_pCompressing->data();
+    m_Stream.avail_in = (uInt)m_pCompressing->size();
+    do
+    {
+        m_Stream.next_out = m_Output.data();
+        m_Stream.avail_out = (uInt)m_Output.size();
+        const int res = deflate(&m_Stream, flush);
+        VMA_ASSERT(res != Z_STREAM_ERROR);
+        (void)res;
+        const size_t outSize = m_Output.size() - m_Stream.avail_out;
+        if(outSize > 0)
+        {
+            fwrite(m_Output.data(), 1, outSize, m_File);
+            m_BytesWritten.fetch_add(outSize, std::memory_order_relaxed);
+        }
+    } while(m_Stream.avail_out == 0);
+    VMA_ASSERT(m_Stream.avail_in == 0);
 
-                // If the allocation doesn't fit before the end of dstBlock, forward to next block.
-                while(dstBlockInfoIndex < srcBlockInfoIndex &&
-                    dstAllocOffset + srcAllocSize > dstBlockSize)
-                {
-                    // But before that, register remaining free space at the end of dst block.
-                    freeSpaceDb.Register(dstBlockInfoIndex, dstOffset, dstBlockSize - dstOffset);
+    if(flush != Z_NO_FLUSH)
+    {
+        fflush(m_File);
+    }
+}
 
-                    ++dstBlockInfoIndex;
-                    dstOrigBlockIndex = m_BlockInfos[dstBlockInfoIndex].origBlockIndex;
-                    pDstBlock = m_pBlockVector->GetBlock(dstOrigBlockIndex);
-                    pDstMetadata = (VmaBlockMetadata_Generic*)pDstBlock->m_pMetadata;
-                    dstBlockSize = pDstMetadata->GetSize();
-                    dstOffset = 0;
-                    dstAllocOffset = 0;
-                }
+voidpf VmaRecorder::Compressor::ZAlloc(voidpf opaque, uInt items, uInt size)
+{
+    return VmaMalloc((const VkAllocationCallbacks*)opaque, (size_t)items * size, VMA_ALIGN_OF(uint64_t));
+}
 
-                // Same block
-                if(dstBlockInfoIndex == srcBlockInfoIndex)
-                {
-                    VMA_ASSERT(dstAllocOffset <= srcAllocOffset);
+void VmaRecorder::Compressor::ZFree(voidpf opaque, voidpf address)
+{
+    VmaFree((const VkAllocationCallbacks*)opaque, address);
+}
 
-                    const bool overlap = dstAllocOffset + srcAllocSize > srcAllocOffset;
+#endif // #if VMA_RECORDING_COMPRESSION
 
-                    bool skipOver = overlap;
-                    if(overlap && m_OverlappingMoveSupported && dstAllocOffset < srcAllocOffset)
-                    {
-                        // If destination and source place overlap, skip if it would move it
-                        // by only < 1/64 of its size.
-                        skipOver = (srcAllocOffset - dstAllocOffset) * 64 < srcAllocSize;
-                    }
+VmaRecorder::VmaRecorder(VmaAllocator hAllocator) :
+    m_UseMutex(true),
+    m_Flags(0),
+    m_File(VMA_NULL),
+    m_Freq(INT64_MAX),
+    m_StartCounter(INT64_MAX),
+#if VMA_RECORDING_USE_TSC
+    m_UseTsc(false),
+#endif
+    m_DisabledFunctions(0),
+    m_OptionalCallSamplingPeriod(1),
+    m_BytesRecorded(0),
+    m_BytesWritten(0),
+    m_pCompressor(VMA_NULL),
+    m_hAllocator(hAllocator),
+    m_pAllocationCallbacks(hAllocator->GetAllocationCallbacks()),
+    m_BinaryFormat(false),
+    m_Id(0),
+    m_pNextLive(VMA_NULL),
+    m_NextCallIndex(0),
+    m_ThreadBuffers(VmaStlAllocator<ThreadBuffer*>(hAllocator->GetAllocationCallbacks())),
+    m_NextThreadIndex(0),
+    m_FreedRecordedCallCount(0),
+    m_FreedSkippedCallCount(0),
+    m_FreedRecordingTicks(0),
+    m_WriterStop(false),
+    m_FlightRecorder(false),
+    m_FlightRecorderBufferSize(0),
+    m_pFilePath(VMA_NULL),
+    m_Dumping(false),
+    m_DumpState(VmaStlAllocator<uint8_t>(hAllocator->GetAllocationCallbacks())),
+    m_DumpedOnFailure(false),
+    m_ExitedThreadBufferCount(0),
+    m_FirstDumpedCallIndex(0)
+{
+}
 
-                    if(skipOver)
-                    {
-                        freeSpaceDb.Register(dstBlockInfoIndex, dstOffset, srcAllocOffset - dstOffset);
+VkResult VmaRecorder::Init(const VmaRecordSettings& settings, bool useMutex)
+{
+    m_UseMutex = useMutex;
+    m_Flags = settings.flags;
+    m_BinaryFormat = (settings.flags & (VMA_RECORD_BINARY_FORMAT_BIT | VMA_RECORD_FLIGHT_RECORDER_BIT)) != 0;
+    m_FlightRecorder = (settings.flags & VMA_RECORD_FLIGHT_RECORDER_BIT) != 0;
+    m_DisabledFunctions = settings.disabledFunctions;
+    m_OptionalCallSamplingPeriod = VMA_MAX(settings.optionalCallSamplingPeriod, 1u);
 
-                        dstOffset = srcAllocOffset + srcAllocSize;
-                        ++srcSuballocIt;
-                    }
-                    // MOVE OPTION 1: Move the allocation inside the same block by decreasing offset.
-                    else
-                    {
-                        srcSuballocIt->offset = dstAllocOffset;
-                        srcSuballocIt->hAllocation->ChangeOffset(dstAllocOffset);
-                        dstOffset = dstAllocOffset + srcAllocSize;
-                        m_BytesMoved += srcAllocSize;
-                        ++m_AllocationsMoved;
-                        ++srcSuballocIt;
-                        VmaDefragmentationMove move = {
-                            srcOrigBlockIndex, dstOrigBlockIndex,
-                            srcAllocOffset, dstAllocOffset,
-                            srcAllocSize };
-                        moves.push_back(move);
-                    }
-                }
-                // Different block
-                else
-                {
-                    // MOVE OPTION 2: Move the allocation to a different block.
+    static std::atomic<uint64_t> nextId(1);
+    m_Id = nextId.fetch_add(1);
+    {
+        LiveRecorderList& liveRecorders = GetLiveRecorders();
+        VmaMutexLock lock(liveRecorders.mutex, true);
+        m_pNextLive = liveRecorders.pFirst;
+        liveRecorders.pFirst = this;
+    }
 
-                    VMA_ASSERT(dstBlockInfoIndex < srcBlockInfoIndex);
-                    VMA_ASSERT(dstAllocOffset + srcAllocSize <= dstBlockSize);
+#if !VMA_RECORDING_COMPRESSION
+    if((settings.flags & VMA_RECORD_COMPRESS_BIT) != 0)
+    {
+        VMA_ASSERT(0 && "VMA_RECORD_COMPRESS_BIT used, but not supported due to VMA_RECORDING_COMPRESSION not defined to 1.");
+        return VK_ERROR_FEATURE_NOT_PRESENT;
+    }
+#endif
 
-                    VmaSuballocation suballoc = *srcSuballocIt;
-                    suballoc.offset = dstAllocOffset;
-                    suballoc.hAllocation->ChangeBlockAllocation(m_hAllocator, pDstBlock, dstAllocOffset);
-                    dstOffset = dstAllocOffset + srcAllocSize;
-                    m_BytesMoved += srcAllocSize;
-                    ++m_AllocationsMoved;
+    InitCounter();
 
-                    VmaSuballocationList::iterator nextSuballocIt = srcSuballocIt;
-                    ++nextSuballocIt;
-                    pSrcMetadata->m_Suballocations.erase(srcSuballocIt);
-                    srcSuballocIt = nextSuballocIt;
+    if(m_FlightRecorder)
+    {
+#if VMA_STATS_STRING_ENABLED
+        // Power of 2, so that positions in the ring buffer stay valid when they overflow.
+        m_FlightRecorderBufferSize = (size_t)VmaNextPow2((uint64_t)(settings.flightRecorderBufferSize != 0 ?
+            settings.flightRecorderBufferSize : VMA_RECORDING_FLIGHT_RECORDER_BUFFER_SIZE));
+        const size_t pathLen = strlen(settings.pFilePath);
+        m_pFilePath = vma_new_array(m_pAllocationCallbacks, char, pathLen + 1);
+        memcpy(m_pFilePath, settings.pFilePath, pathLen + 1);
+        // The file is written only by Dump().
+        return VK_SUCCESS;
+#else
+        VMA_ASSERT(0 && "VMA_RECORD_FLIGHT_RECORDER_BIT used, but not supported due to VMA_STATS_STRING_ENABLED not defined to 1.");
+        return VK_ERROR_FEATURE_NOT_PRESENT;
+#endif
+    }
 
-                    pDstMetadata->m_Suballocations.push_back(suballoc);
+    // Open file for writing.
+#if defined(_WIN32)
+    errno_t err = fopen_s(&m_File, settings.pFilePath, "wb");
+    if(err != 0)
+    {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+#else
+    m_File = fopen(settings.pFilePath, "wb");
+    if(m_File == VMA_NULL)
+    {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+#endif
 
-                    VmaDefragmentationMove move = {
-                        srcOrigBlockIndex, dstOrigBlockIndex,
-                        srcAllocOffset, dstAllocOffset,
-                        srcAllocSize };
-                    moves.push_back(move);
-                }
-            }
+#if VMA_RECORDING_COMPRESSION
+    if((settings.flags & VMA_RECORD_COMPRESS_BIT) != 0)
+    {
+        m_pCompressor = vma_new(m_pAllocationCallbacks, Compressor)(
+            m_pAllocationCallbacks, m_File, (settings.flags & VMA_RECORD_FLUSH_AFTER_CALL_BIT) != 0, m_BytesWritten);
+        const VkResult res = m_pCompressor->Init();
+        if(res != VK_SUCCESS)
+        {
+            return res;
         }
     }
+#endif
 
-    m_BlockInfos.clear();
-    
-    PostprocessMetadata();
+    // Write header.
+    if(m_BinaryFormat)
+    {
+        WriteBinaryHeader(0);
+        m_WriterThread = std::thread(&VmaRecorder::WriterThreadMain, this);
+    }
+    else
+    {
+        Print("%s\n", "Vulkan Memory Allocator,Calls recording");
+        Print("%s\n", "1,7");
+    }
 
     return VK_SUCCESS;
 }
 
-void VmaDefragmentationAlgorithm_Fast::PreprocessMetadata()
+VmaRecorder::~VmaRecorder()
 {
-    const size_t blockCount = m_pBlockVector->GetBlockCount();
-    for(size_t blockIndex = 0; blockIndex < blockCount; ++blockIndex)
+    // From now on, exiting threads leave their buffers to be freed below.
+    if(m_Id != 0)
     {
-        VmaBlockMetadata_Generic* const pMetadata =
-            (VmaBlockMetadata_Generic*)m_pBlockVector->GetBlock(blockIndex)->m_pMetadata;
-        pMetadata->m_FreeCount = 0;
-        pMetadata->m_SumFreeSize = pMetadata->GetSize();
-        pMetadata->m_FreeSuballocationsBySize.clear();
-        for(VmaSuballocationList::iterator it = pMetadata->m_Suballocations.begin();
-            it != pMetadata->m_Suballocations.end(); )
+        LiveRecorderList& liveRecorders = GetLiveRecorders();
+        VmaMutexLock lock(liveRecorders.mutex, true);
+        VmaRecorder** ppRecorder = &liveRecorders.pFirst;
+        while(*ppRecorder != this)
         {
-            if(it->type == VMA_SUBALLOCATION_TYPE_FREE)
-            {
-                VmaSuballocationList::iterator nextIt = it;
-                ++nextIt;
-                pMetadata->m_Suballocations.erase(it);
-                it = nextIt;
-            }
-            else
-            {
-                ++it;
-            }
+            ppRecorder = &(*ppRecorder)->m_pNextLive;
         }
+        *ppRecorder = m_pNextLive;
     }
-}
 
-void VmaDefragmentationAlgorithm_Fast::PostprocessMetadata()
-{
-    const size_t blockCount = m_pBlockVector->GetBlockCount();
-    for(size_t blockIndex = 0; blockIndex < blockCount; ++blockIndex)
+    if(m_WriterThread.joinable())
     {
-        VmaBlockMetadata_Generic* const pMetadata =
-            (VmaBlockMetadata_Generic*)m_pBlockVector->GetBlock(blockIndex)->m_pMetadata;
-        const VkDeviceSize blockSize = pMetadata->GetSize();
-        
-        // No allocations in this block - entire area is free.
-        if(pMetadata->m_Suballocations.empty())
         {
-            pMetadata->m_FreeCount = 1;
-            //pMetadata->m_SumFreeSize is already set to blockSize.
-            VmaSuballocation suballoc = {
-                0, // offset
-                blockSize, // size
-                VMA_NULL, // hAllocation
-                VMA_SUBALLOCATION_TYPE_FREE };
-            pMetadata->m_Suballocations.push_back(suballoc);
-            pMetadata->RegisterFreeSuballocation(pMetadata->m_Suballocations.begin());
+            std::lock_guard<std::mutex> lock(m_WriterMutex);
+            m_WriterStop = true;
         }
-        // There are some allocations in this block.
-        else
-        {
-            VkDeviceSize offset = 0;
-            VmaSuballocationList::iterator it;
-            for(it = pMetadata->m_Suballocations.begin();
-                it != pMetadata->m_Suballocations.end();
-                ++it)
-            {
-                VMA_ASSERT(it->type != VMA_SUBALLOCATION_TYPE_FREE);
-                VMA_ASSERT(it->offset >= offset);
+        m_WriterCond.notify_one();
+        m_WriterThread.join();
 
-                // Need to insert preceding free space.
-                if(it->offset > offset)
-                {
-                    ++pMetadata->m_FreeCount;
-                    const VkDeviceSize freeSize = it->offset - offset;
-                    VmaSuballocation suballoc = {
-                        offset, // offset
-                        freeSize, // size
-                        VMA_NULL, // hAllocation
-                        VMA_SUBALLOCATION_TYPE_FREE };
-                    VmaSuballocationList::iterator precedingFreeIt = pMetadata->m_Suballocations.insert(it, suballoc);
-                    if(freeSize >= VMA_MIN_FREE_SUBALLOCATION_SIZE_TO_REGISTER)
-                    {
-                        pMetadata->m_FreeSuballocationsBySize.push_back(precedingFreeIt);
-                    }
-                }
+        WriteThreadBuffers();
+        const uint8_t blockType = VMA_RECORD_BLOCK_TYPE_END;
+        Write(&blockType, 1);
+    }
+    for(size_t i = m_ThreadBuffers.size(); i--; )
+    {
+        vma_delete(m_pAllocationCallbacks, m_ThreadBuffers[i]);
+    }
+    if(m_pFilePath != VMA_NULL)
+    {
+        vma_delete_array(m_pAllocationCallbacks, m_pFilePath, strlen(m_pFilePath) + 1);
+    }
+#if VMA_RECORDING_COMPRESSION
+    // Finishes the compressed stream, so it must be destroyed before the file is closed.
+    if(m_pCompressor != VMA_NULL)
+    {
+        vma_delete(m_pAllocationCallbacks, m_pCompressor);
+    }
+#endif
+    if(m_File != VMA_NULL)
+    {
+        fclose(m_File);
+    }
+}
 
-                pMetadata->m_SumFreeSize -= it->size;
-                offset = it->offset + it->size;
-            }
+void VmaRecorder::RecordCreateAllocator(uint32_t frameIndex)
+{
+    if(m_BinaryFormat)
+    {
+        BinaryCall call(*this, VMA_RECORD_OP_CREATE_ALLOCATOR, frameIndex);
+        call.End();
+        return;
+    }
 
-            // Need to insert trailing free space.
-            if(offset < blockSize)
-            {
-                ++pMetadata->m_FreeCount;
-                const VkDeviceSize freeSize = blockSize - offset;
-                VmaSuballocation suballoc = {
-                    offset, // offset
-                    freeSize, // size
-                    VMA_NULL, // hAllocation
-                    VMA_SUBALLOCATION_TYPE_FREE };
-                VMA_ASSERT(it == pMetadata->m_Suballocations.end());
-                VmaSuballocationList::iterator trailingFreeIt = pMetadata->m_Suballocations.insert(it, suballoc);
-                if(freeSize > VMA_MIN_FREE_SUBALLOCATION_SIZE_TO_REGISTER)
-                {
-                    pMetadata->m_FreeSuballocationsBySize.push_back(trailingFreeIt);
-                }
-            }
+    CallParams callParams;
+    GetBasicParams(callParams);
+
+    VmaMutexLock lock(m_FileMutex, m_UseMutex);
+    Print("%u,%.3f,%u,vmaCreateAllocator\n", callParams.threadId, callParams.time, frameIndex);
+    EndCall(callParams);
+}
+
+void VmaRecorder::RecordDestroyAllocator(uint32_t frameIndex)
+{
+    if(m_BinaryFormat)
+    {
+        BinaryCall call(*this, VMA_RECORD_OP_DESTROY_ALLOCATOR, frameIndex);
+        call.End();
+        return;
+    }
 
-            VMA_SORT(
-                pMetadata->m_FreeSuballocationsBySize.begin(),
-                pMetadata->m_FreeSuballocationsBySize.end(),
-                VmaSuballocationItemSizeLess());
-        }
+    CallParams callParams;
+    GetBasicParams(callParams);
 
-        VMA_HEAVY_ASSERT(pMetadata->Validate());
+    VmaMutexLock lock(m_FileMutex, m_UseMutex);
+    Print("%u,%.3f,%u,vmaDestroyAllocator\n", callParams.threadId, callParams.time, frameIndex);
+    EndCall(callParams);
+}
+
+void VmaRecorder::RecordCreatePool(uint32_t frameIndex, const VmaPoolCreateInfo& createInfo, VmaPool pool)
+{
+    if(m_BinaryFormat)
+    {
+        BinaryCall call(*this, VMA_RECORD_OP_CREATE_POOL, frameIndex);
+        call.Uint(createInfo.memoryTypeIndex);
+        call.Uint(createInfo.flags);
+        call.Uint(createInfo.blockSize);
+        call.Uint(createInfo.minBlockCount);
+        call.Uint(createInfo.maxBlockCount);
+        call.Uint(createInfo.frameInUseCount);
+        call.Pool(pool);
+        call.End();
+        return;
     }
+
+    CallParams callParams;
+    GetBasicParams(callParams);
+
+    VmaMutexLock lock(m_FileMutex, m_UseMutex);
+    Print("%u,%.3f,%u,vmaCreatePool,%u,%u,%llu,%llu,%llu,%u,%016llX\n", callParams.threadId, callParams.time, frameIndex,
+        createInfo.memoryTypeIndex,
+        createInfo.flags,
+        (unsigned long long)createInfo.blockSize,
+        (unsigned long long)createInfo.minBlockCount,
+        (unsigned long long)createInfo.maxBlockCount,
+        createInfo.frameInUseCount,
+        PtrToUint64(pool));
+    EndCall(callParams);
 }
 
-void VmaDefragmentationAlgorithm_Fast::InsertSuballoc(VmaBlockMetadata_Generic* pMetadata, const VmaSuballocation& suballoc)
+void VmaRecorder::RecordDestroyPool(uint32_t frameIndex, VmaPool pool)
 {
-    // TODO: Optimize somehow. Remember iterator instead of searching for it linearly.
-    VmaSuballocationList::iterator it = pMetadata->m_Suballocations.begin();
-    while(it != pMetadata->m_Suballocations.end())
+    if(m_BinaryFormat)
     {
-        if(it->offset < suballoc.offset)
+        BinaryCall call(*this, VMA_RECORD_OP_DESTROY_POOL, frameIndex);
+        call.Pool(pool);
+        call.End();
+        if(m_FlightRecorder)
         {
-            ++it;
+            DescribePool(frameIndex, pool, call.GetCallIndex());
         }
+        return;
     }
-    pMetadata->m_Suballocations.insert(it, suballoc);
-}
 
-////////////////////////////////////////////////////////////////////////////////
-// VmaBlockVectorDefragmentationContext
+    CallParams callParams;
+    GetBasicParams(callParams);
 
-VmaBlockVectorDefragmentationContext::VmaBlockVectorDefragmentationContext(
-    VmaAllocator hAllocator,
-    VmaPool hCustomPool,
-    VmaBlockVector* pBlockVector,
-    uint32_t currFrameIndex) :
-    res(VK_SUCCESS),
-    mutexLocked(false),
-    blockContexts(VmaStlAllocator<VmaBlockDefragmentationContext>(hAllocator->GetAllocationCallbacks())),
-    m_hAllocator(hAllocator),
-    m_hCustomPool(hCustomPool),
-    m_pBlockVector(pBlockVector),
-    m_CurrFrameIndex(currFrameIndex),
-    m_pAlgorithm(VMA_NULL),
-    m_Allocations(VmaStlAllocator<AllocInfo>(hAllocator->GetAllocationCallbacks())),
-    m_AllAllocations(false)
-{
+    VmaMutexLock lock(m_FileMutex, m_UseMutex);
+    Print("%u,%.3f,%u,vmaDestroyPool,%016llX\n", callParams.threadId, callParams.time, frameIndex,
+        PtrToUint64(pool));
+    EndCall(callParams);
 }
 
-VmaBlockVectorDefragmentationContext::~VmaBlockVectorDefragmentationContext()
+void VmaRecorder::RecordAllocateMemory(uint32_t frameIndex,
+        const VkMemoryRequirements& vkMemReq,
+        const VmaAllocationCreateInfo& createInfo,
+        VmaAllocation allocation)
 {
-    vma_delete(m_hAllocator, m_pAlgorithm);
+    if(m_BinaryFormat)
+    {
+        BinaryCall call(*this, VMA_RECORD_OP_ALLOCATE_MEMORY, frameIndex);
+        call.Uint(vkMemReq.size);
+        call.Uint(vkMemReq.alignment);
+        call.Uint(vkMemReq.memoryTypeBits);
+        call.Uint(createInfo.flags);
+        call.Uint(createInfo.usage);
+        call.Uint(createInfo.requiredFlags);
+        call.Uint(createInfo.preferredFlags);
+        call.Uint(createInfo.memoryTypeBits);
+        call.Pool(createInfo.pool);
+        call.Allocation(allocation);
+        call.UserData((createInfo.flags & VMA_ALLOCATION_CREATE_USER_DATA_COPY_STRING_BIT) != 0, createInfo.pUserData);
+        call.End();
+        if(allocation == VK_NULL_HANDLE)
+        {
+            AllocationFailed();
+        }
+        return;
+    }
+
+    CallParams callParams;
+    GetBasicParams(callParams);
+
+    VmaMutexLock lock(m_FileMutex, m_UseMutex);
+    UserDataString userDataStr(createInfo.flags, createInfo.pUserData);
+    Print("%u,%.3f,%u,vmaAllocateMemory,%llu,%llu,%u,%u,%u,%u,%u,%u,%016llX,%016llX,%s\n", callParams.threadId, callParams.time, frameIndex,
+        (unsigned long long)vkMemReq.size,
+        (unsigned long long)vkMemReq.alignment,
+        vkMemReq.memoryTypeBits,
+        createInfo.flags,
+        createInfo.usage,
+        createInfo.requiredFlags,
+        createInfo.preferredFlags,
+        createInfo.memoryTypeBits,
+        PtrToUint64(createInfo.pool),
+        PtrToUint64(allocation),
+        userDataStr.GetString());
+    EndCall(callParams);
 }
 
-void VmaBlockVectorDefragmentationContext::AddAllocation(VmaAllocation hAlloc, VkBool32* pChanged)
+void VmaRecorder::RecordAllocateMemoryPages(uint32_t frameIndex,
+    const VkMemoryRequirements& vkMemReq,
+    const VmaAllocationCreateInfo& createInfo,
+    uint64_t allocationCount,
+    const VmaAllocation* pAllocations)
 {
-    AllocInfo info = { hAlloc, pChanged };
-    m_Allocations.push_back(info);
+    if(m_BinaryFormat)
+    {
+        BinaryCall call(*this, VMA_RECORD_OP_ALLOCATE_MEMORY_PAGES, frameIndex);
+        call.Uint(vkMemReq.size);
+        call.Uint(vkMemReq.alignment);
+        call.Uint(vkMemReq.memoryTypeBits);
+        call.Uint(createInfo.flags);
+        call.Uint(createInfo.usage);
+        call.Uint(createInfo.requiredFlags);
+        call.Uint(createInfo.preferredFlags);
+        call.Uint(createInfo.memoryTypeBits);
+        call.Pool(createInfo.pool);
+        call.AllocationList(allocationCount, pAllocations);
+        call.UserData((createInfo.flags & VMA_ALLOCATION_CREATE_USER_DATA_COPY_STRING_BIT) != 0, createInfo.pUserData);
+        call.End();
+        if(allocationCount > 0 && pAllocations[0] == VK_NULL_HANDLE)
+        {
+            AllocationFailed();
+        }
+        return;
+    }
+
+    CallParams callParams;
+    GetBasicParams(callParams);
+
+    VmaMutexLock lock(m_FileMutex, m_UseMutex);
+    UserDataString userDataStr(createInfo.flags, createInfo.pUserData);
+    Print("%u,%.3f,%u,vmaAllocateMemoryPages,%llu,%llu,%u,%u,%u,%u,%u,%u,%016llX,", callParams.threadId, callParams.time, frameIndex,
+        (unsigned long long)vkMemReq.size,
+        (unsigned long long)vkMemReq.alignment,
+        vkMemReq.memoryTypeBits,
+        createInfo.flags,
+        createInfo.usage,
+        createInfo.requiredFlags,
+        createInfo.preferredFlags,
+        createInfo.memoryTypeBits,
+        PtrToUint64(createInfo.pool));
+    PrintPointerList(allocationCount, pAllocations);
+    Print(",%s\n", userDataStr.GetString());
+    EndCall(callParams);
 }
 
-void VmaBlockVectorDefragmentationContext::Begin(bool overlappingMoveSupported)
+void VmaRecorder::RecordAllocateMemoryForBuffer(uint32_t frameIndex,
+    const VkMemoryRequirements& vkMemReq,
+    bool requiresDedicatedAllocation,
+    bool prefersDedicatedAllocation,
+    const VmaAllocationCreateInfo& createInfo,
+    VmaAllocation allocation)
 {
-    const bool allAllocations = m_AllAllocations ||
-        m_Allocations.size() == m_pBlockVector->CalcAllocationCount();
+    if(m_BinaryFormat)
+    {
+        BinaryCall call(*this, VMA_RECORD_OP_ALLOCATE_MEMORY_FOR_BUFFER, frameIndex);
+        call.Uint(vkMemReq.size);
+        call.Uint(vkMemReq.alignment);
+        call.Uint(vkMemReq.memoryTypeBits);
+        call.Uint(requiresDedicatedAllocation ? 1 : 0);
+        call.Uint(prefersDedicatedAllocation ? 1 : 0);
+        call.Uint(createInfo.flags);
+        call.Uint(createInfo.usage);
+        call.Uint(createInfo.requiredFlags);
+        call.Uint(createInfo.preferredFlags);
+        call.Uint(createInfo.memoryTypeBits);
+        call.Pool(createInfo.pool);
+        call.Allocation(allocation);
+        call.UserData((createInfo.flags & VMA_ALLOCATION_CREATE_USER_DATA_COPY_STRING_BIT) != 0, createInfo.pUserData);
+        call.End();
+        if(allocation == VK_NULL_HANDLE)
+        {
+            AllocationFailed();
+        }
+        return;
+    }
 
-    /********************************
-    HERE IS THE CHOICE OF DEFRAGMENTATION ALGORITHM.
-    ********************************/
+    CallParams callParams;
+    GetBasicParams(callParams);
 
-    /*
-    Fast algorithm is supported only when certain criteria are met:
-    - VMA_DEBUG_MARGIN is 0.
-    - All allocations in this block vector are moveable.
-    - There is no possibility of image/buffer granularity conflict.
-    */
-    if(VMA_DEBUG_MARGIN == 0 &&
-        allAllocations &&
-        !m_pBlockVector->IsBufferImageGranularityConflictPossible())
-    {
-        m_pAlgorithm = vma_new(m_hAllocator, VmaDefragmentationAlgorithm_Fast)(
-            m_hAllocator, m_pBlockVector, m_CurrFrameIndex, overlappingMoveSupported);
-    }
-    else
-    {
-        m_pAlgorithm = vma_new(m_hAllocator, VmaDefragmentationAlgorithm_Generic)(
-            m_hAllocator, m_pBlockVector, m_CurrFrameIndex, overlappingMoveSupported);
-    }
+    VmaMutexLock lock(m_FileMutex, m_UseMutex);
+    UserDataString userDataStr(createInfo.flags, createInfo.pUserData);
+    Print("%u,%.3f,%u,vmaAllocateMemoryForBuffer,%llu,%llu,%u,%u,%u,%u,%u,%u,%u,%u,%016llX,%016llX,%s\n", callParams.threadId, callParams.time, frameIndex,
+        (unsigned long long)vkMemReq.size,
+        (unsigned long long)vkMemReq.alignment,
+        vkMemReq.memoryTypeBits,
+        requiresDedicatedAllocation ? 1 : 0,
+        prefersDedicatedAllocation ? 1 : 0,
+        createInfo.flags,
+        createInfo.usage,
+        createInfo.requiredFlags,
+        createInfo.preferredFlags,
+        createInfo.memoryTypeBits,
+        PtrToUint64(createInfo.pool),
+        PtrToUint64(allocation),
+        userDataStr.GetString());
+    EndCall(callParams);
+}
 
-    if(allAllocations)
-    {
-        m_pAlgorithm->AddAll();
-    }
-    else
-    {
-        for(size_t i = 0, count = m_Allocations.size(); i < count; ++i)
-        {
-            m_pAlgorithm->AddAllocation(m_Allocations[i].hAlloc, m_Allocations[i].pChanged);
+void VmaRecorder::RecordAllocateMemoryForImage(uint32_t frameIndex,
+    const VkMemoryRequirements& vkMemReq,
+    bool requiresDedicatedAllocation,
+    bool prefersDedicatedAllocation,
+    const VmaAllocationCreateInfo& createInfo,
+    VmaAllocation allocation)
+{
+    if(m_BinaryFormat)
+    {
+        BinaryCall call(*this, VMA_RECORD_OP_ALLOCATE_MEMORY_FOR_IMAGE, frameIndex);
+        call.Uint(vkMemReq.size);
+        call.Uint(vkMemReq.alignment);
+        call.Uint(vkMemReq.memoryTypeBits);
+        call.Uint(requiresDedicatedAllocation ? 1 : 0);
+        call.Uint(prefersDedicatedAllocation ? 1 : 0);
+        call.Uint(createInfo.flags);
+        call.Uint(createInfo.usage);
+        call.Uint(createInfo.requiredFlags);
+        call.Uint(createInfo.preferredFlags);
+        call.Uint(createInfo.memoryTypeBits);
+        call.Pool(createInfo.pool);
+        call.Allocation(allocation);
+        call.UserData((createInfo.flags & VMA_ALLOCATION_CREATE_USER_DATA_COPY_STRING_BIT) != 0, createInfo.pUserData);
+        call.End();
+        if(allocation == VK_NULL_HANDLE)
+        {
+            AllocationFailed();
         }
+        return;
     }
-}
 
-////////////////////////////////////////////////////////////////////////////////
-// VmaDefragmentationContext
+    CallParams callParams;
+    GetBasicParams(callParams);
 
-VmaDefragmentationContext_T::VmaDefragmentationContext_T(
-    VmaAllocator hAllocator,
-    uint32_t currFrameIndex,
-    uint32_t flags,
-    VmaDefragmentationStats* pStats) :
-    m_hAllocator(hAllocator),
-    m_CurrFrameIndex(currFrameIndex),
-    m_Flags(flags),
-    m_pStats(pStats),
-    m_CustomPoolContexts(VmaStlAllocator<VmaBlockVectorDefragmentationContext*>(hAllocator->GetAllocationCallbacks()))
-{
-    memset(m_DefaultPoolContexts, 0, sizeof(m_DefaultPoolContexts));
+    VmaMutexLock lock(m_FileMutex, m_UseMutex);
+    UserDataString userDataStr(createInfo.flags, createInfo.pUserData);
+    Print("%u,%.3f,%u,vmaAllocateMemoryForImage,%llu,%llu,%u,%u,%u,%u,%u,%u,%u,%u,%016llX,%016llX,%s\n", callParams.threadId, callParams.time, frameIndex,
+        (unsigned long long)vkMemReq.size,
+        (unsigned long long)vkMemReq.alignment,
+        vkMemReq.memoryTypeBits,
+        requiresDedicatedAllocation ? 1 : 0,
+        prefersDedicatedAllocation ? 1 : 0,
+        createInfo.flags,
+        createInfo.usage,
+        createInfo.requiredFlags,
+        createInfo.preferredFlags,
+        createInfo.memoryTypeBits,
+        PtrToUint64(createInfo.pool),
+        PtrToUint64(allocation),
+        userDataStr.GetString());
+    EndCall(callParams);
 }
 
-VmaDefragmentationContext_T::~VmaDefragmentationContext_T()
+void VmaRecorder::RecordFreeMemory(uint32_t frameIndex,
+    VmaAllocation allocation)
 {
-    for(size_t i = m_CustomPoolContexts.size(); i--; )
-    {
-        VmaBlockVectorDefragmentationContext* pBlockVectorCtx = m_CustomPoolContexts[i];
-        pBlockVectorCtx->GetBlockVector()->DefragmentationEnd(pBlockVectorCtx, m_pStats);
-        vma_delete(m_hAllocator, pBlockVectorCtx);
-    }
-    for(size_t i = m_hAllocator->m_MemProps.memoryTypeCount; i--; )
+    if(m_BinaryFormat)
     {
-        VmaBlockVectorDefragmentationContext* pBlockVectorCtx = m_DefaultPoolContexts[i];
-        if(pBlockVectorCtx)
+        BinaryCall call(*this, VMA_RECORD_OP_FREE_MEMORY, frameIndex);
+        call.Allocation(allocation);
+        call.End();
+        if(m_FlightRecorder)
         {
-            pBlockVectorCtx->GetBlockVector()->DefragmentationEnd(pBlockVectorCtx, m_pStats);
-            vma_delete(m_hAllocator, pBlockVectorCtx);
+            DescribeAllocation(frameIndex, allocation, call.GetCallIndex());
         }
+        return;
     }
+
+    CallParams callParams;
+    GetBasicParams(callParams);
+
+    VmaMutexLock lock(m_FileMutex, m_UseMutex);
+    Print("%u,%.3f,%u,vmaFreeMemory,%016llX\n", callParams.threadId, callParams.time, frameIndex,
+        PtrToUint64(allocation));
+    EndCall(callParams);
 }
 
-void VmaDefragmentationContext_T::AddPools(uint32_t poolCount, VmaPool* pPools)
+void VmaRecorder::RecordFreeMemoryPages(uint32_t frameIndex,
+    uint64_t allocationCount,
+    const VmaAllocation* pAllocations)
 {
-    for(uint32_t poolIndex = 0; poolIndex < poolCount; ++poolIndex)
+    if(m_BinaryFormat)
     {
-        VmaPool pool = pPools[poolIndex];
-        VMA_ASSERT(pool);
-        // Pools with algorithm other than default are not defragmented.
-        if(pool->m_BlockVector.GetAlgorithm() == 0)
+        BinaryCall call(*this, VMA_RECORD_OP_FREE_MEMORY_PAGES, frameIndex);
+        call.AllocationList(allocationCount, pAllocations);
+        call.End();
+        if(m_FlightRecorder)
         {
-            VmaBlockVectorDefragmentationContext* pBlockVectorDefragCtx = VMA_NULL;
-            
-            for(size_t i = m_CustomPoolContexts.size(); i--; )
-            {
-                if(m_CustomPoolContexts[i]->GetCustomPool() == pool)
-                {
-                    pBlockVectorDefragCtx = m_CustomPoolContexts[i];
-                    break;
-                }
-            }
-            
-            if(!pBlockVectorDefragCtx)
+            const uint64_t callIndex = call.GetCallIndex();
+            for(uint64_t i = 0; i < allocationCount; ++i)
             {
-                pBlockVectorDefragCtx = vma_new(m_hAllocator, VmaBlockVectorDefragmentationContext)(
-                    m_hAllocator,
-                    pool,
-                    &pool->m_BlockVector,
-                    m_CurrFrameIndex);
-                m_CustomPoolContexts.push_back(pBlockVectorDefragCtx);
+                DescribeAllocation(frameIndex, pAllocations[i], callIndex);
             }
-
-            pBlockVectorDefragCtx->AddAll();
         }
+        return;
+    }
+
+    CallParams callParams;
+    GetBasicParams(callParams);
+
+    VmaMutexLock lock(m_FileMutex, m_UseMutex);
+    Print("%u,%.3f,%u,vmaFreeMemoryPages,", callParams.threadId, callParams.time, frameIndex);
+    PrintPointerList(allocationCount, pAllocations);
+    Print("\n");
+    EndCall(callParams);
+}
+
+void VmaRecorder::RecordSetAllocationUserData(uint32_t frameIndex,
+    VmaAllocation allocation,
+    const void* pUserData)
+{
+    if(m_BinaryFormat)
+    {
+        BinaryCall call(*this, VMA_RECORD_OP_SET_ALLOCATION_USER_DATA, frameIndex);
+        call.Allocation(allocation);
+        call.UserData(allocation->IsUserDataString(), pUserData);
+        call.End();
+        return;
+    }
+
+    CallParams callParams;
+    GetBasicParams(callParams);
+
+    VmaMutexLock lock(m_FileMutex, m_UseMutex);
+    UserDataString userDataStr(
+        allocation->IsUserDataString() ? VMA_ALLOCATION_CREATE_USER_DATA_COPY_STRING_BIT : 0,
+        pUserData);
+    Print("%u,%.3f,%u,vmaSetAllocationUserData,%016llX,%s\n", callParams.threadId, callParams.time, frameIndex,
+        PtrToUint64(allocation),
+        userDataStr.GetString());
+    EndCall(callParams);
+}
+
+void VmaRecorder::RecordCreateLostAllocation(uint32_t frameIndex,
+    VmaAllocation allocation)
+{
+    if(m_BinaryFormat)
+    {
+        BinaryCall call(*this, VMA_RECORD_OP_CREATE_LOST_ALLOCATION, frameIndex);
+        call.Allocation(allocation);
+        call.End();
+        return;
     }
+
+    CallParams callParams;
+    GetBasicParams(callParams);
+
+    VmaMutexLock lock(m_FileMutex, m_UseMutex);
+    Print("%u,%.3f,%u,vmaCreateLostAllocation,%016llX\n", callParams.threadId, callParams.time, frameIndex,
+        PtrToUint64(allocation));
+    EndCall(callParams);
 }
 
-void VmaDefragmentationContext_T::AddAllocations(
-    uint32_t allocationCount,
-    VmaAllocation* pAllocations,
-    VkBool32* pAllocationsChanged)
+void VmaRecorder::RecordMapMemory(uint32_t frameIndex,
+    VmaAllocation allocation)
 {
-    // Dispatch pAllocations among defragmentators. Create them when necessary.
-    for(uint32_t allocIndex = 0; allocIndex < allocationCount; ++allocIndex)
+    if(m_BinaryFormat)
     {
-        const VmaAllocation hAlloc = pAllocations[allocIndex];
-        VMA_ASSERT(hAlloc);
-        // DedicatedAlloc cannot be defragmented.
-        if((hAlloc->GetType() == VmaAllocation_T::ALLOCATION_TYPE_BLOCK) &&
-            // Lost allocation cannot be defragmented.
-            (hAlloc->GetLastUseFrameIndex() != VMA_FRAME_INDEX_LOST))
-        {
-            VmaBlockVectorDefragmentationContext* pBlockVectorDefragCtx = VMA_NULL;
+        BinaryCall call(*this, VMA_RECORD_OP_MAP_MEMORY, frameIndex);
+        call.Allocation(allocation);
+        call.End();
+        return;
+    }
 
-            const VmaPool hAllocPool = hAlloc->GetBlock()->GetParentPool();
-            // This allocation belongs to custom pool.
-            if(hAllocPool != VK_NULL_HANDLE)
-            {
-                // Pools with algorithm other than default are not defragmented.
-                if(hAllocPool->m_BlockVector.GetAlgorithm() == 0)
-                {
-                    for(size_t i = m_CustomPoolContexts.size(); i--; )
-                    {
-                        if(m_CustomPoolContexts[i]->GetCustomPool() == hAllocPool)
-                        {
-                            pBlockVectorDefragCtx = m_CustomPoolContexts[i];
-                            break;
-                        }
-                    }
-                    if(!pBlockVectorDefragCtx)
-                    {
-                        pBlockVectorDefragCtx = vma_new(m_hAllocator, VmaBlockVectorDefragmentationContext)(
-                            m_hAllocator,
-                            hAllocPool,
-                            &hAllocPool->m_BlockVector,
-                            m_CurrFrameIndex);
-                        m_CustomPoolContexts.push_back(pBlockVectorDefragCtx);
-                    }
-                }
-            }
-            // This allocation belongs to default pool.
-            else
-            {
-                const uint32_t memTypeIndex = hAlloc->GetMemoryTypeIndex();
-                pBlockVectorDefragCtx = m_DefaultPoolContexts[memTypeIndex];
-                if(!pBlockVectorDefragCtx)
-                {
-                    pBlockVectorDefragCtx = vma_new(m_hAllocator, VmaBlockVectorDefragmentationContext)(
-                        m_hAllocator,
-                        VMA_NULL, // hCustomPool
-                        m_hAllocator->m_pBlockVectors[memTypeIndex],
-                        m_CurrFrameIndex);
-                    m_DefaultPoolContexts[memTypeIndex] = pBlockVectorDefragCtx;
-                }
-            }
+    CallParams callParams;
+    GetBasicParams(callParams);
 
-            if(pBlockVectorDefragCtx)
-            {
-                VkBool32* const pChanged = (pAllocationsChanged != VMA_NULL) ?
-                    &pAllocationsChanged[allocIndex] : VMA_NULL;
-                pBlockVectorDefragCtx->AddAllocation(hAlloc, pChanged);
-            }
-        }
+    VmaMutexLock lock(m_FileMutex, m_UseMutex);
+    Print("%u,%.3f,%u,vmaMapMemory,%016llX\n", callParams.threadId, callParams.time, frameIndex,
+        PtrToUint64(allocation));
+    EndCall(callParams);
+}
+
+void VmaRecorder::RecordUnmapMemory(uint32_t frameIndex,
+    VmaAllocation allocation)
+{
+    if(m_BinaryFormat)
+    {
+        BinaryCall call(*this, VMA_RECORD_OP_UNMAP_MEMORY, frameIndex);
+        call.Allocation(allocation);
+        call.End();
+        return;
     }
+
+    CallParams callParams;
+    GetBasicParams(callParams);
+
+    VmaMutexLock lock(m_FileMutex, m_UseMutex);
+    Print("%u,%.3f,%u,vmaUnmapMemory,%016llX\n", callParams.threadId, callParams.time, frameIndex,
+        PtrToUint64(allocation));
+    EndCall(callParams);
 }
 
-VkResult VmaDefragmentationContext_T::Defragment(
-    VkDeviceSize maxCpuBytesToMove, uint32_t maxCpuAllocationsToMove,
-    VkDeviceSize maxGpuBytesToMove, uint32_t maxGpuAllocationsToMove,
-    VkCommandBuffer commandBuffer, VmaDefragmentationStats* pStats)
+void VmaRecorder::RecordFlushAllocation(uint32_t frameIndex,
+    VmaAllocation allocation, VkDeviceSize offset, VkDeviceSize size)
 {
-    if(pStats)
+    if(!ShouldRecordOptionalCall(VMA_RECORD_OPTIONAL_FUNCTION_FLUSH_ALLOCATION_BIT, allocation))
     {
-        memset(pStats, 0, sizeof(VmaDefragmentationStats));
+        return;
     }
 
-    if(commandBuffer == VK_NULL_HANDLE)
+    if(m_BinaryFormat)
     {
-        maxGpuBytesToMove = 0;
-        maxGpuAllocationsToMove = 0;
+        BinaryCall call(*this, VMA_RECORD_OP_FLUSH_ALLOCATION, frameIndex);
+        call.Allocation(allocation);
+        call.Uint(offset);
+        call.Uint(size);
+        call.End();
+        return;
     }
 
-    VkResult res = VK_SUCCESS;
+    CallParams callParams;
+    GetBasicParams(callParams);
 
-    // Process default pools.
-    for(uint32_t memTypeIndex = 0;
-        memTypeIndex < m_hAllocator->GetMemoryTypeCount() && res >= VK_SUCCESS;
-        ++memTypeIndex)
+    VmaMutexLock lock(m_FileMutex, m_UseMutex);
+    Print("%u,%.3f,%u,vmaFlushAllocation,%016llX,%llu,%llu\n", callParams.threadId, callParams.time, frameIndex,
+        PtrToUint64(allocation),
+        (unsigned long long)offset,
+        (unsigned long long)size);
+    EndCall(callParams);
+}
+
+void VmaRecorder::RecordInvalidateAllocation(uint32_t frameIndex,
+    VmaAllocation allocation, VkDeviceSize offset, VkDeviceSize size)
+{
+    if(!ShouldRecordOptionalCall(VMA_RECORD_OPTIONAL_FUNCTION_INVALIDATE_ALLOCATION_BIT, allocation))
     {
-        VmaBlockVectorDefragmentationContext* pBlockVectorCtx = m_DefaultPoolContexts[memTypeIndex];
-        if(pBlockVectorCtx)
-        {
-            VMA_ASSERT(pBlockVectorCtx->GetBlockVector());
-            pBlockVectorCtx->GetBlockVector()->Defragment(
-                pBlockVectorCtx,
-                pStats,
-                maxCpuBytesToMove, maxCpuAllocationsToMove,
-                maxGpuBytesToMove, maxGpuAllocationsToMove,
-                commandBuffer);
-            if(pBlockVectorCtx->res != VK_SUCCESS)
-            {
-                res = pBlockVectorCtx->res;
-            }
-        }
+        return;
     }
 
-    // Process custom pools.
-    for(size_t customCtxIndex = 0, customCtxCount = m_CustomPoolContexts.size();
-        customCtxIndex < customCtxCount && res >= VK_SUCCESS;
-        ++customCtxIndex)
+    if(m_BinaryFormat)
     {
-        VmaBlockVectorDefragmentationContext* pBlockVectorCtx = m_CustomPoolContexts[customCtxIndex];
-        VMA_ASSERT(pBlockVectorCtx && pBlockVectorCtx->GetBlockVector());
-        pBlockVectorCtx->GetBlockVector()->Defragment(
-            pBlockVectorCtx,
-            pStats,
-            maxCpuBytesToMove, maxCpuAllocationsToMove,
-            maxGpuBytesToMove, maxGpuAllocationsToMove,
-            commandBuffer);
-        if(pBlockVectorCtx->res != VK_SUCCESS)
-        {
-            res = pBlockVectorCtx->res;
-        }
+        BinaryCall call(*this, VMA_RECORD_OP_INVALIDATE_ALLOCATION, frameIndex);
+        call.Allocation(allocation);
+        call.Uint(offset);
+        call.Uint(size);
+        call.End();
+        return;
     }
 
-    return res;
+    CallParams callParams;
+    GetBasicParams(callParams);
+
+    VmaMutexLock lock(m_FileMutex, m_UseMutex);
+    Print("%u,%.3f,%u,vmaInvalidateAllocation,%016llX,%llu,%llu\n", callParams.threadId, callParams.time, frameIndex,
+        PtrToUint64(allocation),
+        (unsigned long long)offset,
+        (unsigned long long)size);
+    EndCall(callParams);
 }
 
-////////////////////////////////////////////////////////////////////////////////
-// VmaRecorder
+void VmaRecorder::RecordCreateBuffer(uint32_t frameIndex,
+    const VkBufferCreateInfo& bufCreateInfo,
+    const VmaAllocationCreateInfo& allocCreateInfo,
+    VmaAllocation allocation)
+{
+    if(m_BinaryFormat)
+    {
+        BinaryCall call(*this, VMA_RECORD_OP_CREATE_BUFFER, frameIndex);
+        call.Uint(bufCreateInfo.flags);
+        call.Uint(bufCreateInfo.size);
+        call.Uint(bufCreateInfo.usage);
+        call.Uint(bufCreateInfo.sharingMode);
+        call.Uint(allocCreateInfo.flags);
+        call.Uint(allocCreateInfo.usage);
+        call.Uint(allocCreateInfo.requiredFlags);
+        call.Uint(allocCreateInfo.preferredFlags);
+        call.Uint(allocCreateInfo.memoryTypeBits);
+        call.Pool(allocCreateInfo.pool);
+        call.Allocation(allocation);
+        call.UserData((allocCreateInfo.flags & VMA_ALLOCATION_CREATE_USER_DATA_COPY_STRING_BIT) != 0, allocCreateInfo.pUserData);
+        call.End();
+        if(allocation == VK_NULL_HANDLE)
+        {
+            AllocationFailed();
+        }
+        return;
+    }
 
-#if VMA_RECORDING_ENABLED
+    CallParams callParams;
+    GetBasicParams(callParams);
 
-VmaRecorder::VmaRecorder() :
-    m_UseMutex(true),
-    m_Flags(0),
-    m_File(VMA_NULL),
-    m_Freq(INT64_MAX),
-    m_StartCounter(INT64_MAX)
-{
+    VmaMutexLock lock(m_FileMutex, m_UseMutex);
+    UserDataString userDataStr(allocCreateInfo.flags, allocCreateInfo.pUserData);
+    Print("%u,%.3f,%u,vmaCreateBuffer,%u,%llu,%u,%u,%u,%u,%u,%u,%u,%016llX,%016llX,%s\n", callParams.threadId, callParams.time, frameIndex,
+        bufCreateInfo.flags,
+        (unsigned long long)bufCreateInfo.size,
+        bufCreateInfo.usage,
+        bufCreateInfo.sharingMode,
+        allocCreateInfo.flags,
+        allocCreateInfo.usage,
+        allocCreateInfo.requiredFlags,
+        allocCreateInfo.preferredFlags,
+        allocCreateInfo.memoryTypeBits,
+        PtrToUint64(allocCreateInfo.pool),
+        PtrToUint64(allocation),
+        userDataStr.GetString());
+    EndCall(callParams);
 }
 
-VkResult VmaRecorder::Init(const VmaRecordSettings& settings, bool useMutex)
+void VmaRecorder::RecordCreateImage(uint32_t frameIndex,
+    const VkImageCreateInfo& imageCreateInfo,
+    const VmaAllocationCreateInfo& allocCreateInfo,
+    VmaAllocation allocation)
 {
-    m_UseMutex = useMutex;
-    m_Flags = settings.flags;
+    if(m_BinaryFormat)
+    {
+        BinaryCall call(*this, VMA_RECORD_OP_CREATE_IMAGE, frameIndex);
+        call.Uint(imageCreateInfo.flags);
+        call.Uint(imageCreateInfo.imageType);
+        call.Uint(imageCreateInfo.format);
+        call.Uint(imageCreateInfo.extent.width);
+        call.Uint(imageCreateInfo.extent.height);
+        call.Uint(imageCreateInfo.extent.depth);
+        call.Uint(imageCreateInfo.mipLevels);
+        call.Uint(imageCreateInfo.arrayLayers);
+        call.Uint(imageCreateInfo.samples);
+        call.Uint(imageCreateInfo.tiling);
+        call.Uint(imageCreateInfo.usage);
+        call.Uint(imageCreateInfo.sharingMode);
+        call.Uint(imageCreateInfo.initialLayout);
+        call.Uint(allocCreateInfo.flags);
+        call.Uint(allocCreateInfo.usage);
+        call.Uint(allocCreateInfo.requiredFlags);
+        call.Uint(allocCreateInfo.preferredFlags);
+        call.Uint(allocCreateInfo.memoryTypeBits);
+        call.Pool(allocCreateInfo.pool);
+        call.Allocation(allocation);
+        call.UserData((allocCreateInfo.flags & VMA_ALLOCATION_CREATE_USER_DATA_COPY_STRING_BIT) != 0, allocCreateInfo.pUserData);
+        call.End();
+        if(allocation == VK_NULL_HANDLE)
+        {
+            AllocationFailed();
+        }
+        return;
+    }
 
-    QueryPerformanceFrequency((LARGE_INTEGER*)&m_Freq);
-    QueryPerformanceCounter((LARGE_INTEGER*)&m_StartCounter);
+    CallParams callParams;
+    GetBasicParams(callParams);
 
-    // Open file for writing.
-    errno_t err = fopen_s(&m_File, settings.pFilePath, "wb");
-    if(err != 0)
+    VmaMutexLock lock(m_FileMutex, m_UseMutex);
+    UserDataString userDataStr(allocCreateInfo.flags, allocCreateInfo.pUserData);
+    Print("%u,%.3f,%u,vmaCreateImage,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%016llX,%016llX,%s\n", callParams.threadId, callParams.time, frameIndex,
+        imageCreateInfo.flags,
+        imageCreateInfo.imageType,
+        imageCreateInfo.format,
+        imageCreateInfo.extent.width,
+        imageCreateInfo.extent.height,
+        imageCreateInfo.extent.depth,
+        imageCreateInfo.mipLevels,
+        imageCreateInfo.arrayLayers,
+        imageCreateInfo.samples,
+        imageCreateInfo.tiling,
+        imageCreateInfo.usage,
+        imageCreateInfo.sharingMode,
+        imageCreateInfo.initialLayout,
+        allocCreateInfo.flags,
+        allocCreateInfo.usage,
+        allocCreateInfo.requiredFlags,
+        allocCreateInfo.preferredFlags,
+        allocCreateInfo.memoryTypeBits,
+        PtrToUint64(allocCreateInfo.pool),
+        PtrToUint64(allocation),
+        userDataStr.GetString());
+    EndCall(callParams);
+}
+
+void VmaRecorder::RecordDestroyBuffer(uint32_t frameIndex,
+    VmaAllocation allocation)
+{
+    if(m_BinaryFormat)
     {
-        return VK_ERROR_INITIALIZATION_FAILED;
+        BinaryCall call(*this, VMA_RECORD_OP_DESTROY_BUFFER, frameIndex);
+        call.Allocation(allocation);
+        call.End();
+        if(m_FlightRecorder)
+        {
+            DescribeAllocation(frameIndex, allocation, call.GetCallIndex());
+        }
+        return;
     }
 
-    // Write header.
-    fprintf(m_File, "%s\n", "Vulkan Memory Allocator,Calls recording");
-    fprintf(m_File, "%s\n", "1,6");
+    CallParams callParams;
+    GetBasicParams(callParams);
 
-    return VK_SUCCESS;
+    VmaMutexLock lock(m_FileMutex, m_UseMutex);
+    Print("%u,%.3f,%u,vmaDestroyBuffer,%016llX\n", callParams.threadId, callParams.time, frameIndex,
+        PtrToUint64(allocation));
+    EndCall(callParams);
 }
 
-VmaRecorder::~VmaRecorder()
+void VmaRecorder::RecordDestroyImage(uint32_t frameIndex,
+    VmaAllocation allocation)
 {
-    if(m_File != VMA_NULL)
+    if(m_BinaryFormat)
     {
-        fclose(m_File);
+        BinaryCall call(*this, VMA_RECORD_OP_DESTROY_IMAGE, frameIndex);
+        call.Allocation(allocation);
+        call.End();
+        if(m_FlightRecorder)
+        {
+            DescribeAllocation(frameIndex, allocation, call.GetCallIndex());
+        }
+        return;
     }
-}
 
-void VmaRecorder::RecordCreateAllocator(uint32_t frameIndex)
-{
     CallParams callParams;
     GetBasicParams(callParams);
 
     VmaMutexLock lock(m_FileMutex, m_UseMutex);
-    fprintf(m_File, "%u,%.3f,%u,vmaCreateAllocator\n", callParams.threadId, callParams.time, frameIndex);
-    Flush();
+    Print("%u,%.3f,%u,vmaDestroyImage,%016llX\n", callParams.threadId, callParams.time, frameIndex,
+        PtrToUint64(allocation));
+    EndCall(callParams);
 }
 
-void VmaRecorder::RecordDestroyAllocator(uint32_t frameIndex)
+void VmaRecorder::RecordTouchAllocation(uint32_t frameIndex,
+    VmaAllocation allocation)
 {
+    if(!ShouldRecordOptionalCall(VMA_RECORD_OPTIONAL_FUNCTION_TOUCH_ALLOCATION_BIT, allocation))
+    {
+        return;
+    }
+
+    if(m_BinaryFormat)
+    {
+        BinaryCall call(*this, VMA_RECORD_OP_TOUCH_ALLOCATION, frameIndex);
+        call.Allocation(allocation);
+        call.End();
+        return;
+    }
+
     CallParams callParams;
     GetBasicParams(callParams);
 
     VmaMutexLock lock(m_FileMutex, m_UseMutex);
-    fprintf(m_File, "%u,%.3f,%u,vmaDestroyAllocator\n", callParams.threadId, callParams.time, frameIndex);
-    Flush();
+    Print("%u,%.3f,%u,vmaTouchAllocation,%016llX\n", callParams.threadId, callParams.time, frameIndex,
+        PtrToUint64(allocation));
+    EndCall(callParams);
 }
 
-void VmaRecorder::RecordCreatePool(uint32_t frameIndex, const VmaPoolCreateInfo& createInfo, VmaPool pool)
-{
+void VmaRecorder::RecordGetAllocationInfo(uint32_t frameIndex,
+    VmaAllocation allocation)
+{
+    if(!ShouldRecordOptionalCall(VMA_RECORD_OPTIONAL_FUNCTION_GET_ALLOCATION_INFO_BIT, allocation))
+    {
+        return;
+    }
+
+    if(m_BinaryFormat)
+    {
+        BinaryCall call(*this, VMA_RECORD_OP_GET_ALLOCATION_INFO, frameIndex);
+        call.Allocation(allocation);
+        call.End();
+        return;
+    }
+
     CallParams callParams;
     GetBasicParams(callParams);
 
     VmaMutexLock lock(m_FileMutex, m_UseMutex);
-    fprintf(m_File, "%u,%.3f,%u,vmaCreatePool,%u,%u,%llu,%llu,%llu,%u,%p\n", callParams.threadId, callParams.time, frameIndex,
-        createInfo.memoryTypeIndex,
-        createInfo.flags,
-        createInfo.blockSize,
-        (uint64_t)createInfo.minBlockCount,
-        (uint64_t)createInfo.maxBlockCount,
-        createInfo.frameInUseCount,
-        pool);
-    Flush();
+    Print("%u,%.3f,%u,vmaGetAllocationInfo,%016llX\n", callParams.threadId, callParams.time, frameIndex,
+        PtrToUint64(allocation));
+    EndCall(callParams);
 }
 
-void VmaRecorder::RecordDestroyPool(uint32_t frameIndex, VmaPool pool)
+void VmaRecorder::RecordMakePoolAllocationsLost(uint32_t frameIndex,
+    VmaPool pool)
 {
+    if(m_BinaryFormat)
+    {
+        BinaryCall call(*this, VMA_RECORD_OP_MAKE_POOL_ALLOCATIONS_LOST, frameIndex);
+        call.Pool(pool);
+        call.End();
+        return;
+    }
+
     CallParams callParams;
     GetBasicParams(callParams);
 
     VmaMutexLock lock(m_FileMutex, m_UseMutex);
-    fprintf(m_File, "%u,%.3f,%u,vmaDestroyPool,%p\n", callParams.threadId, callParams.time, frameIndex,
-        pool);
-    Flush();
+    Print("%u,%.3f,%u,vmaMakePoolAllocationsLost,%016llX\n", callParams.threadId, callParams.time, frameIndex,
+        PtrToUint64(pool));
+    EndCall(callParams);
 }
 
-void VmaRecorder::RecordAllocateMemory(uint32_t frameIndex,
-        const VkMemoryRequirements& vkMemReq,
-        const VmaAllocationCreateInfo& createInfo,
-        VmaAllocation allocation)
-{
+void VmaRecorder::RecordFreePoolAllocations(uint32_t frameIndex,
+    VmaPool pool,
+    uint32_t lastFrameIndex,
+    uint64_t freedAllocationCount,
+    uint64_t allocationCount,
+    const VmaAllocation* pAllocations,
+    size_t suballocationCount,
+    const VmaSuballocation* pSuballocations)
+{
+    if(m_BinaryFormat)
+    {
+        BinaryCall call(*this, VMA_RECORD_OP_FREE_POOL_ALLOCATIONS, frameIndex);
+        call.Pool(pool);
+        call.Uint(lastFrameIndex);
+        call.Uint(freedAllocationCount);
+        call.AllocationList(allocationCount, pAllocations);
+        call.End();
+        if(m_FlightRecorder)
+        {
+            // In their frames, so that this call frees them again during replay.
+            VMA_ASSERT(suballocationCount == freedAllocationCount);
+            const uint64_t callIndex = call.GetCallIndex();
+            const uint32_t memoryTypeIndex = pool->m_BlockVector.GetMemoryTypeIndex();
+            for(size_t i = 0; i < suballocationCount; ++i)
+            {
+                const VmaSuballocation& suballoc = pSuballocations[i];
+                if(suballoc.hAllocation != VK_NULL_HANDLE)
+                {
+                    DescribeAllocation(suballoc.frameIndex, suballoc.hAllocation, callIndex);
+                }
+                else
+                {
+                    DescribeHandlelessAllocation(pool, memoryTypeIndex, suballoc, callIndex);
+                }
+            }
+        }
+        return;
+    }
+
     CallParams callParams;
     GetBasicParams(callParams);
 
     VmaMutexLock lock(m_FileMutex, m_UseMutex);
-    UserDataString userDataStr(createInfo.flags, createInfo.pUserData);
-    fprintf(m_File, "%u,%.3f,%u,vmaAllocateMemory,%llu,%llu,%u,%u,%u,%u,%u,%u,%p,%p,%s\n", callParams.threadId, callParams.time, frameIndex,
-        vkMemReq.size,
-        vkMemReq.alignment,
-        vkMemReq.memoryTypeBits,
-        createInfo.flags,
-        createInfo.usage,
-        createInfo.requiredFlags,
-        createInfo.preferredFlags,
-        createInfo.memoryTypeBits,
-        createInfo.pool,
-        allocation,
-        userDataStr.GetString());
-    Flush();
+    Print("%u,%.3f,%u,vmaFreePoolAllocations,%016llX,%u,%llu,", callParams.threadId, callParams.time, frameIndex,
+        PtrToUint64(pool),
+        lastFrameIndex,
+        (unsigned long long)freedAllocationCount);
+    PrintPointerList(allocationCount, pAllocations);
+    Print("\n");
+    EndCall(callParams);
 }
 
-void VmaRecorder::RecordAllocateMemoryPages(uint32_t frameIndex,
+void VmaRecorder::RecordAllocateMemoryWithoutHandle(uint32_t frameIndex,
     const VkMemoryRequirements& vkMemReq,
     const VmaAllocationCreateInfo& createInfo,
-    uint64_t allocationCount,
-    const VmaAllocation* pAllocations)
-{
+    bool succeeded)
+{
+    if(m_BinaryFormat)
+    {
+        BinaryCall call(*this, VMA_RECORD_OP_ALLOCATE_MEMORY_WITHOUT_HANDLE, frameIndex);
+        call.Uint(vkMemReq.size);
+        call.Uint(vkMemReq.alignment);
+        call.Uint(vkMemReq.memoryTypeBits);
+        call.Uint(createInfo.flags);
+        call.Uint(createInfo.usage);
+        call.Uint(createInfo.requiredFlags);
+        call.Uint(createInfo.preferredFlags);
+        call.Uint(createInfo.memoryTypeBits);
+        call.Pool(createInfo.pool);
+        call.Uint(succeeded ? 1 : 0);
+        call.End();
+        if(!succeeded)
+        {
+            AllocationFailed();
+        }
+        return;
+    }
+
     CallParams callParams;
     GetBasicParams(callParams);
 
     VmaMutexLock lock(m_FileMutex, m_UseMutex);
-    UserDataString userDataStr(createInfo.flags, createInfo.pUserData);
-    fprintf(m_File, "%u,%.3f,%u,vmaAllocateMemoryPages,%llu,%llu,%u,%u,%u,%u,%u,%u,%p,", callParams.threadId, callParams.time, frameIndex,
-        vkMemReq.size,
-        vkMemReq.alignment,
+    Print("%u,%.3f,%u,vmaAllocateMemoryWithoutHandle,%llu,%llu,%u,%u,%u,%u,%u,%u,%016llX,%u\n", callParams.threadId, callParams.time, frameIndex,
+        (unsigned long long)vkMemReq.size,
+        (unsigned long long)vkMemReq.alignment,
         vkMemReq.memoryTypeBits,
         createInfo.flags,
         createInfo.usage,
         createInfo.requiredFlags,
         createInfo.preferredFlags,
         createInfo.memoryTypeBits,
-        createInfo.pool);
-    PrintPointerList(allocationCount, pAllocations);
-    fprintf(m_File, ",%s\n", userDataStr.GetString());
-    Flush();
+        PtrToUint64(createInfo.pool),
+        succeeded ? 1 : 0);
+    EndCall(callParams);
 }
 
-void VmaRecorder::RecordAllocateMemoryForBuffer(uint32_t frameIndex,
-    const VkMemoryRequirements& vkMemReq,
-    bool requiresDedicatedAllocation,
-    bool prefersDedicatedAllocation,
-    const VmaAllocationCreateInfo& createInfo,
-    VmaAllocation allocation)
+void VmaRecorder::RecordDefragmentationBegin(uint32_t frameIndex,
+    const VmaDefragmentationInfo2& info,
+    VmaDefragmentationContext ctx)
 {
+    if(m_BinaryFormat)
+    {
+        BinaryCall call(*this, VMA_RECORD_OP_DEFRAGMENTATION_BEGIN, frameIndex);
+        call.Uint(info.flags);
+        call.AllocationList(info.allocationCount, info.pAllocations);
+        call.PoolList(info.poolCount, info.pPools);
+        call.Uint(info.maxCpuBytesToMove);
+        call.Uint(info.maxCpuAllocationsToMove);
+        call.Uint(info.maxGpuBytesToMove);
+        call.Uint(info.maxGpuAllocationsToMove);
+        call.Pointer(info.commandBuffer);
+        call.Pointer(ctx);
+        call.End();
+        return;
+    }
+
     CallParams callParams;
     GetBasicParams(callParams);
 
     VmaMutexLock lock(m_FileMutex, m_UseMutex);
-    UserDataString userDataStr(createInfo.flags, createInfo.pUserData);
-    fprintf(m_File, "%u,%.3f,%u,vmaAllocateMemoryForBuffer,%llu,%llu,%u,%u,%u,%u,%u,%u,%u,%u,%p,%p,%s\n", callParams.threadId, callParams.time, frameIndex,
-        vkMemReq.size,
-        vkMemReq.alignment,
-        vkMemReq.memoryTypeBits,
-        requiresDedicatedAllocation ? 1 : 0,
-        prefersDedicatedAllocation ? 1 : 0,
-        createInfo.flags,
-        createInfo.usage,
-        createInfo.requiredFlags,
-        createInfo.preferredFlags,
-        createInfo.memoryTypeBits,
-        createInfo.pool,
-        allocation,
-        userDataStr.GetString());
-    Flush();
+    Print("%u,%.3f,%u,vmaDefragmentationBegin,%u,", callParams.threadId, callParams.time, frameIndex,
+        info.flags);
+    PrintPointerList(info.allocationCount, info.pAllocations);
+    Print(",");
+    PrintPointerList(info.poolCount, info.pPools);
+    Print(",%llu,%u,%llu,%u,%016llX,%016llX\n",
+        (unsigned long long)info.maxCpuBytesToMove,
+        info.maxCpuAllocationsToMove,
+        (unsigned long long)info.maxGpuBytesToMove,
+        info.maxGpuAllocationsToMove,
+        PtrToUint64(info.commandBuffer),
+        PtrToUint64(ctx));
+    EndCall(callParams);
 }
 
-void VmaRecorder::RecordAllocateMemoryForImage(uint32_t frameIndex,
-    const VkMemoryRequirements& vkMemReq,
-    bool requiresDedicatedAllocation,
-    bool prefersDedicatedAllocation,
-    const VmaAllocationCreateInfo& createInfo,
-    VmaAllocation allocation)
+void VmaRecorder::RecordDefragmentationEnd(uint32_t frameIndex,
+    VmaDefragmentationContext ctx)
 {
+    if(m_BinaryFormat)
+    {
+        BinaryCall call(*this, VMA_RECORD_OP_DEFRAGMENTATION_END, frameIndex);
+        call.Pointer(ctx);
+        call.End();
+        return;
+    }
+
     CallParams callParams;
     GetBasicParams(callParams);
 
     VmaMutexLock lock(m_FileMutex, m_UseMutex);
-    UserDataString userDataStr(createInfo.flags, createInfo.pUserData);
-    fprintf(m_File, "%u,%.3f,%u,vmaAllocateMemoryForImage,%llu,%llu,%u,%u,%u,%u,%u,%u,%u,%u,%p,%p,%s\n", callParams.threadId, callParams.time, frameIndex,
-        vkMemReq.size,
-        vkMemReq.alignment,
-        vkMemReq.memoryTypeBits,
-        requiresDedicatedAllocation ? 1 : 0,
-        prefersDedicatedAllocation ? 1 : 0,
-        createInfo.flags,
-        createInfo.usage,
-        createInfo.requiredFlags,
-        createInfo.preferredFlags,
-        createInfo.memoryTypeBits,
-        createInfo.pool,
-        allocation,
-        userDataStr.GetString());
-    Flush();
+    Print("%u,%.3f,%u,vmaDefragmentationEnd,%016llX\n", callParams.threadId, callParams.time, frameIndex,
+        PtrToUint64(ctx));
+    EndCall(callParams);
 }
 
-void VmaRecorder::RecordFreeMemory(uint32_t frameIndex,
-    VmaAllocation allocation)
+VmaRecorder::UserDataString::UserDataString(VmaAllocationCreateFlags allocFlags, const void* pUserData)
 {
-    CallParams callParams;
-    GetBasicParams(callParams);
+    if(pUserData != VMA_NULL)
+    {
+        if((allocFlags & VMA_ALLOCATION_CREATE_USER_DATA_COPY_STRING_BIT) != 0)
+        {
+            m_Str = (const char*)pUserData;
+        }
+        else
+        {
+            snprintf(m_PtrStr, sizeof(m_PtrStr), "%016llX", PtrToUint64(pUserData));
+            m_Str = m_PtrStr;
+        }
+    }
+    else
+    {
+        m_Str = "";
+    }
+}
 
-    VmaMutexLock lock(m_FileMutex, m_UseMutex);
-    fprintf(m_File, "%u,%.3f,%u,vmaFreeMemory,%p\n", callParams.threadId, callParams.time, frameIndex,
-        allocation);
-    Flush();
+void VmaRecorder::WriteConfiguration(
+    const VkPhysicalDeviceProperties& devProps,
+    const VkPhysicalDeviceMemoryProperties& memProps,
+    bool dedicatedAllocationExtensionEnabled,
+    bool bindMemory2ExtensionEnabled)
+{
+    // With flight recorder, configuration is written at the beginning of every dump.
+    if(!m_FlightRecorder)
+    {
+        PrintConfiguration(devProps, memProps, dedicatedAllocationExtensionEnabled, bindMemory2ExtensionEnabled);
+    }
 }
 
-void VmaRecorder::RecordFreeMemoryPages(uint32_t frameIndex,
-    uint64_t allocationCount,
-    const VmaAllocation* pAllocations)
+void VmaRecorder::PrintConfiguration(
+    const VkPhysicalDeviceProperties& devProps,
+    const VkPhysicalDeviceMemoryProperties& memProps,
+    bool dedicatedAllocationExtensionEnabled,
+    bool bindMemory2ExtensionEnabled)
 {
-    CallParams callParams;
-    GetBasicParams(callParams);
+    Print("Config,Begin\n");
 
-    VmaMutexLock lock(m_FileMutex, m_UseMutex);
-    fprintf(m_File, "%u,%.3f,%u,vmaFreeMemoryPages,", callParams.threadId, callParams.time, frameIndex);
-    PrintPointerList(allocationCount, pAllocations);
-    fprintf(m_File, "\n");
-    Flush();
+    Print("PhysicalDevice,apiVersion,%u\n", devProps.apiVersion);
+    Print("PhysicalDevice,driverVersion,%u\n", devProps.driverVersion);
+    Print("PhysicalDevice,vendorID,%u\n", devProps.vendorID);
+    Print("PhysicalDevice,deviceID,%u\n", devProps.deviceID);
+    Print("PhysicalDevice,deviceType,%u\n", devProps.deviceType);
+    Print("PhysicalDevice,deviceName,%s\n", devProps.deviceName);
+
+    Print("PhysicalDeviceLimits,maxMemoryAllocationCount,%u\n", devProps.limits.maxMemoryAllocationCount);
+    Print("PhysicalDeviceLimits,bufferImageGranularity,%llu\n", (unsigned long long)devProps.limits.bufferImageGranularity);
+    Print("PhysicalDeviceLimits,nonCoherentAtomSize,%llu\n", (unsigned long long)devProps.limits.nonCoherentAtomSize);
+
+    Print("PhysicalDeviceMemory,HeapCount,%u\n", memProps.memoryHeapCount);
+    for(uint32_t i = 0; i < memProps.memoryHeapCount; ++i)
+    {
+        Print("PhysicalDeviceMemory,Heap,%u,size,%llu\n", i, (unsigned long long)memProps.memoryHeaps[i].size);
+        Print("PhysicalDeviceMemory,Heap,%u,flags,%u\n", i, memProps.memoryHeaps[i].flags);
+    }
+    Print("PhysicalDeviceMemory,TypeCount,%u\n", memProps.memoryTypeCount);
+    for(uint32_t i = 0; i < memProps.memoryTypeCount; ++i)
+    {
+        Print("PhysicalDeviceMemory,Type,%u,heapIndex,%u\n", i, memProps.memoryTypes[i].heapIndex);
+        Print("PhysicalDeviceMemory,Type,%u,propertyFlags,%u\n", i, memProps.memoryTypes[i].propertyFlags);
+    }
+
+    Print("Extension,VK_KHR_dedicated_allocation,%u\n", dedicatedAllocationExtensionEnabled ? 1 : 0);
+    Print("Extension,VK_KHR_bind_memory2,%u\n", bindMemory2ExtensionEnabled ? 1 : 0);
+
+    Print("Macro,VMA_DEBUG_ALWAYS_DEDICATED_MEMORY,%u\n", VMA_DEBUG_ALWAYS_DEDICATED_MEMORY ? 1 : 0);
+    Print("Macro,VMA_DEBUG_ALIGNMENT,%llu\n", (unsigned long long)VMA_DEBUG_ALIGNMENT);
+    Print("Macro,VMA_DEBUG_MARGIN,%llu\n", (unsigned long long)VMA_DEBUG_MARGIN);
+    Print("Macro,VMA_DEBUG_INITIALIZE_ALLOCATIONS,%u\n", VMA_DEBUG_INITIALIZE_ALLOCATIONS ? 1 : 0);
+    Print("Macro,VMA_DEBUG_DETECT_CORRUPTION,%u\n", VMA_DEBUG_DETECT_CORRUPTION ? 1 : 0);
+    Print("Macro,VMA_DEBUG_GLOBAL_MUTEX,%u\n", VMA_DEBUG_GLOBAL_MUTEX ? 1 : 0);
+    Print("Macro,VMA_DEBUG_MIN_BUFFER_IMAGE_GRANULARITY,%llu\n", (unsigned long long)VMA_DEBUG_MIN_BUFFER_IMAGE_GRANULARITY);
+    Print("Macro,VMA_SMALL_HEAP_MAX_SIZE,%llu\n", (unsigned long long)VMA_SMALL_HEAP_MAX_SIZE);
+    Print("Macro,VMA_DEFAULT_LARGE_HEAP_BLOCK_SIZE,%llu\n", (unsigned long long)VMA_DEFAULT_LARGE_HEAP_BLOCK_SIZE);
+
+    Print("Config,End\n");
 }
 
-void VmaRecorder::RecordSetAllocationUserData(uint32_t frameIndex,
-    VmaAllocation allocation,
-    const void* pUserData)
+void VmaRecorder::InitCounter()
 {
-    CallParams callParams;
-    GetBasicParams(callParams);
+#if defined(_WIN32)
+    QueryPerformanceFrequency((LARGE_INTEGER*)&m_Freq);
+#else
+    m_Freq = 1000000000;
+#if VMA_RECORDING_USE_TSC
+    // Time stamp counter can be used only if it ticks at constant rate in all power states.
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if(__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) && (edx & (1u << 8)) != 0)
+    {
+        // Calibrate it against steady clock, with both clock reads bracketed by counter reads.
+        const std::chrono::steady_clock::time_point beginTime = std::chrono::steady_clock::now();
+        const uint64_t beginTsc = __rdtsc();
+        std::chrono::steady_clock::time_point endTime;
+        uint64_t endTsc;
+        do
+        {
+            endTsc = __rdtsc();
+            endTime = std::chrono::steady_clock::now();
+        } while(endTime - beginTime < std::chrono::milliseconds(VMA_RECORDING_TSC_CALIBRATION_MILLISECONDS));
+        const double nanoseconds = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(endTime - beginTime).count();
+        if(endTsc > beginTsc && nanoseconds > 0.0)
+        {
+            m_Freq = (int64_t)((double)(endTsc - beginTsc) * 1e9 / nanoseconds);
+            m_UseTsc = true;
+        }
+    }
+#endif
+#endif
+    m_StartCounter = GetCounter();
+}
 
-    VmaMutexLock lock(m_FileMutex, m_UseMutex);
-    UserDataString userDataStr(
-        allocation->IsUserDataString() ? VMA_ALLOCATION_CREATE_USER_DATA_COPY_STRING_BIT : 0,
-        pUserData);
-    fprintf(m_File, "%u,%.3f,%u,vmaSetAllocationUserData,%p,%s\n", callParams.threadId, callParams.time, frameIndex,
-        allocation,
-        userDataStr.GetString());
+int64_t VmaRecorder::GetCounter() const
+{
+#if defined(_WIN32)
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return counter.QuadPart;
+#else
+#if VMA_RECORDING_USE_TSC
+    if(m_UseTsc)
+    {
+        return (int64_t)__rdtsc();
+    }
+#endif
+    return (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+uint32_t VmaRecorder::GetThreadId()
+{
+#if defined(_WIN32)
+    return GetCurrentThreadId();
+#elif defined(__linux__)
+    // gettid is a system call, so its result is cached per thread.
+    static thread_local uint32_t threadId = (uint32_t)syscall(SYS_gettid);
+    return threadId;
+#else
+    static thread_local uint32_t threadId = (uint32_t)std::hash<std::thread::id>()(std::this_thread::get_id());
+    return threadId;
+#endif
+}
+
+void VmaRecorder::GetBasicParams(CallParams& outParams)
+{
+    // After the first call of the thread, the buffer comes from its thread_local cache, together with its ID.
+    outParams.pThreadBuffer = &GetThreadBuffer();
+    outParams.threadId = outParams.pThreadBuffer->m_RecordedThreadId;
+    outParams.counter = GetCounter();
+    outParams.time = (double)(outParams.counter - m_StartCounter) / (double)m_Freq;
+}
+
+void VmaRecorder::EndCall(const CallParams& params)
+{
     Flush();
+    params.pThreadBuffer->AddRecordedCall(GetCounter() - params.counter);
+}
+
+bool VmaRecorder::ShouldRecordOptionalCall(VmaRecordOptionalFunctionFlagBits function, VmaAllocation allocation)
+{
+    if(m_DisabledFunctions == 0 && m_OptionalCallSamplingPeriod == 1)
+    {
+        return true;
+    }
+    // These functions update last use frame index, which decides whether allocation becomes lost.
+    if((function == VMA_RECORD_OPTIONAL_FUNCTION_TOUCH_ALLOCATION_BIT ||
+        function == VMA_RECORD_OPTIONAL_FUNCTION_GET_ALLOCATION_INFO_BIT) &&
+        allocation->CanBecomeLost())
+    {
+        return true;
+    }
+
+    ThreadBuffer& buf = GetThreadBuffer();
+    if((m_DisabledFunctions & function) == 0)
+    {
+        uint32_t& counter = buf.m_OptionalCallCounters[VmaBitScanLSB((uint32_t)function)];
+        const bool record = counter == 0;
+        if(++counter == m_OptionalCallSamplingPeriod)
+        {
+            counter = 0;
+        }
+        if(record)
+        {
+            return true;
+        }
+    }
+    ThreadBuffer::Increase(buf.m_SkippedCallCount, 1);
+    return false;
+}
+
+void VmaRecorder::GetStats(VmaRecordingStats& outStats)
+{
+    memset(&outStats, 0, sizeof(outStats));
+    uint64_t ticks = 0;
+    {
+        VmaMutexLock lock(m_ThreadBuffersMutex, true);
+        outStats.recordedCallCount = m_FreedRecordedCallCount;
+        outStats.skippedCallCount = m_FreedSkippedCallCount;
+        ticks = m_FreedRecordingTicks;
+        for(size_t i = 0, count = m_ThreadBuffers.size(); i < count; ++i)
+        {
+            const ThreadBuffer& buf = *m_ThreadBuffers[i];
+            outStats.recordedCallCount += buf.m_RecordedCallCount.load(std::memory_order_relaxed);
+            outStats.skippedCallCount += buf.m_SkippedCallCount.load(std::memory_order_relaxed);
+            ticks += buf.m_RecordingTicks.load(std::memory_order_relaxed);
+        }
+    }
+    outStats.recordingTimeNanoseconds = (uint64_t)((double)ticks * 1e9 / (double)m_Freq);
+    outStats.bytesRecorded = m_BytesRecorded.load(std::memory_order_relaxed);
+    outStats.bytesWritten = (m_Flags & VMA_RECORD_COMPRESS_BIT) != 0 ?
+        m_BytesWritten.load(std::memory_order_relaxed) : outStats.bytesRecorded;
+}
+
+void VmaRecorder::PrintPointerList(uint64_t count, const VmaAllocation* pItems)
+{
+    if(count)
+    {
+        Print("%016llX", PtrToUint64(pItems[0]));
+        for(uint64_t i = 1; i < count; ++i)
+        {
+            Print(" %016llX", PtrToUint64(pItems[i]));
+        }
+    }
+}
+
+void VmaRecorder::Print(const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int len;
+#if VMA_RECORDING_COMPRESSION
+    if(m_pCompressor != VMA_NULL)
+    {
+        len = m_pCompressor->PrintV(format, args);
+    }
+    else
+#endif
+    {
+        len = vfprintf(m_File, format, args);
+    }
+    va_end(args);
+    if(len > 0)
+    {
+        m_BytesRecorded.fetch_add((uint64_t)len, std::memory_order_relaxed);
+    }
+}
+
+void VmaRecorder::Write(const void* pData, size_t size)
+{
+    m_BytesRecorded.fetch_add(size, std::memory_order_relaxed);
+#if VMA_RECORDING_COMPRESSION
+    if(m_pCompressor != VMA_NULL)
+    {
+        m_pCompressor->Write(pData, size);
+        return;
+    }
+#endif
+    fwrite(pData, 1, size, m_File);
 }
 
-void VmaRecorder::RecordCreateLostAllocation(uint32_t frameIndex,
-    VmaAllocation allocation)
+void VmaRecorder::Flush()
 {
-    CallParams callParams;
-    GetBasicParams(callParams);
-
-    VmaMutexLock lock(m_FileMutex, m_UseMutex);
-    fprintf(m_File, "%u,%.3f,%u,vmaCreateLostAllocation,%p\n", callParams.threadId, callParams.time, frameIndex,
-        allocation);
-    Flush();
+    // With compression, the file is flushed by the compressing thread.
+    if((m_Flags & VMA_RECORD_FLUSH_AFTER_CALL_BIT) != 0 && m_pCompressor == VMA_NULL)
+    {
+        fflush(m_File);
+    }
 }
 
-void VmaRecorder::RecordMapMemory(uint32_t frameIndex,
-    VmaAllocation allocation)
+VmaRecorder::LiveRecorderList& VmaRecorder::GetLiveRecorders()
 {
-    CallParams callParams;
-    GetBasicParams(callParams);
-
-    VmaMutexLock lock(m_FileMutex, m_UseMutex);
-    fprintf(m_File, "%u,%.3f,%u,vmaMapMemory,%p\n", callParams.threadId, callParams.time, frameIndex,
-        allocation);
-    Flush();
+    static LiveRecorderList liveRecorders;
+    return liveRecorders;
 }
 
-void VmaRecorder::RecordUnmapMemory(uint32_t frameIndex,
-    VmaAllocation allocation)
+bool VmaRecorder::IsLive(const VmaRecorder* pRecorder, uint64_t id)
 {
-    CallParams callParams;
-    GetBasicParams(callParams);
-
-    VmaMutexLock lock(m_FileMutex, m_UseMutex);
-    fprintf(m_File, "%u,%.3f,%u,vmaUnmapMemory,%p\n", callParams.threadId, callParams.time, frameIndex,
-        allocation);
-    Flush();
+    for(const VmaRecorder* pLive = GetLiveRecorders().pFirst; pLive != VMA_NULL; pLive = pLive->m_pNextLive)
+    {
+        if(pLive == pRecorder)
+        {
+            return pLive->m_Id == id;
+        }
+    }
+    return false;
 }
 
-void VmaRecorder::RecordFlushAllocation(uint32_t frameIndex,
-    VmaAllocation allocation, VkDeviceSize offset, VkDeviceSize size)
+VmaRecorder::ThreadBuffer& VmaRecorder::GetThreadBuffer()
 {
-    CallParams callParams;
-    GetBasicParams(callParams);
+    static thread_local ThreadState threadState;
+    ThreadBuffer* pBuffer = threadState.Find(m_Id);
+    if(pBuffer != VMA_NULL)
+    {
+        return *pBuffer;
+    }
 
-    VmaMutexLock lock(m_FileMutex, m_UseMutex);
-    fprintf(m_File, "%u,%.3f,%u,vmaFlushAllocation,%p,%llu,%llu\n", callParams.threadId, callParams.time, frameIndex,
-        allocation,
-        offset,
-        size);
-    Flush();
+    // Slow path: first call from this thread to this recorder.
+    {
+        VmaMutexLock lock(m_ThreadBuffersMutex, true);
+        pBuffer = vma_new(m_pAllocationCallbacks, ThreadBuffer)(
+            m_pAllocationCallbacks, GetThreadId(), m_NextThreadIndex++,
+            m_FlightRecorder ? m_FlightRecorderBufferSize :
+            m_BinaryFormat ? VMA_RECORDING_BINARY_THREAD_BUFFER_SIZE : 0);
+        m_ThreadBuffers.push_back(pBuffer);
+    }
+    threadState.Add(this, pBuffer);
+    return *pBuffer;
 }
 
-void VmaRecorder::RecordInvalidateAllocation(uint32_t frameIndex,
-    VmaAllocation allocation, VkDeviceSize offset, VkDeviceSize size)
+void VmaRecorder::RetireThreadBuffer(ThreadBuffer& buffer)
 {
-    CallParams callParams;
-    GetBasicParams(callParams);
+    VmaMutexLock buffersLock(m_ThreadBuffersMutex, true);
+    if(!m_FlightRecorder)
+    {
+        if(m_BinaryFormat &&
+            buffer.m_WritePos.load(std::memory_order_relaxed) != buffer.m_ReadPos.load(std::memory_order_relaxed))
+        {
+            VmaMutexLock fileLock(m_FileMutex, true);
+            WriteThreadBuffer(buffer);
+        }
+        FreeThreadBuffer(buffer);
+        return;
+    }
 
-    VmaMutexLock lock(m_FileMutex, m_UseMutex);
-    fprintf(m_File, "%u,%.3f,%u,vmaInvalidateAllocation,%p,%llu,%llu\n", callParams.threadId, callParams.time, frameIndex,
-        allocation,
-        offset,
-        size);
-    Flush();
+    // Calls in the ring buffer may still be needed by Dump(), so it's kept, up to a limit.
+    buffer.m_Exited = true;
+    if(++m_ExitedThreadBufferCount <= VMA_RECORDING_FLIGHT_RECORDER_EXITED_THREAD_BUFFER_COUNT)
+    {
+        return;
+    }
+    ThreadBuffer* pOldestBuffer = VMA_NULL;
+    uint64_t oldestCallIndex = UINT64_MAX;
+    for(size_t i = 0, count = m_ThreadBuffers.size(); i < count; ++i)
+    {
+        if(m_ThreadBuffers[i]->m_Exited)
+        {
+            const uint64_t callIndex = m_ThreadBuffers[i]->GetNewestCallIndex();
+            if(pOldestBuffer == VMA_NULL || callIndex < oldestCallIndex)
+            {
+                pOldestBuffer = m_ThreadBuffers[i];
+                oldestCallIndex = callIndex;
+            }
+        }
+    }
+    VMA_ASSERT(pOldestBuffer != VMA_NULL);
+    if(pOldestBuffer->m_WritePos.load(std::memory_order_relaxed) != pOldestBuffer->m_ReadPos.load(std::memory_order_relaxed))
+    {
+        m_FirstDumpedCallIndex = VMA_MAX(m_FirstDumpedCallIndex, oldestCallIndex + 1);
+    }
+    --m_ExitedThreadBufferCount;
+    FreeThreadBuffer(*pOldestBuffer);
 }
 
-void VmaRecorder::RecordCreateBuffer(uint32_t frameIndex,
-    const VkBufferCreateInfo& bufCreateInfo,
-    const VmaAllocationCreateInfo& allocCreateInfo,
-    VmaAllocation allocation)
+void VmaRecorder::FreeThreadBuffer(ThreadBuffer& buffer)
 {
-    CallParams callParams;
-    GetBasicParams(callParams);
-
-    VmaMutexLock lock(m_FileMutex, m_UseMutex);
-    UserDataString userDataStr(allocCreateInfo.flags, allocCreateInfo.pUserData);
-    fprintf(m_File, "%u,%.3f,%u,vmaCreateBuffer,%u,%llu,%u,%u,%u,%u,%u,%u,%u,%p,%p,%s\n", callParams.threadId, callParams.time, frameIndex,
-        bufCreateInfo.flags,
-        bufCreateInfo.size,
-        bufCreateInfo.usage,
-        bufCreateInfo.sharingMode,
-        allocCreateInfo.flags,
-        allocCreateInfo.usage,
-        allocCreateInfo.requiredFlags,
-        allocCreateInfo.preferredFlags,
-        allocCreateInfo.memoryTypeBits,
-        allocCreateInfo.pool,
-        allocation,
-        userDataStr.GetString());
-    Flush();
+    m_FreedRecordedCallCount += buffer.m_RecordedCallCount.load(std::memory_order_relaxed);
+    m_FreedSkippedCallCount += buffer.m_SkippedCallCount.load(std::memory_order_relaxed);
+    m_FreedRecordingTicks += buffer.m_RecordingTicks.load(std::memory_order_relaxed);
+    for(size_t i = 0, count = m_ThreadBuffers.size(); i < count; ++i)
+    {
+        if(m_ThreadBuffers[i] == &buffer)
+        {
+            VmaVectorRemove(m_ThreadBuffers, i);
+            break;
+        }
+    }
+    vma_delete(m_pAllocationCallbacks, &buffer);
 }
 
-void VmaRecorder::RecordCreateImage(uint32_t frameIndex,
-    const VkImageCreateInfo& imageCreateInfo,
-    const VmaAllocationCreateInfo& allocCreateInfo,
-    VmaAllocation allocation)
+void VmaRecorder::WriterThreadMain()
 {
-    CallParams callParams;
-    GetBasicParams(callParams);
-
-    VmaMutexLock lock(m_FileMutex, m_UseMutex);
-    UserDataString userDataStr(allocCreateInfo.flags, allocCreateInfo.pUserData);
-    fprintf(m_File, "%u,%.3f,%u,vmaCreateImage,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%p,%p,%s\n", callParams.threadId, callParams.time, frameIndex,
-        imageCreateInfo.flags,
-        imageCreateInfo.imageType,
-        imageCreateInfo.format,
-        imageCreateInfo.extent.width,
-        imageCreateInfo.extent.height,
-        imageCreateInfo.extent.depth,
-        imageCreateInfo.mipLevels,
-        imageCreateInfo.arrayLayers,
-        imageCreateInfo.samples,
-        imageCreateInfo.tiling,
-        imageCreateInfo.usage,
-        imageCreateInfo.sharingMode,
-        imageCreateInfo.initialLayout,
-        allocCreateInfo.flags,
-        allocCreateInfo.usage,
-        allocCreateInfo.requiredFlags,
-        allocCreateInfo.preferredFlags,
-        allocCreateInfo.memoryTypeBits,
-        allocCreateInfo.pool,
-        allocation,
-        userDataStr.GetString());
-    Flush();
+    std::unique_lock<std::mutex> lock(m_WriterMutex);
+    while(!m_WriterStop)
+    {
+        m_WriterCond.wait_for(lock, std::chrono::milliseconds(VMA_RECORDING_BINARY_WRITE_INTERVAL_MILLISECONDS));
+        lock.unlock();
+        WriteThreadBuffers();
+        lock.lock();
+    }
 }
 
-void VmaRecorder::RecordDestroyBuffer(uint32_t frameIndex,
-    VmaAllocation allocation)
+void VmaRecorder::WriteThreadBuffers()
 {
-    CallParams callParams;
-    GetBasicParams(callParams);
-
-    VmaMutexLock lock(m_FileMutex, m_UseMutex);
-    fprintf(m_File, "%u,%.3f,%u,vmaDestroyBuffer,%p\n", callParams.threadId, callParams.time, frameIndex,
-        allocation);
+    VmaMutexLock buffersLock(m_ThreadBuffersMutex, true);
+    VmaMutexLock fileLock(m_FileMutex, true);
+    for(size_t i = 0, count = m_ThreadBuffers.size(); i < count; ++i)
+    {
+        WriteThreadBuffer(*m_ThreadBuffers[i]);
+    }
     Flush();
 }
 
-void VmaRecorder::RecordDestroyImage(uint32_t frameIndex,
-    VmaAllocation allocation)
+void VmaRecorder::WriteThreadBuffer(ThreadBuffer& buffer)
 {
-    CallParams callParams;
-    GetBasicParams(callParams);
+    if(!buffer.m_Announced)
+    {
+        WriteThreadBlock(buffer);
+    }
 
-    VmaMutexLock lock(m_FileMutex, m_UseMutex);
-    fprintf(m_File, "%u,%.3f,%u,vmaDestroyImage,%p\n", callParams.threadId, callParams.time, frameIndex,
-        allocation);
-    Flush();
+    const size_t readPos = buffer.m_ReadPos.load(std::memory_order_relaxed);
+    const size_t writePos = buffer.m_WritePos.load(std::memory_order_acquire);
+    if(writePos != readPos)
+    {
+        const size_t size = writePos - readPos;
+        const size_t offset = readPos % buffer.m_Capacity;
+        const size_t size1 = VMA_MIN(size, buffer.m_Capacity - offset);
+        WriteCallsBlock(buffer, buffer.m_pData + offset, size1, buffer.m_pData, size - size1);
+        buffer.m_ReadPos.store(writePos, std::memory_order_release);
+    }
 }
 
-void VmaRecorder::RecordTouchAllocation(uint32_t frameIndex,
-    VmaAllocation allocation)
+void VmaRecorder::WriteCallsBlock(const ThreadBuffer& buffer, const void* pData1, size_t size1, const void* pData2, size_t size2)
 {
-    CallParams callParams;
-    GetBasicParams(callParams);
-
-    VmaMutexLock lock(m_FileMutex, m_UseMutex);
-    fprintf(m_File, "%u,%.3f,%u,vmaTouchAllocation,%p\n", callParams.threadId, callParams.time, frameIndex,
-        allocation);
-    Flush();
+    // Thread must be announced before its first block of calls.
+    VMA_ASSERT(buffer.m_Announced);
+    uint8_t block[1 + 10 + 10];
+    size_t blockSize = 0;
+    block[blockSize++] = VMA_RECORD_BLOCK_TYPE_CALLS;
+    blockSize += VmaWriteVarUint(block + blockSize, buffer.m_Index);
+    blockSize += VmaWriteVarUint(block + blockSize, size1 + size2);
+    Write(block, blockSize);
+    Write(pData1, size1);
+    if(size2 > 0)
+    {
+        Write(pData2, size2);
+    }
 }
 
-void VmaRecorder::RecordGetAllocationInfo(uint32_t frameIndex,
-    VmaAllocation allocation)
+void VmaRecorder::WriteThreadBlock(ThreadBuffer& buffer)
 {
-    CallParams callParams;
-    GetBasicParams(callParams);
+    uint8_t block[1 + 10 + 10];
+    size_t blockSize = 0;
+    block[blockSize++] = VMA_RECORD_BLOCK_TYPE_THREAD;
+    blockSize += VmaWriteVarUint(block + blockSize, buffer.m_Index);
+    blockSize += VmaWriteVarUint(block + blockSize, buffer.m_RecordedThreadId);
+    Write(block, blockSize);
+    buffer.m_Announced = true;
+}
 
-    VmaMutexLock lock(m_FileMutex, m_UseMutex);
-    fprintf(m_File, "%u,%.3f,%u,vmaGetAllocationInfo,%p\n", callParams.threadId, callParams.time, frameIndex,
-        allocation);
-    Flush();
+void VmaRecorder::WriteBinaryHeader(uint32_t flags)
+{
+    struct BinaryHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t flags;
+        uint64_t counterFrequency;
+    } header = { { 'V', 'M', 'A', 'R', 'E', 'C', 'B', 'N' }, 1, flags, (uint64_t)m_Freq };
+    Write(&header, sizeof(header));
 }
 
-void VmaRecorder::RecordMakePoolAllocationsLost(uint32_t frameIndex,
-    VmaPool pool)
+void VmaRecorder::DescribePool(uint32_t frameIndex, VmaPool pool, uint64_t destroyCallIndex)
 {
-    CallParams callParams;
-    GetBasicParams(callParams);
+    if(pool == VK_NULL_HANDLE)
+    {
+        return;
+    }
+    VmaPoolCreateInfo createInfo;
+    pool->m_BlockVector.GetPoolCreateInfo(createInfo);
 
-    VmaMutexLock lock(m_FileMutex, m_UseMutex);
-    fprintf(m_File, "%u,%.3f,%u,vmaMakePoolAllocationsLost,%p\n", callParams.threadId, callParams.time, frameIndex,
-        pool);
-    Flush();
+    BinaryCall call(*this, VMA_RECORD_OP_CREATE_POOL, frameIndex, destroyCallIndex, 0);
+    call.Uint(createInfo.memoryTypeIndex);
+    call.Uint(createInfo.flags);
+    call.Uint(createInfo.blockSize);
+    call.Uint(createInfo.minBlockCount);
+    call.Uint(createInfo.maxBlockCount);
+    call.Uint(createInfo.frameInUseCount);
+    call.Pool(pool);
+    EndDescription(call, destroyCallIndex);
 }
 
-void VmaRecorder::RecordDefragmentationBegin(uint32_t frameIndex,
-    const VmaDefragmentationInfo2& info,
-    VmaDefragmentationContext ctx)
+void VmaRecorder::DescribeAllocation(uint32_t frameIndex, VmaAllocation allocation, uint64_t destroyCallIndex)
 {
-    CallParams callParams;
-    GetBasicParams(callParams);
+    if(allocation == VK_NULL_HANDLE)
+    {
+        return;
+    }
+    if(allocation->GetLastUseFrameIndex() == VMA_FRAME_INDEX_LOST)
+    {
+        BinaryCall call(*this, VMA_RECORD_OP_CREATE_LOST_ALLOCATION, frameIndex, destroyCallIndex, 0);
+        call.Allocation(allocation);
+        EndDescription(call, destroyCallIndex);
+        return;
+    }
 
-    VmaMutexLock lock(m_FileMutex, m_UseMutex);
-    fprintf(m_File, "%u,%.3f,%u,vmaDefragmentationBegin,%u,", callParams.threadId, callParams.time, frameIndex,
-        info.flags);
-    PrintPointerList(info.allocationCount, info.pAllocations);
-    fprintf(m_File, ",");
-    PrintPointerList(info.poolCount, info.pPools);
-    fprintf(m_File, ",%llu,%u,%llu,%u,%p,%p\n",
-        info.maxCpuBytesToMove,
-        info.maxCpuAllocationsToMove,
-        info.maxGpuBytesToMove,
-        info.maxGpuAllocationsToMove,
-        info.commandBuffer,
-        ctx);
-    Flush();
+    // Parameters of the original call are not known, so it's described as
+    // vmaAllocateMemory() that can only result in the same memory type.
+    const uint32_t memoryTypeBits = 1u << allocation->GetMemoryTypeIndex();
+    VmaAllocationCreateFlags flags = 0;
+    VmaPool pool = VK_NULL_HANDLE;
+    if(allocation->GetType() == VmaAllocation_T::ALLOCATION_TYPE_DEDICATED)
+    {
+        flags |= VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+    }
+    else
+    {
+        pool = allocation->GetBlock()->GetParentPool();
+    }
+    if(allocation->IsPersistentMap())
+    {
+        flags |= VMA_ALLOCATION_CREATE_MAPPED_BIT;
+    }
+    if(allocation->CanBecomeLost())
+    {
+        flags |= VMA_ALLOCATION_CREATE_CAN_BECOME_LOST_BIT;
+    }
+    if(allocation->IsUserDataString())
+    {
+        flags |= VMA_ALLOCATION_CREATE_USER_DATA_COPY_STRING_BIT;
+    }
+
+    BinaryCall call(*this, VMA_RECORD_OP_ALLOCATE_MEMORY, frameIndex, destroyCallIndex, 0);
+    call.Uint(allocation->GetSize());
+    call.Uint(allocation->GetAlignment());
+    call.Uint(memoryTypeBits);
+    call.Uint(flags);
+    call.Uint(VMA_MEMORY_USAGE_UNKNOWN);
+    call.Uint(0); // requiredFlags
+    call.Uint(0); // preferredFlags
+    call.Uint(memoryTypeBits);
+    call.Pool(pool);
+    call.Allocation(allocation);
+    call.UserData(allocation->IsUserDataString(), allocation->GetUserData());
+    EndDescription(call, destroyCallIndex);
 }
 
-void VmaRecorder::RecordDefragmentationEnd(uint32_t frameIndex,
-    VmaDefragmentationContext ctx)
+void VmaRecorder::DescribeHandlelessAllocation(VmaPool pool, uint32_t memoryTypeIndex, const VmaSuballocation& suballoc, uint64_t destroyCallIndex)
 {
-    CallParams callParams;
-    GetBasicParams(callParams);
+    // Original alignment is not known, so during replay it may be placed at a different offset.
+    const uint32_t memoryTypeBits = 1u << memoryTypeIndex;
+    BinaryCall call(*this, VMA_RECORD_OP_ALLOCATE_MEMORY_WITHOUT_HANDLE, suballoc.frameIndex, destroyCallIndex, 0);
+    call.Uint(suballoc.size);
+    call.Uint(1); // alignment
+    call.Uint(memoryTypeBits);
+    call.Uint(0); // flags
+    call.Uint(VMA_MEMORY_USAGE_UNKNOWN);
+    call.Uint(0); // requiredFlags
+    call.Uint(0); // preferredFlags
+    call.Uint(memoryTypeBits);
+    call.Pool(pool);
+    call.Uint(1); // succeeded
+    EndDescription(call, destroyCallIndex);
+}
 
-    VmaMutexLock lock(m_FileMutex, m_UseMutex);
-    fprintf(m_File, "%u,%.3f,%u,vmaDefragmentationEnd,%p\n", callParams.threadId, callParams.time, frameIndex,
-        ctx);
-    Flush();
+void VmaRecorder::EndDescription(BinaryCall& call, uint64_t destroyCallIndex)
+{
+    if(destroyCallIndex == UINT64_MAX)
+    {
+        call.EndLiveObject();
+    }
+    else
+    {
+        call.EndFreedObject();
+    }
 }
 
-VmaRecorder::UserDataString::UserDataString(VmaAllocationCreateFlags allocFlags, const void* pUserData)
+VkResult VmaRecorder::Dump(const char* pFilePath)
 {
-    if(pUserData != VMA_NULL)
+    VmaMutexLock dumpLock(m_DumpMutex, true);
+
+    m_DumpState.clear();
+    m_hAllocator->RecordLiveObjects();
+
+    VmaMutexLock buffersLock(m_ThreadBuffersMutex, true);
+    const size_t bufferCount = m_ThreadBuffers.size();
+
+    /*
+    Once m_Dumping is set, every thread has either finished writing to its buffer,
+    or it will see the flag in BeginRingWrite() and wait. Both sides use sequentially
+    consistent operations on m_Dumping and m_Writing, so they can't miss each other.
+    */
+    m_Dumping.store(true);
+    /*
+    Calls made before the oldest call remaining in any overwritten buffer are dropped,
+    because calls made by that thread in the same time are missing. Description of
+    a freed object is written after its call, so if it's the oldest, the call is missing too.
+    */
+    uint64_t firstCallIndex = m_FirstDumpedCallIndex;
+    for(size_t i = 0; i < bufferCount; ++i)
     {
-        if((allocFlags & VMA_ALLOCATION_CREATE_USER_DATA_COPY_STRING_BIT) != 0)
+        ThreadBuffer& buf = *m_ThreadBuffers[i];
+        while(buf.m_Writing.load())
         {
-            m_Str = (const char*)pUserData;
+            std::this_thread::yield();
         }
-        else
+        const size_t readPos = buf.m_ReadPos.load(std::memory_order_relaxed);
+        const size_t size = buf.m_WritePos.load(std::memory_order_relaxed) - readPos;
+        if(buf.m_Overwritten && size > 0)
         {
-            sprintf_s(m_PtrStr, "%p", pUserData);
-            m_Str = m_PtrStr;
+            size_t pos = readPos;
+            buf.LoadVarUint(pos); // Size of the call.
+            const bool freedObject = (buf.Load(pos++) & VMA_RECORD_OP_FREED_OBJECT_BIT) != 0;
+            const uint64_t oldestCallIndex = buf.LoadVarUint(pos);
+            firstCallIndex = VMA_MAX(firstCallIndex, freedObject ? oldestCallIndex + 1 : oldestCallIndex);
         }
+        buf.m_DumpedCalls.resize(size);
+        const size_t offset = readPos % buf.m_Capacity;
+        const size_t size1 = VMA_MIN(size, buf.m_Capacity - offset);
+        memcpy(buf.m_DumpedCalls.data(), buf.m_pData + offset, size1);
+        memcpy(buf.m_DumpedCalls.data() + size1, buf.m_pData, size - size1);
     }
-    else
+    m_Dumping.store(false);
+
+    /*
+    Remove sizes of the calls, which are not stored in the file, and calls before firstCallIndex.
+    Descriptions of freed objects are moved to the state, after objects that still exist.
+    */
+    for(size_t i = 0; i < bufferCount; ++i)
     {
-        m_Str = "";
+        VmaVector< uint8_t, VmaStlAllocator<uint8_t> >& calls = m_ThreadBuffers[i]->m_DumpedCalls;
+        const uint8_t* src = calls.data();
+        const uint8_t* const end = src + calls.size();
+        uint8_t* dst = calls.data();
+        while(src < end)
+        {
+            const size_t callSize = (size_t)VmaReadVarUint(src);
+            const uint8_t* pCallIndex = src + 1;
+            if(VmaReadVarUint(pCallIndex) >= firstCallIndex)
+            {
+                if((src[0] & VMA_RECORD_OP_FREED_OBJECT_BIT) != 0)
+                {
+                    const size_t stateSize = m_DumpState.size();
+                    m_DumpState.resize(stateSize + callSize);
+                    memcpy(m_DumpState.data() + stateSize, src, callSize);
+                    m_DumpState[stateSize] &= (uint8_t)~VMA_RECORD_OP_FREED_OBJECT_BIT;
+                }
+                else
+                {
+                    memmove(dst, src, callSize);
+                    dst += callSize;
+                }
+            }
+            src += callSize;
+        }
+        calls.resize((size_t)(dst - calls.data()));
     }
-}
 
-void VmaRecorder::WriteConfiguration(
-    const VkPhysicalDeviceProperties& devProps,
-    const VkPhysicalDeviceMemoryProperties& memProps,
-    bool dedicatedAllocationExtensionEnabled,
-    bool bindMemory2ExtensionEnabled)
-{
-    fprintf(m_File, "Config,Begin\n");
+    VmaMutexLock fileLock(m_FileMutex, true);
+    const VkResult res = WriteDump(pFilePath != VMA_NULL ? pFilePath : m_pFilePath);
 
-    fprintf(m_File, "PhysicalDevice,apiVersion,%u\n", devProps.apiVersion);
-    fprintf(m_File, "PhysicalDevice,driverVersion,%u\n", devProps.driverVersion);
-    fprintf(m_File, "PhysicalDevice,vendorID,%u\n", devProps.vendorID);
-    fprintf(m_File, "PhysicalDevice,deviceID,%u\n", devProps.deviceID);
-    fprintf(m_File, "PhysicalDevice,deviceType,%u\n", devProps.deviceType);
-    fprintf(m_File, "PhysicalDevice,deviceName,%s\n", devProps.deviceName);
-
-    fprintf(m_File, "PhysicalDeviceLimits,maxMemoryAllocationCount,%u\n", devProps.limits.maxMemoryAllocationCount);
-    fprintf(m_File, "PhysicalDeviceLimits,bufferImageGranularity,%llu\n", devProps.limits.bufferImageGranularity);
-    fprintf(m_File, "PhysicalDeviceLimits,nonCoherentAtomSize,%llu\n", devProps.limits.nonCoherentAtomSize);
+    for(size_t i = 0; i < bufferCount; ++i)
+    {
+        m_ThreadBuffers[i]->m_DumpedCalls.clear(true);
+    }
+    m_DumpState.clear(true);
+    return res;
+}
 
-    fprintf(m_File, "PhysicalDeviceMemory,HeapCount,%u\n", memProps.memoryHeapCount);
-    for(uint32_t i = 0; i < memProps.memoryHeapCount; ++i)
+VkResult VmaRecorder::WriteDump(const char* pFilePath)
+{
+    VMA_ASSERT(m_File == VMA_NULL);
+#if defined(_WIN32)
+    errno_t err = fopen_s(&m_File, pFilePath, "wb");
+    if(err != 0)
+    {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+#else
+    m_File = fopen(pFilePath, "wb");
+    if(m_File == VMA_NULL)
     {
-        fprintf(m_File, "PhysicalDeviceMemory,Heap,%u,size,%llu\n", i, memProps.memoryHeaps[i].size);
-        fprintf(m_File, "PhysicalDeviceMemory,Heap,%u,flags,%u\n", i, memProps.memoryHeaps[i].flags);
+        return VK_ERROR_INITIALIZATION_FAILED;
     }
-    fprintf(m_File, "PhysicalDeviceMemory,TypeCount,%u\n", memProps.memoryTypeCount);
-    for(uint32_t i = 0; i < memProps.memoryTypeCount; ++i)
+#endif
+
+    VkResult res = VK_SUCCESS;
+#if VMA_RECORDING_COMPRESSION
+    if((m_Flags & VMA_RECORD_COMPRESS_BIT) != 0)
     {
-        fprintf(m_File, "PhysicalDeviceMemory,Type,%u,heapIndex,%u\n", i, memProps.memoryTypes[i].heapIndex);
-        fprintf(m_File, "PhysicalDeviceMemory,Type,%u,propertyFlags,%u\n", i, memProps.memoryTypes[i].propertyFlags);
+        m_pCompressor = vma_new(m_pAllocationCallbacks, Compressor)(m_pAllocationCallbacks, m_File, false, m_BytesWritten);
+        res = m_pCompressor->Init();
     }
+#endif
 
-    fprintf(m_File, "Extension,VK_KHR_dedicated_allocation,%u\n", dedicatedAllocationExtensionEnabled ? 1 : 0);
-    fprintf(m_File, "Extension,VK_KHR_bind_memory2,%u\n", bindMemory2ExtensionEnabled ? 1 : 0);
+    if(res == VK_SUCCESS)
+    {
+        WriteBinaryHeader(VMA_RECORD_HEADER_FLAG_INDEPENDENT_CALLS);
+        PrintConfiguration(
+            m_hAllocator->m_PhysicalDeviceProperties,
+            m_hAllocator->m_MemProps,
+            m_hAllocator->m_UseKhrDedicatedAllocation,
+            m_hAllocator->m_UseKhrBindMemory2);
+
+        uint8_t block[1 + 10];
+        size_t blockSize = 0;
+        block[blockSize++] = VMA_RECORD_BLOCK_TYPE_STATE;
+        blockSize += VmaWriteVarUint(block + blockSize, m_DumpState.size());
+        Write(block, blockSize);
+        if(!m_DumpState.empty())
+        {
+            Write(m_DumpState.data(), m_DumpState.size());
+        }
+
+        for(size_t i = 0, count = m_ThreadBuffers.size(); i < count; ++i)
+        {
+            ThreadBuffer& buf = *m_ThreadBuffers[i];
+            if(!buf.m_DumpedCalls.empty())
+            {
+                WriteThreadBlock(buf);
+                WriteCallsBlock(buf, buf.m_DumpedCalls.data(), buf.m_DumpedCalls.size(), VMA_NULL, 0);
+            }
+        }
 
-    fprintf(m_File, "Macro,VMA_DEBUG_ALWAYS_DEDICATED_MEMORY,%u\n", VMA_DEBUG_ALWAYS_DEDICATED_MEMORY ? 1 : 0);
-    fprintf(m_File, "Macro,VMA_DEBUG_ALIGNMENT,%llu\n", (VkDeviceSize)VMA_DEBUG_ALIGNMENT);
-    fprintf(m_File, "Macro,VMA_DEBUG_MARGIN,%llu\n", (VkDeviceSize)VMA_DEBUG_MARGIN);
-    fprintf(m_File, "Macro,VMA_DEBUG_INITIALIZE_ALLOCATIONS,%u\n", VMA_DEBUG_INITIALIZE_ALLOCATIONS ? 1 : 0);
-    fprintf(m_File, "Macro,VMA_DEBUG_DETECT_CORRUPTION,%u\n", VMA_DEBUG_DETECT_CORRUPTION ? 1 : 0);
-    fprintf(m_File, "Macro,VMA_DEBUG_GLOBAL_MUTEX,%u\n", VMA_DEBUG_GLOBAL_MUTEX ? 1 : 0);
-    fprintf(m_File, "Macro,VMA_DEBUG_MIN_BUFFER_IMAGE_GRANULARITY,%llu\n", (VkDeviceSize)VMA_DEBUG_MIN_BUFFER_IMAGE_GRANULARITY);
-    fprintf(m_File, "Macro,VMA_SMALL_HEAP_MAX_SIZE,%llu\n", (VkDeviceSize)VMA_SMALL_HEAP_MAX_SIZE);
-    fprintf(m_File, "Macro,VMA_DEFAULT_LARGE_HEAP_BLOCK_SIZE,%llu\n", (VkDeviceSize)VMA_DEFAULT_LARGE_HEAP_BLOCK_SIZE);
+        const uint8_t blockType = VMA_RECORD_BLOCK_TYPE_END;
+        Write(&blockType, 1);
+    }
 
-    fprintf(m_File, "Config,End\n");
+#if VMA_RECORDING_COMPRESSION
+    if(m_pCompressor != VMA_NULL)
+    {
+        vma_delete(m_pAllocationCallbacks, m_pCompressor);
+        m_pCompressor = VMA_NULL;
+    }
+#endif
+    fclose(m_File);
+    m_File = VMA_NULL;
+    return res;
 }
 
-void VmaRecorder::GetBasicParams(CallParams& outParams)
+void VmaRecorder::AllocationFailed()
 {
-    outParams.threadId = GetCurrentThreadId();
-
-    LARGE_INTEGER counter;
-    QueryPerformanceCounter(&counter);
-    outParams.time = (double)(counter.QuadPart - m_StartCounter) / (double)m_Freq;
+    if(m_FlightRecorder && !m_DumpedOnFailure.exchange(true))
+    {
+        Dump(VMA_NULL);
+    }
 }
 
-void VmaRecorder::PrintPointerList(uint64_t count, const VmaAllocation* pItems)
+void VmaRecorder::BeginRingWrite(ThreadBuffer& buffer)
 {
-    if(count)
+    for(;;)
     {
-        fprintf(m_File, "%p", pItems[0]);
-        for(uint64_t i = 1; i < count; ++i)
+        buffer.m_Writing.store(true);
+        if(!m_Dumping.load())
+        {
+            return;
+        }
+        // Let Dump() copy the buffer.
+        buffer.m_Writing.store(false);
+        while(m_Dumping.load(std::memory_order_relaxed))
         {
-            fprintf(m_File, " %p", pItems[i]);
+            std::this_thread::yield();
         }
     }
 }
 
-void VmaRecorder::Flush()
+void VmaRecorder::EndRingWrite(ThreadBuffer& buffer)
 {
-    if((m_Flags & VMA_RECORD_FLUSH_AFTER_CALL_BIT) != 0)
-    {
-        fflush(m_File);
-    }
+    buffer.m_Writing.store(false, std::memory_order_release);
 }
 
 #endif // #if VMA_RECORDING_ENABLED
@@ -14121,6 +21918,15 @@ void VmaAllocationObjectAllocator::Free(VmaAllocation hAlloc)
     m_Allocator.Free(hAlloc);
 }
 
+void VmaAllocationObjectAllocator::Free(size_t count, const VmaAllocation* pAllocations)
+{
+    VmaMutexLock mutexLock(m_Mutex);
+    for(size_t i = 0; i < count; ++i)
+    {
+        m_Allocator.Free(pAllocations[i]);
+    }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // VmaAllocator_T
 
@@ -14138,7 +21944,8 @@ VmaAllocator_T::VmaAllocator_T(const VmaAllocatorCreateInfo* pCreateInfo) :
     m_CurrentFrameIndex(0),
     m_GpuDefragmentationMemoryTypeBits(UINT32_MAX),
     m_Pools(VmaStlAllocator<VmaPool>(GetAllocationCallbacks())),
-    m_NextPoolId(0)
+    m_NextPoolId(0),
+    m_AutoDefragmentationPoolCount(0)
 #if VMA_RECORDING_ENABLED
     ,m_pRecorder(VMA_NULL)
 #endif
@@ -14227,7 +22034,8 @@ VmaAllocator_T::VmaAllocator_T(const VmaAllocatorCreateInfo* pCreateInfo) :
             pCreateInfo->frameInUseCount,
             false, // isCustomPool
             false, // explicitBlockSize
-            false); // linearAlgorithm
+            0, // algorithm
+            false); // buddyMultipleRoots
         // No need to call m_pBlockVectors[memTypeIndex][blockVectorTypeIndex]->CreateMinBlocks here,
         // becase minBlockCount is 0.
         m_pDedicatedAllocations[memTypeIndex] = vma_new(this, AllocationVectorType)(VmaStlAllocator<VmaAllocation>(GetAllocationCallbacks()));
@@ -14243,7 +22051,7 @@ VkResult VmaAllocator_T::Init(const VmaAllocatorCreateInfo* pCreateInfo)
         !VmaStrIsEmpty(pCreateInfo->pRecordSettings->pFilePath))
     {
 #if VMA_RECORDING_ENABLED
-        m_pRecorder = vma_new(this, VmaRecorder)();
+        m_pRecorder = vma_new(this, VmaRecorder)(this);
         res = m_pRecorder->Init(*pCreateInfo->pRecordSettings, m_UseMutex);
         if(res != VK_SUCCESS)
         {
@@ -14309,7 +22117,11 @@ void VmaAllocator_T::ImportVulkanFunctions(const VmaVulkanFunctions* pVulkanFunc
     m_VulkanFunctions.vkDestroyImage = (PFN_vkDestroyImage)vkDestroyImage;
     m_VulkanFunctions.vkCmdCopyBuffer = (PFN_vkCmdCopyBuffer)vkCmdCopyBuffer;
 #if VMA_DEDICATED_ALLOCATION
-    if(m_UseKhrDedicatedAllocation)
+    // Functions provided by the user are not fetched, so the device doesn't have to support vkGetDeviceProcAddr.
+    if(m_UseKhrDedicatedAllocation &&
+        (pVulkanFunctions == VMA_NULL ||
+        pVulkanFunctions->vkGetBufferMemoryRequirements2KHR == VMA_NULL ||
+        pVulkanFunctions->vkGetImageMemoryRequirements2KHR == VMA_NULL))
     {
         m_VulkanFunctions.vkGetBufferMemoryRequirements2KHR =
             (PFN_vkGetBufferMemoryRequirements2KHR)vkGetDeviceProcAddr(m_hDevice, "vkGetBufferMemoryRequirements2KHR");
@@ -14318,7 +22130,10 @@ void VmaAllocator_T::ImportVulkanFunctions(const VmaVulkanFunctions* pVulkanFunc
     }
 #endif // #if VMA_DEDICATED_ALLOCATION
 #if VMA_BIND_MEMORY2
-    if(m_UseKhrBindMemory2)
+    if(m_UseKhrBindMemory2 &&
+        (pVulkanFunctions == VMA_NULL ||
+        pVulkanFunctions->vkBindBufferMemory2KHR == VMA_NULL ||
+        pVulkanFunctions->vkBindImageMemory2KHR == VMA_NULL))
     {
         m_VulkanFunctions.vkBindBufferMemory2KHR =
             (PFN_vkBindBufferMemory2KHR)vkGetDeviceProcAddr(m_hDevice, "vkBindBufferMemory2KHR");
@@ -14504,6 +22319,7 @@ VkResult VmaAllocator_T::AllocateMemoryOfType(
             {
                 // Succeeded: AllocateDedicatedMemory function already filld pMemory, nothing more to do here.
                 VMA_DEBUG_LOG("    Allocated as DedicatedMemory");
+                m_Counters.Add(VmaAllocatorCounters::COUNTER_DEDICATED_FALLBACK_COUNT, allocationCount);
                 return VK_SUCCESS;
             }
             else
@@ -14575,7 +22391,7 @@ VkResult VmaAllocator_T::AllocateDedicatedMemory(
     {
         // Register them in m_pDedicatedAllocations.
         {
-            VmaMutexLockWrite lock(m_DedicatedAllocationsMutex[memTypeIndex], m_UseMutex);
+            VmaMutexLockWrite lock(m_DedicatedAllocationsMutex[memTypeIndex], m_UseMutex, m_Counters);
             AllocationVectorType* pDedicatedAllocations = m_pDedicatedAllocations[memTypeIndex];
             VMA_ASSERT(pDedicatedAllocations);
             for(allocIndex = 0; allocIndex < allocationCount; ++allocIndex)
@@ -14584,6 +22400,7 @@ VkResult VmaAllocator_T::AllocateDedicatedMemory(
             }
         }
 
+        m_Counters.Add(VmaAllocatorCounters::COUNTER_DEDICATED_ALLOCATION_COUNT, allocationCount);
         VMA_DEBUG_LOG("    Allocated DedicatedMemory Count=%zu, MemoryTypeIndex=#%u", allocationCount, memTypeIndex);
     }
     else
@@ -14741,6 +22558,48 @@ VkResult VmaAllocator_T::AllocateMemory(
     VmaSuballocationType suballocType,
     size_t allocationCount,
     VmaAllocation* pAllocations)
+{
+    const VkResult res = AllocateMemoryUncounted(
+        vkMemReq,
+        requiresDedicatedAllocation,
+        prefersDedicatedAllocation,
+        dedicatedBuffer,
+        dedicatedImage,
+        createInfo,
+        suballocType,
+        allocationCount,
+        pAllocations);
+
+    if(res == VK_SUCCESS)
+    {
+        VkDeviceSize allocatedBytes = 0;
+        for(size_t allocIndex = 0; allocIndex < allocationCount; ++allocIndex)
+        {
+            allocatedBytes += pAllocations[allocIndex]->GetSize();
+        }
+        m_Counters.Add(
+            VmaAllocatorCounters::COUNTER_ALLOCATION_COUNT, allocationCount,
+            VmaAllocatorCounters::COUNTER_ALLOCATION_BYTES, allocatedBytes);
+    }
+    else
+    {
+        m_Counters.Add(
+            VmaAllocatorCounters::COUNTER_ALLOCATION_COUNT, allocationCount,
+            VmaAllocatorCounters::COUNTER_ALLOCATION_FAILURE_COUNT, allocationCount);
+    }
+    return res;
+}
+
+VkResult VmaAllocator_T::AllocateMemoryUncounted(
+    const VkMemoryRequirements& vkMemReq,
+    bool requiresDedicatedAllocation,
+    bool prefersDedicatedAllocation,
+    VkBuffer dedicatedBuffer,
+    VkImage dedicatedImage,
+    const VmaAllocationCreateInfo& createInfo,
+    VmaSuballocationType suballocType,
+    size_t allocationCount,
+    VmaAllocation* pAllocations)
 {
     memset(pAllocations, 0, sizeof(VmaAllocation) * allocationCount);
 
@@ -14893,6 +22752,10 @@ void VmaAllocator_T::FreeMemory(
 
         if(allocation != VK_NULL_HANDLE)
         {
+            m_Counters.Add(
+                VmaAllocatorCounters::COUNTER_FREE_COUNT, 1,
+                VmaAllocatorCounters::COUNTER_FREE_BYTES, allocation->GetSize());
+
             if(TouchAllocation(allocation))
             {
                 if(VMA_DEBUG_INITIALIZE_ALLOCATIONS)
@@ -14933,6 +22796,68 @@ void VmaAllocator_T::FreeMemory(
     }
 }
 
+VkResult VmaAllocator_T::AllocateMemoryWithoutHandle(
+    const VkMemoryRequirements& vkMemReq,
+    const VmaAllocationCreateInfo& createInfo,
+    VmaSuballocationType suballocType,
+    VmaAllocationInfo* pAllocationInfo)
+{
+    VMA_ASSERT(VmaIsPow2(vkMemReq.alignment));
+
+    if(vkMemReq.size == 0)
+    {
+        return VK_ERROR_VALIDATION_FAILED_EXT;
+    }
+    if(createInfo.pool == VK_NULL_HANDLE ||
+        createInfo.pool->m_BlockVector.GetAlgorithm() != VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT)
+    {
+        VMA_ASSERT(0 && "Allocation without VmaAllocation object requires custom pool with VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT.");
+        return VK_ERROR_FEATURE_NOT_PRESENT;
+    }
+    // There is no object that could be made lost, own dedicated memory or a string.
+    if((createInfo.flags & (VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT |
+        VMA_ALLOCATION_CREATE_CAN_BECOME_LOST_BIT |
+        VMA_ALLOCATION_CREATE_USER_DATA_COPY_STRING_BIT)) != 0)
+    {
+        return VK_ERROR_FEATURE_NOT_PRESENT;
+    }
+
+    VmaBlockVector& blockVector = createInfo.pool->m_BlockVector;
+    const VkDeviceSize alignmentForPool = VMA_MAX(
+        vkMemReq.alignment,
+        GetMemoryTypeMinAlignment(blockVector.GetMemoryTypeIndex()));
+
+    VmaAllocationCreateInfo createInfoForPool = createInfo;
+    // If memory type is not HOST_VISIBLE, disable MAPPED.
+    if((createInfoForPool.flags & VMA_ALLOCATION_CREATE_MAPPED_BIT) != 0 &&
+        (m_MemProps.memoryTypes[blockVector.GetMemoryTypeIndex()].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) == 0)
+    {
+        createInfoForPool.flags &= ~VMA_ALLOCATION_CREATE_MAPPED_BIT;
+    }
+
+    const VkResult res = blockVector.AllocateWithoutHandle(
+        m_CurrentFrameIndex.load(),
+        vkMemReq.size,
+        alignmentForPool,
+        createInfoForPool,
+        suballocType,
+        pAllocationInfo);
+
+    if(res == VK_SUCCESS)
+    {
+        m_Counters.Add(
+            VmaAllocatorCounters::COUNTER_ALLOCATION_COUNT, 1,
+            VmaAllocatorCounters::COUNTER_ALLOCATION_BYTES, pAllocationInfo->size);
+    }
+    else
+    {
+        m_Counters.Add(
+            VmaAllocatorCounters::COUNTER_ALLOCATION_COUNT, 1,
+            VmaAllocatorCounters::COUNTER_ALLOCATION_FAILURE_COUNT, 1);
+    }
+    return res;
+}
+
 VkResult VmaAllocator_T::ResizeAllocation(
     const VmaAllocation alloc,
     VkDeviceSize newSize)
@@ -14979,17 +22904,170 @@ void VmaAllocator_T::CalculateStats(VmaStats* pStats)
     for(uint32_t memTypeIndex = 0; memTypeIndex < GetMemoryTypeCount(); ++memTypeIndex)
     {
         const uint32_t memHeapIndex = MemoryTypeIndexToHeapIndex(memTypeIndex);
-        VmaMutexLockRead dedicatedAllocationsLock(m_DedicatedAllocationsMutex[memTypeIndex], m_UseMutex);
-        AllocationVectorType* const pDedicatedAllocVector = m_pDedicatedAllocations[memTypeIndex];
-        VMA_ASSERT(pDedicatedAllocVector);
-        for(size_t allocIndex = 0, allocCount = pDedicatedAllocVector->size(); allocIndex < allocCount; ++allocIndex)
+        VmaStatInfo statInfo;
+        CalcDedicatedAllocationsStatInfo(memTypeIndex, statInfo);
+        VmaAddStatInfo(pStats->total, statInfo);
+        VmaAddStatInfo(pStats->memoryType[memTypeIndex], statInfo);
+        VmaAddStatInfo(pStats->memoryHeap[memHeapIndex], statInfo);
+    }
+
+    // Postprocess.
+    VmaPostprocessCalcStatInfo(pStats->total);
+    for(size_t i = 0; i < GetMemoryTypeCount(); ++i)
+        VmaPostprocessCalcStatInfo(pStats->memoryType[i]);
+    for(size_t i = 0; i < GetMemoryHeapCount(); ++i)
+        VmaPostprocessCalcStatInfo(pStats->memoryHeap[i]);
+}
+
+void VmaAllocator_T::CalcDedicatedAllocationsStatInfo(uint32_t memTypeIndex, VmaStatInfo& outInfo)
+{
+    InitStatInfo(outInfo);
+
+    VmaMutexLockRead dedicatedAllocationsLock(m_DedicatedAllocationsMutex[memTypeIndex], m_UseMutex);
+    AllocationVectorType* const pDedicatedAllocVector = m_pDedicatedAllocations[memTypeIndex];
+    VMA_ASSERT(pDedicatedAllocVector);
+    for(size_t allocIndex = 0, allocCount = pDedicatedAllocVector->size(); allocIndex < allocCount; ++allocIndex)
+    {
+        VmaStatInfo allocationStatInfo;
+        (*pDedicatedAllocVector)[allocIndex]->DedicatedAllocCalcStatsInfo(allocationStatInfo);
+        VmaAddStatInfo(outInfo, allocationStatInfo);
+    }
+}
+
+// Minimum number of tasks per worker thread started by VmaRunTasksOnThreads, as single task is usually very short.
+static const uint32_t VMA_MIN_TASKS_PER_THREAD = 16;
+
+/*
+Implementation of PFN_vmaRunTasksFunction used when the user doesn't provide a task system.
+pUserData is VmaAllocator. Starts worker threads for the duration of the call and distributes
+tasks between them and the calling thread.
+*/
+static void VKAPI_PTR VmaRunTasksOnThreads(
+    void* pUserData,
+    PFN_vmaTaskFunction pfnTask,
+    void* pTaskData,
+    uint32_t taskCount)
+{
+#if VMA_USE_STL_THREAD
+    VmaAllocator hAllocator = (VmaAllocator)pUserData;
+    // Calling thread is one of the workers.
+    const uint32_t threadCount = VMA_MIN(std::thread::hardware_concurrency(), taskCount / VMA_MIN_TASKS_PER_THREAD);
+    if(threadCount > 1)
+    {
+        std::atomic<uint32_t> nextTaskIndex(0);
+        auto worker = [&nextTaskIndex, pfnTask, pTaskData, taskCount]()
+        {
+            for(uint32_t taskIndex = nextTaskIndex++; taskIndex < taskCount; taskIndex = nextTaskIndex++)
+            {
+                pfnTask(pTaskData, taskIndex);
+            }
+        };
+
+        std::thread* const threads = VmaAllocateArray<std::thread>(hAllocator, threadCount - 1);
+        for(uint32_t threadIndex = 0; threadIndex < threadCount - 1; ++threadIndex)
+        {
+            new(&threads[threadIndex]) std::thread(worker);
+        }
+        worker();
+        for(uint32_t threadIndex = 0; threadIndex < threadCount - 1; ++threadIndex)
         {
-            VmaStatInfo allocationStatInfo;
-            (*pDedicatedAllocVector)[allocIndex]->DedicatedAllocCalcStatsInfo(allocationStatInfo);
-            VmaAddStatInfo(pStats->total, allocationStatInfo);
-            VmaAddStatInfo(pStats->memoryType[memTypeIndex], allocationStatInfo);
-            VmaAddStatInfo(pStats->memoryHeap[memHeapIndex], allocationStatInfo);
+            threads[threadIndex].join();
         }
+        vma_delete_array(hAllocator, threads, threadCount - 1);
+        return;
+    }
+#else
+    (void)pUserData;
+#endif
+
+    for(uint32_t taskIndex = 0; taskIndex < taskCount; ++taskIndex)
+    {
+        pfnTask(pTaskData, taskIndex);
+    }
+}
+
+struct VmaCalcStatsTaskData
+{
+    VmaAllocator hAllocator;
+    // Block vectors of default pools for all memory types, followed by custom pools.
+    VmaBlockVector* const* pBlockVectors;
+    uint32_t blockVectorCount;
+    // One for every task: results of block vectors, followed by dedicated allocations of every memory type.
+    VmaStatInfo* pStatInfo;
+};
+
+static void VKAPI_PTR VmaCalcStatsTask(void* pTaskData, uint32_t taskIndex)
+{
+    VmaCalcStatsTaskData* const pData = (VmaCalcStatsTaskData*)pTaskData;
+    if(taskIndex < pData->blockVectorCount)
+    {
+        pData->pBlockVectors[taskIndex]->CalcStatInfo(pData->pStatInfo[taskIndex]);
+    }
+    else
+    {
+        const uint32_t memTypeIndex = taskIndex - pData->blockVectorCount;
+        pData->hAllocator->CalcDedicatedAllocationsStatInfo(memTypeIndex, pData->pStatInfo[taskIndex]);
+    }
+}
+
+void VmaAllocator_T::CalculateStatsParallel(const VmaTaskSystem* pTaskSystem, VmaStats* pStats)
+{
+    // Initialize.
+    InitStatInfo(pStats->total);
+    for(size_t i = 0; i < VK_MAX_MEMORY_TYPES; ++i)
+        InitStatInfo(pStats->memoryType[i]);
+    for(size_t i = 0; i < VK_MAX_MEMORY_HEAPS; ++i)
+        InitStatInfo(pStats->memoryHeap[i]);
+
+    const uint32_t memTypeCount = GetMemoryTypeCount();
+
+    // Custom pools cannot be destroyed while their tasks are running.
+    VmaMutexLockRead lock(m_PoolsMutex, m_UseMutex);
+
+    const VmaStlAllocator<VmaBlockVector*> stlAllocator(GetAllocationCallbacks());
+    VmaVector< VmaBlockVector*, VmaStlAllocator<VmaBlockVector*> > blockVectors(stlAllocator);
+    blockVectors.reserve(memTypeCount + m_Pools.size());
+    for(uint32_t memTypeIndex = 0; memTypeIndex < memTypeCount; ++memTypeIndex)
+    {
+        VMA_ASSERT(m_pBlockVectors[memTypeIndex]);
+        blockVectors.push_back(m_pBlockVectors[memTypeIndex]);
+    }
+    for(size_t poolIndex = 0, poolCount = m_Pools.size(); poolIndex < poolCount; ++poolIndex)
+    {
+        blockVectors.push_back(&m_Pools[poolIndex]->m_BlockVector);
+    }
+
+    const uint32_t blockVectorCount = (uint32_t)blockVectors.size();
+    const uint32_t taskCount = blockVectorCount + memTypeCount;
+    VmaVector< VmaStatInfo, VmaStlAllocator<VmaStatInfo> > statInfo(
+        taskCount, VmaStlAllocator<VmaStatInfo>(GetAllocationCallbacks()));
+
+    VmaCalcStatsTaskData taskData = {};
+    taskData.hAllocator = this;
+    taskData.pBlockVectors = blockVectors.data();
+    taskData.blockVectorCount = blockVectorCount;
+    taskData.pStatInfo = statInfo.data();
+
+    if(pTaskSystem != VMA_NULL)
+    {
+        VMA_ASSERT(pTaskSystem->pfnRunTasks != VMA_NULL);
+        (*pTaskSystem->pfnRunTasks)(pTaskSystem->pUserData, VmaCalcStatsTask, &taskData, taskCount);
+    }
+    else
+    {
+        VmaRunTasksOnThreads(this, VmaCalcStatsTask, &taskData, taskCount);
+    }
+
+    // Merge results in order of tasks, so they don't depend on which thread executed which task.
+    for(uint32_t taskIndex = 0; taskIndex < taskCount; ++taskIndex)
+    {
+        const uint32_t memTypeIndex = taskIndex < blockVectorCount ?
+            blockVectors[taskIndex]->GetMemoryTypeIndex() :
+            taskIndex - blockVectorCount;
+        const uint32_t memHeapIndex = MemoryTypeIndexToHeapIndex(memTypeIndex);
+        VmaAddStatInfo(pStats->total, statInfo[taskIndex]);
+        VmaAddStatInfo(pStats->memoryType[memTypeIndex], statInfo[taskIndex]);
+        VmaAddStatInfo(pStats->memoryHeap[memHeapIndex], statInfo[taskIndex]);
     }
 
     // Postprocess.
@@ -15007,6 +23085,8 @@ VkResult VmaAllocator_T::DefragmentationBegin(
     VmaDefragmentationStats* pStats,
     VmaDefragmentationContext* pContext)
 {
+    m_Counters.Add(VmaAllocatorCounters::COUNTER_DEFRAGMENTATION_COUNT, 1);
+
     if(info.pAllocationsChanged != VMA_NULL)
     {
         memset(info.pAllocationsChanged, 0, info.allocationCount * sizeof(VkBool32));
@@ -15040,6 +23120,26 @@ VkResult VmaAllocator_T::DefragmentationEnd(
     return VK_SUCCESS;
 }
 
+VkResult VmaAllocator_T::EstimateDefragmentation(
+    const VmaDefragmentationInfo2& info,
+    VmaDefragmentationEstimate* pEstimate)
+{
+    VmaDefragmentationContext context = vma_new(this, VmaDefragmentationContext_T)(
+        this, m_CurrentFrameIndex.load(), info.flags, VMA_NULL);
+
+    context->AddPools(info.poolCount, info.pPools);
+    // pAllocationsChanged is deliberately not passed - nothing is really changed.
+    context->AddAllocations(info.allocationCount, info.pAllocations, VMA_NULL);
+
+    VkResult res = context->Estimate(
+        info.maxCpuBytesToMove, info.maxCpuAllocationsToMove,
+        info.maxGpuBytesToMove, info.maxGpuAllocationsToMove,
+        info.commandBuffer, pEstimate);
+
+    vma_delete(this, context);
+    return res;
+}
+
 void VmaAllocator_T::GetAllocationInfo(VmaAllocation hAllocation, VmaAllocationInfo* pAllocationInfo)
 {
     if(hAllocation->CanBecomeLost())
@@ -15178,49 +23278,170 @@ VkResult VmaAllocator_T::CreatePool(const VmaPoolCreateInfo* pCreateInfo, VmaPoo
     {
         return VK_ERROR_INITIALIZATION_FAILED;
     }
+    if((newCreateInfo.flags & VMA_POOL_CREATE_BUDDY_MULTIPLE_ROOTS_BIT) != 0 &&
+        (newCreateInfo.flags & VMA_POOL_CREATE_ALGORITHM_MASK) != VMA_POOL_CREATE_BUDDY_ALGORITHM_BIT)
+    {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
 
     const VkDeviceSize preferredBlockSize = CalcPreferredBlockSize(newCreateInfo.memoryTypeIndex);
 
     *pPool = vma_new(this, VmaPool_T)(this, newCreateInfo, preferredBlockSize);
 
-    VkResult res = (*pPool)->m_BlockVector.CreateMinBlocks();
-    if(res != VK_SUCCESS)
+    VkResult res = (*pPool)->m_BlockVector.CreateMinBlocks();
+    if(res != VK_SUCCESS)
+    {
+        vma_delete(this, *pPool);
+        *pPool = VMA_NULL;
+        return res;
+    }
+
+    // Add to m_Pools.
+    {
+        VmaMutexLockWrite lock(m_PoolsMutex, m_UseMutex);
+        (*pPool)->SetId(m_NextPoolId++);
+        VmaVectorInsertSorted<VmaPointerLess>(m_Pools, *pPool);
+    }
+
+    return VK_SUCCESS;
+}
+
+void VmaAllocator_T::DestroyPool(VmaPool pool)
+{
+    // Remove from m_Pools.
+    {
+        VmaMutexLockWrite lock(m_PoolsMutex, m_UseMutex);
+        bool success = VmaVectorRemoveSorted<VmaPointerLess>(m_Pools, pool);
+        VMA_ASSERT(success && "Pool not found in Allocator.");
+        if(pool->IsAutoDefragmentationEnabled())
+        {
+            m_AutoDefragmentationPoolCount.fetch_sub(1);
+        }
+    }
+
+    vma_delete(this, pool);
+}
+
+void VmaAllocator_T::GetPoolStats(VmaPool pool, VmaPoolStats* pPoolStats)
+{
+    pool->m_BlockVector.GetPoolStats(pPoolStats);
+}
+
+void VmaAllocator_T::GetPoolFragmentationScore(VmaPool pool, VmaFragmentationScore* pScore)
+{
+    pool->m_BlockVector.GetFragmentationScore(pScore);
+}
+
+void VmaAllocator_T::GetMemoryTypeFragmentationScore(uint32_t memoryTypeIndex, VmaFragmentationScore* pScore)
+{
+    m_pBlockVectors[memoryTypeIndex]->GetFragmentationScore(pScore);
+}
+
+void VmaAllocator_T::GetPoolAllocationHistograms(VmaPool pool, VmaAllocationHistograms* pHistograms)
+{
+    pool->m_BlockVector.GetAllocationHistograms(pHistograms);
+}
+
+void VmaAllocator_T::GetMemoryTypeAllocationHistograms(uint32_t memoryTypeIndex, VmaAllocationHistograms* pHistograms)
+{
+    m_pBlockVectors[memoryTypeIndex]->GetAllocationHistograms(pHistograms);
+}
+
+void VmaAllocator_T::SetPoolAutoDefragmentationPolicy(VmaPool pool, const VmaAutoDefragmentationPolicy* pPolicy)
+{
+    VmaMutexLockWrite lock(m_PoolsMutex, m_UseMutex);
+    if(pool->IsAutoDefragmentationEnabled())
     {
-        vma_delete(this, *pPool);
-        *pPool = VMA_NULL;
-        return res;
+        m_AutoDefragmentationPoolCount.fetch_sub(1);
     }
-
-    // Add to m_Pools.
+    pool->SetAutoDefragmentationPolicy(pPolicy);
+    if(pool->IsAutoDefragmentationEnabled())
     {
-        VmaMutexLockWrite lock(m_PoolsMutex, m_UseMutex);
-        (*pPool)->SetId(m_NextPoolId++);
-        VmaVectorInsertSorted<VmaPointerLess>(m_Pools, *pPool);
+        m_AutoDefragmentationPoolCount.fetch_add(1);
     }
-
-    return VK_SUCCESS;
 }
 
-void VmaAllocator_T::DestroyPool(VmaPool pool)
+void VmaAllocator_T::SetCurrentFrameIndex(uint32_t frameIndex)
 {
-    // Remove from m_Pools.
+    m_CurrentFrameIndex.store(frameIndex);
+
+    if(m_AutoDefragmentationPoolCount.load() > 0)
     {
+        // Write lock, because frame counters of the pools are updated.
         VmaMutexLockWrite lock(m_PoolsMutex, m_UseMutex);
-        bool success = VmaVectorRemoveSorted<VmaPointerLess>(m_Pools, pool);
-        VMA_ASSERT(success && "Pool not found in Allocator.");
+        for(size_t poolIndex = 0, poolCount = m_Pools.size(); poolIndex < poolCount; ++poolIndex)
+        {
+            VmaPool const hPool = m_Pools[poolIndex];
+            // Locking m_Mutex of a pool being defragmented by the user could cause deadlock.
+            if(hPool->IsAutoDefragmentationEnabled() &&
+                !hPool->m_BlockVector.IsDefragmentationInProgress() &&
+                hPool->UpdateAutoDefragmentationFrameCounter())
+            {
+                AutoDefragmentPool(hPool, frameIndex);
+            }
+        }
     }
-
-    vma_delete(this, pool);
 }
 
-void VmaAllocator_T::GetPoolStats(VmaPool pool, VmaPoolStats* pPoolStats)
+void VmaAllocator_T::AutoDefragmentPool(VmaPool pool, uint32_t currentFrameIndex)
 {
-    pool->m_BlockVector.GetPoolStats(pPoolStats);
-}
+    m_Counters.Add(VmaAllocatorCounters::COUNTER_DEFRAGMENTATION_COUNT, 1);
 
-void VmaAllocator_T::SetCurrentFrameIndex(uint32_t frameIndex)
-{
-    m_CurrentFrameIndex.store(frameIndex);
+    const VmaAutoDefragmentationPolicy& policy = pool->GetAutoDefragmentationPolicy();
+    VmaBlockVector& blockVector = pool->m_BlockVector;
+
+    VmaVector< VmaAllocation, VmaStlAllocator<VmaAllocation> > movedAllocations =
+        VmaVector< VmaAllocation, VmaStlAllocator<VmaAllocation> >(VmaStlAllocator<VmaAllocation>(GetAllocationCallbacks()));
+
+    VmaBlockVectorDefragmentationContext ctx(
+        this,
+        pool,
+        &blockVector,
+        currentFrameIndex,
+        policy.flags);
+    ctx.AddAll();
+    ctx.SetMovedAllocations(&movedAllocations);
+
+    VkDeviceSize maxCpuBytesToMove = policy.maxBytesToMove;
+    uint32_t maxCpuAllocationsToMove = policy.maxAllocationsToMove;
+    VkDeviceSize maxGpuBytesToMove = 0;
+    uint32_t maxGpuAllocationsToMove = 0;
+    blockVector.Defragment(
+        &ctx,
+        VMA_NULL, // pStats
+        maxCpuBytesToMove, maxCpuAllocationsToMove,
+        maxGpuBytesToMove, maxGpuAllocationsToMove,
+        VK_NULL_HANDLE);
+    // Defragment() does nothing if the pool cannot be defragmented on CPU.
+    if(ctx.GetAlgorithm() == VMA_NULL)
+    {
+        return;
+    }
+    blockVector.DefragmentationEnd(&ctx, VMA_NULL);
+
+    if(ctx.res >= VK_SUCCESS &&
+        policy.pfnAllocationsMoved != VMA_NULL &&
+        !movedAllocations.empty())
+    {
+        // An allocation could have been moved more than once.
+        VMA_SORT(movedAllocations.begin(), movedAllocations.end(), VmaPointerLess());
+        size_t uniqueCount = 1;
+        for(size_t i = 1, count = movedAllocations.size(); i < count; ++i)
+        {
+            if(movedAllocations[i] != movedAllocations[uniqueCount - 1])
+            {
+                movedAllocations[uniqueCount++] = movedAllocations[i];
+            }
+        }
+        movedAllocations.resize(uniqueCount);
+
+        (*policy.pfnAllocationsMoved)(
+            this,
+            pool,
+            (uint32_t)movedAllocations.size(),
+            movedAllocations.data(),
+            policy.pUserData);
+    }
 }
 
 void VmaAllocator_T::MakePoolAllocationsLost(
@@ -15232,6 +23453,59 @@ void VmaAllocator_T::MakePoolAllocationsLost(
         pLostAllocationCount);
 }
 
+VkResult VmaAllocator_T::FreePoolAllocations(
+    VmaPool hPool,
+    uint32_t lastFrameIndex,
+    size_t* pFreedAllocationCount)
+{
+    if(hPool->m_BlockVector.GetAlgorithm() != VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT)
+    {
+        return VK_ERROR_FEATURE_NOT_PRESENT;
+    }
+
+    const VmaStlAllocator<VmaAllocation> stlAllocator(GetAllocationCallbacks());
+    VmaVector< VmaAllocation, VmaStlAllocator<VmaAllocation> > allocations(stlAllocator);
+    const VmaStlAllocator<VmaSuballocation> suballocStlAllocator(GetAllocationCallbacks());
+    VmaVector< VmaSuballocation, VmaStlAllocator<VmaSuballocation> > suballocations(suballocStlAllocator);
+    bool needSuballocations = false;
+#if VMA_RECORDING_ENABLED
+    // Flight recorder describes all freed allocations, including those without VmaAllocation object.
+    needSuballocations = m_pRecorder != VMA_NULL && m_pRecorder->IsFlightRecorder();
+#endif
+    const size_t freedCount = hPool->m_BlockVector.FreeUpToFrame(
+        lastFrameIndex, allocations, needSuballocations ? &suballocations : VMA_NULL);
+
+#if VMA_RECORDING_ENABLED
+    // Recorded here, as only now it's known which allocation objects are destroyed.
+    if(m_pRecorder != VMA_NULL)
+    {
+        m_pRecorder->RecordFreePoolAllocations(
+            GetCurrentFrameIndex(),
+            hPool,
+            lastFrameIndex,
+            (uint64_t)freedCount,
+            (uint64_t)allocations.size(),
+            allocations.data(),
+            suballocations.size(),
+            suballocations.data());
+    }
+#endif
+
+    // Allocation objects are returned all at once.
+    for(size_t i = 0; i < allocations.size(); ++i)
+    {
+        allocations[i]->SetUserData(this, VMA_NULL);
+        allocations[i]->Dtor();
+    }
+    m_AllocationObjectAllocator.Free(allocations.size(), allocations.data());
+
+    if(pFreedAllocationCount != VMA_NULL)
+    {
+        *pFreedAllocationCount = freedCount;
+    }
+    return VK_SUCCESS;
+}
+
 VkResult VmaAllocator_T::CheckPoolCorruption(VmaPool hPool)
 {
     return hPool->m_BlockVector.CheckCorruption();
@@ -15423,11 +23697,19 @@ VkResult VmaAllocator_T::Map(VmaAllocation hAllocation, void** ppData)
             {
                 *ppData = pBytes + (ptrdiff_t)hAllocation->GetOffset();
                 hAllocation->BlockAllocMap();
+                m_Counters.Add(VmaAllocatorCounters::COUNTER_MAP_COUNT, 1);
             }
             return res;
         }
     case VmaAllocation_T::ALLOCATION_TYPE_DEDICATED:
-        return hAllocation->DedicatedAllocMap(this, ppData);
+        {
+            VkResult res = hAllocation->DedicatedAllocMap(this, ppData);
+            if(res == VK_SUCCESS)
+            {
+                m_Counters.Add(VmaAllocatorCounters::COUNTER_MAP_COUNT, 1);
+            }
+            return res;
+        }
     default:
         VMA_ASSERT(0);
         return VK_ERROR_MEMORY_MAP_FAILED;
@@ -15436,6 +23718,8 @@ VkResult VmaAllocator_T::Map(VmaAllocation hAllocation, void** ppData)
 
 void VmaAllocator_T::Unmap(VmaAllocation hAllocation)
 {
+    m_Counters.Add(VmaAllocatorCounters::COUNTER_UNMAP_COUNT, 1);
+
     switch(hAllocation->GetType())
     {
     case VmaAllocation_T::ALLOCATION_TYPE_BLOCK:
@@ -15508,6 +23792,10 @@ void VmaAllocator_T::FlushOrInvalidateAllocation(
     VkDeviceSize offset, VkDeviceSize size,
     VMA_CACHE_OPERATION op)
 {
+    m_Counters.Add(op == VMA_CACHE_FLUSH ?
+        VmaAllocatorCounters::COUNTER_FLUSH_COUNT :
+        VmaAllocatorCounters::COUNTER_INVALIDATE_COUNT, 1);
+
     const uint32_t memTypeIndex = hAllocation->GetMemoryTypeIndex();
     if(size > 0 && IsMemoryTypeNonCoherent(memTypeIndex))
     {
@@ -15585,7 +23873,7 @@ void VmaAllocator_T::FreeDedicatedMemory(VmaAllocation allocation)
 
     const uint32_t memTypeIndex = allocation->GetMemoryTypeIndex();
     {
-        VmaMutexLockWrite lock(m_DedicatedAllocationsMutex[memTypeIndex], m_UseMutex);
+        VmaMutexLockWrite lock(m_DedicatedAllocationsMutex[memTypeIndex], m_UseMutex, m_Counters);
         AllocationVectorType* const pDedicatedAllocations = m_pDedicatedAllocations[memTypeIndex];
         VMA_ASSERT(pDedicatedAllocations);
         bool success = VmaVectorRemoveSorted<VmaPointerLess>(*pDedicatedAllocations, allocation);
@@ -15754,8 +24042,350 @@ void VmaAllocator_T::PrintDetailedMap(VmaJsonWriter& json)
     }
 }
 
+void VmaAllocator_T::WriteBinaryDetailedMap(VmaBinaryStatsWriter& writer)
+{
+    for(uint32_t memTypeIndex = 0; memTypeIndex < GetMemoryTypeCount(); ++memTypeIndex)
+    {
+        VmaMutexLockRead dedicatedAllocationsLock(m_DedicatedAllocationsMutex[memTypeIndex], m_UseMutex);
+        AllocationVectorType* const pDedicatedAllocVector = m_pDedicatedAllocations[memTypeIndex];
+        VMA_ASSERT(pDedicatedAllocVector);
+        for(size_t i = 0; i < pDedicatedAllocVector->size(); ++i)
+        {
+            writer.WriteDedicatedAllocation(memTypeIndex, (*pDedicatedAllocVector)[i]);
+        }
+    }
+
+    for(uint32_t memTypeIndex = 0; memTypeIndex < GetMemoryTypeCount(); ++memTypeIndex)
+    {
+        if(m_pBlockVectors[memTypeIndex]->IsEmpty() == false)
+        {
+            m_pBlockVectors[memTypeIndex]->WriteBinaryStats(writer, 0);
+        }
+    }
+
+    // Custom pools
+    {
+        VmaMutexLockRead lock(m_PoolsMutex, m_UseMutex);
+        for(size_t poolIndex = 0; poolIndex < m_Pools.size(); ++poolIndex)
+        {
+            m_Pools[poolIndex]->m_BlockVector.WriteBinaryStats(writer, m_Pools[poolIndex]->GetId());
+        }
+    }
+}
+
+VkResult VmaAllocator_T::CreateStatsSnapshot(VmaStatsSnapshotCreateFlags flags, VmaStatsSnapshot* pSnapshot)
+{
+    *pSnapshot = vma_new(this, VmaStatsSnapshot_T)(
+        GetAllocationCallbacks(),
+        GetMemoryTypeCount(),
+        (flags & VMA_STATS_SNAPSHOT_CREATE_ALLOCATIONS_BIT) != 0);
+
+    VmaStatsSnapshotBuilder builder(GetAllocationCallbacks(), **pSnapshot);
+
+    for(uint32_t memTypeIndex = 0; memTypeIndex < GetMemoryTypeCount(); ++memTypeIndex)
+    {
+        VmaMutexLockRead dedicatedAllocationsLock(m_DedicatedAllocationsMutex[memTypeIndex], m_UseMutex);
+        AllocationVectorType* const pDedicatedAllocVector = m_pDedicatedAllocations[memTypeIndex];
+        VMA_ASSERT(pDedicatedAllocVector);
+        for(size_t i = 0; i < pDedicatedAllocVector->size(); ++i)
+        {
+            builder.AddDedicatedAllocation(memTypeIndex, (*pDedicatedAllocVector)[i]);
+        }
+    }
+
+    for(uint32_t memTypeIndex = 0; memTypeIndex < GetMemoryTypeCount(); ++memTypeIndex)
+    {
+        m_pBlockVectors[memTypeIndex]->AddToStatsSnapshot(builder, 0);
+    }
+
+    // Custom pools
+    {
+        VmaMutexLockRead lock(m_PoolsMutex, m_UseMutex);
+        for(size_t poolIndex = 0; poolIndex < m_Pools.size(); ++poolIndex)
+        {
+            m_Pools[poolIndex]->m_BlockVector.AddToStatsSnapshot(builder, m_Pools[poolIndex]->GetId());
+        }
+    }
+
+    builder.Finish();
+    return VK_SUCCESS;
+}
+
+void VmaAllocator_T::DestroyStatsSnapshot(VmaStatsSnapshot snapshot)
+{
+    vma_delete(this, snapshot);
+}
+
+static void VmaSubtractStatsDelta(VmaStatsDelta& inoutDelta, const VmaStatsDelta& src)
+{
+    inoutDelta.blockCount -= src.blockCount;
+    inoutDelta.allocationCount -= src.allocationCount;
+    inoutDelta.usedBytes -= src.usedBytes;
+    inoutDelta.unusedBytes -= src.unusedBytes;
+}
+
+static bool VmaIsStatsDeltaZero(const VmaStatsDelta& delta)
+{
+    return delta.blockCount == 0 && delta.allocationCount == 0 &&
+        delta.usedBytes == 0 && delta.unusedBytes == 0;
+}
+
+struct VmaBlockSnapshotEqual
+{
+    // Block with the same pool and ID is the same block, but its contents may have changed.
+    bool operator()(const VmaBlockSnapshot& lhs, const VmaBlockSnapshot& rhs) const
+    {
+        return lhs.size == rhs.size &&
+            lhs.allocationCount == rhs.allocationCount &&
+            lhs.usedBytes == rhs.usedBytes;
+    }
+};
+
+struct VmaAllocationSnapshotEqual
+{
+    // Different allocation may be created in place of freed one.
+    bool operator()(const VmaAllocationSnapshot& lhs, const VmaAllocationSnapshot& rhs) const
+    {
+        return lhs.allocation == rhs.allocation &&
+            lhs.size == rhs.size &&
+            lhs.creationFrameIndex == rhs.creationFrameIndex;
+    }
+};
+
+/*
+Merges two vectors sorted by cmpLess. Items found only in `before` are appended to
+outRemoved, items found only in `after` are appended to outAdded. Items with equal
+keys that are different according to cmpEqual are appended to pOutChanged, as they
+are in `after`, or to both outRemoved and outAdded if pOutChanged is null.
+*/
+template<typename T, typename CmpLess, typename CmpEqual>
+static void VmaDiffSortedVectors(
+    const VmaVector< T, VmaStlAllocator<T> >& before,
+    const VmaVector< T, VmaStlAllocator<T> >& after,
+    CmpLess cmpLess,
+    CmpEqual cmpEqual,
+    VmaVector< T, VmaStlAllocator<T> >& outRemoved,
+    VmaVector< T, VmaStlAllocator<T> >& outAdded,
+    VmaVector< T, VmaStlAllocator<T> >* pOutChanged)
+{
+    size_t beforeIndex = 0, afterIndex = 0;
+    while(beforeIndex < before.size() && afterIndex < after.size())
+    {
+        if(cmpLess(before[beforeIndex], after[afterIndex]))
+        {
+            outRemoved.push_back(before[beforeIndex++]);
+        }
+        else if(cmpLess(after[afterIndex], before[beforeIndex]))
+        {
+            outAdded.push_back(after[afterIndex++]);
+        }
+        else
+        {
+            if(!cmpEqual(before[beforeIndex], after[afterIndex]))
+            {
+                if(pOutChanged != VMA_NULL)
+                {
+                    pOutChanged->push_back(after[afterIndex]);
+                }
+                else
+                {
+                    outRemoved.push_back(before[beforeIndex]);
+                    outAdded.push_back(after[afterIndex]);
+                }
+            }
+            ++beforeIndex;
+            ++afterIndex;
+        }
+    }
+    for(; beforeIndex < before.size(); ++beforeIndex)
+    {
+        outRemoved.push_back(before[beforeIndex]);
+    }
+    for(; afterIndex < after.size(); ++afterIndex)
+    {
+        outAdded.push_back(after[afterIndex]);
+    }
+}
+
+// Returns copy of the vector allocated as array that must be freed with vma_delete_array, or null if it's empty.
+template<typename T>
+static const T* VmaCopyVectorToArray(VmaAllocator hAllocator, const VmaVector< T, VmaStlAllocator<T> >& src)
+{
+    if(src.empty())
+    {
+        return VMA_NULL;
+    }
+    T* const pArray = VmaAllocateArray<T>(hAllocator, src.size());
+    memcpy(pArray, src.data(), src.size() * sizeof(T));
+    return pArray;
+}
+
+void VmaAllocator_T::CompareStatsSnapshots(
+    const VmaStatsSnapshot_T& before,
+    const VmaStatsSnapshot_T& after,
+    VmaStatsSnapshotDiff* pDiff)
+{
+    VMA_ASSERT(before.m_MemoryTypeCount == GetMemoryTypeCount() && after.m_MemoryTypeCount == GetMemoryTypeCount());
+
+    memset(pDiff, 0, sizeof(*pDiff));
+
+    for(uint32_t memTypeIndex = 0; memTypeIndex < GetMemoryTypeCount(); ++memTypeIndex)
+    {
+        VmaStatsDelta& delta = pDiff->memoryType[memTypeIndex];
+        delta = after.m_MemoryTypes[memTypeIndex];
+        VmaSubtractStatsDelta(delta, before.m_MemoryTypes[memTypeIndex]);
+        pDiff->total.blockCount += delta.blockCount;
+        pDiff->total.allocationCount += delta.allocationCount;
+        pDiff->total.usedBytes += delta.usedBytes;
+        pDiff->total.unusedBytes += delta.unusedBytes;
+    }
+
+    // Pools
+    {
+        const VmaStlAllocator<VmaPoolStatsDelta> stlAllocator(GetAllocationCallbacks());
+        VmaVector< VmaPoolStatsDelta, VmaStlAllocator<VmaPoolStatsDelta> > pools(stlAllocator);
+        const VmaStatsSnapshotPoolLess poolLess;
+        size_t beforeIndex = 0, afterIndex = 0;
+        while(beforeIndex < before.m_Pools.size() || afterIndex < after.m_Pools.size())
+        {
+            VmaPoolStatsDelta pool;
+            if(afterIndex == after.m_Pools.size() ||
+                (beforeIndex < before.m_Pools.size() && poolLess(before.m_Pools[beforeIndex], after.m_Pools[afterIndex])))
+            {
+                // Pool destroyed.
+                pool = before.m_Pools[beforeIndex++];
+                const VmaStatsDelta beforeStats = pool.delta;
+                memset(&pool.delta, 0, sizeof(pool.delta));
+                VmaSubtractStatsDelta(pool.delta, beforeStats);
+                pools.push_back(pool);
+            }
+            else if(beforeIndex == before.m_Pools.size() ||
+                poolLess(after.m_Pools[afterIndex], before.m_Pools[beforeIndex]))
+            {
+                // Pool created.
+                pools.push_back(after.m_Pools[afterIndex++]);
+            }
+            else
+            {
+                pool = after.m_Pools[afterIndex++];
+                VmaSubtractStatsDelta(pool.delta, before.m_Pools[beforeIndex++].delta);
+                if(!VmaIsStatsDeltaZero(pool.delta))
+                {
+                    pools.push_back(pool);
+                }
+            }
+        }
+        pDiff->poolCount = (uint32_t)pools.size();
+        pDiff->pPools = VmaCopyVectorToArray(this, pools);
+    }
+
+    // Blocks
+    {
+        const VmaStlAllocator<VmaBlockSnapshot> stlAllocator(GetAllocationCallbacks());
+        VmaVector< VmaBlockSnapshot, VmaStlAllocator<VmaBlockSnapshot> > destroyedBlocks(stlAllocator);
+        VmaVector< VmaBlockSnapshot, VmaStlAllocator<VmaBlockSnapshot> > createdBlocks(stlAllocator);
+        VmaVector< VmaBlockSnapshot, VmaStlAllocator<VmaBlockSnapshot> > changedBlocks(stlAllocator);
+        VmaDiffSortedVectors(before.m_Blocks, after.m_Blocks,
+            VmaStatsSnapshotBlockLess(), VmaBlockSnapshotEqual(),
+            destroyedBlocks, createdBlocks, &changedBlocks);
+        pDiff->destroyedBlockCount = (uint32_t)destroyedBlocks.size();
+        pDiff->pDestroyedBlocks = VmaCopyVectorToArray(this, destroyedBlocks);
+        pDiff->createdBlockCount = (uint32_t)createdBlocks.size();
+        pDiff->pCreatedBlocks = VmaCopyVectorToArray(this, createdBlocks);
+        pDiff->changedBlockCount = (uint32_t)changedBlocks.size();
+        pDiff->pChangedBlocks = VmaCopyVectorToArray(this, changedBlocks);
+    }
+
+    // Allocations
+    if(before.m_HasAllocations && after.m_HasAllocations)
+    {
+        const VmaStlAllocator<VmaAllocationSnapshot> stlAllocator(GetAllocationCallbacks());
+        VmaVector< VmaAllocationSnapshot, VmaStlAllocator<VmaAllocationSnapshot> > removedAllocations(stlAllocator);
+        VmaVector< VmaAllocationSnapshot, VmaStlAllocator<VmaAllocationSnapshot> > addedAllocations(stlAllocator);
+        VmaDiffSortedVectors(before.m_Allocations, after.m_Allocations,
+            VmaStatsSnapshotAllocationLess(), VmaAllocationSnapshotEqual(),
+            removedAllocations, addedAllocations,
+            (VmaVector< VmaAllocationSnapshot, VmaStlAllocator<VmaAllocationSnapshot> >*)VMA_NULL);
+        pDiff->removedAllocationCount = removedAllocations.size();
+        pDiff->pRemovedAllocations = VmaCopyVectorToArray(this, removedAllocations);
+        pDiff->addedAllocationCount = addedAllocations.size();
+        pDiff->pAddedAllocations = VmaCopyVectorToArray(this, addedAllocations);
+    }
+}
+
+void VmaAllocator_T::FreeStatsSnapshotDiff(VmaStatsSnapshotDiff* pDiff)
+{
+    vma_delete_array(this, const_cast<VmaPoolStatsDelta*>(pDiff->pPools), pDiff->poolCount);
+    vma_delete_array(this, const_cast<VmaBlockSnapshot*>(pDiff->pCreatedBlocks), pDiff->createdBlockCount);
+    vma_delete_array(this, const_cast<VmaBlockSnapshot*>(pDiff->pDestroyedBlocks), pDiff->destroyedBlockCount);
+    vma_delete_array(this, const_cast<VmaBlockSnapshot*>(pDiff->pChangedBlocks), pDiff->changedBlockCount);
+    vma_delete_array(this, const_cast<VmaAllocationSnapshot*>(pDiff->pAddedAllocations), pDiff->addedAllocationCount);
+    vma_delete_array(this, const_cast<VmaAllocationSnapshot*>(pDiff->pRemovedAllocations), pDiff->removedAllocationCount);
+    memset(pDiff, 0, sizeof(*pDiff));
+}
+
 #endif // #if VMA_STATS_STRING_ENABLED
 
+#if VMA_RECORDING_ENABLED
+
+void VmaAllocator_T::RecordLiveObjects()
+{
+    // VMA_RECORD_FLIGHT_RECORDER_BIT is not available otherwise.
+#if VMA_STATS_STRING_ENABLED
+    const uint32_t frameIndex = GetCurrentFrameIndex();
+
+    for(uint32_t memTypeIndex = 0; memTypeIndex < GetMemoryTypeCount(); ++memTypeIndex)
+    {
+        VmaMutexLockRead dedicatedAllocationsLock(m_DedicatedAllocationsMutex[memTypeIndex], m_UseMutex);
+        AllocationVectorType* const pDedicatedAllocVector = m_pDedicatedAllocations[memTypeIndex];
+        VMA_ASSERT(pDedicatedAllocVector);
+        for(size_t i = 0; i < pDedicatedAllocVector->size(); ++i)
+        {
+            m_pRecorder->DescribeAllocation(frameIndex, (*pDedicatedAllocVector)[i], UINT64_MAX);
+        }
+    }
+
+    for(uint32_t memTypeIndex = 0; memTypeIndex < GetMemoryTypeCount(); ++memTypeIndex)
+    {
+        m_pBlockVectors[memTypeIndex]->RecordLiveObjects(*m_pRecorder, frameIndex);
+    }
+
+    // Custom pools
+    {
+        VmaMutexLockRead lock(m_PoolsMutex, m_UseMutex);
+        for(size_t poolIndex = 0; poolIndex < m_Pools.size(); ++poolIndex)
+        {
+            m_Pools[poolIndex]->m_BlockVector.RecordLiveObjects(*m_pRecorder, frameIndex);
+        }
+    }
+#endif
+}
+
+#endif // #if VMA_RECORDING_ENABLED
+
+VkResult VmaAllocator_T::GetRecordingStats(VmaRecordingStats* pStats)
+{
+#if VMA_RECORDING_ENABLED
+    if(m_pRecorder != VMA_NULL)
+    {
+        m_pRecorder->GetStats(*pStats);
+        return VK_SUCCESS;
+    }
+#endif
+    return VK_ERROR_FEATURE_NOT_PRESENT;
+}
+
+VkResult VmaAllocator_T::DumpRecording(const char* pFilePath)
+{
+#if VMA_RECORDING_ENABLED
+    if(m_pRecorder != VMA_NULL && m_pRecorder->IsFlightRecorder())
+    {
+        return m_pRecorder->Dump(pFilePath);
+    }
+#endif
+    return VK_ERROR_FEATURE_NOT_PRESENT;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Public interface
 
@@ -15818,6 +24448,30 @@ void vmaSetCurrentFrameIndex(
     allocator->SetCurrentFrameIndex(frameIndex);
 }
 
+VkResult vmaDumpRecording(
+    VmaAllocator allocator,
+    const char* pFilePath)
+{
+    VMA_ASSERT(allocator);
+
+    VMA_DEBUG_LOG("vmaDumpRecording");
+
+    VMA_DEBUG_GLOBAL_MUTEX_LOCK
+
+    return allocator->DumpRecording(pFilePath);
+}
+
+VkResult vmaGetRecordingStats(
+    VmaAllocator allocator,
+    VmaRecordingStats* pStats)
+{
+    VMA_ASSERT(allocator && pStats);
+
+    VMA_DEBUG_GLOBAL_MUTEX_LOCK
+
+    return allocator->GetRecordingStats(pStats);
+}
+
 void vmaCalculateStats(
     VmaAllocator allocator,
     VmaStats* pStats)
@@ -15827,105 +24481,133 @@ void vmaCalculateStats(
     allocator->CalculateStats(pStats);
 }
 
-#if VMA_STATS_STRING_ENABLED
-
-void vmaBuildStatsString(
+void vmaCalculateStatsParallel(
     VmaAllocator allocator,
-    char** ppStatsString,
-    VkBool32 detailedMap)
+    const VmaTaskSystem* pTaskSystem,
+    VmaStats* pStats)
 {
-    VMA_ASSERT(allocator && ppStatsString);
+    VMA_ASSERT(allocator && pStats);
     VMA_DEBUG_GLOBAL_MUTEX_LOCK
+    allocator->CalculateStatsParallel(pTaskSystem, pStats);
+}
 
-    VmaStringBuilder sb(allocator);
+#if VMA_COUNTERS_ENABLED
+
+void vmaGetCounters(
+    VmaAllocator allocator,
+    VmaCounters* pCounters)
+{
+    VMA_ASSERT(allocator && pCounters);
+    // No VMA_DEBUG_GLOBAL_MUTEX_LOCK - counters are read without any lock.
+    allocator->m_Counters.GetSnapshot(*pCounters);
+}
+
+#endif // #if VMA_COUNTERS_ENABLED
+
+#if VMA_STATS_STRING_ENABLED
+
+static void VmaPrintStats(VmaJsonWriter& json, VmaAllocator allocator, bool detailedMap)
+{
+    json.BeginObject();
+
+    VmaStats stats;
+    allocator->CalculateStats(&stats);
+
+    json.WriteString("Total");
+    VmaPrintStatInfo(json, stats.total);
+
+    for(uint32_t heapIndex = 0; heapIndex < allocator->GetMemoryHeapCount(); ++heapIndex)
     {
-        VmaJsonWriter json(allocator->GetAllocationCallbacks(), sb);
+        json.BeginString("Heap ");
+        json.ContinueString(heapIndex);
+        json.EndString();
         json.BeginObject();
 
-        VmaStats stats;
-        allocator->CalculateStats(&stats);
+        json.WriteString("Size");
+        json.WriteNumber(allocator->m_MemProps.memoryHeaps[heapIndex].size);
 
-        json.WriteString("Total");
-        VmaPrintStatInfo(json, stats.total);
-    
-        for(uint32_t heapIndex = 0; heapIndex < allocator->GetMemoryHeapCount(); ++heapIndex)
+        json.WriteString("Flags");
+        json.BeginArray(true);
+        if((allocator->m_MemProps.memoryHeaps[heapIndex].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0)
         {
-            json.BeginString("Heap ");
-            json.ContinueString(heapIndex);
-            json.EndString();
-            json.BeginObject();
+            json.WriteString("DEVICE_LOCAL");
+        }
+        json.EndArray();
 
-            json.WriteString("Size");
-            json.WriteNumber(allocator->m_MemProps.memoryHeaps[heapIndex].size);
+        if(stats.memoryHeap[heapIndex].blockCount > 0)
+        {
+            json.WriteString("Stats");
+            VmaPrintStatInfo(json, stats.memoryHeap[heapIndex]);
+        }
 
-            json.WriteString("Flags");
-            json.BeginArray(true);
-            if((allocator->m_MemProps.memoryHeaps[heapIndex].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0)
+        for(uint32_t typeIndex = 0; typeIndex < allocator->GetMemoryTypeCount(); ++typeIndex)
+        {
+            if(allocator->MemoryTypeIndexToHeapIndex(typeIndex) == heapIndex)
             {
-                json.WriteString("DEVICE_LOCAL");
-            }
-            json.EndArray();
+                json.BeginString("Type ");
+                json.ContinueString(typeIndex);
+                json.EndString();
 
-            if(stats.memoryHeap[heapIndex].blockCount > 0)
-            {
-                json.WriteString("Stats");
-                VmaPrintStatInfo(json, stats.memoryHeap[heapIndex]);
-            }
+                json.BeginObject();
 
-            for(uint32_t typeIndex = 0; typeIndex < allocator->GetMemoryTypeCount(); ++typeIndex)
-            {
-                if(allocator->MemoryTypeIndexToHeapIndex(typeIndex) == heapIndex)
+                json.WriteString("Flags");
+                json.BeginArray(true);
+                VkMemoryPropertyFlags flags = allocator->m_MemProps.memoryTypes[typeIndex].propertyFlags;
+                if((flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) != 0)
                 {
-                    json.BeginString("Type ");
-                    json.ContinueString(typeIndex);
-                    json.EndString();
-
-                    json.BeginObject();
-
-                    json.WriteString("Flags");
-                    json.BeginArray(true);
-                    VkMemoryPropertyFlags flags = allocator->m_MemProps.memoryTypes[typeIndex].propertyFlags;
-                    if((flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) != 0)
-                    {
-                        json.WriteString("DEVICE_LOCAL");
-                    }
-                    if((flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0)
-                    {
-                        json.WriteString("HOST_VISIBLE");
-                    }
-                    if((flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0)
-                    {
-                        json.WriteString("HOST_COHERENT");
-                    }
-                    if((flags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT) != 0)
-                    {
-                        json.WriteString("HOST_CACHED");
-                    }
-                    if((flags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) != 0)
-                    {
-                        json.WriteString("LAZILY_ALLOCATED");
-                    }
-                    json.EndArray();
-
-                    if(stats.memoryType[typeIndex].blockCount > 0)
-                    {
-                        json.WriteString("Stats");
-                        VmaPrintStatInfo(json, stats.memoryType[typeIndex]);
-                    }
+                    json.WriteString("DEVICE_LOCAL");
+                }
+                if((flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0)
+                {
+                    json.WriteString("HOST_VISIBLE");
+                }
+                if((flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0)
+                {
+                    json.WriteString("HOST_COHERENT");
+                }
+                if((flags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT) != 0)
+                {
+                    json.WriteString("HOST_CACHED");
+                }
+                if((flags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) != 0)
+                {
+                    json.WriteString("LAZILY_ALLOCATED");
+                }
+                json.EndArray();
 
-                    json.EndObject();
+                if(stats.memoryType[typeIndex].blockCount > 0)
+                {
+                    json.WriteString("Stats");
+                    VmaPrintStatInfo(json, stats.memoryType[typeIndex]);
                 }
-            }
 
-            json.EndObject();
-        }
-        if(detailedMap == VK_TRUE)
-        {
-            allocator->PrintDetailedMap(json);
+                json.EndObject();
+            }
         }
 
         json.EndObject();
     }
+    if(detailedMap)
+    {
+        allocator->PrintDetailedMap(json);
+    }
+
+    json.EndObject();
+}
+
+void vmaBuildStatsString(
+    VmaAllocator allocator,
+    char** ppStatsString,
+    VkBool32 detailedMap)
+{
+    VMA_ASSERT(allocator && ppStatsString);
+    VMA_DEBUG_GLOBAL_MUTEX_LOCK
+
+    VmaStringBuilder sb(allocator);
+    {
+        VmaJsonWriter json(allocator->GetAllocationCallbacks(), sb);
+        VmaPrintStats(json, allocator, detailedMap == VK_TRUE);
+    }
 
     const size_t len = sb.GetLength();
     char* const pChars = vma_new_array(allocator, char, len + 1);
@@ -15949,6 +24631,46 @@ void vmaFreeStatsString(
     }
 }
 
+VkResult vmaWriteStatsToSink(
+    VmaAllocator allocator,
+    const VmaStatsSink* pSink,
+    VkBool32 detailedMap)
+{
+    VMA_ASSERT(allocator && pSink);
+    VMA_DEBUG_GLOBAL_MUTEX_LOCK
+
+    VmaStringBuilder sb(allocator, *pSink);
+    {
+        VmaJsonWriter json(allocator->GetAllocationCallbacks(), sb);
+        VmaPrintStats(json, allocator, detailedMap == VK_TRUE);
+    }
+    sb.Flush();
+
+    return sb.SinkFailed() ? VK_INCOMPLETE : VK_SUCCESS;
+}
+
+VkResult vmaWriteBinaryStats(
+    VmaAllocator allocator,
+    const VmaStatsSink* pSink)
+{
+    VMA_ASSERT(allocator && pSink);
+    VMA_DEBUG_GLOBAL_MUTEX_LOCK
+
+    VmaStringBuilder sb(allocator, *pSink);
+    {
+        VmaStats stats;
+        allocator->CalculateStats(&stats);
+
+        VmaBinaryStatsWriter writer(allocator, sb);
+        writer.WriteBegin(stats);
+        allocator->WriteBinaryDetailedMap(writer);
+        writer.WriteEnd();
+    }
+    sb.Flush();
+
+    return sb.SinkFailed() ? VK_INCOMPLETE : VK_SUCCESS;
+}
+
 #endif // #if VMA_STATS_STRING_ENABLED
 
 /*
@@ -16159,6 +24881,31 @@ void vmaGetPoolStats(
     allocator->GetPoolStats(pool, pPoolStats);
 }
 
+void vmaGetPoolAllocationHistograms(
+    VmaAllocator allocator,
+    VmaPool pool,
+    VmaAllocationHistograms* pHistograms)
+{
+    VMA_ASSERT(allocator && pool && pHistograms);
+
+    VMA_DEBUG_GLOBAL_MUTEX_LOCK
+
+    allocator->GetPoolAllocationHistograms(pool, pHistograms);
+}
+
+void vmaGetMemoryTypeAllocationHistograms(
+    VmaAllocator allocator,
+    uint32_t memoryTypeIndex,
+    VmaAllocationHistograms* pHistograms)
+{
+    VMA_ASSERT(allocator && pHistograms);
+    VMA_ASSERT(memoryTypeIndex < allocator->GetMemoryTypeCount());
+
+    VMA_DEBUG_GLOBAL_MUTEX_LOCK
+
+    allocator->GetMemoryTypeAllocationHistograms(memoryTypeIndex, pHistograms);
+}
+
 void vmaMakePoolAllocationsLost(
     VmaAllocator allocator,
     VmaPool pool,
@@ -16178,6 +24925,21 @@ void vmaMakePoolAllocationsLost(
     allocator->MakePoolAllocationsLost(pool, pLostAllocationCount);
 }
 
+VkResult vmaFreePoolAllocations(
+    VmaAllocator allocator,
+    VmaPool pool,
+    uint32_t lastFrameIndex,
+    size_t* pFreedAllocationCount)
+{
+    VMA_ASSERT(allocator && pool);
+
+    VMA_DEBUG_LOG("vmaFreePoolAllocations");
+
+    VMA_DEBUG_GLOBAL_MUTEX_LOCK
+
+    return allocator->FreePoolAllocations(pool, lastFrameIndex, pFreedAllocationCount);
+}
+
 VkResult vmaCheckPoolCorruption(VmaAllocator allocator, VmaPool pool)
 {
     VMA_ASSERT(allocator && pool);
@@ -16388,6 +25150,38 @@ VkResult vmaAllocateMemoryForImage(
 	return result;
 }
 
+VkResult vmaAllocateMemoryWithoutHandle(
+    VmaAllocator allocator,
+    const VkMemoryRequirements* pVkMemoryRequirements,
+    const VmaAllocationCreateInfo* pCreateInfo,
+    VmaAllocationInfo* pAllocationInfo)
+{
+    VMA_ASSERT(allocator && pVkMemoryRequirements && pCreateInfo && pAllocationInfo);
+
+    VMA_DEBUG_LOG("vmaAllocateMemoryWithoutHandle");
+
+    VMA_DEBUG_GLOBAL_MUTEX_LOCK
+
+    VkResult result = allocator->AllocateMemoryWithoutHandle(
+        *pVkMemoryRequirements,
+        *pCreateInfo,
+        VMA_SUBALLOCATION_TYPE_UNKNOWN,
+        pAllocationInfo);
+
+#if VMA_RECORDING_ENABLED
+    if(allocator->GetRecorder() != VMA_NULL)
+    {
+        allocator->GetRecorder()->RecordAllocateMemoryWithoutHandle(
+            allocator->GetCurrentFrameIndex(),
+            *pVkMemoryRequirements,
+            *pCreateInfo,
+            result == VK_SUCCESS);
+    }
+#endif
+
+    return result;
+}
+
 void vmaFreeMemory(
     VmaAllocator allocator,
     VmaAllocation allocation)
@@ -16637,6 +25431,50 @@ VkResult vmaCheckCorruption(VmaAllocator allocator, uint32_t memoryTypeBits)
     return allocator->CheckCorruption(memoryTypeBits);
 }
 
+#if VMA_STATS_STRING_ENABLED
+
+VkResult vmaCreateStatsSnapshot(
+    VmaAllocator allocator,
+    VmaStatsSnapshotCreateFlags flags,
+    VmaStatsSnapshot* pSnapshot)
+{
+    VMA_ASSERT(allocator && pSnapshot);
+    VMA_DEBUG_GLOBAL_MUTEX_LOCK
+    return allocator->CreateStatsSnapshot(flags, pSnapshot);
+}
+
+void vmaDestroyStatsSnapshot(
+    VmaAllocator allocator,
+    VmaStatsSnapshot snapshot)
+{
+    if(snapshot != VK_NULL_HANDLE)
+    {
+        VMA_ASSERT(allocator);
+        allocator->DestroyStatsSnapshot(snapshot);
+    }
+}
+
+VkResult vmaCompareStatsSnapshots(
+    VmaAllocator allocator,
+    VmaStatsSnapshot before,
+    VmaStatsSnapshot after,
+    VmaStatsSnapshotDiff* pDiff)
+{
+    VMA_ASSERT(allocator && before && after && pDiff);
+    allocator->CompareStatsSnapshots(*before, *after, pDiff);
+    return VK_SUCCESS;
+}
+
+void vmaFreeStatsSnapshotDiff(
+    VmaAllocator allocator,
+    VmaStatsSnapshotDiff* pDiff)
+{
+    VMA_ASSERT(allocator && pDiff);
+    allocator->FreeStatsSnapshotDiff(pDiff);
+}
+
+#endif // #if VMA_STATS_STRING_ENABLED
+
 VkResult vmaDefragment(
     VmaAllocator allocator,
     VmaAllocation* pAllocations,
@@ -16736,6 +25574,71 @@ VkResult vmaDefragmentationEnd(
     }
 }
 
+VkResult vmaEstimateDefragmentation(
+    VmaAllocator allocator,
+    const VmaDefragmentationInfo2* pInfo,
+    VmaDefragmentationEstimate* pEstimate)
+{
+    VMA_ASSERT(allocator && pInfo && pEstimate);
+
+    // Degenerate case: Nothing to defragment.
+    if(pInfo->allocationCount == 0 && pInfo->poolCount == 0)
+    {
+        memset(pEstimate, 0, sizeof(VmaDefragmentationEstimate));
+        return VK_SUCCESS;
+    }
+
+    VMA_ASSERT(pInfo->allocationCount == 0 || pInfo->pAllocations != VMA_NULL);
+    VMA_ASSERT(pInfo->poolCount == 0 || pInfo->pPools != VMA_NULL);
+    VMA_HEAVY_ASSERT(VmaValidatePointerArray(pInfo->allocationCount, pInfo->pAllocations));
+    VMA_HEAVY_ASSERT(VmaValidatePointerArray(pInfo->poolCount, pInfo->pPools));
+
+    VMA_DEBUG_LOG("vmaEstimateDefragmentation");
+
+    VMA_DEBUG_GLOBAL_MUTEX_LOCK
+
+    return allocator->EstimateDefragmentation(*pInfo, pEstimate);
+}
+
+void vmaGetPoolFragmentationScore(
+    VmaAllocator allocator,
+    VmaPool pool,
+    VmaFragmentationScore* pScore)
+{
+    VMA_ASSERT(allocator && pool && pScore);
+
+    VMA_DEBUG_GLOBAL_MUTEX_LOCK
+
+    allocator->GetPoolFragmentationScore(pool, pScore);
+}
+
+void vmaGetMemoryTypeFragmentationScore(
+    VmaAllocator allocator,
+    uint32_t memoryTypeIndex,
+    VmaFragmentationScore* pScore)
+{
+    VMA_ASSERT(allocator && pScore);
+    VMA_ASSERT(memoryTypeIndex < allocator->GetMemoryTypeCount());
+
+    VMA_DEBUG_GLOBAL_MUTEX_LOCK
+
+    allocator->GetMemoryTypeFragmentationScore(memoryTypeIndex, pScore);
+}
+
+void vmaSetPoolAutoDefragmentationPolicy(
+    VmaAllocator allocator,
+    VmaPool pool,
+    const VmaAutoDefragmentationPolicy* pPolicy)
+{
+    VMA_ASSERT(allocator && pool);
+
+    VMA_DEBUG_LOG("vmaSetPoolAutoDefragmentationPolicy");
+
+    VMA_DEBUG_GLOBAL_MUTEX_LOCK
+
+    allocator->SetPoolAutoDefragmentationPolicy(pool, pPolicy);
+}
+
 VkResult vmaBindBufferMemory(
     VmaAllocator allocator,
     VmaAllocation allocation,
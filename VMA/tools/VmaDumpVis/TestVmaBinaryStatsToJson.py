@@ -0,0 +1,57 @@
+#
+# Copyright (c) 2018-2019 Advanced Micro Devices, Inc. All rights reserved.
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+#
+
+import argparse
+import mmap
+import sys
+
+import VmaBinaryStatsToJson
+
+
+PROGRAM_VERSION = 'VMA Binary Stats To JSON Test 1.0.0'
+
+
+if __name__ == '__main__':
+    argParser = argparse.ArgumentParser(description='Checks that VmaBinaryStatsToJson.py converts binary dump to the same JSON as returned by vmaBuildStatsString() for the same state of the allocator, '
+        'e.g. StatsSink.bin and StatsSink.json saved by VulkanSample tests.')
+    argParser.add_argument('DumpFile', help='Path to binary file created by vmaWriteBinaryStats()')
+    argParser.add_argument('JsonFile', help='Path to JSON file created by vmaBuildStatsString() with detailed map')
+    argParser.add_argument('-v', '--version', action='version', version=PROGRAM_VERSION)
+    args = argParser.parse_args()
+
+    with open(args.JsonFile, 'rb') as jsonFile:
+        expected = jsonFile.read()
+    try:
+        with open(args.DumpFile, 'rb') as srcFile:
+            with mmap.mmap(srcFile.fileno(), 0, access=mmap.ACCESS_READ) as data:
+                actual = VmaBinaryStatsToJson.ConvertToJson(VmaBinaryStatsToJson.BinaryStats(data)).encode('ascii')
+    except ValueError as e:
+        sys.exit('FAILED: Conversion error: %s' % e)
+
+    if actual != expected:
+        actualLines = actual.split(b'\n')
+        expectedLines = expected.split(b'\n')
+        for i in range(min(len(actualLines), len(expectedLines))):
+            if actualLines[i] != expectedLines[i]:
+                sys.exit('FAILED: Line %d differs.\nExpected: %s\nActual:   %s' % (i + 1, expectedLines[i].decode('ascii', 'backslashreplace'), actualLines[i].decode('ascii', 'backslashreplace')))
+        sys.exit('FAILED: Different number of lines: expected %d, actual %d.' % (len(expectedLines), len(actualLines)))
+    print('PASSED')
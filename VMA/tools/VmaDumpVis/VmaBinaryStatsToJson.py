@@ -0,0 +1,445 @@
+#
+# Copyright (c) 2018-2019 Advanced Micro Devices, Inc. All rights reserved.
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+#
+
+import argparse
+import io
+import mmap
+import struct
+import sys
+
+
+PROGRAM_VERSION = 'VMA Binary Stats To JSON 1.0.0'
+MAGIC = b'VMASTATS'
+SUPPORTED_VERSION = 1
+
+HEADER_FORMAT = '<8sIIIIII'
+HEAP_FORMAT = '<QII'
+TYPE_FORMAT = '<II'
+STAT_INFO_FORMAT = '<IIIIQQQQQQQQ'
+RECORD_FORMAT = '<BBHIQQQII'
+TRAILER_FORMAT = '<QQ'
+
+RECORD_TYPE_DEDICATED_ALLOCATION = 1
+RECORD_TYPE_BLOCK_VECTOR = 2
+RECORD_TYPE_BLOCK = 3
+RECORD_TYPE_ALLOCATION = 4
+RECORD_TYPE_UNUSED_RANGE = 5
+RECORD_TYPE_HISTOGRAM_BUCKET = 6
+
+HISTOGRAM_ALLOCATION_SIZE = 0
+HISTOGRAM_ALLOCATION_LIFETIME = 1
+
+RECORD_FLAG_USER_DATA = 0x1
+RECORD_FLAG_USER_DATA_STRING = 0x2
+RECORD_FLAG_HANDLELESS = 0x4
+RECORD_FLAG_CUSTOM_POOL = 0x1
+
+SUBALLOCATION_TYPE_NAMES = ['FREE', 'UNKNOWN', 'BUFFER', 'IMAGE_UNKNOWN', 'IMAGE_LINEAR', 'IMAGE_OPTIMAL']
+ALGORITHM_NAMES = {0x4: 'Linear', 0x8: 'Buddy'}
+SIZE_MAX = 0xFFFFFFFFFFFFFFFF
+
+MEMORY_HEAP_DEVICE_LOCAL_BIT = 0x1
+MEMORY_PROPERTY_FLAG_NAMES = [(0x1, 'DEVICE_LOCAL'), (0x2, 'HOST_VISIBLE'), (0x4, 'HOST_COHERENT'), (0x8, 'HOST_CACHED'), (0x10, 'LAZILY_ALLOCATED')]
+
+
+class JsonWriter:
+    """Writes JSON formatted the same way as VmaJsonWriter in vk_mem_alloc.h."""
+
+    INDENT = '  '
+
+    def __init__(self, out):
+        self.out = out
+        self.stack = [] # Items are lists: [isObject, valueCount, singleLine]
+
+    def BeginObject(self, singleLine=False):
+        self._BeginValue()
+        self.out.write('{')
+        self.stack.append([True, 0, singleLine])
+
+    def EndObject(self):
+        self._WriteIndent(True)
+        self.out.write('}')
+        self.stack.pop()
+
+    def BeginArray(self, singleLine=False):
+        self._BeginValue()
+        self.out.write('[')
+        self.stack.append([False, 0, singleLine])
+
+    def EndArray(self):
+        self._WriteIndent(True)
+        self.out.write(']')
+        self.stack.pop()
+
+    def WriteString(self, s):
+        self._BeginValue()
+        self.out.write('"')
+        for ch in s:
+            if ch == '\\':
+                self.out.write('\\\\')
+            elif ch == '"':
+                self.out.write('\\"')
+            elif ch == '\b':
+                self.out.write('\\b')
+            elif ch == '\f':
+                self.out.write('\\f')
+            elif ch == '\n':
+                self.out.write('\\n')
+            elif ch == '\r':
+                self.out.write('\\r')
+            elif ch == '\t':
+                self.out.write('\\t')
+            elif ch < ' ':
+                # vmaBuildStatsString() skips it with an assert, so there is no equivalent output.
+                raise ValueError('Character 0x%02x is not supported in JSON string.' % ord(ch))
+            else:
+                self.out.write(ch)
+        self.out.write('"')
+
+    def WriteNumber(self, n):
+        self._BeginValue()
+        self.out.write(str(n))
+
+    # Writes "key": value pair of an object.
+    def WriteNumberMember(self, key, n):
+        self.WriteString(key)
+        self.WriteNumber(n)
+
+    def _BeginValue(self):
+        if self.stack:
+            item = self.stack[-1]
+            if item[0] and item[1] % 2 != 0:
+                self.out.write(': ')
+            elif item[1] > 0:
+                self.out.write(', ')
+                self._WriteIndent()
+            else:
+                self._WriteIndent()
+            item[1] += 1
+
+    def _WriteIndent(self, oneLess=False):
+        if self.stack and not self.stack[-1][2]:
+            self.out.write('\n')
+            count = len(self.stack)
+            if oneLess:
+                count -= 1
+            self.out.write(JsonWriter.INDENT * count)
+
+
+class BinaryStats:
+    """Reads file written by vmaWriteBinaryStats(). Records are accessed directly in memory-mapped file."""
+
+    def __init__(self, data):
+        self.data = data
+        (magic, version, headerSize, self.recordSize, self.heapCount, self.typeCount, reserved) = struct.unpack_from(HEADER_FORMAT, data, 0)
+        if magic != MAGIC:
+            raise ValueError('Not a VMA binary stats file.')
+        if version != SUPPORTED_VERSION:
+            raise ValueError('Unsupported version %d of VMA binary stats file.' % version)
+        if self.recordSize < struct.calcsize(RECORD_FORMAT):
+            raise ValueError('Invalid record size.')
+        offset = headerSize
+        self.heaps = []
+        for i in range(self.heapCount):
+            self.heaps.append(struct.unpack_from(HEAP_FORMAT, data, offset))
+            offset += struct.calcsize(HEAP_FORMAT)
+        self.types = []
+        for i in range(self.typeCount):
+            self.types.append(struct.unpack_from(TYPE_FORMAT, data, offset))
+            offset += struct.calcsize(TYPE_FORMAT)
+        self.statInfos = []
+        for i in range(1 + self.heapCount + self.typeCount):
+            self.statInfos.append(struct.unpack_from(STAT_INFO_FORMAT, data, offset))
+            offset += struct.calcsize(STAT_INFO_FORMAT)
+        trailerOffset = len(data) - struct.calcsize(TRAILER_FORMAT)
+        (self.recordCount, stringTableSize) = struct.unpack_from(TRAILER_FORMAT, data, trailerOffset)
+        self.recordsOffset = offset
+        self.stringTableOffset = offset + self.recordCount * self.recordSize
+        if self.stringTableOffset + stringTableSize != trailerOffset:
+            raise ValueError('Invalid file size.')
+
+    def Record(self, index):
+        return struct.unpack_from(RECORD_FORMAT, self.data, self.recordsOffset + index * self.recordSize)
+
+    def String(self, offset):
+        begin = self.stringTableOffset + offset
+        end = self.data.find(b'\0', begin)
+        try:
+            # vmaBuildStatsString() writes only ASCII characters of strings, so others can't be converted the same way.
+            return self.data[begin:end].decode('ascii')
+        except UnicodeDecodeError:
+            raise ValueError('String at offset %d contains non-ASCII characters, which are not supported.' % offset)
+
+
+def PrintStatInfo(json, statInfo):
+    (blockCount, allocationCount, unusedRangeCount, reserved, usedBytes, unusedBytes,
+        allocationSizeMin, allocationSizeAvg, allocationSizeMax,
+        unusedRangeSizeMin, unusedRangeSizeAvg, unusedRangeSizeMax) = statInfo
+    json.BeginObject()
+    json.WriteNumberMember('Blocks', blockCount)
+    json.WriteNumberMember('Allocations', allocationCount)
+    json.WriteNumberMember('UnusedRanges', unusedRangeCount)
+    json.WriteNumberMember('UsedBytes', usedBytes)
+    json.WriteNumberMember('UnusedBytes', unusedBytes)
+    if allocationCount > 1:
+        json.WriteString('AllocationSize')
+        json.BeginObject(True)
+        json.WriteNumberMember('Min', allocationSizeMin)
+        json.WriteNumberMember('Avg', allocationSizeAvg)
+        json.WriteNumberMember('Max', allocationSizeMax)
+        json.EndObject()
+    if unusedRangeCount > 1:
+        json.WriteString('UnusedRangeSize')
+        json.BeginObject(True)
+        json.WriteNumberMember('Min', unusedRangeSizeMin)
+        json.WriteNumberMember('Avg', unusedRangeSizeAvg)
+        json.WriteNumberMember('Max', unusedRangeSizeMax)
+        json.EndObject()
+    json.EndObject()
+
+
+def PrintAllocationParameters(json, stats, record):
+    (recordType, subType, flags, usage, offset, size, userData, creationFrameIndex, lastUseFrameIndex) = record
+    json.WriteString('Type')
+    json.WriteString(SUBALLOCATION_TYPE_NAMES[subType])
+    json.WriteNumberMember('Size', size)
+    if flags & RECORD_FLAG_USER_DATA_STRING:
+        json.WriteString('UserData')
+        json.WriteString(stats.String(userData))
+    elif flags & RECORD_FLAG_USER_DATA:
+        json.WriteString('UserData')
+        json.WriteString('0x%x' % userData)
+    json.WriteNumberMember('CreationFrameIndex', creationFrameIndex)
+    if flags & RECORD_FLAG_HANDLELESS:
+        return
+    json.WriteNumberMember('LastUseFrameIndex', lastUseFrameIndex)
+    if usage != 0:
+        json.WriteNumberMember('Usage', usage)
+
+
+def PrintBlockVector(json, stats, recordIndex):
+    (recordType, algorithm, flags, memTypeIndex, preferredBlockSize, minBlockCount, maxBlockCount, poolId, frameInUseCount) = stats.Record(recordIndex)
+    # Histogram buckets come first, before blocks.
+    histograms = {HISTOGRAM_ALLOCATION_SIZE: [], HISTOGRAM_ALLOCATION_LIFETIME: []}
+    recordIndex += 1
+    while recordIndex < stats.recordCount:
+        record = stats.Record(recordIndex)
+        if record[0] != RECORD_TYPE_HISTOGRAM_BUCKET:
+            break
+        # Key is lower bound of the bucket.
+        bucketIndex = record[3]
+        if record[1] == HISTOGRAM_ALLOCATION_SIZE:
+            lowerBound = 1 << bucketIndex
+        else:
+            lowerBound = 1 << (bucketIndex - 1) if bucketIndex > 0 else 0
+        histograms[record[1]].append((lowerBound, record[4]))
+        recordIndex += 1
+    # Count blocks in advance, as it is printed before them.
+    blockCount = 0
+    endIndex = recordIndex
+    while endIndex < stats.recordCount:
+        nextRecordType = stats.Record(endIndex)[0]
+        if nextRecordType == RECORD_TYPE_BLOCK:
+            blockCount += 1
+        elif nextRecordType != RECORD_TYPE_ALLOCATION and nextRecordType != RECORD_TYPE_UNUSED_RANGE:
+            break
+        endIndex += 1
+
+    json.BeginObject()
+    if flags & RECORD_FLAG_CUSTOM_POOL:
+        json.WriteNumberMember('MemoryTypeIndex', memTypeIndex)
+        json.WriteNumberMember('BlockSize', preferredBlockSize)
+        json.WriteString('BlockCount')
+        json.BeginObject(True)
+        if minBlockCount > 0:
+            json.WriteNumberMember('Min', minBlockCount)
+        if maxBlockCount < SIZE_MAX:
+            json.WriteNumberMember('Max', maxBlockCount)
+        json.WriteNumberMember('Cur', blockCount)
+        json.EndObject()
+        if frameInUseCount > 0:
+            json.WriteNumberMember('FrameInUseCount', frameInUseCount)
+        if algorithm != 0:
+            json.WriteString('Algorithm')
+            json.WriteString(ALGORITHM_NAMES[algorithm])
+    else:
+        json.WriteNumberMember('PreferredBlockSize', preferredBlockSize)
+
+    for (histogram, name) in ((HISTOGRAM_ALLOCATION_SIZE, 'AllocationSizeHistogram'), (HISTOGRAM_ALLOCATION_LIFETIME, 'AllocationLifetimeHistogram')):
+        if histograms[histogram]:
+            json.WriteString(name)
+            json.BeginObject(True)
+            for (lowerBound, count) in histograms[histogram]:
+                json.WriteNumberMember(str(lowerBound), count)
+            json.EndObject()
+
+    json.WriteString('Blocks')
+    json.BeginObject()
+    blockStarted = False
+    for i in range(recordIndex, endIndex):
+        record = stats.Record(i)
+        recordType = record[0]
+        if recordType == RECORD_TYPE_BLOCK:
+            (recordType, subType, flags, blockId, blockSize, unusedBytes, allocationCount, unusedRangeCount, reserved) = record
+            if blockStarted:
+                json.EndArray()
+                json.EndObject()
+            blockStarted = True
+            json.WriteString(str(blockId))
+            json.BeginObject()
+            json.WriteNumberMember('TotalBytes', blockSize)
+            json.WriteNumberMember('UnusedBytes', unusedBytes)
+            json.WriteNumberMember('Allocations', allocationCount)
+            json.WriteNumberMember('UnusedRanges', unusedRangeCount)
+            json.WriteString('Suballocations')
+            json.BeginArray()
+        elif recordType == RECORD_TYPE_ALLOCATION:
+            json.BeginObject(True)
+            json.WriteNumberMember('Offset', record[4])
+            PrintAllocationParameters(json, stats, record)
+            json.EndObject()
+        else:
+            json.BeginObject(True)
+            json.WriteNumberMember('Offset', record[4])
+            json.WriteString('Type')
+            json.WriteString(SUBALLOCATION_TYPE_NAMES[0])
+            json.WriteNumberMember('Size', record[5])
+            json.EndObject()
+    if blockStarted:
+        json.EndArray()
+        json.EndObject()
+    json.EndObject()
+
+    json.EndObject()
+    return endIndex
+
+
+def ConvertToJson(stats):
+    """Returns JSON as a string. Raises ValueError if it can't be the same as from vmaBuildStatsString()."""
+    out = io.StringIO()
+    PrintStats(JsonWriter(out), stats)
+    return out.getvalue()
+
+
+def PrintStats(json, stats):
+    json.BeginObject()
+
+    json.WriteString('Total')
+    PrintStatInfo(json, stats.statInfos[0])
+
+    for heapIndex in range(stats.heapCount):
+        (heapSize, heapFlags, reserved) = stats.heaps[heapIndex]
+        json.WriteString('Heap %d' % heapIndex)
+        json.BeginObject()
+        json.WriteNumberMember('Size', heapSize)
+        json.WriteString('Flags')
+        json.BeginArray(True)
+        if heapFlags & MEMORY_HEAP_DEVICE_LOCAL_BIT:
+            json.WriteString('DEVICE_LOCAL')
+        json.EndArray()
+        heapStatInfo = stats.statInfos[1 + heapIndex]
+        if heapStatInfo[0] > 0:
+            json.WriteString('Stats')
+            PrintStatInfo(json, heapStatInfo)
+        for typeIndex in range(stats.typeCount):
+            (propertyFlags, typeHeapIndex) = stats.types[typeIndex]
+            if typeHeapIndex != heapIndex:
+                continue
+            json.WriteString('Type %d' % typeIndex)
+            json.BeginObject()
+            json.WriteString('Flags')
+            json.BeginArray(True)
+            for (flag, name) in MEMORY_PROPERTY_FLAG_NAMES:
+                if propertyFlags & flag:
+                    json.WriteString(name)
+            json.EndArray()
+            typeStatInfo = stats.statInfos[1 + stats.heapCount + typeIndex]
+            if typeStatInfo[0] > 0:
+                json.WriteString('Stats')
+                PrintStatInfo(json, typeStatInfo)
+            json.EndObject()
+        json.EndObject()
+
+    # Records are ordered: dedicated allocations, default pools, custom pools.
+    recordIndex = 0
+    lastMemTypeIndex = None
+    while recordIndex < stats.recordCount:
+        record = stats.Record(recordIndex)
+        if record[0] != RECORD_TYPE_DEDICATED_ALLOCATION:
+            break
+        memTypeIndex = record[4]
+        if lastMemTypeIndex is None:
+            json.WriteString('DedicatedAllocations')
+            json.BeginObject()
+        if memTypeIndex != lastMemTypeIndex:
+            if lastMemTypeIndex is not None:
+                json.EndArray()
+            json.WriteString('Type %d' % memTypeIndex)
+            json.BeginArray()
+            lastMemTypeIndex = memTypeIndex
+        json.BeginObject(True)
+        PrintAllocationParameters(json, stats, record)
+        json.EndObject()
+        recordIndex += 1
+    if lastMemTypeIndex is not None:
+        json.EndArray()
+        json.EndObject()
+
+    for isCustomPool in (False, True):
+        started = False
+        while recordIndex < stats.recordCount:
+            record = stats.Record(recordIndex)
+            assert record[0] == RECORD_TYPE_BLOCK_VECTOR
+            if bool(record[2] & RECORD_FLAG_CUSTOM_POOL) != isCustomPool:
+                break
+            if not started:
+                json.WriteString('Pools' if isCustomPool else 'DefaultPools')
+                json.BeginObject()
+                started = True
+            json.WriteString(str(record[7]) if isCustomPool else 'Type %d' % record[3])
+            recordIndex = PrintBlockVector(json, stats, recordIndex)
+        if started:
+            json.EndObject()
+
+    json.EndObject()
+
+
+if __name__ == '__main__':
+    argParser = argparse.ArgumentParser(description='Converts binary dump created by vmaWriteBinaryStats() to JSON, same as returned by vmaBuildStatsString().')
+    argParser.add_argument('DumpFile', help='Path to source binary file created by Vulkan Memory Allocator library')
+    argParser.add_argument('-v', '--version', action='version', version=PROGRAM_VERSION)
+    argParser.add_argument('-o', '--output', help='Path to destination JSON file. Standard output is used if not specified.')
+    args = argParser.parse_args()
+
+    try:
+        with open(args.DumpFile, 'rb') as srcFile:
+            with mmap.mmap(srcFile.fileno(), 0, access=mmap.ACCESS_READ) as data:
+                jsonStr = ConvertToJson(BinaryStats(data))
+    except (ValueError, struct.error) as e:
+        # Nothing is written, so partial output is never mistaken for the whole.
+        sys.exit('ERROR: %s' % e)
+    # Written as bytes, so line endings are not translated.
+    if args.output:
+        with open(args.output, 'wb') as dstFile:
+            dstFile.write(jsonStr.encode('ascii'))
+    else:
+        sys.stdout.buffer.write(jsonStr.encode('ascii'))